@@ -33,12 +33,30 @@ HEADERS += audio/core/AudioDriver.h
 HEADERS += audio/core/AudioNode.h
 HEADERS += audio/core/AudioMixer.h
 HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/core/SamplesBufferKernels.h
 HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SnapshotPublisher.h
+HEADERS += audio/core/SpscQueue.h
+HEADERS += audio/core/SamplesRingBuffer.h
+HEADERS += audio/core/RenderWorkerPool.h
+HEADERS += audio/core/RenderSchedule.h
+HEADERS += audio/core/RtSemaphore.h
+HEADERS += audio/core/RtViolationDetector.h
+HEADERS += audio/core/DspProfiler.h
 HEADERS += audio/core/Plugins.h
 HEADERS += audio/RoomStreamerNode.h
+HEADERS += audio/AudioFilePlayerNode.h
+HEADERS += audio/AudioFileSource.h
+HEADERS += audio/AudioFileWriter.h
 HEADERS += audio/NinjamTrackNode.h
+HEADERS += audio/NinjamIntervalDecoder.h
+HEADERS += audio/NinjamIntervalEncoder.h
+HEADERS += audio/IntervalCodec.h
 HEADERS += audio/MetronomeTrackNode.h
+HEADERS += audio/MetronomeSoundBank.h
+HEADERS += audio/WaveFileReader.h
 HEADERS += audio/SamplesBufferResampler.h
+HEADERS += audio/StreamJitterBuffer.h
 HEADERS += audio/SamplesBufferRecorder.h
 HEADERS += loginserver/LoginService.h
 HEADERS += loginserver/JsonUtils.h
@@ -46,6 +64,7 @@ HEADERS += MainController.h
 HEADERS += NinjamController.h
 HEADERS += ninjam/User.h
 HEADERS += ninjam/Service.h
+HEADERS += ninjam/NetworkSendThread.h
 HEADERS += ninjam/Server.h
 HEADERS += midi/MidiDriver.h
 HEADERS += gui/plugins/Guis.h
@@ -56,6 +75,7 @@ HEADERS += gui/BaseTrackView.h
 HEADERS += gui/NinjamTrackView.h
 HEADERS += gui/NinjamPanel.h
 HEADERS += gui/BusyDialog.h
+HEADERS += gui/DspProfilerDialog.h
 HEADERS += gui/ChatPanel.h
 HEADERS += gui/ChatMessagePanel.h
 HEADERS += gui/Highligther.h
@@ -92,10 +112,14 @@ SOURCES += audio/core/AudioDriver.cpp
 SOURCES += audio/core/AudioNode.cpp
 SOURCES += audio/core/AudioMixer.cpp
 SOURCES += audio/RoomStreamerNode.cpp
+SOURCES += audio/AudioFilePlayerNode.cpp
+SOURCES += audio/AudioFileSource.cpp
+SOURCES += audio/AudioFileWriter.cpp
 SOURCES += gui/widgets/PeakMeter.cpp
 SOURCES += gui/widgets/WavePeakPanel.cpp
 SOURCES += MainController.cpp
 SOURCES += ninjam/Service.cpp
+SOURCES += ninjam/NetworkSendThread.cpp
 SOURCES += ninjam/User.cpp
 SOURCES += gui/LocalTrackView.cpp
 SOURCES += gui/FxPanel.cpp
@@ -111,14 +135,28 @@ SOURCES += gui/PluginScanDialog.cpp
 SOURCES += gui/NinjamRoomWindow.cpp
 SOURCES += gui/BaseTrackView.cpp
 SOURCES += audio/NinjamTrackNode.cpp
+SOURCES += audio/NinjamIntervalDecoder.cpp
+SOURCES += audio/NinjamIntervalEncoder.cpp
+SOURCES += audio/IntervalCodec.cpp
 SOURCES += gui/NinjamTrackView.cpp
 SOURCES += audio/MetronomeTrackNode.cpp
+SOURCES += audio/MetronomeSoundBank.cpp
+SOURCES += audio/WaveFileReader.cpp
 SOURCES += gui/NinjamPanel.cpp
 SOURCES += ninjam/UserChannel.cpp
 SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/core/SamplesRingBuffer.cpp
+SOURCES += audio/core/RenderWorkerPool.cpp
+SOURCES += audio/core/RenderSchedule.cpp
+SOURCES += audio/core/RtSemaphore.cpp
 SOURCES += audio/SamplesBufferResampler.cpp
+SOURCES += audio/StreamJitterBuffer.cpp
 SOURCES += gui/BusyDialog.cpp
+SOURCES += gui/DspProfilerDialog.cpp
 SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/RtViolationDetector.cpp
+SOURCES += audio/core/DspProfiler.cpp
 SOURCES += geo/IpToLocationResolver.cpp
 SOURCES += gui/ChatPanel.cpp
 SOURCES += gui/ChatMessagePanel.cpp
@@ -143,6 +181,28 @@ SOURCES += gui/widgets/IntervalChunksDisplay.cpp
 SOURCES += gui/widgets/MarqueeLabel.cpp
 SOURCES += UploadIntervalData.cpp
 
+# low latency opus intervals, libopus is not in libs/static yet: build with 'qmake CONFIG+=opus'
+CONFIG(opus) {
+    DEFINES += JAMTABA_OPUS_CODEC
+    INCLUDEPATH += $$ROOT_PATH/libs/includes/opus
+    HEADERS += audio/opus/OpusIntervalEncoder.h
+    HEADERS += audio/opus/OpusIntervalDecoder.h
+    SOURCES += audio/opus/OpusIntervalEncoder.cpp
+    SOURCES += audio/opus/OpusIntervalDecoder.cpp
+    LIBS += -lopus
+}
+
+# FLAC backing tracks and exported jams, libFLAC is not in libs/static yet: build with 'qmake CONFIG+=flac'
+CONFIG(flac) {
+    DEFINES += JAMTABA_FLAC_CODEC
+    INCLUDEPATH += $$ROOT_PATH/libs/includes/flac
+    HEADERS += audio/flac/FlacFileSource.h
+    HEADERS += audio/flac/FlacFileWriter.h
+    SOURCES += audio/flac/FlacFileSource.cpp
+    SOURCES += audio/flac/FlacFileWriter.cpp
+    LIBS += -lFLAC
+}
+
 #multiplatform implementations
 #win32:SOURCES += $$PWD/src/performance/WindowsPerformanceMonitor.cpp
 #macx:SOURCES += $$PWD/src/performance/MacPerformanceMonitor.cpp
@@ -9,3 +9,5 @@ win32{
 }
 
 #SUBDIRS += ThemeEditor
+
+#SUBDIRS += JamtabaBench #headless render benchmark, see src/JamtabaBench/main.cpp
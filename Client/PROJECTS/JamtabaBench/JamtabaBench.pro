@@ -0,0 +1,95 @@
+!include( ../Jamtaba-common.pri ) {
+    error( "Couldn't find the Jamtaba-common.pri file!" )
+}
+
+# headless benchmark of the audio engine, renders recorded (or synthetic) intervals offline
+
+QT += core gui network widgets
+
+TARGET = JamtabaBench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+# the allocations and locks in the audio thread are reported in release builds too
+DEFINES += JT_RT_VIOLATION_DETECTOR
+
+INCLUDEPATH += $$SOURCE_PATH/JamtabaBench
+INCLUDEPATH += $$ROOT_PATH/libs/includes/ogg
+INCLUDEPATH += $$ROOT_PATH/libs/includes/vorbis
+INCLUDEPATH += $$ROOT_PATH/libs/includes/minimp3
+
+VPATH += $$SOURCE_PATH/JamtabaBench
+
+DEPENDPATH +=  $$ROOT_PATH/libs/includes/ogg
+DEPENDPATH +=  $$ROOT_PATH/libs/includes/vorbis
+DEPENDPATH +=  $$ROOT_PATH/libs/includes/minimp3
+
+HEADERS += BenchMainController.h
+HEADERS += OfflineRenderBench.h
+HEADERS += recorder/JamRecorder.h
+HEADERS += recorder/ReaperProjectGenerator.h
+HEADERS += recorder/RecordingDiskWriter.h
+HEADERS += recorder/ChainedTrackIndex.h
+HEADERS += ninjam/protocol/ServerMessageParser.h
+HEADERS += ninjam/protocol/ServerMessages.h
+HEADERS += ninjam/protocol/ClientMessages.h
+HEADERS += ninjam/protocol/MessageFraming.h
+HEADERS += loginserver/natmap.h
+HEADERS += audio/codec.h
+HEADERS += audio/vorbis/VorbisDecoder.h
+HEADERS += audio/vorbis/VorbisEncoder.h
+HEADERS += persistence/Settings.h
+HEADERS += geo/WebIpToLocationResolver.h
+
+SOURCES += main.cpp
+SOURCES += BenchMainController.cpp
+SOURCES += OfflineRenderBench.cpp
+SOURCES += recorder/JamRecorder.cpp
+SOURCES += recorder/ReaperProjectGenerator.cpp
+SOURCES += recorder/RecordingDiskWriter.cpp
+SOURCES += recorder/ChainedTrackIndex.cpp
+SOURCES += loginserver/LoginService.cpp
+SOURCES += loginserver/JsonUtils.cpp
+SOURCES += ninjam/protocol/ServerMessages.cpp
+SOURCES += ninjam/protocol/ClientMessages.cpp
+SOURCES += ninjam/protocol/ServerMessageParser.cpp
+SOURCES += ninjam/protocol/MessageFraming.cpp
+SOURCES += ninjam/Server.cpp
+SOURCES += audio/vorbis/VorbisDecoder.cpp
+SOURCES += audio/samplesbufferrecorder.cpp
+SOURCES += audio/vorbis/VorbisEncoder.cpp
+SOURCES += persistence/Settings.cpp
+SOURCES += geo/WebIpToLocationResolver.cpp
+SOURCES += audio/core/PluginDescriptor.cpp
+
+win32{
+    win32-msvc*{
+        QMAKE_LFLAGS += /ignore:4099 #supressing warning about missing .pdb files
+        !contains(QMAKE_TARGET.arch, x86_64) {
+            LIBS_PATH = "static/win32-msvc"
+        } else {
+            LIBS_PATH = "static/win64-msvc"
+        }
+    }
+    win32-g++{
+        LIBS_PATH = "static/win32-mingw"
+    }
+    LIBS +=  -lwinmm -lole32 -lws2_32 -lAdvapi32 -lUser32
+}
+
+macx{
+    LIBS_PATH = "static/mac64"
+    LIBS += -framework CoreServices
+}
+
+linux{
+    LIBS_PATH = "static/linux64"
+}
+
+win32-msvc*{
+    CONFIG(release, debug|release): LIBS += -L$$PWD/../../libs/$$LIBS_PATH/ -lminimp3 -lvorbisfile -lvorbis -logg
+    else:CONFIG(debug, debug|release): LIBS += -L$$PWD/../../libs/$$LIBS_PATH/ -lminimp3d -lvorbisfiled -lvorbisd -loggd
+} else {
+    LIBS += -L$$PWD/../../libs/$$LIBS_PATH/ -lminimp3 -lvorbisfile -lvorbisenc -lvorbis -logg
+}
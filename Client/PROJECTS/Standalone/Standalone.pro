@@ -7,6 +7,10 @@ QT += core gui network widgets
 TARGET = Jamtaba2
 TEMPLATE = app
 
+# count heap allocations and locks in the audio thread (see RtViolationDetector). Not enabled
+# in the VST plugin, a DLL can't replace the global new/delete of the host process.
+CONFIG(debug, debug|release): DEFINES += JT_RT_VIOLATION_DETECTOR
+
 INCLUDEPATH += $$ROOT_PATH/libs/includes/portaudio
 INCLUDEPATH += $$ROOT_PATH/libs/includes/rtmidi
 INCLUDEPATH += $$ROOT_PATH/libs/includes/ogg
@@ -32,16 +36,18 @@ HEADERS += StandalonePreferencesDialog.h
 HEADERS += StandaloneLocalTrackView.h
 HEADERS += StandaloneLocalTrackGroupView.h
 
-HEADERS += audio/core/PortAudioDriver.h
 HEADERS += recorder/JamRecorder.h
 HEADERS += recorder/ReaperProjectGenerator.h
+HEADERS += recorder/RecordingDiskWriter.h
+HEADERS += recorder/ChainedTrackIndex.h
+HEADERS += recorder/JamMixdown.h
 HEADERS += ninjam/protocol/ServerMessageParser.h
 HEADERS += ninjam/protocol/ServerMessages.h
 HEADERS += ninjam/protocol/ClientMessages.h
+HEADERS += ninjam/protocol/MessageFraming.h
 HEADERS += loginserver/natmap.h
 HEADERS += audio/codec.h
 HEADERS += midi/rtMidiDriver.h
-HEADERS += audio/Resampler.h
 HEADERS += audio/vorbis/VorbisDecoder.h
 HEADERS += audio/vorbis/VorbisEncoder.h
 HEADERS += persistence/Settings.h
@@ -61,14 +67,17 @@ SOURCES += StandaloneLocalTrackGroupView.cpp
 
 SOURCES += recorder/JamRecorder.cpp
 SOURCES += recorder/ReaperProjectGenerator.cpp
+SOURCES += recorder/RecordingDiskWriter.cpp
+SOURCES += recorder/ChainedTrackIndex.cpp
+SOURCES += recorder/JamMixdown.cpp
 SOURCES += loginserver/LoginService.cpp
 SOURCES += loginserver/JsonUtils.cpp
 SOURCES += ninjam/protocol/ServerMessages.cpp
 SOURCES += ninjam/protocol/ClientMessages.cpp
 SOURCES += ninjam/protocol/ServerMessageParser.cpp
+SOURCES += ninjam/protocol/MessageFraming.cpp
 SOURCES += ninjam/Server.cpp
 SOURCES += midi/rtMidiDriver.cpp
-SOURCES += audio/Resampler.cpp
 SOURCES += audio/vorbis/VorbisDecoder.cpp
 SOURCES += audio/samplesbufferrecorder.cpp
 SOURCES += audio/vorbis/VorbisEncoder.cpp
@@ -77,17 +86,24 @@ SOURCES += audio/vst/VstPlugin.cpp
 SOURCES += audio/vst/vsthost.cpp
 SOURCES += geo/WebIpToLocationResolver.cpp
 SOURCES += Libs/SingleApplication/singleapplication.cpp
-SOURCES += audio/core/PortAudioDriver.cpp
 SOURCES += audio/core/PluginDescriptor.cpp
 SOURCES += audio/vst/VstLoader.cpp
 
 #conditional sources to different platforms
+!linux{
+    HEADERS += audio/core/PortAudioDriver.h
+    SOURCES += audio/core/PortAudioDriver.cpp
+}
 win32{
     SOURCES += audio/core/WindowsPortAudioDriver.cpp
 }
 macx{
     SOURCES += audio/core/MacPortAudioDriver.cpp
 }
+linux{
+    HEADERS += audio/core/JackAudioDriver.h
+    SOURCES += audio/core/JackAudioDriver.cpp
+}
 
 win32{
 
@@ -158,3 +174,11 @@ macx{
     #mac osx doc icon
     ICON = ../Jamtaba.icns
 }
+
+linux{
+    message("Linux build")
+    LIBS_PATH = "static/linux64"
+
+    LIBS += -L$$PWD/../../libs/$$LIBS_PATH/ -lminimp3 -lvorbisfile -lvorbisenc -lvorbis -logg
+    LIBS += -ljack -lrtmidi -lasound #system libs
+}
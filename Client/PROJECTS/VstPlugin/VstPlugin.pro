@@ -44,12 +44,14 @@ DEPENDPATH +=  $$ROOT_PATH/libs/includes/minimp3
 
 HEADERS += recorder/JamRecorder.h
 HEADERS += recorder/ReaperProjectGenerator.h
+HEADERS += recorder/RecordingDiskWriter.h
+HEADERS += recorder/ChainedTrackIndex.h
 HEADERS += ninjam/protocol/ServerMessageParser.h
 HEADERS += ninjam/protocol/ServerMessages.h
 HEADERS += ninjam/protocol/ClientMessages.h
+HEADERS += ninjam/protocol/MessageFraming.h
 HEADERS += loginserver/natmap.h
 HEADERS += audio/codec.h
-HEADERS += audio/Resampler.h
 HEADERS += audio/vorbis/VorbisDecoder.h
 HEADERS += audio/vorbis/VorbisEncoder.h
 HEADERS += persistence/Settings.h
@@ -74,13 +76,15 @@ SOURCES += $$VST_SDK_PATH/public.sdk/source/vst2.x/audioeffectx.cpp
 SOURCES += $$VST_SDK_PATH/public.sdk/source/vst2.x/audioeffect.cpp
 SOURCES += recorder/JamRecorder.cpp
 SOURCES += recorder/ReaperProjectGenerator.cpp
+SOURCES += recorder/RecordingDiskWriter.cpp
+SOURCES += recorder/ChainedTrackIndex.cpp
 SOURCES += loginserver/LoginService.cpp
 SOURCES += loginserver/JsonUtils.cpp
 SOURCES += ninjam/protocol/ServerMessages.cpp
 SOURCES += ninjam/protocol/ClientMessages.cpp
 SOURCES += ninjam/protocol/ServerMessageParser.cpp
+SOURCES += ninjam/protocol/MessageFraming.cpp
 SOURCES += ninjam/Server.cpp
-SOURCES += audio/Resampler.cpp
 SOURCES += audio/vorbis/VorbisDecoder.cpp
 SOURCES += audio/samplesbufferrecorder.cpp
 SOURCES += audio/vorbis/VorbisEncoder.cpp
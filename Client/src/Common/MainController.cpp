@@ -6,6 +6,7 @@
 #include "Utils.h"
 #include "loginserver/natmap.h"
 #include "log/Logging.h"
+#include "audio/core/RtViolationDetector.h"
 
 using namespace Persistence;
 using namespace Midi;
@@ -18,6 +19,7 @@ MainController::MainController(Settings settings) :
     currentStreamingRoomID(-1000),
     mutex(QMutex::Recursive),
     started(false),
+    callbackTimes("Audio callback"),
     ipToLocationResolver(new Geo::WebIpToLocationResolver()),
     loginService(new Login::LoginService()),
     settings(settings),
@@ -43,15 +45,28 @@ void MainController::on_audioDriverStopped()
         finishUploads();// send the last interval part when audio driver is stopped
         ninjamController->reset();// discard downloaded intervals and reset interval position
     }
+    Audio::RtViolationDetector::logViolations();
+    audioMixer.logRenderTimes();
 }
 
 void MainController::finishUploads()
 {
+    Audio::RtCheckedMutexLocker locker(&uploadsMutex);
     foreach (int channelIndex, intervalsToUpload.keys())
         ninjamService.sendAudioIntervalPart(intervalsToUpload[channelIndex]->getGUID(),
                                             QByteArray(), true);
 }
 
+bool MainController::finishUpload(int channelIndex)
+{
+    Audio::RtCheckedMutexLocker locker(&uploadsMutex);
+    if (!intervalsToUpload.contains(channelIndex))
+        return false;
+    ninjamService.sendAudioIntervalPart(intervalsToUpload[channelIndex]->getGUID(), QByteArray(),
+                                        true);
+    return true;
+}
+
 void MainController::quitFromNinjamServer(QString error)
 {
     qCWarning(jtCore) << error;
@@ -74,12 +89,24 @@ void MainController::connectedNinjamServer(Ninjam::Server server)
 {
     qCDebug(jtCore) << "connected in ninjam server";
     stopNinjamController();
+
+    // the audio thread can't see the old controller when it is deleted
+    audioNinjamController.modify([](Controller::NinjamController *&controller) {
+        controller = nullptr;
+    });
     Controller::NinjamController *newNinjamController = createNinjamController(this);// new
     this->ninjamController.reset(newNinjamController);
+    audioNinjamController.modify([newNinjamController](Controller::NinjamController *&controller) {
+        controller = newNinjamController;
+    });
+    // the uploads are enqueued directly by the encoding thread, a GUI stall doesn't delay the uploads
     QObject::connect(newNinjamController,
                      SIGNAL(encodedAudioAvailableToSend(QByteArray, quint8, bool, bool)),
                      this, SLOT(enqueueAudioDataToUpload(QByteArray, quint8, bool,
-                                                         bool)));
+                                                         bool)), Qt::DirectConnection);
+    QObject::connect(newNinjamController,
+                     SIGNAL(encodedAudioAvailableToSend(QByteArray, quint8, bool, bool)),
+                     this, SLOT(recordLocalUserEncodedAudio(QByteArray, quint8, bool, bool)));
 
     QObject::connect(newNinjamController, SIGNAL(startingNewInterval()), this,
                      SLOT(on_newNinjamInterval()));
@@ -101,15 +128,19 @@ void MainController::connectedNinjamServer(Ninjam::Server server)
 
     newNinjamController->start(server, getXmitChannelsFlags());
 
-    if (settings.isSaveMultiTrackActivated())
+    if (settings.isSaveMultiTrackActivated()) {
+        jamRecorder.setOneFilePerTrack(settings.isRecordingOneFilePerTrack());
+        jamRecorder.setSyncPolicy(static_cast<Recorder::RecordingDiskWriter::SyncPolicy>(
+                                      settings.getRecordingDiskSyncPolicy()));
         jamRecorder.startRecording(getUserName(), QDir(settings.getRecordingPath()),
                                    server.getBpm(), server.getBpi(), getSampleRate());
+    }
 }
 
 QMap<int, bool> MainController::getXmitChannelsFlags() const
 {
     QMap<int, bool> xmitFlags;
-    foreach (Audio::LocalInputGroup *inputGroup, trackGroups)
+    foreach (Audio::LocalInputGroup *inputGroup, trackGroups.getCurrent())
         xmitFlags.insert(inputGroup->getIndex(), inputGroup->isTransmiting());
     return xmitFlags;
 }
@@ -137,17 +168,20 @@ void MainController::updateBpm(int newBpm)
 void MainController::enqueueAudioDataToUpload(QByteArray encodedAudio, quint8 channelIndex,
                                               bool isFirstPart, bool isLastPart)
 {
-    /** The audio thread fire this event. This thread (main/gui thread) write the encoded bytes in socket.
-     *  We can't write in the socket from audio thread.*/
+    /** Called by the encoding threads (one per channel). The messages are queued in the ninjam service send thread,
+     *  the socket is not used here.*/
+    Audio::RtCheckedMutexLocker locker(&uploadsMutex);
     if (isFirstPart) {
         if (intervalsToUpload.contains(channelIndex))
             delete intervalsToUpload[channelIndex];
         intervalsToUpload.insert(channelIndex, new UploadIntervalData());
+        // the codec is selected by the encoding threads, the stream headers are in the first part
         ninjamService.sendAudioIntervalBegin(
-            intervalsToUpload[channelIndex]->getGUID(), channelIndex);
+            intervalsToUpload[channelIndex]->getGUID(), channelIndex, uploadsUserName,
+            Audio::IntervalCodecs::detect(encodedAudio));
     }
-    if (intervalsToUpload[channelIndex]) {// just in case...
-        UploadIntervalData *upload = intervalsToUpload[channelIndex];
+    UploadIntervalData *upload = intervalsToUpload.value(channelIndex, nullptr);
+    if (upload) {// just in case...
         upload->appendData(encodedAudio);
         bool canSend = upload->getTotalBytes() >= 4096 || isLastPart;
         if (canSend) {
@@ -156,7 +190,11 @@ void MainController::enqueueAudioDataToUpload(QByteArray encodedAudio, quint8 ch
             upload->clear();
         }
     }
+}
 
+void MainController::recordLocalUserEncodedAudio(QByteArray encodedAudio, quint8 channelIndex,
+                                                 bool isFirstPart, bool isLastPart)
+{
     if (settings.isSaveMultiTrackActivated() && isPlayingInNinjamRoom())
         jamRecorder.appendLocalUserAudio(encodedAudio, channelIndex, isFirstPart, isLastPart);
 }
@@ -164,8 +202,8 @@ void MainController::enqueueAudioDataToUpload(QByteArray encodedAudio, quint8 ch
 // ++++++++++++++++++++
 int MainController::getMaxChannelsForEncodingInTrackGroup(uint trackGroupIndex) const
 {
-    if (trackGroups.contains(trackGroupIndex)) {
-        Audio::LocalInputGroup *group = trackGroups[trackGroupIndex];
+    if (trackGroups.getCurrent().contains(trackGroupIndex)) {
+        Audio::LocalInputGroup *group = trackGroups.getCurrent()[trackGroupIndex];
         if (group)
             return group->getMaxInputChannelsForEncoding();
     }
@@ -203,8 +241,10 @@ Geo::Location MainController::getGeoLocation(QString ip)
 // +++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void MainController::mixGroupedInputs(int groupIndex, Audio::SamplesBuffer &out)
 {
-    if (groupIndex >= 0 && groupIndex < trackGroups.size())
-        trackGroups[groupIndex]->mixGroupedInputs(out);
+    Audio::SnapshotPublisher<QMap<int, Audio::LocalInputGroup *> >::Reader groups(trackGroups);
+    Audio::LocalInputGroup *group = groups->value(groupIndex, nullptr);
+    if (group)
+        group->mixGroupedInputs(out);
 }
 
 // ++++++++++++++++++++++++
@@ -220,15 +260,20 @@ void MainController::saveEncodedAudio(QString userName, quint8 channelIndex,
 
 void MainController::removeInputTrackNode(int inputTrackIndex)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     if (inputTrackIndex >= 0 && inputTrackIndex < inputTracks.size()) {
         // remove from group
         Audio::LocalInputAudioNode *inputTrack = inputTracks[inputTrackIndex];
         int trackGroupIndex = inputTrack->getGroupChannelIndex();
-        if (trackGroups.contains(trackGroupIndex)) {
-            trackGroups[trackGroupIndex]->removeInput(inputTrack);
-            if (trackGroups[trackGroupIndex]->isEmpty())
-                trackGroups.remove(trackGroupIndex);
+        Audio::LocalInputGroup *group = trackGroups.getCurrent().value(trackGroupIndex, nullptr);
+        if (group) {
+            group->removeInput(inputTrack);
+            if (group->isEmpty()) {
+                trackGroups.modify([trackGroupIndex](QMap<int, Audio::LocalInputGroup *> &groups) {
+                    groups.remove(trackGroupIndex);
+                });
+                delete group;
+            }
         }
 
         inputTracks.removeAt(inputTrackIndex);
@@ -243,11 +288,14 @@ int MainController::addInputTrackNode(Audio::LocalInputAudioNode *inputTrackNode
     addTrack(inputTrackID, inputTrackNode);
 
     int trackGroupIndex = inputTrackNode->getGroupChannelIndex();
-    if (!trackGroups.contains(trackGroupIndex))
-        trackGroups.insert(trackGroupIndex,
-                           new Audio::LocalInputGroup(trackGroupIndex, inputTrackNode));
-    else
-        trackGroups[trackGroupIndex]->addInput(inputTrackNode);
+    if (!trackGroups.getCurrent().contains(trackGroupIndex)) {
+        Audio::LocalInputGroup *newGroup = new Audio::LocalInputGroup(trackGroupIndex, inputTrackNode);
+        trackGroups.modify([trackGroupIndex, newGroup](QMap<int, Audio::LocalInputGroup *> &groups) {
+            groups.insert(trackGroupIndex, newGroup);
+        });
+    } else {
+        trackGroups.getCurrent()[trackGroupIndex]->addInput(inputTrackNode);
+    }
 
     return inputTrackID;
 }
@@ -270,8 +318,11 @@ Audio::AudioNode *MainController::getTrackNode(long ID)
 
 bool MainController::addTrack(long trackID, Audio::AudioNode *trackNode)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
 
+    if (trackNode->getProfileName().isEmpty())
+        trackNode->setProfileName(QString(trackNode->metaObject()->className()) + " "
+                                  + QString::number(trackID));
     tracksNodes.insert(trackID, trackNode);
     audioMixer.addNode(trackNode);
     return true;
@@ -309,6 +360,19 @@ void MainController::storeIntervalProgressShape(int shape)
     settings.setIntervalProgressShape(shape);
 }
 
+void MainController::setRenderThreads(int renderThreads)
+{
+    settings.setRenderThreads(renderThreads);
+    audioMixer.setRenderThreads(renderThreads);
+}
+
+void MainController::setOpusEncodingPreferred(bool preferOpus)
+{
+    settings.setOpusEncodingPreferred(preferOpus);
+    if (ninjamController)
+        ninjamController->updateUploadCodec();
+}
+
 void MainController::storeWindowSettings(bool maximized, bool usingFullViewMode, QPointF location)
 {
     settings.setWindowSettings(maximized, usingFullViewMode, location);
@@ -327,7 +391,7 @@ void MainController::storeIOSettings(int firstIn, int lastIn, int firstOut, int
 
 void MainController::removeTrack(long trackID)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     /** remove Track is called from ninjam service thread, and cause a crash if the process callback (audio Thread) is iterating over tracksNodes to render audio */
 
     Audio::AudioNode *trackNode = tracksNodes[trackID];
@@ -342,30 +406,69 @@ void MainController::removeTrack(long trackID)
 void MainController::doAudioProcess(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out,
                                     int sampleRate)
 {
-    audioMixer.process(in, out, sampleRate, pullMidiBuffer());
+    audioMixer.process(in, out, sampleRate, pullMidiBuffer(out.getFrameLenght(), sampleRate));
 
-    out.applyGain(masterGain, 1.0f);// using 1 as boost factor/multiplier (no boost)
-    masterPeak.update(out.computePeak());
+    masterPeak.update(out.applyGainAndComputePeak(masterGain, 1.0f));// using 1 as boost factor/multiplier (no boost)
 }
 
+/** called from the audio thread. No locks here, the tracks, groups and the ninjam controller are
+    read from the published snapshots (see Audio::SnapshotPublisher) */
 void MainController::process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out,
                              int sampleRate)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtViolationDetector::AudioThreadScope audioThreadScope;
+    Audio::ProfileScope profileScope(callbackTimes,
+                                     Audio::DspProfiler::getBudget(out.getFrameLenght(), sampleRate));
     if (!started)
         return;
 
-    if (!isPlayingInNinjamRoom()) {
+    Audio::SnapshotPublisher<SamplesBufferRecorder *>::Reader recorder(audioInputRecorder);
+    if (*recorder)
+        (*recorder)->addSamples(in);
+
+    Audio::SnapshotPublisher<Controller::NinjamController *>::Reader controller(
+        audioNinjamController);
+    if (*controller && (*controller)->isRunning())
+        (*controller)->process(in, out, sampleRate);
+    else
         doAudioProcess(in, out, sampleRate);
-    } else {
-        if (ninjamController)
-            ninjamController->process(in, out, sampleRate);
+}
+
+bool MainController::startInputRecording(const QString &filePath, int bitsPerSample, bool dither)
+{
+    stopInputRecording();
+    SamplesBufferRecorder *recorder = new SamplesBufferRecorder(filePath, getSampleRate(), 2,
+                                                                bitsPerSample, dither);
+    if (!recorder->isRecording()) {
+        delete recorder;
+        return false;
+    }
+    inputRecorder.reset(recorder);
+    audioInputRecorder.modify([recorder](SamplesBufferRecorder *&audioRecorder) {
+        audioRecorder = recorder;
+    });
+    return true;
+}
+
+void MainController::stopInputRecording()
+{
+    if (!inputRecorder)
+        return;
+
+    // the audio thread can't see the recorder when it is deleted
+    audioInputRecorder.modify([](SamplesBufferRecorder *&audioRecorder) {
+        audioRecorder = nullptr;
+    });
+    if (inputRecorder->getDroppedFrames() > 0) {
+        qCWarning(jtCore) << "The disk was slow," << inputRecorder->getDroppedFrames()
+                          << "recorded frames were dropped";
     }
+    inputRecorder.reset();// the buffered samples are written
 }
 
 Audio::AudioPeak MainController::getTrackPeak(int trackID)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     Audio::AudioNode *trackNode = tracksNodes[trackID];
     if (trackNode && !trackNode->isMuted())
         return trackNode->getLastPeak();
@@ -382,19 +485,19 @@ Audio::AudioPeak MainController::getRoomStreamPeak()
 // ++++++++++++++ XMIT +++++++++
 void MainController::setTransmitingStatus(int channelID, bool transmiting)
 {
-    if (trackGroups.contains(channelID)) {
-        if (trackGroups[channelID]->isTransmiting() != transmiting) {
-            trackGroups[channelID]->setTransmitingStatus(transmiting);
-            if (isPlayingInNinjamRoom())
-                ninjamController->setTransmitStatus(channelID, transmiting);
-        }
+    Audio::LocalInputGroup *group = trackGroups.getCurrent().value(channelID, nullptr);
+    if (group) {
+        if (group->isTransmiting() != transmiting)
+            group->setTransmitingStatus(transmiting);// read by the audio thread in the next block
     }
 }
 
 bool MainController::isTransmiting(int channelID) const
 {
-    if (trackGroups.contains(channelID))
-        return trackGroups[channelID]->isTransmiting();
+    Audio::SnapshotPublisher<QMap<int, Audio::LocalInputGroup *> >::Reader groups(trackGroups);
+    Audio::LocalInputGroup *group = groups->value(channelID, nullptr);
+    if (group)
+        return group->isTransmiting();
     return false;
 }
 
@@ -483,17 +586,21 @@ MainController::~MainController()
         mainWindow->detachMainController();
 
     stop();
+    stopInputRecording();
     qCDebug(jtCore()) << "main controller stopped!";
 
     qCDebug(jtCore()) << "cleaning tracksNodes...";
+    // unpublished first, modify() waits until the audio thread can't see the groups and inputs
+    QList<Audio::LocalInputGroup *> groups = trackGroups.getCurrent().values();
+    trackGroups.modify([](QMap<int, Audio::LocalInputGroup *> &groups) {
+        groups.clear();
+    });
+    qDeleteAll(groups);
+
     tracksNodes.clear();
     foreach (Audio::LocalInputAudioNode *input, inputTracks)
         delete input;
     inputTracks.clear();
-
-    foreach (Audio::LocalInputGroup *group, trackGroups)
-        delete group;
-    trackGroups.clear();
     qCDebug(jtCore()) << "cleaning tracksNodes done!";
 
     qCDebug(jtCore) << "MainController destructor finished!";
@@ -600,6 +707,12 @@ void MainController::tryConnectInNinjamServer(Login::RoomInfo ninjamRoom, QStrin
         int serverPort = ninjamRoom.getPort();
         QString userName = getUserName();
         QString pass = (password.isNull() || password.isEmpty()) ? "" : password;
+        {
+            // the intervals are uploaded by the encoding threads, the name is not read from
+            // the service or the settings there
+            Audio::RtCheckedMutexLocker locker(&uploadsMutex);
+            uploadsUserName = userName;
+        }
 
         this->ninjamService.startServerConnection(serverIp, serverPort, userName, channelsNames,
                                                   pass);
@@ -615,8 +728,9 @@ void MainController::start()
         pluginFinder.reset(createPluginFinder());
 
         qCInfo(jtCore) << "Creating roomStreamer ...";
-        roomStreamer.reset(new Audio::NinjamRoomStreamerNode()); // new Audio::AudioFileStreamerNode(":/teste.mp3");
+        roomStreamer.reset(new Audio::NinjamRoomStreamerNode());
         this->audioMixer.addNode(roomStreamer.data());
+        this->audioMixer.setRenderThreads(settings.getRenderThreads());
 
         QObject::connect(&ninjamService, SIGNAL(connectedInServer(Ninjam::Server)), this,
                          SLOT(connectedNinjamServer(Ninjam::Server)));
@@ -625,24 +739,29 @@ void MainController::start()
         QObject::connect(&ninjamService, SIGNAL(error(QString)), this,
                          SLOT(quitFromNinjamServer(QString)));
 
-        NatMap map;// not used yet,will be used in future to real time rooms
-
-        // connect with login server and receive a list of public rooms to play
-        QString userEnvironment = getUserEnvironmentString();
-        QString version = QApplication::applicationVersion();// applicationVersion();
-        QString userName = settings.getUserName();
-        if (userName.isEmpty())
-            userName = "No name!";
-
-        qCInfo(jtCore) << "Connecting in Jamtaba server...";
-        loginService.connectInServer(userName, 0, "", map, version, userEnvironment,
-                                     getSampleRate());
+        connectInLoginServer();
 
-        qInfo() << "Starting " + userEnvironment;
+        qInfo() << "Starting " + getUserEnvironmentString();
         started = true;
     }
 }
 
+void MainController::connectInLoginServer()
+{
+    NatMap map;// not used yet,will be used in future to real time rooms
+
+    // connect with login server and receive a list of public rooms to play
+    QString userEnvironment = getUserEnvironmentString();
+    QString version = QApplication::applicationVersion();// applicationVersion();
+    QString userName = settings.getUserName();
+    if (userName.isEmpty())
+        userName = "No name!";
+
+    qCInfo(jtCore) << "Connecting in Jamtaba server...";
+    loginService.connectInServer(userName, 0, "", map, version, userEnvironment,
+                                 getSampleRate());
+}
+
 QString MainController::getUserEnvironmentString() const
 {
     QString systemName = QSysInfo::prettyProductName();
@@ -720,7 +839,7 @@ Audio::Plugin *MainController::addPlugin(int inputTrackIndex,
     Audio::Plugin *plugin = createPluginInstance(descriptor);
     if (plugin) {
         plugin->start();
-        QMutexLocker locker(&mutex);
+        Audio::RtCheckedMutexLocker locker(&mutex);
         getInputTrack(inputTrackIndex)->addProcessor(plugin);
     }
     return plugin;
@@ -728,7 +847,7 @@ Audio::Plugin *MainController::addPlugin(int inputTrackIndex,
 
 void MainController::removePlugin(int inputTrackIndex, Audio::Plugin *plugin)
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     QString pluginName = plugin->getName();
     try{
         getInputTrack(inputTrackIndex)->removeProcessor(plugin);
@@ -767,7 +886,7 @@ bool MainController::isPlayingInNinjamRoom() const
 
 void MainController::stopNinjamController()
 {
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     if (ninjamController && ninjamController->isRunning())
         ninjamController->stop(true);
 }
@@ -14,6 +14,7 @@
 #include "audio/vst/PluginFinder.h"
 #include "audio/core/AudioMixer.h"
 #include "audio/RoomStreamerNode.h"
+#include "audio/SamplesBufferRecorder.h"
 #include "audio/core/PluginDescriptor.h"
 #include "midi/MidiDriver.h"
 #include "UploadIntervalData.h"
@@ -113,7 +114,7 @@ public:
     Audio::AudioPeak getTrackPeak(int trackID);
     inline Audio::AudioPeak getMasterPeak()
     {
-        return masterPeak;
+        return masterPeak.get();
     }
 
     inline float getMasterGain() const
@@ -123,6 +124,14 @@ public:
 
     void setMasterGain(float newGain);
 
+    // the audio input is recorded in a WAV or FLAC file without blocking the audio thread
+    bool startInputRecording(const QString &filePath, int bitsPerSample = 24, bool dither = true);
+    void stopInputRecording();
+    inline bool isRecordingInput() const
+    {
+        return !inputRecorder.isNull();
+    }
+
     Audio::AudioNode *getTrackNode(long ID);
 
     inline bool isStarted() const
@@ -143,7 +152,7 @@ public:
 
     int getInputTrackGroupsCount() const
     {
-        return trackGroups.size();// return the track groups (channels) count
+        return trackGroups.getCurrent().size();// return the track groups (channels) count
     }
 
     void mixGroupedInputs(int groupIndex, Audio::SamplesBuffer &out);
@@ -160,6 +169,8 @@ public:
     // store settings
     void storeMetronomeSettings(float metronomeGain, float metronomePan, bool metronomeMuted);
     void storeIntervalProgressShape(int shape);
+    void setRenderThreads(int renderThreads);// zero to render all tracks in the audio thread
+    void setOpusEncodingPreferred(bool preferOpus);// opus is used only if all users in the room can decode it
 
     void storeWindowSettings(bool maximized, bool usingFullViewMode, QPointF location);
     void storeIOSettings(int firstIn, int lastIn, int firstOut, int lastOut, int audioDevice,
@@ -217,6 +228,7 @@ public:
     virtual void scanPlugins(bool scanOnlyNewPlugins = false) = 0;
 
     void finishUploads();// used to send the last part of ninjam intervals when audio is stopped.
+    bool finishUpload(int channelIndex);// return false if the channel is not uploading
 
     virtual QString getUserEnvironmentString() const;
 
@@ -256,10 +268,15 @@ protected:
 
     virtual void setCSS(QString css) = 0;
 
-    virtual Midi::MidiBuffer pullMidiBuffer() = 0;
+    // audio thread, the MIDI messages received since the last block (see MidiDriver::fillBuffer())
+    virtual const Midi::MidiBuffer &pullMidiBuffer(int frames, int sampleRate) = 0;
+
+    virtual void connectInLoginServer();// called by start(), receive the public rooms list
 
     // map the input channel indexes to a GUID (used to upload audio to ninjam server)
     QMap<int, UploadIntervalData *> intervalsToUpload;
+    QMutex uploadsMutex;// the uploads are enqueued by the encoding threads
+    QString uploadsUserName;// protected by 'uploadsMutex', the name used in the current server
 
     QMutex mutex;
 
@@ -272,13 +289,20 @@ private:
     QScopedPointer<Audio::AbstractMp3Streamer> roomStreamer;
     long long currentStreamingRoomID;
 
-    QMap<int, Audio::LocalInputGroup *> trackGroups;
+    Audio::SnapshotPublisher<QMap<int, Audio::LocalInputGroup *> > trackGroups;
+
+    // the ninjam controller used by the audio thread, changed only when a controller is created
+    Audio::SnapshotPublisher<Controller::NinjamController *> audioNinjamController;
+
+    QScopedPointer<SamplesBufferRecorder> inputRecorder;
+    Audio::SnapshotPublisher<SamplesBufferRecorder *> audioInputRecorder;// used by the audio thread
 
     QMap<int, bool> getXmitChannelsFlags() const;
 
     QMap<long, Audio::AudioNode *> tracksNodes;
 
     bool started;
+    Audio::ProfileHistogram callbackTimes;// time used in each audio callback vs the callback deadline
 
     void tryConnectInNinjamServer(Login::RoomInfo ninjamRoom, QStringList channels,
                                   QString password = "");
@@ -291,7 +315,7 @@ private:
 
     // master
     float masterGain;
-    Audio::AudioPeak masterPeak;
+    Audio::AtomicAudioPeak masterPeak;
 
     Persistence::UsersDataCache usersDataCache;
 
@@ -303,6 +327,8 @@ protected slots:
     virtual void quitFromNinjamServer(QString error);
     virtual void enqueueAudioDataToUpload(QByteArray, quint8 channelIndex,
                                           bool isFirstPart, bool isLastPart);
+    virtual void recordLocalUserEncodedAudio(QByteArray, quint8 channelIndex, bool isFirstPart,
+                                             bool isLastPart);
     virtual void updateBpi(int newBpi);
     virtual void updateBpm(int newBpm);
 
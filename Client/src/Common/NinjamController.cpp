@@ -9,173 +9,26 @@
 #include "audio/core/SamplesBuffer.h"
 #include "gui/NinjamRoomWindow.h"
 #include "audio/NinjamTrackNode.h"
+#include "audio/NinjamIntervalDecoder.h"
+#include "audio/NinjamIntervalEncoder.h"
 #include "persistence/Settings.h"
 #include "audio/MetronomeTrackNode.h"
+#include "audio/AudioFilePlayerNode.h"
 #include "audio/vst/vsthost.h"
 
 #include <cmath>
 #include <cassert>
-#include <QMutexLocker>
 #include <QDebug>
 #include <QThread>
 
 #include "audio/SamplesBufferRecorder.h"
 #include "Utils.h"
-#include <QWaitCondition>
 #include "log/Logging.h"
+#include "audio/core/RtViolationDetector.h"
 
 
 using namespace Controller;
 
-//+++++++++++++  ENCODING THREAD  +++++++++++++
-class NinjamController::EncodingThread : public QThread{//TODO: use better thread approach, avoid inheritance form QThread
-public:
-    EncodingThread(NinjamController* controller)
-        :stopRequested(false), controller(controller){
-        qCDebug(jtNinjamCore) << "Starting Encoding Thread";
-        start();
-    }
-
-    ~EncodingThread(){
-        stop();
-    }
-
-    void addSamplesToEncode(const Audio::SamplesBuffer& samplesToEncode, quint8 channelIndex, bool isFirstPart, bool isLastPart){
-        //qCDebug(jtNinjamCore) << "Adding samples to encode";
-        QMutexLocker locker(&mutex);
-        chunksToEncode.append(new EncodingChunk(samplesToEncode, channelIndex, isFirstPart, isLastPart));
-        //this method is called by Qt main thread (the producer thread).
-        hasAvailableChunksToEncode.wakeAll();//wakeup the encoding thread (consumer thread)
-
-    }
-
-    void stop(){
-        if(!stopRequested){
-            //QMutexLocker locker(&mutex);
-            stopRequested = true;
-            hasAvailableChunksToEncode.wakeAll();
-            qCDebug(jtNinjamCore) << "Stopping Encoding Thread";
-        }
-    }
-
-protected:
-    void run(){
-        while(!stopRequested){
-            mutex.lock();
-            if(chunksToEncode.isEmpty()){
-                hasAvailableChunksToEncode.wait(&mutex);
-            }
-            if(stopRequested){
-                mutex.unlock();
-                break;
-            }
-            EncodingChunk* chunk = chunksToEncode.first();
-            chunksToEncode.removeFirst();
-            mutex.unlock();
-			if (chunk){
-                QByteArray encodedBytes( controller->encode(chunk->buffer, chunk->channelIndex));
-                if (chunk->lastPart){
-                    encodedBytes.append( controller->encodeLastPartOfInterval(chunk->channelIndex));
-                }
-
-                if(!encodedBytes.isEmpty()){
-                    emit controller->encodedAudioAvailableToSend(encodedBytes, chunk->channelIndex, chunk->firstPart, chunk->lastPart);
-                }
-				delete chunk;
-			}
-
-        }
-        qCDebug(jtNinjamCore) << "Encoding thread stopped!";
-    }
-
-private:
-    class EncodingChunk{
-    public:
-        EncodingChunk(const Audio::SamplesBuffer& buffer, quint8 channelIndex, bool firstPart, bool lastPart)
-            :buffer(buffer), channelIndex(channelIndex), firstPart(firstPart), lastPart(lastPart ) {
-
-        }
-
-        Audio::SamplesBuffer buffer;
-        quint8 channelIndex;
-        bool firstPart;
-        bool lastPart;
-    };
-
-    QList<EncodingChunk*> chunksToEncode;
-    QMutex mutex;
-    volatile bool stopRequested;
-    NinjamController* controller;
-    QWaitCondition hasAvailableChunksToEncode;
-
-};
-
-//+++++++++++++++++ Nested classes to handle schedulable events ++++++++++++++++
-
-class NinjamController::SchedulableEvent{//an event scheduled to be processed in next interval
-public:
-    SchedulableEvent(NinjamController* controller)
-        :controller(controller){}
-    virtual void process() = 0;
-    virtual ~SchedulableEvent(){}
-protected:
-    NinjamController* controller;
-};
-//++++++++++++++++++++++++++++++++++++++++++++
-class NinjamController::BpiChangeEvent : public SchedulableEvent{
-public:
-    BpiChangeEvent(NinjamController* controller, int newBpi)
-        :SchedulableEvent(controller), newBpi(newBpi){
-
-    }
-    void process(){
-        controller->currentBpi = newBpi;
-        controller->samplesInInterval = controller->computeTotalSamplesInInterval();
-        emit controller->currentBpiChanged(controller->currentBpi);
-    }
-private:
-    int newBpi;
-
-};
-//+++++++++++++++++++++++++++++++++++++++++
-class NinjamController::BpmChangeEvent : public SchedulableEvent{
-public:
-    BpmChangeEvent(NinjamController* controller, int newBpm)
-        :SchedulableEvent(controller), newBpm(newBpm){}
-    void process(){
-        controller->setBpm(newBpm);
-    }
-private:
-    int newBpm;
-
-};
-//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-class NinjamController::InputChannelChangedEvent : public SchedulableEvent{
-    public:
-        InputChannelChangedEvent(NinjamController* controller, int channelIndex)
-            :SchedulableEvent(controller), channelIndex(channelIndex){}
-        void process(){
-            controller->recreateEncoderForChannel(channelIndex);
-        }
-    private:
-        int channelIndex;
-};
-//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-class NinjamController::XmitChangedEvent : public SchedulableEvent{
-public:
-    XmitChangedEvent(NinjamController* controller, int channelID, bool transmiting)
-        : SchedulableEvent(controller), transmiting(transmiting), channelID(channelID) {
-
-    }
-    void process(){
-        controller->setTransmitStatus(channelID, transmiting);
-    }
-
-private:
-    bool transmiting;
-    int channelID;
-};
-
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 NinjamController::NinjamController(Controller::MainController* mainController)
     :mainController(mainController),
@@ -186,56 +39,102 @@ NinjamController::NinjamController(Controller::MainController* mainController)
     currentBpi(0),
     currentBpm(0),
     mutex(QMutex::Recursive),
-    encodersMutex(QMutex::Recursive),
-    encodingThread(nullptr),
+    scheduledChanges(MAX_SCHEDULED_CHANGES),
+    audioEvents(MAX_AUDIO_EVENTS),
+    processingIntervalPosition(-1),
+    decodingThread(nullptr),
+    uploadCodec(Audio::IntervalCodec::VORBIS),
     preparedForTransmit(false),
-    waitingIntervals(0)//waiting for start transmit
+    waitingIntervals(0),//waiting for start transmit
+    processTimes("Ninjam controller")
 {
     running = false;
+    setAudioFormat(2, 2, DEFAULT_MAX_FRAMES);// replaced when the audio driver is configured
 
-}
-
-//++++++++++++++++++++++++++
-void NinjamController::setBpm(int newBpm){
-    currentBpm = newBpm;
-    samplesInInterval = computeTotalSamplesInInterval();
-    metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
+    QObject::connect(&audioEventsTimer, SIGNAL(timeout()), this, SLOT(emitAudioEvents()));
 
-    emit currentBpmChanged(currentBpm);
+    //user metronome sounds
+    const Persistence::Settings &settings = mainController->getSettings();
+    QString soundFiles[] = {settings.getMetronomeClickFile(), settings.getMetronomeMeasureAccentFile(), settings.getMetronomeIntervalAccentFile()};
+    Audio::MetronomeSoundBank::Sound sounds[] = {Audio::MetronomeSoundBank::CLICK, Audio::MetronomeSoundBank::MEASURE_ACCENT, Audio::MetronomeSoundBank::INTERVAL_ACCENT};
+    for (int i = 0; i < 3; ++i) {
+        if(!soundFiles[i].isEmpty()){
+            setMetronomeSoundFile(sounds[i], soundFiles[i]);
+        }
+    }
 }
 
+//++++++++++++++++++++++++++
 void NinjamController::removeEncoder(int groupChannelIndex){
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     if(encoders.contains(groupChannelIndex)){
-        encoders.remove(groupChannelIndex);
+        audioEncoders.modify([groupChannelIndex](QMap<int, NinjamIntervalEncoder *> &audioEncoders){
+            audioEncoders.remove(groupChannelIndex);
+        });
+        delete encoders.take(groupChannelIndex);//not used by the audio thread after modify()
     }
 }
 
+void NinjamController::createEncoder(int channelIndex){
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    if(encoders.contains(channelIndex)){
+        return;
+    }
+    NinjamIntervalEncoder* encoder = new NinjamIntervalEncoder(channelIndex);
+    encoder->setCodec(uploadCodec);
+    //emitted in the encoder thread, the encoded intervals are queued in the ninjam service send thread
+    QObject::connect(encoder, SIGNAL(encodedAudioAvailable(QByteArray,quint8,bool,bool)), this, SIGNAL(encodedAudioAvailableToSend(QByteArray,quint8,bool,bool)), Qt::DirectConnection);
+    encoders.insert(channelIndex, encoder);
+    audioEncoders.modify([channelIndex, encoder](QMap<int, NinjamIntervalEncoder *> &audioEncoders){
+        audioEncoders.insert(channelIndex, encoder);
+    });
+}
+
+void NinjamController::deleteEncoders(){
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    audioEncoders.modify([](QMap<int, NinjamIntervalEncoder *> &audioEncoders){
+        audioEncoders.clear();
+    });
+    qDeleteAll(encoders);//stop and wait the encoding threads
+    encoders.clear();
+}
+
 //+++++++++++++++++++++++++ THE MAIN LOGIC IS HERE  ++++++++++++++++++++++++++++++++++++++++++++++++
+//the audio thread never lock the controller mutex, the tracks are read from published snapshots
 void NinjamController::process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out, int sampleRate){
+    Audio::ProfileScope profileScope(processTimes);
 
-    QMutexLocker locker(&mutex);
     if(!running || samplesInInterval <= 0){
         return;//not initialized
     }
 
+    //the temp buffers are allocated in the main thread (see setAudioFormat())
+    Audio::SnapshotPublisher<ProcessBuffers *>::Reader currentBuffers(audioProcessBuffers);
+    ProcessBuffers *buffers = *currentBuffers;
+    if(buffers->in.getChannels() != in.getChannels() || buffers->out.getChannels() != out.getChannels()){
+        return;//the audio driver was just restarted, the buffers for the new format are not published yet
+    }
+    Audio::SamplesBuffer &tempInBuffer = buffers->in;
+    Audio::SamplesBuffer &tempOutBuffer = buffers->out;
+    Audio::SamplesBuffer &inputMixBuffer = buffers->inputMix;
+
     int totalSamplesToProcess = out.getFrameLenght();
     int samplesProcessed = 0;
 
     int offset = 0;
 
     do{
-        emit startProcessing(intervalPosition);//vst host time line is updated with this event
+        processingIntervalPosition.store(intervalPosition);//vst host time line is updated with this position
 
         int samplesToProcessInThisStep = (std::min)((int)(samplesInInterval - intervalPosition), totalSamplesToProcess - offset);
+        samplesToProcessInThisStep = (std::min)(samplesToProcessInThisStep, buffers->maxFrames);
 
         assert(samplesToProcessInThisStep);
 
-        static Audio::SamplesBuffer tempOutBuffer(out.getChannels(), samplesToProcessInThisStep);
         tempOutBuffer.setFrameLenght(samplesToProcessInThisStep);
         tempOutBuffer.zero();
 
-        Audio::SamplesBuffer tempInBuffer(in.getChannels(), samplesToProcessInThisStep);
+        tempInBuffer.setFrameLenght(samplesToProcessInThisStep);
         tempInBuffer.set(in, offset, samplesToProcessInThisStep, 0);
 
         bool newInterval = intervalPosition == 0;
@@ -247,13 +146,16 @@ void NinjamController::process(const Audio::SamplesBuffer &in, Audio::SamplesBuf
         int currentBeat = intervalPosition / getSamplesPerBeat();
         if(currentBeat != lastBeat){
             lastBeat = currentBeat;
-            emit intervalBeatChanged(currentBeat);
+            postAudioEvent(AudioEvent::BEAT_CHANGED, currentBeat);
         }
 
         //+++++++++++ MAIN AUDIO OUTPUT PROCESS +++++++++++++++
         bool isLastPart = intervalPosition + samplesToProcessInThisStep >= samplesInInterval;
-        foreach (NinjamTrackNode* track, trackNodes) {
-            track->setProcessingLastPartOfInterval(isLastPart);//TODO resampler still need a flag indicating the last part?
+        {
+            Audio::SnapshotPublisher<QList<NinjamTrackNode *> >::Reader tracks(audioTrackNodes);
+            for (NinjamTrackNode* track : *tracks) {
+                track->setProcessingLastPartOfInterval(isLastPart);//TODO resampler still need a flag indicating the last part?
+            }
         }
         mainController->doAudioProcess(tempInBuffer, tempOutBuffer, sampleRate);
         out.add(tempOutBuffer, offset); //generate audio output
@@ -262,20 +164,26 @@ void NinjamController::process(const Audio::SamplesBuffer &in, Audio::SamplesBuf
         if(preparedForTransmit){
             //1) mix input subchannels, 2) encode and 3) send the encoded audio
             bool isFirstPart = intervalPosition == 0;
-            int groupedChannels = mainController->getInputTrackGroupsCount();
-            for (int groupIndex = 0; groupIndex < groupedChannels; ++groupIndex) {
-                if(mainController->isTransmiting(groupIndex)){
-                    int channels = mainController->getMaxChannelsForEncodingInTrackGroup(groupIndex);
-                    if(channels > 0){
-                        Audio::SamplesBuffer inputMixBuffer(channels, samplesToProcessInThisStep);
-
-                        if(encoders.contains(groupIndex)){
-                            inputMixBuffer.zero();
-                            mainController->mixGroupedInputs(groupIndex, inputMixBuffer);
-
-                            //encoding is running in another thread to avoid slow down the audio thread
-                            encodingThread->addSamplesToEncode( inputMixBuffer, groupIndex, isFirstPart, isLastPart);
+            Audio::SnapshotPublisher<QMap<int, Audio::LocalInputGroup *> >::Reader groups(mainController->trackGroups);
+            Audio::SnapshotPublisher<QMap<int, NinjamIntervalEncoder *> >::Reader groupEncoders(audioEncoders);
+            for (Audio::LocalInputGroup* group : *groups) {
+                int groupIndex = group->getIndex();
+                if(group->isTransmiting()){
+                    int channels = group->getMaxInputChannelsForEncoding();
+                    NinjamIntervalEncoder* encoder = groupEncoders->value(groupIndex, nullptr);
+                    if(channels > 0 && encoder){
+                        if(channels == 1){
+                            inputMixBuffer.setToMono();
+                        }
+                        else{
+                            inputMixBuffer.setToStereo();
                         }
+                        inputMixBuffer.setFrameLenght(samplesToProcessInThisStep);
+                        inputMixBuffer.zero();
+                        group->mixGroupedInputs(inputMixBuffer);
+
+                        //copied to the encoder PCM blocks, each channel is encoded in its own thread
+                        encoder->addSamples(inputMixBuffer, sampleRate, isFirstPart, isLastPart);
                     }
                 }
             }
@@ -288,9 +196,30 @@ void NinjamController::process(const Audio::SamplesBuffer &in, Audio::SamplesBuf
     }
     while( samplesProcessed < totalSamplesToProcess);
 }
+
+NinjamController::ProcessBuffers::ProcessBuffers(int inputChannels, int outputChannels, int maxFrames)
+    : in(inputChannels, maxFrames),
+      out(outputChannels, maxFrames),
+      inputMix(2, maxFrames),
+      maxFrames(maxFrames)
+{
+}
+
+void NinjamController::setAudioFormat(int inputChannels, int outputChannels, int maxFrames){
+    maxFrames = std::max(maxFrames, (int)DEFAULT_MAX_FRAMES);
+    if(processBuffers && processBuffers->in.getChannels() == inputChannels
+            && processBuffers->out.getChannels() == outputChannels && processBuffers->maxFrames >= maxFrames){
+        return;
+    }
+    ProcessBuffers *newBuffers = new ProcessBuffers(inputChannels, outputChannels, maxFrames);
+    audioProcessBuffers.modify([newBuffers](ProcessBuffers *&buffers){
+        buffers = newBuffers;
+    });
+    processBuffers.reset(newBuffers);//the audio thread can't see the old buffers
+}
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 Audio::MetronomeTrackNode* NinjamController::createMetronomeTrackNode(int sampleRate){
-    return new Audio::MetronomeTrackNode(":/click.wav", sampleRate);
+    return new Audio::MetronomeTrackNode(sampleRate);
 }
 
 //+++++++++++++++
@@ -298,6 +227,7 @@ Audio::MetronomeTrackNode* NinjamController::createMetronomeTrackNode(int sample
 void NinjamController::stop(bool emitDisconnectedingSignal){
     if(isRunning()){
         this->running = false;
+        audioEventsTimer.stop();
 
         //store metronome settings
         Audio::AudioNode* metronomeTrack = mainController->getTrackNode(METRONOME_TRACK_ID);
@@ -308,6 +238,9 @@ void NinjamController::stop(bool emitDisconnectedingSignal){
             mainController->removeTrack(METRONOME_TRACK_ID);//remove metronome
         }
         //clear all tracks
+        audioTrackNodes.modify([](QList<NinjamTrackNode *> &tracks){
+            tracks.clear();
+        });
         foreach(NinjamTrackNode* trackNode, trackNodes.values()){
             mainController->removeTrack(trackNode->getID());
             //trackNode->deactivate();
@@ -315,30 +248,26 @@ void NinjamController::stop(bool emitDisconnectedingSignal){
         trackNodes.clear();
     }
 
-    if(encodingThread){
-        encodingThread->stop();
-        encodingThread->wait();//wait the encoding thread to finish
-        delete encodingThread;
-        encodingThread = nullptr;
+    if(decodingThread){//the ninjam tracks are already deleted
+        delete decodingThread;//stop and wait the thread
+        decodingThread = nullptr;
     }
+    intervalsToRecord.clear();
+    usersDecodingOpus.clear();
 
-    foreach (VorbisEncoder* encoder, encoders.values()) {
-        delete encoder;
-    }
-    encoders.clear();
+    deleteEncoders();
 
     qCDebug(jtNinjamCore) << "NinjamController destructor - disconnecting...";
 
     Ninjam::Service* ninjamService = mainController->getNinjamService();// Ninjam::Service::getInstance();
     QObject::disconnect(ninjamService, SIGNAL(serverBpmChanged(short)), this, SLOT(on_ninjamServerBpmChanged(short)));
     QObject::disconnect(ninjamService, SIGNAL(serverBpiChanged(short,short)), this, SLOT(on_ninjamServerBpiChanged(short,short)));
-    QObject::disconnect(ninjamService, SIGNAL(audioIntervalCompleted(Ninjam::User,int,QByteArray)), this, SLOT(on_ninjamAudiointervalCompleted(Ninjam::User,int,QByteArray)));
+    QObject::disconnect(ninjamService, SIGNAL(audioIntervalChunkDownloaded(Ninjam::User,int,QByteArray,bool,bool)), this, SLOT(on_ninjamAudioIntervalChunkDownloaded(Ninjam::User,int,QByteArray,bool,bool)));
     //QObject::disconnect(ninjamService, SIGNAL(disconnectedFromServer(Ninjam::Server)), this, SLOT(on_ninjamDisconnectedFromServer(Ninjam::Server)));
 
     QObject::disconnect(ninjamService, SIGNAL(userChannelCreated(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelCreated(Ninjam::User, Ninjam::UserChannel)));
     QObject::disconnect(ninjamService, SIGNAL(userChannelRemoved(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelRemoved(Ninjam::User, Ninjam::UserChannel)));
     QObject::disconnect(ninjamService, SIGNAL(userChannelUpdated(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelUpdated(Ninjam::User, Ninjam::UserChannel)));
-    QObject::disconnect(ninjamService, SIGNAL(audioIntervalDownloading(Ninjam::User,int,int)), this, SLOT(on_ninjamAudioIntervalDownloading(Ninjam::User,int,int)));
 
     QObject::disconnect(ninjamService, SIGNAL(chatMessageReceived(Ninjam::User,QString)), this, SIGNAL(chatMsgReceived(Ninjam::User,QString)));
 
@@ -357,29 +286,44 @@ NinjamController::~NinjamController(){
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void NinjamController::start(const Ninjam::Server& server, QMap<int, bool> channelsXmitFlags){
     qCDebug(jtNinjamCore) << "starting ninjam controller...";
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
+
+    //the transmit status of each channel is read by the audio thread from the input groups
+    Q_UNUSED(channelsXmitFlags);
 
-    //schedule an update in internal attributes
-    scheduledEvents.append(new BpiChangeEvent(this, server.getBpi()));
-    scheduledEvents.append(new BpmChangeEvent(this, server.getBpm()));
-    foreach (int channelID, channelsXmitFlags.keys()) {
-        bool channelIsTransmiting = channelsXmitFlags[channelID];
-        scheduledEvents.append(new XmitChangedEvent(this, channelID, channelIsTransmiting));
+    if(running){//applied by the audio thread in the next interval
+        scheduleChange(ScheduledChange::BPI, server.getBpi());
+        scheduleChange(ScheduledChange::BPM, server.getBpm());
+    }
+    else{//the audio thread is not processing the interval
+        currentBpi = server.getBpi();
+        currentBpm = server.getBpm();
+        samplesInInterval = computeTotalSamplesInInterval();
+        metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
+        emit currentBpiChanged(currentBpi);
+        emit currentBpmChanged(currentBpm);
     }
     preparedForTransmit = false; //the xmit start after the first interval is received
     emit preparingTransmission();
 
-    //schedule the encoders creation (one encoder for each channel)
-    int channels = mainController->getInputTrackGroupsCount();
-    for (int channelIndex = 0; channelIndex < channels; ++channelIndex) {
-        scheduledEvents.append(new InputChannelChangedEvent(this, channelIndex));
-    }
-
-    processScheduledChanges();
-
     if(!running){
+        //discard the changes and events of the last jam, the audio thread is not using the queues
+        ScheduledChange staleChange;
+        while(scheduledChanges.pop(staleChange)){
+        }
+        AudioEvent staleEvent;
+        while(audioEvents.pop(staleEvent)){
+        }
+        processingIntervalPosition = -1;
+        audioEventsTimer.start(AUDIO_EVENTS_PERIOD);
 
-        encodingThread = new NinjamController::EncodingThread(this);
+        //one encoder for each channel, the encoding starts in the next interval
+        int channels = mainController->getInputTrackGroupsCount();
+        for (int channelIndex = 0; channelIndex < channels; ++channelIndex) {
+            createEncoder(channelIndex);
+        }
+
+        decodingThread = new NinjamIntervalDecodingThread();
 
         //add a sine wave generator as input to test audio transmission
         //mainController->addInputTrackNode(new Audio::LocalInputTestStreamer(440, mainController->getAudioDriverSampleRate()));
@@ -396,13 +340,13 @@ void NinjamController::start(const Ninjam::Server& server, QMap<int, bool> chann
         Ninjam::Service* ninjamService = mainController->getNinjamService();// Ninjam::Service::getInstance();
         QObject::connect(ninjamService, SIGNAL(serverBpmChanged(short)), this, SLOT(on_ninjamServerBpmChanged(short)));
         QObject::connect(ninjamService, SIGNAL(serverBpiChanged(short,short)), this, SLOT(on_ninjamServerBpiChanged(short,short)));
-        QObject::connect(ninjamService, SIGNAL(audioIntervalCompleted(Ninjam::User,int,QByteArray)), this, SLOT(on_ninjamAudiointervalCompleted(Ninjam::User,int,QByteArray)));
+        //the downloaded chunks are not copied by the ninjam service, they are valid only in a direct call
+        QObject::connect(ninjamService, SIGNAL(audioIntervalChunkDownloaded(Ninjam::User,int,QByteArray,bool,bool)), this, SLOT(on_ninjamAudioIntervalChunkDownloaded(Ninjam::User,int,QByteArray,bool,bool)), Qt::DirectConnection);
         //QObject::connect(ninjamService, SIGNAL(disconnectedFromServer(Ninjam::Server)), this, SLOT(on_ninjamDisconnectedFromServer(Ninjam::Server)));
 
         QObject::connect(ninjamService, SIGNAL(userChannelCreated(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelCreated(Ninjam::User, Ninjam::UserChannel)));
         QObject::connect(ninjamService, SIGNAL(userChannelRemoved(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelRemoved(Ninjam::User, Ninjam::UserChannel)));
         QObject::connect(ninjamService, SIGNAL(userChannelUpdated(Ninjam::User, Ninjam::UserChannel)), this, SLOT(on_ninjamUserChannelUpdated(Ninjam::User, Ninjam::UserChannel)));
-        QObject::connect(ninjamService, SIGNAL(audioIntervalDownloading(Ninjam::User,int,int)), this, SLOT(on_ninjamAudioIntervalDownloading(Ninjam::User,int,int)));
         QObject::connect(ninjamService, SIGNAL(userLeaveTheJam(Ninjam::User)), this, SLOT(on_ninjamUserLeave(Ninjam::User)));
         QObject::connect(ninjamService, SIGNAL(userEnterInTheJam(Ninjam::User)), this, SLOT(on_ninjamUserEnter(Ninjam::User)));
 
@@ -411,6 +355,7 @@ void NinjamController::start(const Ninjam::Server& server, QMap<int, bool> chann
         //add tracks for users connected in server
         QList<Ninjam::User*> users = server.getUsers();
         foreach (Ninjam::User* user, users) {
+            setUserDecodingOpus(*user, false);//vorbis until the first interval of the user is downloaded
             foreach (Ninjam::UserChannel* channel, user->getChannels()) {
                 addTrack(*user, *channel);
             }
@@ -439,22 +384,26 @@ void NinjamController::addTrack(Ninjam::User user, Ninjam::UserChannel channel){
     if(user.isBot()){
         return;
     }
-    NinjamTrackNode* trackNode = new NinjamTrackNode(generateNewTrackID());
+    NinjamTrackNode* trackNode = new NinjamTrackNode(generateNewTrackID(), decodingThread);
+    trackNode->setProfileName(user.getName() + " / " + channel.getName());
 
     bool trackAdded = false;
 
     //checkThread("addTrack();");
     {
-        QMutexLocker locker(&mutex);
+        Audio::RtCheckedMutexLocker locker(&mutex);
         trackNodes.insert(getUniqueKey(channel), trackNode);
     }//release the mutex before emit the signal
     trackAdded = mainController->addTrack(trackNode->getID(), trackNode);
 
     if(trackAdded){
+        audioTrackNodes.modify([trackNode](QList<NinjamTrackNode *> &tracks){
+            tracks.append(trackNode);
+        });
         emit channelAdded(user,  channel, trackNode->getID());
     }
     else{
-        QMutexLocker locker(&mutex);
+        Audio::RtCheckedMutexLocker locker(&mutex);
         trackNodes.remove(getUniqueKey(channel));
         delete trackNode;
     }
@@ -464,7 +413,7 @@ void NinjamController::removeTrack(Ninjam::User user, Ninjam::UserChannel channe
     bool channelDeleted = false;
     long ID;
     {
-        QMutexLocker locker(&mutex);
+        Audio::RtCheckedMutexLocker locker(&mutex);
         //checkThread("removeTrack();");
         QString uniqueKey = getUniqueKey(channel);
 
@@ -472,7 +421,10 @@ void NinjamController::removeTrack(Ninjam::User user, Ninjam::UserChannel channe
             NinjamTrackNode* trackNode = trackNodes[uniqueKey];
             ID = trackNode->getID();
             trackNodes.remove(uniqueKey);
-            mainController->removeTrack(ID);
+            audioTrackNodes.modify([trackNode](QList<NinjamTrackNode *> &tracks){
+                tracks.removeOne(trackNode);
+            });
+            mainController->removeTrack(ID);//the track node is deleted here
             channelDeleted = true;
         }
     }
@@ -492,6 +444,27 @@ void NinjamController::voteBpm(int bpm){
 void NinjamController::setMetronomeBeatsPerAccent(int beatsPerAccent){
     metronomeTrackNode->setBeatsPerAccent(beatsPerAccent);
 }
+
+void NinjamController::setMetronomeSoundFile(Audio::MetronomeSoundBank::Sound sound, QString waveFile){
+    Audio::MetronomeSoundBank &soundBank = metronomeTrackNode->getSoundBank();
+    if(waveFile.isEmpty() || !soundBank.loadSound(sound, waveFile)){
+        soundBank.resetSound(sound);
+    }
+}
+//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+void NinjamController::addIntervalSyncedPlayer(Audio::AudioFilePlayerNode *player){
+    intervalSyncedPlayers.modify([player](QList<Audio::AudioFilePlayerNode *> &players){
+        if(!players.contains(player)){
+            players.append(player);
+        }
+    });
+}
+
+void NinjamController::removeIntervalSyncedPlayer(Audio::AudioFilePlayerNode *player){
+    intervalSyncedPlayers.modify([player](QList<Audio::AudioFilePlayerNode *> &players){
+        players.removeOne(player);
+    });
+}
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //void NinjamController::deleteDeactivatedTracks(){
@@ -515,36 +488,95 @@ void NinjamController::handleNewInterval(){
         if(waitingIntervals >= TOTAL_PREPARED_INTERVALS){
             preparedForTransmit = true;
             waitingIntervals = 0;
-            emit preparedToTransmit();
+            postAudioEvent(AudioEvent::PREPARED_TO_TRANSMIT);
         }
         else{
             waitingIntervals++;
         }
     }
 
-    if(hasScheduledChanges()){
-        processScheduledChanges();
-    }
-    //QMutexLocker locker(&mutex);
-    foreach (NinjamTrackNode* track, trackNodes.values()) {
+    processScheduledChanges();
+    Audio::SnapshotPublisher<QList<NinjamTrackNode *> >::Reader tracks(audioTrackNodes);
+    for (NinjamTrackNode* track : *tracks) {
         bool trackWasPlaying = track->isPlaying();
         bool trackIsPlaying = track->startNewInterval();
         if(trackWasPlaying != trackIsPlaying){
-            emit channelXmitChanged(track->getID(), trackIsPlaying);
+            postAudioEvent(AudioEvent::TRACK_XMIT_CHANGED, trackIsPlaying, track->getID());
         }
     }
-    qCDebug(jtNinjamCore) << "emitint startingNewInterval signal";
-    emit startingNewInterval();
+    Audio::SnapshotPublisher<QList<Audio::AudioFilePlayerNode *> >::Reader players(intervalSyncedPlayers);
+    for (Audio::AudioFilePlayerNode* player : *players) {
+        player->startNewInterval();
+    }
+    postAudioEvent(AudioEvent::NEW_INTERVAL);
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-void NinjamController::processScheduledChanges(){
-    foreach (SchedulableEvent* event, scheduledEvents) {
-        event->process();
-        delete event;
+void NinjamController::scheduleChange(ScheduledChange::Type type, int value){
+    ScheduledChange change;
+    change.type = type;
+    change.value = value;
+    if(!scheduledChanges.push(change)){
+        qCWarning(jtNinjamCore) << "Discarding a scheduled change, the audio thread is not processing the intervals";
     }
+}
 
-    scheduledEvents.clear();
-
+void NinjamController::processScheduledChanges(){
+    ScheduledChange change;
+    bool changed = false;
+    while(scheduledChanges.pop(change)){
+        if(change.type == ScheduledChange::BPI){
+            currentBpi = change.value;
+            postAudioEvent(AudioEvent::BPI_CHANGED, change.value);
+        }
+        else{
+            currentBpm = change.value;
+            postAudioEvent(AudioEvent::BPM_CHANGED, change.value);
+        }
+        changed = true;
+    }
+    if(changed){
+        samplesInInterval = computeTotalSamplesInInterval();
+        metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
+    }
+}
+
+void NinjamController::postAudioEvent(AudioEvent::Type type, int value, long trackID){
+    AudioEvent event;
+    event.type = type;
+    event.value = value;
+    event.trackID = trackID;
+    audioEvents.push(event);//discarded when the queue is full, the GUI thread is not emitting the events
+}
+
+void NinjamController::emitAudioEvents(){
+    long position = processingIntervalPosition.exchange(-1);
+    if(position >= 0){
+        emit startProcessing(position);
+    }
+    AudioEvent event;
+    while(audioEvents.pop(event)){
+        switch (event.type) {
+        case AudioEvent::NEW_INTERVAL:
+            qCDebug(jtNinjamCore) << "emitint startingNewInterval signal";
+            emit startingNewInterval();
+            break;
+        case AudioEvent::BEAT_CHANGED:
+            emit intervalBeatChanged(event.value);
+            break;
+        case AudioEvent::BPI_CHANGED:
+            emit currentBpiChanged(event.value);
+            break;
+        case AudioEvent::BPM_CHANGED:
+            emit currentBpmChanged(event.value);
+            break;
+        case AudioEvent::PREPARED_TO_TRANSMIT:
+            emit preparedToTransmit();
+            break;
+        case AudioEvent::TRACK_XMIT_CHANGED:
+            emit channelXmitChanged(event.trackID, event.value != 0);
+            break;
+        }
+    }
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 long NinjamController::getSamplesPerBeat(){
@@ -566,6 +598,7 @@ long NinjamController::computeTotalSamplesInInterval(){
 //}
 
 void NinjamController::on_ninjamUserEnter(Ninjam::User user){
+    setUserDecodingOpus(user, false);
     emit userEnter(user.getName());
 }
 
@@ -573,9 +606,40 @@ void NinjamController::on_ninjamUserLeave(Ninjam::User user){
      foreach (Ninjam::UserChannel* channel, user.getChannels()) {
         removeTrack(user, *channel);
      }
+     if(usersDecodingOpus.remove(user.getFullName()) > 0){
+         updateUploadCodec();//maybe the last vorbis only user is leaving
+     }
      emit userLeave(user.getName());
 }
 
+//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+void NinjamController::setUserDecodingOpus(const Ninjam::User &user, bool decodingOpus){
+    if(user.getFullName() == mainController->getNinjamService()->getConnectedUserName()){
+        return;//the local user
+    }
+    if(usersDecodingOpus.contains(user.getFullName()) && usersDecodingOpus[user.getFullName()] == decodingOpus){
+        return;
+    }
+    usersDecodingOpus.insert(user.getFullName(), decodingOpus);
+    updateUploadCodec();
+}
+
+void NinjamController::updateUploadCodec(){
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    //all users in the room, including the listeners and bots, must decode the uploaded intervals
+    bool useOpus = mainController->getSettings().isOpusEncodingPreferred()
+            && Audio::IntervalCodecs::isSupported(Audio::IntervalCodec::OPUS)
+            && !usersDecodingOpus.values().contains(false);
+    Audio::IntervalCodec codec = useOpus ? Audio::IntervalCodec::OPUS : Audio::IntervalCodec::VORBIS;
+    if(codec != uploadCodec){
+        qCDebug(jtNinjamCore) << "uploading" << Audio::IntervalCodecs::getFourCC(codec) << "intervals";
+        uploadCodec = codec;
+    }
+    foreach (NinjamIntervalEncoder* encoder, encoders) {
+        encoder->setCodec(uploadCodec);//used in the next interval
+    }
+}
+
 void NinjamController::on_ninjamUserChannelCreated(Ninjam::User user, Ninjam::UserChannel channel){
     addTrack(user, channel);
 }
@@ -586,7 +650,7 @@ void NinjamController::on_ninjamUserChannelRemoved(Ninjam::User user, Ninjam::Us
 
 void NinjamController::on_ninjamUserChannelUpdated(Ninjam::User user, Ninjam::UserChannel channel){
     QString uniqueKey = getUniqueKey(channel);
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     //checkThread("on_ninjamUserChannelUpdated();");
     if(trackNodes.contains(uniqueKey)){
         NinjamTrackNode* trackNode = trackNodes[uniqueKey];
@@ -599,31 +663,54 @@ void NinjamController::on_ninjamServerBpiChanged(short newBpi, short oldBpi){
     Q_UNUSED(oldBpi);
     //this->samplesInInterval = computeTotalSamplesInInterval();
     //this->newBpi = newBpi;
-    scheduledEvents.append(new BpiChangeEvent(this, newBpi));
+    scheduleChange(ScheduledChange::BPI, newBpi);
 }
 
 void NinjamController::on_ninjamServerBpmChanged(short newBpm){
     //this->metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
     //this->newBpm = newBpm;
-    scheduledEvents.append(new BpmChangeEvent(this, newBpm));
+    scheduleChange(ScheduledChange::BPM, newBpm);
 }
 
-void NinjamController::on_ninjamAudiointervalCompleted(Ninjam::User user, int channelIndex, QByteArray encodedAudioData){
+void NinjamController::on_ninjamAudioIntervalChunkDownloaded(Ninjam::User user, int channelIndex, QByteArray encodedAudioChunk, bool isFirstPart, bool isLastPart){
+    Ninjam::UserChannel channel = user.getChannel(channelIndex);
+    QString channelKey = getUniqueKey(channel);
 
+    //the recorder need the complete interval
+    if(isFirstPart){
+        intervalsToRecord.remove(channelKey);
+        //the decoders supported by each user are advertised in the stream headers
+        QList<Audio::IntervalCodec> userDecoders = Audio::IntervalCodecs::getAdvertisedDecoders(encodedAudioChunk);
+        setUserDecodingOpus(user, userDecoders.contains(Audio::IntervalCodec::OPUS));
+    }
     if(mainController->isRecordingMultiTracksActivated()){
-        Geo::Location geoLocation = mainController->getGeoLocation(user.getIp());
-        QString userName = user.getName() + " from " + geoLocation.getCountryName();
-        mainController->saveEncodedAudio(userName, channelIndex, encodedAudioData);
+        if(isFirstPart || intervalsToRecord.contains(channelKey)){//the intervals downloading when the recording is activated are not recorded
+            intervalsToRecord[channelKey].append(encodedAudioChunk.constData(), encodedAudioChunk.size());//copied, the chunk is a view of the received bytes
+        }
+        if(isLastPart && intervalsToRecord.contains(channelKey)){
+            Geo::Location geoLocation = mainController->getGeoLocation(user.getIp());
+            QString userName = user.getName() + " from " + geoLocation.getCountryName();
+            mainController->saveEncodedAudio(userName, channelIndex, intervalsToRecord.take(channelKey));
+        }
+    }
+    else{
+        intervalsToRecord.clear();
     }
 
-    Ninjam::UserChannel channel = user.getChannel(channelIndex);
-    QString channelKey = getUniqueKey(channel);
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     if(trackNodes.contains(channelKey)){
         NinjamTrackNode* trackNode = trackNodes[channelKey];
         if(trackNode){
-            trackNode->addVorbisEncodedInterval(encodedAudioData);
-            emit channelAudioFullyDownloaded(trackNode->getID());
+            trackNode->addEncodedChunk(encodedAudioChunk, isFirstPart, isLastPart);
+            if(isLastPart){
+                emit channelAudioFullyDownloaded(trackNode->getID());
+            }
+            else{
+                if(!trackNode->isPlaying()){//track is not playing yet and receive the first interval bytes
+                    emit channelXmitChanged(trackNode->getID(), true);
+                }
+                emit channelAudioChunkDownloaded(trackNode->getID());
+            }
         }
     }
     else{
@@ -632,7 +719,7 @@ void NinjamController::on_ninjamAudiointervalCompleted(Ninjam::User user, int ch
 }
 
 void NinjamController::reset(){
-    QMutexLocker locker(&mutex);
+    Audio::RtCheckedMutexLocker locker(&mutex);
     foreach (NinjamTrackNode* trackNode, this->trackNodes.values()) {
         trackNode->discardIntervals();
     }
@@ -640,63 +727,9 @@ void NinjamController::reset(){
 }
 
 
-void NinjamController::setTransmitStatus(int channelID, bool transmiting){
-    scheduledEvents.append(new XmitChangedEvent(this, channelID, transmiting));
-}
-
 void NinjamController::scheduleEncoderChangeForChannel(int channelIndex){
-    scheduledEvents.append(new InputChannelChangedEvent(this, channelIndex));
-}
-
-QByteArray NinjamController::encode(const Audio::SamplesBuffer &buffer, uint channelIndex){
-    QMutexLocker locker(&encodersMutex);
-    if(encoders.contains(channelIndex)){
-        return encoders[channelIndex]->encode(buffer);
-    }
-    return QByteArray();
-}
-
-QByteArray NinjamController::encodeLastPartOfInterval(uint channelIndex){
-    QMutexLocker locker(&encodersMutex);
-    if(encoders.contains(channelIndex)){
-        return encoders[channelIndex]->finishIntervalEncoding();
-    }
-    return QByteArray();
-}
-
-void NinjamController::recreateEncoderForChannel(int channelIndex){
-
-    QMutexLocker locker(&encodersMutex);
-    int maxChannelsForEncoding = mainController->getMaxChannelsForEncodingInTrackGroup(channelIndex);
-    //qWarning() << "recreating encoding using " << maxChannelsForEncoding << " channels";
-    if(maxChannelsForEncoding <= 0){//input tracks are setted as noInput?
-        return;
-    }
-    bool currentEncoderIsInvalid = encoders.contains(channelIndex) &&
-            (encoders[channelIndex]->getChannels() != maxChannelsForEncoding
-                || encoders[channelIndex]->getSampleRate() != mainController->getSampleRate());
-
-    if(!encoders.contains(channelIndex) || currentEncoderIsInvalid){//a new encoder is necessary?
-        //qDebug() << "recreating encoder for channel index" << channelIndex;
-        if(currentEncoderIsInvalid){
-            delete encoders[channelIndex];
-        }
-        encoders[channelIndex] = new VorbisEncoder(maxChannelsForEncoding, mainController->getSampleRate());
-    }
-}
-
-void NinjamController::recreateEncoders(){
     if(isRunning()){
-        QMutexLocker locker(&encodersMutex); //this method is called from main thread, and the encoders are used in audio thread every time
-        for (int e = 0; e < encoders.size(); ++e) {
-            delete encoders[e];
-        }
-        encoders.clear();//new encoders will be create on demand
-
-        int trackGroupsCount = mainController->getInputTrackGroupsCount();
-        for (int channelIndex = 0; channelIndex < trackGroupsCount; ++channelIndex) {
-            recreateEncoderForChannel(channelIndex);
-        }
+        createEncoder(channelIndex);//the encoders are recreated by the encoding thread when the input channels change
     }
 }
 
@@ -709,43 +742,12 @@ void NinjamController::setSampleRate(int newSampleRate){
 
     this->samplesInInterval = computeTotalSamplesInInterval();
 
-    //remove the old metronome
-    float oldGain = metronomeTrackNode->getGain();
-    float oldPan = metronomeTrackNode->getPan();
-    bool oldMutedStatus = metronomeTrackNode->isMuted();
-    bool oldSoloStatus = metronomeTrackNode->isSoloed();
-    int oldBeatsPerAccent = metronomeTrackNode->getBeatsPerAccent();
-
-    mainController->removeTrack(METRONOME_TRACK_ID);
-
-    //recreate metronome using the new sample rate
-    this->metronomeTrackNode = createMetronomeTrackNode(newSampleRate);
-    this->metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
-    this->metronomeTrackNode->setGain( oldGain );
-    this->metronomeTrackNode->setPan( oldPan );
-    this->metronomeTrackNode->setMute( oldMutedStatus );
-    this->metronomeTrackNode->setSolo( oldSoloStatus );
-    this->metronomeTrackNode->setBeatsPerAccent(oldBeatsPerAccent);
-    mainController->addTrack(METRONOME_TRACK_ID, this->metronomeTrackNode);
-
-    recreateEncoders();
+    //the metronome sounds are resampled (or taken from the cache), the track is not recreated
+    metronomeTrackNode->setSampleRate(newSampleRate);
+    metronomeTrackNode->setSamplesPerBeat(getSamplesPerBeat());
+    //the encoders are recreated in the next interval using the new sample rate
 }
 
-void NinjamController::on_ninjamAudioIntervalDownloading(Ninjam::User user, int channelIndex, int downloadedBytes){
-    Q_UNUSED(downloadedBytes);
-    Ninjam::UserChannel channel = user.getChannel(channelIndex);
-    QString channelKey = getUniqueKey(channel);
-    QMutexLocker locker(&mutex);
-    if(trackNodes.contains(channelKey)){
-        NinjamTrackNode* track = dynamic_cast<NinjamTrackNode*>( trackNodes[channelKey]);
-        if(track){
-            if(!track->isPlaying()){//track is not playing yet and receive the first interval bytes
-                emit channelXmitChanged(track->getID(), true);
-            }
-            emit channelAudioChunkDownloaded(track->getID());
-        }
-    }
-}
 
 //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -3,17 +3,27 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QScopedPointer>
 #include "ninjam/User.h"
 #include "ninjam/Server.h"
-#include "audio/vorbis/VorbisEncoder.h"
+#include "audio/core/SamplesBuffer.h"
+#include "audio/core/SnapshotPublisher.h"
+#include "audio/core/SpscQueue.h"
+#include "audio/core/DspProfiler.h"
+#include "audio/IntervalCodec.h"
+#include "audio/MetronomeSoundBank.h"
 
 #include <QThread>
+#include <QTimer>
+#include <atomic>
 
 class NinjamTrackNode;
+class NinjamIntervalDecodingThread;
+class NinjamIntervalEncoder;
 
 namespace Audio {
 class MetronomeTrackNode;
-class SamplesBuffer;
+class AudioFilePlayerNode;
 }
 
 namespace Controller {
@@ -37,6 +47,7 @@ public:
     }
 
     void setMetronomeBeatsPerAccent(int beatsPerAccent);
+    void setMetronomeSoundFile(Audio::MetronomeSoundBank::Sound sound, QString waveFile);// empty file name to use the default sound
     inline int getCurrentBpi() const
     {
         return currentBpi;
@@ -50,24 +61,24 @@ public:
     void voteBpi(int newBpi);
     void voteBpm(int newBpm);
 
-    void setBpm(int newBpm);
-
     void sendChatMessage(QString msg);
 
     static const long METRONOME_TRACK_ID = 123456789; // just a number :)
 
-    void recreateEncoders();
-
-    QByteArray encode(const Audio::SamplesBuffer &buffer, uint channelIndex);
-    QByteArray encodeLastPartOfInterval(uint channelIndex);
-
+    // create the encoder of a new channel, the channels and sample rate changes are detected by the encoders
     void scheduleEncoderChangeForChannel(int channelIndex);
     void removeEncoder(int groupChannelIndex);
 
-    void setTransmitStatus(int channelID, bool transmiting);
-
     void setSampleRate(int newSampleRate);
 
+    // main thread, allocate the audio thread buffers for the audio driver format. The blocks
+    // bigger than 'maxFrames' are processed in parts, the audio thread never allocates.
+    void setAudioFormat(int inputChannels, int outputChannels, int maxFrames);
+
+    // select the codec used in the next uploaded intervals. Opus is used only if it is preferred
+    // in the settings and all remote users advertise an opus decoder in the downloaded intervals.
+    void updateUploadCodec();
+
     void reset();// discard downloaded intervals and reset intervalPosition
 
     inline bool isPreparedForTransmit() const
@@ -75,6 +86,11 @@ public:
         return preparedForTransmit;
     }
 
+public slots:
+    // GUI thread, emit the signals of the events posted by the audio thread. Called by a timer
+    // while the controller is running, the offline renders without event loop call it directly.
+    void emitAudioEvents();
+
 signals:
     void currentBpiChanged(int newBpi);
     void currentBpmChanged(int newBpm);
@@ -95,6 +111,11 @@ signals:
     void encodedAudioAvailableToSend(QByteArray encodedAudio, quint8 channelIndex, bool isFirstPart,
                                      bool isLastPart);
 
+    // the players waiting the next interval (AudioFilePlayerNode::StartMode::NEXT_INTERVAL) are
+    // started in the first sample of the interval
+    void addIntervalSyncedPlayer(Audio::AudioFilePlayerNode *player);
+    void removeIntervalSyncedPlayer(Audio::AudioFilePlayerNode *player);
+
     void preparingTransmission();// waiting for start transmission
     void preparedToTransmit(); // this signal is emmited one time, when Jamtaba is ready to transmit (after wait some complete itervals)
 private:
@@ -102,6 +123,8 @@ private:
     Audio::MetronomeTrackNode *metronomeTrackNode;
 
     QMap<QString, NinjamTrackNode *> trackNodes;// the other users channels
+    Audio::SnapshotPublisher<QList<NinjamTrackNode *> > audioTrackNodes;// the same tracks, read by the audio thread
+    Audio::SnapshotPublisher<QList<Audio::AudioFilePlayerNode *> > intervalSyncedPlayers;
 
     static QString getUniqueKey(Ninjam::UserChannel channel);
 
@@ -114,56 +137,94 @@ private:
     int lastBeat;
     long samplesInInterval;
 
-    int currentBpi;
-    int currentBpm;
+    std::atomic<int> currentBpi;// changed by the audio thread in the first sample of the interval
+    std::atomic<int> currentBpm;
 
     QMutex mutex;
 
-    QMutex encodersMutex;
-
     long computeTotalSamplesInInterval();
     long getSamplesPerBeat();
 
-    void processScheduledChanges();
-    inline bool hasScheduledChanges() const
-    {
-        return !scheduledEvents.isEmpty();
-    }
-
     static long generateNewTrackID();
 
     static Audio::MetronomeTrackNode *createMetronomeTrackNode(int sampleRate);
 
-    QMap<int, VorbisEncoder *> encoders;
-    VorbisEncoder *getEncoder(quint8 channelIndex);
+    QMap<int, NinjamIntervalEncoder *> encoders;// one encoder (and thread) for each input track group
+    Audio::SnapshotPublisher<QMap<int, NinjamIntervalEncoder *> > audioEncoders;// the same encoders, read by the audio thread
+    void createEncoder(int channelIndex);
+    void deleteEncoders();
 
     void handleNewInterval();
-    void recreateEncoderForChannel(int channelIndex);
 
-    // ++++++++++++++++++++ nested classes to handle scheduled events +++++++++++++++++
-    class SchedulableEvent;// the interface for all events
-    class BpiChangeEvent;
-    class BpmChangeEvent;
-    class InputChannelChangedEvent;// user change the channel input selection from mono to stereo or vice-versa, or user added a new channel, both cases requires a new encoder in next interval
-    class XmitChangedEvent;
-    QList<SchedulableEvent *> scheduledEvents;
+    // the server bpi and bpm changes, applied by the audio thread in the next interval
+    struct ScheduledChange
+    {
+        enum Type {
+            BPI, BPM
+        };
+        Type type;
+        int value;
+    };
+    Audio::SpscQueue<ScheduledChange> scheduledChanges;// GUI thread -> audio thread
+    void scheduleChange(ScheduledChange::Type type, int value);
+    void processScheduledChanges();// audio thread
+
+    // the audio thread never emits signals, the events are emitted by the GUI thread
+    struct AudioEvent
+    {
+        enum Type {
+            NEW_INTERVAL, BEAT_CHANGED, BPI_CHANGED, BPM_CHANGED, PREPARED_TO_TRANSMIT,
+            TRACK_XMIT_CHANGED
+        };
+        Type type;
+        int value;// the beat, bpi, bpm or track transmit status
+        long trackID;
+    };
+    Audio::SpscQueue<AudioEvent> audioEvents;// audio thread -> GUI thread
+    void postAudioEvent(AudioEvent::Type type, int value = 0, long trackID = 0);
+    std::atomic<long> processingIntervalPosition;// -1 when startProcessing() was already emitted
+    QTimer audioEventsTimer;
+
+    static const int MAX_SCHEDULED_CHANGES = 64;
+    static const int MAX_AUDIO_EVENTS = 512;// the events posted while the GUI thread is busy
+    static const int AUDIO_EVENTS_PERIOD = 10;// ms
+
+    NinjamIntervalDecodingThread *decodingThread;// decode the downloaded intervals ahead of the audio thread
+
+    QMap<QString, bool> usersDecodingOpus;// remote users (full names) -> the last downloaded interval advertised an opus decoder
+    Audio::IntervalCodec uploadCodec;
+    void setUserDecodingOpus(const Ninjam::User &user, bool decodingOpus);
+
+    QMap<QString, QByteArray> intervalsToRecord;// downloading intervals, stored only when the multi track recording is activated
+
+    std::atomic<bool> preparedForTransmit;
+    int waitingIntervals;
+    static const int TOTAL_PREPARED_INTERVALS = 2;// how many intervals Jamtaba will wait to start trasmiting?
+
+    static const int DEFAULT_MAX_FRAMES = 4096;
 
-    class EncodingThread;
+    // buffers used in audio thread, recreated only when the audio driver format changes
+    struct ProcessBuffers
+    {
+        ProcessBuffers(int inputChannels, int outputChannels, int maxFrames);
 
-    EncodingThread *encodingThread;
+        Audio::SamplesBuffer in;
+        Audio::SamplesBuffer out;
+        Audio::SamplesBuffer inputMix;// the mono or stereo mix of each transmitted group
+        int maxFrames;
+    };
+    QScopedPointer<ProcessBuffers> processBuffers;
+    Audio::SnapshotPublisher<ProcessBuffers *> audioProcessBuffers;// used by the audio thread
 
-    bool preparedForTransmit;
-    int waitingIntervals;
-    static const int TOTAL_PREPARED_INTERVALS = 2;// how many intervals Jamtaba will wait to start trasmiting?
+    Audio::ProfileHistogram processTimes;
 
 private slots:
     // ninjam events
     void on_ninjamServerBpmChanged(short newBpm);
     void on_ninjamServerBpiChanged(short oldBpi, short newBpi);
-    void on_ninjamAudiointervalCompleted(Ninjam::User user, int channelIndex,
-                                         QByteArray encodedAudioData);
-    void on_ninjamAudioIntervalDownloading(Ninjam::User user, int channelIndex,
-                                           int downloadedBytes);
+    void on_ninjamAudioIntervalChunkDownloaded(Ninjam::User user, int channelIndex,
+                                               QByteArray encodedAudioChunk, bool isFirstPart,
+                                               bool isLastPart);
     void on_ninjamUserChannelCreated(Ninjam::User user, Ninjam::UserChannel channel);
     void on_ninjamUserChannelRemoved(Ninjam::User user, Ninjam::UserChannel channel);
     void on_ninjamUserChannelUpdated(Ninjam::User user, Ninjam::UserChannel channel);
@@ -0,0 +1,365 @@
+#include "AudioFilePlayerNode.h"
+#include "AudioFileSource.h"
+#include "core/SamplesBuffer.h"
+#include "log/Logging.h"
+#include "core/RtViolationDetector.h"
+
+#include <QThread>
+#include <climits>
+
+using namespace Audio;
+
+namespace Audio {
+class AudioFileDecodingThread : public QThread
+{
+public:
+    explicit AudioFileDecodingThread(AudioFilePlayerNode *player) :
+        player(player)
+    {
+        start();
+    }
+
+protected:
+    void run()
+    {
+        player->decodingLoop();
+    }
+
+private:
+    AudioFilePlayerNode *player;
+};
+}
+
+// +++++++++++++
+AudioFilePlayerNode::AudioFilePlayerNode() :
+    stopDecoding(false),
+    source(nullptr),
+    decodedBuffer(nullptr),
+    decodingPosition(0),
+    seekRequest(-1),
+    loopEnabled(false),
+    loopStart(0),
+    loopEnd(-1),
+    flushRequested(false),
+    flushPosition(0),
+    finished(false),
+    playing(false),
+    waitingInterval(false),
+    playPosition(0),
+    length(0),
+    fileSampleRate(0),
+    decodedSamples(2, PRE_RENDERED_FRAMES),
+    wasPlaying(false),
+    culled(false),
+    skippedFramesRemainder(0)
+{
+    decodingThread = new AudioFileDecodingThread(this);
+}
+
+AudioFilePlayerNode::~AudioFilePlayerNode()
+{
+    {
+        Audio::RtCheckedMutexLocker locker(&mutex);
+        stopDecoding = true;
+        hasCommands.wakeAll();
+    }
+    decodingThread->wait();
+    delete decodingThread;
+    delete source;
+    delete decodedBuffer;
+}
+
+void AudioFilePlayerNode::load(const QString &filePath)
+{
+    playing.store(false);
+    waitingInterval.store(false);
+
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    fileToLoad = filePath;
+    hasCommands.wakeAll();
+}
+
+void AudioFilePlayerNode::play(StartMode startMode)
+{
+    if (finished.load() && decodedSamples.getAvailableFrames() == 0)
+        seek(0);// played until the end, start again
+
+    if (startMode == StartMode::NEXT_INTERVAL) {
+        waitingInterval.store(true);
+    } else {
+        waitingInterval.store(false);
+        playing.store(true);
+    }
+}
+
+void AudioFilePlayerNode::stop()
+{
+    waitingInterval.store(false);
+    playing.store(false);
+}
+
+void AudioFilePlayerNode::seek(qint64 frame)
+{
+    if (loopEnabled.load() && frame >= getLoopEnd())
+        frame = loopStart.load();// the decoding thread restarts the loop in the loop end
+
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    finished.store(false);// the audio thread doesn't stop the playback before the decoding thread seeks
+    seekRequest.store(qMax((qint64)0, frame));
+    hasCommands.wakeAll();
+}
+
+void AudioFilePlayerNode::setLoop(bool enabled, qint64 startFrame, qint64 endFrame)
+{
+    loopStart.store(qMax((qint64)0, startFrame));
+    loopEnd.store(endFrame);
+    loopEnabled.store(enabled);
+
+    // the samples decoded with the old loop are discarded
+    qint64 position = playPosition.load();
+    if (enabled && (position < startFrame || position >= getLoopEnd()))
+        position = startFrame;
+    seek(position);
+}
+
+qint64 AudioFilePlayerNode::getLoopEnd() const
+{
+    qint64 end = loopEnd.load();
+    qint64 fileLength = length.load();
+    if (end < 0 || (fileLength > 0 && end > fileLength))
+        return fileLength;
+    return end;
+}
+
+void AudioFilePlayerNode::startNewInterval()
+{
+    if (waitingInterval.exchange(false))
+        playing.store(true);
+}
+
+bool AudioFilePlayerNode::playedUntilTheEnd() const
+{
+    // 'finished' can be set by a decoding started before the last seek, the pending requests are
+    // checked first (see the order in decodeAhead())
+    if (seekRequest.load() >= 0 || flushRequested.load())
+        return false;
+    return finished.load();
+}
+
+void AudioFilePlayerNode::consumeFlushRequest()
+{
+    if (flushRequested.load()) {// the decoding thread is not writing until the flag is cleared
+        decodedSamples.skip(decodedSamples.getAvailableFrames());
+        resampler.reset();
+        playPosition.store(flushPosition.load());
+        wasPlaying = false;
+        skippedFramesRemainder = 0;
+        flushRequested.store(false);
+    }
+}
+
+void AudioFilePlayerNode::advancePosition(int frames)
+{
+    // the same loop used in the decoding thread
+    qint64 position = playPosition.load() + frames;
+    if (loopEnabled.load()) {
+        qint64 start = loopStart.load();
+        qint64 end = getLoopEnd();
+        if (end > start && position >= end)
+            position = start + (position - end) % (end - start);
+    }
+    playPosition.store(position);
+}
+
+void AudioFilePlayerNode::processCulled(const SamplesBuffer &in, SamplesBuffer &discarded,
+                                        int sampleRate, const Midi::MidiBuffer &midiBuffer)
+{
+    Q_UNUSED(in);
+    Q_UNUSED(midiBuffer);
+    if (!culled) {
+        culled = true;
+        lastPeak.zero();
+        skippedFramesRemainder = 0;
+    }
+    consumeFlushRequest();// the decoding thread waits the flush while the node is culled too
+
+    int fileRate = fileSampleRate.load();
+    if (!playing.load() || fileRate <= 0)
+        return;
+
+    // the position in the file is the same as if the samples were rendered
+    double framesToSkip = (double)discarded.getFrameLenght() * fileRate / sampleRate
+                          + skippedFramesRemainder;
+    int skippedFrames = decodedSamples.skip((int)framesToSkip);
+    skippedFramesRemainder = skippedFrames == (int)framesToSkip ? framesToSkip - skippedFrames : 0;
+    advancePosition(skippedFrames);
+    if (skippedFrames == 0 && playedUntilTheEnd())
+        playing.store(false);
+}
+
+void AudioFilePlayerNode::processReplacing(const SamplesBuffer &in, SamplesBuffer &out,
+                                           int sampleRate, const Midi::MidiBuffer &midiBuffer)
+{
+    consumeFlushRequest();
+    if (culled) {// the resampler history is older than the skipped samples
+        culled = false;
+        resampler.reset();
+    }
+
+    bool play = playing.load();
+    int fileRate = fileSampleRate.load();
+    if ((!play && !wasPlaying) || fileRate <= 0)
+        return;
+
+    bool needResampling = fileRate != sampleRate;
+    int framesToRead = out.getFrameLenght();
+    if (needResampling) {
+        resampler.setSampleRates(fileRate, sampleRate);
+        framesToRead = resampler.getInputFramesFor(out.getFrameLenght());
+    }
+
+    internalInputBuffer.setFrameLenght(framesToRead);
+    int framesRead = decodedSamples.read(internalInputBuffer, framesToRead);
+    if (framesRead <= 0) {
+        if (playedUntilTheEnd())
+            playing.store(false);
+        wasPlaying = false;
+        return;
+    }
+    internalInputBuffer.setFrameLenght(framesRead);
+    advancePosition(framesRead);
+
+    if (!play)
+        internalInputBuffer.fade(1, 0);// stopped, the last block fades out
+    else if (!wasPlaying)
+        internalInputBuffer.fade(0, 1);
+    wasPlaying = play;
+
+    if (needResampling) {
+        const SamplesBuffer &resampledBuffer = resampler.resample(internalInputBuffer,
+                                                                  out.getFrameLenght());
+        internalInputBuffer.setFrameLenght(resampledBuffer.getFrameLenght());
+        internalInputBuffer.set(resampledBuffer);
+    }
+    AudioNode::processReplacing(in, out, sampleRate, midiBuffer);// process internal buffer pan, gain, etc
+}
+
+// ++++++++++++++ decoding thread +++++++++++++++
+
+void AudioFilePlayerNode::decodingLoop()
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    while (!stopDecoding) {
+        if (!fileToLoad.isNull()) {
+            QString filePath = fileToLoad;
+            fileToLoad = QString();
+            locker.unlock();// opening the file can be slow, the commands are not blocked
+            openFile(filePath);
+            locker.relock();
+            continue;
+        }
+
+        locker.unlock();
+        bool decoded = decodeAhead();
+        locker.relock();
+        if (!decoded && !stopDecoding && fileToLoad.isNull()) {
+            // the ring buffer is refilled periodically while the audio thread consumes it
+            hasCommands.wait(&mutex, source ? REFILL_PERIOD : ULONG_MAX);
+        }
+    }
+}
+
+bool AudioFilePlayerNode::flush(qint64 position)
+{
+    flushPosition.store(position);
+    flushRequested.store(true);
+
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    while (flushRequested.load() && !stopDecoding && fileToLoad.isNull())
+        hasCommands.wait(&mutex, REFILL_PERIOD);
+    return !flushRequested.load();
+}
+
+void AudioFilePlayerNode::openFile(const QString &filePath)
+{
+    AudioFileSource *newSource = AudioFileSource::open(filePath);
+    delete source;
+    source = newSource;
+    decodingPosition = 0;
+    seekRequest.store(-1);
+    if (!flush(0))// the samples of the previous file
+        return;
+
+    if (!source) {
+        length.store(0);
+        fileSampleRate.store(0);
+        emit error("Can't play the file " + filePath);
+        return;
+    }
+
+    if (!decodedBuffer || decodedBuffer->getChannels() != source->getChannels()) {
+        delete decodedBuffer;
+        decodedBuffer = new SamplesBuffer(source->getChannels(), FRAMES_PER_DECODING);
+    }
+    length.store(source->getLength());
+    fileSampleRate.store(source->getSampleRate());
+    finished.store(false);
+    qCDebug(jtAudio) << "Playing" << filePath << source->getLength() << "frames in"
+                     << source->getSampleRate() << "Hz";
+}
+
+bool AudioFilePlayerNode::decodeAhead()
+{
+    if (!source)
+        return false;
+
+    if (flushRequested.load() && !flush(flushPosition.load()))
+        return false;// interrupted by other command
+
+    if (seekRequest.load() >= 0)
+        finished.store(false);// cleared before consuming the request, see playedUntilTheEnd()
+    qint64 seekFrame = seekRequest.exchange(-1);
+    if (seekFrame >= 0) {
+        if (!source->seek(seekFrame))
+            qCWarning(jtAudio) << "Can't seek the audio file to" << seekFrame;
+        decodingPosition = seekFrame;
+        if (!flush(seekFrame))
+            return false;
+    }
+    if (finished.load())
+        return false;
+
+    bool decoded = false;
+    bool restarted = false;// the loop is restarted only one time without decoded samples
+    while (decodedSamples.getFreeFrames() >= (unsigned int)FRAMES_PER_DECODING) {
+        bool looping = loopEnabled.load();
+        qint64 end = looping ? getLoopEnd() : 0;
+        int framesToDecode = FRAMES_PER_DECODING;
+        if (end > 0)
+            framesToDecode = (int)qBound((qint64)0, end - decodingPosition, (qint64)FRAMES_PER_DECODING);
+
+        decodedBuffer->setFrameLenght(FRAMES_PER_DECODING);
+        int frames = framesToDecode > 0 ? source->read(*decodedBuffer, framesToDecode) : 0;
+        if (frames > 0) {
+            decodedBuffer->setFrameLenght(frames);
+            decodedSamples.write(*decodedBuffer);
+            decodingPosition += frames;
+            decoded = true;
+            restarted = false;
+        }
+
+        if (frames < framesToDecode || framesToDecode == 0) {// the end of the file or the loop
+            if (!looping) {
+                finished.store(true);
+                break;
+            }
+            if (restarted)
+                break;
+            qint64 start = loopStart.load();
+            source->seek(start);
+            decodingPosition = start;
+            restarted = true;
+        }
+    }
+    return decoded;
+}
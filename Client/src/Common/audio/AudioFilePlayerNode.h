@@ -0,0 +1,128 @@
+#ifndef AUDIO_FILE_PLAYER_NODE_H
+#define AUDIO_FILE_PLAYER_NODE_H
+
+#include "core/AudioNode.h"
+#include "core/SamplesRingBuffer.h"
+#include "SamplesBufferResampler.h"
+#include <QWaitCondition>
+#include <atomic>
+
+namespace Audio {
+class AudioFileSource;
+class AudioFileDecodingThread;
+
+/**
+ * Plays long audio files (backing tracks). The file is opened and decoded by a background thread
+ * in a ring buffer ahead of the playback (see AudioFileSource for the supported formats), the
+ * file is never loaded in memory and the GUI thread is never blocked.
+ *
+ * The commands (load, seek, loop) are executed by the decoding thread. The decoded samples are
+ * discarded by the audio thread when the position changes, so the audio thread never waits for
+ * the decoding thread. The interval synced start is triggered by the NinjamController in the
+ * first sample of the next interval (startNewInterval()).
+ *
+ * The positions and the lengths are in frames in the file sample rate.
+ */
+class AudioFilePlayerNode : public AudioNode
+{
+    Q_OBJECT
+    friend class AudioFileDecodingThread;
+
+public:
+    enum class StartMode {
+        IMMEDIATELY,
+        NEXT_INTERVAL
+    };
+
+    AudioFilePlayerNode();
+    ~AudioFilePlayerNode();
+
+    void load(const QString &filePath);// the file is opened by the decoding thread
+
+    void play(StartMode startMode = StartMode::IMMEDIATELY);
+    void stop();// paused in the current position
+    void seek(qint64 frame);
+    void setLoop(bool enabled, qint64 startFrame = 0, qint64 endFrame = -1);// -1 is the end of the file
+
+    inline bool isPlaying() const
+    {
+        return playing.load();
+    }
+
+    inline bool isWaitingInterval() const
+    {
+        return waitingInterval.load();
+    }
+
+    inline qint64 getPosition() const
+    {
+        return playPosition.load();
+    }
+
+    inline qint64 getLength() const
+    {
+        return length.load();
+    }
+
+    inline int getFileSampleRate() const
+    {
+        return fileSampleRate.load();
+    }
+
+    void startNewInterval();// audio thread, the first sample of an interval
+
+    void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                          const Midi::MidiBuffer &midiBuffer);
+    void processCulled(const SamplesBuffer &in, SamplesBuffer &discarded, int sampleRate,
+                       const Midi::MidiBuffer &midiBuffer);
+
+signals:
+    void error(QString errorMsg);// emitted by the decoding thread
+
+private:
+    static const int PRE_RENDERED_FRAMES = 65536;// ~1.5 seconds in 44.1 KHz
+    static const int FRAMES_PER_DECODING = 4096;
+    static const unsigned long REFILL_PERIOD = 10;// milliseconds
+
+    AudioFileDecodingThread *decodingThread;
+    QWaitCondition hasCommands;
+    bool stopDecoding;// protected by 'mutex'
+    QString fileToLoad;// protected by 'mutex', null when there is no file to load
+
+    AudioFileSource *source;// decoding thread
+    SamplesBuffer *decodedBuffer;// decoding thread, with the file channels
+    qint64 decodingPosition;// decoding thread
+
+    std::atomic<qint64> seekRequest;// -1 when the position is not changed
+    std::atomic<bool> loopEnabled;
+    std::atomic<qint64> loopStart;
+    std::atomic<qint64> loopEnd;
+
+    std::atomic<bool> flushRequested;// the audio thread discard the decoded samples
+    std::atomic<qint64> flushPosition;// the position after the flush
+    std::atomic<bool> finished;// the end of the file was decoded and there is no loop
+
+    std::atomic<bool> playing;
+    std::atomic<bool> waitingInterval;
+    std::atomic<qint64> playPosition;// audio thread
+    std::atomic<qint64> length;
+    std::atomic<int> fileSampleRate;
+
+    SamplesRingBuffer decodedSamples;// decoding thread -> audio thread
+    SamplesBufferResampler resampler;// audio thread
+    bool wasPlaying;// audio thread, fade in and fade out when the playback starts and stops
+    bool culled;// audio thread
+    double skippedFramesRemainder;// audio thread
+
+    void decodingLoop();
+    bool decodeAhead();// decoding thread
+    void openFile(const QString &filePath);// decoding thread
+    bool flush(qint64 position);// decoding thread, wait the audio thread discard the samples
+    qint64 getLoopEnd() const;
+    bool playedUntilTheEnd() const;// audio thread
+    void consumeFlushRequest();// audio thread
+    void advancePosition(int frames);// audio thread
+};
+}
+
+#endif // AUDIO_FILE_PLAYER_NODE_H
@@ -0,0 +1,341 @@
+#include "AudioFileSource.h"
+#include "WaveFileReader.h"
+#include "codec.h"
+#include "core/SamplesBuffer.h"
+#include "log/Logging.h"
+#ifdef JAMTABA_FLAC_CODEC
+#include "flac/FlacFileSource.h"
+#endif
+
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#include <vorbis/vorbisfile.h>
+
+#include <QFile>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace Audio;
+
+namespace {
+// ++++++++++++++++++++++++++++++++++++++++++++
+class WaveFileSource : public AudioFileSource
+{
+public:
+    WaveFileSource() :
+        content(nullptr),
+        position(0)
+    {
+    }
+
+    bool open(const QString &filePath)
+    {
+        file.setFileName(filePath);
+        if (!file.open(QFile::ReadOnly))
+            return false;
+        content = file.map(0, file.size());// the pages are loaded by the OS when decoded
+        if (!content)
+            return false;
+        return WaveFileReader::readFormat(content, file.size(), format);
+    }
+
+    int getChannels() const
+    {
+        return format.channels;
+    }
+
+    int getSampleRate() const
+    {
+        return format.sampleRate;
+    }
+
+    qint64 getLength() const
+    {
+        return format.getFrames();
+    }
+
+    int read(SamplesBuffer &out, int maxFrames)
+    {
+        int frames = (int)std::min((qint64)maxFrames, getLength() - position);
+        if (frames <= 0)
+            return 0;
+        const uchar *data = content + format.dataOffset + position * format.getFrameSize();
+        if (!WaveFileReader::decode(format, data, frames, out))
+            return 0;
+        position += frames;
+        return frames;
+    }
+
+    bool seek(qint64 frame)
+    {
+        position = qBound((qint64)0, frame, getLength());
+        return true;
+    }
+
+private:
+    QFile file;
+    uchar *content;// memory mapped, unmapped when the file is closed
+    WaveFileReader::Format format;
+    qint64 position;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+class VorbisFileSource : public AudioFileSource
+{
+public:
+    VorbisFileSource() :
+        opened(false)
+    {
+    }
+
+    ~VorbisFileSource()
+    {
+        if (opened)
+            ov_clear(&vorbisFile);
+    }
+
+    bool open(const QString &filePath)
+    {
+        file.setFileName(filePath);
+        if (!file.open(QFile::ReadOnly))
+            return false;
+
+        ov_callbacks callbacks = {readCallback, seekCallback, nullptr, tellCallback};
+        opened = ov_open_callbacks(&file, &vorbisFile, nullptr, 0, callbacks) == 0;
+        return opened;
+    }
+
+    int getChannels() const
+    {
+        return ov_info(const_cast<OggVorbis_File *>(&vorbisFile), -1)->channels;
+    }
+
+    int getSampleRate() const
+    {
+        return ov_info(const_cast<OggVorbis_File *>(&vorbisFile), -1)->rate;
+    }
+
+    qint64 getLength() const
+    {
+        return ov_pcm_total(const_cast<OggVorbis_File *>(&vorbisFile), -1);
+    }
+
+    int read(SamplesBuffer &out, int maxFrames)
+    {
+        int decodedFrames = 0;
+        while (decodedFrames < maxFrames) {
+            float **pcm = nullptr;
+            int bitstream = 0;
+            long frames = ov_read_float(&vorbisFile, &pcm, maxFrames - decodedFrames, &bitstream);
+            if (frames == OV_HOLE)
+                continue;// interruption in the data, the decoding continues in the next page
+            if (frames <= 0)
+                break;// end of the file or error
+            // the chained streams can have other channels count
+            int channels = std::min(ov_info(&vorbisFile, bitstream)->channels, (int)out.getChannels());
+            for (int c = 0; c < (int)out.getChannels(); ++c) {
+                std::memcpy(out.getSamplesArray(c) + decodedFrames, pcm[std::min(c, channels - 1)],
+                            frames * sizeof(float));
+            }
+            decodedFrames += frames;
+        }
+        return decodedFrames;
+    }
+
+    bool seek(qint64 frame)
+    {
+        return ov_pcm_seek(&vorbisFile, frame) == 0;
+    }
+
+private:
+    QFile file;
+    OggVorbis_File vorbisFile;
+    bool opened;
+
+    static size_t readCallback(void *buffer, size_t size, size_t count, void *source)
+    {
+        qint64 readed = static_cast<QFile *>(source)->read(static_cast<char *>(buffer), size * count);
+        return readed > 0 ? readed / size : 0;
+    }
+
+    static int seekCallback(void *source, ogg_int64_t offset, int whence)
+    {
+        QFile *file = static_cast<QFile *>(source);
+        if (whence == SEEK_CUR)
+            offset += file->pos();
+        else if (whence == SEEK_END)
+            offset += file->size();
+        return file->seek(offset) ? 0 : -1;
+    }
+
+    static long tellCallback(void *source)
+    {
+        return static_cast<QFile *>(source)->pos();
+    }
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * The MP3 files are read in small chunks. There is no index of the MP3 frames, the length and
+ * the seek positions are estimated with the average bytes per decoded frame.
+ */
+class Mp3FileSource : public AudioFileSource
+{
+public:
+    Mp3FileSource() :
+        dataOffset(0),
+        channels(0),
+        pending(nullptr),
+        pendingOffset(0),
+        decodedBytes(0),
+        decodedFrames(0)
+    {
+    }
+
+    bool open(const QString &filePath)
+    {
+        file.setFileName(filePath);
+        if (!file.open(QFile::ReadOnly))
+            return false;
+
+        dataOffset = getId3TagSize(file.peek(10));
+        file.seek(dataOffset);
+        if (!decodeNextChunk())// the channels and the sample rate are known in the first frame
+            return false;
+        channels = pending->getChannels();
+        return true;
+    }
+
+    int getChannels() const
+    {
+        return channels;
+    }
+
+    int getSampleRate() const
+    {
+        return decoder.getSampleRate();
+    }
+
+    qint64 getLength() const
+    {
+        return (file.size() - dataOffset) / getBytesPerFrame();
+    }
+
+    int read(SamplesBuffer &out, int maxFrames)
+    {
+        int frames = 0;
+        while (frames < maxFrames) {
+            if (pendingOffset >= (int)pending->getFrameLenght() && !decodeNextChunk())
+                break;
+            int framesToCopy = std::min(maxFrames - frames,
+                                        (int)pending->getFrameLenght() - pendingOffset);
+            out.set(*pending, pendingOffset, framesToCopy, frames);
+            pendingOffset += framesToCopy;
+            frames += framesToCopy;
+        }
+        return frames;
+    }
+
+    bool seek(qint64 frame)
+    {
+        qint64 position = dataOffset + (qint64)(frame * getBytesPerFrame());
+        if (!file.seek(std::min(position, file.size())))
+            return false;
+        decoder.reset();
+        pendingOffset = pending ? pending->getFrameLenght() : 0;
+        return true;
+    }
+
+private:
+    static const int BYTES_PER_READ = 2048;
+
+    QFile file;
+    qint64 dataOffset;// after the ID3 tag
+    int channels;
+    Mp3DecoderMiniMp3 decoder;
+    const SamplesBuffer *pending;// decoded and not readed yet, owned by the decoder
+    int pendingOffset;
+    char bytes[BYTES_PER_READ];
+    qint64 decodedBytes;
+    qint64 decodedFrames;
+
+    double getBytesPerFrame() const
+    {
+        if (decodedFrames <= 0)
+            return 128000.0 / 8 / 44100;
+        return (double)(decodedBytes - decoder.getBufferedBytes()) / decodedFrames;
+    }
+
+    bool decodeNextChunk()
+    {
+        const SamplesBuffer *decoded = nullptr;
+        do {
+            int bytesReaded = (int)file.read(bytes, BYTES_PER_READ);
+            if (bytesReaded < 0)
+                bytesReaded = 0;
+            decoded = decoder.decode(bytes, bytesReaded);
+            decodedBytes += bytesReaded;
+            if (bytesReaded == 0 && decoded->isEmpty())
+                return false;// end of the file, the remaining bytes are not a complete frame
+        } while (decoded->isEmpty());
+
+        decodedFrames += decoded->getFrameLenght();
+        pending = decoded;
+        pendingOffset = 0;
+        return true;
+    }
+
+    static qint64 getId3TagSize(const QByteArray &header)
+    {
+        if (header.size() < 10 || !header.startsWith("ID3"))
+            return 0;
+        // the tag size is a 28 bits 'syncsafe' integer, 7 bits in each byte
+        qint64 size = 0;
+        for (int i = 6; i < 10; ++i)
+            size = (size << 7) | (header[i] & 0x7f);
+        return size + 10;
+    }
+};
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+AudioFileSource *AudioFileSource::open(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(jtAudio) << "Can't open the audio file" << filePath;
+        return nullptr;
+    }
+    QByteArray header = file.read(4);
+    file.close();
+
+    if (header == "RIFF") {
+        WaveFileSource *source = new WaveFileSource();
+        if (source->open(filePath))
+            return source;
+        delete source;
+    } else if (header == "OggS") {
+        VorbisFileSource *source = new VorbisFileSource();
+        if (source->open(filePath))
+            return source;
+        delete source;
+    } else if (header == "fLaC") {
+#ifdef JAMTABA_FLAC_CODEC
+        FlacFileSource *source = new FlacFileSource();
+        if (source->open(filePath))
+            return source;
+        delete source;
+#else
+        qCWarning(jtAudio) << "FLAC is not supported in this build" << filePath;
+        return nullptr;
+#endif
+    } else {// MP3 files have no magic number, the ID3 tag is optional
+        Mp3FileSource *source = new Mp3FileSource();
+        if (source->open(filePath))
+            return source;
+        delete source;
+    }
+
+    qCWarning(jtAudio) << "Can't decode the audio file" << filePath;
+    return nullptr;
+}
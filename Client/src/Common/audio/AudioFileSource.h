@@ -0,0 +1,39 @@
+#ifndef AUDIO_FILE_SOURCE_H
+#define AUDIO_FILE_SOURCE_H
+
+#include <QString>
+
+namespace Audio {
+class SamplesBuffer;
+
+/**
+ * Decodes an audio file in parts, the file is never loaded in memory. The supported formats are
+ * WAV (memory mapped), Ogg Vorbis, MP3 and FLAC (only in builds with CONFIG+=flac).
+ *
+ * The sources are not thread safe, they are used only by the thread decoding the file.
+ */
+class AudioFileSource
+{
+public:
+    virtual ~AudioFileSource()
+    {
+    }
+
+    // the format is detected in the file header, return nullptr if the file can't be decoded. The
+    // caller owns the returned source.
+    static AudioFileSource *open(const QString &filePath);
+
+    virtual int getChannels() const = 0;
+    virtual int getSampleRate() const = 0;
+    virtual qint64 getLength() const = 0;// in frames, estimated in MP3 files
+
+    // decode up to 'maxFrames' frames in 'out' (getChannels() channels, at least 'maxFrames'
+    // capacity), return the decoded frames or 0 in the end of the file
+    virtual int read(SamplesBuffer &out, int maxFrames) = 0;
+
+    // the position of the next read(), the MP3 seeking is not sample accurate
+    virtual bool seek(qint64 frame) = 0;
+};
+}
+
+#endif // AUDIO_FILE_SOURCE_H
@@ -0,0 +1,191 @@
+#include "AudioFileWriter.h"
+#include "core/SamplesBuffer.h"
+#include "core/SamplesBufferKernels.h"
+#include "log/Logging.h"
+#ifdef JAMTABA_FLAC_CODEC
+#include "flac/FlacFileWriter.h"
+#endif
+
+#include <QFile>
+#include <QtEndian>
+#include <cstring>
+
+using namespace Audio;
+
+namespace {
+// ++++++++++++++++++++++++++++++++++++++++++++
+class WaveFileWriter : public AudioFileWriter
+{
+public:
+    WaveFileWriter(int channels, int sampleRate, int bitsPerSample) :
+        channels(channels),
+        sampleRate(sampleRate),
+        bitsPerSample(bitsPerSample),
+        writtenFrames(0)
+    {
+    }
+
+    ~WaveFileWriter()
+    {
+        close();
+    }
+
+    bool open(const QString &filePath)
+    {
+        file.setFileName(filePath);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate))
+            return false;
+        return writeHeader();
+    }
+
+    bool write(const SamplesBuffer &samples)
+    {
+        if (!file.isOpen())
+            return false;
+
+        const int frames = samples.getFrameLenght();
+        const int bytesPerSample = bitsPerSample / 8;
+        const int frameSize = channels * bytesPerSample;
+        if (converted.size() < frames * frameSize)
+            converted.resize(frames * frameSize);
+        if (ints.size() < (size_t)frames)
+            ints.resize(frames);
+        uchar *out = reinterpret_cast<uchar *>(converted.data());
+        for (int c = 0; c < channels; ++c) {
+            const float *in = samples.getReadOnlySamplesArray(qMin(c, (int)samples.getChannels() - 1));
+            uchar *sample = out + c * bytesPerSample;
+            if (bitsPerSample == 32) {// float
+                for (int s = 0; s < frames; ++s, sample += frameSize)
+                    qToLittleEndian<quint32>(*reinterpret_cast<const quint32 *>(in + s), sample);
+                continue;
+            }
+            convert(in, ints.data(), frames, bitsPerSample);
+            if (bitsPerSample == 16) {
+                for (int s = 0; s < frames; ++s, sample += frameSize)
+                    qToLittleEndian<qint16>((qint16)ints[s], sample);
+            } else {
+                for (int s = 0; s < frames; ++s, sample += frameSize) {
+                    sample[0] = ints[s] & 0xff;
+                    sample[1] = (ints[s] >> 8) & 0xff;
+                    sample[2] = (ints[s] >> 16) & 0xff;
+                }
+            }
+        }
+        qint64 bytes = frames * channels * bytesPerSample;
+        if (file.write(converted.constData(), bytes) != bytes)
+            return false;
+        writtenFrames += frames;
+        return true;
+    }
+
+    bool flush()
+    {
+        if (!file.isOpen())
+            return false;
+        qint64 position = file.pos();
+        bool updated = writeHeader() && file.seek(position);
+        return file.flush() && updated;
+    }
+
+    bool close()
+    {
+        if (!file.isOpen())
+            return true;
+        bool updated = writeHeader();
+        file.close();
+        return updated;
+    }
+
+    qint64 getWrittenFrames() const
+    {
+        return writtenFrames;
+    }
+
+private:
+    QFile file;
+    const int channels;
+    const int sampleRate;
+    const int bitsPerSample;
+    qint64 writtenFrames;
+    QByteArray converted;// interleaved samples in the file format
+    std::vector<int> ints;// one channel
+
+    bool writeHeader()// the sizes are updated when the file is flushed or closed
+    {
+        const quint16 format = bitsPerSample == 32 ? 3 : 1;// float or PCM
+        const quint16 blockAlign = channels * bitsPerSample / 8;
+        const quint32 dataSize = (quint32)qMin(writtenFrames * blockAlign, (qint64)0xffffffff - 36);
+
+        uchar header[44];
+        memcpy(header, "RIFF", 4);
+        qToLittleEndian<quint32>(36 + dataSize, header + 4);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        qToLittleEndian<quint32>(16, header + 16);
+        qToLittleEndian<quint16>(format, header + 20);
+        qToLittleEndian<quint16>(channels, header + 22);
+        qToLittleEndian<quint32>(sampleRate, header + 24);
+        qToLittleEndian<quint32>(sampleRate * blockAlign, header + 28);
+        qToLittleEndian<quint16>(blockAlign, header + 32);
+        qToLittleEndian<quint16>(bitsPerSample, header + 34);
+        memcpy(header + 36, "data", 4);
+        qToLittleEndian<quint32>(dataSize, header + 40);
+
+        if (!file.seek(0))
+            return false;
+        return file.write(reinterpret_cast<const char *>(header), sizeof(header)) == sizeof(header);
+    }
+};
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+AudioFileWriter::AudioFileWriter() :
+    dither(false),
+    ditherSeed(22222)
+{
+}
+
+void AudioFileWriter::convert(const float *in, int *out, unsigned int frames, int bitsPerSample)
+{
+    const float scale = (float)((1 << (bitsPerSample - 1)) - 1);
+    if (dither) {
+        // triangular noise: the sum of two uniform random values, one LSB each
+        if (dithered.size() < frames)
+            dithered.resize(frames);
+        const float lsb = 1.0f / scale / 4294967296.0f;
+        for (unsigned int i = 0; i < frames; ++i) {
+            ditherSeed = ditherSeed * 1664525 + 1013904223;
+            quint32 first = ditherSeed;
+            ditherSeed = ditherSeed * 1664525 + 1013904223;
+            dithered[i] = in[i] + ((float)first - (float)ditherSeed) * lsb;
+        }
+        in = dithered.data();
+    }
+    Kernels::get().convertToInts(out, in, frames, scale);
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+AudioFileWriter *AudioFileWriter::create(const QString &filePath, int channels, int sampleRate,
+                                         int bitsPerSample)
+{
+    if (filePath.endsWith(".flac", Qt::CaseInsensitive)) {
+#ifdef JAMTABA_FLAC_CODEC
+        FlacFileWriter *writer = new FlacFileWriter(channels, sampleRate, qMin(bitsPerSample, 24));
+        if (writer->open(filePath))
+            return writer;
+        delete writer;
+#else
+        qCWarning(jtAudio) << "FLAC is not supported in this build" << filePath;
+        return nullptr;
+#endif
+    } else {
+        if (bitsPerSample != 16 && bitsPerSample != 24 && bitsPerSample != 32)
+            bitsPerSample = 16;
+        WaveFileWriter *writer = new WaveFileWriter(channels, sampleRate, bitsPerSample);
+        if (writer->open(filePath))
+            return writer;
+        delete writer;
+    }
+
+    qCWarning(jtAudio) << "Can't write the audio file" << filePath;
+    return nullptr;
+}
@@ -0,0 +1,58 @@
+#ifndef AUDIO_FILE_WRITER_H
+#define AUDIO_FILE_WRITER_H
+
+#include <QString>
+#include <vector>
+
+namespace Audio {
+class SamplesBuffer;
+
+/**
+ * Write audio files in parts, the samples are converted and written in each write() call. The
+ * supported formats are WAV (PCM 16 and 24 bits, float 32 bits) and FLAC (16 and 24 bits, only
+ * in builds with CONFIG+=flac).
+ *
+ * The writers are not thread safe.
+ */
+class AudioFileWriter
+{
+public:
+    virtual ~AudioFileWriter()
+    {
+    }
+
+    // the format is selected by the file extension (.wav or .flac), return nullptr if the file
+    // can't be created. The caller owns the returned writer.
+    static AudioFileWriter *create(const QString &filePath, int channels, int sampleRate,
+                                   int bitsPerSample = 16);
+
+    // the first 'channels' of the buffer are written, the mono buffers are written in all channels
+    virtual bool write(const SamplesBuffer &samples) = 0;
+
+    // the header is updated with the written length, the file is valid if the writing stops here
+    virtual bool flush() = 0;
+
+    virtual bool close() = 0;// called in the destructor
+
+    virtual qint64 getWrittenFrames() const = 0;
+
+    // TPDF dither (2 LSB peak to peak) added before the conversion to 16 or 24 bits
+    inline void setDither(bool dither)
+    {
+        this->dither = dither;
+    }
+
+protected:
+    AudioFileWriter();
+
+    // one channel converted to integers, the samples are clipped in [-1, 1]
+    void convert(const float *in, int *out, unsigned int frames, int bitsPerSample);
+
+private:
+    bool dither;
+    quint32 ditherSeed;
+    std::vector<float> dithered;
+};
+}
+
+#endif // AUDIO_FILE_WRITER_H
@@ -0,0 +1,181 @@
+#include "IntervalCodec.h"
+#include "vorbis/VorbisEncoder.h"
+#include "vorbis/VorbisDecoder.h"
+#include <QtEndian>
+#include <atomic>
+#include <random>
+#ifdef JAMTABA_OPUS_CODEC
+    #include "opus/OpusIntervalEncoder.h"
+    #include "opus/OpusIntervalDecoder.h"
+#endif
+
+using namespace Audio;
+
+const char *IntervalCodecs::DECODERS_TAG = "JAMTABA_DECODERS";
+
+bool IntervalCodecs::isSupported(IntervalCodec codec)
+{
+    switch (codec) {
+    case IntervalCodec::VORBIS:
+        return true;
+    case IntervalCodec::OPUS:
+#ifdef JAMTABA_OPUS_CODEC
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+IntervalEncoder *IntervalCodecs::createEncoder(IntervalCodec codec, int channels, int sampleRate)
+{
+#ifdef JAMTABA_OPUS_CODEC
+    if (codec == IntervalCodec::OPUS)
+        return new OpusIntervalEncoder(channels, sampleRate);
+#endif
+    Q_UNUSED(codec)
+    return new VorbisEncoder(channels, sampleRate);
+}
+
+IntervalDecoder *IntervalCodecs::createDecoder(IntervalCodec codec)
+{
+#ifdef JAMTABA_OPUS_CODEC
+    if (codec == IntervalCodec::OPUS)
+        return new OpusIntervalDecoder();
+#endif
+    Q_UNUSED(codec)
+    return new VorbisDecoder();
+}
+
+IntervalCodec IntervalCodecs::fromFourCC(const QByteArray &fourCC)
+{
+    if (fourCC == "OGGv")
+        return IntervalCodec::VORBIS;
+    if (fourCC == "OGGo")
+        return IntervalCodec::OPUS;
+    return IntervalCodec::UNKNOWN;
+}
+
+QByteArray IntervalCodecs::getFourCC(IntervalCodec codec)
+{
+    return codec == IntervalCodec::OPUS ? QByteArray("OGGo") : QByteArray("OGGv");
+}
+
+QString IntervalCodecs::getFileExtension(IntervalCodec codec)
+{
+    return codec == IntervalCodec::OPUS ? ".opus" : ".ogg";
+}
+
+int IntervalCodecs::newStreamSerialNumber()
+{
+    static std::atomic<unsigned int> nextSerial(std::random_device()());
+    return (int)nextSerial.fetch_add(1);
+}
+
+QByteArray IntervalCodecs::getName(IntervalCodec codec)
+{
+    switch (codec) {
+    case IntervalCodec::VORBIS:
+        return "vorbis";
+    case IntervalCodec::OPUS:
+        return "opus";
+    default:
+        return QByteArray();
+    }
+}
+
+/*
+ Ogg page header:
+ Offset Type        Field
+ 0x0    uint8_t[4]  "OggS"
+ ...
+ 0x1a   uint8_t     Page segments
+ 0x1b   uint8_t[]   Segments table, followed by the first packet
+ */
+IntervalCodec IntervalCodecs::detect(const QByteArray &firstEncodedBytes)
+{
+    static const int SEGMENTS_OFFSET = 26;
+    if (firstEncodedBytes.size() <= SEGMENTS_OFFSET || !firstEncodedBytes.startsWith("OggS"))
+        return IntervalCodec::UNKNOWN;
+
+    int packetOffset = SEGMENTS_OFFSET + 1 + (quint8)firstEncodedBytes.at(SEGMENTS_OFFSET);
+    QByteArray packetStart = firstEncodedBytes.mid(packetOffset, 8);
+    if (packetStart.startsWith("\x01vorbis"))
+        return IntervalCodec::VORBIS;
+    if (packetStart.startsWith("OpusHead"))
+        return IntervalCodec::OPUS;
+    return IntervalCodec::UNKNOWN;
+}
+
+/*
+ The granule position (offset 0x6, int64) of the last page is the number of samples in the end of
+ the stream. The Vorbis sample rate is in the identification header, Opus granules are always in
+ 48 KHz and include the pre-skip samples.
+ */
+double IntervalCodecs::getDuration(const QByteArray &encodedInterval)
+{
+    static const int SEGMENTS_OFFSET = 26;
+    static const int GRANULE_OFFSET = 6;
+    IntervalCodec codec = detect(encodedInterval);
+    if (codec == IntervalCodec::UNKNOWN)
+        return 0;
+
+    const uchar *data = reinterpret_cast<const uchar *>(encodedInterval.constData());
+    int packetOffset = SEGMENTS_OFFSET + 1 + data[SEGMENTS_OFFSET];
+    int lastPageOffset = encodedInterval.lastIndexOf("OggS");
+    if (lastPageOffset <= 0 || lastPageOffset + SEGMENTS_OFFSET >= encodedInterval.size())
+        return 0;
+    qint64 granule = qFromLittleEndian<qint64>(data + lastPageOffset + GRANULE_OFFSET);
+    if (granule <= 0)
+        return 0;
+
+    if (codec == IntervalCodec::VORBIS) {
+        if (packetOffset + 16 > encodedInterval.size())
+            return 0;
+        // packet type, "vorbis", version (uint32), channels (uint8), sample rate (uint32)
+        quint32 sampleRate = qFromLittleEndian<quint32>(data + packetOffset + 12);
+        return sampleRate > 0 ? (double)granule / sampleRate : 0;
+    }
+
+    if (packetOffset + 12 > encodedInterval.size())
+        return 0;
+    // "OpusHead", version (uint8), channels (uint8), pre-skip (uint16)
+    quint16 preSkip = qFromLittleEndian<quint16>(data + packetOffset + 10);
+    return qMax((qint64)0, granule - preSkip) / 48000.0;
+}
+
+QByteArray IntervalCodecs::getSupportedDecoders()
+{
+    QByteArray decoders = getName(IntervalCodec::VORBIS);
+    if (isSupported(IntervalCodec::OPUS))
+        decoders += "," + getName(IntervalCodec::OPUS);
+    return decoders;
+}
+
+QList<IntervalCodec> IntervalCodecs::getAdvertisedDecoders(const QByteArray &firstEncodedBytes)
+{
+    QList<IntervalCodec> decoders;
+    decoders.append(IntervalCodec::VORBIS);// all NINJAM clients decode Vorbis
+
+    // the comments are stored as plain "TAG=value" strings in the header packets
+    QByteArray tag = QByteArray(DECODERS_TAG) + "=";
+    int tagIndex = firstEncodedBytes.indexOf(tag);
+    if (tagIndex < 0)
+        return decoders;
+
+    int valueStart = tagIndex + tag.size();
+    int valueEnd = valueStart;
+    while (valueEnd < firstEncodedBytes.size()) {
+        char c = firstEncodedBytes.at(valueEnd);
+        if (!((c >= 'a' && c <= 'z') || c == ','))
+            break;
+        valueEnd++;
+    }
+    foreach (const QByteArray &name, firstEncodedBytes.mid(valueStart, valueEnd - valueStart).split(',')) {
+        if (name == getName(IntervalCodec::OPUS) && !decoders.contains(IntervalCodec::OPUS))
+            decoders.append(IntervalCodec::OPUS);
+    }
+    return decoders;
+}
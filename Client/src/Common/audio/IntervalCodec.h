@@ -0,0 +1,99 @@
+#ifndef INTERVAL_CODEC_H
+#define INTERVAL_CODEC_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+namespace Audio {
+class SamplesBuffer;
+
+// the codecs used to encode the NINJAM intervals, all of them are Ogg streams
+enum class IntervalCodec : quint8 {
+    VORBIS,// "OGGv", supported by all NINJAM clients
+    OPUS,  // "OGGo", lower CPU cost and lookahead, used only when all peers can decode it
+    UNKNOWN
+};
+
+class IntervalEncoder
+{
+public:
+    virtual ~IntervalEncoder()
+    {
+    }
+
+    // the first call in each interval returns the stream headers with the encoded samples
+    virtual QByteArray encode(const SamplesBuffer &samples) = 0;
+
+    // flush the encoder and close the stream, the next encode() starts a new interval
+    virtual QByteArray finishIntervalEncoding() = 0;
+
+    virtual int getChannels() const = 0;
+    virtual int getSampleRate() const = 0;// the sample rate of the encoded samples
+    virtual IntervalCodec getCodec() const = 0;
+};
+
+class IntervalDecoder
+{
+public:
+    virtual ~IntervalDecoder()
+    {
+    }
+
+    // streaming input, can be called by other thread while decoding. The bytes are copied, the
+    // downloaded chunks reference the network receive buffer.
+    virtual void addInput(const QByteArray &encodedData, bool isLastPart) = 0;
+    virtual bool isInputComplete() const = 0;
+
+    // the returned buffer is always stereo and empty while waiting for more input or in the end
+    virtual const SamplesBuffer &decode(int maxSamplesToDecode) = 0;
+
+    virtual int getSampleRate() const = 0;// valid after the first decoded samples
+    virtual int getTotalDecodedSamples() const = 0;
+
+    // discard the input and decode a new stream (the next interval) with the same decoder. The
+    // decoders keep what can be reused, like the parsed stream headers.
+    virtual void restart() = 0;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+class IntervalCodecs
+{
+public:
+    static bool isSupported(IntervalCodec codec);// Opus is available only in builds with CONFIG+=opus
+
+    static IntervalEncoder *createEncoder(IntervalCodec codec, int channels, int sampleRate);
+    static IntervalDecoder *createDecoder(IntervalCodec codec);
+
+    static IntervalCodec fromFourCC(const QByteArray &fourCC);
+    static QByteArray getFourCC(IntervalCodec codec);
+
+    static QString getFileExtension(IntervalCodec codec);
+
+    // the serial number of a new encoded Ogg stream, random in each client and unique in the
+    // process, so the streams chained in the same file (recordings) never share a serial
+    static int newStreamSerialNumber();
+
+    // the codec of an interval, detected in the first Ogg packet
+    static IntervalCodec detect(const QByteArray &firstEncodedBytes);
+
+    // the duration (in seconds) of a complete encoded interval, read in the stream headers and in
+    // the granule position of the last Ogg page. Return 0 if the interval is incomplete.
+    static double getDuration(const QByteArray &encodedInterval);
+
+    /**
+     * The decoders supported by the client are advertised in a comment of the encoded
+     * streams (DECODERS_TAG=vorbis,opus). The NINJAM clients that don't know the tag
+     * ignore it, the peers that don't advertise any decoder are handled as Vorbis only.
+     */
+    static const char *DECODERS_TAG;
+    static QByteArray getSupportedDecoders();
+    static QList<IntervalCodec> getAdvertisedDecoders(const QByteArray &firstEncodedBytes);
+
+private:
+    static QByteArray getName(IntervalCodec codec);
+};
+}
+
+#endif // INTERVAL_CODEC_H
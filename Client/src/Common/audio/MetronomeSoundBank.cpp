@@ -0,0 +1,181 @@
+#include "MetronomeSoundBank.h"
+#include "WaveFileReader.h"
+#include "SamplesBufferResampler.h"
+#include "core/SamplesBuffer.h"
+#include "log/Logging.h"
+#include "core/RtViolationDetector.h"
+#include <algorithm>
+
+using namespace Audio;
+
+const QString MetronomeSoundBank::DEFAULT_CLICK_FILE(":/click.wav");
+
+MetronomeSoundBank::Sounds::Sounds() :
+    sampleRate(0)
+{
+    std::fill(buffers, buffers + TOTAL_SOUNDS, nullptr);
+}
+
+MetronomeSoundBank::SoundData::SoundData() :
+    samples(nullptr),
+    sampleRate(0)
+{
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+MetronomeSoundBank::MetronomeSoundBank(int sampleRate) :
+    sampleRate(sampleRate)
+{
+    loadSound(CLICK, DEFAULT_CLICK_FILE);
+}
+
+MetronomeSoundBank::~MetronomeSoundBank()
+{
+    for (int s = 0; s < TOTAL_SOUNDS; ++s) {
+        delete sounds[s].samples;
+        qDeleteAll(sounds[s].resampled);
+    }
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+bool MetronomeSoundBank::loadSound(Sound sound, const QString &waveFile)
+{
+    int fileSampleRate = 0;
+    SamplesBuffer *samples = WaveFileReader::read(waveFile, fileSampleRate);
+    if (!samples)
+        return false;
+
+    setSound(sound, *samples, fileSampleRate);
+    delete samples;
+    return true;
+}
+
+void MetronomeSoundBank::setSound(Sound sound, const SamplesBuffer &samples, int sampleRate)
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    QList<SamplesBuffer *> buffersToDelete;
+    clearSound(sound, buffersToDelete);
+    sounds[sound].samples = new SamplesBuffer(samples);
+    sounds[sound].sampleRate = sampleRate;
+    publish(buffersToDelete);
+}
+
+void MetronomeSoundBank::resetSound(Sound sound)
+{
+    if (sound == CLICK) {
+        loadSound(CLICK, DEFAULT_CLICK_FILE);
+        return;
+    }
+
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    QList<SamplesBuffer *> buffersToDelete;
+    clearSound(sound, buffersToDelete);
+    publish(buffersToDelete);
+}
+
+void MetronomeSoundBank::clearSound(Sound sound, QList<SamplesBuffer *> &buffersToDelete)
+{
+    delete sounds[sound].samples;// the original samples are never read by the audio thread
+    sounds[sound].samples = nullptr;
+    buffersToDelete.append(sounds[sound].resampled.values());
+    sounds[sound].resampled.clear();
+
+    if (sound == CLICK) {// the default accents are derived from the click
+        for (int s = 0; s < TOTAL_SOUNDS; ++s) {
+            if (s != CLICK && !sounds[s].samples) {
+                buffersToDelete.append(sounds[s].resampled.values());
+                sounds[s].resampled.clear();
+            }
+        }
+    }
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+void MetronomeSoundBank::setSampleRate(int sampleRate)
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    if (sampleRate == this->sampleRate && publishedSounds.getCurrent().sampleRate == sampleRate)
+        return;
+    this->sampleRate = sampleRate;
+    publish();// the sounds resampled to the old sample rate are kept in the cache
+}
+
+void MetronomeSoundBank::publish(QList<SamplesBuffer *> buffersToDelete)
+{
+    Sounds newSounds;
+    newSounds.sampleRate = sampleRate;
+    for (int s = 0; s < TOTAL_SOUNDS; ++s)
+        newSounds.buffers[s] = getResampled((Sound)s, sampleRate);
+
+    publishedSounds.modify([&newSounds](Sounds &sounds){
+        sounds = newSounds;
+    });
+    qDeleteAll(buffersToDelete);// the audio thread is not using the old buffers anymore
+}
+
+const SamplesBuffer *MetronomeSoundBank::getResampled(Sound sound, int targetSampleRate)
+{
+    SoundData &data = sounds[sound];
+    SamplesBuffer *cached = data.resampled.value(targetSampleRate, nullptr);
+    if (cached)
+        return cached;
+
+    const SoundData &source = data.samples ? data : sounds[CLICK];
+    if (!source.samples || targetSampleRate <= 0)
+        return nullptr;
+
+    // playing the click in a faster rate is the same as resample the click to a lower rate
+    int sourceSampleRate = data.samples ? data.sampleRate : source.sampleRate / getDefaultPitch(sound);
+
+    SamplesBuffer *buffer = nullptr;
+    if (sourceSampleRate == targetSampleRate)
+        buffer = new SamplesBuffer(*source.samples);
+    else
+        buffer = createResampledBuffer(*source.samples, sourceSampleRate, targetSampleRate);
+    data.resampled.insert(targetSampleRate, buffer);
+    return buffer;
+}
+
+float MetronomeSoundBank::getDefaultPitch(Sound sound)
+{
+    switch (sound) {
+    case INTERVAL_ACCENT:
+        return 0.5f;
+    case MEASURE_ACCENT:
+        return 0.75f;
+    default:
+        return 1.0f;
+    }
+}
+
+SamplesBuffer *MetronomeSoundBank::createResampledBuffer(const SamplesBuffer &buffer,
+                                                         int originalSampleRate,
+                                                         int finalSampleRate)
+{
+    int finalSize = (double)finalSampleRate/originalSampleRate * buffer.getFrameLenght();
+    SamplesBufferResampler resampler(SamplesBufferResampler::HIGH);// offline, latency is not a problem
+    resampler.setSampleRates(originalSampleRate, finalSampleRate);
+
+    // resampled in blocks (the resampler renders a limited number of frames in each call). The
+    // filter need some zeros after the last sample to render the tail.
+    const int blockSize = 4096;
+    SamplesBuffer *newBuffer = new SamplesBuffer(buffer.getChannels(), finalSize);
+    SamplesBuffer input(buffer.getChannels(), blockSize);
+    int inputPosition = 0;
+    int rendered = 0;
+    while (rendered < finalSize) {
+        int outFrames = std::min(blockSize, finalSize - rendered);
+        int inputFrames = resampler.getInputFramesFor(outFrames);
+        input.setFrameLenght(inputFrames);
+        input.zero();
+        input.set(buffer, inputPosition, inputFrames, 0);// nothing is copied after the last sample
+        inputPosition += inputFrames;
+
+        const SamplesBuffer &resampled = resampler.resample(input, outFrames);
+        if (resampled.isEmpty())
+            break;
+        newBuffer->set(resampled, 0, resampled.getFrameLenght(), rendered);
+        rendered += resampled.getFrameLenght();
+    }
+    return newBuffer;
+}
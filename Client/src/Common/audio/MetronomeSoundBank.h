@@ -0,0 +1,91 @@
+#ifndef METRONOME_SOUND_BANK_H
+#define METRONOME_SOUND_BANK_H
+
+#include "core/SnapshotPublisher.h"
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QMutex>
+
+namespace Audio {
+class SamplesBuffer;
+
+/**
+ * The sounds played by the metronome, decoded once and resampled (with high quality) to the
+ * audio sample rate. The resampled sounds are cached for each sample rate, so changing the
+ * sample rate back and forth doesn't resample the sounds again.
+ *
+ * The audio thread reads the sounds through a Reader and never blocks, all the loading and
+ * resampling is done by the thread calling loadSound() or setSampleRate().
+ */
+class MetronomeSoundBank
+{
+public:
+    enum Sound {
+        CLICK,
+        MEASURE_ACCENT,// first beat in each measure, when the accents are played
+        INTERVAL_ACCENT,// first beat in the interval
+        TOTAL_SOUNDS
+    };
+
+    struct Sounds
+    {
+        Sounds();
+        const SamplesBuffer *buffers[TOTAL_SOUNDS];
+        int sampleRate;
+    };
+
+    typedef SnapshotPublisher<Sounds>::Reader Reader;
+
+    explicit MetronomeSoundBank(int sampleRate);
+    ~MetronomeSoundBank();
+
+    // a WAV file or a Qt resource, the default accents are a higher pitched click
+    bool loadSound(Sound sound, const QString &waveFile);
+    void setSound(Sound sound, const SamplesBuffer &samples, int sampleRate);
+    void resetSound(Sound sound);// back to the default sound
+
+    void setSampleRate(int sampleRate);
+
+    inline int getSampleRate() const
+    {
+        return publishedSounds.getCurrent().sampleRate;
+    }
+
+    // used by the audio thread
+    inline const SnapshotPublisher<Sounds> &getSounds() const
+    {
+        return publishedSounds;
+    }
+
+    static const QString DEFAULT_CLICK_FILE;
+
+private:
+    MetronomeSoundBank(const MetronomeSoundBank &other);
+    MetronomeSoundBank &operator=(const MetronomeSoundBank &other);
+
+    struct SoundData
+    {
+        SoundData();
+        SamplesBuffer *samples;// null when the default sound is used
+        int sampleRate;
+        QMap<int, SamplesBuffer *> resampled;// cached variants, indexed by sample rate
+    };
+
+    SoundData sounds[TOTAL_SOUNDS];
+    int sampleRate;
+    QMutex mutex;
+
+    SnapshotPublisher<Sounds> publishedSounds;
+
+    const SamplesBuffer *getResampled(Sound sound, int targetSampleRate);
+    void publish(QList<SamplesBuffer *> buffersToDelete = QList<SamplesBuffer *>());
+    void clearSound(Sound sound, QList<SamplesBuffer *> &buffersToDelete);
+
+    static float getDefaultPitch(Sound sound);
+    static SamplesBuffer *createResampledBuffer(const SamplesBuffer &buffer, int originalSampleRate,
+                                                int finalSampleRate);
+};
+}
+
+#endif // METRONOME_SOUND_BANK_H
@@ -2,6 +2,7 @@
 #define METRONOMETRACKNODE_H
 
 #include "core/AudioNode.h"
+#include "MetronomeSoundBank.h"
 
 namespace Audio {
 class SamplesBuffer;
@@ -9,17 +10,24 @@ class SamplesBuffer;
 class MetronomeTrackNode : public Audio::AudioNode
 {
 public:
-    MetronomeTrackNode(QString metronomeWaveFile, int localSampleRate);
+    explicit MetronomeTrackNode(int localSampleRate);
 
     ~MetronomeTrackNode();
     virtual void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int SampleRate,
                                   const Midi::MidiBuffer &midiBuffer);
+
+    // muted metronome, the interval position is updated by the ninjam controller
+    virtual void processCulled(const SamplesBuffer &in, SamplesBuffer &discarded, int SampleRate,
+                               const Midi::MidiBuffer &midiBuffer);
     void setSamplesPerBeat(long samplesPerBeat);
     void setIntervalPosition(long intervalPosition);
     void resetInterval();
 
     void setBeatsPerAccent(int beatsPerAccent); // pass zero to turn off accents
 
+    // the sounds are resampled (or taken from the cache), the track is not recreated
+    void setSampleRate(int sampleRate);
+
     inline bool isPlayingAccents() const
     {
         return beatsPerAccent > 0;
@@ -27,7 +35,7 @@ public:
 
     virtual int getSampleRate() const
     {
-        return waveFileSampleRate;
+        return soundBank.getSampleRate();
     }
 
     inline int getBeatsPerAccent() const
@@ -35,20 +43,19 @@ public:
         return beatsPerAccent;
     }
 
+    inline MetronomeSoundBank &getSoundBank()
+    {
+        return soundBank;
+    }
+
 private:
-    SamplesBuffer *clickSoundBuffer;
-    SamplesBuffer *firstIntervalBeatBuffer;
-    SamplesBuffer *firstMeasureBeatBuffer;
+    MetronomeSoundBank soundBank;
 
     long samplesPerBeat;
     long intervalPosition;
-    long beatPosition;
-    int currentBeat;
     int beatsPerAccent;
 
-    quint32 waveFileSampleRate;// metronome wav file sample rate
-    SamplesBuffer *readWavFile(QString fileName, quint32 &sampleRate);
-    SamplesBuffer *getBuffer(int beat);// return the correct buffer to play in each beat
+    MetronomeSoundBank::Sound getSound(int beat) const;// return the correct sound to play in each beat
 };
 }
 
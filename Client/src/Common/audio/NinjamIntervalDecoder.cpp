@@ -0,0 +1,158 @@
+#include "NinjamIntervalDecoder.h"
+#include "log/Logging.h"
+#include "core/RtViolationDetector.h"
+#include <algorithm>
+
+const float NinjamIntervalDecoder::SILENCE_THRESHOLD = 0.000001f;
+
+NinjamIntervalDecoder::NinjamIntervalDecoder(Audio::IntervalCodec codec,
+                                             Audio::ProfileHistogram &decodeTimes) :
+    codec(codec),
+    decoder(Audio::IntervalCodecs::createDecoder(codec)),
+    decodeTimes(decodeTimes),
+    decodedSamples(2, PRE_RENDERED_FRAMES),
+    fullyDownloaded(false),
+    decodingFinished(false),
+    state(QUEUED),
+    sampleRate(0)
+{
+}
+
+void NinjamIntervalDecoder::addEncodedData(const QByteArray &encodedData, bool isLastPart)
+{
+    decoder->addInput(encodedData, isLastPart);
+    if (isLastPart)
+        fullyDownloaded.store(true);
+}
+
+void NinjamIntervalDecoder::discard()
+{
+    int expected = QUEUED;// the playing interval is not discarded
+    state.compare_exchange_strong(expected, DISCARDED);
+}
+
+bool NinjamIntervalDecoder::startPlaying()
+{
+    int expected = QUEUED;
+    return state.compare_exchange_strong(expected, PLAYING);
+}
+
+void NinjamIntervalDecoder::reset()
+{
+    decoder->restart();
+    decodedSamples.clear();
+    fullyDownloaded.store(false);
+    decodingFinished.store(false);
+    state.store(QUEUED);
+    sampleRate.store(0);
+}
+
+bool NinjamIntervalDecoder::decodeAhead()
+{
+    if (decodingFinished.load() || isDiscarded())
+        return false;
+
+    if (decodedSamples.getFreeFrames() < MIN_FRAMES_TO_DECODE)
+        return false;// avoid waking up to decode a few samples
+
+    bool decoded = false;
+    while (decodedSamples.getFreeFrames() > 0) {
+        bool inputWasComplete = decoder->isInputComplete();// checked before decode to avoid a race with the network thread
+        int framesToDecode = std::min((int)decodedSamples.getFreeFrames(), MAX_FRAMES_PER_DECODE);
+        Audio::ProfileScope profileScope(decodeTimes);
+        const Audio::SamplesBuffer &samples = decoder->decode(framesToDecode);
+        if (samples.isEmpty()) {
+            if (inputWasComplete) {// end of the interval, or the data is corrupted
+                decodingFinished.store(true);
+                qCDebug(jtNinjamVorbisDecoder) << "interval decoded, total samples:"
+                                               << decoder->getTotalDecodedSamples();
+            }
+            break;// waiting for more encoded data
+        }
+        if (sampleRate.load() == 0)
+            sampleRate.store(decoder->getSampleRate());
+        // silent blocks (idle users) are detected here, out of the audio thread
+        if (samples.isSilent() || samples.computePeak().getMax() < SILENCE_THRESHOLD)
+            decodedSamples.writeSilence(samples.getFrameLenght());
+        else
+            decodedSamples.write(samples);
+        decoded = true;
+    }
+    return decoded;
+}
+
+int NinjamIntervalDecoder::read(Audio::SamplesBuffer &out, int frames)
+{
+    return decodedSamples.read(out, frames);
+}
+
+int NinjamIntervalDecoder::skip(int frames)
+{
+    return decodedSamples.skip(frames);
+}
+
+bool NinjamIntervalDecoder::isFinished() const
+{
+    return decodingFinished.load() && decodedSamples.getAvailableFrames() == 0;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+NinjamIntervalDecodingThread::NinjamIntervalDecodingThread() :
+    stopRequested(false)
+{
+    qCDebug(jtNinjamCore) << "Starting Decoding Thread";
+    start();
+}
+
+NinjamIntervalDecodingThread::~NinjamIntervalDecodingThread()
+{
+    stop();
+    wait();
+}
+
+void NinjamIntervalDecodingThread::addDecoder(NinjamIntervalDecoder *decoder)
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    decoders.append(decoder);
+    hasDataToDecode.wakeAll();
+}
+
+void NinjamIntervalDecodingThread::removeDecoder(NinjamIntervalDecoder *decoder)
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);// wait the decoder finish the current decoding
+    decoders.removeOne(decoder);
+}
+
+void NinjamIntervalDecodingThread::wakeUp()
+{
+    hasDataToDecode.wakeAll();// a lost wake up is not a problem, the thread is waked periodically
+}
+
+void NinjamIntervalDecodingThread::stop()
+{
+    if (!stopRequested) {
+        stopRequested = true;
+        hasDataToDecode.wakeAll();
+        qCDebug(jtNinjamCore) << "Stopping Decoding Thread";
+    }
+}
+
+void NinjamIntervalDecodingThread::run()
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    while (!stopRequested) {
+        bool decoded = false;
+        foreach (NinjamIntervalDecoder *decoder, decoders) {
+            if (decoder->decodeAhead())
+                decoded = true;
+        }
+        if (!decoded && !stopRequested) {
+            hasDataToDecode.wait(&mutex, REFILL_PERIOD);// the mutex is released while waiting
+        } else {
+            locker.unlock();// give a chance to add/remove decoders
+            locker.relock();
+        }
+    }
+    qCDebug(jtNinjamCore) << "Decoding thread stopped!";
+}
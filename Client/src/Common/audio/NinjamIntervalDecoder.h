@@ -0,0 +1,124 @@
+#ifndef NINJAM_INTERVAL_DECODER_H
+#define NINJAM_INTERVAL_DECODER_H
+
+#include "IntervalCodec.h"
+#include "core/SamplesRingBuffer.h"
+#include "core/DspProfiler.h"
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+
+/**
+ * One NINJAM interval decoded while it is downloading.
+ *
+ * The encoded chunks (vorbis or opus) are added by the main thread as they are downloaded, the decoding thread
+ * pre-renders the PCM samples in a ring buffer and the audio thread just copy these samples.
+ *
+ * The played intervals are reused by the track (reset()), the ring buffer and the codec decoder
+ * are not allocated again in each interval.
+ */
+class NinjamIntervalDecoder
+{
+public:
+    NinjamIntervalDecoder(Audio::IntervalCodec codec, Audio::ProfileHistogram &decodeTimes);
+
+    // main thread (ninjam service)
+    void addEncodedData(const QByteArray &encodedData, bool isLastPart);
+    void discard();// the interval will be skipped by the audio thread, if it was not started
+
+    // main thread, prepare to decode a new interval. The interval can't be used by the decoding
+    // thread or the audio thread.
+    void reset();
+
+    inline Audio::IntervalCodec getCodec() const
+    {
+        return codec;
+    }
+
+    // decoding thread, decode until the ring buffer is full or the downloaded bytes are consumed
+    bool decodeAhead();// return true if some samples were decoded
+
+    // audio thread, return how many frames were copied to 'out'. The silent parts of the interval
+    // are not copied, 'out' is just marked as silent.
+    int read(Audio::SamplesBuffer &out, int frames);
+
+    // audio thread, advance the playback position without copying the samples (muted tracks)
+    int skip(int frames);
+
+    inline bool isFullyDownloaded() const
+    {
+        return fullyDownloaded.load();
+    }
+
+    inline bool isDiscarded() const
+    {
+        return state.load() == DISCARDED;
+    }
+
+    // audio thread, return false if the interval was discarded
+    bool startPlaying();
+
+    // all samples were decoded and readed
+    bool isFinished() const;
+
+    inline int getSampleRate() const// zero until the stream headers are decoded
+    {
+        return sampleRate.load();
+    }
+
+private:
+    static const int PRE_RENDERED_FRAMES = 32768;// ~0.7 seconds in 48 KHz
+    static const int MAX_FRAMES_PER_DECODE = 4096;// the decoders internal buffer size
+    static const unsigned int MIN_FRAMES_TO_DECODE = PRE_RENDERED_FRAMES/4;
+    static const float SILENCE_THRESHOLD;// decoded blocks below -120 dB are stored as digital silence
+
+    Audio::IntervalCodec codec;
+    QScopedPointer<Audio::IntervalDecoder> decoder;
+    Audio::ProfileHistogram &decodeTimes;// owned by the track, shared by all intervals
+    Audio::SamplesRingBuffer decodedSamples;
+
+    std::atomic<bool> fullyDownloaded;
+    std::atomic<bool> decodingFinished;
+
+    enum State {
+        QUEUED, PLAYING, DISCARDED
+    };
+    std::atomic<int> state;// changed once, from QUEUED to PLAYING or DISCARDED
+    std::atomic<int> sampleRate;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+/**
+ * Decode the intervals of all ninjam tracks ahead of the audio thread. The thread wakes up
+ * when new encoded data is available or periodically to refill the ring buffers consumed by
+ * the audio thread.
+ */
+class NinjamIntervalDecodingThread : public QThread
+{
+public:
+    NinjamIntervalDecodingThread();
+    ~NinjamIntervalDecodingThread();
+
+    void addDecoder(NinjamIntervalDecoder *decoder);
+    void removeDecoder(NinjamIntervalDecoder *decoder);// after the return the decoder is not used by this thread
+    void wakeUp();// new encoded data available
+    void stop();
+
+protected:
+    void run();
+
+private:
+    static const unsigned long REFILL_PERIOD = 10;// milliseconds
+
+    QList<NinjamIntervalDecoder *> decoders;
+    QMutex mutex;
+    QWaitCondition hasDataToDecode;
+    volatile bool stopRequested;
+};
+
+#endif // NINJAM_INTERVAL_DECODER_H
@@ -0,0 +1,188 @@
+#include "NinjamIntervalEncoder.h"
+#include "log/Logging.h"
+#include <algorithm>
+
+NinjamIntervalEncoder::PcmBlock::PcmBlock() :
+    samples(2, BLOCK_FRAMES),
+    frames(0),
+    sampleRate(0),
+    firstPart(false),
+    lastPart(false)
+{
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+NinjamIntervalEncoder::NinjamIntervalEncoder(quint8 channelIndex) :
+    channelIndex(channelIndex),
+    freeBlocks(TOTAL_BLOCKS),
+    filledBlocks(TOTAL_BLOCKS),
+    stopRequested(false),
+    droppedFrames(0),
+    codec(Audio::IntervalCodec::VORBIS),
+    currentBlock(nullptr),
+    nextBlockIsFirstPart(false),
+    encodingInterval(false),
+    firstPartPending(false)
+{
+    for (int i = 0; i < TOTAL_BLOCKS; ++i) {
+        PcmBlock *block = new PcmBlock();
+        blocks.append(block);
+        freeBlocks.push(block);
+    }
+    qCDebug(jtNinjamCore) << "Starting encoding thread for channel" << channelIndex;
+    start(QThread::HighPriority);
+}
+
+NinjamIntervalEncoder::~NinjamIntervalEncoder()
+{
+    stop();
+    qDeleteAll(blocks);
+}
+
+void NinjamIntervalEncoder::stop()
+{
+    if (!stopRequested.exchange(true)) {
+        filledBlocksAvailable.release();
+        wait();
+        qCDebug(jtNinjamCore) << "Encoding thread for channel" << channelIndex << "stopped";
+    }
+}
+
+void NinjamIntervalEncoder::setCodec(Audio::IntervalCodec codec)
+{
+    this->codec.store(codec);
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+bool NinjamIntervalEncoder::addSamples(const Audio::SamplesBuffer &samples, int sampleRate,
+                                       bool isFirstPart, bool isLastPart)
+{
+    if (isFirstPart) {
+        if (currentBlock && currentBlock->frames > 0)
+            pushCurrentBlock();// the previous interval was not finished (the interval was reset)
+        nextBlockIsFirstPart = true;
+    }
+
+    const int channels = samples.getChannels();
+    const int totalFrames = samples.getFrameLenght();
+    int offset = 0;
+    while (offset < totalFrames) {
+        if (currentBlock && currentBlock->samples.getChannels() != channels)
+            pushCurrentBlock();
+        if (!currentBlock && !startBlock(channels, sampleRate)) {
+            droppedFrames.fetch_add(totalFrames - offset, std::memory_order_relaxed);
+            return false;
+        }
+
+        int frames = std::min(totalFrames - offset, BLOCK_FRAMES - currentBlock->frames);
+        currentBlock->samples.set(samples, offset, frames, currentBlock->frames);
+        currentBlock->frames += frames;
+        offset += frames;
+        if (currentBlock->frames == BLOCK_FRAMES && offset < totalFrames)
+            pushCurrentBlock();
+    }
+
+    if (isLastPart) {
+        if (!currentBlock && !startBlock(channels, sampleRate))
+            return false;
+        currentBlock->lastPart = true;
+        pushCurrentBlock();
+    } else if (currentBlock && currentBlock->frames == BLOCK_FRAMES) {
+        pushCurrentBlock();
+    }
+    return true;
+}
+
+bool NinjamIntervalEncoder::startBlock(int channels, int sampleRate)
+{
+    if (!freeBlocks.pop(currentBlock)) {
+        currentBlock = nullptr;
+        return false;
+    }
+    if (channels == 1)
+        currentBlock->samples.setToMono();
+    else
+        currentBlock->samples.setToStereo();// the block capacity is stereo, nothing is allocated
+    currentBlock->sampleRate = sampleRate;
+    currentBlock->firstPart = nextBlockIsFirstPart;
+    nextBlockIsFirstPart = false;
+    return true;
+}
+
+void NinjamIntervalEncoder::pushCurrentBlock()
+{
+    filledBlocks.push(currentBlock);// never full, the queue capacity is the total of blocks
+    currentBlock = nullptr;
+    filledBlocksAvailable.release();
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+void NinjamIntervalEncoder::run()
+{
+    int loggedDroppedFrames = 0;
+    while (true) {
+        filledBlocksAvailable.acquire();
+        if (stopRequested.load())
+            break;
+
+        PcmBlock *block;
+        if (filledBlocks.pop(block))
+            encodeBlock(block);
+
+        int dropped = droppedFrames.load(std::memory_order_relaxed);
+        if (dropped != loggedDroppedFrames) {
+            qCWarning(jtNinjamCore) << "Encoder of channel" << channelIndex << "is late,"
+                                    << (dropped - loggedDroppedFrames) << "frames dropped";
+            loggedDroppedFrames = dropped;
+        }
+    }
+    encoder.reset();
+}
+
+void NinjamIntervalEncoder::encodeBlock(PcmBlock *block)
+{
+    const int channels = block->samples.getChannels();
+    if (block->firstPart) {
+        Audio::IntervalCodec intervalCodec = codec.load();
+        bool formatChanged = encoder && (encoder->getCodec() != intervalCodec
+                                         || encoder->getChannels() != channels
+                                         || encoder->getSampleRate() != block->sampleRate);
+        if (!encoder || formatChanged || encodingInterval)// a new stream for each interval
+            encoder.reset(Audio::IntervalCodecs::createEncoder(intervalCodec, channels, block->sampleRate));
+        encodingInterval = true;
+        firstPartPending = true;
+    }
+    if (!encodingInterval) {// the encoder was created in the middle of an interval, or the first part was dropped
+        recycleBlock(block);
+        return;
+    }
+
+    QByteArray encodedBytes;
+    if (block->frames > 0) {// zero frames are encoded as the end of the stream
+        block->samples.setFrameLenght(block->frames);
+        encodedBytes.append(encoder->encode(block->samples));
+    }
+    bool lastPart = block->lastPart;
+    if (lastPart) {
+        encodedBytes.append(encoder->finishIntervalEncoding());
+        encodingInterval = false;
+    }
+    recycleBlock(block);
+
+    if (!encodedBytes.isEmpty()) {
+        emit encodedAudioAvailable(encodedBytes, channelIndex, firstPartPending, lastPart);
+        firstPartPending = false;
+    }
+}
+
+void NinjamIntervalEncoder::recycleBlock(PcmBlock *block)
+{
+    block->samples.setFrameLenght(BLOCK_FRAMES);
+    block->frames = 0;
+    block->firstPart = false;
+    block->lastPart = false;
+    freeBlocks.push(block);
+}
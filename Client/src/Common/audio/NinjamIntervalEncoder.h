@@ -0,0 +1,100 @@
+#ifndef NINJAM_INTERVAL_ENCODER_H
+#define NINJAM_INTERVAL_ENCODER_H
+
+#include "IntervalCodec.h"
+#include "core/SamplesBuffer.h"
+#include "core/SpscQueue.h"
+#include "core/RtSemaphore.h"
+#include <QByteArray>
+#include <QList>
+#include <QScopedPointer>
+#include <QThread>
+#include <atomic>
+
+/**
+ * Encode the intervals of one local channel (an input track group) in a dedicated thread.
+ *
+ * The audio thread copies the mixed input samples in preallocated PCM blocks and pass the
+ * filled blocks to the encoding thread in a lock-free queue. The encoding thread is waked by a
+ * native semaphore, so addSamples() never locks or allocates. Each transmitted channel has
+ * its own encoding thread, the channels are encoded in parallel.
+ *
+ * The interval encoder is created in the encoding thread, and recreated in the first part of
+ * an interval when the codec, the channels or the sample rate of the samples change.
+ */
+class NinjamIntervalEncoder : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit NinjamIntervalEncoder(quint8 channelIndex);
+    ~NinjamIntervalEncoder();
+
+    // audio thread, return false if some samples were dropped because the encoder is late
+    bool addSamples(const Audio::SamplesBuffer &samples, int sampleRate, bool isFirstPart,
+                    bool isLastPart);
+
+    void stop();
+
+    // any thread, the new codec is used in the next interval
+    void setCodec(Audio::IntervalCodec codec);
+
+    inline quint8 getChannelIndex() const
+    {
+        return channelIndex;
+    }
+
+    inline int getDroppedFrames() const
+    {
+        return droppedFrames.load();
+    }
+
+signals:
+    // emitted in the encoding thread
+    void encodedAudioAvailable(const QByteArray &encodedAudio, quint8 channelIndex,
+                               bool isFirstPart, bool isLastPart);
+
+protected:
+    void run();
+
+private:
+    static const int BLOCK_FRAMES = 2048;
+    static const int TOTAL_BLOCKS = 32;// ~1.5 seconds in 44.1 KHz
+
+    struct PcmBlock
+    {
+        PcmBlock();
+        Audio::SamplesBuffer samples;
+        int frames;
+        int sampleRate;
+        bool firstPart;
+        bool lastPart;
+    };
+
+    const quint8 channelIndex;
+
+    QList<PcmBlock *> blocks;// all blocks, owned by the encoder
+    Audio::SpscQueue<PcmBlock *> freeBlocks;// encoding thread -> audio thread
+    Audio::SpscQueue<PcmBlock *> filledBlocks;// audio thread -> encoding thread
+    Audio::RtSemaphore filledBlocksAvailable;
+    std::atomic<bool> stopRequested;
+    std::atomic<int> droppedFrames;
+    std::atomic<Audio::IntervalCodec> codec;
+
+    // used only by the audio thread
+    PcmBlock *currentBlock;// partially filled
+    bool nextBlockIsFirstPart;
+
+    // used only by the encoding thread
+    QScopedPointer<Audio::IntervalEncoder> encoder;
+    bool encodingInterval;// the last part of the current interval was not encoded yet
+    bool firstPartPending;// the first encoded bytes of the interval were not emitted yet
+
+    bool startBlock(int channels, int sampleRate);
+    void pushCurrentBlock();
+
+    void encodeBlock(PcmBlock *block);
+    void recycleBlock(PcmBlock *block);
+};
+
+#endif // NINJAM_INTERVAL_ENCODER_H
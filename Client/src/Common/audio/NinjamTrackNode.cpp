@@ -1,43 +1,67 @@
 #include "NinjamTrackNode.h"
+#include "NinjamIntervalDecoder.h"
 #include "audio/core/AudioDriver.h"
-#include <QDataStream>
 #include <QDebug>
 #include <QList>
 #include <QByteArray>
-#include <QMutexLocker>
-#include <QDateTime>
 
-NinjamTrackNode::NinjamTrackNode(int ID) :
+NinjamTrackNode::NinjamTrackNode(int ID, NinjamIntervalDecodingThread *decodingThread) :
     playing(false),
     ID(ID),
+    sampleRate(0),
+    underruns(0),
+    culled(false),
+    skippedFramesRemainder(0),
+    decodingThread(decodingThread),
+    intervals(MAX_QUEUED_INTERVALS),
+    playedIntervals(MAX_QUEUED_INTERVALS * 2),
+    downloadingInterval(nullptr),
+    currentInterval(nullptr),
     processingLastPartOfInterval(false)
 {
-}
-
-int NinjamTrackNode::getSampleRate() const
-{
-    return decoder.getSampleRate();
+    internalInputBuffer.setFrameLenght(MAX_INPUT_FRAMES);// preallocated, not used by the audio thread yet
+    internalInputBuffer.setFrameLenght(0);
 }
 
 NinjamTrackNode::~NinjamTrackNode()
 {
+    // the track is not processed by the audio thread anymore
+    foreach (NinjamIntervalDecoder *interval, allIntervals) {
+        decodingThread->removeDecoder(interval);
+        delete interval;
+    }
+    qDeleteAll(reusedIntervals);
 }
 
 void NinjamTrackNode::discardIntervals()
 {
-    QMutexLocker locker(&mutex);
-    intervals.clear();
+    // the audio thread skip the discarded intervals, the playing interval is not affected (see
+    // NinjamIntervalDecoder::startPlaying())
+    foreach (NinjamIntervalDecoder *interval, allIntervals)
+        interval->discard();
     qDebug() << "intervals discarded";
 }
 
 bool NinjamTrackNode::startNewInterval()
 {
-    QMutexLocker locker(&mutex);
+    // called from audio thread, the intervals are just moved between the lock-free queues
+    if (currentInterval) {
+        playedIntervals.push(currentInterval);// if the queue is full the interval is deleted with the track
+        currentInterval = nullptr;
+    }
+
+    NinjamIntervalDecoder *nextInterval = nullptr;
+    while (intervals.peek(nextInterval) && nextInterval->isDiscarded()) {
+        intervals.pop(nextInterval);
+        playedIntervals.push(nextInterval);
+    }
 
-    if (!intervals.isEmpty()) {
-        decoder.setInput(intervals.front());
-        intervals.removeFirst();
-        decoder.reset();// head the headers from new interval
+    // only fully downloaded intervals are played, like when the whole interval was decoded in the audio thread
+    if (intervals.peek(nextInterval) && nextInterval->isFullyDownloaded()
+        && nextInterval->startPlaying()) {// fail if it was discarded now, skipped in the next call
+        intervals.pop(currentInterval);
+        if (!playing)
+            resampler.reset();// discard the samples from the last played interval
         playing = true;
     } else {
         playing = false;
@@ -45,59 +69,154 @@ bool NinjamTrackNode::startNewInterval()
     return playing;
 }
 
-void NinjamTrackNode::addVorbisEncodedInterval(QByteArray vorbisData)
+void NinjamTrackNode::addEncodedChunk(const QByteArray &encodedData, bool isFirstPart,
+                                      bool isLastPart)
+{
+    releasePlayedIntervals();
+
+    if (isFirstPart) {
+        if (downloadingInterval) {// the last download was interrupted, play what was downloaded
+            downloadingInterval->addEncodedData(QByteArray(), true);
+            downloadingInterval = nullptr;
+        }
+        Audio::IntervalCodec codec = Audio::IntervalCodecs::detect(encodedData);
+        if (!Audio::IntervalCodecs::isSupported(codec))
+            codec = Audio::IntervalCodec::VORBIS;// corrupted data is handled by the vorbis decoder like before
+        NinjamIntervalDecoder *newInterval = createInterval(codec);
+        if (!intervals.push(newInterval)) {
+            qWarning() << "Too many intervals queued in ninjam track" << ID;
+            releaseInterval(newInterval);
+            return;
+        }
+        allIntervals.append(newInterval);
+        decodingThread->addDecoder(newInterval);
+        downloadingInterval = newInterval;
+    }
+
+    if (!downloadingInterval)
+        return;// the first part was not received
+
+    downloadingInterval->addEncodedData(encodedData, isLastPart);
+    decodingThread->wakeUp();
+    if (isLastPart)
+        downloadingInterval = nullptr;
+}
+
+void NinjamTrackNode::setProfileName(const QString &name)
+{
+    Audio::AudioNode::setProfileName(name);
+    decodeTimes.setName(name + " / decode");
+    resampleTimes.setName(name + " / resample");
+}
+
+void NinjamTrackNode::countUnderrun()
+{
+    // only the audio thread writes, load + store avoid the locked instruction
+    underruns.store(underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+NinjamIntervalDecoder *NinjamTrackNode::createInterval(Audio::IntervalCodec codec)
 {
-    QMutexLocker locker(&mutex);
-    intervals.append(vorbisData);// enqueue a new interval
+    for (int i = 0; i < reusedIntervals.size(); ++i) {
+        if (reusedIntervals.at(i)->getCodec() == codec)
+            return reusedIntervals.takeAt(i);
+    }
+    return new NinjamIntervalDecoder(codec, decodeTimes);
+}
+
+void NinjamTrackNode::releasePlayedIntervals()
+{
+    NinjamIntervalDecoder *interval;
+    while (playedIntervals.pop(interval))
+        releaseInterval(interval);
+}
+
+void NinjamTrackNode::releaseInterval(NinjamIntervalDecoder *interval)
+{
+    if (interval == downloadingInterval) {// discarded while downloading
+        interval->addEncodedData(QByteArray(), true);
+        downloadingInterval = nullptr;
+    }
+    decodingThread->removeDecoder(interval);
+    allIntervals.removeOne(interval);
+    if (reusedIntervals.size() < MAX_REUSED_INTERVALS) {
+        interval->reset();// not used by the audio thread or the decoding thread anymore
+        reusedIntervals.append(interval);
+    } else {
+        delete interval;
+    }
 }
 
 // ++++++++++++++++++++++++++++++++++++++
 
-int NinjamTrackNode::getFramesToProcess(int targetSampleRate, int outFrameLenght)
+void NinjamTrackNode::processCulled(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &discarded,
+                                    int sampleRate, const Midi::MidiBuffer &midiBuffer)
 {
-    return needResamplingFor(targetSampleRate) ? getInputResamplingLength(
-        getSampleRate(), targetSampleRate, outFrameLenght) : outFrameLenght;
+    Q_UNUSED(in);
+    Q_UNUSED(midiBuffer);
+    if (!culled) {
+        culled = true;
+        lastPeak.zero();
+        skippedFramesRemainder = 0;
+    }
+    if (!playing || !currentInterval)
+        return;
+
+    int intervalSampleRate = currentInterval->getSampleRate();
+    if (intervalSampleRate <= 0)
+        return;// the vorbis headers are not decoded yet
+
+    // the position in the interval is the same as if the samples were rendered
+    double framesToSkip = (double)discarded.getFrameLenght() * intervalSampleRate / sampleRate
+                          + skippedFramesRemainder;
+    int skippedFrames = currentInterval->skip((int)framesToSkip);
+    skippedFramesRemainder = skippedFrames == (int)framesToSkip ? framesToSkip - skippedFrames : 0;
 }
 
 void NinjamTrackNode::processReplacing(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out,
                                        int sampleRate, const Midi::MidiBuffer &midiBuffer)
 {
-    if (!playing)
+    if (culled) {// the resampler history is older than the skipped samples
+        culled = false;
+        resampler.reset();
+    }
+
+    if (!playing || !currentInterval)
         return;
 
-    int totalDecoded = 0;
-    int framesToDecode = getFramesToProcess(sampleRate, out.getFrameLenght());
-    internalInputBuffer.setFrameLenght(framesToDecode);
-    internalInputBuffer.zero();
-    while (totalDecoded < framesToDecode) {
-        const Audio::SamplesBuffer &decodedBuffer = decoder.decode(framesToDecode - totalDecoded);
-        if (decodedBuffer.getFrameLenght() > 0) {
-            internalInputBuffer.add(decodedBuffer, totalDecoded);// total decoded is the offset
-            totalDecoded += decodedBuffer.getFrameLenght();
-        } else {// no more samples to decode
-            break;
-        }
+    int intervalSampleRate = currentInterval->getSampleRate();
+    if (intervalSampleRate <= 0) {// the vorbis headers are not decoded yet
+        countUnderrun();
+        return;
     }
+    this->sampleRate.store(intervalSampleRate);
 
-    if (totalDecoded > 0) {
-        internalInputBuffer.setFrameLenght(totalDecoded);
-
-        if (needResamplingFor(sampleRate)) {
-            const Audio::SamplesBuffer &resampledBuffer = resampler.resample(internalInputBuffer,
-                                                                             out.getFrameLenght());
-            internalInputBuffer.setFrameLenght(resampledBuffer.getFrameLenght());
-            internalInputBuffer.set(resampledBuffer);
-            if (internalInputBuffer.getFrameLenght() != out.getFrameLenght())
-                qWarning() << internalInputBuffer.getFrameLenght() << " != "
-                           << out.getFrameLenght();
-        }
-        Audio::AudioNode::processReplacing(in, out, sampleRate, midiBuffer);// process internal buffer pan, gain, etc
+    bool needResampling = intervalSampleRate != sampleRate;
+    int framesToRead = out.getFrameLenght();
+    if (needResampling) {
+        resampler.setSampleRates(intervalSampleRate, sampleRate);
+        framesToRead = resampler.getInputFramesFor(out.getFrameLenght());
+    }
+    if (framesToRead > MAX_INPUT_FRAMES) {// the internal buffer is not reallocated
+        framesToRead = MAX_INPUT_FRAMES;
+        countUnderrun();
     }
-}
 
-bool NinjamTrackNode::needResamplingFor(int targetSampleRate) const
-{
-    if (playing && decoder.isInitialized())
-        return decoder.getSampleRate() != targetSampleRate;
-    return false;
+    // the samples were decoded in the decoding thread, just copy
+    internalInputBuffer.setFrameLenght(framesToRead);
+    int framesRead = currentInterval->read(internalInputBuffer, framesToRead);
+    if (framesRead < framesToRead && !currentInterval->isFinished())
+        countUnderrun();
+    if (framesRead <= 0)
+        return;
+    internalInputBuffer.setFrameLenght(framesRead);
+
+    if (needResampling) {
+        Audio::ProfileScope profileScope(resampleTimes);
+        const Audio::SamplesBuffer &resampledBuffer = resampler.resample(internalInputBuffer,
+                                                                         out.getFrameLenght());
+        internalInputBuffer.setFrameLenght(resampledBuffer.getFrameLenght());
+        internalInputBuffer.set(resampledBuffer);
+    }
+    Audio::AudioNode::processReplacing(in, out, sampleRate, midiBuffer);// process internal buffer pan, gain, etc
 }
@@ -2,9 +2,14 @@
 #define NINJAMTRACKNODE_H
 
 #include "core/AudioNode.h"
+#include "core/SpscQueue.h"
 #include <QByteArray>
-#include "vorbis/VorbisDecoder.h"
+#include <QList>
 #include "SamplesBufferResampler.h"
+#include <atomic>
+
+class NinjamIntervalDecoder;
+class NinjamIntervalDecodingThread;
 
 namespace Audio {
 class SamplesBuffer;
@@ -14,18 +19,29 @@ class StreamBuffer;
 class NinjamTrackNode : public Audio::AudioNode
 {
 public:
-    explicit NinjamTrackNode(int ID);
+    NinjamTrackNode(int ID, NinjamIntervalDecodingThread *decodingThread);
     virtual ~NinjamTrackNode();
-    void addVorbisEncodedInterval(QByteArray encodedBytes);
+
+    // called by the main thread for each downloaded chunk, the interval is decoded while downloading.
+    // The codec (vorbis or opus) is detected in the first chunk of each interval.
+    void addEncodedChunk(const QByteArray &encodedBytes, bool isFirstPart, bool isLastPart);
     void processReplacing(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out, int sampleRate,
                           const Midi::MidiBuffer &midiBuffer);
+
+    // muted track, the decoded samples are skipped (no copies, resampling or gains)
+    void processCulled(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &discarded,
+                       int sampleRate, const Midi::MidiBuffer &midiBuffer);
     bool startNewInterval();
     inline int getID() const
     {
         return ID;
     }
 
-    int getSampleRate() const;
+    inline int getSampleRate() const
+    {
+        return sampleRate.load();
+    }
+
     inline bool isPlaying() const
     {
         return playing;
@@ -37,16 +53,49 @@ public:
         this->processingLastPartOfInterval = status;
     }
 
+    void setProfileName(const QString &name);
+
+    // rendered blocks missing samples because the decoding thread was late
+    inline quint64 getUnderruns() const
+    {
+        return underruns.load();
+    }
+
 private:
-    bool playing;// playing one interval or waiting for more vorbis data to decode
-    VorbisDecoder decoder;
-    QList<QByteArray> intervals;
+    static const int MAX_QUEUED_INTERVALS = 16;
+    static const int MAX_REUSED_INTERVALS = 2;// the downloading interval and the next one
+
+    // the input buffer is preallocated for the worst resampling ratio, the audio thread never
+    // allocates. Bigger reads (like 192 KHz intervals) are clamped and counted as underruns.
+    static const int MAX_FRAMES = 4096;// the audio mixer max block size
+    static const int MAX_INTERVAL_SAMPLE_RATE = 96000;
+    static const int MIN_SAMPLE_RATE = 44100;
+    static const int MAX_INPUT_FRAMES = MAX_FRAMES * MAX_INTERVAL_SAMPLE_RATE / MIN_SAMPLE_RATE
+                                        + 256;// + the resampler filter taps
+
+    bool playing;// playing one interval or waiting for more encoded data to decode
     int ID;
     SamplesBufferResampler resampler;
+    std::atomic<int> sampleRate;// the sample rate of the current interval
+    std::atomic<quint64> underruns;// written only by the audio thread
+    bool culled;// the last block was skipped by processCulled()
+    double skippedFramesRemainder;// fraction of interval frame not skipped yet when resampling
+
+    Audio::ProfileHistogram decodeTimes;// written by the decoding thread
+    Audio::ProfileHistogram resampleTimes;
 
-    bool needResamplingFor(int targetSampleRate) const;
+    NinjamIntervalDecodingThread *decodingThread;
+    Audio::SpscQueue<NinjamIntervalDecoder *> intervals;// main thread -> audio thread
+    Audio::SpscQueue<NinjamIntervalDecoder *> playedIntervals;// audio thread -> main thread, the audio thread never delete intervals
+    QList<NinjamIntervalDecoder *> allIntervals;// owned by the main thread
+    QList<NinjamIntervalDecoder *> reusedIntervals;// played intervals ready to decode the next ones, main thread
+    NinjamIntervalDecoder *downloadingInterval;// main thread
+    NinjamIntervalDecoder *currentInterval;// audio thread
 
-    int getFramesToProcess(int targetSampleRate, int outFrameLenght);
+    NinjamIntervalDecoder *createInterval(Audio::IntervalCodec codec);
+    void releaseInterval(NinjamIntervalDecoder *interval);
+    void releasePlayedIntervals();
+    void countUnderrun();
 
     bool processingLastPartOfInterval;
 };
@@ -2,6 +2,7 @@
 #include "codec.h"
 #include "core/AudioDriver.h"
 #include "core/SamplesBuffer.h"
+#include "core/RtViolationDetector.h"
 #include "log/Logging.h"
 
 #include <QNetworkAccessManager>
@@ -12,27 +13,68 @@
 #include <QBuffer>
 #include <QObject>
 #include <QDateTime>
+#include <QThread>
 #include <QWaitCondition>
+#include <climits>
 #include <cmath>
-#include <QMutexLocker>
-#include <QFile>
 
 using namespace Audio;
 
 const int AbstractMp3Streamer::MAX_BYTES_PER_DECODING = 2048;
 
+namespace Audio {
+class Mp3DecodingThread : public QThread
+{
+public:
+    explicit Mp3DecodingThread(AbstractMp3Streamer *streamer) :
+        streamer(streamer)
+    {
+        start();
+    }
+
+protected:
+    void run()
+    {
+        streamer->decodingLoop();
+    }
+
+private:
+    AbstractMp3Streamer *streamer;
+};
+}
+
 // +++++++++++++
 AbstractMp3Streamer::AbstractMp3Streamer(Audio::Mp3Decoder *decoder) :
+    stopDecoding(false),
+    flushRequested(false),
+    sampleRate(44100),
+    decodedBytes(0),
+    decodedFrames(0),
+    playing(false),
+    playbackRate(1),
+    framesToDrop(0),
+    wasPlaying(false),
     decoder(decoder),
     device(nullptr),
+    bytesToDecodeOffset(0),
+    adaptiveBuffering(false),
     streaming(false),
-    bufferedSamples(2, 4096)
+    decodedSamples(2, PRE_RENDERED_FRAMES)
 {
-    bufferedSamples.setFrameLenght(0);// reset internal offset
+    arrivalsClock.start();
+    setMaxBlockSize(DEFAULT_MAX_BLOCK_SIZE);
+    decodingThread = new Mp3DecodingThread(this);
 }
 
 AbstractMp3Streamer::~AbstractMp3Streamer()
 {
+    {
+        Audio::RtCheckedMutexLocker locker(&mutex);
+        stopDecoding = true;
+        hasBytesToDecode.wakeAll();
+    }
+    decodingThread->wait();
+    delete decodingThread;
     delete decoder;
 }
 
@@ -40,23 +82,32 @@ void AbstractMp3Streamer::stopCurrentStream()
 {
     qCDebug(jtNinjamRoomStreamer) << "stopping room stream";
 
+    Audio::RtCheckedMutexLocker locker(&mutex);// wait the decoding thread
     if (device) {
         decoder->reset();// discard unprocessed bytes
         device->deleteLater();
         device = nullptr;
-        bufferedSamples.zero();// discard samples
-        streaming = false;
+        streaming.store(false);
     }
     bytesToDecode.clear();
+    bytesToDecodeOffset = 0;
+    jitterBuffer.reset();
+    jitterBuffer.setByteRate(0);// the next stream can use another bitrate
+    decodedBytes = 0;
+    decodedFrames = 0;
+    playing.store(false);
+    playbackRate.store(1);
+    framesToDrop.store(0);
+    flushRequested.store(true);// the decoded samples are discarded in the audio thread
     lastPeak.zero();
 }
 
 int AbstractMp3Streamer::getSamplesToRender(int targetSampleRate, int outLenght)
 {
-    bool needResampling = needResamplingFor(targetSampleRate);
-    int samplesToRender = needResampling ? getInputResamplingLength(
-        getSampleRate(), targetSampleRate, outLenght) : outLenght;
-    return samplesToRender;
+    if (!needResamplingFor(targetSampleRate))
+        return outLenght;
+    resampler.setSampleRates(getSampleRate(), targetSampleRate);
+    return resampler.getInputFramesFor(outLenght);
 }
 
 void AbstractMp3Streamer::processReplacing(const Audio::SamplesBuffer &in,
@@ -65,15 +116,42 @@ void AbstractMp3Streamer::processReplacing(const Audio::SamplesBuffer &in,
 {
     Q_UNUSED(in);
 
-    if (bufferedSamples.isEmpty() || !streaming)
+    if (flushRequested.load()) {// the decoding thread is not writing until the flag is cleared
+        decodedSamples.skip(decodedSamples.getAvailableFrames());
+        resampler.reset();// discard the samples from the stopped stream
+        wasPlaying = false;
+        flushRequested.store(false);
+    }
+
+    if (!playing.load()) {// buffering
+        wasPlaying = false;
+        return;
+    }
+
+    if (!streaming.load() || decodedSamples.getAvailableFrames() == 0)
         return;
 
+    resampler.setPlaybackRate(playbackRate.load());
     int samplesToRender = getSamplesToRender(targetSampleRate, out.getFrameLenght());
     if (samplesToRender <= 0)
         return;
 
     internalInputBuffer.setFrameLenght(samplesToRender);
-    internalInputBuffer.set(bufferedSamples);
+    int renderedSamples = decodedSamples.read(internalInputBuffer, samplesToRender);
+    if (renderedSamples < samplesToRender) {
+        qCDebug(jtNinjamRoomStreamer) << samplesToRender - renderedSamples
+                                      << " samples missing, the decoding thread is late";
+        internalInputBuffer.setFrameLenght(renderedSamples);
+        internalInputBuffer.fade(wasPlaying ? 1 : 0, 0);// avoid a click in the gap
+        wasPlaying = false;
+    } else {
+        int frames = framesToDrop.exchange(0);
+        if (frames > 0)
+            dropFrames(internalInputBuffer, frames);
+        if (!wasPlaying)
+            internalInputBuffer.fade(0, 1);// starting after a stop or a buffering
+        wasPlaying = true;
+    }
 
     if (needResamplingFor(targetSampleRate)) {
         const Audio::SamplesBuffer &resampledBuffer = resampler.resample(internalInputBuffer,
@@ -81,65 +159,179 @@ void AbstractMp3Streamer::processReplacing(const Audio::SamplesBuffer &in,
         internalOutputBuffer.setFrameLenght(resampledBuffer.getFrameLenght());
         internalOutputBuffer.set(resampledBuffer);
     } else {
-        internalOutputBuffer.setFrameLenght(out.getFrameLenght());
+        internalOutputBuffer.setFrameLenght(internalInputBuffer.getFrameLenght());
         internalOutputBuffer.set(internalInputBuffer);
     }
 
-    qCDebug(jtNinjamRoomStreamer) << "discarding " << samplesToRender << " samples";
-    bufferedSamples.discardFirstSamples(samplesToRender);// keep non rendered samples for next audio callback
-
-    if (internalOutputBuffer.getFrameLenght() < out.getFrameLenght())
-        qCDebug(jtNinjamRoomStreamer) << out.getFrameLenght()
-            - internalOutputBuffer.getFrameLenght() << " samples missing";
-
     this->lastPeak.update(internalOutputBuffer.computePeak());
 
     out.add(internalOutputBuffer);
 }
 
+AbstractMp3Streamer::CrossfadeBuffer::CrossfadeBuffer(int maxFrames) :
+    samples(2, maxFrames),
+    maxFrames(maxFrames)
+{
+}
+
+void AbstractMp3Streamer::setMaxBlockSize(int frames)
+{
+    // the input frames are more than the callback frames when downsampling, like 48 KHz streams
+    // played in 22 or 24 KHz
+    int maxFrames = frames * 2;
+    if (crossfadeBuffer && crossfadeBuffer->maxFrames >= maxFrames)
+        return;
+    CrossfadeBuffer *newBuffer = new CrossfadeBuffer(maxFrames);
+    audioCrossfadeBuffer.modify([newBuffer](CrossfadeBuffer *&buffer){
+        buffer = newBuffer;
+    });
+    crossfadeBuffer.reset(newBuffer);// the audio thread can't see the old buffer
+}
+
+void AbstractMp3Streamer::dropFrames(Audio::SamplesBuffer &buffer, int frames)
+{
+    Audio::SnapshotPublisher<CrossfadeBuffer *>::Reader currentBuffer(audioCrossfadeBuffer);
+    CrossfadeBuffer *crossfade = *currentBuffer;
+
+    // 'buffer' fades out and the block after the dropped frames fades in
+    int lenght = buffer.getFrameLenght();
+    if (lenght > crossfade->maxFrames)
+        return;// the excess is dropped again by the decoding thread in the next update
+    frames = std::min(frames, (int)decodedSamples.getAvailableFrames() - lenght);
+    if (frames <= 0)
+        return;
+
+    decodedSamples.skip(frames);
+    crossfade->samples.setFrameLenght(lenght);
+    decodedSamples.read(crossfade->samples, lenght);
+    buffer.fade(1, 0);
+    crossfade->samples.fade(0, 1);
+    buffer.add(crossfade->samples);
+}
+
 void AbstractMp3Streamer::initialize(QString streamPath)
 {
-    streaming = !streamPath.isNull() && !streamPath.isEmpty();
+    streaming.store(!streamPath.isNull() && !streamPath.isEmpty());
 }
 
 int AbstractMp3Streamer::getSampleRate() const
 {
-    return decoder->getSampleRate();
+    return sampleRate.load();
 }
 
 bool AbstractMp3Streamer::needResamplingFor(int targetSampleRate) const
 {
-    if (!streaming)
+    if (!streaming.load())
         return false;
     return targetSampleRate != getSampleRate();
 }
 
-void AbstractMp3Streamer::decode(const unsigned int maxBytesToDecode)
+StreamJitterBuffer::Health AbstractMp3Streamer::getBufferHealth()
 {
-    if (!device)
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    return jitterBuffer.getHealth(getBufferedMs());
+}
+
+int AbstractMp3Streamer::getBufferedMs() const
+{
+    // decoded samples and downloaded bytes waiting the decoding
+    double decodedMs = decodedSamples.getAvailableFrames() * 1000.0 / sampleRate.load();
+    double downloadedMs = (bytesToDecode.size() - bytesToDecodeOffset) * 1000.0
+                          / jitterBuffer.getByteRate();
+    return (int)(decodedMs + downloadedMs);
+}
+
+void AbstractMp3Streamer::appendBytesToDecode(const QByteArray &bytes)
+{
+    if (adaptiveBuffering)
+        jitterBuffer.addArrival(arrivalsClock.elapsed(), bytes.size());
+
+    if (bytesToDecodeOffset > 0) {// remove the decoded bytes only here, not in each decoding
+        bytesToDecode.remove(0, bytesToDecodeOffset);
+        bytesToDecodeOffset = 0;
+    }
+    bytesToDecode.append(bytes);
+    hasBytesToDecode.wakeAll();
+}
+
+bool AbstractMp3Streamer::decodeAhead()
+{
+    if (!device || flushRequested.load())
+        return false;// the audio thread is discarding the samples of the stopped stream
+
+    int bytesAvailable = bytesToDecode.size() - bytesToDecodeOffset;
+    bool decoded = false;
+    while (decodedSamples.getFreeFrames() >= (unsigned int)Mp3Decoder::MAX_DECODED_FRAMES) {
+        // split in chunks to avoid a very large decoded buffer
+        int bytesToProcess = std::min(bytesAvailable, MAX_BYTES_PER_DECODING);
+        const Audio::SamplesBuffer *decodedBuffer
+            = decoder->decode(bytesToDecode.constData() + bytesToDecodeOffset, bytesToProcess);
+        bytesToDecodeOffset += bytesToProcess;
+        bytesAvailable -= bytesToProcess;
+        decodedBytes += bytesToProcess;
+        if (decodedBuffer->isEmpty()) {
+            if (bytesToProcess == 0)
+                break;// waiting for more bytes
+            continue;
+        }
+        sampleRate.store(decoder->getSampleRate());
+        decodedSamples.write(*decodedBuffer);
+        decodedFrames += decodedBuffer->getFrameLenght();
+        decoded = true;
+    }
+
+    if (decodedFrames >= sampleRate.load())// at least one second to measure the byte rate
+        jitterBuffer.setByteRate((double)decodedBytes * sampleRate.load() / decodedFrames);
+
+    updatePlayback();
+    return decoded;
+}
+
+void AbstractMp3Streamer::updatePlayback()
+{
+    if (!adaptiveBuffering) {
+        playing.store(true);// just play the decoded samples
         return;
-    qint64 totalBytesToProcess = std::min((int)maxBytesToDecode, bytesToDecode.size());
-    char *in = bytesToDecode.data();
-
-    if (totalBytesToProcess > 0) {
-        int bytesProcessed = 0;
-        while (bytesProcessed < totalBytesToProcess) {// split bytesReaded in chunks to avoid a very large decoded buffer
-            // chunks maxsize is 2048 bytes
-            int bytesToProcess = std::min((int)(totalBytesToProcess - bytesProcessed),
-                                          MAX_BYTES_PER_DECODING);
-            const Audio::SamplesBuffer *decodedBuffer = decoder->decode(in, bytesToProcess);
-
-            // prepare in for the next decoding
-            in += bytesToProcess;
-            bytesProcessed += bytesToProcess;
-            // +++++++++++++++++  PROCESS DECODED SAMPLES ++++++++++++++++
-            bufferedSamples.append(*decodedBuffer);
+    }
+
+    // all the downloaded bytes were decoded when the ring buffer is empty, the remaining bytes
+    // are an incomplete mp3 frame
+    int bufferedMs = decodedSamples.getAvailableFrames() > 0 ? getBufferedMs() : 0;
+    bool wasBuffering = jitterBuffer.isBuffering();
+    bool play = jitterBuffer.update(bufferedMs);
+    if (wasBuffering && play) {
+        qCDebug(jtNinjamRoomStreamer) << "buffered " << bufferedMs << "ms, playing";
+    } else if (!wasBuffering && !play) {
+        qCDebug(jtNinjamRoomStreamer) << "no more samples, buffering "
+                                      << jitterBuffer.getTargetMs() << "ms";
+    }
+    playing.store(play);
+    playbackRate.store(jitterBuffer.getPlaybackRate(bufferedMs));
+
+    // large excess is dropped from the decoded samples, keeping some frames to the crossfade
+    int excessMs = jitterBuffer.getExcessMs(bufferedMs);
+    if (excessMs > 0 && framesToDrop.load() == 0) {
+        int rate = sampleRate.load();
+        int maxFrames = (int)decodedSamples.getAvailableFrames() - Mp3Decoder::MAX_DECODED_FRAMES;
+        int frames = std::min((int)((qint64)excessMs * rate / 1000), maxFrames);
+        if (frames > 0) {
+            jitterBuffer.addDroppedMs((int)((qint64)frames * 1000 / rate));
+            framesToDrop.store(frames);
         }
+    }
+}
 
-        bytesToDecode = bytesToDecode.right(bytesToDecode.size() - bytesProcessed);
-        if (bytesToDecode.isEmpty())
-            qCDebug(jtNinjamRoomStreamer) << bytesProcessed << " decoded  bytesToDecode: "
-                                          << bytesToDecode.size();
+void AbstractMp3Streamer::decodingLoop()
+{
+    Audio::RtCheckedMutexLocker locker(&mutex);
+    while (!stopDecoding) {
+        if (decodeAhead()) {
+            locker.unlock();// give a chance to the main thread append the downloaded bytes
+            locker.relock();
+        } else if (!stopDecoding) {
+            // the ring buffer is refilled periodically while the audio thread consumes it
+            hasBytesToDecode.wait(&mutex, device ? REFILL_PERIOD : ULONG_MAX);
+        }
     }
 }
 
@@ -153,34 +345,30 @@ void AbstractMp3Streamer::setStreamPath(QString streamPath)
 NinjamRoomStreamerNode::NinjamRoomStreamerNode(QUrl streamPath, int bufferTimeInSeconds) :
     AbstractMp3Streamer(new Mp3DecoderMiniMp3()),
     httpClient(nullptr),
-    bufferTime(bufferTimeInSeconds),
-    buffering(false)
+    bufferTime(bufferTimeInSeconds)
 {
+    adaptiveBuffering = true;
     setStreamPath(streamPath.toString());
 }
 
 NinjamRoomStreamerNode::NinjamRoomStreamerNode(int bufferTimeInSeconds) :
     AbstractMp3Streamer(new Mp3DecoderMiniMp3()),
     httpClient(nullptr),
-    bufferTime(bufferTimeInSeconds),
-    buffering(false)
+    bufferTime(bufferTimeInSeconds)
 {
+    adaptiveBuffering = true;
     setStreamPath("");
 }
 
 bool NinjamRoomStreamerNode::needResamplingFor(int targetSampleRate) const
 {
-    if (!streaming)
-        return false;
-    return AbstractMp3Streamer::needResamplingFor(targetSampleRate);
+    Q_UNUSED(targetSampleRate);
+    return streaming.load();// always resampling, the jitter buffer changes the playback rate
 }
 
 void NinjamRoomStreamerNode::initialize(QString streamPath)
 {
     AbstractMp3Streamer::initialize(streamPath);
-    buffering = true;
-    bufferedSamples.zero();
-    bytesToDecode.clear();
     if (!streamPath.isEmpty()) {
         qCDebug(jtNinjamRoomStreamer) << "connecting in " << streamPath;
         if (httpClient)
@@ -190,6 +378,7 @@ void NinjamRoomStreamerNode::initialize(QString streamPath)
         QObject::connect(reply, SIGNAL(readyRead()), this, SLOT(on_reply_read()));
         QObject::connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this,
                          SLOT(on_reply_error(QNetworkReply::NetworkError)));
+        Audio::RtCheckedMutexLocker locker(&mutex);
         this->device = reply;
     }
 }
@@ -208,10 +397,13 @@ void NinjamRoomStreamerNode::on_reply_read()
         return;
     }
     if (device->isOpen() && device->isReadable()) {
-        QMutexLocker locker(&mutex);
-        bytesToDecode.append(device->readAll());
-        qCDebug(jtNinjamRoomStreamer) << "bytes downloaded  bytesToDecode:"<<bytesToDecode.size()
-                                      << " bufferedSamples: " << bufferedSamples.getFrameLenght();
+        QByteArray bytes = device->readAll();
+        Audio::RtCheckedMutexLocker locker(&mutex);
+        appendBytesToDecode(bytes);
+        qCDebug(jtNinjamRoomStreamer) << "bytes downloaded  bytesToDecode:"
+                                      << bytesToDecode.size() - bytesToDecodeOffset
+                                      << " decodedSamples: " << decodedSamples.getAvailableFrames()
+                                      << " jitter: " << jitterBuffer.getJitterMs() << "ms";
     } else {
         qCCritical(jtNinjamRoomStreamer) << "problem in device!";
     }
@@ -222,59 +414,6 @@ NinjamRoomStreamerNode::~NinjamRoomStreamerNode()
     qCDebug(jtNinjamRoomStreamer) << "RoomStreamerNode destructor!";
 }
 
-void NinjamRoomStreamerNode::processReplacing(const SamplesBuffer &in, SamplesBuffer &out,
-                                              int sampleRate, const Midi::MidiBuffer &midiBuffer)
-{
-    Q_UNUSED(in)
-    QMutexLocker locker(&mutex);
-    if (buffering && bytesToDecode.size() >= 120000)
-        buffering = false;
-    if (!buffering && bytesToDecode.isEmpty())
-        buffering = true;
-    if (buffering)
-        return;
-    int samplesToRender = getSamplesToRender(sampleRate, out.getFrameLenght());
-    while (bufferedSamples.getFrameLenght() < samplesToRender) {// need decoding?
-        decode(256);
-        if (bytesToDecode.isEmpty()) {// no more bytes to decode
-            qCritical() << "BREAK";
-            break;
-        }
-    }
-    if (!bufferedSamples.isEmpty())
-        AbstractMp3Streamer::processReplacing(in, out, sampleRate, midiBuffer);
-}
-
-// ++++++++++++++++++
-AudioFileStreamerNode::AudioFileStreamerNode(QString file) :
-    AbstractMp3Streamer(new Mp3DecoderMiniMp3())
-{
-    setStreamPath(file);
-}
-
-void AudioFileStreamerNode::initialize(QString streamPath)
-{
-    AbstractMp3Streamer::initialize(streamPath);
-    QFile *f = new QFile(streamPath);
-    if (!f->open(QIODevice::ReadOnly))
-        qCCritical(jtNinjamRoomStreamer) << "error opening the file " << streamPath;
-    this->device = f;
-    bytesToDecode.append(f->readAll());
-}
-
-AudioFileStreamerNode::~AudioFileStreamerNode()
-{
-}
-
-void AudioFileStreamerNode::processReplacing(const SamplesBuffer &in, SamplesBuffer &out,
-                                             int sampleRate, const Midi::MidiBuffer &midiBuffer)
-{
-    while (bufferedSamples.getFrameLenght() < out.getFrameLenght())
-        decode(1024 + 1024);
-
-    AbstractMp3Streamer::processReplacing(in, out, sampleRate, midiBuffer);
-}
-
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++/*
 
 TestStreamerNode::TestStreamerNode(int sampleRate) :
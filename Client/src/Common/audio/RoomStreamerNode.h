@@ -2,19 +2,41 @@
 #define ROOM_STREAMER_NODE_H
 
 #include "core/AudioNode.h"
+#include "core/SamplesRingBuffer.h"
 #include <QNetworkReply>
 #include <QNetworkAccessManager>
+#include <QWaitCondition>
 // #include <deque>
 #include "SamplesBufferResampler.h"
+#include "StreamJitterBuffer.h"
+#include "core/SnapshotPublisher.h"
+#include <QScopedPointer>
+#include <QElapsedTimer>
+#include <atomic>
 
 class QIODevice;
 
 namespace Audio {
 class Mp3Decoder;
-
+class Mp3DecodingThread;
+
+/**
+ * The mp3 stream is decoded by a background thread in a ring buffer, ahead of the playback. The
+ * audio thread only read the decoded samples, there is no decoding or locks in processReplacing().
+ *
+ * The downloaded bytes and the decoder are protected by 'mutex', used by the main thread and
+ * the decoding thread.
+ *
+ * With 'adaptiveBuffering' the playback start and the underruns are controlled by a
+ * StreamJitterBuffer: the decoding thread compare the buffered duration with the jitter buffer
+ * target and the audio thread follow the decided playback rate and drop the excess with a
+ * crossfade. Without it the samples are played as soon as they are decoded.
+ */
 class AbstractMp3Streamer : public AudioNode
 {
     Q_OBJECT
+    friend class Mp3DecodingThread;
+
 public:
     explicit AbstractMp3Streamer(Audio::Mp3Decoder *decoder);
     ~AbstractMp3Streamer();
@@ -24,27 +46,68 @@ public:
     virtual void setStreamPath(QString streamPath);
     inline bool isStreaming() const
     {
-        return streaming;
+        return streaming.load();
     }
 
     virtual int getSampleRate() const;
     virtual bool needResamplingFor(int targetSampleRate) const;
+
+    StreamJitterBuffer::Health getBufferHealth();
+
+    // the biggest audio callback of the driver, the crossfade buffer is allocated here and not in
+    // the audio thread
+    void setMaxBlockSize(int frames);
 signals:
     void error(QString errorMsg);
 private:
     static const int MAX_BYTES_PER_DECODING;
+    static const int PRE_RENDERED_FRAMES = 65536;// ~1.5 seconds in 44.1 KHz
+    static const unsigned long REFILL_PERIOD = 10;// milliseconds
+    static const int DEFAULT_MAX_BLOCK_SIZE = 4096;
+
+    struct CrossfadeBuffer
+    {
+        explicit CrossfadeBuffer(int maxFrames);
+        Audio::SamplesBuffer samples;
+        int maxFrames;// the resampled streams read more frames than the audio callback frames
+    };
+
+    Mp3DecodingThread *decodingThread;
+    QWaitCondition hasBytesToDecode;
+    bool stopDecoding;// protected by 'mutex'
+    std::atomic<bool> flushRequested;// the audio thread discard the samples of the stopped stream
+    std::atomic<int> sampleRate;
+
+    StreamJitterBuffer jitterBuffer;// protected by 'mutex'
+    QElapsedTimer arrivalsClock;
+    qint64 decodedBytes;// measure the stream byte rate, protected by 'mutex'
+    qint64 decodedFrames;
+    std::atomic<bool> playing;// false while the jitter buffer is buffering
+    std::atomic<float> playbackRate;
+    std::atomic<int> framesToDrop;
+    bool wasPlaying;// audio thread, fade in after the buffering
+    QScopedPointer<CrossfadeBuffer> crossfadeBuffer;
+    Audio::SnapshotPublisher<CrossfadeBuffer *> audioCrossfadeBuffer;// used by the audio thread
+
+    bool decodeAhead();// decoding thread, 'mutex' is locked
+    void decodingLoop();
+    void updatePlayback();// decoding thread, 'mutex' is locked
+    int getBufferedMs() const;// 'mutex' is locked
+    void dropFrames(Audio::SamplesBuffer &buffer, int frames);// audio thread
 
 protected:
     Audio::Mp3Decoder *decoder;
 
     QIODevice *device;
-    void decode(const unsigned int maxBytesToDecode);
-    QByteArray bytesToDecode;
+    QByteArray bytesToDecode;// downloaded bytes, protected by 'mutex'
+    int bytesToDecodeOffset;// the decoded bytes are removed when new bytes are appended
+    bool adaptiveBuffering;// set in the constructor
     virtual void initialize(QString streamPath);
-    bool streaming;
-    SamplesBuffer bufferedSamples;
-    SamplesBufferResampler resampler;
+    std::atomic<bool> streaming;
+    SamplesRingBuffer decodedSamples;// decoding thread -> audio thread
+    SamplesBufferResampler resampler;// audio thread
 
+    void appendBytesToDecode(const QByteArray &bytes);// 'mutex' is locked
     int getSamplesToRender(int targetSampleRate, int outLenght);
 };
 
@@ -58,33 +121,17 @@ public:
     explicit NinjamRoomStreamerNode(int bufferTimeInSeconds = 3);
     ~NinjamRoomStreamerNode();
 
-    virtual void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
-                                  const Midi::MidiBuffer &midiBuffer);
     virtual bool needResamplingFor(int targetSampleRate) const;
 protected:
     void initialize(QString streamPath);
 private:
     QNetworkAccessManager *httpClient;
     int bufferTime;// in seconds
-    bool buffering;
 
 private slots:
     void on_reply_error(QNetworkReply::NetworkError);
     void on_reply_read();
 };
-// ++++++++++++++++++++++++++++
-class AudioFileStreamerNode : public AbstractMp3Streamer
-{
-protected:
-    void initialize(QString streamPath);
-
-public:
-    explicit AudioFileStreamerNode(QString file);
-    ~AudioFileStreamerNode();
-    virtual void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
-                                  const Midi::MidiBuffer &midiBuffer);
-};
-
 // ++++++++++++++++++++++
 
 class TestStreamerNode : public AbstractMp3Streamer
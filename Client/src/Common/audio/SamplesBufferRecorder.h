@@ -1,22 +1,72 @@
 #ifndef SAMPLESBUFFERRECORDER_H
 #define SAMPLESBUFFERRECORDER_H
 
-#include "core/SamplesBuffer.h"
+#include "core/SamplesRingBuffer.h"
+#include "core/RtSemaphore.h"
 #include <QString>
-#include <QByteArray>
+#include <QScopedPointer>
+#include <atomic>
 
+namespace Audio {
+class AudioFileWriter;
+}
+class SamplesBufferRecorderThread;
+
+/**
+ * Records the audio thread samples (the local input) in a WAV or FLAC file.
+ *
+ * addSamples() only copies the samples to a lock-free ring buffer, it never allocates, locks or
+ * touches the disk. A low priority disk thread converts the samples (SIMD, optional dither) and
+ * streams them to the file, so the memory used is constant for any recording length. The WAV
+ * header is updated each HEADER_UPDATE_PERIOD seconds, the file is valid if the application crash.
+ *
+ * When the disk can't keep up and the ring buffer is full the new samples are discarded and
+ * counted in getDroppedFrames().
+ */
 class SamplesBufferRecorder
 {
+    friend class SamplesBufferRecorderThread;
+
 public:
-    SamplesBufferRecorder(QString fileName, quint32 sampleRate);
-    ~SamplesBufferRecorder();
-    void addSamples(const Audio::SamplesBuffer &buffer);
+    // the format is selected by the file extension (see Audio::AudioFileWriter::create())
+    SamplesBufferRecorder(const QString &filePath, int sampleRate, int channels = 2,
+                          int bitsPerSample = 16, bool dither = true);
+    ~SamplesBufferRecorder();// the buffered samples are written and the file is closed
+
+    inline bool isRecording() const// false if the file can't be created
+    {
+        return writer != nullptr;
+    }
+
+    void addSamples(const Audio::SamplesBuffer &buffer);// audio thread
+
+    inline quint64 getDroppedFrames() const
+    {
+        return droppedFrames.load(std::memory_order_relaxed);
+    }
+
+    inline qint64 getWrittenFrames() const
+    {
+        return writtenFrames.load(std::memory_order_relaxed);
+    }
+
+    static const int RING_BUFFER_SECONDS = 4;
+    static const int HEADER_UPDATE_PERIOD = 2;// seconds
+    static const int DISK_BLOCK_FRAMES = 8192;// the disk thread is waked when a block is available
+
 private:
-    void writeSamplesToFile();
-    void writeWavHeader();
-    QByteArray array;
-    QString fileName;
-    quint32 sampleRate;
+    QString filePath;
+    Audio::AudioFileWriter *writer;
+    Audio::SamplesRingBuffer ringBuffer;
+    Audio::RtSemaphore samplesAvailable;
+    std::atomic<bool> diskThreadWaiting;
+    std::atomic<bool> stopRequested;
+    std::atomic<quint64> droppedFrames;
+    std::atomic<qint64> writtenFrames;
+    QScopedPointer<SamplesBufferRecorderThread> diskThread;
+
+    void diskLoop();// disk thread
+    bool writeAvailableSamples(Audio::SamplesBuffer &block);
 };
 
 #endif // SAMPLESBUFFERRECORDER_H
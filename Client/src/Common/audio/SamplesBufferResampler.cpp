@@ -1,27 +1,268 @@
 #include "SamplesBufferResampler.h"
+#include "core/SamplesBufferKernels.h"
 #include <algorithm>
+#include <cmath>
 #include <QDebug>
 
-SamplesBufferResampler::SamplesBufferResampler() :
-    outBuffer(2, 4096 * 2)
+namespace {
+struct QualityPreset
 {
+    int halfTaps;
+    double kaiserBeta;// stop band attenuation
+    double rolloff;// cutoff frequency relative to the lowest nyquist frequency
+};
+
+const QualityPreset PRESETS[] = {
+    {8, 6.0, 0.85},// LOW_LATENCY
+    {16, 8.0, 0.90},// NORMAL
+    {32, 10.0, 0.94}// HIGH
+};
+
+double besselI0(double x)// zero order modified bessel function, used in kaiser window
+{
+    double sum = 1;
+    double term = 1;
+    double halfX = x/2;
+    for (int k = 1; k < 50; ++k) {
+        term *= (halfX/k) * (halfX/k);
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+const double PI = 3.14159265358979323846;
+const int MAX_INPUT_FRAMES = 4096 * 2;
+const int MAX_OUTPUT_FRAMES = 4096 * 2;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++
+
+SamplesBufferResampler::SamplesBufferResampler(Quality quality) :
+    quality(quality),
+    sourceSampleRate(0),
+    targetSampleRate(0),
+    playbackRate(1),
+    step(1),
+    position(0),
+    halfTaps(PRESETS[quality].halfTaps),
+    silentFrames(0),
+    history(2, PRESETS[quality].halfTaps * 2 + MAX_INPUT_FRAMES),// the input is appended to the history
+    outBuffer(2, MAX_OUTPUT_FRAMES)
+{
+    reset();
 }
 
 SamplesBufferResampler::~SamplesBufferResampler()
 {
 }
 
+void SamplesBufferResampler::setQuality(Quality quality)
+{
+    if (this->quality == quality)
+        return;
+    this->quality = quality;
+    if (sourceSampleRate > 0 && targetSampleRate > 0) {
+        buildFilter();
+    } else {// the filter is built when the sample rates are setted
+        halfTaps = PRESETS[quality].halfTaps;
+        reset();
+    }
+}
+
+void SamplesBufferResampler::setSampleRates(int sourceSampleRate, int targetSampleRate)
+{
+    if (sourceSampleRate == this->sourceSampleRate && targetSampleRate == this->targetSampleRate)
+        return;
+    if (sourceSampleRate <= 0 || targetSampleRate <= 0) {
+        qCritical() << "invalid sample rates " << sourceSampleRate << targetSampleRate;
+        return;
+    }
+    this->sourceSampleRate = sourceSampleRate;
+    this->targetSampleRate = targetSampleRate;
+    buildFilter();
+}
+
+void SamplesBufferResampler::setPlaybackRate(double rate)
+{
+    if (rate == playbackRate)
+        return;
+    playbackRate = rate;
+    if (sourceSampleRate > 0 && targetSampleRate > 0)
+        step = (double)sourceSampleRate/targetSampleRate * playbackRate;
+}
+
+void SamplesBufferResampler::buildFilter()
+{
+    step = (double)sourceSampleRate/targetSampleRate;
+    const QualityPreset &preset = PRESETS[quality];
+
+    // when downsampling the filter is wider to keep the same transition band
+    halfTaps = (int)std::ceil(preset.halfTaps * std::max(1.0, step));
+    double cutoff = preset.rolloff * std::min(1.0, 1.0/step);// relative to input nyquist
+
+    int taps = halfTaps * 2;
+    filter.assign((PHASES + 1) * taps, 0);
+    double windowNormalization = besselI0(preset.kaiserBeta);
+    for (int phase = 0; phase <= PHASES; ++phase) {
+        float *coefficients = &filter[phase * taps];
+        double fraction = (double)phase/PHASES;
+        double sum = 0;
+        for (int t = 0; t < taps; ++t) {
+            double x = t - halfTaps + 1 - fraction;// distance (in input frames) to the output frame
+            double sinc = (x == 0) ? 1.0 : std::sin(PI * cutoff * x)/(PI * cutoff * x);
+            double r = x/halfTaps;
+            double window = (std::fabs(r) < 1) ? besselI0(
+                preset.kaiserBeta * std::sqrt(1 - r * r))/windowNormalization : 0;
+            coefficients[t] = cutoff * sinc * window;
+            sum += coefficients[t];
+        }
+        for (int t = 0; t < taps; ++t)// unity gain in DC
+            coefficients[t] /= sum;
+    }
+
+    step *= playbackRate;
+
+    // the history is not reallocated when the input blocks are appended in the audio thread
+    history.setFrameLenght(taps + MAX_INPUT_FRAMES);
+    reset();
+}
+
+void SamplesBufferResampler::reset()
+{
+    // the first output frame is aligned with the first input frame, the history starts with zeros
+    history.setFrameLenght(0);
+    history.setFrameLenght(halfTaps - 1);
+    history.zero();
+    silentFrames = history.getFrameLenght();
+    position = halfTaps - 1;
+}
+
+int SamplesBufferResampler::getInputFramesFor(int outFrames) const
+{
+    if (outFrames <= 0)
+        return 0;
+    double lastPosition = position + (outFrames - 1) * step;
+    int framesNeeded = (int)lastPosition + halfTaps + 1 - history.getFrameLenght();
+    return std::max(0, framesNeeded + 1);// +1 to avoid missing frames by double rounding
+}
+
 const Audio::SamplesBuffer &SamplesBufferResampler::resample(const Audio::SamplesBuffer &in,
                                                              int desiredOutLenght)
 {
-    outBuffer.zero();
-    outBuffer.setFrameLenght(desiredOutLenght * 2);// enough space
-    int channels = std::min(in.getChannels(), outBuffer.getChannels());
-    for (int c = 0; c < channels; ++c) {
-        float *input = in.getSamplesArray(c);
-        float *output = outBuffer.getSamplesArray(c);
-        resamplers[c].process(input, in.getFrameLenght(), output, desiredOutLenght);
+    if (in.getChannels() != history.getChannels()) {// mono <-> stereo
+        if (in.isMono()) {
+            history.setToMono();
+            outBuffer.setToMono();
+        } else {
+            history.setToStereo();
+            outBuffer.setToStereo();
+        }
+        reset();
+    }
+
+    // the output buffer is not reallocated in the audio thread
+    desiredOutLenght = std::max(0, std::min(desiredOutLenght, MAX_OUTPUT_FRAMES));
+
+    if (sourceSampleRate <= 0 || targetSampleRate <= 0) {// sample rates not setted, just copy
+        outBuffer.setFrameLenght(std::min(desiredOutLenght, in.getFrameLenght()));// no old samples in the end
+        outBuffer.set(in);
+        return outBuffer;
     }
+
+    // the input is appended in chunks fitting in the preallocated history. The input frames not
+    // fitting in the history when the output is complete are discarded, the caller used much more
+    // than getInputFramesFor().
+    const int maxHistoryLenght = halfTaps * 2 + MAX_INPUT_FRAMES;
+    const int inputLenght = in.getFrameLenght();
     outBuffer.setFrameLenght(desiredOutLenght);
+    int inputOffset = 0;
+    int rendered = 0;
+    bool silentOutput = true;
+    do {
+        int framesToAppend = std::min(inputLenght - inputOffset,
+                                      maxHistoryLenght - history.getFrameLenght());
+        appendToHistory(in, inputOffset, framesToAppend);
+        inputOffset += framesToAppend;
+        silentOutput = silentOutput && history.isSilent();
+
+        int renderedFrames = render(rendered, desiredOutLenght - rendered);
+        rendered += renderedFrames;
+        if (framesToAppend == 0 && renderedFrames == 0)
+            break;
+    } while (inputOffset < inputLenght);
+
+    outBuffer.setFrameLenght(rendered);
+    if (silentOutput)
+        outBuffer.zero();// keep the silent flag
     return outBuffer;
 }
+
+void SamplesBufferResampler::appendToHistory(const Audio::SamplesBuffer &in, int inputOffset,
+                                             int frames)
+{
+    if (frames <= 0)
+        return;
+    const int historyLenght = history.getFrameLenght();
+    history.setFrameLenght(historyLenght + frames);// preallocated, the new samples are zeroed
+    history.set(in, inputOffset, frames, historyLenght);
+    if (in.isSilent())
+        silentFrames += frames;
+    else
+        silentFrames = 0;
+    if (silentFrames >= history.getFrameLenght())
+        history.zero();// only silence in the filter input
+}
+
+int SamplesBufferResampler::render(int firstOutputFrame, int maxFrames)
+{
+    const int taps = halfTaps * 2;
+    const int historyLenght = history.getFrameLenght();
+    const int channels = history.getChannels();
+    int rendered = 0;
+    if (history.isSilent()) {// the output is silent too, just advance the position
+        while (rendered < maxFrames && (int)position + halfTaps < historyLenght) {
+            rendered++;
+            position += step;
+        }
+        for (int c = 0; c < channels && rendered > 0; ++c)
+            std::fill_n(outBuffer.getSamplesArray(c) + firstOutputFrame, rendered, 0.0f);
+    } else {
+        const Audio::Kernels::Functions &kernels = Audio::Kernels::get();
+        const float *historySamples[2];
+        float *outSamples[2];
+        for (int c = 0; c < channels; ++c) {
+            historySamples[c] = history.getReadOnlySamplesArray(c);
+            outSamples[c] = outBuffer.getSamplesArray(c) + firstOutputFrame;
+        }
+        while (rendered < maxFrames) {
+            int inputIndex = (int)position;
+            if (inputIndex + halfTaps >= historyLenght)
+                break;// no more input samples
+
+            double phase = (position - inputIndex) * PHASES;
+            int phaseIndex = (int)phase;
+            float interpolation = (float)(phase - phaseIndex);
+            const float *coefficients = &filter[phaseIndex * taps];
+            const float *nextCoefficients = coefficients + taps;
+            for (int c = 0; c < channels; ++c) {
+                const float *input = historySamples[c] + inputIndex - halfTaps + 1;
+                float value = kernels.dotProduct(coefficients, input, taps);
+                float nextValue = kernels.dotProduct(nextCoefficients, input, taps);
+                outSamples[c][rendered] = value + (nextValue - value) * interpolation;
+            }
+            rendered++;
+            position += step;
+        }
+    }
+
+    // discard the input samples not used by the next output frames
+    int consumedFrames = std::min((int)position - halfTaps + 1, historyLenght);
+    if (consumedFrames > 0) {
+        history.discardFirstSamples(consumedFrames);
+        position -= consumedFrames;
+    }
+
+    return rendered;
+}
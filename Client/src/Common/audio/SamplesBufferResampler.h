@@ -1,18 +1,75 @@
 #ifndef SAMPLESBUFFERRESAMPLER_H
 #define SAMPLESBUFFERRESAMPLER_H
 
-#include "Resampler.h"
 #include "core/SamplesBuffer.h"
+#include <vector>
 
+/**
+ * Streaming band-limited resampler (polyphase windowed sinc).
+ *
+ * The input samples not consumed in one resample() call are kept for the next call, so
+ * the streams are continuous between the audio callbacks. Use getInputFramesFor() to know
+ * how many input frames are necessary to render the next block. When the filter input is silent
+ * the output is just zeroed (see SamplesBuffer::isSilent()).
+ */
 class SamplesBufferResampler
 {
 public:
-    SamplesBufferResampler();
+    enum Quality {
+        LOW_LATENCY,// 16 taps
+        NORMAL,     // 32 taps
+        HIGH        // 64 taps, used in offline resampling
+    };
+
+    explicit SamplesBufferResampler(Quality quality = NORMAL);
     ~SamplesBufferResampler();
+
+    void setSampleRates(int sourceSampleRate, int targetSampleRate);// the filter is rebuilt only if the rates changed
+    void setQuality(Quality quality);
+
+    // varispeed, the input is consumed 'rate' times faster. Only for small changes (like +-5%),
+    // the filter is not rebuilt and the stored samples are kept.
+    void setPlaybackRate(double rate);
+    void reset();// discard the stored input samples
+
+    // how many input frames are necessary to produce 'outFrames'
+    int getInputFramesFor(int outFrames) const;
+
+    // input frames read ahead by the filter
+    inline int getLatency() const
+    {
+        return halfTaps;
+    }
+
+    inline Quality getQuality() const
+    {
+        return quality;
+    }
+
+    // the returned buffer can be shorter than 'desiredOutLenght' if 'in' has not enough samples.
+    // Up to 8192 frames are rendered in each call.
     const Audio::SamplesBuffer &resample(const Audio::SamplesBuffer &in, int desiredOutLenght);
+
 private:
+    static const int PHASES = 256;// filter phases between two input samples
+
+    Quality quality;
+    int sourceSampleRate;
+    int targetSampleRate;
+    double playbackRate;
+    double step;// input frames per output frame
+    double position;// position of the next output frame in 'history'
+    int halfTaps;
+    int silentFrames;// silent input frames in the end of 'history'
+
+    std::vector<float> filter;// PHASES + 1 rows, 2 * halfTaps coefficients per row
+
+    Audio::SamplesBuffer history;// input samples not consumed yet
     Audio::SamplesBuffer outBuffer;
-    ResamplerTest resamplers[2];
+
+    void buildFilter();
+    void appendToHistory(const Audio::SamplesBuffer &in, int inputOffset, int frames);
+    int render(int firstOutputFrame, int maxFrames);// return the rendered frames
 };
 
 #endif // SAMPLESBUFFERRESAMPLER_H
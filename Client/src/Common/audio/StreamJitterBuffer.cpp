@@ -0,0 +1,171 @@
+#include "StreamJitterBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Audio;
+
+const float StreamJitterBuffer::MAX_RATE_DEVIATION = 0.02f;// ~1/3 semitone in the extremes
+const double StreamJitterBuffer::DEFAULT_BYTE_RATE = 128000 / 8;
+
+namespace {
+const float RATE_DEAD_BAND = 0.2f;// relative to the target, no rate changes near the target
+const float RATE_GAIN = 0.05f;
+const int UNDERRUN_PENALTY_DECAY = 30;// the penalty decreases 1 ms every 30 ms of stable stream
+}
+
+StreamJitterBuffer::StreamJitterBuffer() :
+    byteRate(0),
+    underrunPenaltyMs(0),
+    underruns(0),
+    droppedMs(0)
+{
+    reset();
+}
+
+void StreamJitterBuffer::reset()
+{
+    buffering = true;
+    arrivals = 0;
+    firstArrivalTime = 0;
+    lastArrivalTime = 0;
+    receivedBytes = 0;
+    jitter = 0;
+    lastArrivals.clear();
+}
+
+void StreamJitterBuffer::setByteRate(double bytesPerSecond)
+{
+    byteRate = bytesPerSecond;
+}
+
+double StreamJitterBuffer::getByteRate() const
+{
+    return getEffectiveByteRate();
+}
+
+double StreamJitterBuffer::getEffectiveByteRate() const
+{
+    if (byteRate > 0)
+        return byteRate;
+    qint64 elapsed = lastArrivalTime - firstArrivalTime;
+    if (arrivals >= MIN_ARRIVALS && elapsed >= 2000)
+        return receivedBytes * 1000.0 / elapsed;// the average download rate
+    return DEFAULT_BYTE_RATE;
+}
+
+double StreamJitterBuffer::getTransitTime(qint64 arrivalTime, qint64 byte, double byteRate)
+{
+    return arrivalTime - byte * 1000.0 / byteRate;
+}
+
+void StreamJitterBuffer::addArrival(qint64 timeMs, int bytes)
+{
+    if (arrivals == 0)
+        firstArrivalTime = timeMs;
+
+    Arrival arrival = {timeMs, receivedBytes, receivedBytes + bytes};
+    if (!lastArrivals.isEmpty()) {
+        // RFC 3550 interarrival jitter, the difference between the arrival gap and the media gap
+        double rate = getEffectiveByteRate();
+        const Arrival &last = lastArrivals.last();
+        double deviation = std::fabs(getTransitTime(timeMs, arrival.endByte, rate)
+                                     - getTransitTime(last.time, last.endByte, rate));
+        jitter += (deviation - jitter) / 16;
+
+        qint64 gap = timeMs - lastArrivalTime;
+        underrunPenaltyMs = std::max(0, underrunPenaltyMs - (int)(gap / UNDERRUN_PENALTY_DECAY));
+    }
+    if (lastArrivals.size() == ARRIVALS_WINDOW)
+        lastArrivals.remove(0);
+    lastArrivals.append(arrival);
+
+    receivedBytes += bytes;
+    lastArrivalTime = timeMs;
+    arrivals++;
+}
+
+int StreamJitterBuffer::getDelaySpreadMs() const
+{
+    // The first byte of each chunk must be played only after the arrival, so the buffer must cover
+    // the latest chunk start since the earliest chunk end. Computed with the current byte rate,
+    // the rate is refined while the stream is playing.
+    double rate = getEffectiveByteRate();
+    double minTransit = 0;
+    double maxTransit = 0;
+    for (int i = 0; i < lastArrivals.size(); ++i) {
+        const Arrival &arrival = lastArrivals.at(i);
+        double endTransit = getTransitTime(arrival.time, arrival.endByte, rate);
+        double startTransit = getTransitTime(arrival.time, arrival.firstByte, rate);
+        if (i == 0 || endTransit < minTransit)
+            minTransit = endTransit;
+        if (i == 0 || startTransit > maxTransit)
+            maxTransit = startTransit;
+    }
+    return (int)(maxTransit - minTransit);
+}
+
+int StreamJitterBuffer::getTargetMs() const
+{
+    int target = INITIAL_TARGET_MS;
+    if (arrivals >= MIN_ARRIVALS)
+        target = getDelaySpreadMs() + (int)(2 * jitter) + SAFETY_MARGIN_MS;
+    return qBound((int)MIN_TARGET_MS, target + underrunPenaltyMs, (int)MAX_TARGET_MS);
+}
+
+bool StreamJitterBuffer::update(int bufferedMs)
+{
+    if (buffering) {
+        if (bufferedMs >= getTargetMs())
+            buffering = false;
+    } else if (bufferedMs <= 0) {// the stream is late, buffer again with a larger target
+        buffering = true;
+        underruns++;
+        underrunPenaltyMs = std::min(underrunPenaltyMs + UNDERRUN_PENALTY_MS, (int)MAX_UNDERRUN_PENALTY_MS);
+    }
+    return !buffering;
+}
+
+float StreamJitterBuffer::getPlaybackRate(int bufferedMs) const
+{
+    if (buffering)
+        return 1;
+
+    int target = getTargetMs();
+    float error = (float)(bufferedMs - target) / target;
+    if (std::fabs(error) <= RATE_DEAD_BAND)
+        return 1;
+
+    error += error > 0 ? -RATE_DEAD_BAND : RATE_DEAD_BAND;
+    return 1 + qBound(-MAX_RATE_DEVIATION, error * RATE_GAIN, MAX_RATE_DEVIATION);
+}
+
+int StreamJitterBuffer::getExcessMs(int bufferedMs) const
+{
+    if (buffering)
+        return 0;
+
+    // the excess is dropped only when the rate changes would take too long
+    int target = getTargetMs();
+    if (bufferedMs > target + std::max(target, 2000))
+        return bufferedMs - target;
+    return 0;
+}
+
+void StreamJitterBuffer::addDroppedMs(int droppedMs)
+{
+    this->droppedMs += droppedMs;
+}
+
+StreamJitterBuffer::Health StreamJitterBuffer::getHealth(int bufferedMs) const
+{
+    Health health;
+    health.bufferedMs = bufferedMs;
+    health.targetMs = getTargetMs();
+    health.jitterMs = jitter;
+    health.delaySpreadMs = getDelaySpreadMs();
+    health.playbackRate = getPlaybackRate(bufferedMs);
+    health.buffering = buffering;
+    health.underruns = underruns;
+    health.droppedMs = droppedMs;
+    return health;
+}
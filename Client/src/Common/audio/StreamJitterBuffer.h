@@ -0,0 +1,111 @@
+#ifndef STREAM_JITTER_BUFFER_H
+#define STREAM_JITTER_BUFFER_H
+
+#include <QtGlobal>
+#include <QVector>
+
+namespace Audio {
+/**
+ * Adaptive playout of a live stream (the room preview). The arrivals of the downloaded chunks
+ * are compared with a constant rate stream to measure the network jitter, and the buffered
+ * duration target (in milliseconds) follows the measured jitter instead of a fixed amount of
+ * bytes: fast links start playing quickly and slow or bursty links buffer more.
+ *
+ * When playing, small deviations from the target are corrected changing the playback rate
+ * (getPlaybackRate()), large excess is dropped (getExcessMs()) and only when the buffer is empty
+ * the stream is buffered again. Every underrun increases the target.
+ *
+ * This class has no synchronization and no clock, the times are passed by the caller.
+ */
+class StreamJitterBuffer
+{
+public:
+    struct Health
+    {
+        int bufferedMs;// decoded and downloaded, not played yet
+        int targetMs;
+        float jitterMs;// mean deviation of the arrivals from a constant rate stream
+        int delaySpreadMs;// the buffered duration needed to play the last chunks without gaps
+        float playbackRate;
+        bool buffering;
+        quint64 underruns;
+        quint64 droppedMs;
+    };
+
+    static const int MIN_TARGET_MS = 250;
+    static const int MAX_TARGET_MS = 8000;
+    static const int INITIAL_TARGET_MS = 1500;// used until some chunks are received
+    static const float MAX_RATE_DEVIATION;// the playback rate is in [1 - deviation, 1 + deviation]
+
+    StreamJitterBuffer();
+
+    void reset();// new stream, the underrun penalty is kept
+
+    void addArrival(qint64 timeMs, int bytes);
+
+    // the stream bytes per second, measured in the decoder. The arrival average is used until
+    // the first decoded samples.
+    void setByteRate(double bytesPerSecond);
+    double getByteRate() const;
+
+    // update the buffering state, return true when the stream must be played
+    bool update(int bufferedMs);
+
+    inline bool isBuffering() const
+    {
+        return buffering;
+    }
+
+    int getTargetMs() const;
+    float getPlaybackRate(int bufferedMs) const;
+    int getExcessMs(int bufferedMs) const;// buffered duration that can be dropped
+    void addDroppedMs(int droppedMs);
+
+    inline float getJitterMs() const
+    {
+        return jitter;
+    }
+
+    int getDelaySpreadMs() const;
+
+    inline quint64 getUnderruns() const
+    {
+        return underruns;
+    }
+
+    Health getHealth(int bufferedMs) const;
+
+private:
+    static const int ARRIVALS_WINDOW = 64;
+    static const int MIN_ARRIVALS = 8;// to trust the measured jitter
+    static const int SAFETY_MARGIN_MS = 150;
+    static const int UNDERRUN_PENALTY_MS = 500;
+    static const int MAX_UNDERRUN_PENALTY_MS = 4000;
+    static const double DEFAULT_BYTE_RATE;// 128 kbps
+
+    bool buffering;
+    int arrivals;
+    qint64 firstArrivalTime;
+    qint64 lastArrivalTime;
+    qint64 receivedBytes;
+    double byteRate;// 0 until measured in the decoder
+    float jitter;
+
+    struct Arrival
+    {
+        qint64 time;
+        qint64 firstByte;// the position of the chunk in the stream
+        qint64 endByte;
+    };
+    QVector<Arrival> lastArrivals;// the last ARRIVALS_WINDOW chunks
+    int underrunPenaltyMs;
+    quint64 underruns;
+    quint64 droppedMs;
+
+    double getEffectiveByteRate() const;
+    // arrival time - media time of the byte
+    static double getTransitTime(qint64 arrivalTime, qint64 byte, double byteRate);
+};
+}
+
+#endif // STREAM_JITTER_BUFFER_H
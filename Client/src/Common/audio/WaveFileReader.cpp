@@ -0,0 +1,145 @@
+#include "WaveFileReader.h"
+#include "core/SamplesBuffer.h"
+#include "log/Logging.h"
+#include <QFile>
+#include <QtEndian>
+#include <cstring>
+
+using namespace Audio;
+
+namespace {
+const quint16 FORMAT_PCM = 1;
+const quint16 FORMAT_FLOAT = 3;
+const quint16 FORMAT_EXTENSIBLE = 0xFFFE;
+}
+
+SamplesBuffer *WaveFileReader::read(const QString &fileName, int &sampleRate)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(jtAudio) << "Can't open the WAV file" << fileName;
+        return nullptr;
+    }
+    SamplesBuffer *samples = read(file.readAll(), sampleRate);
+    if (!samples)
+        qCWarning(jtAudio) << "Can't read the samples in" << fileName;
+    return samples;
+}
+
+/*
+ RIFF header:
+ Offset Type        Field
+ 0x0    uint8_t[4]  "RIFF"
+ 0x4    uint32_t    Size
+ 0x8    uint8_t[4]  "WAVE", followed by the chunks (id, size and data)
+
+ fmt chunk:
+ 0x0    uint16_t    Format
+ 0x2    uint16_t    Channels
+ 0x4    uint32_t    Sample rate
+ 0x8    uint32_t    Bytes per second
+ 0xc    uint16_t    Block align
+ 0xe    uint16_t    Bits per sample
+ 0x18   uint16_t    Sub format (first bytes of the GUID, extensible format only)
+ */
+SamplesBuffer *WaveFileReader::read(const QByteArray &fileContent, int &sampleRate)
+{
+    Format format;
+    if (!readFormat((const uchar *)fileContent.constData(), fileContent.size(), format))
+        return nullptr;
+
+    const int frames = format.getFrames();
+    SamplesBuffer *samples = new SamplesBuffer(format.channels, frames);
+    if (!decode(format, (const uchar *)fileContent.constData() + format.dataOffset, frames, *samples)) {
+        delete samples;
+        return nullptr;
+    }
+    sampleRate = format.sampleRate;
+    return samples;
+}
+
+bool WaveFileReader::readFormat(const uchar *content, qint64 size, Format &format)
+{
+    if (size < 12 || std::memcmp(content, "RIFF", 4) != 0 || std::memcmp(content + 8, "WAVE", 4) != 0)
+        return false;
+
+    format.format = 0;
+    format.channels = 0;
+    format.sampleRate = 0;
+    format.bitsPerSample = 0;
+    format.dataOffset = 0;
+    format.dataSize = 0;
+    qint64 position = 12;
+    while (position + 8 <= size && !format.dataOffset) {
+        const uchar *chunk = content + position;
+        qint64 chunkSize = qFromLittleEndian<quint32>(chunk + 4);
+        const uchar *body = chunk + 8;
+        qint64 available = size - position - 8;
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && available >= 16) {
+            format.format = qFromLittleEndian<quint16>(body);
+            format.channels = qFromLittleEndian<quint16>(body + 2);
+            format.sampleRate = qFromLittleEndian<quint32>(body + 4);
+            format.bitsPerSample = qFromLittleEndian<quint16>(body + 14);
+            if (format.format == FORMAT_EXTENSIBLE && chunkSize >= 26 && available >= 26)
+                format.format = qFromLittleEndian<quint16>(body + 24);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            format.dataOffset = position + 8;
+            format.dataSize = qMin(chunkSize, available);// truncated files are accepted
+        }
+        position += 8 + chunkSize + (chunkSize & 1);// the chunks are word aligned
+    }
+
+    return format.dataOffset && format.channels > 0 && format.sampleRate > 0
+           && format.bitsPerSample >= 8;
+}
+
+bool WaveFileReader::decode(const Format &format, const uchar *data, int frames,
+                            SamplesBuffer &samples)
+{
+    const int channels = format.channels;
+    const int bitsPerSample = format.bitsPerSample;
+    const int bytesPerSample = bitsPerSample / 8;
+    if (format.format == FORMAT_PCM && bitsPerSample == 8) {
+        decode(data, frames, channels, bytesPerSample, samples, [](const uchar *sample) {
+            return (*sample - 128) / 128.0f;// unsigned
+        });
+    } else if (format.format == FORMAT_PCM && bitsPerSample == 16) {
+        decode(data, frames, channels, bytesPerSample, samples, [](const uchar *sample) {
+            return qFromLittleEndian<qint16>(sample) / 32768.0f;
+        });
+    } else if (format.format == FORMAT_PCM && bitsPerSample == 24) {
+        decode(data, frames, channels, bytesPerSample, samples, [](const uchar *sample) {
+            qint32 value = (qint32)((quint32)sample[0] << 8 | (quint32)sample[1] << 16
+                                    | (quint32)sample[2] << 24);
+            return value / 2147483648.0f;
+        });
+    } else if (format.format == FORMAT_PCM && bitsPerSample == 32) {
+        decode(data, frames, channels, bytesPerSample, samples, [](const uchar *sample) {
+            return qFromLittleEndian<qint32>(sample) / 2147483648.0f;
+        });
+    } else if (format.format == FORMAT_FLOAT && bitsPerSample == 32) {
+        decode(data, frames, channels, bytesPerSample, samples, [](const uchar *sample) {
+            quint32 bits = qFromLittleEndian<quint32>(sample);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        });
+    } else {
+        qCWarning(jtAudio) << "Unsupported WAV format" << format.format << bitsPerSample << "bits";
+        return false;
+    }
+    return true;
+}
+
+template<typename Decoder>
+void WaveFileReader::decode(const uchar *data, int frames, int channels, int bytesPerSample,
+                            SamplesBuffer &samples, Decoder decoder)
+{
+    const int frameSize = bytesPerSample * channels;
+    for (int c = 0; c < channels; ++c) {
+        float *channelSamples = samples.getSamplesArray(c);
+        const uchar *sample = data + c * bytesPerSample;
+        for (int s = 0; s < frames; ++s, sample += frameSize)
+            channelSamples[s] = decoder(sample);
+    }
+}
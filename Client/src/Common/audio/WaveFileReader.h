@@ -0,0 +1,55 @@
+#ifndef WAVE_FILE_READER_H
+#define WAVE_FILE_READER_H
+
+#include <QString>
+#include <QByteArray>
+
+namespace Audio {
+class SamplesBuffer;
+
+/**
+ * Read the samples of WAV files (or Qt resources) to a SamplesBuffer.
+ *
+ * The RIFF chunks are walked, so files with extra chunks (LIST, fact, cue, etc.) are supported.
+ * The supported formats are PCM 8, 16, 24 and 32 bits, float 32 bits and the extensible
+ * variants of these formats.
+ */
+class WaveFileReader
+{
+public:
+    struct Format
+    {
+        quint16 format;
+        int channels;
+        int sampleRate;
+        int bitsPerSample;
+        qint64 dataOffset;// the samples position in the file
+        qint64 dataSize;
+
+        inline int getFrameSize() const
+        {
+            return (bitsPerSample / 8) * channels;
+        }
+
+        inline qint64 getFrames() const
+        {
+            return dataSize / getFrameSize();
+        }
+    };
+
+    // return nullptr if the file can't be read, the caller owns the returned buffer
+    static SamplesBuffer *read(const QString &fileName, int &sampleRate);
+    static SamplesBuffer *read(const QByteArray &fileContent, int &sampleRate);
+
+    // used to read the samples in parts (streaming, memory mapped files)
+    static bool readFormat(const uchar *content, qint64 size, Format &format);
+    static bool decode(const Format &format, const uchar *data, int frames, SamplesBuffer &samples);
+
+private:
+    template<typename Decoder>
+    static void decode(const uchar *data, int frames, int channels, int bytesPerSample,
+                       SamplesBuffer &samples, Decoder decoder);
+};
+}
+
+#endif // WAVE_FILE_READER_H
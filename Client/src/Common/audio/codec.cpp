@@ -2,27 +2,30 @@
 #include <climits>
 #include "core/AudioDriver.h"
 #include "core/SamplesBuffer.h"
+#include "core/SamplesBufferKernels.h"
 #include <QDebug>
 #include <cmath>
 
 using namespace Audio;
 
 const int Mp3DecoderMiniMp3::MINIMUM_SIZE_TO_DECODE = 1024 + 256;
-const int Mp3DecoderMiniMp3::AUDIO_SAMPLES_BUFFER_MAX_SIZE = 4096 * 2;
 const int Mp3DecoderMiniMp3::INTERNAL_SHORT_BUFFER_SIZE = MP3_MAX_SAMPLES_PER_FRAME *8 * 2;
 
 Mp3DecoderMiniMp3::Mp3DecoderMiniMp3() :
     mp3Decoder(mp3_create()),
-    buffer(nullptr)
+    buffer(nullptr),
+    arrayOffset(0)
 {
     internalShortBuffer = new signed short[INTERNAL_SHORT_BUFFER_SIZE];// recommend by the minimp3 author
+    array.reserve(MINIMUM_SIZE_TO_DECODE * 4);// the capacity is kept when the array is emptied
     reset();
     NULL_BUFFER = new Audio::SamplesBuffer(1);
 }
 
 void Mp3DecoderMiniMp3::reset()
 {
-    array.clear();
+    array.resize(0);
+    arrayOffset = 0;
     for (int i = 0; i < INTERNAL_SHORT_BUFFER_SIZE; ++i)
         internalShortBuffer[i] = 0;
 }
@@ -34,43 +37,51 @@ int Mp3DecoderMiniMp3::getSampleRate() const
     return mp3Info.sample_rate;
 }
 
-const SamplesBuffer *Mp3DecoderMiniMp3::decode(char *inputBuffer, int inputBufferLenght)
+const SamplesBuffer *Mp3DecoderMiniMp3::decode(const char *inputBuffer, int inputBufferLenght)
 {
+    if (arrayOffset > 0 && arrayOffset >= array.size() / 2) {// discard the decoded bytes
+        array.remove(0, arrayOffset);
+        arrayOffset = 0;
+    }
     array.append(inputBuffer, inputBufferLenght);
-    if (array.size() < MINIMUM_SIZE_TO_DECODE)
+    int bytesLeft = array.size() - arrayOffset;
+    if (bytesLeft < MINIMUM_SIZE_TO_DECODE)
         return NULL_BUFFER;
-    int totalBytesDecoded = 0;
-    int bytesDecoded = 0;
     signed short *out = internalShortBuffer;
-    char *in = array.data();
+    char *in = array.data() + arrayOffset;
     int totalSamplesDecoded = 0;
-    int bytesLeft = array.size() - totalBytesDecoded;
+    int framesDecoded = 0;
+    int bytesDecoded = 0;
     do {
+        // the remaining bytes are decoded in the next call when the output is full
+        if (framesDecoded + MAX_FRAMES_PER_MP3_FRAME > MAX_DECODED_FRAMES)
+            break;
         bytesDecoded = mp3_decode((void **)mp3Decoder, in, bytesLeft, out, &mp3Info);
         if (bytesDecoded > 0) {
             bytesLeft -= bytesDecoded;
             in += bytesDecoded;
+            arrayOffset += bytesDecoded;
             int samplesDecoded = mp3Info.audio_bytes/2;
             out += samplesDecoded;
             totalSamplesDecoded += samplesDecoded;
-            totalBytesDecoded += bytesDecoded;
+            framesDecoded = totalSamplesDecoded/mp3Info.channels;
         }
     } while (bytesDecoded > 0 && bytesLeft > 0);
-    array = array.right(array.size() - totalBytesDecoded);// keep just the undecoded bytes to the next call for decode
-    if (totalBytesDecoded <= 0)
+    if (framesDecoded <= 0)
         return NULL_BUFFER;
     // +++++++++++++++++++++++++++
-    int framesDecoded = totalSamplesDecoded/mp3Info.channels;
 
-    if (!buffer)
-        buffer = new Audio::SamplesBuffer(mp3Info.channels);
-    if (framesDecoded > AUDIO_SAMPLES_BUFFER_MAX_SIZE)
-        framesDecoded = AUDIO_SAMPLES_BUFFER_MAX_SIZE;
+    if (!buffer || buffer->getChannels() != mp3Info.channels) {
+        delete buffer;
+        buffer = new Audio::SamplesBuffer(mp3Info.channels, MAX_DECODED_FRAMES);
+    }
     buffer->setFrameLenght(framesDecoded);
-    int internalIndex = 0;
-    for (int i = 0; i < framesDecoded; ++i) {
-        for (int c = 0; c < buffer->getChannels(); ++c)
-            buffer->set(c, i, (float)internalShortBuffer[internalIndex++] / SHRT_MAX);
+    const Kernels::Functions &kernels = Kernels::get();
+    if (mp3Info.channels == 2) {
+        kernels.deinterleaveShorts(buffer->getSamplesArray(0), buffer->getSamplesArray(1),
+                                   internalShortBuffer, framesDecoded);
+    } else {
+        kernels.convertShorts(buffer->getSamplesArray(0), internalShortBuffer, framesDecoded);
     }
 
     return buffer;
@@ -12,7 +12,10 @@ class SamplesBuffer;
 class Mp3Decoder
 {
 public:
-    virtual const Audio::SamplesBuffer *decode(char *inputBuffer, int bytesToDecode) = 0;
+    static const int MAX_DECODED_FRAMES = 4096 * 2;// max frames returned by decode()
+
+    // the returned buffer has the mp3 channels and is empty until a complete mp3 frame is available
+    virtual const Audio::SamplesBuffer *decode(const char *inputBuffer, int bytesToDecode) = 0;
     virtual void reset() = 0;
     virtual int getSampleRate() const = 0;
     virtual ~Mp3Decoder()
@@ -27,20 +30,27 @@ class Mp3DecoderMiniMp3 : public Mp3Decoder
 public:
     Mp3DecoderMiniMp3();
     ~Mp3DecoderMiniMp3();
-    virtual const Audio::SamplesBuffer *decode(char *inputBuffer, int inputBufferLenght);
+    virtual const Audio::SamplesBuffer *decode(const char *inputBuffer, int inputBufferLenght);
     virtual void reset();
     virtual int getSampleRate() const;
+
+    inline int getBufferedBytes() const// received and not decoded yet
+    {
+        return array.size() - arrayOffset;
+    }
+
 private:
     static const int MINIMUM_SIZE_TO_DECODE;
-    static const int AUDIO_SAMPLES_BUFFER_MAX_SIZE;
     static const int INTERNAL_SHORT_BUFFER_SIZE;
+    static const int MAX_FRAMES_PER_MP3_FRAME = MP3_MAX_SAMPLES_PER_FRAME / 2;
     mp3_decoder_t mp3Decoder;
     mp3_info_t
         mp3Info;
     signed short *internalShortBuffer;
     Audio::SamplesBuffer *buffer;
     Audio::SamplesBuffer *NULL_BUFFER;
-    QByteArray array;
+    QByteArray array;// undecoded bytes, the decoded bytes are skipped using 'arrayOffset'
+    int arrayOffset;
 };
 }
 
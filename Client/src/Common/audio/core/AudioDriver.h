@@ -4,6 +4,7 @@
 #include "SamplesBuffer.h"
 #include <QObject>
 #include <QMutex>
+#include <atomic>
 
 namespace Controller {
 class MainController;
@@ -54,6 +55,7 @@ class AudioDriver : public QObject
 
 signals:
     void sampleRateChanged(int newSampleRate);
+    void bufferSizeChanged(int newBufferSize);// changed by the audio API while running
     void stopped();
     void started();
 
@@ -88,6 +90,17 @@ public:
         return bufferSize;
     }
 
+    // latencies reported by the audio API for the running stream, in frames. Zero when unknown.
+    virtual inline int getInputLatency() const
+    {
+        return 0;
+    }
+
+    virtual inline int getOutputLatency() const
+    {
+        return 0;
+    }
+
     virtual QList<int> getValidSampleRates(int deviceIndex) const = 0;
     virtual QList<int> getValidBufferSizes(int deviceIndex) const = 0;
 
@@ -124,7 +137,7 @@ protected:
     int audioDeviceIndex;// using same audio device for input and output
 
     int sampleRate;
-    int bufferSize;
+    std::atomic<int> bufferSize;// can be changed by the audio API threads
 
     QScopedPointer<SamplesBuffer> inputBuffer;
     QScopedPointer<SamplesBuffer> outputBuffer;
@@ -3,66 +3,232 @@
 #include <QDebug>
 #include "Plugins.h"
 #include "midi/MidiDriver.h"
-#include <QMutexLocker>
+#include <QElapsedTimer>
 #include "log/Logging.h"
+#include "RtViolationDetector.h"
 
 using namespace Audio;
 
 AudioMixer::AudioMixer(int sampleRate) :
-    sampleRate(sampleRate)
+    sampleRate(sampleRate),
+    discardedSamples(2, MAX_FRAMES),
+    soloedBuffersInLastProcess(0),
+    mixTimes("Mixer")
 {
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    compileSchedule();// the audio thread always have a schedule
+}
+
+void AudioMixer::compileSchedule()
+{
+    QSharedPointer<RenderSchedule> newSchedule(RenderSchedule::compile(mixerNodes, sources,
+                                                                       MAX_FRAMES));
+    // when modify() returns the audio thread is not using the old schedule (and the removed nodes)
+    schedule.modify([newSchedule](QSharedPointer<RenderSchedule> &currentSchedule) {
+        currentSchedule = newSchedule;
+    });
 }
 
 void AudioMixer::addNode(AudioNode *node)
 {
-    nodes.append(node);
-    resamplers.insert(node, new SamplesBufferResampler());
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    if (mixerNodes.contains(node))
+        return;
+    mixerNodes.append(node);
+    compileSchedule();
 }
 
 void AudioMixer::removeNode(AudioNode *node)
 {
-    SamplesBufferResampler *resampler = resamplers[node];
-    nodes.removeOne(node);
-    if (resampler) {
-        resamplers[node] = nullptr;
-        delete resampler;
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    mixerNodes.removeAll(node);
+    sources.remove(node);
+    QMultiHash<AudioNode *, AudioNode *>::iterator i = sources.begin();
+    while (i != sources.end()) {
+        if (i.value() == node)
+            i = sources.erase(i);
+        else
+            ++i;
+    }
+    compileSchedule();// the caller can delete the node when this function returns
+}
+
+bool AudioMixer::isConnected(AudioNode *source, AudioNode *destination) const
+{
+    foreach (AudioNode *node, sources.values(destination)) {
+        if (node == source || isConnected(source, node))
+            return true;
     }
+    return false;
+}
+
+bool AudioMixer::connect(AudioNode *source, AudioNode *destination)
+{
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    if (source == destination || isConnected(destination, source)) {
+        qCWarning(jtAudio) << "Can't connect the audio nodes, a cycle will be created!";
+        return false;
+    }
+    if (!sources.contains(destination, source)) {
+        sources.insert(destination, source);
+        compileSchedule();
+    }
+    return true;
+}
+
+bool AudioMixer::disconnect(AudioNode *source, AudioNode *destination)
+{
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    if (!sources.remove(destination, source))
+        return false;
+    compileSchedule();
+    return true;
 }
 
 AudioMixer::~AudioMixer()
 {
     qCDebug(jtAudio) << "Audio mixer destructor...";
-    foreach (Audio::AudioNode *node, resamplers.keys())
-        removeNode(node);
+    setRenderThreads(0);
     qCDebug(jtAudio) << "Audio mixer destructor finished!";
 }
 
+void AudioMixer::setRenderThreads(int threads)
+{
+    if (threads == getRenderThreads())
+        return;
+    QSharedPointer<RenderWorkerPool> newPool;
+    if (threads > 0)
+        newPool.reset(new RenderWorkerPool(threads));
+    // the old pool is deleted (and the threads stopped) when the audio thread is not using it
+    renderPool.modify([newPool](QSharedPointer<RenderWorkerPool> &pool) {
+        pool = newPool;
+    });
+}
+
+int AudioMixer::getRenderThreads() const
+{
+    const QSharedPointer<RenderWorkerPool> &pool = renderPool.getCurrent();
+    return pool ? pool->getWorkers() : 0;
+}
+
+void AudioMixer::logRenderTimes()
+{
+    Audio::RtCheckedMutexLocker locker(&graphMutex);
+    foreach (const RenderSchedule::Step &step, schedule.getCurrent()->getSteps()) {
+        AudioNode *node = step.node;
+        qCDebug(jtAudio) << node->metaObject()->className() << node
+                         << "last render time (us):" << node->getLastRenderTime()/1000
+                         << "max render time (us):" << node->getMaxRenderTime()/1000;
+        node->resetRenderTimes();
+    }
+}
+
+bool AudioMixer::canProcess(const AudioNode *node, bool hasSoloedBuffers) const
+{
+    return (!hasSoloedBuffers && !node->isMuted()) || (hasSoloedBuffers && node->isSoloed());
+}
+
 void AudioMixer::process(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
                          const Midi::MidiBuffer &midiBuffer, bool attenuateAfterSumming)
 {
-    static int soloedBuffersInLastProcess = 0;
-    // --------------------------------------
+    ProfileScope profileScope(mixTimes);
+    SnapshotPublisher<QSharedPointer<RenderSchedule> >::Reader scheduleToProcess(schedule);
+    SnapshotPublisher<QSharedPointer<RenderWorkerPool> >::Reader pool(renderPool);
+    const RenderSchedule &currentSchedule = **scheduleToProcess;
+    if (*pool && currentSchedule.getSteps().size() > 1)
+        processInParallel(pool->data(), currentSchedule, in, out, sampleRate, midiBuffer);
+    else
+        processSerially(currentSchedule, in, out, sampleRate, midiBuffer);
+
+    if (attenuateAfterSumming) {
+        int nodesConnected = currentSchedule.getMixedSteps();
+        if (nodesConnected > 1)// attenuate
+            out.applyGain(1.0/nodesConnected, 0.0);
+    }
+}
+
+void AudioMixer::renderStep(const RenderSchedule::Step &step, const SamplesBuffer &in,
+                            SamplesBuffer &out, int sampleRate, const Midi::MidiBuffer &midiBuffer,
+                            bool hasSoloedBuffers)
+{
+    AudioNode *node = step.node;
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+    node->connectedOutputs = step.inputs.isEmpty() ? nullptr : &step.inputs;
+    if (!step.mixed || canProcess(node, hasSoloedBuffers))
+        node->processReplacing(in, out, sampleRate, midiBuffer);
+    else // muted or not soloed, the node output is not mixed
+        node->processCulled(in, out, sampleRate, midiBuffer);
+    node->connectedOutputs = nullptr;
+    node->updateRenderTime(renderTimer.nsecsElapsed());
+}
+
+void AudioMixer::processSerially(const RenderSchedule &scheduleToProcess, const SamplesBuffer &in,
+                                 SamplesBuffer &out, int sampleRate,
+                                 const Midi::MidiBuffer &midiBuffer)
+{
     bool hasSoloedBuffers = soloedBuffersInLastProcess > 0;
     soloedBuffersInLastProcess = 0;
-    foreach (AudioNode *node, nodes) {
-        bool canProcess = (!hasSoloedBuffers && !node->isMuted())
-                          || (hasSoloedBuffers && node->isSoloed());
-        if (canProcess) {
-            node->processReplacing(in, out, sampleRate, midiBuffer);
-        } else {// just discard the samples if node is muted, the internalBuffer is not copyed to out buffer
-            static Audio::SamplesBuffer internalBuffer(2);
-            internalBuffer.setFrameLenght(out.getFrameLenght());
-            node->processReplacing(in, internalBuffer, sampleRate, midiBuffer);
+    int frameLenght = out.getFrameLenght();
+    for (const RenderSchedule::Step &step : scheduleToProcess.getSteps()) {
+        bool mixed = step.mixed && canProcess(step.node, hasSoloedBuffers);
+        if (step.hasConsumers) {// the output is used by the next steps
+            step.output->setFrameLenght(frameLenght);
+            step.output->zero();
+            renderStep(step, in, *step.output, sampleRate, midiBuffer, hasSoloedBuffers);
+            if (mixed)
+                out.add(*step.output);
+        } else if (mixed) {// summed directly in the mixer output
+            renderStep(step, in, out, sampleRate, midiBuffer, hasSoloedBuffers);
+        } else {
+            discardedSamples.setFrameLenght(frameLenght);
+            renderStep(step, in, discardedSamples, sampleRate, midiBuffer, hasSoloedBuffers);
         }
-        if (node->isSoloed())
+        if (step.mixed && step.node->isSoloed())
             soloedBuffersInLastProcess++;
     }
+}
 
-    if (attenuateAfterSumming) {
-        int nodesConnected = nodes.size();
-        if (nodesConnected > 1)// attenuate
-            out.applyGain(1.0/nodesConnected, 0.0);
+void AudioMixer::processInParallel(RenderWorkerPool *pool, const RenderSchedule &scheduleToProcess,
+                                   const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                                   const Midi::MidiBuffer &midiBuffer)
+{
+    bool hasSoloedBuffers = soloedBuffersInLastProcess > 0;
+    renderContext.schedule = &scheduleToProcess;
+    renderContext.in = &in;
+    renderContext.frameLenght = out.getFrameLenght();
+    renderContext.sampleRate = sampleRate;
+    renderContext.midiBuffer = &midiBuffer;
+    renderContext.hasSoloedBuffers = hasSoloedBuffers;
+
+    soloedBuffersInLastProcess = 0;
+    const QVector<RenderSchedule::Step> &steps = scheduleToProcess.getSteps();
+    for (int level = 0; level < scheduleToProcess.getLevels(); ++level) {
+        int firstStep = scheduleToProcess.getLevelStart(level);
+        int lastStep = scheduleToProcess.getLevelStart(level + 1);
+        renderContext.firstStep = firstStep;
+        pool->run(lastStep - firstStep, &AudioMixer::renderNode, this);
+
+        // the buffers are summed in the steps order, the result is the same of the serial mode
+        for (int s = firstStep; s < lastStep; ++s) {
+            const RenderSchedule::Step &step = steps.at(s);
+            if (step.mixed && canProcess(step.node, hasSoloedBuffers))
+                out.add(*step.output);// the silent buffers are not summed
+            if (step.mixed && step.node->isSoloed())
+                soloedBuffersInLastProcess++;
+        }
     }
 }
 
+void AudioMixer::renderNode(void *mixer, int stepIndex)
+{
+    AudioMixer *audioMixer = static_cast<AudioMixer *>(mixer);
+    const RenderContext &context = audioMixer->renderContext;
+    const RenderSchedule::Step &step = context.schedule->getSteps().at(context.firstStep + stepIndex);
+    step.output->setFrameLenght(context.frameLenght);
+    step.output->zero();
+    audioMixer->renderStep(step, *context.in, *step.output, context.sampleRate,
+                           *context.midiBuffer, context.hasSoloedBuffers);
+}
+
 // ++++++++++++++++++++++
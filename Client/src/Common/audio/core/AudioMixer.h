@@ -4,8 +4,13 @@
 #include <QList>
 #include <QMutex>
 #include <QMap>
-#include <QScopedPointer>
-#include "audio/SamplesBufferResampler.h"
+#include <QSharedPointer>
+#include <QMultiHash>
+#include "SnapshotPublisher.h"
+#include "SamplesBuffer.h"
+#include "RenderWorkerPool.h"
+#include "RenderSchedule.h"
+#include "DspProfiler.h"
 
 namespace Midi {
 class MidiBuffer;
@@ -13,7 +18,6 @@ class MidiBuffer;
 
 namespace Audio {
 class AudioNode;
-class SamplesBuffer;
 class LocalInputAudioNode;
 
 class AudioMixer
@@ -26,17 +30,64 @@ public:
     void process(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
                  const Midi::MidiBuffer &midiBuffer, bool attenuateAfterSumming = false);
     void addNode(AudioNode *node);
-    void removeNode(AudioNode *node);
+    void removeNode(AudioNode *node);// the node connections are removed too
+
+    // the source output is summed in the destination input, before the destination plugins. The
+    // source is rendered even if it is not a mixer node. Return false if a cycle is created.
+    bool connect(AudioNode *source, AudioNode *destination);
+    bool disconnect(AudioNode *source, AudioNode *destination);
 
     inline void setSampleRate(int newSampleRate)
     {
         this->sampleRate = newSampleRate;
     }
 
+    // worker threads used to render the nodes in parallel, zero to render all nodes in the audio thread
+    void setRenderThreads(int threads);
+    int getRenderThreads() const;
+
+    void logRenderTimes();// write the render time of each node in jtAudio logging category
+
 private:
-    QList<AudioNode *> nodes;
+    // the graph, changed by the GUI thread and compiled in a new schedule after each change
+    QMutex graphMutex;
+    QList<AudioNode *> mixerNodes;
+    QMultiHash<AudioNode *, AudioNode *> sources;// destination -> connected nodes
+
+    SnapshotPublisher<QSharedPointer<RenderSchedule> > schedule;// read by the audio thread without locks
+    SnapshotPublisher<QSharedPointer<RenderWorkerPool> > renderPool;
     int sampleRate;
-    QMap<AudioNode *, SamplesBufferResampler *> resamplers;
+    SamplesBuffer discardedSamples;// output of the culled (muted or not soloed) nodes
+    int soloedBuffersInLastProcess;
+    ProfileHistogram mixTimes;
+
+    // parameters of the current process() call, used by the render jobs
+    struct RenderContext
+    {
+        const RenderSchedule *schedule;
+        int firstStep;// the first step of the level rendered by the render jobs
+        const SamplesBuffer *in;
+        int frameLenght;
+        int sampleRate;
+        const Midi::MidiBuffer *midiBuffer;
+        bool hasSoloedBuffers;// the not soloed nodes are culled
+    };
+    RenderContext renderContext;
+
+    void compileSchedule();// called with the graphMutex locked
+    bool isConnected(AudioNode *source, AudioNode *destination) const;// direct or indirectly
+
+    void processSerially(const RenderSchedule &scheduleToProcess, const SamplesBuffer &in,
+                         SamplesBuffer &out, int sampleRate, const Midi::MidiBuffer &midiBuffer);
+    void processInParallel(RenderWorkerPool *pool, const RenderSchedule &scheduleToProcess,
+                           const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                           const Midi::MidiBuffer &midiBuffer);
+    static void renderNode(void *mixer, int stepIndex);// render job, called by the worker threads
+    void renderStep(const RenderSchedule::Step &step, const SamplesBuffer &in, SamplesBuffer &out,
+                    int sampleRate, const Midi::MidiBuffer &midiBuffer, bool hasSoloedBuffers);
+    bool canProcess(const AudioNode *node, bool hasSoloedBuffers) const;
+
+    static const int MAX_FRAMES = 4096;
 };
 // +++++++++++++++++++++++
 }
@@ -8,7 +8,6 @@
 #include "midi/MidiDriver.h"
 #include <QMutexLocker>
 
-#include "audio/Resampler.h"
 
 using namespace Audio;
 
@@ -49,9 +48,10 @@ void FaderProcessor::process(const Audio::SamplesBuffer &in, SamplesBuffer &out,
                              const Midi::MidiBuffer &midiBuffer)
 {
     Q_UNUSED(midiBuffer);
+    if (&in != &out)
+        out.set(in);// copy in to out
     if (finished())
         return;
-    out.set(in);// copy in to out
     float finalGain = currentGain + (gainStep * out.getFrameLenght());
     out.fade(currentGain, finalGain);
     currentGain = finalGain + gainStep;
@@ -67,6 +67,7 @@ void AudioNode::processReplacing(const SamplesBuffer &in, SamplesBuffer &out, in
                                  const Midi::MidiBuffer &midiBuffer)
 {
     Q_UNUSED(in);
+    Q_UNUSED(sampleRate);
 
     if (!isActivated())
         return;
@@ -74,38 +75,69 @@ void AudioNode::processReplacing(const SamplesBuffer &in, SamplesBuffer &out, in
     internalInputBuffer.setFrameLenght(out.getFrameLenght());
     internalOutputBuffer.setFrameLenght(out.getFrameLenght());
 
-    {
-        QMutexLocker locker(&mutex);
-        foreach (AudioNode *node, connections)  // ask connected nodes to generate audio
-            node->processReplacing(internalInputBuffer, internalOutputBuffer, sampleRate,
-                                   midiBuffer);
+    if (connectedOutputs) {// the connected nodes are already rendered, just sum the outputs
+        for (const SamplesBuffer *connectedOutput : *connectedOutputs)
+            internalInputBuffer.add(*connectedOutput);
     }
 
-    internalOutputBuffer.set(internalInputBuffer);// if we have no plugins insert the input samples are just copied  to output buffer.
+    // The insert chain. The in place processors read and write the same buffer, the others read
+    // the previous output and write in the other buffer (ping-pong between internalOutputBuffer and
+    // processorBuffer). The node input is never changed and the buffers are chosen to finish the
+    // chain in internalOutputBuffer, so a chain does at most one copy.
+    SnapshotPublisher<QList<AudioNodeProcessor *> >::Reader insertedProcessors(processors);
+    int outOfPlaceProcessors = 0;
+    for (AudioNodeProcessor *processor : *insertedProcessors) {
+        if (!processor->isBypassed() && !processor->canProcessInPlace())
+            outOfPlaceProcessors++;
+    }
 
-    if (!processors.isEmpty()) {
-        static SamplesBuffer tempInputBuffer(2);
-        // process inserted plugins
-        foreach (AudioNodeProcessor *processor, processors) {
-            if (!processor->isBypassed()) {
-                tempInputBuffer.setFrameLenght(internalOutputBuffer.getFrameLenght());
-                tempInputBuffer.set(internalOutputBuffer);
-                processor->process(tempInputBuffer, internalOutputBuffer, midiBuffer);
+    processorBuffer.setFrameLenght(internalOutputBuffer.getFrameLenght());
+    SamplesBuffer *chainOutput = nullptr;// null while the chain output is the node input
+    for (AudioNodeProcessor *processor : *insertedProcessors) {
+        if (processor->isBypassed())
+            continue;
+        ProfileScope profileScope(processor->getProcessTimes());
+        if (processor->canProcessInPlace()) {
+            if (!chainOutput) {// the only copy, chosen to finish the chain in the output buffer
+                if (outOfPlaceProcessors % 2 == 0)
+                    chainOutput = &internalOutputBuffer;
+                else
+                    chainOutput = &processorBuffer;
+                chainOutput->set(internalInputBuffer);
             }
+            processor->process(*chainOutput, *chainOutput, midiBuffer);
+        } else {
+            SamplesBuffer *target = &processorBuffer;
+            if (outOfPlaceProcessors % 2 != 0)// the last one writes in internalOutputBuffer
+                target = &internalOutputBuffer;
+            if (target == chainOutput)// a processor was bypassed by the GUI thread in this loop
+                target = (target == &processorBuffer) ? &internalOutputBuffer : &processorBuffer;
+            const SamplesBuffer &processorInput = chainOutput ? *chainOutput : internalInputBuffer;
+            processor->process(processorInput, *target, midiBuffer);
+            chainOutput = target;
+            outOfPlaceProcessors--;
         }
     }
 
-    internalOutputBuffer.applyGain(gain, leftGain, rightGain, boost);
+    // if we have no plugins insert the input samples are just copied to output buffer
+    if (chainOutput != &internalOutputBuffer)
+        internalOutputBuffer.set(chainOutput ? *chainOutput : internalInputBuffer);
 
-    lastPeak.update(internalOutputBuffer.computePeak());
+    lastPeak.update(internalOutputBuffer.applyGainAndComputePeak(gain, leftGain, rightGain, boost));
 
     out.add(internalOutputBuffer);
 }
 
+void AudioNode::processCulled(const SamplesBuffer &in, SamplesBuffer &discarded, int sampleRate,
+                              const Midi::MidiBuffer &midiBuffer)
+{
+    // the inserted plugins (instruments, loopers) keep running while the track is muted
+    processReplacing(in, discarded, sampleRate, midiBuffer);
+}
+
 AudioNode::AudioNode() :
     internalInputBuffer(2),
     internalOutputBuffer(2),
-    lastPeak(0, 0),
     muted(false),
     soloed(false),
     activated(true),
@@ -114,29 +146,30 @@ AudioNode::AudioNode() :
     pan(0),
     leftGain(1.0),
     rightGain(1.0),
-    resamplingCorrection(0)
+    processorBuffer(2),
+    connectedOutputs(nullptr),
+    lastRenderTime(0),
+    maxRenderTime(0)
 {
 }
 
-int AudioNode::getInputResamplingLength(int sourceSampleRate, int targetSampleRate,
-                                        int outFrameLenght)
+void AudioNode::updateRenderTime(qint64 renderTime)
 {
-    double doubleValue = (double)sourceSampleRate*(double)outFrameLenght/(double)targetSampleRate;
-    int intValue = (int)doubleValue;
-    resamplingCorrection += doubleValue - intValue;
-    if (qAbs(resamplingCorrection) > 1) {
-        intValue += resamplingCorrection;
-        if (resamplingCorrection > 0)
-            resamplingCorrection--;
-        else
-            resamplingCorrection++;
-    }
-    return intValue;
+    lastRenderTime.store(renderTime);
+    if (renderTime > maxRenderTime.load())
+        maxRenderTime.store(renderTime);// only the audio thread (or one render thread) update the render times
+    if (DspProfiler::isEnabled())
+        renderTimes.add(renderTime);
+}
+
+void AudioNode::resetRenderTimes()
+{
+    maxRenderTime.store(0);
 }
 
 Audio::AudioPeak AudioNode::getLastPeak() const
 {
-    return this->lastPeak;
+    return lastPeak.get();
 }
 
 void AudioNode::setPan(float pan)
@@ -182,6 +215,11 @@ void AudioNode::reset()
 }
 
 void AudioNode::updateGains()
+{
+    getPanGains(pan, leftGain, rightGain);
+}
+
+void AudioNode::getPanGains(float pan, float &leftGain, float &rightGain)
 {
     double angle = pan * PI_OVER_2 * 0.5;
     leftGain = (float)(ROOT_2_OVER_2 * (cos(angle) - sin(angle)));
@@ -190,56 +228,52 @@ void AudioNode::updateGains()
 
 AudioNode::~AudioNode()
 {
-    foreach (AudioNodeProcessor *processor, processors)
+    foreach (AudioNodeProcessor *processor, processors.getCurrent())
         delete processor;
-    processors.clear();
-}
-
-bool AudioNode::connect(AudioNode &other)
-{
-    QMutexLocker(&(other.mutex));
-    other.connections.insert(this);
-    return true;
 }
 
-bool AudioNode::disconnect(AudioNode &otherNode)
+void AudioNode::setProfileName(const QString &name)
 {
-    QMutexLocker(&(otherNode.mutex));
-    otherNode.connections.remove(this);
-    return true;
+    renderTimes.setName(name);
+    foreach (AudioNodeProcessor *processor, processors.getCurrent())
+        processor->getProcessTimes().setName(name + " / " + processor->getName());
 }
 
 void AudioNode::addProcessor(AudioNodeProcessor *newProcessor)
 {
     assert(newProcessor);
-    processors.append(newProcessor);
+    newProcessor->getProcessTimes().setName(getProfileName() + " / " + newProcessor->getName());
+    processors.modify([newProcessor](QList<AudioNodeProcessor *> &list) {
+        list.append(newProcessor);
+    });
 }
 
 void AudioNode::removeProcessor(AudioNodeProcessor *processor)
 {
     assert(processor);
     processor->suspend();
-    processors.removeOne(processor);
+    processors.modify([processor](QList<AudioNodeProcessor *> &list) {
+        list.removeOne(processor);
+    });
 
-    delete processor;
+    delete processor;// the audio thread is not using the processor anymore
 }
 
 void AudioNode::suspendProcessors()
 {
-    foreach (AudioNodeProcessor *processor, processors)
+    foreach (AudioNodeProcessor *processor, processors.getCurrent())
         processor->suspend();
 }
 
 void AudioNode::updateProcessorsGui()
 {
-    QMutexLocker locker(&mutex);
-    foreach (AudioNodeProcessor *processor, processors)
+    foreach (AudioNodeProcessor *processor, processors.getCurrent())
         processor->updateGui();
 }
 
 void AudioNode::resumeProcessors()
 {
-    foreach (AudioNodeProcessor *processor, processors)
+    foreach (AudioNodeProcessor *processor, processors.getCurrent())
         processor->resume();
 }
 
@@ -272,7 +306,8 @@ void OscillatorAudioNode::processReplacing(const Audio::SamplesBuffer &in,
 LocalInputAudioNode::LocalInputAudioNode(int parentChannelIndex, bool isMono) :
     globalFirstInputIndex(0),
     channelIndex(parentChannelIndex),
-    lastMidiActivity(0)
+    lastMidiActivity(0),
+    filteredMidiBuffer(new Midi::MidiBuffer(Midi::MidiBuffer::MAX_BLOCK_MESSAGES))
 {
     Q_UNUSED(isMono)
     setToNoInput();
@@ -309,13 +344,13 @@ bool LocalInputAudioNode::isAudio() const
 
 void LocalInputAudioNode::setProcessorsSampleRate(int newSampleRate)
 {
-    foreach (Audio::AudioNodeProcessor *p, processors)
+    foreach (Audio::AudioNodeProcessor *p, processors.getCurrent())
         p->setSampleRate(newSampleRate);
 }
 
 void LocalInputAudioNode::closeProcessorsWindows()
 {
-    foreach (Audio::AudioNodeProcessor *p, processors)
+    foreach (Audio::AudioNodeProcessor *p, processors.getCurrent())
         p->closeEditor();
 }
 
@@ -324,7 +359,7 @@ void LocalInputAudioNode::addProcessor(AudioNodeProcessor *newProcessor)
     AudioNode::addProcessor(newProcessor);
 
     // if newProcessor is the first added processor and is a virtual instrument (VSTi) change the input selection to midi
-    if (processors.size() == 1 && newProcessor->isVirtualInstrument()) {
+    if (processors.getCurrent().size() == 1 && newProcessor->isVirtualInstrument()) {
         if (!isMidi())
             setMidiInputSelection(0, -1);// select the first midi device, all channels (-1)
     }
@@ -377,7 +412,7 @@ void LocalInputAudioNode::processReplacing(const SamplesBuffer &in, SamplesBuffe
      * Other LocalInputAudioNode instances will read other channels from input SamplesBuffer.
      */
 
-    Midi::MidiBuffer filteredMidiBuffer(midiBuffer.getMessagesCount());
+    filteredMidiBuffer->clear();// the SysEx messages still point to the bytes in 'midiBuffer'
     internalInputBuffer.setFrameLenght(out.getFrameLenght());
     internalOutputBuffer.setFrameLenght(out.getFrameLenght());
     internalInputBuffer.zero();
@@ -395,9 +430,9 @@ void LocalInputAudioNode::processReplacing(const SamplesBuffer &in, SamplesBuffe
                 for (int m = 0; m < total; ++m) {
                     Midi::MidiMessage message = midiBuffer.getMessage(m);
                     if (message.getDeviceIndex() == midiDeviceIndex
-                        && (isReceivingAllMidiChannels()
+                        && (isReceivingAllMidiChannels() || message.isSysEx()
                             || message.getChannel() == midiChannelIndex)) {
-                        filteredMidiBuffer.addMessage(message);
+                        filteredMidiBuffer->addMessage(message);
 
                         // save the midi activity peak value for notes or controls
                         if (message.isNote() || message.isControl()) {
@@ -410,7 +445,7 @@ void LocalInputAudioNode::processReplacing(const SamplesBuffer &in, SamplesBuffe
             }
         }
     }
-    AudioNode::processReplacing(in, out, sampleRate, filteredMidiBuffer);
+    AudioNode::processReplacing(in, out, sampleRate, *filteredMidiBuffer);
 }
 
 // ++++++++++++=
@@ -431,17 +466,19 @@ LocalInputGroup::LocalInputGroup(int groupIndex, Audio::LocalInputAudioNode *fir
 
 LocalInputGroup::~LocalInputGroup()
 {
-    groupedInputs.clear();
 }
 
 void LocalInputGroup::addInput(Audio::LocalInputAudioNode *input)
 {
-    groupedInputs.append(input);
+    groupedInputs.modify([input](QList<Audio::LocalInputAudioNode *> &inputs) {
+        inputs.append(input);
+    });
 }
 
 void LocalInputGroup::mixGroupedInputs(Audio::SamplesBuffer &out)
 {
-    foreach (Audio::LocalInputAudioNode *inputTrack, groupedInputs) {
+    SnapshotPublisher<QList<Audio::LocalInputAudioNode *> >::Reader inputs(groupedInputs);
+    for (Audio::LocalInputAudioNode *inputTrack : *inputs) {
         if (!inputTrack->isMuted())
             out.add(inputTrack->getLastBuffer());
     }
@@ -449,20 +486,25 @@ void LocalInputGroup::mixGroupedInputs(Audio::SamplesBuffer &out)
 
 void LocalInputGroup::removeInput(Audio::LocalInputAudioNode *input)
 {
-    if (!groupedInputs.removeOne(input))
+    bool removed = false;
+    groupedInputs.modify([input, &removed](QList<Audio::LocalInputAudioNode *> &inputs) {
+        removed = inputs.removeOne(input);
+    });
+    if (!removed)
         qCritical() << "the input track was not removed!";
 }
 
 int LocalInputGroup::getMaxInputChannelsForEncoding() const
 {
-    if (groupedInputs.size() > 1)
+    SnapshotPublisher<QList<Audio::LocalInputAudioNode *> >::Reader inputs(groupedInputs);
+    if (inputs->size() > 1)
         return 2;    // stereo encoding
-    if (!groupedInputs.isEmpty()) {
-        if (groupedInputs.first()->isMidi())
+    if (!inputs->isEmpty()) {
+        if (inputs->first()->isMidi())
             return 2;    // just one midi track, use stereo encoding
-        if (groupedInputs.first()->isAudio())
-            return groupedInputs.first()->getAudioInputRange().getChannels();
-        if (groupedInputs.first()->isNoInput())
+        if (inputs->first()->isAudio())
+            return inputs->first()->getAudioInputRange().getChannels();
+        if (inputs->first()->isNoInput())
             return 2;    // allow channels using noInput but processing some vst looper in stereo
     }
     return 0;    // no channels to encoding
@@ -2,10 +2,15 @@
 #define AUDIO_NODE_H
 
 #include <QSet>
+#include <QVector>
 #include <QMutex>
+#include <QScopedPointer>
 #include "SamplesBuffer.h"
 #include "AudioDriver.h"
+#include "SnapshotPublisher.h"
+#include "DspProfiler.h"
 #include <QDebug>
+#include <atomic>
 
 namespace Midi   {
 class MidiBuffer;
@@ -20,8 +25,18 @@ public:
     {
     }
 
+    // all 'out' samples must be written, the 'out' content is undefined when 'in' and 'out' are
+    // different buffers (see canProcessInPlace())
     virtual void process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out,
                          const Midi::MidiBuffer &midiBuffer) = 0;
+
+    // true when process() can receive the same buffer as 'in' and 'out'. The other processors
+    // read the previous processor output and write in other buffer (see AudioNode::processReplacing)
+    virtual bool canProcessInPlace() const
+    {
+        return false;
+    }
+
     virtual void suspend() = 0;
     virtual void resume() = 0;
     virtual void updateGui() = 0;
@@ -43,8 +58,22 @@ public:
         return false;
     }
 
+    virtual QString getName() const
+    {
+        return "Processor";
+    }
+
+    // time spent in process(), named by the node using this processor
+    inline ProfileHistogram &getProcessTimes()
+    {
+        return processTimes;
+    }
+
 protected:
     bool bypassed;
+
+private:
+    ProfileHistogram processTimes;
 };
 
 // ++++++++++++++++++++++++++++++++++++++++++++
@@ -63,6 +92,16 @@ public:
                          const Midi::MidiBuffer &midiBuffer);
     bool finished();
     void reset();
+    bool canProcessInPlace() const
+    {
+        return true;
+    }
+
+    QString getName() const
+    {
+        return "Fader";
+    }
+
     void resume()
     {
     }
@@ -76,12 +115,19 @@ public:
 class AudioNode : public QObject
 {
     Q_OBJECT
+    friend class AudioMixer;// update the render times
 public:
     AudioNode();
     virtual ~AudioNode();
 
     virtual void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
                                   const Midi::MidiBuffer &midiBuffer);
+
+    // called by the mixer instead of processReplacing() when the node is muted or other node is
+    // soloed. The 'discarded' buffer is not mixed, the nodes can just advance the playback position.
+    virtual void processCulled(const SamplesBuffer &in, SamplesBuffer &discarded, int sampleRate,
+                               const Midi::MidiBuffer &midiBuffer);
+
     virtual void setMute(bool muted);
     void setSolo(bool soloed);
     inline bool isMuted() const
@@ -94,9 +140,6 @@ public:
         return soloed;
     }
 
-    virtual bool connect(AudioNode &other);
-    virtual bool disconnect(AudioNode &otherNode);
-
     virtual void addProcessor(AudioNodeProcessor *newProcessor);
     void removeProcessor(AudioNodeProcessor *processor);
     void suspendProcessors();
@@ -120,6 +163,7 @@ public:
     }
 
     void setPan(float pan);
+    static void getPanGains(float pan, float &leftGain, float &rightGain);// constant power, pan in [-1, 1]
     inline float getPan() const
     {
         return pan;
@@ -144,17 +188,35 @@ public:
 
     virtual void reset();// reset pan, gain, boost, etc
 
-protected:
+    // time spent in processReplacing() (including the plugins) in nanoseconds
+    inline qint64 getLastRenderTime() const
+    {
+        return lastRenderTime.load();
+    }
 
-    int getInputResamplingLength(int sourceSampleRate, int targetSampleRate, int outFrameLenght);
+    inline qint64 getMaxRenderTime() const
+    {
+        return maxRenderTime.load();
+    }
 
-    QSet<AudioNode *> connections;
-    QList<AudioNodeProcessor *> processors;
+    void resetRenderTimes();
+
+    // name used in the DSP profiler, the inserted processors are named after the node
+    virtual void setProfileName(const QString &name);
+    inline QString getProfileName() const
+    {
+        return renderTimes.getName();
+    }
+
+protected:
+
+    // processors are changed by the GUI thread and published to the audio thread as immutable snapshots
+    SnapshotPublisher<QList<AudioNodeProcessor *> > processors;
     SamplesBuffer internalInputBuffer;
     SamplesBuffer internalOutputBuffer;
 
-    mutable Audio::AudioPeak lastPeak;
-    QMutex mutex; // used to protected connections manipulation because nodes can be added or removed by different threads
+    Audio::AtomicAudioPeak lastPeak;
+    QMutex mutex; // used by subclasses to protect data shared with non audio threads
 private:
     AudioNode(const AudioNode &other);
     AudioNode &operator=(const AudioNode &other);
@@ -172,11 +234,22 @@ private:
     float leftGain;
     float rightGain;
 
+    // ping-pong with internalOutputBuffer in the insert chain, not static (the nodes can be
+    // processed in parallel)
+    SamplesBuffer processorBuffer;
+
+    // outputs of the connected nodes (see AudioMixer::connect), rendered before this node by the
+    // mixer render schedule. Setted by the mixer only while this node is rendered.
+    const QVector<SamplesBuffer *> *connectedOutputs;
+
+    std::atomic<qint64> lastRenderTime;
+    std::atomic<qint64> maxRenderTime;
+    ProfileHistogram renderTimes;
+    void updateRenderTime(qint64 renderTime);
+
     static const double ROOT_2_OVER_2;
     static const double PI_OVER_2;
 
-    double resamplingCorrection;
-
     void updateGains();
 
 signals:
@@ -323,6 +396,8 @@ private:
     InputMode inputMode = DISABLED;
 
     quint8 lastMidiActivity;// max velocity or control value
+
+    QScopedPointer<Midi::MidiBuffer> filteredMidiBuffer;// the messages of the selected device/channel
 };
 // ++++++++++++++++++++++++
 class LocalInputGroup
@@ -333,7 +408,7 @@ public:
 
     inline bool isEmpty() const
     {
-        return groupedInputs.empty();
+        return groupedInputs.getCurrent().empty();
     }
 
     void addInput(Audio::LocalInputAudioNode *input);
@@ -358,7 +433,7 @@ public:
 
 private:
     int groupIndex;
-    QList<Audio::LocalInputAudioNode *> groupedInputs;
+    SnapshotPublisher<QList<Audio::LocalInputAudioNode *> > groupedInputs;// mixed by the audio thread
     bool transmiting;
 };
 // ++++++++++++++++++++++++
@@ -41,3 +41,26 @@ float AudioPeak::getMax() const
 {
     return std::max(qAbs(left), qAbs(right));
 }
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+AtomicAudioPeak::AtomicAudioPeak() :
+    left(0),
+    right(0)
+{
+}
+
+void AtomicAudioPeak::update(const AudioPeak &peak)
+{
+    left.store(peak.getLeft(), std::memory_order_relaxed);
+    right.store(peak.getRight(), std::memory_order_relaxed);
+}
+
+void AtomicAudioPeak::zero()
+{
+    update(AudioPeak(0, 0));
+}
+
+AudioPeak AtomicAudioPeak::get() const
+{
+    return AudioPeak(left.load(std::memory_order_relaxed), right.load(std::memory_order_relaxed));
+}
@@ -1,6 +1,8 @@
 #ifndef AUDIOPEAK_H
 #define AUDIOPEAK_H
 
+#include <atomic>
+
 namespace Audio {
 class AudioPeak
 {
@@ -26,6 +28,23 @@ private:
     float left;
     float right;
 };
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+// peak written by the audio thread and read by the GUI thread without locks
+class AtomicAudioPeak
+{
+public:
+    AtomicAudioPeak();
+    void update(const AudioPeak &peak);
+    void zero();
+    AudioPeak get() const;
+private:
+    AtomicAudioPeak(const AtomicAudioPeak &other);
+    AtomicAudioPeak &operator=(const AtomicAudioPeak &other);
+
+    std::atomic<float> left;
+    std::atomic<float> right;
+};
 }
 
 #endif // AUDIOPEAK_H
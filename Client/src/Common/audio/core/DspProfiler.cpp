@@ -0,0 +1,256 @@
+#include "DspProfiler.h"
+#include "RtViolationDetector.h"
+#include <QMutex>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+using namespace Audio;
+
+namespace {
+QMutex &registryMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QList<ProfileHistogram *> &registeredHistograms()
+{
+    static QList<ProfileHistogram *> histograms;
+    return histograms;
+}
+}
+
+std::atomic<bool> DspProfiler::enabled(false);
+
+ProfileHistogram::ProfileHistogram(const QString &name) :
+    samples(0),
+    totalTime(0),
+    lastTime(0),
+    maxTime(0),
+    budget(0),
+    overruns(0),
+    resetRequested(false),
+    name(name)
+{
+    for (int b = 0; b < BUCKETS; ++b)
+        counts[b].store(0);
+    DspProfiler::registerHistogram(this);
+}
+
+ProfileHistogram::~ProfileHistogram()
+{
+    DspProfiler::unregisterHistogram(this);
+}
+
+void ProfileHistogram::setName(const QString &name)
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    this->name = name;
+}
+
+QString ProfileHistogram::getName() const
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    return name;
+}
+
+int ProfileHistogram::getBucket(qint64 time)
+{
+    quint64 value = time > 0 ? (quint64)time >> 8 : 0;
+    int bucket = 0;
+    while (value) {
+        value >>= 1;
+        bucket++;
+    }
+    return qMin(bucket, BUCKETS - 1);
+}
+
+qint64 ProfileHistogram::getBucketLimit(int bucket)
+{
+    return (qint64)256 << bucket;
+}
+
+void ProfileHistogram::add(qint64 time, qint64 budget)
+{
+    // only one writer, load + store is enough and avoid the locked instructions
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    if (resetRequested.load(relaxed) && resetRequested.exchange(false))
+        clearCounters();
+
+    std::atomic<quint64> &count = counts[getBucket(time)];
+    count.store(count.load(relaxed) + 1, relaxed);
+    samples.store(samples.load(relaxed) + 1, relaxed);
+    totalTime.store(totalTime.load(relaxed) + time, relaxed);
+    lastTime.store(time, relaxed);
+    if (time > maxTime.load(relaxed))
+        maxTime.store(time, relaxed);
+    if (budget > 0) {
+        this->budget.store(budget, relaxed);
+        if (time > budget)
+            overruns.store(overruns.load(relaxed) + 1, relaxed);
+    }
+}
+
+void ProfileHistogram::reset()
+{
+    // the writer could overwrite the cleared counters with its load + store, the reset is
+    // executed by the writer
+    resetRequested.store(true);
+}
+
+void ProfileHistogram::clearCounters()
+{
+    for (int b = 0; b < BUCKETS; ++b)
+        counts[b].store(0);
+    samples.store(0);
+    totalTime.store(0);
+    maxTime.store(0);
+    overruns.store(0);
+}
+
+ProfileStatistics ProfileHistogram::getStatistics() const
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    return collectStatistics();
+}
+
+ProfileStatistics ProfileHistogram::collectStatistics() const
+{
+    ProfileStatistics statistics;
+    statistics.name = name;
+    if (resetRequested.load()) {// the old counters are still not cleared
+        statistics.samples = 0;
+        statistics.averageTime = statistics.lastTime = statistics.maxTime = 0;
+        statistics.percentile50 = statistics.percentile99 = 0;
+        statistics.budget = budget.load();
+        statistics.overruns = 0;
+        statistics.buckets.fill(0, BUCKETS);
+        return statistics;
+    }
+    statistics.samples = samples.load();
+    statistics.averageTime = statistics.samples > 0 ? totalTime.load() / (qint64)statistics.samples : 0;
+    statistics.lastTime = lastTime.load();
+    statistics.maxTime = maxTime.load();
+    statistics.budget = budget.load();
+    statistics.overruns = overruns.load();
+    statistics.buckets.resize(BUCKETS);
+    for (int b = 0; b < BUCKETS; ++b)
+        statistics.buckets[b] = counts[b].load();
+    statistics.percentile50 = estimatePercentile(statistics, 0.5);
+    statistics.percentile99 = estimatePercentile(statistics, 0.99);
+    return statistics;
+}
+
+qint64 ProfileHistogram::estimatePercentile(const ProfileStatistics &statistics, double percentile)
+{
+    quint64 total = 0;
+    for (int b = 0; b < statistics.buckets.size(); ++b)
+        total += statistics.buckets[b];
+    if (total == 0)
+        return 0;
+
+    quint64 target = (quint64)(total * percentile);
+    quint64 accumulated = 0;
+    for (int b = 0; b < statistics.buckets.size(); ++b) {
+        accumulated += statistics.buckets[b];
+        if (accumulated > target)// the bucket upper limit, never more than the measured maximum
+            return qMin(getBucketLimit(b), statistics.maxTime);
+    }
+    return statistics.maxTime;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+void DspProfiler::setEnabled(bool enabled)
+{
+    DspProfiler::enabled.store(enabled);
+}
+
+void DspProfiler::registerHistogram(ProfileHistogram *histogram)
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    registeredHistograms().append(histogram);
+}
+
+void DspProfiler::unregisterHistogram(ProfileHistogram *histogram)
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    registeredHistograms().removeOne(histogram);
+}
+
+QList<ProfileStatistics> DspProfiler::getStatistics()
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());// the histograms are not deleted while collecting
+    QList<ProfileStatistics> statistics;
+    foreach (const ProfileHistogram *histogram, registeredHistograms()) {
+        ProfileStatistics histogramStatistics = histogram->collectStatistics();
+        if (histogramStatistics.samples > 0)
+            statistics.append(histogramStatistics);
+    }
+    return statistics;
+}
+
+void DspProfiler::reset()
+{
+    Audio::RtCheckedMutexLocker locker(&registryMutex());
+    foreach (ProfileHistogram *histogram, registeredHistograms())
+        histogram->reset();
+}
+
+qint64 DspProfiler::getBudget(int frames, int sampleRate)
+{
+    if (sampleRate <= 0)
+        return 0;
+    return (qint64)frames * 1000000000 / sampleRate;
+}
+
+QByteArray DspProfiler::toCsv(const QList<ProfileStatistics> &statistics)
+{
+    QByteArray csv;
+    QTextStream stream(&csv);
+    stream << "name,samples,average (ns),last (ns),max (ns),p50 (ns),p99 (ns),budget (ns),overruns";
+    for (int b = 0; b < ProfileHistogram::BUCKETS; ++b)
+        stream << ",< " << ProfileHistogram::getBucketLimit(b) << " ns";
+    stream << "\n";
+
+    foreach (const ProfileStatistics &s, statistics) {
+        QString name(s.name);
+        stream << "\"" << name.replace("\"", "\"\"") << "\"," << s.samples << "," << s.averageTime
+               << "," << s.lastTime << "," << s.maxTime << "," << s.percentile50 << ","
+               << s.percentile99 << "," << s.budget << "," << s.overruns;
+        foreach (quint64 count, s.buckets)
+            stream << "," << count;
+        stream << "\n";
+    }
+    stream.flush();
+    return csv;
+}
+
+QByteArray DspProfiler::toJson(const QList<ProfileStatistics> &statistics)
+{
+    QJsonArray array;
+    foreach (const ProfileStatistics &s, statistics) {
+        QJsonObject object;
+        object["name"] = s.name;
+        object["samples"] = (double)s.samples;
+        object["average"] = (double)s.averageTime;
+        object["last"] = (double)s.lastTime;
+        object["max"] = (double)s.maxTime;
+        object["p50"] = (double)s.percentile50;
+        object["p99"] = (double)s.percentile99;
+        object["budget"] = (double)s.budget;
+        object["overruns"] = (double)s.overruns;
+        QJsonArray buckets;
+        foreach (quint64 count, s.buckets)
+            buckets.append((double)count);
+        object["buckets"] = buckets;
+        array.append(object);
+    }
+    QJsonObject root;
+    root["unit"] = QString("ns");
+    root["firstBucketLimit"] = (double)ProfileHistogram::getBucketLimit(0);
+    root["histograms"] = array;
+    return QJsonDocument(root).toJson();
+}
@@ -0,0 +1,146 @@
+#ifndef DSP_PROFILER_H
+#define DSP_PROFILER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <atomic>
+#include <chrono>
+
+namespace Audio {
+struct ProfileStatistics
+{
+    QString name;
+    quint64 samples;
+    qint64 averageTime;// all times in nanoseconds
+    qint64 lastTime;
+    qint64 maxTime;
+    qint64 percentile50;// estimated from the histogram buckets
+    qint64 percentile99;
+    qint64 budget;// zero when the profiled code has no deadline
+    quint64 overruns;// samples exceeding the budget
+    QVector<quint64> buckets;
+};
+
+/**
+ * Lock free histogram of the time spent in a piece of audio code (a node, a plugin, etc).
+ *
+ * Each histogram has only one writer at time (the audio thread, the render worker rendering
+ * the node or the decoding thread), so the counters are updated without atomic read-modify-write
+ * instructions. The GUI thread reads the counters at any time and requests the reset, the counters
+ * are cleared by the writer in the next add(). The histograms are registered in the DspProfiler
+ * while they exist.
+ */
+class ProfileHistogram
+{
+public:
+    explicit ProfileHistogram(const QString &name = QString());
+    ~ProfileHistogram();
+
+    void setName(const QString &name);
+    QString getName() const;
+
+    void add(qint64 time, qint64 budget = 0);
+    void reset();// cleared in the next add(), the statistics are empty until then
+    ProfileStatistics getStatistics() const;
+
+    // bucket 'b' counts the times smaller than getBucketLimit(b), the first bucket is 256 ns
+    static const int BUCKETS = 32;
+    static qint64 getBucketLimit(int bucket);
+
+private:
+    ProfileHistogram(const ProfileHistogram &other);
+    ProfileHistogram &operator=(const ProfileHistogram &other);
+
+    std::atomic<quint64> counts[BUCKETS];
+    std::atomic<quint64> samples;
+    std::atomic<qint64> totalTime;
+    std::atomic<qint64> lastTime;
+    std::atomic<qint64> maxTime;
+    std::atomic<qint64> budget;
+    std::atomic<quint64> overruns;
+    std::atomic<bool> resetRequested;
+
+    QString name;// protected by the profiler mutex
+
+    ProfileStatistics collectStatistics() const;// the caller must hold the profiler mutex
+    void clearCounters();// writer
+    static int getBucket(qint64 time);
+    static qint64 estimatePercentile(const ProfileStatistics &statistics, double percentile);
+    friend class DspProfiler;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+// RAII helper, time the scope if the profiler is enabled
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileHistogram &histogram, qint64 budget = 0);
+    ~ProfileScope();
+
+private:
+    ProfileScope(const ProfileScope &other);
+    ProfileScope &operator=(const ProfileScope &other);
+
+    ProfileHistogram *histogram;// null when the profiler is disabled
+    qint64 budget;
+    qint64 start;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+/**
+ * Profiler of the audio graph. The audio code is timed with ProfileScopes, when the profiler is
+ * disabled each scope costs just one relaxed atomic read.
+ */
+class DspProfiler
+{
+public:
+    static void setEnabled(bool enabled);
+    static inline bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    static inline qint64 now()// steady clock, in nanoseconds
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static QList<ProfileStatistics> getStatistics();// all registered histograms
+    static void reset();
+
+    static QByteArray toCsv(const QList<ProfileStatistics> &statistics);
+    static QByteArray toJson(const QList<ProfileStatistics> &statistics);
+
+    static qint64 getBudget(int frames, int sampleRate);// the audio callback deadline
+
+private:
+    static std::atomic<bool> enabled;
+
+    static void registerHistogram(ProfileHistogram *histogram);
+    static void unregisterHistogram(ProfileHistogram *histogram);
+    friend class ProfileHistogram;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+inline ProfileScope::ProfileScope(ProfileHistogram &histogram, qint64 budget) :
+    histogram(DspProfiler::isEnabled() ? &histogram : nullptr),
+    budget(budget),
+    start(this->histogram ? DspProfiler::now() : 0)
+{
+}
+
+inline ProfileScope::~ProfileScope()
+{
+    if (histogram)
+        histogram->add(DspProfiler::now() - start, budget);
+}
+}
+
+#endif // DSP_PROFILER_H
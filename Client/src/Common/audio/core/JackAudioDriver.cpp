@@ -0,0 +1,343 @@
+#include "JackAudioDriver.h"
+#include "SamplesBuffer.h"
+#include "MainController.h"
+#include "log/Logging.h"
+#include <stdexcept>
+#include <algorithm>
+
+using namespace Audio;
+
+JackAudioDriver::JackAudioDriver(Controller::MainController *mainController, int audioDeviceIndex,
+                                 int firstInputIndex, int lastInputIndex, int firstOutputIndex,
+                                 int lastOutputIndex, int sampleRate, int bufferSize) :
+    AudioDriver(mainController),
+    client(nullptr),
+    active(false)
+{
+    Q_UNUSED(audioDeviceIndex);
+    qCInfo(jtAudio) << "connecting in the JACK server...";
+    jack_status_t status;
+    client = jack_client_open("Jamtaba", JackNoStartServer, &status);
+    if (!client) {
+        qCCritical(jtAudio) << "Can't connect in the JACK server, status:" << status;
+        throw std::runtime_error("The JACK server is not running!");
+    }
+
+    jack_set_process_callback(client, &JackAudioDriver::processCallback, this);
+    jack_set_buffer_size_callback(client, &JackAudioDriver::bufferSizeCallback, this);
+    jack_set_sample_rate_callback(client, &JackAudioDriver::sampleRateCallback, this);
+    jack_on_shutdown(client, &JackAudioDriver::shutdownCallback, this);
+
+    // the physical capture ports are 'output' ports for JACK clients, and vice versa
+    physicalInputs = getPhysicalPorts(client, JackPortIsPhysical | JackPortIsOutput);
+    physicalOutputs = getPhysicalPorts(client, JackPortIsPhysical | JackPortIsInput);
+
+    globalInputRange = ChannelRange(firstInputIndex, (lastInputIndex - firstInputIndex) + 1);
+    int maxInputs = getMaxInputs();
+    if (globalInputRange.isEmpty() || globalInputRange.getLastChannel() >= maxInputs)
+        globalInputRange = ChannelRange(0, std::min(maxInputs, 1));
+
+    globalOutputRange = ChannelRange(firstOutputIndex, (lastOutputIndex - firstOutputIndex) + 1);
+    int maxOutputs = getMaxOutputs();
+    if (globalOutputRange.isEmpty() || globalOutputRange.getLastChannel() >= maxOutputs)
+        globalOutputRange = ChannelRange(0, std::min(maxOutputs, 2));
+
+    // the sample rate is defined by the server
+    this->sampleRate = jack_get_sample_rate(client);
+    if (sampleRate != this->sampleRate) {
+        qCInfo(jtAudio) << "Using the JACK server sample rate" << this->sampleRate
+                        << "instead of" << sampleRate;
+    }
+
+    this->bufferSize = std::max(MIN_BUFFER_SIZE, std::min(bufferSize, MAX_BUFFER_SIZE));
+}
+
+JackAudioDriver::~JackAudioDriver()
+{
+    qCDebug(jtAudio) << "destructor JackAudioDriver";
+    release();
+}
+
+QList<QByteArray> JackAudioDriver::getPhysicalPorts(jack_client_t *client, unsigned long flags)
+{
+    QList<QByteArray> portNames;
+    const char **ports = jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE, flags);
+    if (ports) {
+        for (int p = 0; ports[p]; ++p)
+            portNames.append(QByteArray(ports[p]));
+        jack_free(ports);
+    }
+    return portNames;
+}
+
+void JackAudioDriver::start()
+{
+    if (!client)
+        return;
+
+    stop();
+
+    qCInfo(jtAudio) << "Starting JACK driver, inputs:" << globalInputRange.getChannels()
+                    << "outputs:" << globalOutputRange.getChannels();
+
+    recreateBuffers();// adjust the input and output buffers channels
+    registerPorts();
+
+    // JACK change the period of all clients, the sample rate can't be changed by clients
+    if ((jack_nframes_t)bufferSize != jack_get_buffer_size(client)) {
+        int error = jack_set_buffer_size(client, bufferSize);
+        if (error)
+            qCWarning(jtAudio) << "Can't change the JACK buffer size to" << bufferSize.load();
+    }
+    bufferSize = jack_get_buffer_size(client);
+
+    int serverSampleRate = jack_get_sample_rate(client);
+    if (serverSampleRate != sampleRate) {
+        sampleRate = serverSampleRate;
+        emit sampleRateChanged(sampleRate);
+    }
+
+    if (jack_activate(client)) {
+        unregisterPorts();
+        qCCritical(jtAudio) << "Can't activate the JACK client!";
+        throw std::runtime_error("Can't activate the JACK client!");
+    }
+    active = true;
+
+    connectPorts();
+
+    qCInfo(jtAudio) << "JACK driver started, buffer size:" << bufferSize.load() << "sample rate:"
+                    << sampleRate << "latency (frames) input:" << getInputLatency() << "output:"
+                    << getOutputLatency();
+
+    emit started();
+}
+
+void JackAudioDriver::stop()
+{
+    if (!client || !active)
+        return;
+
+    qCDebug(jtAudio) << "deactivating JACK client";
+    jack_deactivate(client);// the process callback is not called after this
+    active = false;
+    unregisterPorts();
+
+    if (inputBuffer)
+        inputBuffer->releaseExternalSamples();
+    if (outputBuffer)
+        outputBuffer->releaseExternalSamples();
+
+    emit stopped();
+}
+
+void JackAudioDriver::release()
+{
+    stop();
+    if (client) {
+        qCDebug(jtAudio) << "closing JACK client";
+        jack_client_close(client);
+        client = nullptr;
+    }
+}
+
+void JackAudioDriver::registerPorts()
+{
+    for (int c = 0; c < globalInputRange.getChannels(); ++c) {
+        QByteArray name = "in_" + QByteArray::number(c + 1);
+        jack_port_t *port = jack_port_register(client, name.constData(), JACK_DEFAULT_AUDIO_TYPE,
+                                               JackPortIsInput, 0);
+        if (!port) {
+            unregisterPorts();
+            throw std::runtime_error("Can't register the JACK input ports!");
+        }
+        inputPorts.append(port);
+    }
+    for (int c = 0; c < globalOutputRange.getChannels(); ++c) {
+        QByteArray name = "out_" + QByteArray::number(c + 1);
+        jack_port_t *port = jack_port_register(client, name.constData(), JACK_DEFAULT_AUDIO_TYPE,
+                                               JackPortIsOutput, 0);
+        if (!port) {
+            unregisterPorts();
+            throw std::runtime_error("Can't register the JACK output ports!");
+        }
+        outputPorts.append(port);
+    }
+
+    // allocated here, the process callback only replace the pointers
+    inputChannels.fill(nullptr, inputPorts.size());
+    outputChannels.fill(nullptr, outputPorts.size());
+}
+
+void JackAudioDriver::unregisterPorts()
+{
+    foreach (jack_port_t *port, inputPorts)
+        jack_port_unregister(client, port);
+    foreach (jack_port_t *port, outputPorts)
+        jack_port_unregister(client, port);
+    inputPorts.clear();
+    outputPorts.clear();
+}
+
+void JackAudioDriver::connectPorts()
+{
+    // the selected physical ports are connected, the user can change the connections in the JACK patchbay
+    for (int c = 0; c < inputPorts.size(); ++c) {
+        const QByteArray &source = physicalInputs.at(globalInputRange.getFirstChannel() + c);
+        if (jack_connect(client, source.constData(), jack_port_name(inputPorts.at(c))))
+            qCWarning(jtAudio) << "Can't connect" << source << "in the JACK input" << c + 1;
+    }
+    for (int c = 0; c < outputPorts.size(); ++c) {
+        const QByteArray &destination = physicalOutputs.at(globalOutputRange.getFirstChannel() + c);
+        if (jack_connect(client, jack_port_name(outputPorts.at(c)), destination.constData()))
+            qCWarning(jtAudio) << "Can't connect the JACK output" << c + 1 << "in" << destination;
+    }
+}
+
+int JackAudioDriver::process(jack_nframes_t frames)
+{
+    if (!inputBuffer || !outputBuffer)
+        return 0;
+
+    // the ports memory is used by the audio engine, no interleaving and no copies
+    for (int c = 0; c < inputChannels.size(); ++c)
+        inputChannels[c] = static_cast<float *>(jack_port_get_buffer(inputPorts.at(c), frames));
+    for (int c = 0; c < outputChannels.size(); ++c)
+        outputChannels[c] = static_cast<float *>(jack_port_get_buffer(outputPorts.at(c), frames));
+
+    inputBuffer->setExternalSamples(inputChannels.constData(), frames);
+    outputBuffer->setExternalSamples(outputChannels.constData(), frames);
+    outputBuffer->zero();
+
+    // all application audio processing is computed here
+    if (mainController)
+        mainController->process(*inputBuffer, *outputBuffer, sampleRate);
+
+    return 0;
+}
+
+int JackAudioDriver::getPortsLatency(const QList<jack_port_t *> &ports,
+                                     jack_latency_callback_mode_t mode) const
+{
+    jack_nframes_t latency = 0;
+    foreach (jack_port_t *port, ports) {
+        jack_latency_range_t range;
+        jack_port_get_latency_range(port, mode, &range);
+        latency = std::max(latency, range.max);
+    }
+    return latency;
+}
+
+int JackAudioDriver::getInputLatency() const
+{
+    if (!active)
+        return 0;
+    return getPortsLatency(inputPorts, JackCaptureLatency);
+}
+
+int JackAudioDriver::getOutputLatency() const
+{
+    if (!active)
+        return 0;
+    return getPortsLatency(outputPorts, JackPlaybackLatency);
+}
+
+QList<int> JackAudioDriver::getValidSampleRates(int deviceIndex) const
+{
+    Q_UNUSED(deviceIndex);
+    QList<int> sampleRates;
+    if (client)
+        sampleRates.append(jack_get_sample_rate(client));// the server sample rate is the only option
+    return sampleRates;
+}
+
+QList<int> JackAudioDriver::getValidBufferSizes(int deviceIndex) const
+{
+    Q_UNUSED(deviceIndex);
+    QList<int> bufferSizes;
+    for (int size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size *= 2)
+        bufferSizes.append(size);
+    return bufferSizes;
+}
+
+int JackAudioDriver::getMaxInputs() const
+{
+    return physicalInputs.size();
+}
+
+int JackAudioDriver::getMaxOutputs() const
+{
+    return physicalOutputs.size();
+}
+
+const char *JackAudioDriver::getInputChannelName(const unsigned int index) const
+{
+    if (index < (unsigned int)physicalInputs.size())
+        return physicalInputs.at(index).constData();
+    return "error";
+}
+
+const char *JackAudioDriver::getOutputChannelName(const unsigned int index) const
+{
+    if (index < (unsigned int)physicalOutputs.size())
+        return physicalOutputs.at(index).constData();
+    return "error";
+}
+
+const char *JackAudioDriver::getAudioDeviceName(int index) const
+{
+    Q_UNUSED(index);
+    return "JACK";
+}
+
+void JackAudioDriver::setAudioDeviceIndex(int index)
+{
+    Q_UNUSED(index);// the JACK server is the only device
+}
+
+int JackAudioDriver::getDevicesCount() const
+{
+    return 1;
+}
+
+bool JackAudioDriver::canBeStarted() const
+{
+    return client != nullptr;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+int JackAudioDriver::processCallback(jack_nframes_t frames, void *driver)
+{
+    return static_cast<JackAudioDriver *>(driver)->process(frames);
+}
+
+int JackAudioDriver::bufferSizeCallback(jack_nframes_t frames, void *driver)
+{
+    // the period was changed by other JACK client
+    JackAudioDriver *instance = static_cast<JackAudioDriver *>(driver);
+    if ((int)frames != instance->bufferSize.load()) {
+        instance->bufferSize = frames;
+        emit instance->bufferSizeChanged(frames);// called in a JACK thread, queued to the main thread
+    }
+    return 0;
+}
+
+int JackAudioDriver::sampleRateCallback(jack_nframes_t sampleRate, void *driver)
+{
+    JackAudioDriver *instance = static_cast<JackAudioDriver *>(driver);
+    if ((int)sampleRate != instance->sampleRate) {
+        instance->sampleRate = sampleRate;
+        emit instance->sampleRateChanged(sampleRate);// called in a JACK thread, queued to the main thread
+    }
+    return 0;
+}
+
+void JackAudioDriver::shutdownCallback(void *driver)
+{
+    // the server was closed, the client is closed in release()
+    JackAudioDriver *instance = static_cast<JackAudioDriver *>(driver);
+    qCCritical(jtAudio) << "The JACK server was closed!";
+    instance->active = false;
+    emit instance->stopped();
+}
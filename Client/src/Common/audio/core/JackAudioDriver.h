@@ -0,0 +1,98 @@
+#ifndef JACK_AUDIO_DRIVER_H
+#define JACK_AUDIO_DRIVER_H
+
+#include "AudioDriver.h"
+#include <jack/jack.h>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+
+namespace Audio {
+/**
+ * Linux audio driver. JACK delivers non interleaved float buffers, the port buffers are used by
+ * the audio engine without copies (see SamplesBuffer::setExternalSamples). The sample rate is
+ * defined by the JACK server, the period can be changed from 16 to 4096 frames.
+ *
+ * Can be tested without a sound card using the JACK dummy backend (jackd -d dummy -r 48000 -p 16)
+ * or the ALSA dummy/loopback modules (jackd -d alsa -d hw:Loopback).
+ */
+class JackAudioDriver : public AudioDriver
+{
+public:
+    JackAudioDriver(Controller::MainController *mainController, int audioDeviceIndex,
+                    int firstInputIndex, int lastInputIndex, int firstOutputIndex,
+                    int lastOutputIndex, int sampleRate, int bufferSize);
+    ~JackAudioDriver();
+
+    void start() override;
+    void stop() override;
+    void release() override;
+
+    int getInputLatency() const override;
+    int getOutputLatency() const override;
+
+    QList<int> getValidSampleRates(int deviceIndex) const override;
+    QList<int> getValidBufferSizes(int deviceIndex) const override;
+
+    int getMaxInputs() const override;
+    int getMaxOutputs() const override;
+
+    const char *getInputChannelName(unsigned const int index) const override;
+    const char *getOutputChannelName(unsigned const int index) const override;
+
+    const char *getAudioDeviceName(int index) const override;
+    inline int getAudioDeviceIndex() const override
+    {
+        return 0;// the JACK server is the only device
+    }
+
+    void setAudioDeviceIndex(int index) override;
+
+    int getDevicesCount() const override;
+
+    bool canBeStarted() const override;
+
+    inline bool hasControlPanel() const override
+    {
+        return false;
+    }
+
+    inline void openControlPanel(void *mainWindowHandle) override
+    {
+        Q_UNUSED(mainWindowHandle);
+    }
+
+    static const int MIN_BUFFER_SIZE = 16;
+    static const int MAX_BUFFER_SIZE = 4096;
+
+private:
+    jack_client_t *client;
+    bool active;
+
+    QList<QByteArray> physicalInputs;// the capture ports, like 'system:capture_1'
+    QList<QByteArray> physicalOutputs;
+
+    QList<jack_port_t *> inputPorts;// registered in start()
+    QList<jack_port_t *> outputPorts;
+    QVector<float *> inputChannels;// the ports buffers in the current period
+    QVector<float *> outputChannels;
+
+    static QList<QByteArray> getPhysicalPorts(jack_client_t *client, unsigned long flags);
+
+    void registerPorts();
+    void unregisterPorts();
+    void connectPorts();
+
+    int getPortsLatency(const QList<jack_port_t *> &ports, jack_latency_callback_mode_t mode) const;
+
+    int process(jack_nframes_t frames);
+
+    // JACK callbacks
+    static int processCallback(jack_nframes_t frames, void *driver);
+    static int bufferSizeCallback(jack_nframes_t frames, void *driver);
+    static int sampleRateCallback(jack_nframes_t sampleRate, void *driver);
+    static void shutdownCallback(void *driver);
+};
+}
+
+#endif
@@ -51,6 +51,11 @@ public:
     ~JamtabaDelay();
     virtual void process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &out,
                          const Midi::MidiBuffer &midiBuffer);
+    bool canProcessInPlace() const
+    {
+        return true;
+    }
+
     void setDelayTime(int delayTimeInMs);
     void setFeedback(float feedback);
     void setLevel(float level);
@@ -95,13 +95,7 @@ void PortAudioDriver::translatePortAudioCallBack(const void *in, void *out, unsi
     inputBuffer->setFrameLenght(framesPerBuffer);
     outputBuffer->setFrameLenght(framesPerBuffer);
     if(!globalInputRange.isEmpty()){
-        float* inputs = (float*)in;
-        int inputChannels = globalInputRange.getChannels();
-        for(unsigned int i=0; i < framesPerBuffer; i++){
-            for (int c = 0; c < inputChannels; c++){
-                inputBuffer->set(c, i, *inputs++);
-            }
-        }
+        inputBuffer->setInterleavedSamples((const float*)in, globalInputRange.getChannels());
     }
     else{
         inputBuffer->zero();
@@ -116,13 +110,7 @@ void PortAudioDriver::translatePortAudioCallBack(const void *in, void *out, unsi
     }
 
     //convert application output buffers to portaudio format
-    float* outputs = (float*)out;
-    int outputChannels = globalOutputRange.getChannels();
-    for(unsigned int i=0; i < framesPerBuffer; i++){
-        for (int c = 0; c < outputChannels; c++){
-            *outputs++ = outputBuffer->get(c, i);
-        }
-    }
+    outputBuffer->getInterleavedSamples((float*)out, globalOutputRange.getChannels());
 }
 
 //friend function, receive the pointer to PortAudioDriver instance in userData param
@@ -251,11 +239,32 @@ void PortAudioDriver::stop(){
                 qCCritical(jtAudio) << "error closing portaudio stream: " << Pa_GetErrorText(error);
                 throw std::runtime_error(std::string(Pa_GetErrorText(error)));
             }
+            paStream = NULL;
             emit stopped(); //fireDriverStopped();
         }
     }
 }
 
+int PortAudioDriver::getInputLatency() const{
+    if (paStream != NULL){
+        const PaStreamInfo *info = Pa_GetStreamInfo(paStream);
+        if(info){
+            return (int)(info->inputLatency * sampleRate);
+        }
+    }
+    return 0;
+}
+
+int PortAudioDriver::getOutputLatency() const{
+    if (paStream != NULL){
+        const PaStreamInfo *info = Pa_GetStreamInfo(paStream);
+        if(info){
+            return (int)(info->outputLatency * sampleRate);
+        }
+    }
+    return 0;
+}
+
 void PortAudioDriver::release(){
     qCDebug(jtAudio) << "releasing portaudio resources...";
     stop();
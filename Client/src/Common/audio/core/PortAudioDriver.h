@@ -17,6 +17,9 @@ public:
     virtual void stop();
     virtual void release();
 
+    virtual int getInputLatency() const;
+    virtual int getOutputLatency() const;
+
     virtual QList<int> getValidSampleRates(int deviceIndex) const;
     virtual QList<int> getValidBufferSizes(int deviceIndex) const;
 
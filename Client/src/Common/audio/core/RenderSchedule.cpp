@@ -0,0 +1,105 @@
+#include "RenderSchedule.h"
+#include "SamplesBuffer.h"
+#include <QSet>
+
+using namespace Audio;
+
+RenderSchedule::RenderSchedule() :
+    mixedSteps(0)
+{
+    levelStarts.append(0);// no levels
+}
+
+RenderSchedule::~RenderSchedule()
+{
+    qDeleteAll(scratchBuffers);
+}
+
+int RenderSchedule::computeLevel(AudioNode *node,
+                                 const QMultiHash<AudioNode *, AudioNode *> &sources,
+                                 QHash<AudioNode *, int> &levels, QList<AudioNode *> &order)
+{
+    QHash<AudioNode *, int>::const_iterator computed = levels.constFind(node);
+    if (computed != levels.constEnd())
+        return computed.value();
+
+    int level = 0;
+    foreach (AudioNode *source, sources.values(node))
+        level = qMax(level, computeLevel(source, sources, levels, order) + 1);
+
+    levels.insert(node, level);
+    order.append(node);// post order, the sources are placed before the nodes using them
+    return level;
+}
+
+RenderSchedule *RenderSchedule::compile(const QList<AudioNode *> &mixerNodes,
+                                        const QMultiHash<AudioNode *, AudioNode *> &sources,
+                                        int maxFrames)
+{
+    RenderSchedule *schedule = new RenderSchedule();
+
+    QHash<AudioNode *, int> levels;
+    QList<AudioNode *> order;
+    int lastLevel = -1;
+    foreach (AudioNode *node, mixerNodes)
+        lastLevel = qMax(lastLevel, computeLevel(node, sources, levels, order));
+
+    // grouped by level, the mixer nodes keep their order (the order used to sum the outputs)
+    QSet<AudioNode *> mixed = mixerNodes.toSet();
+    QHash<AudioNode *, int> stepIndexes;
+    QVector<int> stepLevels;
+    schedule->levelStarts.clear();
+    for (int level = 0; level <= lastLevel; ++level) {
+        schedule->levelStarts.append(schedule->steps.size());
+        foreach (AudioNode *node, order) {
+            if (levels.value(node) != level)
+                continue;
+            Step step;
+            step.node = node;
+            step.output = nullptr;
+            step.mixed = mixed.contains(node);
+            step.hasConsumers = false;
+            stepIndexes.insert(node, schedule->steps.size());
+            schedule->steps.append(step);
+            stepLevels.append(level);
+            if (step.mixed)
+                schedule->mixedSteps++;
+        }
+    }
+    schedule->levelStarts.append(schedule->steps.size());
+
+    // liveness: a step output is alive until the level of the last step reading it
+    QVector<int> lastUse(stepLevels);
+    for (int s = 0; s < schedule->steps.size(); ++s) {
+        foreach (AudioNode *source, sources.values(schedule->steps.at(s).node)) {
+            int sourceIndex = stepIndexes.value(source);
+            schedule->steps[sourceIndex].hasConsumers = true;
+            lastUse[sourceIndex] = qMax(lastUse.at(sourceIndex), stepLevels.at(s));
+        }
+    }
+    QVector<QList<int> > releasedAfterLevel(lastLevel + 1);
+    for (int s = 0; s < lastUse.size(); ++s)
+        releasedAfterLevel[lastUse.at(s)].append(s);
+
+    QList<SamplesBuffer *> freeBuffers;
+    for (int level = 0; level <= lastLevel; ++level) {
+        for (int s = schedule->getLevelStart(level); s < schedule->getLevelStart(level + 1); ++s) {
+            if (freeBuffers.isEmpty()) {
+                schedule->scratchBuffers.append(new SamplesBuffer(2, maxFrames));
+                freeBuffers.append(schedule->scratchBuffers.last());
+            }
+            schedule->steps[s].output = freeBuffers.takeLast();
+        }
+        // released only after the level, the steps in the same level are rendered in parallel
+        foreach (int s, releasedAfterLevel.at(level))
+            freeBuffers.append(schedule->steps.at(s).output);
+    }
+
+    for (int s = 0; s < schedule->steps.size(); ++s) {
+        Step &step = schedule->steps[s];
+        foreach (AudioNode *source, sources.values(step.node))
+            step.inputs.append(schedule->steps.at(stepIndexes.value(source)).output);
+    }
+
+    return schedule;
+}
@@ -0,0 +1,82 @@
+#ifndef RENDER_SCHEDULE_H
+#define RENDER_SCHEDULE_H
+
+#include <QList>
+#include <QVector>
+#include <QMultiHash>
+
+namespace Audio {
+class AudioNode;
+class SamplesBuffer;
+
+/**
+ * The audio graph (the mixer nodes and the nodes connected to them) compiled in a flat array of
+ * render steps. The audio thread only walks the steps, there is no recursion and no graph lookup.
+ *
+ * The steps are topologically sorted and grouped in levels: a step depends only on steps of the
+ * previous levels, so the steps in the same level can be rendered in parallel. Each step writes
+ * in a scratch buffer from a pool, and a buffer is reused by the next levels when the last step
+ * reading it was rendered (liveness analysis). A new schedule is compiled by the thread editing
+ * the graph and replaces the old one, a schedule is never changed after compile().
+ */
+class RenderSchedule
+{
+public:
+    struct Step
+    {
+        AudioNode *node;
+        SamplesBuffer *output;// scratch buffer, shared with steps that are not alive at same time
+        QVector<SamplesBuffer *> inputs;// the outputs of the nodes connected in this node
+        bool mixed;// a mixer node, summed in the mixer output
+        bool hasConsumers;// the output is the input of other steps
+    };
+
+    RenderSchedule();
+    ~RenderSchedule();
+
+    // 'sources' maps each node to the nodes connected in it. The graph can't have cycles.
+    static RenderSchedule *compile(const QList<AudioNode *> &mixerNodes,
+                                   const QMultiHash<AudioNode *, AudioNode *> &sources,
+                                   int maxFrames);
+
+    inline const QVector<Step> &getSteps() const
+    {
+        return steps;
+    }
+
+    inline int getLevels() const
+    {
+        return levelStarts.size() - 1;
+    }
+
+    // the steps of a level are in [getLevelStart(level), getLevelStart(level + 1))
+    inline int getLevelStart(int level) const
+    {
+        return levelStarts.at(level);
+    }
+
+    inline int getMixedSteps() const
+    {
+        return mixedSteps;
+    }
+
+    inline int getScratchBuffers() const
+    {
+        return scratchBuffers.size();
+    }
+
+private:
+    RenderSchedule(const RenderSchedule &);
+    RenderSchedule &operator=(const RenderSchedule &);
+
+    QVector<Step> steps;
+    QVector<int> levelStarts;
+    QList<SamplesBuffer *> scratchBuffers;
+    int mixedSteps;
+
+    static int computeLevel(AudioNode *node, const QMultiHash<AudioNode *, AudioNode *> &sources,
+                            QHash<AudioNode *, int> &levels, QList<AudioNode *> &order);
+};
+}
+
+#endif // RENDER_SCHEDULE_H
@@ -0,0 +1,109 @@
+#include "RenderWorkerPool.h"
+#include "RtViolationDetector.h"
+#include "log/Logging.h"
+#include <QThread>
+#include <algorithm>
+
+using namespace Audio;
+
+class RenderWorkerPool::Worker : public QThread
+{
+public:
+    explicit Worker(RenderWorkerPool *pool) :
+        pool(pool)
+    {
+    }
+
+protected:
+    void run()
+    {
+        pool->workerLoop();
+    }
+
+private:
+    RenderWorkerPool *pool;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+RenderWorkerPool::RenderWorkerPool(int workersCount) :
+    jobFunction(nullptr),
+    jobContext(nullptr),
+    jobsClaim(0),
+    completedJobs(0),
+    stopRequested(false)
+{
+    qCDebug(jtAudio) << "Starting" << workersCount << "render threads";
+    for (int i = 0; i < workersCount; ++i) {
+        Worker *worker = new Worker(this);
+        worker->start(QThread::TimeCriticalPriority);
+        workers.append(worker);
+    }
+}
+
+RenderWorkerPool::~RenderWorkerPool()
+{
+    stopRequested.store(true);
+    for (int i = 0; i < workers.size(); ++i)
+        semaphore.release();
+    foreach (Worker *worker, workers) {
+        worker->wait();
+        delete worker;
+    }
+    qCDebug(jtAudio) << "Render threads stopped";
+}
+
+void RenderWorkerPool::run(int jobs, JobFunction function, void *context)
+{
+    if (jobs <= 0)
+        return;
+    Q_ASSERT(jobs <= MAX_JOBS);
+
+    // no worker is rendering, all the jobs of the previous run were claimed and completed
+    jobFunction = function;
+    jobContext = context;
+    completedJobs.store(0, std::memory_order_relaxed);
+    quint64 generation = (jobsClaim.load(std::memory_order_relaxed) >> 32) + 1;
+    jobsClaim.store((generation << 32) | ((quint64)jobs << 16), std::memory_order_release);// publish the jobs
+
+    int workersToWake = std::min(workers.size(), jobs - 1);// the audio thread renders one job at least
+    for (int i = 0; i < workersToWake; ++i)
+        semaphore.release();
+
+    while (renderNextJob()) {
+    }
+
+    // wait only for the jobs in progress in the workers
+    while (completedJobs.load(std::memory_order_acquire) < jobs)
+        QThread::yieldCurrentThread();
+}
+
+bool RenderWorkerPool::renderNextJob()
+{
+    quint64 claim = jobsClaim.load(std::memory_order_acquire);
+    int jobIndex;
+    do {
+        jobIndex = (int)(claim & 0xFFFF);
+        if (jobIndex >= (int)((claim >> 16) & 0xFFFF))
+            return false;// all jobs of this run were claimed
+    } while (!jobsClaim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel,
+                                              std::memory_order_acquire));
+
+    // the claim succeeded in the current run, the run doesn't finish (and the job parameters
+    // don't change) until this job is completed
+    jobFunction(jobContext, jobIndex);
+    completedJobs.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void RenderWorkerPool::workerLoop()
+{
+    RtViolationDetector::AudioThreadScope audioThreadScope;
+    while (true) {
+        semaphore.acquire();
+        if (stopRequested.load())
+            break;
+        while (renderNextJob()) {
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef RENDER_WORKER_POOL_H
+#define RENDER_WORKER_POOL_H
+
+#include <QList>
+#include <atomic>
+#include "RtSemaphore.h"
+
+namespace Audio {
+/**
+ * Real time threads used to render independent jobs (the mixer tracks) in parallel.
+ *
+ * run() is called by the audio thread: the workers are waked by a semaphore (a futex in Linux),
+ * the audio thread renders jobs too and spin-waits only for the jobs still in progress. No locks
+ * or allocations are used in run(). Each job must write in its own buffers, so the result does
+ * not depend on which thread rendered each job.
+ */
+class RenderWorkerPool
+{
+public:
+    typedef void (*JobFunction)(void *context, int jobIndex);
+
+    explicit RenderWorkerPool(int workers);
+    ~RenderWorkerPool();
+
+    // audio thread, return when all jobs are rendered. 'jobs' is limited to MAX_JOBS.
+    void run(int jobs, JobFunction function, void *context);
+
+    static const int MAX_JOBS = 0xFFFF;
+
+    inline int getWorkers() const
+    {
+        return workers.size();
+    }
+
+private:
+    class Worker;
+    friend class Worker;
+
+    QList<Worker *> workers;
+    RtSemaphore semaphore;
+
+    // the current jobs, published to the workers with a new 'jobsClaim'
+    JobFunction jobFunction;
+    void *jobContext;
+
+    /**
+     * The run generation (bits 32-63), the jobs of the run (bits 16-31) and the next job index
+     * (bits 0-15) in one atomic. The jobs are claimed with a compare and swap, so a worker
+     * preempted with an index taken in a finished run can't render a job of the next run with
+     * that index, or render a job that other thread is rendering. All jobs are claimed when
+     * the index reaches the jobs count, the idle pool has zero jobs.
+     */
+    std::atomic<quint64> jobsClaim;
+    std::atomic<int> completedJobs;
+    std::atomic<bool> stopRequested;
+
+    bool renderNextJob();// return false when all jobs were taken
+    void workerLoop();
+
+    RenderWorkerPool(const RenderWorkerPool &);
+    RenderWorkerPool &operator=(const RenderWorkerPool &);
+};
+}
+
+#endif // RENDER_WORKER_POOL_H
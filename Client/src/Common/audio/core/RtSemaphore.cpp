@@ -0,0 +1,111 @@
+#include "RtSemaphore.h"
+#include <QtGlobal>
+#include <climits>
+
+#if defined(Q_OS_WIN)
+    #include <windows.h>
+#elif defined(Q_OS_MAC)
+    #include <dispatch/dispatch.h>
+#else
+    #include <semaphore.h>
+    #include <cerrno>
+#endif
+
+using namespace Audio;
+
+class RtSemaphore::NativeSemaphore
+{
+public:
+#if defined(Q_OS_WIN)
+    NativeSemaphore() :
+        handle(CreateSemaphore(NULL, 0, LONG_MAX, NULL))
+    {
+    }
+
+    ~NativeSemaphore()
+    {
+        CloseHandle(handle);
+    }
+
+    inline void release()
+    {
+        ReleaseSemaphore(handle, 1, NULL);
+    }
+
+    inline void acquire()
+    {
+        WaitForSingleObject(handle, INFINITE);
+    }
+
+private:
+    HANDLE handle;
+#elif defined(Q_OS_MAC)
+    NativeSemaphore() :
+        handle(dispatch_semaphore_create(0))
+    {
+    }
+
+    ~NativeSemaphore()
+    {
+        dispatch_release(handle);
+    }
+
+    inline void release()
+    {
+        dispatch_semaphore_signal(handle);
+    }
+
+    inline void acquire()
+    {
+        dispatch_semaphore_wait(handle, DISPATCH_TIME_FOREVER);
+    }
+
+private:
+    dispatch_semaphore_t handle;
+#else
+    NativeSemaphore()
+    {
+        sem_init(&handle, 0, 0);
+    }
+
+    ~NativeSemaphore()
+    {
+        sem_destroy(&handle);
+    }
+
+    inline void release()
+    {
+        sem_post(&handle);
+    }
+
+    inline void acquire()
+    {
+        while (sem_wait(&handle) != 0 && errno == EINTR) {
+        }
+    }
+
+private:
+    sem_t handle;
+#endif
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+RtSemaphore::RtSemaphore() :
+    semaphore(new NativeSemaphore())
+{
+}
+
+RtSemaphore::~RtSemaphore()
+{
+}
+
+void RtSemaphore::release()
+{
+    semaphore->release();
+}
+
+void RtSemaphore::acquire()
+{
+    semaphore->acquire();
+}
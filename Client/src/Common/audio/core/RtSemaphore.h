@@ -0,0 +1,31 @@
+#ifndef RT_SEMAPHORE_H
+#define RT_SEMAPHORE_H
+
+#include <QScopedPointer>
+
+namespace Audio {
+/**
+ * Counting semaphore using the native OS semaphores (a futex in Linux).
+ *
+ * release() never locks a mutex or allocates, so the audio thread can wake other threads
+ * without blocking. QSemaphore can't be used because it locks a QMutex in release().
+ */
+class RtSemaphore
+{
+public:
+    RtSemaphore();
+    ~RtSemaphore();
+
+    void release();// can be called from the audio thread
+    void acquire();
+
+private:
+    class NativeSemaphore;
+    QScopedPointer<NativeSemaphore> semaphore;
+
+    RtSemaphore(const RtSemaphore &);
+    RtSemaphore &operator=(const RtSemaphore &);
+};
+}
+
+#endif // RT_SEMAPHORE_H
@@ -0,0 +1,243 @@
+#include "RtViolationDetector.h"
+
+#ifdef JT_RT_VIOLATION_DETECTOR
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "log/Logging.h"
+
+using namespace Audio;
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+    #define JT_THREAD_LOCAL __declspec(thread)
+#else
+    #define JT_THREAD_LOCAL thread_local
+#endif
+
+namespace {
+JT_THREAD_LOCAL int audioThreadScopes = 0;// > 0 when the current thread is inside the audio callback
+
+std::atomic<quint64> allocations(0);
+std::atomic<quint64> deallocations(0);
+std::atomic<quint64> locks(0);
+}
+
+void RtViolationDetector::enterAudioThread()
+{
+    audioThreadScopes++;
+}
+
+void RtViolationDetector::leaveAudioThread()
+{
+    audioThreadScopes--;
+}
+
+bool RtViolationDetector::isInAudioThread()
+{
+    return audioThreadScopes > 0;
+}
+
+void RtViolationDetector::reportAllocation()
+{
+    if (isInAudioThread())
+        allocations++;
+}
+
+void RtViolationDetector::reportDeallocation()
+{
+    if (isInAudioThread())
+        deallocations++;
+}
+
+void RtViolationDetector::reportLock()
+{
+    if (isInAudioThread())
+        locks++;
+}
+
+quint64 RtViolationDetector::getAllocations()
+{
+    return allocations.load();
+}
+
+quint64 RtViolationDetector::getDeallocations()
+{
+    return deallocations.load();
+}
+
+quint64 RtViolationDetector::getLocks()
+{
+    return locks.load();
+}
+
+void RtViolationDetector::reset()
+{
+    allocations = 0;
+    deallocations = 0;
+    locks = 0;
+}
+
+void RtViolationDetector::logViolations()
+{
+    if (getAllocations() > 0 || getDeallocations() > 0 || getLocks() > 0) {
+        qCWarning(jtAudio) << "RT violations in audio thread - allocations:" << getAllocations()
+                           << " deallocations:" << getDeallocations() << " locks:" << getLocks();
+    }
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// replacing all the global allocation functions to count the heap usage in the audio thread.
+// The array, nothrow, sized and aligned versions are replaced too, some standard libraries don't
+// implement them calling the replaced plain versions.
+
+namespace {
+void *allocate(std::size_t size)
+{
+    RtViolationDetector::reportAllocation();
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void deallocate(void *pointer)
+{
+    if (pointer) {
+        RtViolationDetector::reportDeallocation();
+        std::free(pointer);
+    }
+}
+}
+
+void *operator new(std::size_t size)
+{
+    void *pointer = allocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+    void *pointer = allocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    deallocate(pointer);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    deallocate(pointer);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+namespace {
+void *allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    RtViolationDetector::reportAllocation();
+    return qMallocAligned(size > 0 ? size : 1, static_cast<std::size_t>(alignment));
+}
+
+void deallocateAligned(void *pointer)
+{
+    if (pointer) {
+        RtViolationDetector::reportDeallocation();
+        qFreeAligned(pointer);
+    }
+}
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    void *pointer = allocateAligned(size, alignment);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    void *pointer = allocateAligned(size, alignment);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+    deallocateAligned(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept
+{
+    deallocateAligned(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    deallocateAligned(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    deallocateAligned(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    deallocateAligned(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    deallocateAligned(pointer);
+}
+#endif
+
+#endif
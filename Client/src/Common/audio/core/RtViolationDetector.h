@@ -0,0 +1,146 @@
+#ifndef RT_VIOLATION_DETECTOR_H
+#define RT_VIOLATION_DETECTOR_H
+
+#include <QtGlobal>
+#include <QMutex>
+
+namespace Audio {
+/**
+ * Debug helper counting the heap allocations and the locks taken in the audio thread.
+ *
+ * The counters are active only when JT_RT_VIOLATION_DETECTOR is defined (standalone debug builds
+ * and the bench), the global allocation functions are replaced in these builds. The plugin
+ * never defines it, a DLL can't replace the allocation functions of the host process. In the
+ * other builds all methods are empty inline functions.
+ *
+ * The locks are counted by RtCheckedMutexLocker, used instead of QMutexLocker by the classes
+ * sharing a mutex with the audio thread.
+ */
+class RtViolationDetector
+{
+public:
+    // RAII helper used to mark the audio callback scope
+    class AudioThreadScope
+    {
+    public:
+        AudioThreadScope()
+        {
+            RtViolationDetector::enterAudioThread();
+        }
+
+        ~AudioThreadScope()
+        {
+            RtViolationDetector::leaveAudioThread();
+        }
+    };
+
+#ifdef JT_RT_VIOLATION_DETECTOR
+    static void enterAudioThread();
+    static void leaveAudioThread();
+    static bool isInAudioThread();
+
+    static void reportAllocation();
+    static void reportDeallocation();
+    static void reportLock();
+
+    static quint64 getAllocations();
+    static quint64 getDeallocations();
+    static quint64 getLocks();
+    static void reset();
+
+    static void logViolations();// write the counters in jtAudio logging category
+#else
+    static inline void enterAudioThread()
+    {
+    }
+
+    static inline void leaveAudioThread()
+    {
+    }
+
+    static inline bool isInAudioThread()
+    {
+        return false;
+    }
+
+    static inline void reportAllocation()
+    {
+    }
+
+    static inline void reportDeallocation()
+    {
+    }
+
+    static inline void reportLock()
+    {
+    }
+
+    static inline quint64 getAllocations()
+    {
+        return 0;
+    }
+
+    static inline quint64 getDeallocations()
+    {
+        return 0;
+    }
+
+    static inline quint64 getLocks()
+    {
+        return 0;
+    }
+
+    static inline void reset()
+    {
+    }
+
+    static inline void logViolations()
+    {
+    }
+#endif
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+// QMutexLocker replacement for mutexes that can be locked by the audio thread
+class RtCheckedMutexLocker
+{
+public:
+    explicit RtCheckedMutexLocker(QMutex *mutex) :
+        mutex(mutex),
+        locked(false)
+    {
+        relock();
+    }
+
+    ~RtCheckedMutexLocker()
+    {
+        unlock();
+    }
+
+    inline void unlock()
+    {
+        if (locked) {
+            locked = false;
+            mutex->unlock();
+        }
+    }
+
+    inline void relock()
+    {
+        if (!locked) {
+            RtViolationDetector::reportLock();
+            mutex->lock();
+            locked = true;
+        }
+    }
+
+private:
+    RtCheckedMutexLocker(const RtCheckedMutexLocker &other);
+    RtCheckedMutexLocker &operator=(const RtCheckedMutexLocker &other);
+
+    QMutex *mutex;
+    bool locked;
+};
+}
+
+#endif // RT_VIOLATION_DETECTOR_H
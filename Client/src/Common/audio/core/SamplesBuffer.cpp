@@ -1,52 +1,146 @@
 #include "SamplesBuffer.h"
+#include "SamplesBufferKernels.h"
 #include <QDebug>
+#include <QtGlobal>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 using namespace Audio;
 // +++++++++++++++++=
 
+namespace {
+const size_t SAMPLES_ALIGNMENT = 32;// bytes, AVX registers
+const unsigned int FRAMES_ALIGNMENT = SAMPLES_ALIGNMENT/sizeof(float);
+
+inline unsigned int alignFrames(unsigned int frames)
+{
+    if (frames == 0)
+        frames = 1;// always allocate some memory, getSamplesArray() never return null
+    return (frames + FRAMES_ALIGNMENT - 1) & ~(FRAMES_ALIGNMENT - 1);
+}
+}
+
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 const SamplesBuffer SamplesBuffer::ZERO_BUFFER(1, 0);
 
 SamplesBuffer::SamplesBuffer(unsigned int channels) :
     channels(channels),
-    frameLenght(0)
+    frameLenght(0),
+    samples(nullptr),
+    allocatedChannels(0),
+    allocatedFrames(0),
+    channelPointers(nullptr),
+    externalSamples(false),
+    externalFrames(0),
+    silent(true)
 {
     if (channels == 0)
         qCritical() << "AudioSamplesBuffer::channels == 0";
-    for (unsigned int c = 0; c < channels; ++c)
-        samples.push_back(std::vector<float>());
+    reserve(channels, 0);
 }
 
 SamplesBuffer::SamplesBuffer(unsigned int channels, unsigned int frameLenght) :
     channels(channels),
-    frameLenght(frameLenght)
+    frameLenght(frameLenght),
+    samples(nullptr),
+    allocatedChannels(0),
+    allocatedFrames(0),
+    channelPointers(nullptr),
+    externalSamples(false),
+    externalFrames(0),
+    silent(true)
 {
-    for (unsigned int c = 0; c < channels; ++c)
-        samples.push_back(std::vector<float>(frameLenght));
+    reserve(channels, frameLenght);// the new samples are zeroed
 }
 
 SamplesBuffer::SamplesBuffer(const SamplesBuffer &other) :
     channels(other.channels),
     frameLenght(other.frameLenght),
-    samples(other.samples)
+    samples(nullptr),
+    allocatedChannels(0),
+    allocatedFrames(0),
+    channelPointers(nullptr),
+    externalSamples(false),
+    externalFrames(0),
+    silent(other.silent)
 {
     // qWarning() << "Samples Buffer copy constructor!";
+    reserve(channels, frameLenght);
+    for (unsigned int c = 0; c < channels; ++c)
+        std::memcpy(channelData(c), other.channelData(c), frameLenght * sizeof(float));
 }
 
 SamplesBuffer::~SamplesBuffer()
 {
+    qFreeAligned(samples);
+    delete[] channelPointers;
+}
+
+void SamplesBuffer::reserve(unsigned int channelsToReserve, unsigned int framesToReserve)
+{
+    if (channelsToReserve == 0)
+        channelsToReserve = 1;
+    if (externalSamples) {
+        if (channelsToReserve <= channels && framesToReserve <= externalFrames)
+            return;
+        framesToReserve = std::max(framesToReserve, frameLenght);// the external samples are copied
+    } else if (channelsToReserve <= allocatedChannels && framesToReserve <= allocatedFrames) {
+        return;
+    }
+
+    unsigned int newChannels = std::max(channelsToReserve, allocatedChannels);
+    unsigned int newFrames = alignFrames(std::max(framesToReserve, allocatedFrames));
+    size_t bytes = (size_t)newChannels * newFrames * sizeof(float);
+    float *newSamples = static_cast<float *>(qMallocAligned(bytes, SAMPLES_ALIGNMENT));
+    std::memset(newSamples, 0, bytes);
+    unsigned int channelsToKeep = externalSamples ? channels : allocatedChannels;
+    unsigned int framesToKeep = externalSamples ? frameLenght : allocatedFrames;
+    for (unsigned int c = 0; c < channelsToKeep; ++c)// keep the current samples
+        std::memcpy(newSamples + c * newFrames, channelData(c), framesToKeep * sizeof(float));
+
+    qFreeAligned(samples);
+    samples = newSamples;
+    allocatedChannels = newChannels;
+    allocatedFrames = newFrames;
+    externalSamples = false;
+
+    delete[] channelPointers;
+    channelPointers = new float *[allocatedChannels];
+    for (unsigned int c = 0; c < allocatedChannels; ++c)
+        channelPointers[c] = samples + c * allocatedFrames;
+}
+
+void SamplesBuffer::setExternalSamples(float *const *channelSamples, unsigned int frames)
+{
+    for (unsigned int c = 0; c < channels; ++c)// channels <= allocatedChannels, no allocations here
+        channelPointers[c] = channelSamples[c];
+    externalSamples = true;
+    externalFrames = frames;
+    frameLenght = frames;
+    silent = false;
+}
+
+void SamplesBuffer::releaseExternalSamples()
+{
+    if (!externalSamples)
+        return;
+    for (unsigned int c = 0; c < allocatedChannels; ++c)
+        channelPointers[c] = samples + c * allocatedFrames;
+    externalSamples = false;
+    externalFrames = 0;
+    frameLenght = 0;
+    silent = true;
 }
 
 void SamplesBuffer::discardFirstSamples(unsigned int samplesToDiscard)
 {
     int toDiscard = std::min(frameLenght, samplesToDiscard);
     uint newFrameLenght = frameLenght - toDiscard;
-    for (uint c = 0; c < channels; ++c) {
-        std::rotate(samples[c].begin(), samples[c].begin() + toDiscard, samples[c].end());
-        // samples[c].erase(samples[c].begin(), samples[c].begin() + toDiscard);
+    for (uint c = 0; c < channels && !silent; ++c) {
+        float *channelSamples = channelData(c);
+        std::memmove(channelSamples, channelSamples + toDiscard, newFrameLenght * sizeof(float));
     }
     setFrameLenght(newFrameLenght);
 }
@@ -59,93 +153,121 @@ void SamplesBuffer::append(const SamplesBuffer &other)
     set(other, 0, other.frameLenght, internalOffset);
 }
 
-float *SamplesBuffer::getSamplesArray(unsigned int channel) const
+float *SamplesBuffer::getSamplesArray(unsigned int channel)
 {
-    if (channel > samples.size())
+    if (channel >= channels)
         channel = 0;
-    return const_cast<float *>(&(samples[channel][0]));
+    silent = false;
+    return channelData(channel);
 }
 
 void SamplesBuffer::applyGain(float gainFactor, float boostFactor)
 {
-    for (unsigned int c = 0; c < channels; ++c) {
-        for (unsigned int i = 0; i < frameLenght; ++i)
-            samples[c][i] *= (gainFactor * boostFactor);
-    }
+    if (silent)
+        return;
+    const Kernels::Functions &kernels = Kernels::get();
+    for (unsigned int c = 0; c < channels; ++c)
+        kernels.applyGain(channelData(c), frameLenght, gainFactor * boostFactor);
 }
 
 void SamplesBuffer::fadeOut(int fadeFrameLenght, float endGain)
 {
+    if (silent)
+        return;
     uint lenght = std::min(fadeFrameLenght, (int)frameLenght);
     float gainStep = (1 - endGain)/lenght;
-    for (unsigned int c = 0; c < channels; ++c) {
-        float gain = 1;
-        for (unsigned int s = 0; s < lenght; ++s) {
-            samples[c][s] *= gain;
-            gain -= gainStep;
-        }
-    }
+    const Kernels::Functions &kernels = Kernels::get();
+    for (unsigned int c = 0; c < channels; ++c)
+        kernels.applyRamp(channelData(c), lenght, 1, -gainStep);
 }
 
 void SamplesBuffer::fadeIn(int fadeFrameLenght, float beginGain)
 {
+    if (silent)
+        return;
     uint lenght = std::min(fadeFrameLenght, (int)frameLenght);
     float gainStep = (1 - beginGain)/lenght;
-    for (unsigned int c = 0; c < channels; ++c) {
-        float gain = beginGain;
-        for (unsigned int s = 0; s < lenght; ++s) {
-            samples[c][s] *= gain;
-            gain += gainStep;
-        }
-    }
+    const Kernels::Functions &kernels = Kernels::get();
+    for (unsigned int c = 0; c < channels; ++c)
+        kernels.applyRamp(channelData(c), lenght, beginGain, gainStep);
 }
 
 void SamplesBuffer::fade(float beginGain, float endGain)
 {
+    if (silent)
+        return;
     float gainStep = (endGain - beginGain)/frameLenght;
-    for (unsigned int c = 0; c < channels; ++c) {
-        float gain = beginGain;
-        for (unsigned int s = 0; s < frameLenght; ++s) {
-            samples[c][s] *= gain;
-            gain += gainStep;
-        }
-    }
+    const Kernels::Functions &kernels = Kernels::get();
+    for (unsigned int c = 0; c < channels; ++c)
+        kernels.applyRamp(channelData(c), frameLenght, beginGain, gainStep);
 }
 
 void SamplesBuffer::applyGain(float gainFactor, float leftGain, float rightGain, float boostFactor)
 {
+    if (silent)
+        return;
     if (!isMono()) {
         float commonGain = gainFactor * boostFactor;
-        float finalLeftGain = commonGain * leftGain;
-        float finalRightGain = commonGain * rightGain;
-        for (unsigned int i = 0; i < frameLenght; ++i) {
-            samples[0][i] *= finalLeftGain;
-            samples[1][i] *= finalRightGain;
-        }
+        const Kernels::Functions &kernels = Kernels::get();
+        kernels.applyGain(channelData(0), frameLenght, commonGain * leftGain);
+        kernels.applyGain(channelData(1), frameLenght, commonGain * rightGain);
     } else {
         applyGain(gainFactor, boostFactor);
     }
 }
 
+AudioPeak SamplesBuffer::applyGainAndComputePeak(float gainFactor, float boostFactor)
+{
+    if (silent)
+        return AudioPeak();
+    const Kernels::Functions &kernels = Kernels::get();
+    float peaks[2] = {0};// left and right peaks
+    for (unsigned int c = 0; c < channels; ++c) {
+        float peak = kernels.applyGainAndComputePeak(channelData(c), frameLenght,
+                                                     gainFactor * boostFactor);
+        if (c < 2)
+            peaks[c] = peak;
+    }
+    if (isMono())
+        peaks[1] = peaks[0];
+    return AudioPeak(peaks[0], peaks[1]);
+}
+
+AudioPeak SamplesBuffer::applyGainAndComputePeak(float gainFactor, float leftGain, float rightGain,
+                                                 float boostFactor)
+{
+    if (silent)
+        return AudioPeak();
+    if (isMono())
+        return applyGainAndComputePeak(gainFactor, boostFactor);
+
+    float commonGain = gainFactor * boostFactor;
+    const Kernels::Functions &kernels = Kernels::get();
+    float leftPeak = kernels.applyGainAndComputePeak(channelData(0), frameLenght,
+                                                     commonGain * leftGain);
+    float rightPeak = kernels.applyGainAndComputePeak(channelData(1), frameLenght,
+                                                      commonGain * rightGain);
+    return AudioPeak(leftPeak, rightPeak);
+}
+
 void SamplesBuffer::zero()
 {
+    if (silent)
+        return;
     for (unsigned int c = 0; c < channels; ++c)
-        std::fill(samples[c].begin(), samples[c].end(), (float)0);
+        std::memset(channelData(c), 0, frameLenght * sizeof(float));
+    silent = true;
 }
 
 AudioPeak SamplesBuffer::computePeak() const
 {
-    float abs;
+    if (silent)
+        return AudioPeak();
+    const Kernels::Functions &kernels = Kernels::get();
     float peaks[2] = {0};// left and right peaks
-    for (unsigned int c = 0; c < channels; ++c) {
-        float maxPeak = 0;
-        for (unsigned int i = 0; i < frameLenght; ++i) {
-            abs = fabs(samples[c][i]);
-            if (abs > maxPeak)
-                maxPeak = abs;
-            peaks[c] = maxPeak;
-        }
-    }
+    unsigned int channelsToProcess = std::min(channels, 2u);
+    for (unsigned int c = 0; c < channelsToProcess; ++c)
+        peaks[c] = kernels.computePeak(channelData(c), frameLenght);
     if (isMono())
         peaks[1] = peaks[0];
     return AudioPeak(peaks[0], peaks[1]);
@@ -153,24 +275,27 @@ AudioPeak SamplesBuffer::computePeak() const
 
 void SamplesBuffer::add(const SamplesBuffer &buffer, int internalWriteOffset)
 {
-    unsigned int framesToProcess = std::min((int)frameLenght, buffer.getFrameLenght());
+    if (buffer.silent || internalWriteOffset < 0 || internalWriteOffset >= (int)frameLenght)
+        return;
+    silent = false;
+    unsigned int framesToProcess = std::min((int)frameLenght - internalWriteOffset,
+                                            buffer.getFrameLenght());
+    const Kernels::Functions &kernels = Kernels::get();
     if (buffer.channels >= channels) {
-        for (unsigned int c = 0; c < channels; ++c) {
-            for (unsigned int s = 0; s < framesToProcess; ++s)
-                samples[c][s + internalWriteOffset] += buffer.samples[c][s];
-        }
+        for (unsigned int c = 0; c < channels; ++c)
+            kernels.mix(channelData(c) + internalWriteOffset, buffer.channelData(c),
+                        framesToProcess);
     } else {// samples is stereo and buffer is mono
-        for (unsigned int s = 0; s < framesToProcess; ++s) {
-            samples[0][s + internalWriteOffset] += buffer.samples[0][s];
-            samples[1][s + internalWriteOffset] += buffer.samples[0][s];
-        }
+        kernels.mix(channelData(0) + internalWriteOffset, buffer.channelData(0), framesToProcess);
+        kernels.mix(channelData(1) + internalWriteOffset, buffer.channelData(0), framesToProcess);
     }
 }
 
 void SamplesBuffer::add(unsigned int channel, float *samples, int samplesToAdd)
 {
     if (channel < channels) {
-        void *dest = &(this->samples[channel][0]);
+        silent = false;
+        void *dest = channelData(channel);
         memcpy(dest, samples, std::min((int)frameLenght, samplesToAdd) * sizeof(float));
     } else {
         qWarning() << "wrong channel " << channel;
@@ -179,18 +304,22 @@ void SamplesBuffer::add(unsigned int channel, float *samples, int samplesToAdd)
 
 void SamplesBuffer::add(int channel, int sampleIndex, float sampleValue)
 {
-    if (channelIsValid(channel) && sampleIndexIsValid(sampleIndex))
-        samples[channel][sampleIndex] += sampleValue;
-    else
+    if (channelIsValid(channel) && sampleIndexIsValid(sampleIndex)) {
+        channelData(channel)[sampleIndex] += sampleValue;
+        silent = false;
+    } else {
         qWarning() << "channel ("<<channel<<") or sampleIndex ("<<sampleIndex<<") invalid";
+    }
 }
 
 void SamplesBuffer::set(int channel, int sampleIndex, float sampleValue)
 {
-    if (channelIsValid(channel) && sampleIndexIsValid(sampleIndex))
-        samples[channel][sampleIndex] = sampleValue;
-    else
+    if (channelIsValid(channel) && sampleIndexIsValid(sampleIndex)) {
+        channelData(channel)[sampleIndex] = sampleValue;
+        silent = false;
+    } else {
         qWarning() << "channel ("<<channel<<") or sampleIndex ("<<sampleIndex<<") invalid";
+    }
 }
 
 int SamplesBuffer::getFrameLenght() const
@@ -206,18 +335,18 @@ void SamplesBuffer::setToMono()
 
 void SamplesBuffer::setToStereo()
 {
-    if (this->samples.size() < 2) {
-        size_t channelsToAdd = 2 - this->samples.size();
-        for (uint c = 0; c < channelsToAdd; ++c)
-            samples.push_back(std::vector<float>(frameLenght));
-    }
-    for (unsigned int c = 0; c < samples.size(); ++c)
-        samples[c].resize(frameLenght);
+    reserve(2, frameLenght);// the new channel is zeroed
+    if (channels == 1 && silent)// the right channel can contain old samples
+        std::memset(channelData(1), 0, frameLenght * sizeof(float));
     this->channels = 2;
 }
 
 void SamplesBuffer::set(const SamplesBuffer &buffer)
 {
+    if (buffer.silent && buffer.frameLenght >= frameLenght) {
+        zero();// all samples replaced by silence
+        return;
+    }
     set(buffer, 0, std::min(buffer.frameLenght, frameLenght), 0);
 }
 
@@ -225,7 +354,34 @@ float SamplesBuffer::get(int channel, int sampleIndex) const
 {
     if (!channelIsValid(channel) || !sampleIndexIsValid(sampleIndex))
         return 0;
-    return samples[channel][sampleIndex ];
+    return channelData(channel)[sampleIndex];
+}
+
+void SamplesBuffer::setInterleavedSamples(const float *interleaved, unsigned int interleavedChannels)
+{
+    unsigned int channelsToCopy = std::min(channels, interleavedChannels);
+    silent = false;
+    for (unsigned int c = 0; c < channelsToCopy; ++c) {
+        float *channelSamples = channelData(c);
+        const float *source = interleaved + c;
+        for (unsigned int i = 0; i < frameLenght; ++i, source += interleavedChannels)
+            channelSamples[i] = *source;
+    }
+}
+
+void SamplesBuffer::getInterleavedSamples(float *interleaved, unsigned int interleavedChannels) const
+{
+    for (unsigned int c = 0; c < interleavedChannels; ++c) {
+        float *dest = interleaved + c;
+        if (c < channels) {
+            const float *channelSamples = channelData(c);
+            for (unsigned int i = 0; i < frameLenght; ++i, dest += interleavedChannels)
+                *dest = channelSamples[i];
+        } else {
+            for (unsigned int i = 0; i < frameLenght; ++i, dest += interleavedChannels)
+                *dest = 0;
+        }
+    }
 }
 
 void SamplesBuffer::setFrameLenght(unsigned int newFrameLenght)
@@ -233,9 +389,11 @@ void SamplesBuffer::setFrameLenght(unsigned int newFrameLenght)
     if (newFrameLenght == frameLenght)
         return;
 
-    if (newFrameLenght > 0) {
+    reserve(channels, newFrameLenght);
+    if (newFrameLenght > frameLenght) {// the new samples are always zeroed
         for (unsigned int c = 0; c < channels; ++c)
-            samples[c].resize(newFrameLenght);
+            std::memset(channelData(c) + frameLenght, 0,
+                        (newFrameLenght - frameLenght) * sizeof(float));
     }
     this->frameLenght = newFrameLenght;
 }
@@ -246,11 +404,13 @@ void SamplesBuffer::set(const SamplesBuffer &buffer, int bufferChannelOffset, in
         return;
     int framesToCopy = std::min(buffer.getFrameLenght(), (int)frameLenght);
     int channelsToProcess = std::min(channelsToCopy, std::min(buffer.getChannels(), (int)channels));
+    if (buffer.silent && silent)
+        return;// zeros over zeros
     if (channelsToProcess + bufferChannelOffset <= buffer.getChannels()) {// avoid invalid channel index
         int bytesToCopy = framesToCopy * sizeof(float);
         for (int c = 0; c < channelsToProcess; ++c)
-            memcpy((void *)getSamplesArray(c), buffer.getSamplesArray(
-                       c + bufferChannelOffset), bytesToCopy);
+            memcpy((void *)channelData(c), buffer.channelData(c + bufferChannelOffset), bytesToCopy);
+        silent = false;
     }
 }
 
@@ -259,38 +419,40 @@ void SamplesBuffer::set(const SamplesBuffer &buffer, unsigned int bufferOffset,
 {
     if (buffer.channels <= 0 || channels <= 0)
         return;
+    if (bufferOffset >= buffer.frameLenght || internalOffset >= frameLenght)
+        return;
+    if (buffer.silent && silent)
+        return;// zeros over zeros
+    silent = false;
 
-    unsigned int framesToProcess = std::min(samplesToCopy, buffer.getFrameLenght() - bufferOffset);
-    if (framesToProcess > buffer.frameLenght)// não processa mais samples do que a quantidade existente em buffer
-        framesToProcess = buffer.frameLenght;
-    if ((int)(internalOffset + framesToProcess) > this->getFrameLenght())
-        framesToProcess = (internalOffset + framesToProcess) - this->getFrameLenght();
+    unsigned int framesToProcess = std::min(samplesToCopy, buffer.frameLenght - bufferOffset);
+    if (internalOffset + framesToProcess > frameLenght)
+        framesToProcess = frameLenght - internalOffset;
+    size_t bytesToCopy = framesToProcess * sizeof(float);
 
     if (channels == buffer.channels) {// channels number are equal
-        for (unsigned int c = 0; c < channels; ++c) {
-            for (unsigned int s = 0; s < framesToProcess; ++s)
-                samples[c][s + internalOffset] = buffer.samples[c][s + bufferOffset];
-        }
+        for (unsigned int c = 0; c < channels; ++c)
+            std::memcpy(channelData(c) + internalOffset, buffer.channelData(c) + bufferOffset,
+                        bytesToCopy);
     } else {// different number of channels
         if (!isMono()) {// copy every &buffer samples to LR in this buffer
             if (!buffer.isMono()) {
                 int channelsToCopy = qMin(channels, buffer.channels);
-                for (int c = 0; c < channelsToCopy; ++c) {
-                    for (unsigned int s = 0; s < framesToProcess; ++s)
-                        samples[c][s + internalOffset] = buffer.samples[c][s + bufferOffset];
-                }
+                for (int c = 0; c < channelsToCopy; ++c)
+                    std::memcpy(channelData(c) + internalOffset,
+                                buffer.channelData(c) + bufferOffset, bytesToCopy);
             } else {
-                for (unsigned int s = 0; s < framesToProcess; ++s) {
-                    samples[0][s + internalOffset] = buffer.samples[0][s + bufferOffset];
-                    samples[1][s + internalOffset] = buffer.samples[0][s + bufferOffset];
-                }
+                std::memcpy(channelData(0) + internalOffset, buffer.channelData(0) + bufferOffset,
+                            bytesToCopy);
+                std::memcpy(channelData(1) + internalOffset, buffer.channelData(0) + bufferOffset,
+                            bytesToCopy);
             }
         } else {// this buffer is mono, but the buffer in parameter is not! Mix down the stereo samples in one mono sample value.
-            for (unsigned int s = 0; s < framesToProcess; ++s) {
-                int index = s + bufferOffset;
-                float v = (buffer.samples[0][index] + buffer.samples[1][index])/2.0f;
-                samples[0][s + internalOffset] = v;
-            }
+            float *dest = channelData(0) + internalOffset;
+            const float *left = buffer.channelData(0) + bufferOffset;
+            const float *right = buffer.channelData(1) + bufferOffset;
+            for (unsigned int s = 0; s < framesToProcess; ++s)
+                dest[s] = (left[s] + right[s])/2.0f;
         }
     }
 }
@@ -2,7 +2,6 @@
 #define SAMPLESBUFFER_H
 
 #include "AudioPeak.h"
-#include <vector>
 
 namespace Audio {
 class SamplesBuffer
@@ -12,7 +11,24 @@ private:
     unsigned int channels;
     unsigned int frameLenght;
 
-    std::vector< std::vector<float> > samples;
+    // planar samples in one 32-byte aligned block, channel 'c' starts at samples + c * allocatedFrames
+    float *samples;
+    unsigned int allocatedChannels;
+    unsigned int allocatedFrames;// always multiple of 8 floats, so every channel is aligned too
+
+    // the first sample of each channel, in the internal block or in the external samples
+    float **channelPointers;
+    bool externalSamples;
+    unsigned int externalFrames;
+
+    bool silent;// see isSilent()
+
+    void reserve(unsigned int channelsToReserve, unsigned int framesToReserve);// keep the current samples
+
+    inline float *channelData(unsigned int channel) const
+    {
+        return channelPointers[channel];
+    }
 
     inline bool channelIsValid(unsigned int channel) const
     {
@@ -38,7 +54,23 @@ public:
         return channels == 1;
     }
 
-    float *getSamplesArray(unsigned int channel) const;
+    float *getSamplesArray(unsigned int channel);// the buffer is not silent after this call
+
+    // the samples can't be changed, the silent flag is preserved (used by the const buffers)
+    inline const float *getReadOnlySamplesArray(unsigned int channel) const
+    {
+        return channelData(channel < channels ? channel : 0);
+    }
+
+    /**
+     * True when all samples are zero. The flag is set by zero() and cleared by the methods
+     * writing samples (including getSamplesArray(), the caller can write in the returned array).
+     * Silent buffers are not mixed, the gains and peaks are not computed and zero() is free.
+     */
+    inline bool isSilent() const
+    {
+        return silent;
+    }
 
     void discardFirstSamples(unsigned int samplesToDiscard);// discard N samples and set frame lenght to new size
     void append(const SamplesBuffer &other);
@@ -53,6 +85,11 @@ public:
     // panValue between [-1, 0, 1] => LEFT, CENTER, RIGHT
     void applyGain(float gainFactor, float leftGain, float rightGain, float boostFactor);
 
+    // fused versions of applyGain() + computePeak(), the samples are read just one time
+    Audio::AudioPeak applyGainAndComputePeak(float gainFactor, float boostFactor);
+    Audio::AudioPeak applyGainAndComputePeak(float gainFactor, float leftGain, float rightGain,
+                                             float boostFactor);
+
     void zero();
 
     void setToMono();
@@ -78,6 +115,23 @@ public:
 
     float get(int channel, int sampleIndex) const;
 
+    // convert from/to interleaved samples (audio drivers), no bounds check per sample
+    void setInterleavedSamples(const float *interleaved, unsigned int interleavedChannels);
+    void getInterleavedSamples(float *interleaved, unsigned int interleavedChannels) const;
+
+    /**
+     * Use the non interleaved samples of an audio driver without copying (one pointer per channel,
+     * 'frames' samples each). The caller memory is used until releaseExternalSamples() is called
+     * or the buffer needs more channels or frames, in this case the samples are copied to the
+     * internal memory again.
+     */
+    void setExternalSamples(float *const *channelSamples, unsigned int frames);
+    void releaseExternalSamples();// the external samples are discarded and the buffer is empty
+    inline bool isUsingExternalSamples() const
+    {
+        return externalSamples;
+    }
+
     int getFrameLenght() const;// { return frameLenght; }
     void setFrameLenght(unsigned int newFrameLenght);
     inline int getChannels() const
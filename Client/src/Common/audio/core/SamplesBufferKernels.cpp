@@ -0,0 +1,585 @@
+#include "SamplesBufferKernels.h"
+#include <climits>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define JT_KERNELS_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define JT_TARGET_SSE
+        #define JT_TARGET_AVX
+    #else
+        #define JT_TARGET_SSE __attribute__((target("sse2")))
+        #define JT_TARGET_AVX __attribute__((target("avx")))
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define JT_KERNELS_NEON
+    #include <arm_neon.h>
+#endif
+
+using namespace Audio;
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// scalar (reference) implementation
+
+namespace {
+const float SHORT_TO_FLOAT = 1.0f / SHRT_MAX;
+
+void scalarApplyGain(float *samples, unsigned int frames, float gain)
+{
+    for (unsigned int i = 0; i < frames; ++i)
+        samples[i] *= gain;
+}
+
+float scalarApplyGainAndComputePeak(float *samples, unsigned int frames, float gain)
+{
+    float peak = 0;
+    for (unsigned int i = 0; i < frames; ++i) {
+        samples[i] *= gain;
+        float abs = std::fabs(samples[i]);
+        if (abs > peak)
+            peak = abs;
+    }
+    return peak;
+}
+
+float scalarComputePeak(const float *samples, unsigned int frames)
+{
+    float peak = 0;
+    for (unsigned int i = 0; i < frames; ++i) {
+        float abs = std::fabs(samples[i]);
+        if (abs > peak)
+            peak = abs;
+    }
+    return peak;
+}
+
+void scalarMix(float *dest, const float *source, unsigned int frames)
+{
+    for (unsigned int i = 0; i < frames; ++i)
+        dest[i] += source[i];
+}
+
+void scalarApplyRamp(float *samples, unsigned int frames, float beginGain, float gainStep)
+{
+    for (unsigned int i = 0; i < frames; ++i)
+        samples[i] *= beginGain + i * gainStep;
+}
+
+float scalarDotProduct(const float *a, const float *b, unsigned int frames)
+{
+    float sum = 0;
+    for (unsigned int i = 0; i < frames; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+void scalarConvertShorts(float *dest, const short *source, unsigned int frames)
+{
+    for (unsigned int i = 0; i < frames; ++i)
+        dest[i] = source[i] * SHORT_TO_FLOAT;
+}
+
+void scalarDeinterleaveShorts(float *left, float *right, const short *source, unsigned int frames)
+{
+    for (unsigned int i = 0; i < frames; ++i) {
+        left[i] = source[2 * i] * SHORT_TO_FLOAT;
+        right[i] = source[2 * i + 1] * SHORT_TO_FLOAT;
+    }
+}
+
+void scalarConvertToInts(int *dest, const float *source, unsigned int frames, float scale)
+{
+    for (unsigned int i = 0; i < frames; ++i) {
+        // the same comparisons of the SIMD max/min, NaN is clipped to -1 and never reaches lrint
+        float sample = source[i] > -1.0f ? source[i] : -1.0f;
+        sample = sample < 1.0f ? sample : 1.0f;
+        dest[i] = (int)std::lrint(sample * scale);// round half to even, like the SIMD conversions
+    }
+}
+
+const Kernels::Functions SCALAR_FUNCTIONS = {
+    "scalar",
+    scalarApplyGain,
+    scalarApplyGainAndComputePeak,
+    scalarComputePeak,
+    scalarMix,
+    scalarApplyRamp,
+    scalarDotProduct,
+    scalarConvertShorts,
+    scalarDeinterleaveShorts,
+    scalarConvertToInts
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#ifdef JT_KERNELS_X86
+
+JT_TARGET_SSE inline __m128 sseAbs(__m128 values)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), values);// clear the sign bit
+}
+
+JT_TARGET_SSE inline float sseHorizontalMax(__m128 values)
+{
+    values = _mm_max_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+    values = _mm_max_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(values);
+}
+
+JT_TARGET_SSE void sseApplyGain(float *samples, unsigned int frames, float gain)
+{
+    const __m128 gains = _mm_set1_ps(gain);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gains));
+    scalarApplyGain(samples + i, frames - i, gain);
+}
+
+JT_TARGET_SSE float sseApplyGainAndComputePeak(float *samples, unsigned int frames, float gain)
+{
+    const __m128 gains = _mm_set1_ps(gain);
+    __m128 peaks = _mm_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 values = _mm_mul_ps(_mm_loadu_ps(samples + i), gains);
+        _mm_storeu_ps(samples + i, values);
+        peaks = _mm_max_ps(peaks, sseAbs(values));
+    }
+    float peak = sseHorizontalMax(peaks);
+    float tailPeak = scalarApplyGainAndComputePeak(samples + i, frames - i, gain);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+JT_TARGET_SSE float sseComputePeak(const float *samples, unsigned int frames)
+{
+    __m128 peaks = _mm_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        peaks = _mm_max_ps(peaks, sseAbs(_mm_loadu_ps(samples + i)));
+    float peak = sseHorizontalMax(peaks);
+    float tailPeak = scalarComputePeak(samples + i, frames - i);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+JT_TARGET_SSE void sseMix(float *dest, const float *source, unsigned int frames)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_loadu_ps(source + i)));
+    scalarMix(dest + i, source + i, frames - i);
+}
+
+JT_TARGET_SSE void sseApplyRamp(float *samples, unsigned int frames, float beginGain,
+                                float gainStep)
+{
+    __m128 gains = _mm_add_ps(_mm_set1_ps(beginGain),
+                              _mm_mul_ps(_mm_set1_ps(gainStep), _mm_set_ps(3, 2, 1, 0)));
+    const __m128 increment = _mm_set1_ps(gainStep * 4);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gains));
+        gains = _mm_add_ps(gains, increment);
+    }
+    scalarApplyRamp(samples + i, frames - i, beginGain + i * gainStep, gainStep);
+}
+
+JT_TARGET_SSE float sseDotProduct(const float *a, const float *b, unsigned int frames)
+{
+    __m128 sums = _mm_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        sums = _mm_add_ps(sums, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+    sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sums) + scalarDotProduct(a + i, b + i, frames - i);
+}
+
+JT_TARGET_SSE void sseConvertShorts(float *dest, const short *source, unsigned int frames)
+{
+    const __m128 scale = _mm_set1_ps(SHORT_TO_FLOAT);
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(source + i));
+        // each short in the high half of a 32 bits lane, the arithmetic shift extends the sign
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16);
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+    scalarConvertShorts(dest + i, source + i, frames - i);
+}
+
+JT_TARGET_SSE void sseDeinterleaveShorts(float *left, float *right, const short *source,
+                                         unsigned int frames)
+{
+    const __m128 scale = _mm_set1_ps(SHORT_TO_FLOAT);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(source + 2 * i));// L R L R L R L R
+        __m128i leftValues = _mm_srai_epi32(_mm_slli_epi32(values, 16), 16);
+        __m128i rightValues = _mm_srai_epi32(values, 16);
+        _mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(leftValues), scale));
+        _mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(rightValues), scale));
+    }
+    scalarDeinterleaveShorts(left + i, right + i, source + 2 * i, frames - i);
+}
+
+JT_TARGET_SSE void sseConvertToInts(int *dest, const float *source, unsigned int frames,
+                                    float scale)
+{
+    const __m128 scales = _mm_set1_ps(scale);
+    const __m128 min = _mm_set1_ps(-1.0f);
+    const __m128 max = _mm_set1_ps(1.0f);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 values = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), min), max);
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_cvtps_epi32(_mm_mul_ps(values, scales)));
+    }
+    scalarConvertToInts(dest + i, source + i, frames - i, scale);
+}
+
+const Kernels::Functions SSE_FUNCTIONS = {
+    "sse",
+    sseApplyGain,
+    sseApplyGainAndComputePeak,
+    sseComputePeak,
+    sseMix,
+    sseApplyRamp,
+    sseDotProduct,
+    sseConvertShorts,
+    sseDeinterleaveShorts,
+    sseConvertToInts
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+JT_TARGET_AVX inline __m256 avxAbs(__m256 values)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), values);
+}
+
+JT_TARGET_AVX inline float avxHorizontalMax(__m256 values)
+{
+    __m128 max = _mm_max_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+    max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+    max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(max);
+}
+
+JT_TARGET_AVX void avxApplyGain(float *samples, unsigned int frames, float gain)
+{
+    const __m256 gains = _mm256_set1_ps(gain);
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gains));
+    scalarApplyGain(samples + i, frames - i, gain);
+}
+
+JT_TARGET_AVX float avxApplyGainAndComputePeak(float *samples, unsigned int frames, float gain)
+{
+    const __m256 gains = _mm256_set1_ps(gain);
+    __m256 peaks = _mm256_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 values = _mm256_mul_ps(_mm256_loadu_ps(samples + i), gains);
+        _mm256_storeu_ps(samples + i, values);
+        peaks = _mm256_max_ps(peaks, avxAbs(values));
+    }
+    float peak = avxHorizontalMax(peaks);
+    float tailPeak = scalarApplyGainAndComputePeak(samples + i, frames - i, gain);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+JT_TARGET_AVX float avxComputePeak(const float *samples, unsigned int frames)
+{
+    __m256 peaks = _mm256_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8)
+        peaks = _mm256_max_ps(peaks, avxAbs(_mm256_loadu_ps(samples + i)));
+    float peak = avxHorizontalMax(peaks);
+    float tailPeak = scalarComputePeak(samples + i, frames - i);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+JT_TARGET_AVX void avxMix(float *dest, const float *source, unsigned int frames)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        _mm256_storeu_ps(dest + i, _mm256_add_ps(_mm256_loadu_ps(dest + i),
+                                                 _mm256_loadu_ps(source + i)));
+    }
+    scalarMix(dest + i, source + i, frames - i);
+}
+
+JT_TARGET_AVX void avxApplyRamp(float *samples, unsigned int frames, float beginGain,
+                                float gainStep)
+{
+    __m256 gains = _mm256_add_ps(_mm256_set1_ps(beginGain),
+                                 _mm256_mul_ps(_mm256_set1_ps(gainStep),
+                                               _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0)));
+    const __m256 increment = _mm256_set1_ps(gainStep * 8);
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gains));
+        gains = _mm256_add_ps(gains, increment);
+    }
+    scalarApplyRamp(samples + i, frames - i, beginGain + i * gainStep, gainStep);
+}
+
+JT_TARGET_AVX float avxDotProduct(const float *a, const float *b, unsigned int frames)
+{
+    __m256 sums = _mm256_setzero_ps();
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8)
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum) + scalarDotProduct(a + i, b + i, frames - i);
+}
+
+JT_TARGET_AVX void avxConvertToInts(int *dest, const float *source, unsigned int frames,
+                                    float scale)
+{
+    const __m256 scales = _mm256_set1_ps(scale);
+    const __m256 min = _mm256_set1_ps(-1.0f);
+    const __m256 max = _mm256_set1_ps(1.0f);
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 values = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + i), min), max);
+        _mm256_storeu_si256((__m256i *)(dest + i),
+                            _mm256_cvtps_epi32(_mm256_mul_ps(values, scales)));
+    }
+    scalarConvertToInts(dest + i, source + i, frames - i, scale);
+}
+
+// AVX has no 256 bits integer instructions (AVX2), the short conversions use SSE. The float to
+// int32 conversion is available in AVX.
+const Kernels::Functions AVX_FUNCTIONS = {
+    "avx",
+    avxApplyGain,
+    avxApplyGainAndComputePeak,
+    avxComputePeak,
+    avxMix,
+    avxApplyRamp,
+    avxDotProduct,
+    sseConvertShorts,
+    sseDeinterleaveShorts,
+    avxConvertToInts
+};
+
+bool cpuSupportsSse()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;// SSE2
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpuSupportsAvx()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osUsesXsave = (info[2] & (1 << 27)) != 0;
+    bool cpuHasAvx = (info[2] & (1 << 28)) != 0;
+    if (!osUsesXsave || !cpuHasAvx)
+        return false;
+    return (_xgetbv(0) & 0x6) == 0x6;// the OS is saving the AVX registers
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif // JT_KERNELS_X86
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#ifdef JT_KERNELS_NEON
+
+inline float neonHorizontalMax(float32x4_t values)
+{
+    float32x2_t max = vpmax_f32(vget_low_f32(values), vget_high_f32(values));
+    max = vpmax_f32(max, max);
+    return vget_lane_f32(max, 0);
+}
+
+void neonApplyGain(float *samples, unsigned int frames, float gain)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+    scalarApplyGain(samples + i, frames - i, gain);
+}
+
+float neonApplyGainAndComputePeak(float *samples, unsigned int frames, float gain)
+{
+    float32x4_t peaks = vdupq_n_f32(0);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t values = vmulq_n_f32(vld1q_f32(samples + i), gain);
+        vst1q_f32(samples + i, values);
+        peaks = vmaxq_f32(peaks, vabsq_f32(values));
+    }
+    float peak = neonHorizontalMax(peaks);
+    float tailPeak = scalarApplyGainAndComputePeak(samples + i, frames - i, gain);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+float neonComputePeak(const float *samples, unsigned int frames)
+{
+    float32x4_t peaks = vdupq_n_f32(0);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        peaks = vmaxq_f32(peaks, vabsq_f32(vld1q_f32(samples + i)));
+    float peak = neonHorizontalMax(peaks);
+    float tailPeak = scalarComputePeak(samples + i, frames - i);
+    return tailPeak > peak ? tailPeak : peak;
+}
+
+void neonMix(float *dest, const float *source, unsigned int frames)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        vst1q_f32(dest + i, vaddq_f32(vld1q_f32(dest + i), vld1q_f32(source + i)));
+    scalarMix(dest + i, source + i, frames - i);
+}
+
+void neonApplyRamp(float *samples, unsigned int frames, float beginGain, float gainStep)
+{
+    const float firstGains[4] = {
+        beginGain, beginGain + gainStep, beginGain + 2 * gainStep, beginGain + 3 * gainStep
+    };
+    float32x4_t gains = vld1q_f32(firstGains);
+    const float32x4_t increment = vdupq_n_f32(gainStep * 4);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), gains));
+        gains = vaddq_f32(gains, increment);
+    }
+    scalarApplyRamp(samples + i, frames - i, beginGain + i * gainStep, gainStep);
+}
+
+float neonDotProduct(const float *a, const float *b, unsigned int frames)
+{
+    float32x4_t sums = vdupq_n_f32(0);
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4)
+        sums = vmlaq_f32(sums, vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x2_t sum = vadd_f32(vget_low_f32(sums), vget_high_f32(sums));
+    sum = vpadd_f32(sum, sum);
+    return vget_lane_f32(sum, 0) + scalarDotProduct(a + i, b + i, frames - i);
+}
+
+void neonConvertShorts(float *dest, const short *source, unsigned int frames)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        int16x8_t values = vld1q_s16(source + i);
+        vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(values))),
+                                        SHORT_TO_FLOAT));
+        vst1q_f32(dest + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(values))),
+                                            SHORT_TO_FLOAT));
+    }
+    scalarConvertShorts(dest + i, source + i, frames - i);
+}
+
+void neonDeinterleaveShorts(float *left, float *right, const short *source, unsigned int frames)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int16x4x2_t values = vld2_s16(source + 2 * i);// deinterleaved load
+        vst1q_f32(left + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(values.val[0])), SHORT_TO_FLOAT));
+        vst1q_f32(right + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(values.val[1])), SHORT_TO_FLOAT));
+    }
+    scalarDeinterleaveShorts(left + i, right + i, source + 2 * i, frames - i);
+}
+
+void neonConvertToInts(int *dest, const float *source, unsigned int frames, float scale)
+{
+    unsigned int i = 0;
+#ifdef __aarch64__// the round to nearest conversion is not available in ARMv7
+    const float32x4_t min = vdupq_n_f32(-1.0f);
+    const float32x4_t max = vdupq_n_f32(1.0f);
+    for (; i + 4 <= frames; i += 4) {
+        // vmaxnmq returns -1 for NaN, like the SSE max
+        float32x4_t values = vminq_f32(vmaxnmq_f32(vld1q_f32(source + i), min), max);
+        vst1q_s32(dest + i, vcvtnq_s32_f32(vmulq_n_f32(values, scale)));
+    }
+#endif
+    scalarConvertToInts(dest + i, source + i, frames - i, scale);
+}
+
+const Kernels::Functions NEON_FUNCTIONS = {
+    "neon",
+    neonApplyGain,
+    neonApplyGainAndComputePeak,
+    neonComputePeak,
+    neonMix,
+    neonApplyRamp,
+    neonDotProduct,
+    neonConvertShorts,
+    neonDeinterleaveShorts,
+    neonConvertToInts
+};
+
+#endif // JT_KERNELS_NEON
+
+const Kernels::Functions *selectBestFunctions()
+{
+    if (Kernels::avx())
+        return Kernels::avx();
+    if (Kernels::sse())
+        return Kernels::sse();
+    if (Kernels::neon())
+        return Kernels::neon();
+    return &Kernels::scalar();
+}
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+const Kernels::Functions &Kernels::scalar()
+{
+    return SCALAR_FUNCTIONS;
+}
+
+const Kernels::Functions *Kernels::sse()
+{
+#ifdef JT_KERNELS_X86
+    static const bool supported = cpuSupportsSse();
+    return supported ? &SSE_FUNCTIONS : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const Kernels::Functions *Kernels::avx()
+{
+#ifdef JT_KERNELS_X86
+    static const bool supported = cpuSupportsAvx();
+    return supported ? &AVX_FUNCTIONS : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const Kernels::Functions *Kernels::neon()
+{
+#ifdef JT_KERNELS_NEON
+    return &NEON_FUNCTIONS;
+#else
+    return nullptr;
+#endif
+}
+
+const Kernels::Functions &Kernels::get()
+{
+    static const Functions *bestFunctions = selectBestFunctions();
+    return *bestFunctions;
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLES_BUFFER_KERNELS_H
+#define SAMPLES_BUFFER_KERNELS_H
+
+namespace Audio {
+namespace Kernels {
+/**
+ * The inner loops used by SamplesBuffer. Every function works in one channel (planar samples)
+ * and accepts unaligned pointers, but the SamplesBuffer channels are always 32-byte aligned.
+ *
+ * The best implementation (AVX, SSE, NEON or scalar) is selected at runtime in the first call
+ * to get(). The scalar implementation is the original SamplesBuffer code and is used as
+ * reference in the benchmarks.
+ */
+struct Functions
+{
+    const char *name;
+
+    // samples[i] *= gain
+    void (*applyGain)(float *samples, unsigned int frames, float gain);
+
+    // samples[i] *= gain, return the max absolute value after the gain is applied
+    float (*applyGainAndComputePeak)(float *samples, unsigned int frames, float gain);
+
+    // return the max absolute value
+    float (*computePeak)(const float *samples, unsigned int frames);
+
+    // dest[i] += source[i]
+    void (*mix)(float *dest, const float *source, unsigned int frames);
+
+    // samples[i] *= beginGain + i * gainStep
+    void (*applyRamp)(float *samples, unsigned int frames, float beginGain, float gainStep);
+
+    // sum of a[i] * b[i], used by the resampler filters
+    float (*dotProduct)(const float *a, const float *b, unsigned int frames);
+
+    // dest[i] = source[i] / 32767, the 16 bits PCM produced by the mp3 decoder
+    void (*convertShorts)(float *dest, const short *source, unsigned int frames);
+
+    // left[i] = source[2 * i] / 32767, right[i] = source[2 * i + 1] / 32767 (interleaved stereo PCM)
+    void (*deinterleaveShorts)(float *left, float *right, const short *source, unsigned int frames);
+
+    // dest[i] = source[i] * scale rounded to the nearest integer, source[i] is clipped in [-1, 1]
+    // and NaN is converted to -scale.
+    // Used to write 16 and 24 bits PCM (scale 32767 or 8388607).
+    void (*convertToInts)(int *dest, const float *source, unsigned int frames, float scale);
+};
+
+const Functions &get();// the best implementation for the running CPU
+
+const Functions &scalar();
+const Functions *sse();// nullptr if not supported in this build or CPU
+const Functions *avx();
+const Functions *neon();
+}
+}
+
+#endif // SAMPLES_BUFFER_KERNELS_H
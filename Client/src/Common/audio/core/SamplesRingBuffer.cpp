@@ -0,0 +1,136 @@
+#include "SamplesRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Audio;
+
+namespace {
+// a power of 2 capacity keep the positions continuous when the frame counters overflow
+unsigned int nextPowerOfTwo(unsigned int value)
+{
+    unsigned int power = 1;
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+}
+
+SamplesRingBuffer::SamplesRingBuffer(unsigned int channels, unsigned int capacity) :
+    samples(channels, nextPowerOfTwo(capacity)),
+    capacity(nextPowerOfTwo(capacity)),
+    writtenFrames(0),
+    readedFrames(0),
+    audibleFramesEnd(0)
+{
+}
+
+unsigned int SamplesRingBuffer::getAvailableFrames() const
+{
+    return writtenFrames.load(std::memory_order_acquire)
+           - readedFrames.load(std::memory_order_acquire);
+}
+
+unsigned int SamplesRingBuffer::getFreeFrames() const
+{
+    return capacity - getAvailableFrames();
+}
+
+void SamplesRingBuffer::clear()
+{
+    writtenFrames.store(0);
+    readedFrames.store(0);
+    audibleFramesEnd.store(0);
+}
+
+unsigned int SamplesRingBuffer::write(const SamplesBuffer &in)
+{
+    if (in.isSilent())
+        return writeSilence(in.getFrameLenght());
+
+    unsigned int written = writtenFrames.load(std::memory_order_relaxed);
+    unsigned int framesToWrite = std::min((unsigned int)in.getFrameLenght(),
+                                          capacity - (written - readedFrames.load(std::memory_order_acquire)));
+    if (framesToWrite == 0)
+        return 0;
+
+    unsigned int writePosition = written % capacity;
+    unsigned int firstPart = std::min(framesToWrite, capacity - writePosition);
+    int channels = getChannels();
+    for (int c = 0; c < channels; ++c) {
+        // mono input is copied to all channels
+        const float *source = in.getReadOnlySamplesArray(std::min(c, in.getChannels() - 1));
+        float *dest = samples.getSamplesArray(c);
+        std::memcpy(dest + writePosition, source, firstPart * sizeof(float));
+        std::memcpy(dest, source + firstPart, (framesToWrite - firstPart) * sizeof(float));
+    }
+
+    audibleFramesEnd.store(written + framesToWrite, std::memory_order_relaxed);// published by the release below
+    writtenFrames.store(written + framesToWrite, std::memory_order_release);
+    return framesToWrite;
+}
+
+unsigned int SamplesRingBuffer::writeSilence(unsigned int frames)
+{
+    unsigned int written = writtenFrames.load(std::memory_order_relaxed);
+    unsigned int framesToWrite = std::min(frames,
+                                          capacity - (written - readedFrames.load(std::memory_order_acquire)));
+    if (framesToWrite == 0)
+        return 0;
+
+    // zeroed in the writer thread, the reader can copy these frames together with the audible frames
+    unsigned int writePosition = written % capacity;
+    unsigned int firstPart = std::min(framesToWrite, capacity - writePosition);
+    int channels = getChannels();
+    for (int c = 0; c < channels; ++c) {
+        float *dest = samples.getSamplesArray(c);
+        std::memset(dest + writePosition, 0, firstPart * sizeof(float));
+        std::memset(dest, 0, (framesToWrite - firstPart) * sizeof(float));
+    }
+
+    writtenFrames.store(written + framesToWrite, std::memory_order_release);
+    return framesToWrite;
+}
+
+unsigned int SamplesRingBuffer::read(SamplesBuffer &out, unsigned int frames, unsigned int outOffset)
+{
+    if (outOffset >= (unsigned int)out.getFrameLenght())
+        return 0;
+
+    unsigned int readed = readedFrames.load(std::memory_order_relaxed);
+    unsigned int available = writtenFrames.load(std::memory_order_acquire) - readed;
+    unsigned int framesToRead = std::min(std::min(frames, available),
+                                         out.getFrameLenght() - outOffset);
+    if (framesToRead == 0)
+        return 0;
+
+    // only silence after the read position, the samples are not copied
+    bool silence = (int)(readed - audibleFramesEnd.load(std::memory_order_relaxed)) >= 0;
+    if (silence && outOffset == 0 && framesToRead == (unsigned int)out.getFrameLenght()) {
+        out.zero();
+        readedFrames.store(readed + framesToRead, std::memory_order_release);
+        return framesToRead;
+    }
+
+    unsigned int readPosition = readed % capacity;
+    unsigned int firstPart = std::min(framesToRead, capacity - readPosition);
+    int channels = std::min(getChannels(), out.getChannels());
+    for (int c = 0; c < channels; ++c) {
+        // the silent flag of 'samples' is changed only by the writer thread
+        const float *source = samples.getReadOnlySamplesArray(c);
+        float *dest = out.getSamplesArray(c) + outOffset;
+        std::memcpy(dest, source + readPosition, firstPart * sizeof(float));
+        std::memcpy(dest + firstPart, source, (framesToRead - firstPart) * sizeof(float));
+    }
+
+    readedFrames.store(readed + framesToRead, std::memory_order_release);
+    return framesToRead;
+}
+
+unsigned int SamplesRingBuffer::skip(unsigned int frames)
+{
+    unsigned int readed = readedFrames.load(std::memory_order_relaxed);
+    unsigned int available = writtenFrames.load(std::memory_order_acquire) - readed;
+    unsigned int framesToSkip = std::min(frames, available);
+    readedFrames.store(readed + framesToSkip, std::memory_order_release);
+    return framesToSkip;
+}
@@ -0,0 +1,62 @@
+#ifndef SAMPLES_RING_BUFFER_H
+#define SAMPLES_RING_BUFFER_H
+
+#include "SamplesBuffer.h"
+#include <atomic>
+
+namespace Audio {
+/**
+ * Lock-free FIFO of planar samples with one writer thread and one reader thread.
+ *
+ * The capacity is allocated in the constructor, write() and read() only copy samples, so the
+ * audio thread can be in any side. write() accepts only the frames that fit in the free space.
+ * The capacity is rounded up to a power of 2.
+ *
+ * The silent writes are tracked, when the reader is only reading silence the output buffer is
+ * just zeroed and marked as silent (see SamplesBuffer::isSilent()).
+ */
+class SamplesRingBuffer
+{
+public:
+    SamplesRingBuffer(unsigned int channels, unsigned int capacity);
+
+    // writer thread, return how many frames were copied from 'in'
+    unsigned int write(const SamplesBuffer &in);
+    unsigned int writeSilence(unsigned int frames);
+
+    // reader thread, copy up to 'frames' frames to 'out' starting at 'outOffset', return how many frames were copied
+    unsigned int read(SamplesBuffer &out, unsigned int frames, unsigned int outOffset = 0);
+
+    // reader thread, discard up to 'frames' frames without copying, return how many frames were skipped
+    unsigned int skip(unsigned int frames);
+
+    unsigned int getAvailableFrames() const;
+    unsigned int getFreeFrames() const;
+
+    inline unsigned int getCapacity() const
+    {
+        return capacity;
+    }
+
+    inline int getChannels() const
+    {
+        return samples.getChannels();
+    }
+
+    void clear();// not thread safe, use only when nobody is reading or writing
+
+private:
+    SamplesBuffer samples;
+    const unsigned int capacity;
+
+    // always incremented, the position in 'samples' is the counter modulo capacity
+    std::atomic<unsigned int> writtenFrames;
+    std::atomic<unsigned int> readedFrames;
+    std::atomic<unsigned int> audibleFramesEnd;// 'writtenFrames' after the last non silent write
+
+    SamplesRingBuffer(const SamplesRingBuffer &);
+    SamplesRingBuffer &operator=(const SamplesRingBuffer &);
+};
+}
+
+#endif // SAMPLES_RING_BUFFER_H
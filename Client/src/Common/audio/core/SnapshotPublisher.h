@@ -0,0 +1,97 @@
+#ifndef SNAPSHOT_PUBLISHER_H
+#define SNAPSHOT_PUBLISHER_H
+
+#include <atomic>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace Audio {
+/**
+ * Publishes immutable snapshots of a value (normally a list of nodes) to the audio thread.
+ *
+ * The audio thread only reads the current snapshot through a Reader and never blocks or
+ * allocates. Other threads change the value with modify(): the current snapshot is copied,
+ * changed and atomically swapped in. The old snapshot is deleted only after every reader that
+ * could still see it has finished, so when modify() returns it is safe to delete any object
+ * that was removed from the snapshot.
+ *
+ * modify() must never be called by a thread holding a Reader of the same publisher.
+ */
+template<typename T>
+class SnapshotPublisher
+{
+public:
+    SnapshotPublisher() :
+        current(new T()),
+        readers(0)
+    {
+    }
+
+    ~SnapshotPublisher()
+    {
+        delete current.load();
+    }
+
+    class Reader
+    {
+    public:
+        explicit Reader(const SnapshotPublisher<T> &publisher) :
+            publisher(publisher)
+        {
+            publisher.readers.fetch_add(1);
+            snapshot = publisher.current.load();
+        }
+
+        ~Reader()
+        {
+            publisher.readers.fetch_sub(1);
+        }
+
+        inline const T &operator*() const
+        {
+            return *snapshot;
+        }
+
+        inline const T *operator->() const
+        {
+            return snapshot;
+        }
+
+    private:
+        Reader(const Reader &other);
+        Reader &operator=(const Reader &other);
+
+        const SnapshotPublisher<T> &publisher;
+        const T *snapshot;
+    };
+
+    // used by the threads changing the value, the audio thread must use a Reader
+    inline const T &getCurrent() const
+    {
+        return *current.load();
+    }
+
+    template<typename Function>
+    void modify(Function change)
+    {
+        QMutexLocker locker(&writersMutex);
+        T *newSnapshot = new T(*current.load());
+        change(*newSnapshot);
+        T *oldSnapshot = current.exchange(newSnapshot);
+        while (readers.load() > 0)// wait the audio thread finish with the old snapshot
+            QThread::yieldCurrentThread();
+        delete oldSnapshot;
+    }
+
+private:
+    SnapshotPublisher(const SnapshotPublisher &other);
+    SnapshotPublisher &operator=(const SnapshotPublisher &other);
+
+    std::atomic<T *> current;
+    mutable std::atomic<int> readers;
+    QMutex writersMutex;
+};
+}
+
+#endif // SNAPSHOT_PUBLISHER_H
@@ -0,0 +1,73 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+
+namespace Audio {
+/**
+ * Bounded lock-free queue with exactly one producer thread and one consumer thread.
+ *
+ * All the memory is allocated in the constructor, so push() and pop() can be called from the
+ * audio thread. push() fails when the queue is full, it never blocks or grows.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(unsigned int capacity) :
+        items(capacity + 1),// one slot is always empty to distinguish full and empty queues
+        head(0),
+        tail(0)
+    {
+    }
+
+    bool push(const T &value)// producer thread
+    {
+        unsigned int currentTail = tail.load(std::memory_order_relaxed);
+        unsigned int nextTail = next(currentTail);
+        if (nextTail == head.load(std::memory_order_acquire))
+            return false;// full
+        items[currentTail] = value;
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)// consumer thread
+    {
+        if (!peek(value))
+            return false;
+        head.store(next(head.load(std::memory_order_relaxed)), std::memory_order_release);
+        return true;
+    }
+
+    bool peek(T &value) const// consumer thread, read the next value without removing it
+    {
+        unsigned int currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+            return false;// empty
+        value = items[currentHead];
+        return true;
+    }
+
+    inline bool isEmpty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> items;
+    std::atomic<unsigned int> head;// next item to pop, changed only by the consumer
+    std::atomic<unsigned int> tail;// next free slot, changed only by the producer
+
+    inline unsigned int next(unsigned int index) const
+    {
+        return (index + 1) % items.size();
+    }
+
+    SpscQueue(const SpscQueue &);
+    SpscQueue &operator=(const SpscQueue &);
+};
+}
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,128 @@
+#include "FlacFileSource.h"
+#include "log/Logging.h"
+#include <QFile>
+#include <algorithm>
+
+using namespace Audio;
+
+FlacFileSource::FlacFileSource() :
+    decoder(FLAC__stream_decoder_new()),
+    channels(0),
+    sampleRate(0),
+    bitsPerSample(0),
+    length(0),
+    block(2),
+    blockOffset(0)
+{
+}
+
+FlacFileSource::~FlacFileSource()
+{
+    FLAC__stream_decoder_delete(decoder);// finish the decoding and close the file
+}
+
+bool FlacFileSource::open(const QString &filePath)
+{
+    if (!decoder)
+        return false;
+
+    FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_file(
+        decoder, QFile::encodeName(filePath).constData(), writeCallback, metadataCallback,
+        errorCallback, this);
+    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+        return false;
+    if (!FLAC__stream_decoder_process_until_end_of_metadata(decoder))
+        return false;
+    return channels > 0 && sampleRate > 0;
+}
+
+int FlacFileSource::getChannels() const
+{
+    return channels;
+}
+
+int FlacFileSource::getSampleRate() const
+{
+    return sampleRate;
+}
+
+qint64 FlacFileSource::getLength() const
+{
+    return length;
+}
+
+int FlacFileSource::read(SamplesBuffer &out, int maxFrames)
+{
+    int frames = 0;
+    while (frames < maxFrames) {
+        if (blockOffset >= (int)block.getFrameLenght()) {
+            if (FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_END_OF_STREAM)
+                break;
+            block.setFrameLenght(0);
+            if (!FLAC__stream_decoder_process_single(decoder))
+                break;
+            blockOffset = 0;
+            continue;// metadata blocks are not decoded in 'block'
+        }
+        int framesToCopy = std::min(maxFrames - frames, (int)block.getFrameLenght() - blockOffset);
+        out.set(block, blockOffset, framesToCopy, frames);
+        blockOffset += framesToCopy;
+        frames += framesToCopy;
+    }
+    return frames;
+}
+
+bool FlacFileSource::seek(qint64 frame)
+{
+    // the block starting in 'frame' is decoded by the seek
+    block.setFrameLenght(0);
+    blockOffset = 0;
+    if (FLAC__stream_decoder_seek_absolute(decoder, frame))
+        return true;
+    if (FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_SEEK_ERROR)
+        FLAC__stream_decoder_flush(decoder);
+    return false;
+}
+
+FLAC__StreamDecoderWriteStatus FlacFileSource::writeCallback(const FLAC__StreamDecoder *,
+                                                             const FLAC__Frame *frame,
+                                                             const FLAC__int32 *const buffer[],
+                                                             void *source)
+{
+    FlacFileSource *flac = static_cast<FlacFileSource *>(source);
+    const int frames = frame->header.blocksize;
+    const int bits = frame->header.bits_per_sample ? frame->header.bits_per_sample : flac->bitsPerSample;
+    const float scale = 1.0f / (1 << (bits - 1));
+    flac->block.setFrameLenght(frames);
+    for (int c = 0; c < flac->channels; ++c) {
+        float *samples = flac->block.getSamplesArray(c);
+        const FLAC__int32 *input = buffer[std::min(c, (int)frame->header.channels - 1)];
+        for (int s = 0; s < frames; ++s)
+            samples[s] = input[s] * scale;
+    }
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FlacFileSource::metadataCallback(const FLAC__StreamDecoder *,
+                                      const FLAC__StreamMetadata *metadata, void *source)
+{
+    if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO)
+        return;
+
+    FlacFileSource *flac = static_cast<FlacFileSource *>(source);
+    const FLAC__StreamMetadata_StreamInfo &info = metadata->data.stream_info;
+    flac->channels = std::min((int)info.channels, 2);
+    flac->sampleRate = info.sample_rate;
+    flac->bitsPerSample = info.bits_per_sample;
+    flac->length = info.total_samples;// 0 when unknown
+    if (flac->channels == 1)
+        flac->block.setToMono();
+    flac->block.setFrameLenght(info.max_blocksize);// allocated only here
+    flac->block.setFrameLenght(0);
+}
+
+void FlacFileSource::errorCallback(const FLAC__StreamDecoder *,
+                                   FLAC__StreamDecoderErrorStatus status, void *)
+{
+    qCWarning(jtAudio) << "FLAC decoding error:" << FLAC__StreamDecoderErrorStatusString[status];
+}
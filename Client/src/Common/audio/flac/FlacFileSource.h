@@ -0,0 +1,48 @@
+#ifndef FLAC_FILE_SOURCE_H
+#define FLAC_FILE_SOURCE_H
+
+#include "audio/AudioFileSource.h"
+#include "audio/core/SamplesBuffer.h"
+#include <FLAC/stream_decoder.h>
+
+namespace Audio {
+/**
+ * FLAC files decoded with libFLAC, one FLAC frame (block) per decoding step. Only the first 2
+ * channels are decoded. The seeking is sample accurate.
+ */
+class FlacFileSource : public AudioFileSource
+{
+public:
+    FlacFileSource();
+    ~FlacFileSource();
+
+    bool open(const QString &filePath);
+
+    int getChannels() const;
+    int getSampleRate() const;
+    qint64 getLength() const;
+    int read(SamplesBuffer &out, int maxFrames);
+    bool seek(qint64 frame);
+
+private:
+    FLAC__StreamDecoder *decoder;
+    int channels;
+    int sampleRate;
+    int bitsPerSample;
+    qint64 length;
+
+    SamplesBuffer block;// the last decoded block
+    int blockOffset;// frames already readed from 'block'
+
+    static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder *decoder,
+                                                        const FLAC__Frame *frame,
+                                                        const FLAC__int32 *const buffer[],
+                                                        void *source);
+    static void metadataCallback(const FLAC__StreamDecoder *decoder,
+                                 const FLAC__StreamMetadata *metadata, void *source);
+    static void errorCallback(const FLAC__StreamDecoder *decoder,
+                              FLAC__StreamDecoderErrorStatus status, void *source);
+};
+}
+
+#endif // FLAC_FILE_SOURCE_H
@@ -0,0 +1,80 @@
+#include "FlacFileWriter.h"
+#include "audio/core/SamplesBuffer.h"
+#include "log/Logging.h"
+#include <QFile>
+
+using namespace Audio;
+
+FlacFileWriter::FlacFileWriter(int channels, int sampleRate, int bitsPerSample) :
+    encoder(FLAC__stream_encoder_new()),
+    channels(channels),
+    sampleRate(sampleRate),
+    bitsPerSample(bitsPerSample == 24 ? 24 : 16),
+    writtenFrames(0),
+    opened(false)
+{
+}
+
+FlacFileWriter::~FlacFileWriter()
+{
+    close();
+    FLAC__stream_encoder_delete(encoder);
+}
+
+bool FlacFileWriter::open(const QString &filePath)
+{
+    if (!encoder)
+        return false;
+
+    FLAC__stream_encoder_set_channels(encoder, channels);
+    FLAC__stream_encoder_set_bits_per_sample(encoder, bitsPerSample);
+    FLAC__stream_encoder_set_sample_rate(encoder, sampleRate);
+    FLAC__stream_encoder_set_compression_level(encoder, 5);
+    FLAC__StreamEncoderInitStatus status = FLAC__stream_encoder_init_file(
+        encoder, QFile::encodeName(filePath).constData(), nullptr, nullptr);
+    opened = status == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+    return opened;
+}
+
+bool FlacFileWriter::write(const SamplesBuffer &samples)
+{
+    if (!opened)
+        return false;
+
+    const int frames = samples.getFrameLenght();
+    planar.resize(frames * channels);
+    const FLAC__int32 *channelSamples[FLAC__MAX_CHANNELS];
+    for (int c = 0; c < channels; ++c) {
+        const float *in = samples.getReadOnlySamplesArray(qMin(c, (int)samples.getChannels() - 1));
+        FLAC__int32 *out = planar.data() + c * frames;
+        convert(in, reinterpret_cast<int *>(out), frames, bitsPerSample);
+        channelSamples[c] = out;
+    }
+    if (!FLAC__stream_encoder_process(encoder, channelSamples, frames)) {
+        qCWarning(jtAudio) << "FLAC encoding error:"
+                           << FLAC__stream_encoder_get_resolved_state_string(encoder);
+        return false;
+    }
+    writtenFrames += frames;
+    return true;
+}
+
+bool FlacFileWriter::flush()
+{
+    // the stream info is updated only when the encoding finish, the decoders read the frames
+    // without the total length
+    return opened;
+}
+
+bool FlacFileWriter::close()
+{
+    if (!opened)
+        return true;
+    opened = false;
+    return FLAC__stream_encoder_finish(encoder);
+}
+
+qint64 FlacFileWriter::getWrittenFrames() const
+{
+    return writtenFrames;
+}
@@ -0,0 +1,37 @@
+#ifndef FLAC_FILE_WRITER_H
+#define FLAC_FILE_WRITER_H
+
+#include "audio/AudioFileWriter.h"
+#include <FLAC/stream_encoder.h>
+#include <vector>
+
+namespace Audio {
+/**
+ * FLAC files encoded with libFLAC (16 or 24 bits). The stream info (total samples, MD5) is
+ * written by libFLAC when the file is closed.
+ */
+class FlacFileWriter : public AudioFileWriter
+{
+public:
+    FlacFileWriter(int channels, int sampleRate, int bitsPerSample);
+    ~FlacFileWriter();
+
+    bool open(const QString &filePath);
+
+    bool write(const SamplesBuffer &samples);
+    bool flush();
+    bool close();
+    qint64 getWrittenFrames() const;
+
+private:
+    FLAC__StreamEncoder *encoder;
+    const int channels;
+    const int sampleRate;
+    const int bitsPerSample;
+    qint64 writtenFrames;
+    bool opened;
+    std::vector<FLAC__int32> planar;// the channels are not interleaved
+};
+}
+
+#endif // FLAC_FILE_WRITER_H
@@ -0,0 +1,217 @@
+#include "OpusIntervalDecoder.h"
+#include "log/Logging.h"
+#include "audio/core/RtViolationDetector.h"
+#include <algorithm>
+#include <cstring>
+
+OpusIntervalDecoder::OpusIntervalDecoder() :
+    streamInitialized(false),
+    decoder(nullptr),
+    decoderChannels(0),
+    channels(0),
+    preSkip(0),
+    headerPackets(0),
+    endOfStream(false),
+    packetsFrames(0),
+    packetSamples(MAX_FRAME_SIZE * 2),
+    packetSamplesOffset(0),
+    packetSamplesEnd(0),
+    internalBuffer(2, MAX_FRAMES_PER_DECODE),
+    decodedSamples(0),
+    inputComplete(false)
+{
+    ogg_sync_init(&syncState);
+}
+
+OpusIntervalDecoder::~OpusIntervalDecoder()
+{
+    if (decoder)
+        opus_decoder_destroy(decoder);
+    if (streamInitialized)
+        ogg_stream_clear(&streamState);
+    ogg_sync_clear(&syncState);
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+void OpusIntervalDecoder::addInput(const QByteArray &encodedData, bool isLastPart)
+{
+    Audio::RtCheckedMutexLocker locker(&inputMutex);
+    pendingInput.append(encodedData.constData(), encodedData.size());// copied, can be a view of the received bytes
+    if (isLastPart)
+        inputComplete = true;
+}
+
+bool OpusIntervalDecoder::isInputComplete() const
+{
+    Audio::RtCheckedMutexLocker locker(&inputMutex);
+    return inputComplete;
+}
+
+void OpusIntervalDecoder::restart()
+{
+    {
+        Audio::RtCheckedMutexLocker locker(&inputMutex);
+        pendingInput.clear();
+        inputComplete = false;
+    }
+    ogg_sync_reset(&syncState);
+    if (streamInitialized) {
+        ogg_stream_clear(&streamState);
+        streamInitialized = false;// the next interval has other serial number
+    }
+    headerPackets = 0;
+    endOfStream = false;
+    packetsFrames = 0;
+    packetSamplesOffset = 0;
+    packetSamplesEnd = 0;
+    decodedSamples = 0;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+const Audio::SamplesBuffer &OpusIntervalDecoder::decode(int maxSamplesToDecode)
+{
+    int maxFrames = std::min(maxSamplesToDecode, (int)MAX_FRAMES_PER_DECODE);
+    internalBuffer.setFrameLenght(maxFrames);
+    int frames = 0;
+    while (frames < maxFrames) {
+        if (packetSamplesOffset < packetSamplesEnd) {
+            // internal buffer is always stereo
+            int framesToCopy = std::min(maxFrames - frames, packetSamplesEnd - packetSamplesOffset);
+            float *left = internalBuffer.getSamplesArray(0) + frames;
+            float *right = internalBuffer.getSamplesArray(1) + frames;
+            const float *samples = packetSamples.data() + packetSamplesOffset * channels;
+            const int rightChannel = channels >= 2 ? 1 : 0;
+            for (int s = 0; s < framesToCopy; ++s) {
+                left[s] = samples[s * channels];
+                right[s] = samples[s * channels + rightChannel];
+            }
+            packetSamplesOffset += framesToCopy;
+            frames += framesToCopy;
+            continue;
+        }
+
+        ogg_packet packet;
+        if (endOfStream || !readPacket(packet))
+            break;// waiting for more input, or the interval is finished
+
+        if (headerPackets < 2)
+            readHeader(packet);
+        else if (decoder)
+            decodePacket(packet);
+    }
+    internalBuffer.setFrameLenght(frames);
+    decodedSamples += frames;
+    return internalBuffer;
+}
+
+bool OpusIntervalDecoder::readPacket(ogg_packet &packet)
+{
+    while (true) {
+        if (streamInitialized) {
+            int result = ogg_stream_packetout(&streamState, &packet);
+            if (result == 1)
+                return true;
+            if (result < 0) {
+                qCWarning(jtNinjamOpus) << "opus decoder: missing data in the ogg stream";
+                continue;
+            }
+        }
+
+        ogg_page page;
+        if (ogg_sync_pageout(&syncState, &page) == 1) {
+            if (!streamInitialized) {
+                ogg_stream_init(&streamState, ogg_page_serialno(&page));
+                streamInitialized = true;
+            }
+            ogg_stream_pagein(&streamState, &page);
+            continue;
+        }
+
+        QByteArray input;
+        {
+            Audio::RtCheckedMutexLocker locker(&inputMutex);
+            input.swap(pendingInput);
+        }
+        if (input.isEmpty())
+            return false;
+        char *buffer = ogg_sync_buffer(&syncState, input.size());
+        std::memcpy(buffer, input.constData(), input.size());
+        ogg_sync_wrote(&syncState, input.size());
+    }
+}
+
+/*
+ OpusHead packet:
+ Offset Type        Field
+ 0x0    uint8_t[8]  "OpusHead"
+ 0x8    uint8_t     Version
+ 0x9    uint8_t     Channels
+ 0xa    uint16_t    Pre-skip (little endian)
+ 0xc    uint32_t    Input sample rate
+ 0x10   int16_t     Output gain
+ 0x12   uint8_t     Channel mapping family
+ */
+void OpusIntervalDecoder::readHeader(const ogg_packet &packet)
+{
+    const char *data = (const char *)packet.packet;
+    if (headerPackets == 0) {
+        if (packet.bytes < 19 || std::memcmp(data, "OpusHead", 8) != 0) {
+            qCWarning(jtNinjamOpus) << "opus decoder: invalid OpusHead packet";
+            endOfStream = true;
+            return;
+        }
+        channels = (quint8)data[9];
+        preSkip = (quint8)data[10] | ((quint8)data[11] << 8);
+        if (channels < 1 || channels > 2 || data[18] != 0) {
+            qCWarning(jtNinjamOpus) << "opus decoder: unsupported channel mapping," << channels << "channels";
+            endOfStream = true;
+            return;
+        }
+
+        if (decoder && decoderChannels == channels) {
+            opus_decoder_ctl(decoder, OPUS_RESET_STATE);// restarted decoder, same channels
+        } else {
+            if (decoder)
+                opus_decoder_destroy(decoder);
+
+            int error = OPUS_OK;
+            decoder = opus_decoder_create(OPUS_SAMPLE_RATE, channels, &error);
+            if (error != OPUS_OK) {
+                qCWarning(jtNinjamOpus) << "opus decoder initialization error:" << opus_strerror(error);
+                decoder = nullptr;
+                endOfStream = true;
+                return;
+            }
+            decoderChannels = channels;
+        }
+    }
+    headerPackets++;// the comments (OpusTags) are not used by the decoder
+}
+
+void OpusIntervalDecoder::decodePacket(const ogg_packet &packet)
+{
+    int frames = opus_decode_float(decoder, packet.packet, packet.bytes, packetSamples.data(),
+                                   MAX_FRAME_SIZE, 0);
+    if (frames < 0) {
+        qCWarning(jtNinjamOpus) << "opus decoding error:" << opus_strerror(frames);
+        return;
+    }
+
+    ogg_int64_t packetStart = packetsFrames;
+    packetsFrames += frames;
+
+    int first = 0;
+    if (packetStart < preSkip)
+        first = (int)std::min<ogg_int64_t>(frames, preSkip - packetStart);
+
+    int end = frames;
+    if (packet.e_o_s) {
+        endOfStream = true;
+        if (packet.granulepos >= 0 && packet.granulepos < packetsFrames)// discard the padding
+            end = std::max(first, frames - (int)(packetsFrames - packet.granulepos));
+    }
+    packetSamplesOffset = first;
+    packetSamplesEnd = end;
+}
@@ -0,0 +1,78 @@
+#ifndef OPUS_INTERVAL_DECODER_H
+#define OPUS_INTERVAL_DECODER_H
+
+#include "audio/IntervalCodec.h"
+#include "audio/core/SamplesBuffer.h"
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+#include <QByteArray>
+#include <QMutex>
+#include <vector>
+
+/**
+ * Decode the Ogg Opus intervals (RFC 7845) while they are downloading.
+ *
+ * The decoded samples are always in 48 KHz, the pre-skip and the padding in the end of the
+ * interval are discarded.
+ *
+ * The decoder can be reused in the next intervals (restart()), the opus decoder state is
+ * reset instead of allocated again.
+ */
+class OpusIntervalDecoder : public Audio::IntervalDecoder
+{
+public:
+    OpusIntervalDecoder();
+    ~OpusIntervalDecoder();
+
+    // streaming input, can be called by other thread while decoding
+    void addInput(const QByteArray &encodedData, bool isLastPart);
+    bool isInputComplete() const;
+
+    const Audio::SamplesBuffer &decode(int maxSamplesToDecode);
+
+    void restart();// the opus decoder is reused when the next interval has the same channels
+
+    inline int getSampleRate() const
+    {
+        return OPUS_SAMPLE_RATE;
+    }
+
+    inline int getTotalDecodedSamples() const
+    {
+        return decodedSamples;
+    }
+
+private:
+    static const int OPUS_SAMPLE_RATE = 48000;
+    static const int MAX_FRAME_SIZE = 5760;// 120 ms, the largest opus packet
+    static const int MAX_FRAMES_PER_DECODE = 4096;
+
+    ogg_sync_state syncState;
+    ogg_stream_state streamState;
+    bool streamInitialized;
+
+    OpusDecoder *decoder;
+    int decoderChannels;// the channels used to create the decoder
+    int channels;
+    int preSkip;
+    int headerPackets;// OpusHead and OpusTags
+    bool endOfStream;
+    ogg_int64_t packetsFrames;// decoded frames in all packets, including the pre-skip
+
+    std::vector<float> packetSamples;// interleaved samples of the last decoded packet
+    int packetSamplesOffset;// first frame not returned yet
+    int packetSamplesEnd;
+
+    Audio::SamplesBuffer internalBuffer;
+    int decodedSamples;
+
+    QByteArray pendingInput;// downloaded bytes not passed to the ogg parser yet
+    bool inputComplete;
+    mutable QMutex inputMutex;
+
+    bool readPacket(ogg_packet &packet);
+    void readHeader(const ogg_packet &packet);
+    void decodePacket(const ogg_packet &packet);
+};
+
+#endif // OPUS_INTERVAL_DECODER_H
@@ -0,0 +1,216 @@
+#include "OpusIntervalEncoder.h"
+#include "log/Logging.h"
+#include <algorithm>
+
+OpusIntervalEncoder::OpusIntervalEncoder(int channels, int sampleRate, int bitrate) :
+    channels(channels),
+    sampleRate(sampleRate),
+    bitrate(bitrate > 0 ? bitrate : DEFAULT_BITRATE_PER_CHANNEL * channels),
+    encoder(nullptr),
+    preSkip(0),
+    resampler(SamplesBufferResampler::LOW_LATENCY),
+    pendingSamples(channels, FRAME_SIZE),
+    interleavedFrame(FRAME_SIZE * channels),
+    packetData(MAX_PACKET_SIZE),
+    streaming(false),
+    packetNumber(0),
+    decodedFrames(0),
+    validFrames(0)
+{
+    int error = OPUS_OK;
+    encoder = opus_encoder_create(OPUS_SAMPLE_RATE, channels, OPUS_APPLICATION_RESTRICTED_LOWDELAY,
+                                  &error);
+    if (error != OPUS_OK) {
+        qCCritical(jtNinjamOpus) << "opus encoder initialization error:" << opus_strerror(error);
+        encoder = nullptr;
+        return;
+    }
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(this->bitrate));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
+
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    preSkip = lookahead;
+
+    if (sampleRate != OPUS_SAMPLE_RATE)
+        resampler.setSampleRates(sampleRate, OPUS_SAMPLE_RATE);
+    pendingSamples.setFrameLenght(0);
+}
+
+OpusIntervalEncoder::~OpusIntervalEncoder()
+{
+    if (streaming)
+        ogg_stream_clear(&streamState);
+    if (encoder)
+        opus_encoder_destroy(encoder);
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+QByteArray OpusIntervalEncoder::encode(const Audio::SamplesBuffer &samples)
+{
+    outBuffer.clear();
+    if (!encoder)
+        return outBuffer;
+
+    if (!streaming)
+        startStream();
+
+    if (samples.getFrameLenght() > 0) {
+        if (sampleRate == OPUS_SAMPLE_RATE) {
+            encodeSamples(samples);
+        } else {
+            int outFrames = (qint64)samples.getFrameLenght() * OPUS_SAMPLE_RATE / sampleRate + 1;
+            encodeSamples(resampler.resample(samples, outFrames));
+        }
+    }
+    writePages();// a page for each call, the encoded audio is uploaded without waiting for full pages
+    return outBuffer;
+}
+
+QByteArray OpusIntervalEncoder::finishIntervalEncoding()
+{
+    outBuffer.clear();
+    if (!encoder)
+        return outBuffer;
+
+    if (!streaming)
+        startStream();// an empty interval is a valid stream with one silent packet
+
+    if (sampleRate != OPUS_SAMPLE_RATE) {// flush the samples read ahead by the resampler
+        Audio::SamplesBuffer tail(channels, resampler.getLatency());
+        int outFrames = resampler.getLatency() * 2 + 2;// all the remaining output frames
+        encodeSamples(resampler.resample(tail, outFrames));
+    }
+
+    // the last frame is padded with zeros, and silent frames are encoded until the samples in
+    // the encoder lookahead are flushed. The decoders discard the padding using the granule position.
+    validFrames += pendingSamples.getFrameLenght();
+    do {
+        pendingSamples.setFrameLenght(FRAME_SIZE);
+        encodeFrame(decodedFrames + FRAME_SIZE >= preSkip + validFrames);
+        pendingSamples.setFrameLenght(0);
+    } while (decodedFrames < preSkip + validFrames);
+
+    writePages();
+    ogg_stream_clear(&streamState);
+    streaming = false;
+    return outBuffer;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+void OpusIntervalEncoder::startStream()
+{
+    ogg_stream_init(&streamState, Audio::IntervalCodecs::newStreamSerialNumber());
+    opus_encoder_ctl(encoder, OPUS_RESET_STATE);// each interval is decoded by a new decoder
+    resampler.reset();
+    pendingSamples.setFrameLenght(0);
+    packetNumber = 0;
+    decodedFrames = 0;
+    validFrames = 0;
+    streaming = true;
+
+    writeHeaders();
+}
+
+void OpusIntervalEncoder::appendLittleEndian(QByteArray &data, quint32 value, int bytes)
+{
+    for (int b = 0; b < bytes; ++b)
+        data.append((char)((value >> (8 * b)) & 0xFF));
+}
+
+void OpusIntervalEncoder::appendComment(QByteArray &data, const QByteArray &comment)
+{
+    appendLittleEndian(data, comment.size(), 4);
+    data.append(comment);
+}
+
+void OpusIntervalEncoder::writeHeaders()
+{
+    QByteArray head("OpusHead");
+    head.append((char)1);// version
+    head.append((char)channels);
+    appendLittleEndian(head, preSkip, 2);
+    appendLittleEndian(head, sampleRate, 4);// the original sample rate, informative only
+    appendLittleEndian(head, 0, 2);// output gain
+    head.append((char)0);// channel mapping family, mono or stereo
+
+    QByteArray tags("OpusTags");
+    appendComment(tags, QByteArray(opus_get_version_string()));// vendor
+    appendLittleEndian(tags, 2, 4);// comments
+    appendComment(tags, "Encoder=Jamtaba");
+    appendComment(tags, QByteArray(Audio::IntervalCodecs::DECODERS_TAG) + "="
+                  + Audio::IntervalCodecs::getSupportedDecoders());// must be the last comment
+
+    ogg_packet packet;
+    packet.packet = (unsigned char *)head.data();
+    packet.bytes = head.size();
+    packet.b_o_s = 1;
+    packet.e_o_s = 0;
+    packet.granulepos = 0;
+    packet.packetno = packetNumber++;
+    ogg_stream_packetin(&streamState, &packet);
+    writePages();// the identification header is alone in the first page
+
+    packet.packet = (unsigned char *)tags.data();
+    packet.bytes = tags.size();
+    packet.b_o_s = 0;
+    packet.packetno = packetNumber++;
+    ogg_stream_packetin(&streamState, &packet);
+    writePages();// the audio data starts in a new page
+}
+
+void OpusIntervalEncoder::encodeSamples(const Audio::SamplesBuffer &samples)
+{
+    const int totalFrames = samples.getFrameLenght();
+    int offset = 0;
+    while (offset < totalFrames) {
+        int pending = pendingSamples.getFrameLenght();
+        int frames = std::min(FRAME_SIZE - pending, totalFrames - offset);
+        pendingSamples.setFrameLenght(pending + frames);
+        pendingSamples.set(samples, offset, frames, pending);
+        offset += frames;
+        if (pendingSamples.getFrameLenght() == FRAME_SIZE) {
+            validFrames += FRAME_SIZE;
+            encodeFrame(false);
+            pendingSamples.setFrameLenght(0);
+        }
+    }
+}
+
+void OpusIntervalEncoder::encodeFrame(bool endOfStream)
+{
+    for (int c = 0; c < channels; ++c) {
+        const float *channelSamples = pendingSamples.getReadOnlySamplesArray(c);
+        for (int s = 0; s < FRAME_SIZE; ++s)
+            interleavedFrame[s * channels + c] = channelSamples[s];
+    }
+
+    opus_int32 bytes = opus_encode_float(encoder, interleavedFrame.data(), FRAME_SIZE,
+                                         packetData.data(), MAX_PACKET_SIZE);
+    if (bytes < 0) {
+        qCWarning(jtNinjamOpus) << "opus encoding error:" << opus_strerror(bytes);
+        bytes = 0;// an empty packet is decoded as a lost frame, the stream timing is preserved
+    }
+    decodedFrames += FRAME_SIZE;
+
+    ogg_packet packet;
+    packet.packet = packetData.data();
+    packet.bytes = bytes;
+    packet.b_o_s = 0;
+    packet.e_o_s = endOfStream ? 1 : 0;
+    // the end trimming is signaled by a granule position smaller than the decoded frames
+    packet.granulepos = endOfStream ? preSkip + validFrames : decodedFrames;
+    packet.packetno = packetNumber++;
+    ogg_stream_packetin(&streamState, &packet);
+}
+
+void OpusIntervalEncoder::writePages()
+{
+    ogg_page page;
+    while (ogg_stream_flush(&streamState, &page) != 0) {
+        outBuffer.append((const char *)page.header, page.header_len);
+        outBuffer.append((const char *)page.body, page.body_len);
+    }
+}
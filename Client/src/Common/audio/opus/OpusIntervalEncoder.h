@@ -0,0 +1,85 @@
+#ifndef OPUS_INTERVAL_ENCODER_H
+#define OPUS_INTERVAL_ENCODER_H
+
+#include "audio/IntervalCodec.h"
+#include "audio/SamplesBufferResampler.h"
+#include "audio/core/SamplesBuffer.h"
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+#include <QByteArray>
+#include <vector>
+
+/**
+ * Encode the intervals as Ogg Opus streams (RFC 7845).
+ *
+ * Opus works in 48 KHz, the samples in other sample rates are resampled before the encoding.
+ * The restricted low delay mode is used: 2.5 ms of lookahead and 10 ms frames, the first
+ * packets of each interval are available to upload almost immediately.
+ */
+class OpusIntervalEncoder : public Audio::IntervalEncoder
+{
+public:
+    static const int DEFAULT_BITRATE_PER_CHANNEL = 48000;// bits per second
+
+    OpusIntervalEncoder(int channels, int sampleRate, int bitrate = 0);// zero to use the default bitrate
+    ~OpusIntervalEncoder();
+
+    QByteArray encode(const Audio::SamplesBuffer &samples);
+    QByteArray finishIntervalEncoding();
+
+    inline int getChannels() const
+    {
+        return channels;
+    }
+
+    inline int getSampleRate() const
+    {
+        return sampleRate;
+    }
+
+    inline Audio::IntervalCodec getCodec() const
+    {
+        return Audio::IntervalCodec::OPUS;
+    }
+
+    inline int getBitrate() const
+    {
+        return bitrate;
+    }
+
+private:
+    static const int OPUS_SAMPLE_RATE = 48000;
+    static const int FRAME_SIZE = 480;// 10 ms
+    static const int MAX_PACKET_SIZE = 1500;
+
+    const int channels;
+    const int sampleRate;
+    int bitrate;
+
+    OpusEncoder *encoder;
+    int preSkip;// encoder lookahead, discarded by the decoders
+
+    SamplesBufferResampler resampler;
+    Audio::SamplesBuffer pendingSamples;// less than one frame, waiting for more samples
+    std::vector<float> interleavedFrame;
+    std::vector<unsigned char> packetData;
+
+    ogg_stream_state streamState;
+    bool streaming;// the headers of the current interval were written
+    ogg_int64_t packetNumber;
+    ogg_int64_t decodedFrames;// 48 KHz frames produced by the decoders, including the pre-skip
+    ogg_int64_t validFrames;// 48 KHz input frames encoded in the current interval
+
+    QByteArray outBuffer;
+
+    void startStream();
+    void writeHeaders();
+    void encodeSamples(const Audio::SamplesBuffer &samples);// 48 KHz samples
+    void encodeFrame(bool endOfStream);
+    void writePages();
+
+    static void appendLittleEndian(QByteArray &data, quint32 value, int bytes);
+    static void appendComment(QByteArray &data, const QByteArray &comment);
+};
+
+#endif // OPUS_INTERVAL_ENCODER_H
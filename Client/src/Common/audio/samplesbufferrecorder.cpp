@@ -1,71 +1,125 @@
 #include "SamplesBufferRecorder.h"
-
-#include <QDataStream>
+#include "AudioFileWriter.h"
 #include "core/SamplesBuffer.h"
-#include <QByteArray>
-#include <QFile>
-#include <QDir>
-#include <QDebug>
-
-SamplesBufferRecorder::SamplesBufferRecorder(QString fileName, quint32 sampleRate)
-    :fileName(fileName), sampleRate(sampleRate){
-    char header[44];
-    array.append(header, 44);//create empty space in first 44 bytes to write header in desctructor
-}
+#include "log/Logging.h"
 
-SamplesBufferRecorder::~SamplesBufferRecorder(){
-    writeSamplesToFile();
-}
+#include <QElapsedTimer>
+#include <QThread>
 
-void SamplesBufferRecorder::addSamples(const Audio::SamplesBuffer &buffer){
-    QDataStream stream(&array, QIODevice::WriteOnly);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    stream.skipRawData(array.size());
-    if(buffer.getChannels() < 2){
-        qCritical() << "buffer is mono!";
-        return;
+using namespace Audio;
+
+class SamplesBufferRecorderThread : public QThread
+{
+public:
+    explicit SamplesBufferRecorderThread(SamplesBufferRecorder *recorder) :
+        recorder(recorder)
+    {
+        start(QThread::LowPriority);
     }
-    for (int s = 0; s < buffer.getFrameLenght(); ++s) {
-        for (int c = 0; c < buffer.getChannels(); ++c) {
-            quint16 sampleVale = (quint16)(buffer.get(c, s) * 32767);
-            stream << sampleVale;
-        }
+
+protected:
+    void run()
+    {
+        recorder->diskLoop();
+    }
+
+private:
+    SamplesBufferRecorder *recorder;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+SamplesBufferRecorder::SamplesBufferRecorder(const QString &filePath, int sampleRate,
+                                             int channels, int bitsPerSample, bool dither) :
+    filePath(filePath),
+    writer(AudioFileWriter::create(filePath, channels, sampleRate, bitsPerSample)),
+    ringBuffer(channels, sampleRate * RING_BUFFER_SECONDS),
+    diskThreadWaiting(false),
+    stopRequested(false),
+    droppedFrames(0),
+    writtenFrames(0)
+{
+    if (writer) {
+        writer->setDither(dither);
+        diskThread.reset(new SamplesBufferRecorderThread(this));
     }
 }
 
-void SamplesBufferRecorder::writeWavHeader(){
-    quint32 frameLenght = (quint32)(array.size() - 44);
-    quint32 chunckSize = (quint32)16;
-    quint16 audioFormat = (quint16)1;//PCM
-    quint16 channels = (quint16)2;
-    quint32 bytesPerSecond = (quint32)(sampleRate * 2);
-    quint16 bytesPerSample = (quint16)2;
-    quint16 bitDepth = (quint16)16;
-
-    QDataStream stream(&array, QIODevice::WriteOnly);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    stream.writeRawData("RIFF", 4);                                 // 00 - RIFF
-    stream << frameLenght;      // 04 - how big is the rest of this file?
-    stream.writeRawData("WAVE", 4);                                 // 08 - WAVE
-    stream.writeRawData("fmt ", 4);                                 // 12 - fmt
-    stream << chunckSize;  // 16 - size of this chunk
-    stream << audioFormat;     // 20 - what is the audio format? 1 for PCM = Pulse Code Modulation
-    stream << channels;   // 22 - mono or stereo? 1 or 2?  (or 5 or ???)
-    stream << sampleRate;     // 24 - samples per second (numbers per second)
-    stream << bytesPerSecond;       // 28 - bytes per second
-    stream << bytesPerSample; // 32 - # of bytes in one sample, for all channels
-    stream << bitDepth;  // 34 - how many bits in a sample(number)?  usually 16 or 24
-    stream.writeRawData("data", 4);                                 // 36 - data
-    stream << frameLenght;       // 40 - how big is this data chunk
+SamplesBufferRecorder::~SamplesBufferRecorder()
+{
+    if (diskThread) {
+        stopRequested.store(true);
+        if (diskThreadWaiting.exchange(false))
+            samplesAvailable.release();
+        diskThread->wait();
+    }
+    delete writer;
 }
 
-void SamplesBufferRecorder::writeSamplesToFile(){
+void SamplesBufferRecorder::addSamples(const SamplesBuffer &buffer)
+{
+    if (!writer)
+        return;
 
-    writeWavHeader();
-    QFile file(fileName);
-    file.open(QIODevice::WriteOnly);
-    file.write(array.data(), array.size());
-    file.close();
+    unsigned int frames = buffer.getFrameLenght();
+    unsigned int written = ringBuffer.write(buffer);
+    if (written < frames)
+        droppedFrames.fetch_add(frames - written, std::memory_order_relaxed);
 
+    // the disk thread is waked only when a block is available, not in every audio callback
+    if (ringBuffer.getAvailableFrames() >= (unsigned int)DISK_BLOCK_FRAMES
+        && diskThreadWaiting.exchange(false))
+        samplesAvailable.release();
+}
+
+// ++++++++++++++ disk thread +++++++++++++++
+
+void SamplesBufferRecorder::diskLoop()
+{
+    SamplesBuffer block(ringBuffer.getChannels(), DISK_BLOCK_FRAMES);
+    QElapsedTimer lastHeaderUpdate;
+    lastHeaderUpdate.start();
+    bool failed = false;
+    forever {
+        diskThreadWaiting.store(true);
+        if (ringBuffer.getAvailableFrames() < (unsigned int)DISK_BLOCK_FRAMES
+            && !stopRequested.load()) {
+            samplesAvailable.acquire();
+        } else if (!diskThreadWaiting.exchange(false)) {
+            samplesAvailable.acquire();// released by the other thread, consume it
+        }
+
+        bool stopping = stopRequested.load();
+        if (!failed && !writeAvailableSamples(block)) {
+            qCCritical(jtAudio) << "Can't write the recorded samples in" << filePath;
+            failed = true;// the samples are just discarded
+        }
+        if (failed)
+            ringBuffer.skip(ringBuffer.getAvailableFrames());
+
+        if (lastHeaderUpdate.hasExpired(HEADER_UPDATE_PERIOD * 1000)) {
+            writer->flush();// the file length in the header
+            lastHeaderUpdate.restart();
+        }
+        if (stopping)
+            break;
+    }
+
+    writer->close();
+    qCDebug(jtAudio) << "Recorded" << writtenFrames.load() << "frames in" << filePath << ","
+                     << droppedFrames.load() << "frames dropped";
+}
+
+bool SamplesBufferRecorder::writeAvailableSamples(SamplesBuffer &block)
+{
+    unsigned int available = ringBuffer.getAvailableFrames();
+    while (available > 0) {
+        unsigned int frames = qMin(available, (unsigned int)DISK_BLOCK_FRAMES);
+        block.setFrameLenght(frames);
+        ringBuffer.read(block, frames);
+        if (!writer->write(block))
+            return false;
+        writtenFrames.fetch_add(frames, std::memory_order_relaxed);
+        available -= frames;
+    }
+    return true;
 }
@@ -1,126 +1,231 @@
 #include "VorbisDecoder.h"
-#include <stdexcept>
 #include <cstring>
 #include <QByteArray>
-#include <cmath>
 #include <QDebug>
-#include "audio/core/AudioDriver.h"
 #include "audio/core/SamplesBuffer.h"
-#include <vorbis/vorbisfile.h>
-#include <QThread>
 #include "log/Logging.h"
+#include "audio/core/RtViolationDetector.h"
 //+++++++++++++++++++++++++++++++++++++++++++
 VorbisDecoder::VorbisDecoder()
-    : internalBuffer(2, 4096),
+    : internalBuffer(2, MAX_FRAMES_PER_DECODE),
+      streamStarted(false),
+      streamFailed(false),
+      setupParsed(false),
       initialized(false),
-      vorbisInput()
+      parsedSetups(0),
+      vorbisInput(),
+      inputOffset(0),
+      keepConsumedInput(false),
+      inputComplete(false),
+      decodedSamples(0)
 {
-    outBuffer = new float*[2];
-    outBuffer[0] = new float[2048];
-    outBuffer[1] = new float[2048];
-
-    decodedSamples = 0;
+    ogg_sync_init(&syncState);
+    ogg_stream_init(&streamState, 0);//the serial number is changed in the first page
 }
 //+++++++++++++++++++++++++++++++++++++++++++
 VorbisDecoder::~VorbisDecoder(){
     qCDebug(jtNinjamVorbisDecoder) << "Destrutor Vorbis Decoder";
-    //TODO this destructor is crashing when a track is removed
-    //delete [] outBuffer[0];
-    //delete [] outBuffer[1];
-    //delete [] outBuffer;
-    //if(initialized){
-//        ov_clear(&vorbisFile);
-//    }
+    releaseSetup();
+    ogg_stream_clear(&streamState);
+    ogg_sync_clear(&syncState);
 }
 //+++++++++++++++++++++++++++++++++++++++++++
-size_t VorbisDecoder::consumeTo(void *oggOutBuffer, size_t bytesToConsume){
-    size_t len = qMin( bytesToConsume, (size_t)vorbisInput.size());
-    if(len > 0){
-        memcpy(oggOutBuffer, vorbisInput.data(), len);
-        vorbisInput.remove(0, (uint)len);
+bool VorbisDecoder::readPacket(ogg_packet &packet){
+    while(true){
+        if(streamStarted){
+            int result = ogg_stream_packetout(&streamState, &packet);
+            if(result == 1){
+                return true;
+            }
+            if(result < 0){
+                qCWarning(jtNinjamVorbisDecoder) << "VORBIS ERROR: there was an interruption in the data.";
+                continue;
+            }
+        }
+
+        ogg_page page;
+        if(ogg_sync_pageout(&syncState, &page) == 1){
+            if(ogg_page_bos(&page)){//first page of the interval, or a new chained stream
+                ogg_stream_reset_serialno(&streamState, ogg_page_serialno(&page));
+                streamStarted = true;
+                streamFailed = false;
+                initialized = false;
+                streamHeaders.clear();
+            }
+            if(streamStarted){
+                ogg_stream_pagein(&streamState, &page);
+            }
+            continue;
+        }
+
+        //the input is readed through a cursor, the streamed bytes are removed after parsed, so only
+        //the bytes downloaded and not decoded yet are kept in memory
+        int bytesToRead;
+        {
+            Audio::RtCheckedMutexLocker locker(&inputMutex);
+            if(!keepConsumedInput && inputOffset >= MIN_CONSUMED_BYTES_TO_REMOVE){
+                vorbisInput.remove(0, inputOffset);
+                inputOffset = 0;
+            }
+            bytesToRead = qMin(BYTES_PER_READ, vorbisInput.size() - inputOffset);
+            if(bytesToRead > 0){
+                char *buffer = ogg_sync_buffer(&syncState, bytesToRead);
+                std::memcpy(buffer, vorbisInput.constData() + inputOffset, bytesToRead);
+                inputOffset += bytesToRead;
+            }
+        }
+        if(bytesToRead <= 0){
+            return false;//waiting for more input, or the end of the interval
+        }
+        ogg_sync_wrote(&syncState, bytesToRead);
     }
-//    else{
-//        qCritical() << "len " << len;
-//    }
-    return len;
 }
+//+++++++++++++++++++++++++++++++++++++++++++
+const Audio::SamplesBuffer &VorbisDecoder::decode(int maxSamplesToDecode){
+    while(true){
+        if(initialized){
+            float **pcm;//pointers to libvorbis internal buffers
+            int samplesAvailable = vorbis_synthesis_pcmout(&dspState, &pcm);
+            if(samplesAvailable > 0){
+                int samplesDecoded = qMin(samplesAvailable, qMin(maxSamplesToDecode, (int)MAX_FRAMES_PER_DECODE));
+                internalBuffer.setFrameLenght(samplesDecoded);
+                //internal buffer is always stereo
+                internalBuffer.add(0, pcm[0], samplesDecoded);//the left channel is always copyed
+                internalBuffer.add(1, pcm[ (vorbisInfo.channels >= 2) ? 1 : 0 ], samplesDecoded);
+                vorbis_synthesis_read(&dspState, samplesDecoded);
+                decodedSamples += samplesDecoded;
+                return internalBuffer;
+            }
+        }
 
-//vorbisfile read callback
-size_t VorbisDecoder::readOgg(void *oggOutBuffer, size_t size, size_t nmemb, void *decoder){
-    VorbisDecoder* decoderInstance = reinterpret_cast<VorbisDecoder*>(decoder);
-    return decoderInstance->consumeTo(oggOutBuffer, size * nmemb);
+        ogg_packet packet;
+        if(!readPacket(packet)){
+            return Audio::SamplesBuffer::ZERO_BUFFER;
+        }
+        if(streamFailed){
+            continue;//skip the packets of an invalid stream
+        }
+        if(!initialized){
+            readHeader(packet);
+        }
+        else if(vorbis_synthesis(&block, &packet) == 0){
+            vorbis_synthesis_blockin(&dspState, &block);
+        }
+    }
 }
 //+++++++++++++++++++++++++++++++++++++++++++
-const Audio::SamplesBuffer &VorbisDecoder::decode(int maxSamplesToDecode){
-    if(!initialized){
-        initialize();
+void VorbisDecoder::readHeader(const ogg_packet &packet){
+    streamHeaders.append(QByteArray((const char *)packet.packet, packet.bytes));
+    if(streamHeaders.size() < HEADER_PACKETS){
+        return;
     }
-    if(!initialized){
-        return Audio::SamplesBuffer::ZERO_BUFFER;
+
+    if(setupParsed && streamHeaders == parsedHeaders){
+        vorbis_synthesis_restart(&dspState);//same codebooks, just discard the last stream state
+        initialized = true;
     }
-    //static float decoderOutBuffer[vorbisFile.vi->channels]
-    long samplesDecoded = ov_read_float(&vorbisFile, &outBuffer, maxSamplesToDecode, NULL);//currentSection is not used
-    if(samplesDecoded < 0){//error
-        QString message;
-        switch (samplesDecoded) {
-            case OV_HOLE: message = "VORBIS ERROR: there was an interruption in the data. (one of: garbage between pages, loss of sync followed by recapture, or a corrupt page)";
+    else{
+        initialized = parseHeaders();
+        streamFailed = !initialized;
+    }
+}
+//+++++++++++++++++++++++++++++++++++++++++++
+bool VorbisDecoder::parseHeaders(){
+    releaseSetup();
+    vorbis_info_init(&vorbisInfo);
+    vorbis_comment_init(&vorbisComment);
+    for (int p = 0; p < streamHeaders.size(); ++p) {
+        ogg_packet packet;
+        std::memset(&packet, 0, sizeof(packet));
+        packet.packet = (unsigned char *)streamHeaders.at(p).constData();
+        packet.bytes = streamHeaders.at(p).size();
+        packet.b_o_s = p == 0;
+        packet.packetno = p;
+        int result = vorbis_synthesis_headerin(&vorbisInfo, &vorbisComment, &packet);
+        if(result < 0){
+            QString message;
+            switch (result) {
+            case OV_ENOTVORBIS: message = "VORBIS DECODER INIT ERROR:  Bitstream does not contain any Vorbis data.";
                 break;
-            case OV_EBADLINK: message = "VORBIS ERROR: an invalid stream section was supplied to libvorbisfile, or the requested link is corrupt.";
+            case OV_EBADHEADER: message = "VORBIS DECODER INIT ERROR: Invalid Vorbis bitstream header.";
                 break;
-            case OV_EINVAL: message = "VORBIS ERROR: the initial file headers couldn't be read or are corrupt, or that the initial open call for vf failed.";
+            case OV_EFAULT: message = "VORBIS DECODER INIT ERROR: Internal logic fault; indicates a bug or heap/stack corruption.";
+            }
+            qCWarning(jtNinjamVorbisDecoder) << message;
+            vorbis_comment_clear(&vorbisComment);
+            vorbis_info_clear(&vorbisInfo);
+            return false;
         }
-        qCWarning(jtNinjamVorbisDecoder) << message;
-        return Audio::SamplesBuffer::ZERO_BUFFER;
     }
-    internalBuffer.setFrameLenght(samplesDecoded);
-    decodedSamples += samplesDecoded;
-    //internal buffer is always stereo
-    internalBuffer.add(0, outBuffer[0], samplesDecoded);//the left channel is always copyed
-    internalBuffer.add(1, outBuffer[ (vorbisFile.vi->channels >= 2) ? 1 : 0 ], samplesDecoded);
-    return internalBuffer;
+    vorbis_synthesis_init(&dspState, &vorbisInfo);
+    vorbis_block_init(&dspState, &block);
+    setupParsed = true;
+    parsedHeaders = streamHeaders;
+    parsedSetups++;
+    return true;
 }
 //+++++++++++++++++++++++++++++++++++++++++++
-void VorbisDecoder::reset(){
-    initialize();
+void VorbisDecoder::releaseSetup(){
+    if(setupParsed){
+        vorbis_block_clear(&block);
+        vorbis_dsp_clear(&dspState);
+        vorbis_comment_clear(&vorbisComment);
+        vorbis_info_clear(&vorbisInfo);
+        setupParsed = false;
+        parsedHeaders.clear();
+    }
+    initialized = false;
+}
+//+++++++++++++++++++++++++++++++++++++++++++
+void VorbisDecoder::restartStream(){
+    ogg_sync_reset(&syncState);
+    ogg_stream_reset(&streamState);
+    streamStarted = false;
+    streamFailed = false;
+    initialized = false;//the parsed setup is kept
+    streamHeaders.clear();
     decodedSamples = 0;
-    //qWarning() << "reset";
+}
+//+++++++++++++++++++++++++++++++++++++++++++
+void VorbisDecoder::reset(){
+    {
+        Audio::RtCheckedMutexLocker locker(&inputMutex);
+        inputOffset = 0;
+    }
+    restartStream();
+}
+//++++++++++++++++++++++++++++++++++++++++++++++
+void VorbisDecoder::restart(){
+    {
+        Audio::RtCheckedMutexLocker locker(&inputMutex);
+        vorbisInput.clear();
+        inputOffset = 0;
+        keepConsumedInput = false;
+        inputComplete = false;
+    }
+    restartStream();
 }
 //++++++++++++++++++++++++++++++++++++++++++++++
 void VorbisDecoder::setInput(QByteArray vorbisData){
-    vorbisInput.clear();
-    vorbisInput.append(vorbisData);
+    {
+        Audio::RtCheckedMutexLocker locker(&inputMutex);
+        vorbisInput = vorbisData;
+        inputOffset = 0;
+        keepConsumedInput = true;
+        inputComplete = true;
+    }
+    restartStream();
 }
 
-//+++++++++++++++++++++++++++++++++++++++++++
-bool VorbisDecoder::initialize(){
-    ov_callbacks callbacks;
-    callbacks.read_func = readOgg;
-    callbacks.seek_func = NULL;
-    callbacks.close_func = NULL;
-    callbacks.tell_func = NULL;
-
-    if(initialized){
-        ov_clear(&vorbisFile);
+void VorbisDecoder::addInput(const QByteArray &vorbisData, bool isLastPart){
+    Audio::RtCheckedMutexLocker locker(&inputMutex);
+    vorbisInput.append(vorbisData.constData(), vorbisData.size());//copied, can be a view of the received bytes
+    if(isLastPart){
+        inputComplete = true;
     }
+}
 
-    int result = ov_open_callbacks((void*)this, &vorbisFile, NULL, 0, callbacks );
-    
-	initialized = result == 0;
-
-    if(!initialized){
-        QString message;
-        switch (result) {
-        case OV_EREAD: message = "VORBIS DECODER INIT ERROR:  A read from media returned an error.";
-            break;
-        case OV_ENOTVORBIS: message = "VORBIS DECODER INIT ERROR:  Bitstream does not contain any Vorbis data.";
-            break;
-        case OV_EVERSION: message = "VORBIS DECODER INIT ERROR: Vorbis version mismatch";
-            break;
-        case OV_EBADHEADER: message = "VORBIS DECODER INIT ERROR: Invalid Vorbis bitstream header.";
-            break;
-        case OV_EFAULT: message = "VORBIS DECODER INIT ERROR: Internal logic fault; indicates a bug or heap/stack corruption.";
-        }
-        qCWarning(jtNinjamVorbisDecoder) << message;
-    }
-    return initialized;
+bool VorbisDecoder::isInputComplete() const{
+    Audio::RtCheckedMutexLocker locker(&inputMutex);
+    return inputComplete;
 }
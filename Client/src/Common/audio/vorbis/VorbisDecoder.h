@@ -1,11 +1,21 @@
-#include <vorbis/vorbisfile.h>
+#include <vorbis/codec.h>
 #include "audio/core/SamplesBuffer.h"
+#include "audio/IntervalCodec.h"
 #include <QByteArray>
+#include <QList>
+#include <QMutex>
 
 #ifndef VORBIS_DECODER_H
 #define VORBIS_DECODER_H
 
-class VorbisDecoder
+/**
+ * Streaming vorbis decoder, the bytes are decoded while the interval is downloading.
+ *
+ * The decoder can be reused in the next intervals (restart()). The setup header (codebooks) is
+ * parsed only when the stream headers change, normally all intervals of a remote channel have
+ * byte-identical headers and just the synthesis state is restarted.
+ */
+class VorbisDecoder : public Audio::IntervalDecoder
 {
 public:
     VorbisDecoder();
@@ -19,17 +29,17 @@ public:
 
     inline bool isMono() const
     {
-        return vorbisFile.vi->channels == 1;
+        return getChannels() == 1;
     }
 
     inline int getChannels() const
     {
-        return vorbisFile.vi->channels;
+        return setupParsed ? vorbisInfo.channels : 0;
     }
 
     inline int getSampleRate() const
     {
-        return vorbisFile.vi->rate;
+        return setupParsed ? vorbisInfo.rate : 0;
     }
 
     inline bool isInitialized() const
@@ -37,25 +47,62 @@ public:
         return initialized;
     }
 
-    void setInput(QByteArray vorbisData);
-    void reset();
+    void setInput(QByteArray vorbisData);// the whole input, kept to allow a reset()
+
+    // streaming input, can be called by other thread while decoding. The decoder is initialized when the headers are available.
+    void addInput(const QByteArray &vorbisData, bool isLastPart);
+    bool isInputComplete() const;
+
+    void reset();// decode the same input again, only after setInput()
+    void restart();// decode a new input, the parsed headers are reused if possible
+
     inline int getTotalDecodedSamples() const
     {
         return decodedSamples;
     }
 
+    // setup headers parsed since the decoder creation, the other streams reused the parsed headers
+    inline int getParsedSetups() const
+    {
+        return parsedSetups;
+    }
+
 private:
-    bool initialize();
+    static const int HEADER_PACKETS = 3;// identification, comments and setup
+    static const int BYTES_PER_READ = 4096;
+    static const int MAX_FRAMES_PER_DECODE = 4096;
+    static const int MIN_CONSUMED_BYTES_TO_REMOVE = 65536;// the streamed input is compacted in blocks
+
     Audio::SamplesBuffer internalBuffer;
-    OggVorbis_File vorbisFile;
-    bool initialized;
-    QByteArray vorbisInput;
-    float **outBuffer;
-    static size_t readOgg(void *oggOutBuffer, size_t size, size_t nmemb, void *decoderInstance);
 
-    size_t consumeTo(void *oggOutBuffer, size_t bytesToConsume);
+    ogg_sync_state syncState;
+    ogg_stream_state streamState;
+    bool streamStarted;// the first page of the current stream was readed
+    bool streamFailed;// invalid headers, the stream is not decoded
+
+    vorbis_info vorbisInfo;
+    vorbis_comment vorbisComment;
+    vorbis_dsp_state dspState;
+    vorbis_block block;
+    bool setupParsed;// vorbisInfo, dspState and block are valid for 'parsedHeaders'
+    QList<QByteArray> parsedHeaders;
+    QList<QByteArray> streamHeaders;// the header packets of the current stream
+    bool initialized;// the current stream headers are parsed, the audio packets can be decoded
+    int parsedSetups;
+
+    QByteArray vorbisInput;
+    int inputOffset;//bytes already passed to the ogg parser
+    bool keepConsumedInput;//true after setInput(), the streamed input (addInput()) is removed after parsed
+    bool inputComplete;
+    mutable QMutex inputMutex;
 
     int decodedSamples;
+
+    bool readPacket(ogg_packet &packet);
+    void readHeader(const ogg_packet &packet);
+    bool parseHeaders();
+    void releaseSetup();
+    void restartStream();
 };
 
 #endif
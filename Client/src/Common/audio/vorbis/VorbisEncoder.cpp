@@ -29,8 +29,8 @@ void VorbisEncoder::init(int channels, int sampleRate){
     }
     vorbis_comment_init(&comment);
     vorbis_comment_add_tag(&comment, "Encoder", "Jamtaba");
+    vorbis_comment_add_tag(&comment, Audio::IntervalCodecs::DECODERS_TAG, Audio::IntervalCodecs::getSupportedDecoders().constData());//must be the last comment
 
-    streamID = 0;
     isFirstEncoding = true;
 
     //encodeFirstVorbisHeaders();
@@ -58,7 +58,7 @@ VorbisEncoder::~VorbisEncoder() {
 void VorbisEncoder::encodeFirstVorbisHeaders(){
     vorbis_analysis_init(&dspState, &info);
     vorbis_block_init(&dspState, &block);
-    ogg_stream_init(&streamState, streamID++);
+    ogg_stream_init(&streamState, Audio::IntervalCodecs::newStreamSerialNumber());
 
     //writing headers
     ogg_packet header, header_comm, header_code;
@@ -99,7 +99,7 @@ QByteArray VorbisEncoder::encode(const Audio::SamplesBuffer& samples) {
 
         int channels = std::min(info.channels, samples.getChannels());
         for (int c = 0; c < channels; c++) {
-            memcpy(vorbisBuffer[c], samples.getSamplesArray(c), samples.getFrameLenght() * sizeof(float));
+            memcpy(vorbisBuffer[c], samples.getReadOnlySamplesArray(c), samples.getFrameLenght() * sizeof(float));
         }
     }
     //lenght == 0 in the end of interval
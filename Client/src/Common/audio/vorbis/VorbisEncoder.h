@@ -3,9 +3,10 @@
 
 #include "vorbis/vorbisenc.h"
 #include "audio/core/SamplesBuffer.h"
+#include "audio/IntervalCodec.h"
 #include <QByteArray>
 
-class VorbisEncoder
+class VorbisEncoder : public Audio::IntervalEncoder
 {
 
 public:
@@ -17,6 +18,7 @@ public:
     QByteArray finishIntervalEncoding();
     inline int getChannels() const{return info.channels;}
     inline int getSampleRate() const{return info.rate;}
+    inline Audio::IntervalCodec getCodec() const{return Audio::IntervalCodec::VORBIS;}
 //    inline int getTotalEncoded() const{return totalEncoded;}
 private:
     static const float QUALITY;// = 0.32;//vorbis default quality is 0.3
@@ -47,8 +49,6 @@ private:
     void clearState();
 
     bool isFirstEncoding;
-
-    int streamID;
 };
 
 
@@ -24,6 +24,7 @@
 #include <cassert>
 #include "log/Logging.h"
 #include "VstLoader.h"
+#include "audio/core/RtViolationDetector.h"
 
 using namespace Vst;
 
@@ -45,7 +46,9 @@ VstPlugin::VstPlugin(Vst::Host* host)
     this->vstMidiEvents.reserved = 0;
     this->vstMidiEvents.numEvents = 0;
     for (int i = 0; i < MAX_MIDI_EVENTS; ++i) {
-        this->vstMidiEvents.events[i] = (VstEvent*)(new VstMidiEvent);
+        this->midiEvents[i] = new VstMidiEvent;
+        this->sysExEvents[i] = new VstMidiSysexEvent;
+        this->vstMidiEvents.events[i] = (VstEvent*)midiEvents[i];
     }
 
     assert(host);
@@ -109,6 +112,9 @@ void VstPlugin::restoreFromSerializedData(QByteArray dataToRestore){
 void VstPlugin::resume(){
 
     qCDebug(jtVstPlugin) << "Resuming " << getName() << "thread: " << QThread::currentThreadId();
+    //the audio driver can be restarted with other block size or sample rate while the plugin is suspended
+    effect->dispatcher(effect, effSetSampleRate, 0, 0, NULL, host->getSampleRate());
+    effect->dispatcher(effect, effSetBlockSize, 0, host->getBufferSize(), NULL, 0.0f);
     effect->dispatcher(effect, effMainsChanged, 0, 1, NULL, 0.0f);
 
     effect->dispatcher(effect, effStartProcess, 0, 1, NULL, 0.0f);
@@ -189,7 +195,8 @@ VstPlugin::~VstPlugin(){
     delete internalOutputBuffer;
 
     for (int i = 0; i < MAX_MIDI_EVENTS; ++i) {
-        delete this->vstMidiEvents.events[i];
+        delete this->midiEvents[i];
+        delete this->sysExEvents[i];
     }
 
     if(vstOutputArray){
@@ -223,25 +230,39 @@ void VstPlugin::fillVstEventsList(const Midi::MidiBuffer &midiBuffer){
     this->vstMidiEvents.numEvents = midiMessages;
     for (int m = 0; m < midiMessages; ++m) {
         Midi::MidiMessage message = midiBuffer.getMessage(m);
-        qCDebug(jtVstPlugin) << getName() << "Midi message: channel " << message.getChannel();
-        VstMidiEvent* vstEvent = (VstMidiEvent*)vstMidiEvents.events[m];
+        if(message.isSysEx()){//the dump bytes are owned by the midiBuffer, valid during this block
+            VstMidiSysexEvent* sysExEvent = sysExEvents[m];
+            sysExEvent->type = kVstSysExType;
+            sysExEvent->byteSize = sizeof(VstMidiSysexEvent);
+            sysExEvent->deltaFrames = message.getFrameOffset();
+            sysExEvent->flags = 0;
+            sysExEvent->dumpBytes = message.getSysExSize();
+            sysExEvent->resvd1 = sysExEvent->resvd2 = 0;
+            sysExEvent->sysexDump = (char*)message.getSysExData();
+            vstMidiEvents.events[m] = (VstEvent*)sysExEvent;
+            continue;
+        }
+        VstMidiEvent* vstEvent = midiEvents[m];
         vstEvent->type = kVstMidiType;
-        vstEvent->byteSize = sizeof(vstEvent);
-        vstEvent->deltaFrames = 0;
+        vstEvent->byteSize = sizeof(VstMidiEvent);
+        vstEvent->deltaFrames = message.getFrameOffset();//the position in this block, see Midi::MidiDriver::fillBuffer()
         vstEvent->midiData[0] = message.getStatus();
         vstEvent->midiData[1] = message.getData1();
         vstEvent->midiData[2] = message.getData2();
         vstEvent->midiData[3] = 0;
+        vstEvent->noteLength = vstEvent->noteOffset = 0;
+        vstEvent->detune = vstEvent->noteOffVelocity = 0;
         vstEvent->reserved1 = vstEvent->reserved2 = 0;
         vstEvent->flags = kVstMidiEventIsRealtime;
+        vstMidiEvents.events[m] = (VstEvent*)vstEvent;
     }
 }
 
 void VstPlugin::process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &outBuffer, const Midi::MidiBuffer& midiBuffer){
 
-    Q_UNUSED(in)
     //qCDebug(vst) << "processing ...";
     if( isBypassed() || !effect || !loaded || !started){
+        outBuffer.set(in);//not processed, the samples are passed to the next processor
         return;
     }
 
@@ -255,26 +276,45 @@ void VstPlugin::process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &ou
         effect->dispatcher(effect, effProcessEvents, 0, 0, (void*)&vstMidiEvents, 0);
     }
 
-    internalOutputBuffer->setFrameLenght(outBuffer.getFrameLenght());
-    internalInputBuffer->setFrameLenght(outBuffer.getFrameLenght());
-
-    internalInputBuffer->set(in);
+    VstInt32 sampleFrames = outBuffer.getFrameLenght();
 
-    int inChannels = internalInputBuffer->getChannels();
-    for (int c = 0; c < inChannels; ++c) {
-        vstInputArray[c] = internalInputBuffer->getSamplesArray(c);
+    //The insert chain buffers are used directly when the channels match, so no samples are copied.
+    //The plugin read the previous processor output and write in the other chain buffer (see
+    //AudioNode::processReplacing). The internal buffers are used for the other channel layouts.
+    int inChannels = effect->numInputs;
+    if(in.getChannels() == inChannels && (VstInt32)in.getFrameLenght() >= sampleFrames){
+        for (int c = 0; c < inChannels; ++c) {
+            vstInputArray[c] = const_cast<float *>(in.getReadOnlySamplesArray(c));//inputs are not changed by VSTs
+        }
+    }
+    else{
+        internalInputBuffer->setFrameLenght(sampleFrames);
+        internalInputBuffer->set(in);
+        for (int c = 0; c < inChannels; ++c) {
+            vstInputArray[c] = internalInputBuffer->getSamplesArray(c);
+        }
     }
 
-    int outChannels = internalOutputBuffer->getChannels();
+    bool usingChainOutput = outBuffer.getChannels() == effect->numOutputs && &in != &outBuffer;
+    Audio::SamplesBuffer *vstOutputBuffer = usingChainOutput ? &outBuffer : internalOutputBuffer;
+    vstOutputBuffer->setFrameLenght(sampleFrames);
+    int outChannels = vstOutputBuffer->getChannels();
     for (int c = 0; c < outChannels; ++c) {
-        vstOutputArray[c] = internalOutputBuffer->getSamplesArray(c);
+        vstOutputArray[c] = vstOutputBuffer->getSamplesArray(c);
     }
 
-    VstInt32 sampleFrames = outBuffer.getFrameLenght();
     if(effect->flags & effFlagsCanReplacing){
-        QMutexLocker locker(&editorMutex);
+        Audio::RtCheckedMutexLocker locker(&editorMutex);
         effect->processReplacing(effect, vstInputArray, vstOutputArray, sampleFrames);
     }
+    else{
+        vstOutputBuffer->zero();
+    }
+
+    if(!usingChainOutput){
+        outBuffer.set(*internalOutputBuffer);
+    }
+
     //after a lot of tests I realize VSTs are processing input samples and
     //replacing the output buffer with these processed samples.
     //But VSTis are generating output samples directly, without touch the input
@@ -283,10 +323,7 @@ void VstPlugin::process(const Audio::SamplesBuffer &in, Audio::SamplesBuffer &ou
     //they will generate a fresh output and replacing the last outputs. The result
     //is just the last VTSi in the chain can be heard.
     if(effect->flags & effFlagsIsSynth){
-        outBuffer.add(*internalOutputBuffer);//VSTis add and preserve the last generated output samples
-    }
-    else{
-        outBuffer.set(*internalOutputBuffer);//VSTs are replacing
+        outBuffer.add(in);//VSTis add and preserve the last generated output samples (not summed when silent)
     }
 }
 
@@ -299,7 +336,7 @@ void VstPlugin::setBypass(bool state){
 
 void VstPlugin::closeEditor(){
     qCDebug(jtVstPlugin) << "Closing " << getName() << " editor. Thread:" << QThread::currentThreadId();
-    QMutexLocker locker(&editorMutex);
+    Audio::RtCheckedMutexLocker locker(&editorMutex);
     if(effect && editorWindow){
         effect->dispatcher(effect, effEditClose, 0, 0, NULL, 0);
     }
@@ -318,7 +355,7 @@ void VstPlugin::openEditor(QPoint centerOfScreen){
         return;
     }
 
-    QMutexLocker locker(&editorMutex);
+    Audio::RtCheckedMutexLocker locker(&editorMutex);
 
     if(editorWindow && editorWindow->isVisible()){
         editorWindow->raise();
@@ -6,7 +6,7 @@
 #include <QMap>
 #include <QLibrary>
 
-#define MAX_MIDI_EVENTS 40 // in my tests playing piano I can genenerate just 3 messages per block (256 samples) at maximum
+#define MAX_MIDI_EVENTS 256 // the size of the MIDI buffer used in each audio block (Midi::MidiBuffer::MAX_BLOCK_MESSAGES)
 
 namespace Vst {
 class Host;
@@ -76,6 +76,8 @@ private:
     };
 
     VSTEventBlock<MAX_MIDI_EVENTS> vstMidiEvents;
+    VstMidiEvent *midiEvents[MAX_MIDI_EVENTS];// allocated in the constructor, reused in each block
+    VstMidiSysexEvent *sysExEvents[MAX_MIDI_EVENTS];
 
     static QMap<QString, QDialog *> editorsWindows;
 };
@@ -0,0 +1,145 @@
+#include "DspProfilerDialog.h"
+#include "audio/core/DspProfiler.h"
+#include "ninjam/Service.h"
+#include <QCheckBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include <algorithm>
+
+using namespace Audio;
+
+DspProfilerDialog::DspProfilerDialog(Ninjam::Service *ninjamService, QWidget *parent) :
+    QDialog(parent),
+    ninjamService(ninjamService),
+    enabledCheckBox(new QCheckBox("Profiling enabled", this)),
+    table(new QTableWidget(this)),
+    uploadQueueLabel(new QLabel(this))
+{
+    setWindowTitle("DSP Profiler");
+    resize(860, 480);
+
+    QStringList columns;
+    columns << "Name" << "Blocks" << "Average" << "P50" << "P99" << "Max" << "Budget used (max)"
+            << "Overruns";
+    table->setColumnCount(columns.size());
+    table->setHorizontalHeaderLabels(columns);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->verticalHeader()->hide();
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+
+    QPushButton *resetButton = new QPushButton("Reset", this);
+    QPushButton *csvButton = new QPushButton("Export CSV ...", this);
+    QPushButton *jsonButton = new QPushButton("Export JSON ...", this);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    buttonsLayout->addWidget(enabledCheckBox);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(resetButton);
+    buttonsLayout->addWidget(csvButton);
+    buttonsLayout->addWidget(jsonButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table);
+    layout->addWidget(uploadQueueLabel);
+    layout->addLayout(buttonsLayout);
+
+    enabledCheckBox->setChecked(DspProfiler::isEnabled());
+    QObject::connect(enabledCheckBox, SIGNAL(toggled(bool)), this, SLOT(setProfilerEnabled(bool)));
+    QObject::connect(resetButton, SIGNAL(clicked()), this, SLOT(resetStatistics()));
+    QObject::connect(csvButton, SIGNAL(clicked()), this, SLOT(exportCsv()));
+    QObject::connect(jsonButton, SIGNAL(clicked()), this, SLOT(exportJson()));
+    QObject::connect(&updateTimer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+    updateTimer.start(UPDATE_PERIOD);
+
+    updateStatistics();
+}
+
+void DspProfilerDialog::setProfilerEnabled(bool enabled)
+{
+    DspProfiler::setEnabled(enabled);
+}
+
+void DspProfilerDialog::resetStatistics()
+{
+    DspProfiler::reset();
+    updateStatistics();
+}
+
+QString DspProfilerDialog::formatTime(qint64 nanoseconds)
+{
+    return QString::number(nanoseconds / 1000.0, 'f', 1) + " us";
+}
+
+void DspProfilerDialog::updateStatistics()
+{
+    QList<ProfileStatistics> statistics = DspProfiler::getStatistics();
+    std::sort(statistics.begin(), statistics.end(),
+              [](const ProfileStatistics &a, const ProfileStatistics &b) {
+        return a.percentile99 > b.percentile99;
+    });
+
+    table->setRowCount(statistics.size());
+    for (int row = 0; row < statistics.size(); ++row) {
+        const ProfileStatistics &s = statistics.at(row);
+        QString budgetUsed = "-";
+        if (s.budget > 0)
+            budgetUsed = QString::number(s.maxTime * 100.0 / s.budget, 'f', 1) + " %";
+        QStringList values;
+        values << s.name << QString::number(s.samples) << formatTime(s.averageTime)
+               << formatTime(s.percentile50) << formatTime(s.percentile99) << formatTime(s.maxTime)
+               << budgetUsed << QString::number(s.overruns);
+        for (int column = 0; column < values.size(); ++column) {
+            QTableWidgetItem *item = table->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem();
+                table->setItem(row, column, item);
+            }
+            item->setText(values.at(column));
+        }
+    }
+    updateUploadQueueStatistics();
+}
+
+void DspProfilerDialog::updateUploadQueueStatistics()
+{
+    // the ninjam upload is not profiled, a growing queue means the network can't keep up
+    uploadQueueLabel->setText(QString("Upload queue: %1 segments, %2 KB in flight (max %3 KB), %4 KB sent")
+                              .arg(ninjamService->getSendQueueDepth())
+                              .arg(ninjamService->getSendBytesInFlight() / 1024.0, 0, 'f', 1)
+                              .arg(ninjamService->getMaxSendBytesInFlight() / 1024.0, 0, 'f', 1)
+                              .arg(ninjamService->getSentBytes() / 1024.0, 0, 'f', 1));
+}
+
+void DspProfilerDialog::exportCsv()
+{
+    exportStatistics("CSV files (*.csv)", false);
+}
+
+void DspProfilerDialog::exportJson()
+{
+    exportStatistics("JSON files (*.json)", true);
+}
+
+void DspProfilerDialog::exportStatistics(const QString &fileFilter, bool json)
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Export DSP profiler statistics",
+                                                    QString(), fileFilter);
+    if (fileName.isEmpty())
+        return;
+
+    QList<ProfileStatistics> statistics = DspProfiler::getStatistics();
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        QMessageBox::warning(this, "Error", "Can't write the file " + fileName);
+        return;
+    }
+    file.write(json ? DspProfiler::toJson(statistics) : DspProfiler::toCsv(statistics));
+}
@@ -0,0 +1,44 @@
+#ifndef DSP_PROFILER_DIALOG_H
+#define DSP_PROFILER_DIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+
+class QCheckBox;
+class QLabel;
+class QTableWidget;
+
+namespace Ninjam {
+class Service;
+}
+
+// debug panel showing the DSP profiler statistics, the slowest code is listed first
+class DspProfilerDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DspProfilerDialog(Ninjam::Service *ninjamService, QWidget *parent = 0);
+
+private slots:
+    void updateStatistics();
+    void setProfilerEnabled(bool enabled);
+    void resetStatistics();
+    void exportCsv();
+    void exportJson();
+
+private:
+    Ninjam::Service *ninjamService;
+    QCheckBox *enabledCheckBox;
+    QTableWidget *table;
+    QLabel *uploadQueueLabel;
+    QTimer updateTimer;
+
+    static const int UPDATE_PERIOD = 500;// milliseconds
+
+    void exportStatistics(const QString &fileFilter, bool json);
+    void updateUploadQueueStatistics();
+    static QString formatTime(qint64 nanoseconds);
+};
+
+#endif // DSP_PROFILER_DIALOG_H
@@ -27,6 +27,7 @@ MainWindow::MainWindow(Controller::MainController *mainController, QWidget *pare
     busyDialog(0),
     mainController(mainController),
     pluginScanDialog(nullptr),
+    dspProfilerDialog(nullptr),
     ninjamWindow(nullptr),
     roomToJump(nullptr),
     fullViewMode(true),
@@ -1042,6 +1043,14 @@ void MainWindow::showJamtabaCurrentVersion()
     QMessageBox::about(this, title, text);
 }
 
+void MainWindow::showDspProfilerDialog()
+{
+    if (!dspProfilerDialog)
+        dspProfilerDialog.reset(new DspProfilerDialog(mainController->getNinjamService(), this));
+    dspProfilerDialog->show();
+    dspProfilerDialog->raise();
+}
+
 // ++++++++++++++++++
 void MainWindow::setMasterFaderPosition(int value)
 {
@@ -1185,6 +1194,9 @@ void MainWindow::setupSignals()
     QObject::connect(ui.actionCurrentVersion, SIGNAL(triggered(bool)), this,
                      SLOT(showJamtabaCurrentVersion()));
 
+    QObject::connect(ui.actionDspProfiler, SIGNAL(triggered(bool)), this,
+                     SLOT(showDspProfilerDialog()));
+
     QObject::connect(ui.localControlsCollapseButton, SIGNAL(clicked()), this,
                      SLOT(toggleLocalInputsCollapseStatus()));
 
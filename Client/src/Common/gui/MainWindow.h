@@ -5,6 +5,7 @@
 #include "BusyDialog.h"
 #include "chords/ChordsPanel.h"
 #include "PluginScanDialog.h"
+#include "DspProfilerDialog.h"
 #include "NinjamRoomWindow.h"
 #include "MainController.h"
 #include "JamRoomViewPanel.h"
@@ -173,6 +174,7 @@ private slots:
     void toggleFullScreen();
     void closePluginScanDialog();
     void showJamtabaCurrentVersion();
+    void showDspProfilerDialog();
 
     void updateLocalInputChannelsGeometry();
 
@@ -196,6 +198,7 @@ private:
     QMap<long long, JamRoomViewPanel *> roomViewPanels;
 
     QScopedPointer<PluginScanDialog> pluginScanDialog;
+    QScopedPointer<DspProfilerDialog> dspProfilerDialog;
 
     QScopedPointer<NinjamRoomWindow> ninjamWindow;
 
@@ -14,6 +14,7 @@ Q_DECLARE_LOGGING_CATEGORY(jtNinjamGUI)
 Q_DECLARE_LOGGING_CATEGORY(jtGUI)
 Q_DECLARE_LOGGING_CATEGORY(jtNinjamVorbisEncoder)
 Q_DECLARE_LOGGING_CATEGORY(jtNinjamVorbisDecoder)
+Q_DECLARE_LOGGING_CATEGORY(jtNinjamOpus)
 Q_DECLARE_LOGGING_CATEGORY(jtNinjamRoomStreamer)
 Q_DECLARE_LOGGING_CATEGORY(jtJamRecorder)
 Q_DECLARE_LOGGING_CATEGORY(jtIpToLocation)
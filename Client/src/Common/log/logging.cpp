@@ -8,6 +8,7 @@ Q_LOGGING_CATEGORY(jtNinjamGUI,             "jt.Ninjam.GUI")
 Q_LOGGING_CATEGORY(jtGUI,                   "jt.GUI")
 Q_LOGGING_CATEGORY(jtNinjamVorbisEncoder,   "jt.Ninjam.VorbisEncoder")
 Q_LOGGING_CATEGORY(jtNinjamVorbisDecoder,   "jt.Ninjam.VorbisDecoder")
+Q_LOGGING_CATEGORY(jtNinjamOpus,            "jt.Ninjam.Opus")
 Q_LOGGING_CATEGORY(jtNinjamRoomStreamer,    "jt.Ninjam.RoomStreamer")
 Q_LOGGING_CATEGORY(jtJamRecorder,           "jt.JamRecorder")
 Q_LOGGING_CATEGORY(jtIpToLocation,          "jt.IpToLocation")
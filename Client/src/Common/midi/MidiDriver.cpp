@@ -1,25 +1,53 @@
 #include "MidiDriver.h"
-#include "log/Logging.h"
+#include <cstring>
 
 using namespace Midi;
 // +++++++++++++++++++++++
-MidiMessage::MidiMessage(qint32 data, qint32 timestamp, int sourceDeviceIndex)
+MidiMessage::MidiMessage(qint32 data, qint32 frameOffset, int sourceDeviceIndex) :
+    data(data),
+    frameOffset(frameOffset),
+    deviceIndex(sourceDeviceIndex),
+    sysExData(nullptr),
+    sysExSize(0)
 {
-    this->data = data;
-    this->timestamp = timestamp;
-    this->deviceIndex = sourceDeviceIndex;
 }
 
-MidiMessage::MidiMessage()
+MidiMessage::MidiMessage(const quint8 *sysExData, int sysExSize, qint32 frameOffset,
+                         int sourceDeviceIndex) :
+    data(0xF0),
+    frameOffset(frameOffset),
+    deviceIndex(sourceDeviceIndex),
+    sysExData(sysExData),
+    sysExSize(sysExSize)
 {
-    this->data = this->timestamp = this->deviceIndex = -1;
 }
 
-MidiMessage::MidiMessage(const MidiMessage &other)
+MidiMessage::MidiMessage() :
+    data(-1),
+    frameOffset(-1),
+    deviceIndex(-1),
+    sysExData(nullptr),
+    sysExSize(0)
 {
-    this->data = other.data;
-    this->timestamp = other.timestamp;
-    this->deviceIndex = other.deviceIndex;
+}
+
+MidiMessage::MidiMessage(const MidiMessage &other) :
+    data(other.data),
+    frameOffset(other.frameOffset),
+    deviceIndex(other.deviceIndex),
+    sysExData(other.sysExData),
+    sysExSize(other.sysExSize)
+{
+}
+
+MidiMessage &MidiMessage::operator=(const MidiMessage &other)
+{
+    data = other.data;
+    frameOffset = other.frameOffset;
+    deviceIndex = other.deviceIndex;
+    sysExData = other.sysExData;
+    sysExSize = other.sysExSize;
+    return *this;
 }
 
 // +++++++++++++++++++++++
@@ -40,25 +68,44 @@ bool MidiMessage::isNote() const
 
 // +++++++++++++++++++++++++++++++++++++
 
-MidiBuffer::MidiBuffer(int maxMessages) :
+MidiBuffer::MidiBuffer(int maxMessages, int maxSysExBytes) :
     maxMessages(maxMessages),
     messages(new MidiMessage[maxMessages]),
-    messagesCount(0)
+    messagesCount(0),
+    maxSysExBytes(maxSysExBytes),
+    sysExBytes(maxSysExBytes > 0 ? new quint8[maxSysExBytes] : nullptr),
+    sysExBytesUsed(0)
 {
 }
 
 MidiBuffer::MidiBuffer(const MidiBuffer &other) :
     maxMessages(other.maxMessages),
     messages(new MidiMessage[other.maxMessages]),
-    messagesCount(other.messagesCount)
+    messagesCount(other.messagesCount),
+    maxSysExBytes(other.maxSysExBytes),
+    sysExBytes(other.maxSysExBytes > 0 ? new quint8[other.maxSysExBytes] : nullptr),
+    sysExBytesUsed(other.sysExBytesUsed)
 {
-    for (int m = 0; m < other.messagesCount; ++m)
-        this->messages[m] = other.messages[m];
+    if (sysExBytesUsed > 0)
+        std::memcpy(sysExBytes, other.sysExBytes, sysExBytesUsed);
+    for (int m = 0; m < other.messagesCount; ++m) {
+        const MidiMessage &message = other.messages[m];
+        const quint8 *sysExData = message.getSysExData();
+        if (message.isSysEx() && sysExData >= other.sysExBytes
+            && sysExData < other.sysExBytes + other.sysExBytesUsed) {// the copy owns the bytes
+            this->messages[m] = MidiMessage(sysExBytes + (sysExData - other.sysExBytes),
+                                            message.getSysExSize(), message.getFrameOffset(),
+                                            message.getDeviceIndex());
+        } else {
+            this->messages[m] = message;
+        }
+    }
 }
 
 MidiBuffer::~MidiBuffer()
 {
     delete [] messages;
+    delete [] sysExBytes;
 }
 
 void MidiBuffer::addMessage(const MidiMessage &m)
@@ -66,9 +113,18 @@ void MidiBuffer::addMessage(const MidiMessage &m)
     if (messagesCount < maxMessages) {
         messages[messagesCount] = m;
         messagesCount++;
-    } else {
-        qCWarning(jtMidi) << "MidiBuffer full, discarding the message!";
-    }
+    }// else the message is discarded, the audio thread can't log
+}
+
+bool MidiBuffer::addSysEx(const quint8 *data, int size, qint32 frameOffset, int deviceIndex)
+{
+    if (messagesCount >= maxMessages || size <= 0 || sysExBytesUsed + size > maxSysExBytes)
+        return false;
+    quint8 *copy = sysExBytes + sysExBytesUsed;
+    std::memcpy(copy, data, size);
+    sysExBytesUsed += size;
+    addMessage(MidiMessage(copy, size, frameOffset, deviceIndex));
+    return true;
 }
 
 MidiMessage MidiBuffer::getMessage(int index) const
@@ -78,6 +134,24 @@ MidiMessage MidiBuffer::getMessage(int index) const
     return MidiMessage();
 }
 
+void MidiBuffer::clear()
+{
+    messagesCount = 0;
+    sysExBytesUsed = 0;
+}
+
+void MidiBuffer::sortByFrameOffset()
+{
+    // insertion sort, few messages per block and most of them are already sorted
+    for (int i = 1; i < messagesCount; ++i) {
+        MidiMessage message = messages[i];
+        int j = i - 1;
+        for (; j >= 0 && messages[j].getFrameOffset() > message.getFrameOffset(); --j)
+            messages[j + 1] = messages[j];
+        messages[j + 1] = message;
+    }
+}
+
 // ++++++++++++++++
 MidiDriver::MidiDriver()
 {
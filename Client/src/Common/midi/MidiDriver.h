@@ -8,9 +8,12 @@ namespace Midi {
 class MidiMessage
 {
 public:
-    MidiMessage(qint32 data, qint32 timestamp, int sourceDeviceIndex);
+    // 'frameOffset' is the message position in the audio block
+    MidiMessage(qint32 data, qint32 frameOffset, int sourceDeviceIndex);
+    MidiMessage(const quint8 *sysExData, int sysExSize, qint32 frameOffset, int sourceDeviceIndex);
     MidiMessage();
     MidiMessage(const MidiMessage &other);
+    MidiMessage &operator=(const MidiMessage &other);
 
     inline int getChannel() const
     {
@@ -46,29 +49,73 @@ public:
         return getStatus() == 0xB0;
     }
 
+    inline qint32 getFrameOffset() const
+    {
+        return frameOffset;
+    }
+
+    inline bool isSysEx() const
+    {
+        return sysExSize > 0;
+    }
+
+    // the complete message (F0 ... F7), the bytes are owned by the MidiBuffer
+    inline const quint8 *getSysExData() const
+    {
+        return sysExData;
+    }
+
+    inline int getSysExSize() const
+    {
+        return sysExSize;
+    }
+
 private:
     qint32 data;
-    qint32 timestamp;
+    qint32 frameOffset;
     int deviceIndex;
+    const quint8 *sysExData;
+    int sysExSize;
 };
 
+/**
+ * The MIDI messages of one audio block. All the memory is allocated in the constructor, the
+ * buffers are reused in each block (clear()) by the audio thread.
+ */
 class MidiBuffer
 {
 public:
-    explicit MidiBuffer(int maxMessages);
+    explicit MidiBuffer(int maxMessages, int maxSysExBytes = 0);
     ~MidiBuffer();
     void addMessage(const MidiMessage &m);
+
+    // the SysEx bytes are copied, return false if the buffer has no space
+    bool addSysEx(const quint8 *data, int size, qint32 frameOffset, int deviceIndex);
+
     MidiMessage getMessage(int index) const;
     int getMessagesCount() const
     {
         return messagesCount;
     }
 
+    void clear();
+    void sortByFrameOffset();// stable, the messages of each device keep the arrival order
+
+    // the size of the buffers used in each audio block
+    static const int MAX_BLOCK_MESSAGES = 256;
+    static const int MAX_BLOCK_SYSEX_BYTES = 16384;
+
     MidiBuffer(const MidiBuffer &other);
 private:
     int maxMessages;
     MidiMessage *messages;
     int messagesCount;
+
+    int maxSysExBytes;
+    quint8 *sysExBytes;
+    int sysExBytesUsed;
+
+    MidiBuffer &operator=(const MidiBuffer &other);
 };
 
 class MidiDriver
@@ -86,7 +133,11 @@ public:
     virtual int getMaxInputDevices() const = 0;
 
     virtual QString getInputDeviceName(int index) const = 0;
-    virtual MidiBuffer getBuffer() = 0;
+
+    // audio thread, called in each audio callback. The messages received since the last call are
+    // added in 'buffer' with their position in the block of 'frames' frames. The drivers never
+    // allocate or lock here.
+    virtual void fillBuffer(MidiBuffer &buffer, int frames, int sampleRate) = 0;
 
     virtual bool deviceIsGloballyEnabled(int deviceIndex) const;
     int getFirstGloballyEnableInputDevice() const;
@@ -127,9 +178,11 @@ class NullMidiDriver : public MidiDriver
         return "";
     }
 
-    inline virtual MidiBuffer getBuffer()
+    inline virtual void fillBuffer(MidiBuffer &buffer, int frames, int sampleRate)
     {
-        return MidiBuffer(0);
+        Q_UNUSED(frames);
+        Q_UNUSED(sampleRate);
+        buffer.clear();
     }
 };
 }
@@ -1,136 +1,254 @@
-﻿#include "RtMidiDriver.h"
-#include "RtMidi.h"
+﻿#include "rtMidiDriver.h"
+#include "log/Logging.h"
+
+#include <chrono>
+#include <cstring>
 
 using namespace Midi;
 
-#include "../log/Logging.h"
+RtMidiDriver::InputPort::InputPort(int deviceIndex) :
+    deviceIndex(deviceIndex),
+    stream(new RtMidiIn()),
+    queue(QUEUE_CAPACITY),
+    droppedEvents(0),
+    sysExSize(0),
+    sysExDiscarded(false)
+{
+    stream->ignoreTypes(false, true, true);// receive SysEx, ignore timing and active sensing
+    stream->setCallback(&RtMidiDriver::onMidiMessage, this);
+}
+
+RtMidiDriver::InputPort::~InputPort()
+{
+    if (stream->isPortOpen())
+        stream->closePort();// the callback is not called after this
+    delete stream;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
 
-RtMidiDriver::RtMidiDriver(QList<bool> deviceStatuses){
+RtMidiDriver::RtMidiDriver(QList<bool> deviceStatuses) :
+    lastFillTime(0)
+{
     qCInfo(jtMidi) << "Initializing rtmidi...";
     int maxInputDevices = getMaxInputDevices();
     qCDebug(jtMidi) << "MIDI DEVICES FOUND idx:" << maxInputDevices;
-    if(deviceStatuses.size() < maxInputDevices){
+    if (deviceStatuses.size() < maxInputDevices) {
         int itemsToAdd = maxInputDevices - deviceStatuses.size();
-        for (int i = 0; i < itemsToAdd; ++i) {
+        for (int i = 0; i < itemsToAdd; ++i)
             deviceStatuses.append(true);
-        }
     }
     setInputDevicesStatus(deviceStatuses);
     qCInfo(jtMidi) << "rtmidi initialized!";
-
 }
 
-void RtMidiDriver::setInputDevicesStatus(QList<bool> statuses){
+void RtMidiDriver::setInputDevicesStatus(QList<bool> statuses)
+{
     MidiDriver::setInputDevicesStatus(statuses);
 
     release();
 
     for (int s = 0; s < statuses.size(); ++s) {
-        midiStreams.append(new RtMidiIn());
+        try {
+            ports.append(new InputPort(s));
+        }
+        catch (const RtMidiError &e) {
+            qCCritical(jtMidi) << "Error creating the midi input " << QString::fromStdString(
+                e.getMessage());
+        }
     }
+
+    QList<InputPort *> newPorts = ports;
+    audioPorts.modify([newPorts](QList<InputPort *> &snapshot) {
+        snapshot = newPorts;
+    });
 }
 
-void RtMidiDriver::start(){
-    if(!hasInputDevices()){
+void RtMidiDriver::start()
+{
+    if (!hasInputDevices())
         return;
-    }
     stop();
 
-    for(int deviceIndex=0; deviceIndex < inputDevicesEnabledStatuses.size(); deviceIndex++) {
-        RtMidiIn* stream = midiStreams.at(deviceIndex);
-        if(stream && inputDevicesEnabledStatuses.at(deviceIndex)){//device is globally enabled?
-            if(!stream->isPortOpen()){
-                try{
-                    qCInfo(jtMidi) << "Starting MIDI in " << QString::fromStdString(stream->getPortName(deviceIndex));
+    foreach (InputPort *port, ports) {
+        int deviceIndex = port->deviceIndex;
+        RtMidiIn *stream = port->stream;
+        if (deviceIndex < inputDevicesEnabledStatuses.size()
+            && inputDevicesEnabledStatuses.at(deviceIndex)) {// device is globally enabled?
+            if (!stream->isPortOpen()) {
+                try {
+                    qCInfo(jtMidi) << "Starting MIDI in " << QString::fromStdString(
+                        stream->getPortName(deviceIndex));
                     stream->openPort(deviceIndex);
                 }
-                catch(RtMidiError e){
-                    qCCritical(jtMidi) << "Error opening midi port " << QString::fromStdString(e.getMessage());
+                catch (const RtMidiError &e) {
+                    qCCritical(jtMidi) << "Error opening midi port " << QString::fromStdString(
+                        e.getMessage());
                 }
-            }
-            else{
-                qCCritical(jtMidi) << "Port " << QString::fromStdString(stream->getPortName(deviceIndex)) << " already opened!";
+            } else {
+                qCCritical(jtMidi) << "Port " << QString::fromStdString(stream->getPortName(
+                                                                            deviceIndex))
+                                   << " already opened!";
             }
         }
+    }
+}
 
+void RtMidiDriver::stop()
+{
+    foreach (InputPort *port, ports) {
+        if (port->stream->isPortOpen())
+            port->stream->closePort();
+        quint64 dropped = port->droppedEvents.exchange(0);
+        if (dropped > 0)
+            qCWarning(jtMidi) << dropped << "MIDI events discarded in the device" << port->deviceIndex;
     }
+}
 
+void RtMidiDriver::release()
+{
+    // the audio thread can't see the ports after modify() returns
+    audioPorts.modify([](QList<InputPort *> &snapshot) {
+        snapshot.clear();
+    });
+    qDeleteAll(ports);
+    ports.clear();
 }
 
-void RtMidiDriver::stop(){
-    foreach (RtMidiIn* stream, midiStreams) {
-        if(stream){
-            stream->closePort();
+QString RtMidiDriver::getInputDeviceName(int index) const
+{
+    if (index >= 0 && index < ports.size())
+        return QString::fromStdString(ports.at(index)->stream->getPortName(index));
+    return "error";
+}
+
+// ++++++++++++++++++++ RtMidi thread +++++++++++++++++++++++++
+
+void RtMidiDriver::onMidiMessage(double deltaTime, std::vector<unsigned char> *message,
+                                 void *userData)
+{
+    Q_UNUSED(deltaTime);// the arrival time is used, it is compared with the audio callback time
+
+    InputPort *port = static_cast<InputPort *>(userData);
+    if (!message || message->empty())
+        return;
+
+    Event event;
+    event.arrivalTime = getTime();
+    const size_t messageSize = message->size();
+    if (message->at(0) != 0xF0) {
+        event.type = Event::SHORT_MESSAGE;
+        event.size = (quint8)qMin(messageSize, (size_t)3);
+        std::memcpy(event.bytes, message->data(), event.size);
+        if (!port->queue.push(event))
+            port->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    for (size_t offset = 0; offset < messageSize; offset += EVENT_BYTES) {
+        size_t partSize = qMin(messageSize - offset, (size_t)EVENT_BYTES);
+        event.type = offset + partSize < messageSize ? Event::SYSEX_PART : Event::SYSEX_END;
+        event.size = (quint8)partSize;
+        std::memcpy(event.bytes, message->data() + offset, partSize);
+        if (!port->queue.push(event)) {
+            // the incomplete message is discarded by the audio thread
+            port->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
     }
 }
 
-void RtMidiDriver::release(){
-    foreach (RtMidiIn* stream, midiStreams) {
-        if(stream){
-            if(stream->isPortOpen()){
-                stream->closePort();
+// ++++++++++++++++++++ audio thread +++++++++++++++++++++++++
+
+void RtMidiDriver::fillBuffer(MidiBuffer &buffer, int frames, int sampleRate)
+{
+    buffer.clear();
+    if (frames <= 0 || sampleRate <= 0)
+        return;
+
+    // the messages received while the previous block was playing are spread in this block
+    const qint64 now = getTime();
+    const qint64 blockDuration = (qint64)frames * 1000000000LL / sampleRate;
+    qint64 windowStart = now - blockDuration;
+    if (lastFillTime > 0 && now > lastFillTime && now - lastFillTime < blockDuration * 2)
+        windowStart = lastFillTime;// follow the real callback period
+    lastFillTime = now;
+    const qint64 window = qMax(now - windowStart, (qint64)1);
+
+    Audio::SnapshotPublisher<QList<InputPort *> >::Reader currentPorts(audioPorts);
+    foreach (InputPort *port, *currentPorts) {
+        Event event;
+        // the messages received after 'now' are used in the next block
+        while (port->queue.peek(event) && event.arrivalTime < now) {
+            port->queue.pop(event);
+            qint64 elapsed = qMax(event.arrivalTime - windowStart, (qint64)0);
+            qint32 frameOffset = (qint32)qMin(elapsed * frames / window, (qint64)(frames - 1));
+            if (event.type == Event::SHORT_MESSAGE) {
+                qint32 data = 0;
+                for (int b = 0; b < event.size; ++b)
+                    data |= event.bytes[b] << (8 * b);
+                buffer.addMessage(MidiMessage(data, frameOffset, port->deviceIndex));
+            } else {
+                readSysExPart(port, event, frameOffset, buffer);
             }
-            delete stream;
         }
     }
-    midiStreams.clear();
+    buffer.sortByFrameOffset();
 }
 
-QString RtMidiDriver::getInputDeviceName(int index) const{
-    if(midiStreams.at(index)){
-    return  QString::fromStdString(midiStreams.at(index)->getPortName(index));
+void RtMidiDriver::readSysExPart(InputPort *port, const Event &event, qint32 frameOffset,
+                                 MidiBuffer &buffer)
+{
+    if (event.bytes[0] == 0xF0) {// first part, discard any incomplete message
+        port->sysExSize = 0;
+        port->sysExDiscarded = false;
+    } else if (port->sysExSize == 0) {
+        port->sysExDiscarded = true;// the first part was dropped
     }
-    return "error";
-}
 
-MidiBuffer RtMidiDriver::getBuffer(){
-    MidiBuffer buffer(32);//max 32 midi messages
-    int deviceIndex = 0;
-    foreach (RtMidiIn* stream, midiStreams) {
-        while(true){
-            std::vector<unsigned char> message;
-            double stamp = stream->getMessage(&message);
-            if(!message.empty() && message.size() <= 3){
-                int msgData = 0;
-                msgData |= message.at(0);
-                if(message.size() == 3){
-                    msgData |= message.at(1) << 8;
-                    msgData |= message.at(2) << 16;
-                }else{
-                    msgData = 0;
-                    qCWarning(jtMidi) << "We receive a not common midi message with just" << message.size() << "bytes";
-                }
-                //qDebug(midi) << "original msgData:";
-                //qDebug(midi) << "Status:" << message.at(0);
-                //qDebug(midi) << "data 1:" << message.at(1);
-                //qDebug(midi) << "data 2:" << message.at(2) << endl;
+    if (port->sysExSize + event.size > MAX_SYSEX_BYTES)
+        port->sysExDiscarded = true;
 
-                buffer.addMessage(MidiMessage(msgData, qint32(stamp), deviceIndex));
+    if (!port->sysExDiscarded) {
+        std::memcpy(port->sysEx + port->sysExSize, event.bytes, event.size);
+        port->sysExSize += event.size;
+    }
 
-                //            qDebug(midi) << "msgData:" << msgData;
-                //            qDebug(midi) << "Status:" << ((msgData) & 0xFF);
-                //            qDebug(midi) << "data 1:" << (((msgData) >> 8) & 0xFF);
-                //            qDebug(midi) << "data 2:" << (((msgData) >> 16) & 0xFF);
-            }
-            else{
-                break;
-            }
-        }
-        deviceIndex++;
+    if (event.type == Event::SYSEX_END) {
+        if (!port->sysExDiscarded)
+            buffer.addSysEx(port->sysEx, port->sysExSize, frameOffset, port->deviceIndex);
+        port->sysExSize = 0;
+        port->sysExDiscarded = false;
     }
-    return buffer;
 }
 
-bool RtMidiDriver::hasInputDevices() const{
+qint64 RtMidiDriver::getTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++
+
+bool RtMidiDriver::hasInputDevices() const
+{
     return getMaxInputDevices() > 0;
 }
 
-int RtMidiDriver::getMaxInputDevices() const{
-    RtMidiIn* rtMidi=new RtMidiIn() ;
-    return rtMidi->getPortCount();
+int RtMidiDriver::getMaxInputDevices() const
+{
+    try {
+        RtMidiIn rtMidi;
+        return rtMidi.getPortCount();
+    }
+    catch (const RtMidiError &e) {
+        qCCritical(jtMidi) << "Error querying the midi inputs " << QString::fromStdString(
+            e.getMessage());
+    }
+    return 0;
 }
 
-RtMidiDriver::~RtMidiDriver(){
+RtMidiDriver::~RtMidiDriver()
+{
     release();
 }
@@ -2,6 +2,9 @@
 #define RTMIDIDRIVER_H
 
 #include "MidiDriver.h"
+#include "audio/core/SpscQueue.h"
+#include "audio/core/SnapshotPublisher.h"
+#include <atomic>
 
 #pragma warning(push)
 #pragma warning(disable: 4100) //Unreferenced formal parameter
@@ -11,6 +14,12 @@
 #pragma warning(pop)
 
 namespace Midi {
+/**
+ * The messages are received in the RtMidi callbacks, stamped with the arrival time and pushed in
+ * a lock-free queue per device. In each audio callback fillBuffer() spreads the messages received
+ * while the previous block was playing in the new block, so the plugins receive the notes with
+ * a constant latency of one block instead of a jitter of up to one block.
+ */
 class RtMidiDriver : public MidiDriver
 {
 public:
@@ -24,12 +33,57 @@ public:
     virtual bool hasInputDevices() const;
     virtual int getMaxInputDevices() const;
     virtual QString getInputDeviceName(int index) const;
-    virtual MidiBuffer getBuffer();
+    virtual void fillBuffer(MidiBuffer &buffer, int frames, int sampleRate);
 
     virtual void setInputDevicesStatus(QList<bool> statuses);
 
+    static const int QUEUE_CAPACITY = 2048;// events per device
+    static const int MAX_SYSEX_BYTES = 4096;// bigger SysEx messages are discarded
+
 private:
-    QList<RtMidiIn *> midiStreams;
+    static const int EVENT_BYTES = 28;// the SysEx messages are split in several events
+
+    struct Event
+    {
+        enum Type {
+            SHORT_MESSAGE,
+            SYSEX_PART,// more parts of the same SysEx message are coming
+            SYSEX_END
+        };
+
+        qint64 arrivalTime;// nanoseconds, see getTime()
+        quint8 type;
+        quint8 size;
+        quint8 bytes[EVENT_BYTES];
+    };
+
+    struct InputPort
+    {
+        explicit InputPort(int deviceIndex);
+        ~InputPort();
+
+        int deviceIndex;
+        RtMidiIn *stream;
+        Audio::SpscQueue<Event> queue;// RtMidi thread -> audio thread
+        std::atomic<quint64> droppedEvents;// queue full
+
+        // the SysEx message in assembly, used only by the audio thread
+        quint8 sysEx[MAX_SYSEX_BYTES];
+        int sysExSize;
+        bool sysExDiscarded;// too big or some part was dropped
+    };
+
+    QList<InputPort *> ports;
+    Audio::SnapshotPublisher<QList<InputPort *> > audioPorts;// used by the audio thread
+
+    qint64 lastFillTime;// audio thread
+
+    static void onMidiMessage(double deltaTime, std::vector<unsigned char> *message,
+                              void *userData);// RtMidi thread
+    static qint64 getTime();
+
+    static void readSysExPart(InputPort *port, const Event &event, qint32 frameOffset,
+                              MidiBuffer &buffer);// audio thread
 };
 }
 #endif // RTMIDIDRIVER_H
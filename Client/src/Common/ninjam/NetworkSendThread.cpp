@@ -0,0 +1,277 @@
+#include "NetworkSendThread.h"
+#include "log/Logging.h"
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+#if defined(Q_OS_WIN)
+    #include <winsock2.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <poll.h>
+    #include <cerrno>
+    #include <cstring>
+#endif
+
+using namespace Ninjam;
+
+NetworkSendThread::NetworkSendThread() :
+    headSegmentOffset(0),
+    stopRequested(false),
+    socketDescriptor(-1),
+    sending(false),
+    queuedSegments(0),
+    queuedBytes(0),
+    maxQueuedBytes(0),
+    sentBytes(0),
+    sendCalls(0),
+    sentSegments(0)
+{
+}
+
+NetworkSendThread::~NetworkSendThread()
+{
+    stopSending();
+}
+
+void NetworkSendThread::startSending(qintptr socketDescriptor)
+{
+    stopSending();
+
+    QMutexLocker locker(&mutex);
+    this->socketDescriptor = socketDescriptor;
+    stopRequested = false;
+    sentBytes.store(0);
+    sendCalls.store(0);
+    sentSegments.store(0);
+    maxQueuedBytes.store(0);
+    sending.store(true);
+    locker.unlock();
+
+    start(QThread::HighPriority);
+}
+
+void NetworkSendThread::stopSending(int drainTimeout)
+{
+    QMutexLocker locker(&mutex);
+    if (drainTimeout > 0 && sending.load()) {
+        QElapsedTimer timer;
+        timer.start();
+        while (!queue.isEmpty() && sending.load() && timer.elapsed() < drainTimeout)
+            queueDrained.wait(&mutex, drainTimeout - timer.elapsed());
+    }
+    stopRequested = true;
+    sending.store(false);
+    segmentsAvailable.wakeAll();
+    locker.unlock();
+
+    wait();// no more writes in the socket descriptor after this point
+
+    locker.relock();
+    clearQueue();
+    socketDescriptor = -1;
+}
+
+void NetworkSendThread::send(const QByteArray &message)
+{
+    QMutexLocker locker(&mutex);
+    if (!sending.load())
+        return;
+    enqueue(message);
+    segmentsAvailable.wakeOne();
+}
+
+void NetworkSendThread::send(const QByteArray &messageHeader, const QByteArray &messagePayload)
+{
+    QMutexLocker locker(&mutex);
+    if (!sending.load())
+        return;
+    enqueue(messageHeader);
+    enqueue(messagePayload);
+    segmentsAvailable.wakeOne();
+}
+
+void NetworkSendThread::enqueue(const QByteArray &segment)
+{
+    if (segment.isEmpty())
+        return;
+    queue.enqueue(segment);// implicitly shared, the bytes are not copied
+    queuedSegments.fetch_add(1);
+    qint64 bytes = queuedBytes.fetch_add(segment.size()) + segment.size();
+    if (bytes > maxQueuedBytes.load())
+        maxQueuedBytes.store(bytes);
+}
+
+void NetworkSendThread::consumeWrittenBytes(qint64 bytes)
+{
+    sentBytes.fetch_add(bytes);
+    queuedBytes.fetch_sub(bytes);
+    while (bytes > 0 && !queue.isEmpty()) {
+        qint64 remainingInHead = queue.head().size() - headSegmentOffset;
+        if (bytes < remainingInHead) {
+            headSegmentOffset += bytes;
+            return;
+        }
+        bytes -= remainingInHead;
+        queue.dequeue();
+        headSegmentOffset = 0;
+        queuedSegments.fetch_sub(1);
+        sentSegments.fetch_add(1);
+    }
+}
+
+void NetworkSendThread::clearQueue()
+{
+    queue.clear();
+    headSegmentOffset = 0;
+    queuedSegments.store(0);
+    queuedBytes.store(0);
+    queueDrained.wakeAll();
+}
+
+void NetworkSendThread::run()
+{
+    QByteArray segments[MAX_GATHERED_SEGMENTS];
+    QString error;
+    QMutexLocker locker(&mutex);
+    while (!stopRequested) {
+        if (queue.isEmpty()) {
+            queueDrained.wakeAll();
+            segmentsAvailable.wait(&mutex);
+            continue;
+        }
+
+        // the segments are copied (just a reference count increment) to write without the lock
+        int count = qMin(queue.size(), (int)MAX_GATHERED_SEGMENTS);
+        for (int i = 0; i < count; ++i)
+            segments[i] = queue.at(i);
+        int firstSegmentOffset = headSegmentOffset;
+        locker.unlock();
+
+        qint64 result = writeGathered(segments, count, firstSegmentOffset);
+        if (result == WRITE_WOULD_BLOCK && !waitUntilWritable())// back-pressure, the server or the network is slow
+            result = WRITE_ERROR;
+        if (result == WRITE_ERROR)
+            error = getLastErrorString();
+        for (int i = 0; i < count; ++i)
+            segments[i].clear();
+
+        locker.relock();
+        if (result > 0) {
+            sendCalls.fetch_add(1);
+            consumeWrittenBytes(result);
+        } else if (result == WRITE_ERROR) {
+            clearQueue();
+            sending.store(false);// the socket error is handled by the QTcpSocket owner
+            break;
+        }
+    }
+    queueDrained.wakeAll();
+    locker.unlock();
+
+    if (!error.isEmpty()) {
+        qCWarning(jtNinjamProtocol) << "Error writing in the socket:" << error;
+        emit sendError(error);
+    }
+}
+
+void NetworkSendThread::logMetrics() const
+{
+    int calls = sendCalls.load();
+    qCDebug(jtNinjamProtocol) << "Sent" << getSentBytes() << "bytes," << getSentSegments()
+                              << "segments in" << calls << "send calls ("
+                              << (calls > 0 ? (double)getSentSegments() / calls : 0.0)
+                              << "segments per call), max queued bytes:" << getMaxQueuedBytes();
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+#if defined(Q_OS_WIN)
+
+qint64 NetworkSendThread::writeGathered(const QByteArray *segments, int count,
+                                        int firstSegmentOffset)
+{
+    WSABUF buffers[MAX_GATHERED_SEGMENTS];
+    for (int i = 0; i < count; ++i) {
+        int offset = (i == 0) ? firstSegmentOffset : 0;
+        buffers[i].buf = const_cast<char *>(segments[i].constData()) + offset;
+        buffers[i].len = segments[i].size() - offset;
+    }
+    DWORD bytesSent = 0;
+    if (WSASend((SOCKET)socketDescriptor, buffers, count, &bytesSent, 0, NULL, NULL) == 0)
+        return bytesSent;
+    return WSAGetLastError() == WSAEWOULDBLOCK ? WRITE_WOULD_BLOCK : WRITE_ERROR;
+}
+
+bool NetworkSendThread::waitUntilWritable()
+{
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET((SOCKET)socketDescriptor, &writeSet);
+    fd_set errorSet;
+    FD_ZERO(&errorSet);
+    FD_SET((SOCKET)socketDescriptor, &errorSet);
+    timeval timeout = {0, WRITABLE_WAIT_TIMEOUT * 1000};
+    return select(0, NULL, &writeSet, &errorSet, &timeout) != SOCKET_ERROR
+           && !FD_ISSET((SOCKET)socketDescriptor, &errorSet);
+}
+
+QString NetworkSendThread::getLastErrorString() const
+{
+    return QString("WSA error %1").arg(WSAGetLastError());
+}
+
+#else
+
+qint64 NetworkSendThread::writeGathered(const QByteArray *segments, int count,
+                                        int firstSegmentOffset)
+{
+    iovec buffers[MAX_GATHERED_SEGMENTS];
+    for (int i = 0; i < count; ++i) {
+        int offset = (i == 0) ? firstSegmentOffset : 0;
+        buffers[i].iov_base = const_cast<char *>(segments[i].constData()) + offset;
+        buffers[i].iov_len = segments[i].size() - offset;
+    }
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;// SO_NOSIGPIPE is set by Qt in Mac
+#endif
+    ssize_t bytesSent;
+    do {
+        bytesSent = ::sendmsg((int)socketDescriptor, &message, flags);
+    } while (bytesSent < 0 && errno == EINTR);
+
+    if (bytesSent >= 0)
+        return bytesSent;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? WRITE_WOULD_BLOCK : WRITE_ERROR;
+}
+
+bool NetworkSendThread::waitUntilWritable()
+{
+    pollfd descriptor;
+    descriptor.fd = (int)socketDescriptor;
+    descriptor.events = POLLOUT;
+    descriptor.revents = 0;
+    int result;
+    errno = 0;
+    do {
+        result = ::poll(&descriptor, 1, WRITABLE_WAIT_TIMEOUT);
+    } while (result < 0 && errno == EINTR);
+    return result >= 0 && !(descriptor.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+QString NetworkSendThread::getLastErrorString() const
+{
+    if (errno == 0)
+        return QString("socket closed");
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+#endif
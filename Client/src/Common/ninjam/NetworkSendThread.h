@@ -0,0 +1,121 @@
+#ifndef NETWORK_SEND_THREAD_H
+#define NETWORK_SEND_THREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+namespace Ninjam {
+/**
+ * Write the client messages in the server socket.
+ *
+ * The messages are queued by any thread (the encoded intervals are queued by the encoding thread,
+ * so a GUI stall doesn't delay the uploads) and written in a dedicated thread. All queued segments
+ * are written in one gathered call (writev/WSASend), so the upload messages of several channels
+ * are sent in one syscall. When the socket buffer is full the thread sleeps until the socket is
+ * writable again, instead of retrying in a loop.
+ *
+ * The socket descriptor is owned by the QTcpSocket, which is still used to read. QTcpSocket::write()
+ * can't be used while the thread is sending, or the bytes of both would be interleaved.
+ */
+class NetworkSendThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    NetworkSendThread();
+    ~NetworkSendThread();
+
+    void startSending(qintptr socketDescriptor);
+
+    // stop and discard the queued messages, waiting up to 'drainTimeout' ms to send them
+    void stopSending(int drainTimeout = 0);
+
+    // thread safe, the segments of a message are queued together and not copied
+    void send(const QByteArray &message);
+    void send(const QByteArray &messageHeader, const QByteArray &messagePayload);
+
+    inline bool isSending() const
+    {
+        return sending.load();
+    }
+
+    // metrics, can be read from any thread
+    inline int getQueuedSegments() const
+    {
+        return queuedSegments.load();
+    }
+
+    inline qint64 getQueuedBytes() const// queued and not written in the socket yet
+    {
+        return queuedBytes.load();
+    }
+
+    inline qint64 getMaxQueuedBytes() const
+    {
+        return maxQueuedBytes.load();
+    }
+
+    inline qint64 getSentBytes() const
+    {
+        return sentBytes.load();
+    }
+
+    inline int getSendCalls() const
+    {
+        return sendCalls.load();
+    }
+
+    inline int getSentSegments() const
+    {
+        return sentSegments.load();
+    }
+
+    void logMetrics() const;
+
+signals:
+    void sendError(const QString &error);
+
+protected:
+    void run();
+
+private:
+    static const int MAX_GATHERED_SEGMENTS = 64;
+    static const int WRITABLE_WAIT_TIMEOUT = 100;// ms, stopSending() is checked when waking
+
+    enum WriteResult {
+        WRITE_WOULD_BLOCK = -1,
+        WRITE_ERROR = -2
+    };
+
+    QMutex mutex;
+    QWaitCondition segmentsAvailable;
+    QWaitCondition queueDrained;
+    QQueue<QByteArray> queue;
+    int headSegmentOffset;// bytes of the first queued segment already written
+    bool stopRequested;
+    qintptr socketDescriptor;
+
+    std::atomic<bool> sending;
+    std::atomic<int> queuedSegments;
+    std::atomic<qint64> queuedBytes;
+    std::atomic<qint64> maxQueuedBytes;
+    std::atomic<qint64> sentBytes;
+    std::atomic<int> sendCalls;
+    std::atomic<int> sentSegments;
+
+    void enqueue(const QByteArray &segment);// mutex locked
+    void consumeWrittenBytes(qint64 bytes);// mutex locked
+    void clearQueue();// mutex locked
+
+    qint64 writeGathered(const QByteArray *segments, int count, int firstSegmentOffset);
+    bool waitUntilWritable();
+    QString getLastErrorString() const;
+};
+}
+
+#endif // NETWORK_SEND_THREAD_H
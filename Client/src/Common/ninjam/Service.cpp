@@ -2,17 +2,18 @@
 #include "Server.h"
 #include "User.h"
 #include "protocol/ServerMessageParser.h"
+#include "protocol/MessageFraming.h"
 #include "protocol/ServerMessages.h"
 #include "protocol/ClientMessages.h"
 #include <algorithm>
 #include <QHostAddress>
 #include <QDateTime>
-#include <QDataStream>
 
 #include <QThread>
 #include <cassert>
 
 #include "log/Logging.h"
+#include "audio/IntervalCodec.h"
 
 using namespace Ninjam;
 
@@ -25,14 +26,15 @@ class Service::Download
 private:
     quint8 channelIndex;
     QString userFullName;
-    QString GUID;
-    QByteArray vorbisData;
+    QByteArray GUID;
+    int downloadedBytes;// the vorbis data is not stored, each chunk is decoded while downloading
     static int instances;
 public:
-    Download(QString userFullName, quint8 channelIndex, QString GUID) :
+    Download(QString userFullName, quint8 channelIndex, QByteArray GUID) :
         channelIndex(channelIndex),
         userFullName(userFullName),
-        GUID(GUID)
+        GUID(GUID),
+        downloadedBytes(0)
     {
         instances++;
         qCDebug(jtNinjamProtocol) << "Download constructor instances: " << instances;
@@ -49,9 +51,14 @@ public:
         qCDebug(jtNinjamProtocol) << "Download destructor instances: " << instances;
     }
 
-    inline void appendVorbisData(QByteArray data)
+    inline void addDownloadedBytes(int bytes)
     {
-        this->vorbisData.append(data);
+        this->downloadedBytes += bytes;
+    }
+
+    inline bool isFirstChunk() const
+    {
+        return downloadedBytes == 0;
     }
 
     inline quint8 getChannelIndex() const
@@ -64,21 +71,18 @@ public:
         return userFullName;
     }
 
-    inline QString getGUI() const
+    inline QByteArray getGUI() const
     {
         return GUID;
     }
-
-    inline QByteArray getVorbisData() const
-    {
-        return vorbisData;
-    }
 };
 int Ninjam::Service::Download::instances = 0;
 
 // ++++++++++++++++++++++++++++++++++++++++
 
 Service::Service() :
+    receiveBuffer(new ReceiveBuffer()),
+    messageParser(new ServerMessageParser()),
     lastSendTime(0),
     initialized(false)
 {
@@ -87,15 +91,27 @@ Service::Service() :
             SLOT(socketErrorSlot(QAbstractSocket::SocketError)));
     connect(&socket, SIGNAL(disconnected()), this, SLOT(socketDisconnectSlot()));
     connect(&socket, SIGNAL(connected()), this, SLOT(socketConnectedSlot()));
+
+    // the send thread must stop before the socket descriptor is closed
+    connect(&socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), this,
+            SLOT(socketStateChangedSlot(QAbstractSocket::SocketState)), Qt::DirectConnection);
+
+    // emitted in the send thread
+    connect(&sendThread, SIGNAL(sendError(QString)), this, SLOT(sendErrorSlot(QString)),
+            Qt::QueuedConnection);
 }
 
 Service::~Service()
 {
+    sendThread.stopSending();
     disconnect(&socket, SIGNAL(readyRead()), this, SLOT(socketReadSlot()));
     disconnect(&socket, SIGNAL(error(QAbstractSocket::SocketError)), this,
                SLOT(socketErrorSlot(QAbstractSocket::SocketError)));
     disconnect(&socket, SIGNAL(disconnected()), this, SLOT(socketDisconnectSlot()));
     disconnect(&socket, SIGNAL(connected()), this, SLOT(socketConnectedSlot()));
+    disconnect(&socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), this,
+               SLOT(socketStateChangedSlot(QAbstractSocket::SocketState)));
+    disconnect(&sendThread, SIGNAL(sendError(QString)), this, SLOT(sendErrorSlot(QString)));
 
     if (socket.isValid() && socket.isOpen())
         socket.disconnectFromHost();
@@ -107,56 +123,55 @@ void Service::sendAudioIntervalPart(QByteArray GUID, QByteArray encodedAudioBuff
     if (!initialized)
         return;
     ClientIntervalUploadWrite msg(GUID, encodedAudioBuffer, isLastPart);
-    sendMessageToServer(&msg);
+    QByteArray header;
+    msg.serializeHeaderTo(header);
+    sendThread.send(header, encodedAudioBuffer);// the encoded audio is not copied
+    lastSendTime = QDateTime::currentMSecsSinceEpoch();
 }
 
-void Service::sendAudioIntervalBegin(QByteArray GUID, quint8 channelIndex)
+void Service::sendAudioIntervalBegin(QByteArray GUID, quint8 channelIndex, const QString &userName,
+                                     Audio::IntervalCodec codec)
 {
     qCDebug(jtNinjamProtocol) << "sending audio interval begin";
     if (!initialized)
         return;
-    ClientUploadIntervalBegin msg(GUID, channelIndex, this->userName);
+    ClientUploadIntervalBegin msg(GUID, channelIndex, userName,
+                                  Audio::IntervalCodecs::getFourCC(codec));
     sendMessageToServer(&msg);
 }
 
 // +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void Service::socketReadSlot()
 {
-    if (socket.bytesAvailable() < 5) {
-        qCDebug(jtNinjamProtocol) << "not have enough bytes to read message header (5 bytes)";
-        return;
+    // the socket bytes are read directly in the receive buffer and parsed without copies
+    qint64 bytesAvailable = socket.bytesAvailable();
+    if (bytesAvailable > 0) {
+        char *writePointer = receiveBuffer->prepareWrite((int)bytesAvailable);
+        qint64 bytesRead = socket.read(writePointer, bytesAvailable);
+        if (bytesRead > 0)
+            receiveBuffer->commitWrite((int)bytesRead);
     }
 
-    qCDebug(jtNinjamProtocol) << "socket read slot";
-
-    QDataStream stream(&socket);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    static quint8 messageTypeCode;
-    static quint32 payloadLenght;
-    while (socket.bytesAvailable() >= 5) {// consume all messages
-        if (!lastMessageWasIncomplete) {
-            stream >> messageTypeCode >> payloadLenght;
-            qCDebug(jtNinjamProtocol) << "reading message from socket msgType:"
-                                      << messageTypeCode << " payloadLenght:" << payloadLenght;
-        }
-        if (socket.bytesAvailable() >= (int)payloadLenght) {// message payload is available to read
-            lastMessageWasIncomplete = false;
-            const Ninjam::ServerMessage &message
-                = ServerMessageParser::parse(static_cast<ServerMessageType>(messageTypeCode),
-                                             stream,
-                                             payloadLenght);
-            invokeMessageHandler(message);
-            if (needSendKeepAlive()) {
-                ClientKeepAlive clientKeepAliveMessage;
-                sendMessageToServer((ClientMessage *)&clientKeepAliveMessage);
-            }
-        } else {
-            qCDebug(jtNinjamProtocol) << "incomplete message!";
-            lastMessageWasIncomplete = true;
-            break;
+    MessageFrame frame;
+    ReceiveBuffer::FrameStatus status;
+    while ((status = receiveBuffer->nextFrame(frame)) == ReceiveBuffer::FRAME_AVAILABLE) {// consume all messages
+        qCDebug(jtNinjamProtocol) << "reading message from socket msgType:"
+                                  << (quint8)frame.type << " payloadLenght:" << frame.payloadSize;
+        const ServerMessage *message = messageParser->parse(frame);
+        if (message)
+            invokeMessageHandler(*message);
+        if (needSendKeepAlive()) {
+            ClientKeepAlive clientKeepAliveMessage;
+            sendMessageToServer((ClientMessage *)&clientKeepAliveMessage);
         }
     }
+
+    if (status == ReceiveBuffer::INVALID_FRAME) {
+        qCCritical(jtNinjamProtocol) << "Invalid message received, disconnecting!";
+        receiveBuffer->clear();
+        emit error(tr("Invalid data received from the server!"));
+        socket.disconnectFromHost();
+    }
 }
 
 void Service::socketErrorSlot(QAbstractSocket::SocketError e)
@@ -170,6 +185,25 @@ void Service::socketErrorSlot(QAbstractSocket::SocketError e)
 void Service::socketConnectedSlot()
 {
     qCDebug(jtNinjamProtocol) << "socket connected on " << socket.peerName();
+    sendThread.startSending(socket.socketDescriptor());
+}
+
+void Service::sendErrorSlot(const QString &errorMessage)
+{
+    // the send thread stopped, nothing more can be uploaded in this connection
+    if (socket.state() != QAbstractSocket::ConnectedState)
+        return;// already disconnected, the error was reported by the socket
+    qCCritical(jtNinjamProtocol) << "Error sending data to the server, disconnecting:" << errorMessage;
+    emit error(tr("Error sending data to the server: %1").arg(errorMessage));
+    socket.disconnectFromHost();
+}
+
+void Service::socketStateChangedSlot(QAbstractSocket::SocketState state)
+{
+    if (state != QAbstractSocket::ConnectedState && sendThread.isRunning()) {
+        sendThread.stopSending();
+        sendThread.logMetrics();
+    }
 }
 
 void Service::socketDisconnectSlot()
@@ -238,22 +272,8 @@ void Service::sendMessageToServer(ClientMessage *message)
 {
     QByteArray outBuffer;
     message->serializeTo(outBuffer);
-
-    int totalDataToSend = outBuffer.size();
-    int dataSended = 0;
-    int bytesWrited = -1;
-    do {
-        bytesWrited = socket.write(outBuffer.data() + dataSended, totalDataToSend - dataSended);
-        if (bytesWrited > 0)
-            dataSended += bytesWrited;
-    } while (dataSended < totalDataToSend && bytesWrited != -1);
-
-    if (bytesWrited > 0) {
-        socket.flush();
-        lastSendTime = QDateTime::currentMSecsSinceEpoch();
-    } else {
-        qCCritical(jtNinjamProtocol) << "Bytes not writed in socket!";
-    }
+    sendThread.send(outBuffer);
+    lastSendTime = QDateTime::currentMSecsSinceEpoch();
 
     if ((int)message->getPayload() + 5 != outBuffer.size()) {
         qCWarning(jtNinjamProtocol()) << "(int)message->getPayload() + 5: "
@@ -286,29 +306,32 @@ void Service::handle(const UserInfoChangeNotifyMessage &msg)
 
 void Service::handle(const DownloadIntervalBegin &msg)
 {
-    if (!msg.downloadShouldBeStopped() && msg.isValidOggDownload()) {
+    Audio::IntervalCodec codec = Audio::IntervalCodecs::fromFourCC(msg.getFourCC());
+    if (!msg.downloadShouldBeStopped() && msg.isValidOggDownload()
+        && Audio::IntervalCodecs::isSupported(codec)) {
         quint8 channelIndex = msg.getChannelIndex();
         QString userFullName = msg.getUserName();
-        QString GUID = msg.getGUID();
+        QByteArray GUID = msg.getGUID();
         downloads.insert(GUID, new Download(userFullName, channelIndex, GUID));
     }
 }
 
 void Service::handle(const DownloadIntervalWrite &msg)
 {
-    if (downloads.contains(msg.getGUID())) {
-        Download *download = downloads[msg.getGUID()];
-        download->appendVorbisData(msg.getEncodedAudioData());
+    QByteArray GUID = msg.getGUID();// a view of the received bytes, not copied
+    Download *download = downloads.value(GUID, nullptr);
+    if (download) {
         User *user = currentServer->getUser(download->getUserFullName());
-        if (msg.downloadIsComplete()) {
-            emit audioIntervalCompleted(*user, download->getChannelIndex(),
-                                        download->getVorbisData());
+        bool isFirstPart = download->isFirstChunk();
+        bool isLastPart = msg.downloadIsComplete();
+        // not copied, the receivers are called directly and copy the bytes to keep them
+        QByteArray encodedAudioData = msg.getEncodedAudioData();
+        download->addDownloadedBytes(encodedAudioData.size());
+        emit audioIntervalChunkDownloaded(*user, download->getChannelIndex(),
+                                          encodedAudioData, isFirstPart, isLastPart);
+        if (isLastPart) {
+            downloads.remove(GUID);
             delete download;
-            downloads.remove(msg.getGUID());
-        } else {
-            emit audioIntervalDownloading(*user,
-                                          download->getChannelIndex(),
-                                          msg.getEncodedAudioData().size());
         }
     } else {
         qCritical("GUID is not in map!");
@@ -362,7 +385,8 @@ void Service::handle(const ServerAuthReplyMessage &msg)
 void Service::startServerConnection(QString serverIp, int serverPort, QString userName,
                                     QStringList channels, QString password)
 {
-    initialized = lastMessageWasIncomplete = false;
+    initialized = false;
+    receiveBuffer->clear();
     this->userName = userName;
     this->password = password;
     this->channels = channels;
@@ -375,6 +399,10 @@ void Service::startServerConnection(QString serverIp, int serverPort, QString us
 void Service::disconnectFromServer(bool emitDisconnectedSignal)
 {
     qCDebug(jtNinjamProtocol) << "disconnecting from " << socket.peerName();
+    if (sendThread.isRunning()) {
+        sendThread.stopSending(SEND_DRAIN_TIMEOUT);// try send the last interval parts
+        sendThread.logMetrics();
+    }
     if (socket.isOpen()) {
         if (!emitDisconnectedSignal)
             socket.blockSignals(true); // avoid generate events when disconnecting/exiting
@@ -3,10 +3,13 @@
 
 #include <QTcpSocket>
 #include <memory>
+#include <atomic>
 #include <QLoggingCategory>
 
 #include "ninjam/User.h"
 #include "ninjam/UserChannel.h"
+#include "ninjam/NetworkSendThread.h"
+#include "audio/IntervalCodec.h"
 
 namespace Ninjam {
 class PublicServersParser;
@@ -14,7 +17,7 @@ class Server;
 class MixedPublicServersParser;
 
 class ServerMessageParser;
-class ServerMessageParserFactory;
+class ReceiveBuffer;
 
 class ServerMessage;
 class ServerKeepAliveMessage;
@@ -44,9 +47,11 @@ public:
 
     void sendChatMessageToServer(QString message);
 
-    // audio interval upload
+    // audio interval upload, these functions can be called from any thread. The user name is
+    // passed by the caller, 'userName' is changed by the GUI thread.
     void sendAudioIntervalPart(QByteArray GUID, QByteArray encodedAudioBuffer, bool isLastPart);
-    void sendAudioIntervalBegin(QByteArray GUID, quint8 channelIndex);
+    void sendAudioIntervalBegin(QByteArray GUID, quint8 channelIndex, const QString &userName,
+                                Audio::IntervalCodec codec = Audio::IntervalCodec::VORBIS);
 
     void sendNewChannelsListToServer(QStringList channelsNames);
     void sendRemovedChannelIndex(int removedChannelIndex);
@@ -62,6 +67,27 @@ public:
     void voteToChangeBPM(int newBPM);
     void voteToChangeBPI(int newBPI);
 
+    // upload queue metrics, can be read from any thread
+    inline int getSendQueueDepth() const// queued message segments
+    {
+        return sendThread.getQueuedSegments();
+    }
+
+    inline qint64 getSendBytesInFlight() const// queued and not written in the socket yet
+    {
+        return sendThread.getQueuedBytes();
+    }
+
+    inline qint64 getMaxSendBytesInFlight() const// since connected
+    {
+        return sendThread.getMaxQueuedBytes();
+    }
+
+    inline qint64 getSentBytes() const// since connected
+    {
+        return sendThread.getSentBytes();
+    }
+
     static inline QStringList getBotNamesList()
     {
         return botNames;
@@ -74,8 +100,9 @@ signals:
     void userCountMessageReceived(int users, int maxUsers);
     void serverBpiChanged(short currentBpi, short lastBpi);
     void serverBpmChanged(short currentBpm);
-    void audioIntervalCompleted(Ninjam::User user, int channelIndex, QByteArray encodedAudioData);
-    void audioIntervalDownloading(Ninjam::User, int channelIndex, int bytesDownloaded);
+    // the chunk references the socket receive buffer, use a direct connection and copy the bytes to
+    // keep them (the interval decoders copy the bytes in IntervalDecoder::addInput())
+    void audioIntervalChunkDownloaded(Ninjam::User user, int channelIndex, QByteArray encodedAudioChunk, bool isFirstPart, bool isLastPart);
     void disconnectedFromServer(const Ninjam::Server &server);
     void connectedInServer(const Ninjam::Server &server);
     void chatMessageReceived(Ninjam::User sender, QString message);
@@ -87,16 +114,19 @@ signals:
 private:
 
     static const long DEFAULT_KEEP_ALIVE_PERIOD = 3000;
+    static const int SEND_DRAIN_TIMEOUT = 500;// ms waiting to send the queued messages when disconnecting
     static std::unique_ptr<PublicServersParser> publicServersParser; // TODO use QScopedPointer ?
 
     QTcpSocket socket;
-    QByteArray byteArray;
+    NetworkSendThread sendThread;
+    std::unique_ptr<ReceiveBuffer> receiveBuffer;
+    std::unique_ptr<ServerMessageParser> messageParser;
 
     static const QStringList botNames;
     static QStringList buildBotNamesList();
 
     // GUID, AudioInterval
-    long lastSendTime;// time stamp of last send
+    std::atomic<qint64> lastSendTime;// time stamp of last send
     long serverKeepAlivePeriod;
     QString serverLicence;
 
@@ -105,7 +135,7 @@ private:
     QString newUserName;// name received from server when connected
 
     std::unique_ptr<Server> currentServer;
-    bool initialized;
+    std::atomic<bool> initialized;
     QString userName;
     QString password;
     QStringList channels;// channels names
@@ -131,17 +161,17 @@ private:
 
     class Download;
     // using GUID as key
-    QMap<QString, Download *> downloads;
+    QMap<QByteArray, Download *> downloads;
 
     bool needSendKeepAlive() const;
 
-    bool lastMessageWasIncomplete;
-
 private slots:
     void socketReadSlot();
     void socketErrorSlot(QAbstractSocket::SocketError error);
     void socketDisconnectSlot();
     void socketConnectedSlot();
+    void socketStateChangedSlot(QAbstractSocket::SocketState state);
+    void sendErrorSlot(const QString &errorMessage);
 };
 }// namespace
 
@@ -201,18 +201,16 @@ void ChatMessage::printDebug(QDebug dbg) const{
 
 //+++++++++++++++++++++++++
 
-ClientUploadIntervalBegin::ClientUploadIntervalBegin(QByteArray GUID, quint8 channelIndex, QString userName)
+ClientUploadIntervalBegin::ClientUploadIntervalBegin(QByteArray GUID, quint8 channelIndex, QString userName, const QByteArray &fourCC)
     :ClientMessage( 0x83, 16 + 4 + 4 + 1 + userName.size()),
       GUID(GUID),
       estimatedSize(0),
-      //fourCC{'O', 'G', 'G', 'v'},
       channelIndex(channelIndex),
       userName(userName)
 {
-	fourCC[0] = 'O';
-	fourCC[1] = 'G';
-	fourCC[2] = 'G';
-	fourCC[3] = 'v';
+    for (int i = 0; i < 4; ++i) {
+        this->fourCC[i] = i < fourCC.size() ? fourCC.at(i) : ' ';
+    }
 }
 
 void ClientUploadIntervalBegin::serializeTo(QByteArray &buffer){
@@ -247,6 +245,13 @@ ClientIntervalUploadWrite::ClientIntervalUploadWrite(QByteArray GUID, QByteArray
 }
 
 void ClientIntervalUploadWrite::serializeTo(QByteArray &buffer){
+    serializeHeaderTo(buffer);
+    buffer.append(encodedAudioBuffer);
+
+    assert(buffer.size() == (int)(payload + 5));
+}
+
+void ClientIntervalUploadWrite::serializeHeaderTo(QByteArray &buffer){
     QDataStream stream(&buffer, QIODevice::WriteOnly);
     stream.setByteOrder(QDataStream::LittleEndian);
     stream << msgType;
@@ -255,9 +260,6 @@ void ClientIntervalUploadWrite::serializeTo(QByteArray &buffer){
     stream.writeRawData(GUID.data(), 16);
     quint8 intervalCompleted = isLastPart ? (quint8) 1 : (quint8) 0;//If the Flag field bit 0 is set then the upload is complete.
     stream << intervalCompleted;
-    stream.writeRawData( encodedAudioBuffer.data(), encodedAudioBuffer.size() );
-
-    assert(buffer.size() == (int)(payload + 5));
 }
 
 
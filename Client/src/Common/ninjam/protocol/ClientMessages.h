@@ -118,7 +118,8 @@ private:
     quint8 channelIndex;
     QString userName;
 public:
-    ClientUploadIntervalBegin(QByteArray GUID, quint8 channelIndex, QString userName);
+    ClientUploadIntervalBegin(QByteArray GUID, quint8 channelIndex, QString userName,
+                              const QByteArray &fourCC = QByteArray("OGGv"));
 
     static QByteArray newGUID();
 
@@ -141,6 +142,7 @@ private:
 public:
     ClientIntervalUploadWrite(QByteArray GUID, QByteArray encodedAudioBuffer, bool isLastPart);
     virtual void serializeTo(QByteArray &buffer);
+    void serializeHeaderTo(QByteArray &buffer);// message header, GUID and flags, without the audio
     virtual void printDebug(QDebug dbg) const;
 };
 
@@ -0,0 +1,126 @@
+#include "MessageFraming.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace Ninjam;
+
+PayloadReader::PayloadReader(const char *data, quint32 size) :
+    data(reinterpret_cast<const uchar *>(data)),
+    size(size),
+    position(0),
+    error(false)
+{
+}
+
+quint8 PayloadReader::readUInt8()
+{
+    const char *bytes = readBytes(1);
+    return bytes ? (quint8)bytes[0] : 0;
+}
+
+quint16 PayloadReader::readUInt16()
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(readBytes(2));
+    return bytes ? (quint16)(bytes[0] | (bytes[1] << 8)) : 0;
+}
+
+quint32 PayloadReader::readUInt32()
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(readBytes(4));
+    if (!bytes)
+        return 0;
+    return (quint32)bytes[0] | ((quint32)bytes[1] << 8) | ((quint32)bytes[2] << 16)
+           | ((quint32)bytes[3] << 24);
+}
+
+const char *PayloadReader::readBytes(quint32 count)
+{
+    if (count > getRemainingBytes()) {
+        error = true;
+        position = size;
+        return nullptr;
+    }
+    const char *bytes = reinterpret_cast<const char *>(data + position);
+    position += count;
+    return bytes;
+}
+
+QString PayloadReader::readString()
+{
+    if (atEnd())
+        return QString();// optional strings are not sent in the payload end
+    const char *begin = reinterpret_cast<const char *>(data + position);
+    quint32 remaining = getRemainingBytes();
+    const void *terminator = std::memchr(begin, '\0', remaining);
+    quint32 lenght = terminator ? (quint32)(static_cast<const char *>(terminator) - begin) : remaining;
+    position += terminator ? lenght + 1 : lenght;// skip the NUL
+    return QString::fromUtf8(begin, lenght);
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+ReceiveBuffer::ReceiveBuffer() :
+    data(nullptr),
+    capacity(0),
+    readPosition(0),
+    writePosition(0)
+{
+}
+
+ReceiveBuffer::~ReceiveBuffer()
+{
+    std::free(data);
+}
+
+void ReceiveBuffer::clear()
+{
+    readPosition = writePosition = 0;
+}
+
+char *ReceiveBuffer::prepareWrite(int bytes)
+{
+    if (writePosition + bytes > capacity) {
+        // reclaim the consumed bytes, only the unread bytes (normally an incomplete message) are moved
+        int unreadBytes = getUnreadBytes();
+        if (readPosition > 0) {
+            std::memmove(data, data + readPosition, unreadBytes);
+            readPosition = 0;
+            writePosition = unreadBytes;
+        }
+        if (writePosition + bytes > capacity) {
+            int newCapacity = qMax(capacity * 2, qMax(writePosition + bytes, 16 * 1024));
+            char *newData = static_cast<char *>(std::realloc(data, newCapacity));
+            if (!newData)
+                throw std::bad_alloc();
+            data = newData;
+            capacity = newCapacity;
+        }
+    }
+    return data + writePosition;
+}
+
+void ReceiveBuffer::commitWrite(int bytes)
+{
+    writePosition = qMin(writePosition + bytes, capacity);
+}
+
+ReceiveBuffer::FrameStatus ReceiveBuffer::nextFrame(MessageFrame &frame)
+{
+    if (getUnreadBytes() < (int)HEADER_SIZE)
+        return INCOMPLETE_FRAME;
+
+    const uchar *header = reinterpret_cast<const uchar *>(data + readPosition);
+    quint32 payloadSize = (quint32)header[1] | ((quint32)header[2] << 8)
+                          | ((quint32)header[3] << 16) | ((quint32)header[4] << 24);
+    if (payloadSize > MAX_PAYLOAD_SIZE)
+        return INVALID_FRAME;
+    if ((quint32)getUnreadBytes() < HEADER_SIZE + payloadSize)
+        return INCOMPLETE_FRAME;
+
+    frame.type = static_cast<ServerMessageType>(header[0]);
+    frame.payload = data + readPosition + HEADER_SIZE;
+    frame.payloadSize = payloadSize;
+    readPosition += HEADER_SIZE + payloadSize;
+    return FRAME_AVAILABLE;
+}
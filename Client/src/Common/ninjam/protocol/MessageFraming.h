@@ -0,0 +1,115 @@
+#ifndef MESSAGE_FRAMING_H
+#define MESSAGE_FRAMING_H
+
+#include <QtGlobal>
+#include <QString>
+#include <cstdint>
+
+namespace Ninjam {
+enum class ServerMessageType : std::uint8_t;
+
+/**
+ * A complete message in the receive buffer. The payload is not copied, it is valid until the
+ * next ReceiveBuffer::prepareWrite() or ReceiveBuffer::clear().
+ */
+struct MessageFrame
+{
+    ServerMessageType type;
+    const char *payload;
+    quint32 payloadSize;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+/**
+ * Read the little endian fields of a message payload. Reading past the payload end returns
+ * zeros and sets the error flag, so malformed messages never read outside the payload.
+ */
+class PayloadReader
+{
+public:
+    PayloadReader(const char *data, quint32 size);
+
+    quint8 readUInt8();
+    quint16 readUInt16();
+    quint32 readUInt32();
+    const char *readBytes(quint32 count);// pointer to the payload bytes, nullptr if there are not enough bytes
+    QString readString();// NUL-terminated UTF-8 string, the last string can be not terminated or missing
+
+    inline quint32 getRemainingBytes() const
+    {
+        return size - position;
+    }
+
+    inline bool atEnd() const
+    {
+        return position >= size;
+    }
+
+    inline bool hasError() const
+    {
+        return error;
+    }
+
+private:
+    const uchar *data;
+    quint32 size;
+    quint32 position;
+    bool error;
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+/**
+ * Growable buffer receiving the bytes from the socket and splitting them in messages.
+ *
+ * Every NINJAM message is a 5 bytes header (type and payload size) followed by the payload.
+ * The socket bytes are written directly in the buffer (prepareWrite() + commitWrite()) and the
+ * complete messages are returned by nextFrame() as views of the buffer. The consumed bytes are
+ * reclaimed in prepareWrite() moving the incomplete message to the buffer start, so a frame is
+ * always contiguous.
+ */
+class ReceiveBuffer
+{
+public:
+    enum FrameStatus {
+        FRAME_AVAILABLE,
+        INCOMPLETE_FRAME,// waiting for more bytes
+        INVALID_FRAME// the payload size is bigger than MAX_PAYLOAD_SIZE, the stream is not valid
+    };
+
+    static const quint32 HEADER_SIZE = 5;
+    static const quint32 MAX_PAYLOAD_SIZE = 1 << 20;
+
+    ReceiveBuffer();
+    ~ReceiveBuffer();
+
+    char *prepareWrite(int bytes);// return a pointer with at least 'bytes' free bytes
+    void commitWrite(int bytes);// the bytes were written in the pointer returned by prepareWrite()
+
+    FrameStatus nextFrame(MessageFrame &frame);
+
+    inline int getUnreadBytes() const
+    {
+        return writePosition - readPosition;
+    }
+
+    inline int getCapacity() const
+    {
+        return capacity;
+    }
+
+    void clear();
+
+private:
+    char *data;
+    int capacity;
+    int readPosition;
+    int writePosition;
+
+    ReceiveBuffer(const ReceiveBuffer &);
+    ReceiveBuffer &operator=(const ReceiveBuffer &);
+};
+}
+
+#endif // MESSAGE_FRAMING_H
@@ -1,124 +1,144 @@
 #include "ServerMessageParser.h"
-#include "ServerMessages.h"
-#include "../User.h"
-#include <QDataStream>
-#include <QSharedPointer>
-#include <QDebug>
+#include "../UserChannel.h"
+#include "log/Logging.h"
 
 using namespace Ninjam;
 
+ServerMessageParser::ServerMessageParser()
+{
+}
 
-QString ServerMessageParser::extractString(QDataStream &stream){
-    quint8 byte;
-    QByteArray byteArray;
-    while(!stream.atEnd()){
-        stream >> byte;
-        if(byte == '\0'){
-            break;
-        }
-        byteArray.append(byte);
+const ServerMessage *ServerMessageParser::parse(const MessageFrame &frame)
+{
+    PayloadReader reader(frame.payload, frame.payloadSize);
+    const ServerMessage *message = nullptr;
+    switch (frame.type) {
+    case ServerMessageType::AUTH_CHALLENGE:
+        message = parseAuthChallenge(reader);
+        break;
+    case ServerMessageType::AUTH_REPLY:
+        message = parseAuthReply(reader);
+        break;
+    case ServerMessageType::SERVER_CONFIG_CHANGE_NOTIFY:
+        message = parseServerConfigChangeNotify(reader);
+        break;
+    case ServerMessageType::USER_INFO_CHANGE_NOTIFY:
+        message = parseUserInfoChangeNotify(reader);
+        break;
+    case ServerMessageType::CHAT_MESSAGE:
+        message = parseChatMessage(reader);
+        break;
+    case ServerMessageType::KEEP_ALIVE:
+        message = &keepAlive;
+        break;
+    case ServerMessageType::DOWNLOAD_INTERVAL_BEGIN:
+        message = parseDownloadIntervalBegin(reader);
+        break;
+    case ServerMessageType::DOWNLOAD_INTERVAL_WRITE:
+        message = parseDownloadIntervalWrite(reader);
+        break;
+    default:
+        qCWarning(jtNinjamProtocol) << "Unknown message type:" << (quint8)frame.type;
+        return nullptr;
     }
-    return QString::fromUtf8(byteArray.data(), byteArray.size());
-}
-//+++++++++++++++++++++++++++++++++++++++++
-const ServerMessage& ServerMessageParser::parse(ServerMessageType msgType, QDataStream &stream, quint32 payloadLenght){
-    //const ServerMessage* message = nullptr;
-    switch (msgType) {
-    case ServerMessageType::AUTH_CHALLENGE: return parseAuthChallenge(stream, payloadLenght);
-    case ServerMessageType::AUTH_REPLY: return parseAuthReply(stream, payloadLenght);
-    case ServerMessageType::USER_INFO_CHANGE_NOTIFY: return parseUserInfoChangeNotify(stream, payloadLenght);
-    case ServerMessageType::SERVER_CONFIG_CHANGE_NOTIFY: return parseServerConfigChangeNotify(stream, payloadLenght);
-    case ServerMessageType::CHAT_MESSAGE: return parseChatMessage(stream, payloadLenght);
-    case ServerMessageType::KEEP_ALIVE: return parseKeepAlive(stream, payloadLenght);
-    case ServerMessageType::DOWNLOAD_INTERVAL_BEGIN: return parseDownloadIntervalBegin(stream, payloadLenght);
-    case ServerMessageType::DOWNLOAD_INTERVAL_WRITE: return parseDownloadIntervalWrite(stream, payloadLenght);
+
+    if (reader.hasError()) {
+        qCWarning(jtNinjamProtocol) << "Malformed message, type:" << (quint8)frame.type
+                                    << "payload size:" << frame.payloadSize;
+        return nullptr;
     }
-    throw std::runtime_error("invalid message type!");
+    return message;
 }
 
-const ServerMessage& ServerMessageParser::parseAuthChallenge(QDataStream &stream, quint32 /*payloadLenght*/){
-    quint8 challenge[8];
-    for (int i = 0; i < 8; ++i) {
-        stream >> challenge[i];
-    }
-    quint32 serverCapabilities;
-    stream >> serverCapabilities;
+/*
+ Offset Type        Field
+ 0x0    uint8_t[8]  Challenge
+ 0x8    uint32_t    Server Capabilities
+ 0xc    uint32_t    Protocol Version
+ 0x10   ...         License Agreement (NUL-terminated)
+ */
+const ServerMessage *ServerMessageParser::parseAuthChallenge(PayloadReader &reader)
+{
+    const quint8 *challenge = reinterpret_cast<const quint8 *>(reader.readBytes(8));
+    quint32 serverCapabilities = reader.readUInt32();
+    quint32 protocolVersion = reader.readUInt32();
+    if (reader.hasError())
+        return nullptr;
 
-    //If the Server Capabilities field has bit 0 set then the License Agreement is present.
-    bool serverHasLicenceAgreement = serverCapabilities & 0xFFFFFFFF;
+    // If the Server Capabilities field has bit 0 set then the License Agreement is present.
+    bool serverHasLicenceAgreement = serverCapabilities & 1;
 
-    //The Server Capabilities field bits 8-15 contains the client keepalive interval in seconds. The client sends a Keepalive message if it has sent no messages for the interval.
+    // The Server Capabilities field bits 8-15 contains the client keepalive interval in seconds.
     quint8 serverKeepAlivePeriod = quint8(serverCapabilities >> 8);
 
-    quint32 protocolVersion;
-    stream >> protocolVersion;
-    Q_ASSERT(protocolVersion == 0x00020000);
+    QString licenceAgreement;
+    if (serverHasLicenceAgreement)
+        licenceAgreement = reader.readString();
 
-    QString licenceAgreement = "";
-    if (serverHasLicenceAgreement) {
-        licenceAgreement = ServerMessageParser::extractString(stream);
-    }
-    static ServerAuthChallengeMessage msg;
-    msg.set(serverKeepAlivePeriod, challenge, licenceAgreement, protocolVersion);
-    return msg;
+    authChallenge.set(serverKeepAlivePeriod, challenge, licenceAgreement, protocolVersion);
+    return &authChallenge;
 }
-//++++++++++++++++++++++++++++++++++++++++++++++++++
-const ServerMessage& ServerMessageParser::parseAuthReply(QDataStream &stream, quint32 /*payloadLenght*/)
+
+/*
+ Offset Type        Field
+ 0x0    uint8_t     Flag
+ 0x1    ...         Error Message or the new user name (NUL-terminated)
+ a+0x0  uint8_t     Maximum Channels
+ */
+const ServerMessage *ServerMessageParser::parseAuthReply(PayloadReader &reader)
 {
-    quint8 flag;
-    quint8 maxChannels;
-    stream >> flag;
-
-    QString serverMessage = ServerMessageParser::extractString(stream);
-    //acho que o extractString não movimenta o cursos interno do stream, por isso não está lendo o maxChannels corretamente
-    stream >> maxChannels;
-    static ServerAuthReplyMessage msg;
-    msg.set(flag, maxChannels, serverMessage);
-    return msg;
-}
-//++++++++++++++++++++++++++++++++++++++=
-const ServerMessage& ServerMessageParser::parseServerConfigChangeNotify(QDataStream &stream, quint32 /*payloadLenght*/){
-    quint16 bpm;
-    quint16 bpi;
-    stream >> bpm;
-    stream >> bpi;
-    static ServerConfigChangeNotifyMessage msg;
-    msg.set(bpm, bpi);
-    return msg;
+    quint8 flag = reader.readUInt8();
+    QString serverMessage = reader.readString();
+    quint8 maxChannels = reader.atEnd() ? 0 : reader.readUInt8();// not sent in some errors
+    authReply.set(flag, maxChannels, serverMessage);
+    return &authReply;
 }
 
+/*
+ Offset Type        Field
+ 0x0    uint16_t    BPM
+ 0x2    uint16_t    BPI
+ */
+const ServerMessage *ServerMessageParser::parseServerConfigChangeNotify(PayloadReader &reader)
+{
+    quint16 bpm = reader.readUInt16();
+    quint16 bpi = reader.readUInt16();
+    configChangeNotify.set(bpm, bpi);
+    return &configChangeNotify;
+}
 
-const ServerMessage& ServerMessageParser::parseUserInfoChangeNotify(QDataStream &stream, quint32 payloadLenght)
+/*
+ The payload is a list of channels:
+
+ Offset Type        Field
+ 0x0    uint8_t     Active
+ 0x1    uint8_t     Channel Index
+ 0x2    int16_t     Volume
+ 0x4    int8_t      Pan
+ 0x5    uint8_t     Flags
+ 0x6    ...         Username (NUL-terminated)
+ a+0x0  ...         Channel Name (NUL-terminated)
+ */
+const ServerMessage *ServerMessageParser::parseUserInfoChangeNotify(PayloadReader &reader)
 {
-    static UserInfoChangeNotifyMessage msg;
-    if (payloadLenght <= 0) {//no users
-        msg.set(QMap<QString, QList<UserChannel>>());//empy user list
-        return  msg;
-    }
-    QMap<QString, QList<UserChannel>> allUsersChannels;
-    unsigned int bytesConsumed = 0;
-    while (bytesConsumed < payloadLenght) {
-        quint8 active;
-        quint8 channelIndex;
-        quint16 volume;
-        quint8 pan;
-        quint8 flags;
-        stream >> active >> channelIndex >> volume >> pan >> flags;
-        bytesConsumed += 6;
-        QString userFullName = ServerMessageParser::extractString(stream);
-        bytesConsumed += userFullName.size() + 1;
-        QList<UserChannel> & userChannels = allUsersChannels[userFullName];//use the reference to change the same instance inside of QMap
-        QString channelName = ServerMessageParser::extractString(stream);
-        bytesConsumed += channelName.size() + 1;
-        //qDebug() << userFullName << "active:" << active << "volume:" << volume << "pan:" << pan << "flags: "<< flags;
-        userChannels.append(UserChannel(userFullName, channelName, (bool)active, channelIndex, volume, pan, flags));
+    QMap<QString, QList<UserChannel> > allUsersChannels;
+    while (!reader.atEnd() && !reader.hasError()) {
+        quint8 active = reader.readUInt8();
+        quint8 channelIndex = reader.readUInt8();
+        quint16 volume = reader.readUInt16();
+        quint8 pan = reader.readUInt8();
+        quint8 flags = reader.readUInt8();
+        QString userFullName = reader.readString();
+        QString channelName = reader.readString();
+        if (reader.hasError())
+            return nullptr;
+        allUsersChannels[userFullName].append(UserChannel(userFullName, channelName, (bool)active,
+                                                          channelIndex, volume, pan, flags));
     }
-
-    msg.set(allUsersChannels);
-    return msg;
+    userInfoChangeNotify.set(allUsersChannels);
+    return &userInfoChangeNotify;
 }
 
-//+++++++++++++++++++
 /*
  Offset Type Field
  0x0    ...  Command (NUL-terminated)
@@ -126,108 +146,56 @@ const ServerMessage& ServerMessageParser::parseUserInfoChangeNotify(QDataStream
  b+0x0  ...  Argument 2 (NUL-terminated)
  c+0x0  ...  Argument 3 (NUL-terminated)
  d+0x0  ...  Argument 4 (NUL-terminated)
-
- The server-to-client commands are:
- MSG <username> <text> -- a broadcast message
- PRIVMSG <username> <text> -- a private message
- TOPIC <username> <text> -- server topic change
- JOIN <username> -- user enters server
- PART <username> -- user leaves server
- USERCOUNT <users> <maxusers> -- server status
  */
-
-int getStringSize(char* data, int maxLenght){
-    int p = 0;
-    for (; p < maxLenght-1; ++p) {
-        if(data[p] == '\0'){
-            break;
-        }
-    }
-    return p + 1;
-}
-
-const ServerMessage& ServerMessageParser::parseChatMessage(QDataStream &stream, const quint32 payloadLenght){
-    static char data[4096];
-    stream.readRawData(data, qMin((int)payloadLenght, 4096));
-    quint32 consumedBytes = 0;
-
-    int commandStringSize = getStringSize(data, payloadLenght);
-    QString command = QString::fromUtf8(data, commandStringSize-1);//remove the NULL terminator (2 bytes - utf-8)
-    consumedBytes += commandStringSize;
-
-
-    int parsedArgs = 0;
-    QStringList arguments;
-    while(consumedBytes < payloadLenght && parsedArgs < 4){
-        int argStringSize = getStringSize(data + consumedBytes, payloadLenght - consumedBytes);
-        QString arg = QString::fromUtf8(data + consumedBytes, argStringSize-1);
-        arguments.append(arg);
-        consumedBytes += argStringSize;
-        parsedArgs++;
-    }
-
-    static ServerChatMessage msg;
-    msg.set(command, arguments);
-    return msg;
-}
-
-//+++++++++++++++++++++++++++=
-
-const ServerMessage& ServerMessageParser::parseKeepAlive(QDataStream &/*stream*/, quint32 /*payloadLenght*/)
+const ServerMessage *ServerMessageParser::parseChatMessage(PayloadReader &reader)
 {
-    //tinha um bug aqui. Eu estava retornando uma instância estática da mensagem, só que o método
-    //que chama o parse deleta a mensagem depois de processá-la. Ou seja, a instância estática era
-    //destruída e dava um SIGSEV logo em seguida.
+    static const int MAX_ARGUMENTS = 4;
+    QString command = reader.readString();
+    QStringList arguments;
+    while (!reader.atEnd() && arguments.size() < MAX_ARGUMENTS)
+        arguments.append(reader.readString());
 
-    static  ServerKeepAliveMessage msg;
-    return msg;
+    chatMessage.set(command, arguments);
+    return &chatMessage;
 }
-//++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-const ServerMessage& ServerMessageParser::parseDownloadIntervalBegin(QDataStream &stream, quint32 /*payload*/)
+/*
+ Offset Type        Field
+ 0x0    uint8_t[16] GUID (binary)
+ 0x10   uint32_t    Estimated Size
+ 0x14   uint8_t[4]  FourCC
+ 0x18   uint8_t     Channel Index
+ 0x19   ...         Username (NUL-terminated)
+ */
+const ServerMessage *ServerMessageParser::parseDownloadIntervalBegin(PayloadReader &reader)
 {
-    QByteArray GUID;
-    quint8 byte;
-    for (int i = 0; i < 16; ++i) {
-        stream >> byte;//será que é suficiente?
-        GUID.append(byte);
-    }
-    quint32 estimatedSize;
-    stream >> estimatedSize;
-    quint8 fourCC[4];
-    for (int i = 0; i < 4; ++i) {
-        stream >> fourCC[i];
-    }
-    quint8 channelIndex;
-    stream >> channelIndex;
-    QString userName = ServerMessageParser::extractString(stream);
-
-    static DownloadIntervalBegin msg;
-    msg.set(estimatedSize, channelIndex, userName, fourCC, GUID);
-    return msg;
+    const char *GUID = reader.readBytes(DownloadIntervalBegin::GUID_SIZE);
+    quint32 estimatedSize = reader.readUInt32();
+    const quint8 *fourCC = reinterpret_cast<const quint8 *>(reader.readBytes(4));
+    quint8 channelIndex = reader.readUInt8();
+    if (reader.hasError())
+        return nullptr;
+    QString userName = reader.readString();
+
+    downloadIntervalBegin.set(estimatedSize, channelIndex, userName, fourCC, GUID);
+    return &downloadIntervalBegin;
 }
 
-
-const ServerMessage &ServerMessageParser::parseDownloadIntervalWrite(QDataStream &stream, quint32 payloadLenght)
+/*
+ Offset Type        Field
+ 0x0    uint8_t[16] GUID (binary)
+ 0x10   uint8_t     Flags
+ 0x11   ...         Audio Data
+ */
+const ServerMessage *ServerMessageParser::parseDownloadIntervalWrite(PayloadReader &reader)
 {
-    QByteArray GUID;
-    quint8 byte;
-    for (int i = 0; i < 16; ++i) {
-        stream >> byte;//será que é suficiente?
-        GUID.append(byte);
-    }
-    quint8 flags;
-    stream >> flags;
-
-    quint32 lenght = payloadLenght - 17;
-    QByteArray encodedData;
-    encodedData.resize(lenght);
-    int bytesReaded = stream.readRawData(encodedData.data(), lenght);
-    if(bytesReaded <= 0){
-        qWarning() << "ERRO na leitura do audio codificado! "  << bytesReaded;
-    }
-    static DownloadIntervalWrite msg;
-    msg.set(GUID, flags, encodedData);
-    return msg;
+    const char *GUID = reader.readBytes(DownloadIntervalWrite::GUID_SIZE);
+    quint8 flags = reader.readUInt8();
+    if (reader.hasError())
+        return nullptr;
+    quint32 audioDataSize = reader.getRemainingBytes();
+    const char *audioData = reader.readBytes(audioDataSize);
+
+    downloadIntervalWrite.set(GUID, flags, audioData, audioDataSize);
+    return &downloadIntervalWrite;
 }
-//++++++++++++++++++++++++++++++++++++++
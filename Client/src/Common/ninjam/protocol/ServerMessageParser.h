@@ -1,40 +1,43 @@
 #ifndef SERVER_MESSAGES_PARSER_H
 #define SERVER_MESSAGES_PARSER_H
 
-#include <QByteArray>
 #include "ServerMessages.h"
-#include <cstdint>
-
-class QDataStream;
+#include "MessageFraming.h"
 
 namespace Ninjam {
-class ServerMessage;
-enum class ServerMessageType : std::uint8_t;
-
+/**
+ * Parse the messages framed by ReceiveBuffer. The parsed messages are members of the parser and
+ * are reused, so a message is valid until the next parse() call in the same parser instance. The
+ * payloads are not copied: DownloadIntervalWrite audio data references the frame bytes.
+ */
 class ServerMessageParser
 {
-protected:
-    static QString extractString(QDataStream &stream);
-
 public:
-    static const ServerMessage &parse(ServerMessageType msgType, QDataStream &stream,
-                                      quint32 payloadLenght);
+    ServerMessageParser();
 
-private:
+    // return nullptr for unknown or malformed messages
+    const ServerMessage *parse(const MessageFrame &frame);
 
-    // TODO remove these static instances
-    static const ServerMessage &parseAuthChallenge(QDataStream &stream, quint32 /*payloadLenght*/);
-    static const ServerMessage &parseAuthReply(QDataStream &stream, quint32 /*payloadLenght*/);
-    static const ServerMessage &parseServerConfigChangeNotify(QDataStream &stream,
-                                                              quint32 /*payloadLenght*/);
-    static const ServerMessage &parseUserInfoChangeNotify(QDataStream &stream,
-                                                          quint32 payloadLenght);
-    static const ServerMessage &parseChatMessage(QDataStream &stream, const quint32 payloadLenght);
-    static const ServerMessage &parseKeepAlive(QDataStream &/*stream*/, quint32 /*payloadLenght*/);
-    static const ServerMessage &parseDownloadIntervalBegin(QDataStream &stream,
-                                                           quint32 /*payload*/);
-    static const ServerMessage &parseDownloadIntervalWrite(QDataStream &stream,
-                                                           quint32 payloadLenght);
+private:
+    ServerAuthChallengeMessage authChallenge;
+    ServerAuthReplyMessage authReply;
+    ServerConfigChangeNotifyMessage configChangeNotify;
+    UserInfoChangeNotifyMessage userInfoChangeNotify;
+    ServerChatMessage chatMessage;
+    ServerKeepAliveMessage keepAlive;
+    DownloadIntervalBegin downloadIntervalBegin;
+    DownloadIntervalWrite downloadIntervalWrite;
+
+    const ServerMessage *parseAuthChallenge(PayloadReader &reader);
+    const ServerMessage *parseAuthReply(PayloadReader &reader);
+    const ServerMessage *parseServerConfigChangeNotify(PayloadReader &reader);
+    const ServerMessage *parseUserInfoChangeNotify(PayloadReader &reader);
+    const ServerMessage *parseChatMessage(PayloadReader &reader);
+    const ServerMessage *parseDownloadIntervalBegin(PayloadReader &reader);
+    const ServerMessage *parseDownloadIntervalWrite(PayloadReader &reader);
+
+    ServerMessageParser(const ServerMessageParser &);
+    ServerMessageParser &operator=(const ServerMessageParser &);
 };
 }
 
@@ -1,6 +1,7 @@
 #include "ServerMessages.h"
 #include <QDebug>
 #include "../User.h"
+#include <cstring>
 
 using namespace Ninjam;
 
@@ -17,7 +18,7 @@ ServerMessage::~ServerMessage(){ }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
 //+++++++++++++++++++++  SERVER AUTH CHALLENGE+++++++++++++++
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++=
-void ServerAuthChallengeMessage::set( int serverKeepAlivePeriod, quint8 challenge[], QString licenceAgreement, int protocolVersion ){
+void ServerAuthChallengeMessage::set( int serverKeepAlivePeriod, const quint8 challenge[], QString licenceAgreement, int protocolVersion ){
     this->serverKeepAlivePeriod = serverKeepAlivePeriod;
     for (int i = 0; i < 8; ++i) {
         this->challenge[i] = challenge[i];
@@ -145,27 +146,39 @@ void ServerChatMessage::printDebug(QDebug dbg) const{
 //++++++++++++++++++++++++++++++++++++++++++++++
 DownloadIntervalBegin::DownloadIntervalBegin()
     :ServerMessage(ServerMessageType::DOWNLOAD_INTERVAL_BEGIN),
+    estimatedSize(0),
+    channelIndex(0),
     isValidOgg(false)
 {
-
+    std::memset(GUID, 0, GUID_SIZE);
+    std::memset(fourCC, 0, 4);
 }
 
-void DownloadIntervalBegin::set(quint32 estimatedSize, quint8 channelIndex, QString userName, quint8 fourCC[], QByteArray GUID){
-    this->GUID = GUID;
+void DownloadIntervalBegin::set(quint32 estimatedSize, quint8 channelIndex, QString userName, const quint8 fourCC[], const char GUID[]){
+    std::memcpy(this->GUID, GUID, GUID_SIZE);
     this->estimatedSize = estimatedSize;
     this->channelIndex = channelIndex;
     this->userName = userName;
     for (int i = 0; i < 4; ++i) {
         this->fourCC[i] = fourCC[i];
     }
-    isValidOgg = fourCC[0] == 'O' && fourCC[1] == 'G' && fourCC[2] == 'G' && fourCC[3] == 'v';
+    isValidOgg = fourCC[0] == 'O' && fourCC[1] == 'G' && fourCC[2] == 'G' && (fourCC[3] == 'v' || fourCC[3] == 'o');
+}
+
+bool DownloadIntervalBegin::downloadShouldBeStopped() const{
+    for (int i = 0; i < GUID_SIZE; ++i) {
+        if(GUID[i] != 0){
+            return false;
+        }
+    }
+    return true;
 }
 
 void DownloadIntervalBegin::printDebug(QDebug dbg) const
 {
     dbg << "DownloadIntervalBegin{ " <<endl
         << "\tfourCC='"<< fourCC[0] << fourCC[1] << fourCC[2] << fourCC[3] << endl
-        << "\tGUID={"<< GUID << "} " << endl
+        << "\tGUID={"<< getGUID().toHex() << "} " << endl
         << "\tisValidOggDownload="<< isValidOggDownload() << endl
         << "\tdownloadShoudBeStopped="<< downloadShouldBeStopped() << endl
         << "\tdownloadIsComplete="<< downloadIsComplete() << endl
@@ -177,18 +190,23 @@ void DownloadIntervalBegin::printDebug(QDebug dbg) const
 
 void DownloadIntervalWrite::printDebug(QDebug dbg) const
 {
-    dbg << "RECEIVE DownloadIntervalWrite{ flags='" << flags << "' GUID={" << GUID << "} downloadIsComplete=" << downloadIsComplete() << ", audioData=" << encodedAudioData.size() << " bytes }";
+    dbg << "RECEIVE DownloadIntervalWrite{ flags='" << flags << "' GUID={" << getGUID().toHex() << "} downloadIsComplete=" << downloadIsComplete() << ", audioData=" << encodedAudioDataSize << " bytes }";
 }
 
 DownloadIntervalWrite::DownloadIntervalWrite()
-    :ServerMessage(ServerMessageType::DOWNLOAD_INTERVAL_WRITE){
+    :ServerMessage(ServerMessageType::DOWNLOAD_INTERVAL_WRITE),
+      GUID(nullptr),
+      flags(0),
+      encodedAudioData(nullptr),
+      encodedAudioDataSize(0){
 
 }
 
-void DownloadIntervalWrite::set(QByteArray GUID, quint8 flags, QByteArray encodedAudioData){
+void DownloadIntervalWrite::set(const char *GUID, quint8 flags, const char *encodedAudioData, quint32 encodedAudioDataSize){
     this->GUID = GUID;
     this->flags = flags;
     this->encodedAudioData = encodedAudioData;
+    this->encodedAudioDataSize = encodedAudioDataSize;
 }
 
 //++++++++++++++++++
@@ -47,11 +47,11 @@ class ServerAuthChallengeMessage : public ServerMessage
 
 public:
     ServerAuthChallengeMessage();
-    void set(int serverKeepAlivePeriod, quint8 challenge[], QString licenceAgreement,
+    void set(int serverKeepAlivePeriod, const quint8 challenge[], QString licenceAgreement,
              int protocolVersion);
     inline QByteArray getChallenge() const
     {
-        return QByteArray((const char *)challenge);
+        return QByteArray((const char *)challenge, 8);// the challenge can contain zeros
     }
 
     inline int getProtocolVersion() const
@@ -226,18 +226,21 @@ If the FourCC field contains "OGGv" then this is a valid Ogg Vorbis encoded down
 */
 class DownloadIntervalBegin : public ServerMessage
 {
+public:
+    static const int GUID_SIZE = 16;
+
 private:
-    QByteArray GUID;
+    char GUID[GUID_SIZE];
     quint32 estimatedSize;
-    quint8 fourCC[4];// = new byte[4];
+    quint8 fourCC[4];
     quint8 channelIndex;
     QString userName;
     bool isValidOgg;
 
 public:
     DownloadIntervalBegin();
-    void set(quint32 estimatedSize, quint8 channelIndex, QString userName, quint8 fourCC[],
-             QByteArray GUID);
+    void set(quint32 estimatedSize, quint8 channelIndex, QString userName, const quint8 fourCC[],
+             const char GUID[]);
 
     inline quint8  getChannelIndex() const
     {
@@ -249,9 +252,9 @@ public:
         return estimatedSize;
     }
 
-    inline QString getGUID() const
+    inline QByteArray getGUID() const
     {
-        return GUID;
+        return QByteArray(GUID, GUID_SIZE);
     }
 
     virtual void printDebug(QDebug dbg) const;
@@ -261,16 +264,19 @@ public:
         return userName;
     }
 
+    // OGGv (vorbis) or OGGo (opus)
     inline bool isValidOggDownload() const
     {
         return isValidOgg;
     }
 
-    inline bool downloadShouldBeStopped() const
+    inline QByteArray getFourCC() const
     {
-        return GUID.at(0) == '0' && GUID.at(GUID.size()-1) == '0';
+        return QByteArray((const char *)fourCC, 4);
     }
 
+    bool downloadShouldBeStopped() const;
+
     inline bool downloadIsComplete() const
     {
         return fourCC[0] == 0 && fourCC[3] == 0;
@@ -283,27 +289,36 @@ public:
   0x10   uint8_t     Flags
   0x11   ...         Audio Data
   If the Flags field has bit 0 set then this download should be aborted.
+
+  The GUID and the audio data are not copied, they reference the received message bytes and are
+  valid only while the message is handled.
   */
 class DownloadIntervalWrite : public ServerMessage
 {
+public:
+    static const int GUID_SIZE = 16;
+
 private:
-    QByteArray GUID;
+    const char *GUID;
     quint8 flags;
-    QByteArray encodedAudioData;
+    const char *encodedAudioData;
+    quint32 encodedAudioDataSize;
 
 public:
     virtual void printDebug(QDebug dbg) const;
     DownloadIntervalWrite();
-    void set(QByteArray GUID, quint8 flags, QByteArray encodedAudioData);
+    void set(const char *GUID, quint8 flags, const char *encodedAudioData,
+             quint32 encodedAudioDataSize);
 
-    inline QString getGUID() const
+    inline QByteArray getGUID() const
     {
-        return GUID;
+        return QByteArray::fromRawData(GUID, GUID_SIZE);
     }
 
+    // a slice of the received bytes, the receivers must copy the data to keep it
     inline QByteArray getEncodedAudioData() const
     {
-        return encodedAudioData;
+        return QByteArray::fromRawData(encodedAudioData, encodedAudioDataSize);
     }
 
     inline bool downloadIsComplete() const
@@ -94,7 +94,9 @@ void Settings::setPrivateServerData(QString server, int serverPort, QString pass
 AudioSettings::AudioSettings() :
     SettingsObject("audio"),
     sampleRate(44100),
-    bufferSize(128)
+    bufferSize(128),
+    renderThreads(0),
+    opusEncoding(false)
 {
 }
 
@@ -107,6 +109,8 @@ void AudioSettings::read(QJsonObject in)
     lastIn = getValueFromJson(in, "lastIn", 0);
     lastOut = getValueFromJson(in, "lastOut", 0);
     audioDevice = getValueFromJson(in, "audioDevice", -1);
+    renderThreads = getValueFromJson(in, "renderThreads", 0);
+    opusEncoding = getValueFromJson(in, "opusEncoding", false);
 }
 
 void AudioSettings::write(QJsonObject &out)
@@ -118,6 +122,8 @@ void AudioSettings::write(QJsonObject &out)
     out["lastIn"] = lastIn;
     out["lastOut"] = lastOut;
     out["audioDevice"] = audioDevice;
+    out["renderThreads"] = renderThreads;
+    out["opusEncoding"] = opusEncoding;
 }
 
 // +++++++++++++++++++++++++++++
@@ -148,7 +154,9 @@ void MidiSettings::read(QJsonObject in)
 RecordingSettings::RecordingSettings() :
     SettingsObject("recording"),
     saveMultiTracksActivated(false),
-    recordingPath("")
+    recordingPath(""),
+    oneFilePerTrack(false),
+    diskSyncPolicy(1)
 {
 }
 
@@ -156,6 +164,8 @@ void RecordingSettings::write(QJsonObject &out)
 {
     out["recordingPath"] = recordingPath;
     out["recordActivated"] = saveMultiTracksActivated;
+    out["oneFilePerTrack"] = oneFilePerTrack;
+    out["diskSyncPolicy"] = diskSyncPolicy;
 }
 
 void RecordingSettings::read(QJsonObject in)
@@ -178,6 +188,8 @@ void RecordingSettings::read(QJsonObject in)
         recordingPath = QDir(documentsDir).absoluteFilePath("Jamtaba");
     }
     saveMultiTracksActivated = getValueFromJson(in, "recordActivated", false);
+    oneFilePerTrack = getValueFromJson(in, "oneFilePerTrack", false);
+    diskSyncPolicy = qBound(0, getValueFromJson(in, "diskSyncPolicy", 1), 2);// never, each interval, each write batch
 }
 
 // +++++++++++++++++++++++++++++
@@ -194,6 +206,9 @@ void MetronomeSettings::read(QJsonObject in)
     pan = getValueFromJson(in, "pan", (float)0);
     gain = getValueFromJson(in, "gain", (float)1);
     muted = getValueFromJson(in, "muted", false);
+    clickFile = getValueFromJson(in, "clickFile", QString(""));
+    measureAccentFile = getValueFromJson(in, "measureAccentFile", QString(""));
+    intervalAccentFile = getValueFromJson(in, "intervalAccentFile", QString(""));
 }
 
 void MetronomeSettings::write(QJsonObject &out)
@@ -201,6 +216,9 @@ void MetronomeSettings::write(QJsonObject &out)
     out["pan"] = pan;
     out["gain"] = gain;
     out["muted"] = muted;
+    out["clickFile"] = clickFile;
+    out["measureAccentFile"] = measureAccentFile;
+    out["intervalAccentFile"] = intervalAccentFile;
 }
 
 // +++++++++++++++++++++++++++
@@ -485,6 +503,14 @@ void Settings::setMetronomeSettings(float gain, float pan, bool muted)
     metronomeSettings.muted = muted;
 }
 
+void Settings::setMetronomeSoundFiles(QString clickFile, QString measureAccentFile,
+                                      QString intervalAccentFile)
+{
+    metronomeSettings.clickFile = clickFile;
+    metronomeSettings.measureAccentFile = measureAccentFile;
+    metronomeSettings.intervalAccentFile = intervalAccentFile;
+}
+
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void Settings::setFullScreenView(bool v)
 {
@@ -48,6 +48,8 @@ public:
     int lastIn;
     int lastOut;
     int audioDevice;
+    int renderThreads;// worker threads used to render the tracks in parallel, zero to render in the audio thread
+    bool opusEncoding;// upload opus intervals when all users in the room can decode them
 };
 // +++++++++++++++++++++++++++++++++++++
 class MidiSettings : public SettingsObject
@@ -81,6 +83,9 @@ public:
     float pan;
     float gain;
     bool muted;
+    QString clickFile;// user WAV files, empty to use the default sounds
+    QString measureAccentFile;
+    QString intervalAccentFile;
 };
 
 // +++++++++++++++++++++++++++++++++++++++++++++++
@@ -116,6 +121,8 @@ public:
     void read(QJsonObject in);
     bool saveMultiTracksActivated;
     QString recordingPath;
+    bool oneFilePerTrack;// the intervals are appended in one chained Ogg file per track
+    int diskSyncPolicy;// Recorder::RecordingDiskWriter::SyncPolicy
 };
 // +++++++++++++++++++++++++++++++++
 class Plugin
@@ -262,6 +269,26 @@ public:
         return audioSettings.bufferSize;
     }
 
+    inline int getRenderThreads() const
+    {
+        return audioSettings.renderThreads;
+    }
+
+    inline void setRenderThreads(int renderThreads)
+    {
+        audioSettings.renderThreads = renderThreads;
+    }
+
+    inline bool isOpusEncodingPreferred() const
+    {
+        return audioSettings.opusEncoding;
+    }
+
+    inline void setOpusEncodingPreferred(bool preferOpus)
+    {
+        audioSettings.opusEncoding = preferOpus;
+    }
+
     // private server
     inline QString getLastPrivateServer() const
     {
@@ -291,6 +318,16 @@ public:
         return recordingSettings.recordingPath;
     }
 
+    inline bool isRecordingOneFilePerTrack() const
+    {
+        return recordingSettings.oneFilePerTrack;
+    }
+
+    inline int getRecordingDiskSyncPolicy() const
+    {
+        return recordingSettings.diskSyncPolicy;
+    }
+
     inline void setSaveMultiTrack(bool saveMultiTracks)
     {
         recordingSettings.saveMultiTracksActivated = saveMultiTracks;
@@ -352,6 +389,23 @@ public:
         return metronomeSettings.muted;
     }
 
+    void setMetronomeSoundFiles(QString clickFile, QString measureAccentFile,
+                                QString intervalAccentFile);
+    inline QString getMetronomeClickFile() const
+    {
+        return metronomeSettings.clickFile;
+    }
+
+    inline QString getMetronomeMeasureAccentFile() const
+    {
+        return metronomeSettings.measureAccentFile;
+    }
+
+    inline QString getMetronomeIntervalAccentFile() const
+    {
+        return metronomeSettings.intervalAccentFile;
+    }
+
     // +++++++++   Window  +++++++++++++++++++++++
     inline QPointF getLastWindowLocation() const
     {
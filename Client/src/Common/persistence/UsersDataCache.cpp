@@ -133,6 +133,18 @@ CacheEntry UsersDataCache::getUserCacheEntry(const QString &userIp, const QStrin
     return CacheEntry(userIp, userName, channelID);// return a entry using default values for pan, gain, mute, etc.
 }
 
+CacheEntry UsersDataCache::findUserCacheEntry(const QString &userName, quint8 channelID) const
+{
+    // the recorded remote tracks are named "user from country" (see NinjamController), the user
+    // names don't have spaces (see CacheEntry::namePattern)
+    QString ninjamUserName = userName.section(" from ", 0, 0);
+    foreach (const CacheEntry &entry, cacheEntries) {
+        if (entry.getUserName() == ninjamUserName && entry.getChannelID() == channelID)
+            return entry;
+    }
+    return CacheEntry(QString(), ninjamUserName, channelID);
+}
+
 void UsersDataCache::updateUserCacheEntry(CacheEntry entry)
 {
     QString userKey
@@ -100,6 +100,10 @@ public:
     // return default values for pan, gain and mute if user is not cached yet
     CacheEntry getUserCacheEntry(const QString &userIp, const QString &userName, quint8 channelID);
 
+    // the first cached entry of the user in any IP (the recorded jams don't have the users IP),
+    // 'userName' can be a recorded track user name ("user from country")
+    CacheEntry findUserCacheEntry(const QString &userName, quint8 channelID) const;
+
     void updateUserCacheEntry(CacheEntry entry);
 private:
     QMap<QString, CacheEntry> cacheEntries;
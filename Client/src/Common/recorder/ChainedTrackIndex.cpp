@@ -0,0 +1,45 @@
+#include "ChainedTrackIndex.h"
+#include "log/Logging.h"
+#include <QFile>
+#include <QFileInfo>
+
+using namespace Recorder;
+
+QString ChainedTrackIndex::getIndexPath(const QString &trackFilePath)
+{
+    return trackFilePath + ".index";
+}
+
+QByteArray ChainedTrackIndex::toLine(const Entry &entry)
+{
+    return QByteArray::number(entry.intervalIndex) + " " + QByteArray::number(entry.offset) + " "
+           + QByteArray::number(entry.size) + " " + QByteArray::number(entry.startTime, 'f', 6)
+           + " " + QByteArray::number(entry.duration, 'f', 6) + "\n";
+}
+
+QList<ChainedTrackIndex::Entry> ChainedTrackIndex::read(const QString &trackFilePath)
+{
+    QList<Entry> entries;
+    QFile indexFile(getIndexPath(trackFilePath));
+    if (!indexFile.open(QFile::ReadOnly)) {
+        qCWarning(jtJamRecorder) << "Can't read the track index" << indexFile.fileName();
+        return entries;
+    }
+
+    qint64 trackFileSize = QFileInfo(trackFilePath).size();
+    while (!indexFile.atEnd()) {
+        QList<QByteArray> fields = indexFile.readLine().trimmed().split(' ');
+        if (fields.size() != 5)
+            continue;// incomplete line
+        Entry entry;
+        entry.intervalIndex = fields.at(0).toInt();
+        entry.offset = fields.at(1).toLongLong();
+        entry.size = fields.at(2).toLongLong();
+        entry.startTime = fields.at(3).toDouble();
+        entry.duration = fields.at(4).toDouble();
+        if (entry.size <= 0 || entry.offset + entry.size > trackFileSize)
+            break;
+        entries.append(entry);
+    }
+    return entries;
+}
@@ -0,0 +1,36 @@
+#ifndef CHAINED_TRACK_INDEX_H
+#define CHAINED_TRACK_INDEX_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+namespace Recorder {
+/**
+ * In the 'one file per track' recording format the intervals of each track are appended in a
+ * single chained Ogg file (each interval is a complete Ogg stream). The sidecar index (the track
+ * file path + ".index") has one text line per interval:
+ *     <intervalIndex> <byte offset> <bytes> <start time in the file> <duration>
+ * The times are in seconds.
+ */
+class ChainedTrackIndex
+{
+public:
+    struct Entry
+    {
+        int intervalIndex;
+        qint64 offset;
+        qint64 size;
+        double startTime;
+        double duration;
+    };
+
+    static QString getIndexPath(const QString &trackFilePath);
+    static QByteArray toLine(const Entry &entry);
+
+    // the entries of intervals not completely written in the track file (a crash) are discarded
+    static QList<Entry> read(const QString &trackFilePath);
+};
+}
+
+#endif // CHAINED_TRACK_INDEX_H
@@ -0,0 +1,495 @@
+#include "JamMixdown.h"
+#include "audio/AudioFileWriter.h"
+#include "audio/IntervalCodec.h"
+#include "audio/SamplesBufferResampler.h"
+#include "audio/core/AudioNode.h"
+#include "audio/core/SamplesBuffer.h"
+#include "persistence/UsersDataCache.h"
+#include "log/Logging.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+#include <algorithm>
+#include <cmath>
+
+using namespace Recorder;
+using namespace Audio;
+
+namespace Recorder {
+struct MixdownItem
+{
+    QString userName;
+    quint8 channelIndex;
+    double position;// seconds
+    double length;
+    QString filePath;
+    qint64 byteOffset;// the interval bytes in chained track files
+    qint64 byteSize;// -1 to read the whole file
+};
+
+// the mixdown or the stem of one user, the samples of the current window
+class MixdownTarget
+{
+public:
+    MixdownTarget(AudioFileWriter *writer, int windowFrames) :
+        writer(writer),
+        window(2, windowFrames),
+        failed(false)
+    {
+    }
+
+    QMutex mutex;// the decoding tasks mix in the same window
+    QScopedPointer<AudioFileWriter> writer;
+    SamplesBuffer window;// WINDOW_SECONDS + the longest item, the tail is the next window start
+    bool failed;
+};
+}
+
+namespace {
+// ++++++++++++++++++++++++++++++++++++++++++++
+class ItemRenderTask : public QRunnable
+{
+public:
+    ItemRenderTask(const MixdownItem *item, int windowOffset, int sampleRate,
+                   MixdownTarget *stem, MixdownTarget *mixdown, float leftGain, float rightGain) :
+        item(item),
+        windowOffset(windowOffset),
+        sampleRate(sampleRate),
+        stem(stem),
+        mixdown(mixdown),
+        leftGain(leftGain),
+        rightGain(rightGain)
+    {
+    }
+
+    void run()
+    {
+        SamplesBuffer rendered(2, 0);
+        if (!render(rendered) || rendered.isEmpty())
+            return;
+
+        rendered.applyGain(1.0f, leftGain, rightGain, 1.0f);
+        MixdownTarget *targets[] = { stem, mixdown };
+        for (MixdownTarget *target : targets) {
+            if (!target)
+                continue;
+            QMutexLocker locker(&target->mutex);
+            target->window.add(rendered, windowOffset);
+        }
+    }
+
+private:
+    const MixdownItem *item;
+    const int windowOffset;
+    const int sampleRate;
+    MixdownTarget *stem;
+    MixdownTarget *mixdown;// null if the track is muted
+    const float leftGain;
+    const float rightGain;
+
+    static const int DECODE_FRAMES = 4096;
+
+    QByteArray readEncodedData() const
+    {
+        QFile file(item->filePath);
+        if (!file.open(QFile::ReadOnly))
+            return QByteArray();
+        if (item->byteSize < 0)
+            return file.readAll();
+        if (!file.seek(item->byteOffset))
+            return QByteArray();
+        return file.read(item->byteSize);
+    }
+
+    // decoded, resampled and trimmed to the item length
+    bool render(SamplesBuffer &rendered) const
+    {
+        QByteArray encodedData = readEncodedData();
+        IntervalCodec codec = IntervalCodecs::detect(encodedData);
+        if (codec == IntervalCodec::UNKNOWN || !IntervalCodecs::isSupported(codec)) {
+            qCWarning(jtJamRecorder) << "Can't decode" << item->filePath;
+            return false;
+        }
+
+        QScopedPointer<IntervalDecoder> decoder(IntervalCodecs::createDecoder(codec));
+        decoder->addInput(encodedData, true);
+        const int lenght = (int)std::lround(item->length * sampleRate);
+        SamplesBufferResampler resampler(SamplesBufferResampler::HIGH);
+        bool resampling = false;
+        while (rendered.getFrameLenght() < lenght) {
+            const SamplesBuffer &decoded = decoder->decode(DECODE_FRAMES);
+            if (decoded.isEmpty())
+                break;
+            if (rendered.isEmpty() && !resampling && decoder->getSampleRate() != sampleRate) {
+                resampler.setSampleRates(decoder->getSampleRate(), sampleRate);
+                resampling = true;
+            }
+            if (!resampling) {
+                rendered.append(decoded);
+                continue;
+            }
+            int outFrames = (int)std::ceil(decoded.getFrameLenght() * (double)sampleRate
+                                           / decoder->getSampleRate()) + 1;
+            rendered.append(resampler.resample(decoded, outFrames));
+        }
+        if (resampling && rendered.getFrameLenght() < lenght) {// the samples in the filter
+            SamplesBuffer zeros(2, resampler.getLatency() * 2);
+            rendered.append(resampler.resample(zeros, lenght - rendered.getFrameLenght()));
+        }
+
+        if (rendered.getFrameLenght() > lenght)
+            rendered.setFrameLenght(lenght);
+        return true;
+    }
+};
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+class TargetWriteTask : public QRunnable
+{
+public:
+    TargetWriteTask(MixdownTarget *target, int frames, int windowFrames) :
+        target(target),
+        frames(frames),
+        windowFrames(windowFrames)
+    {
+    }
+
+    void run()
+    {
+        SamplesBuffer block(2, frames);
+        block.set(target->window, 0, frames, 0);
+        if (!target->writer->write(block))
+            target->failed = true;
+
+        // the items longer than the window end are in the tail, moved to the next window start
+        const int lenght = target->window.getFrameLenght();
+        target->window.discardFirstSamples(windowFrames);
+        target->window.setFrameLenght(lenght);
+    }
+
+private:
+    MixdownTarget *target;
+    const int frames;
+    const int windowFrames;
+};
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+JamMixdown::Options::Options() :
+    fileExtension(".wav"),
+    bitsPerSample(16),
+    sampleRate(0),
+    threads(0),
+    mixdown(true),
+    stems(true)
+{
+}
+
+JamMixdown::JamMixdown(const QString &jamDir) :
+    jamDir(jamDir),
+    sampleRate(0)
+{
+}
+
+JamMixdown::~JamMixdown()
+{
+    qDeleteAll(items);
+}
+
+bool JamMixdown::load()
+{
+    qDeleteAll(items);
+    items.clear();
+    trackIndexes.clear();
+
+    QDir dir(jamDir);
+    bool loaded;
+    if (dir.exists("Reaper project.journal"))// the recording was interrupted
+        loaded = loadJournal(dir.absoluteFilePath("Reaper project.journal"));
+    else if (dir.exists("Reaper project.rpp"))
+        loaded = loadProject(dir.absoluteFilePath("Reaper project.rpp"));
+    else
+        return error("No recorded jam in " + jamDir);
+
+    if (!loaded)
+        return false;
+    if (items.isEmpty())
+        return error("No recorded intervals in " + jamDir);
+
+    std::stable_sort(items.begin(), items.end(),
+                     [](const MixdownItem *a, const MixdownItem *b) {
+        return a->position < b->position;
+    });
+    return true;
+}
+
+bool JamMixdown::loadProject(const QString &projectFilePath)
+{
+    QFile project(projectFilePath);
+    if (!project.open(QFile::ReadOnly | QFile::Text))
+        return error("Can't read " + projectFilePath);
+
+    static const QRegularExpression quoted("\"(.*)\"");
+    QString userName;
+    quint8 channelIndex = 0;
+    bool validTrack = false;
+    bool inItem = false;
+    double position = 0;
+    double length = 0;
+    double sourceOffset = 0;
+    while (!project.atEnd()) {
+        QString line = QString::fromUtf8(project.readLine()).trimmed();
+        QString value = line.section(' ', 1);
+        if (line.startsWith("SAMPLERATE ")) {
+            sampleRate = value.section(' ', 0, 0).toInt();
+        } else if (line.startsWith("<TRACK")) {
+            validTrack = false;
+        } else if (line.startsWith("NAME ") && !inItem) {
+            validTrack = parseTrackName(quoted.match(line).captured(1), userName, channelIndex);
+        } else if (line.startsWith("<ITEM")) {
+            inItem = true;
+            position = length = sourceOffset = 0;
+        } else if (inItem && line.startsWith("POSITION ")) {
+            position = value.toDouble();
+        } else if (inItem && line.startsWith("LENGTH ")) {
+            length = value.toDouble();
+        } else if (inItem && line.startsWith("SOFFS ")) {
+            sourceOffset = value.toDouble();
+        } else if (inItem && line.startsWith("FILE ")) {// the last item field
+            if (validTrack)
+                addItem(userName, channelIndex, position, length, quoted.match(line).captured(1),
+                        sourceOffset);
+            inItem = false;
+        }
+    }
+
+    if (sampleRate <= 0)
+        return error("Invalid sample rate in " + projectFilePath);
+    return true;
+}
+
+bool JamMixdown::loadJournal(const QString &journalFilePath)
+{
+    QFile journal(journalFilePath);
+    if (!journal.open(QFile::ReadOnly))
+        return error("Can't read " + journalFilePath);
+
+    double intervalsLenght = 0;
+    while (!journal.atEnd()) {
+        QList<QByteArray> fields = journal.readLine().trimmed().split(' ');
+        if (fields.size() == 4 && fields.at(0) == "JAM") {
+            int bpm = fields.at(1).toInt();
+            int bpi = fields.at(2).toInt();
+            sampleRate = fields.at(3).toInt();
+            if (bpm > 0)
+                intervalsLenght = 60.0/bpm * (double)bpi;
+        } else if (fields.size() == 6 && fields.at(0) == "ITEM" && intervalsLenght > 0) {
+            int intervalIndex = fields.at(1).toInt();
+            addItem(QUrl::fromPercentEncoding(fields.at(3)), (quint8)fields.at(2).toUInt(),
+                    (intervalIndex - 1) * intervalsLenght, intervalsLenght,
+                    QUrl::fromPercentEncoding(fields.at(4)), fields.at(5).toDouble());
+        }// else the last line is incomplete (a crash)
+    }
+
+    if (sampleRate <= 0 || intervalsLenght <= 0)
+        return error("Invalid jam header in " + journalFilePath);
+    return true;
+}
+
+void JamMixdown::addItem(const QString &userName, quint8 channelIndex, double position,
+                         double length, const QString &filePath, double sourceOffset)
+{
+    MixdownItem *item = new MixdownItem();
+    item->userName = userName;
+    item->channelIndex = channelIndex;
+    item->position = position;
+    item->length = length;
+    item->filePath = resolvePath(filePath);
+    item->byteOffset = 0;
+    item->byteSize = -1;
+
+    QString indexPath = ChainedTrackIndex::getIndexPath(item->filePath);
+    if (trackIndexes.contains(item->filePath) || QFile::exists(indexPath)) {
+        if (!trackIndexes.contains(item->filePath))
+            trackIndexes.insert(item->filePath, ChainedTrackIndex::read(item->filePath));
+        bool found = false;
+        for (const ChainedTrackIndex::Entry &entry : trackIndexes[item->filePath]) {
+            if (std::abs(entry.startTime - sourceOffset) < 0.001) {
+                item->byteOffset = entry.offset;
+                item->byteSize = entry.size;
+                item->length = qMin(length, entry.duration);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {// not written in the track file
+            qCWarning(jtJamRecorder) << "Interval not found in the track index" << filePath
+                                     << sourceOffset;
+            delete item;
+            return;
+        }
+    }
+    items.append(item);
+}
+
+QString JamMixdown::resolvePath(const QString &filePath) const
+{
+    if (QFileInfo(filePath).isAbsolute() && QFile::exists(filePath))
+        return filePath;
+
+    // the jam folder was moved (or copied to a server), the audio files are in 'audio'
+    return QDir(jamDir).absoluteFilePath("audio/" + QFileInfo(filePath).fileName());
+}
+
+bool JamMixdown::render(const QString &outputDir, const Options &options,
+                        const Persistence::UsersDataCache *usersDataCache)
+{
+    if (items.isEmpty() && !load())
+        return false;
+    if (!options.mixdown && !options.stems)
+        return error("Nothing to render");
+    if (!QDir().mkpath(outputDir))
+        return error("Can't create " + outputDir);
+
+    const int outSampleRate = options.sampleRate > 0 ? options.sampleRate : sampleRate;
+    const int windowFrames = WINDOW_SECONDS * outSampleRate;
+    double longestItem = 0;
+    for (const MixdownItem *item : items)
+        longestItem = qMax(longestItem, item->length);
+    const int bufferFrames = windowFrames + (int)std::ceil(longestItem * outSampleRate) + 1;
+    const qint64 totalFrames = (qint64)std::ceil(getLength() * outSampleRate);
+
+    // the writers are created first, nothing is rendered if a file can't be written
+    QList<MixdownTarget *> targets;
+    QMap<QString, MixdownTarget *> stems;
+    MixdownTarget *mixdown = nullptr;
+    QDir dir(outputDir);
+    if (options.mixdown) {
+        AudioFileWriter *writer = AudioFileWriter::create(
+            dir.absoluteFilePath("mixdown" + options.fileExtension), 2, outSampleRate,
+            options.bitsPerSample);
+        if (writer)
+            targets.append(mixdown = new MixdownTarget(writer, bufferFrames));
+    }
+    if (options.stems) {
+        for (const QString &userName : getUsers()) {
+            AudioFileWriter *writer = AudioFileWriter::create(
+                dir.absoluteFilePath(getFileName(userName) + options.fileExtension), 2,
+                outSampleRate, options.bitsPerSample);
+            if (!writer)
+                break;
+            targets.append(stems[userName] = new MixdownTarget(writer, bufferFrames));
+        }
+    }
+    if (targets.size() != (options.mixdown ? 1 : 0) + (options.stems ? getUsers().size() : 0)) {
+        qDeleteAll(targets);
+        return error("Can't write the rendered files in " + outputDir);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(options.threads > 0 ? options.threads : QThread::idealThreadCount());
+
+    qCDebug(jtJamRecorder) << "Rendering" << items.size() << "intervals of" << jamDir << "in"
+                           << pool.maxThreadCount() << "threads";
+
+    int nextItem = 0;
+    const int windows = (int)((totalFrames + windowFrames - 1) / windowFrames);
+    for (int w = 0; w < windows; ++w) {
+        // the intervals starting in this window are decoded and mixed in parallel
+        const qint64 windowStart = (qint64)w * windowFrames;
+        while (nextItem < items.size()) {
+            const MixdownItem *item = items.at(nextItem);
+            qint64 itemStart = (qint64)std::lround(item->position * outSampleRate);
+            if (itemStart >= windowStart + windowFrames)
+                break;
+            nextItem++;
+
+            float gain = 1.0f;
+            float pan = 0;
+            bool muted = false;
+            if (usersDataCache) {
+                Persistence::CacheEntry entry
+                    = usersDataCache->findUserCacheEntry(item->userName, item->channelIndex);
+                gain = entry.getGain() * entry.getBoost();
+                pan = entry.getPan();
+                muted = entry.isMuted();
+            }
+            float leftGain, rightGain;
+            AudioNode::getPanGains(pan, leftGain, rightGain);
+            pool.start(new ItemRenderTask(item, (int)(qMax(itemStart, windowStart) - windowStart),
+                                          outSampleRate, stems.value(item->userName),
+                                          muted ? nullptr : mixdown, leftGain * gain,
+                                          rightGain * gain));
+        }
+        pool.waitForDone();
+
+        const int frames = (int)qMin((qint64)windowFrames, totalFrames - windowStart);
+        for (MixdownTarget *target : targets)
+            pool.start(new TargetWriteTask(target, frames, windowFrames));
+        pool.waitForDone();
+
+        emit progressChanged((w + 1) * 100 / windows);
+    }
+
+    bool failed = false;
+    for (MixdownTarget *target : targets)
+        failed = target->failed || !target->writer->close() || failed;
+    qDeleteAll(targets);
+    if (failed)
+        return error("Can't write the rendered files in " + outputDir);
+    return true;
+}
+
+QStringList JamMixdown::getUsers() const
+{
+    QStringList users;
+    for (const MixdownItem *item : items) {
+        if (!users.contains(item->userName))
+            users.append(item->userName);
+    }
+    users.sort(Qt::CaseInsensitive);
+    return users;
+}
+
+double JamMixdown::getLength() const
+{
+    double length = 0;
+    for (const MixdownItem *item : items)
+        length = qMax(length, item->position + item->length);
+    return length;
+}
+
+bool JamMixdown::error(const QString &message)
+{
+    qCWarning(jtJamRecorder) << message;
+    errorMessage = message;
+    return false;
+}
+
+bool JamMixdown::parseTrackName(const QString &trackName, QString &userName, quint8 &channelIndex)
+{
+    // see ReaperProjectGenerator::buildTrackName
+    static const QRegularExpression pattern("^(.*) \\(Channel (\\d+)\\)$");
+    QRegularExpressionMatch match = pattern.match(trackName);
+    if (!match.hasMatch() || match.captured(2).toInt() <= 0)
+        return false;
+    userName = match.captured(1);
+    channelIndex = (quint8)(match.captured(2).toInt() - 1);
+    return true;
+}
+
+QString JamMixdown::getFileName(const QString &userName)
+{
+    QString fileName = userName;
+    fileName.replace(QRegularExpression("[\\\\/:*?\"<>|]"), "_");
+    return fileName;
+}
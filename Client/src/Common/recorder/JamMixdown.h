@@ -0,0 +1,89 @@
+#ifndef JAM_MIXDOWN_H
+#define JAM_MIXDOWN_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QMap>
+#include "ChainedTrackIndex.h"
+
+namespace Persistence {
+class UsersDataCache;
+}
+
+namespace Recorder {
+struct MixdownItem;
+class MixdownTarget;
+
+/**
+ * Render a recorded jam (a JamRecorder session directory) offline: a stereo mixdown and one stem
+ * per user. The items are read from the Reaper project, or from the journal when the recording
+ * was interrupted, so both recording formats (one file per interval and chained track files) are
+ * supported.
+ *
+ * The jam is rendered in windows of WINDOW_SECONDS. The intervals starting in each window are
+ * decoded, resampled and mixed in parallel by a thread pool, only the current window is kept in
+ * memory.
+ */
+class JamMixdown : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        Options();
+
+        QString fileExtension;// ".wav" or ".flac"
+        int bitsPerSample;
+        int sampleRate;// zero to use the jam sample rate
+        int threads;// zero to use all cores
+        bool mixdown;
+        bool stems;
+    };
+
+    explicit JamMixdown(const QString &jamDir);
+    ~JamMixdown();
+
+    bool load();// read the items of the jam
+    bool render(const QString &outputDir, const Options &options,
+                const Persistence::UsersDataCache *usersDataCache = nullptr);
+
+    QStringList getUsers() const;
+    double getLength() const;// seconds
+
+    inline int getSampleRate() const
+    {
+        return sampleRate;
+    }
+
+    inline QString getErrorMessage() const
+    {
+        return errorMessage;
+    }
+
+    static const int WINDOW_SECONDS = 60;
+
+signals:
+    void progressChanged(int percent);
+
+private:
+    QString jamDir;
+    int sampleRate;
+    QList<MixdownItem *> items;// sorted by position
+    QMap<QString, QList<ChainedTrackIndex::Entry> > trackIndexes;// chained track files only
+    QString errorMessage;
+
+    bool loadProject(const QString &projectFilePath);
+    bool loadJournal(const QString &journalFilePath);
+    void addItem(const QString &userName, quint8 channelIndex, double position, double length,
+                 const QString &filePath, double sourceOffset);
+    QString resolvePath(const QString &filePath) const;
+    bool error(const QString &message);
+
+    static bool parseTrackName(const QString &trackName, QString &userName, quint8 &channelIndex);
+    static QString getFileName(const QString &userName);
+};
+}
+
+#endif // JAM_MIXDOWN_H
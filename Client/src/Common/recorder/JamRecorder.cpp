@@ -1,18 +1,19 @@
 #include "JamRecorder.h"
 #include <QDateTime>
 #include <QDebug>
-#include <QtConcurrent/QtConcurrent>
 #include "../log/Logging.h"
+#include "../audio/IntervalCodec.h"
+#include "ChainedTrackIndex.h"
 
 using namespace Recorder;
 
 //++++++++++++++++++++++++++++++++++++++++++++++
-JamAudioFile::JamAudioFile(QString path, uint intervalIndex)
-    :path(path), intervalIndex(intervalIndex){
+JamAudioFile::JamAudioFile(QString path, uint intervalIndex, double sourceOffset)
+    :path(path), intervalIndex(intervalIndex), sourceOffset(sourceOffset){
 
 }
 JamAudioFile::JamAudioFile()//default construtor to use this class in QMap and QList without pointers
-    :path(""), intervalIndex(0){
+    :path(""), intervalIndex(0), sourceOffset(0){
 
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -26,8 +27,8 @@ JamTrack::JamTrack()//default construtor to use this class in QMap and QList wit
 
 }
 
-void JamTrack::addAudioFile(QString path, int intervalIndex){
-    audioFiles.append( JamAudioFile(path, intervalIndex));
+void JamTrack::addAudioFile(QString path, int intervalIndex, double sourceOffset){
+    audioFiles.append( JamAudioFile(path, intervalIndex, sourceOffset));
 }
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 Jam::Jam(int bpm, int bpi, int sampleRate, QString jamName, QString baseDir)
@@ -48,19 +49,19 @@ QList<JamTrack> Jam::getJamTracks() const{
     return tracks;
 }
 
-double Jam::getIntervalsLenght(){
+double Jam::getIntervalsLenght() const{
     return 60.0/bpm * (double)bpi;
 }
 
 //called when a new file is writed in disk
-void Jam::addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex){
+void Jam::addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex, double sourceOffset){
     if(!jamTracks.contains(userName)){
         jamTracks.insert(userName, QMap<quint8, JamTrack>());
     }
     if(!jamTracks[userName].contains(channelIndex)){
         jamTracks[userName].insert(channelIndex, JamTrack(userName, channelIndex));
     }
-    jamTracks[userName][channelIndex].addAudioFile(filePath, intervalIndex);
+    jamTracks[userName][channelIndex].addAudioFile(filePath, intervalIndex, sourceOffset);
     qCDebug(jtJamRecorder) << "adding a file in jam interval:" <<intervalIndex << " path:" << filePath;
 }
 
@@ -72,28 +73,78 @@ QString JamRecorder::getNewJamName() {
     return "Jam-" + nowString;
 }
 
-void JamRecorder::writeEncodedFile(const QByteArray& encodedData, QString path){
-
-    QFile audioFile(path);
-    if(!audioFile.open(QFile::WriteOnly)){
-        qCritical() << "can't open file " << path;
+void JamRecorder::saveInterval(QString userName, quint8 channelIndex, int intervalIndex, const QByteArray &encodedData){
+    QDir audioDir(jam->getAudioAbsolutePath());
+    if(!oneFilePerTrack){
+        QString audioFilePath = audioDir.absoluteFilePath(buildAudioFileName(userName, channelIndex, intervalIndex, encodedData));
+        diskWriter.write(audioFilePath, encodedData);
+        addAudioFile(userName, channelIndex, audioFilePath, intervalIndex);
         return;
     }
-    audioFile.write(encodedData.data(), encodedData.size());
-    qCDebug(jtJamRecorder) << "file writed:" <<path;
+
+    //the interval is appended in the track file, a chained Ogg stream
+    QString trackFilePath = audioDir.absoluteFilePath(buildTrackFileName(userName, channelIndex, encodedData));
+    if(!chainedTrackFiles.contains(trackFilePath)){
+        ChainedTrackFile trackFile = {0, 0};
+        chainedTrackFiles.insert(trackFilePath, trackFile);
+    }
+    ChainedTrackFile &trackFile = chainedTrackFiles[trackFilePath];
+    ChainedTrackIndex::Entry entry;
+    entry.intervalIndex = intervalIndex;
+    entry.offset = trackFile.size;
+    entry.size = encodedData.size();
+    entry.startTime = trackFile.duration;
+    entry.duration = Audio::IntervalCodecs::getDuration(encodedData);
+    if(entry.duration <= 0){
+        entry.duration = jam->getIntervalsLenght();
+    }
+    diskWriter.append(trackFilePath, encodedData);
+    diskWriter.append(ChainedTrackIndex::getIndexPath(trackFilePath), ChainedTrackIndex::toLine(entry));
+    trackFile.size += entry.size;
+    trackFile.duration += entry.duration;
+    addAudioFile(userName, channelIndex, trackFilePath, intervalIndex, entry.startTime);
 }
 
-QString JamRecorder::buildAudioFileName(QString userName, quint8 channelIndex, int currentInterval) {
+QString JamRecorder::buildAudioFileName(QString userName, quint8 channelIndex, int currentInterval, const QByteArray &encodedData) {
     QString channelName = "Channel " + QString::number(channelIndex + 1);
-    return userName + " (" + channelName + ") part " + QString::number(currentInterval) + ".ogg";
+    QString extension = Audio::IntervalCodecs::getFileExtension(Audio::IntervalCodecs::detect(encodedData));//.ogg or .opus
+    return userName + " (" + channelName + ") part " + QString::number(currentInterval) + extension;
+}
+
+QString JamRecorder::buildTrackFileName(QString userName, quint8 channelIndex, const QByteArray &encodedData) {
+    QString channelName = "Channel " + QString::number(channelIndex + 1);
+    QString extension = Audio::IntervalCodecs::getFileExtension(Audio::IntervalCodecs::detect(encodedData));//.ogg or .opus
+    return userName + " (" + channelName + ")" + extension;
 }
 
 JamRecorder::JamRecorder(JamMetadataWriter* jamMetadataWritter)
-    : jam(nullptr), jamMetadataWritter(jamMetadataWritter), globalIntervalIndex(0), running(false){
+    : jam(nullptr), jamMetadataWritter(jamMetadataWritter), globalIntervalIndex(0), running(false),
+      oneFilePerTrack(false){
 
     //this->recordingActivated = true;//just to test
 }
 
+JamRecorder::~JamRecorder(){
+    stopRecording();
+    delete jamMetadataWritter;//wait the pending metadata writes
+    delete jam;
+}
+
+void JamRecorder::addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex, double sourceOffset){
+    jam->addAudioFile(userName, channelIndex, filePath, intervalIndex, sourceOffset);
+    if(jamMetadataWritter){
+        jamMetadataWritter->addAudioFile(userName, channelIndex, JamAudioFile(filePath, intervalIndex, sourceOffset));
+    }
+}
+
+void JamRecorder::setOneFilePerTrack(bool oneFilePerTrack){
+    this->oneFilePerTrack = oneFilePerTrack;
+}
+
+void JamRecorder::setSyncPolicy(RecordingDiskWriter::SyncPolicy policy){
+    diskWriter.setSyncPolicy(policy);
+}
+
 
 void JamRecorder::appendLocalUserAudio(QByteArray encodedaudio, quint8 channelIndex, bool isFirstPartOfInterval, bool isLastPastOfInterval){
     if(!running){
@@ -107,12 +158,8 @@ void JamRecorder::appendLocalUserAudio(QByteArray encodedaudio, quint8 channelIn
     }
     localUserIntervals[channelIndex].appendEncodedAudio(encodedaudio);
     if(isLastPastOfInterval){
-        QString audioFileName = buildAudioFileName(localUserName, channelIndex, localUserIntervals[channelIndex].getIntervalIndex());
-        QString audioFilePath = QDir(jam->getAudioAbsolutePath()).absoluteFilePath(audioFileName);
         QByteArray encodedData(localUserIntervals[channelIndex].getEncodedData());
-        QtConcurrent::run(this, &JamRecorder::writeEncodedFile, encodedData, audioFilePath);
-        //writeEncodedFile(localUserIntervals[channelIndex].getEncodedData(), audioFilePath);
-        jam->addAudioFile(localUserName, channelIndex, audioFilePath, localUserIntervals[channelIndex].getIntervalIndex());
+        saveInterval(localUserName, channelIndex, localUserIntervals[channelIndex].getIntervalIndex(), encodedData);
         localUserIntervals[channelIndex].clear();
     }
 }
@@ -122,11 +169,7 @@ void JamRecorder::addRemoteUserAudio(QString userName, QByteArray encodedAudio,
         qCCritical(jtJamRecorder) << "Illegal state! Recorder is not running!";
         return;
     }
-    int intervalIndex = globalIntervalIndex;
-    QString audioFileName = buildAudioFileName(userName, channelIndex, intervalIndex);
-    QString audioFilePath = QDir(jam->getAudioAbsolutePath()).absoluteFilePath(audioFileName);
-    QtConcurrent::run(this, &JamRecorder::writeEncodedFile, encodedAudio, audioFilePath);
-    jam->addAudioFile(userName, channelIndex, audioFilePath, intervalIndex);
+    saveInterval(userName, channelIndex, globalIntervalIndex, encodedAudio);
 }
 
 void JamRecorder::startRecording(QString localUser, QDir recordBasePath, int bpm, int bpi, int sampleRate){
@@ -137,6 +180,9 @@ void JamRecorder::startRecording(QString localUser, QDir recordBasePath, int bpm
         delete this->jam;
     }
     this->jam = new Jam(bpm, bpi, sampleRate, currentJamName, recordBasePath.absolutePath());
+    if(jamMetadataWritter){
+        jamMetadataWritter->startJam(*jam);
+    }
     this->running = true;
 }
 
@@ -171,17 +217,15 @@ void JamRecorder::setSampleRate(int newSampleRate){
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 void JamRecorder::stopRecording() {
     if(running){
-        writeProjectFile();
+        if(jamMetadataWritter){
+            jamMetadataWritter->stopJam();
+        }
         this->running = false;
         this->globalIntervalIndex = 0;
         this->localUserIntervals.clear();
-    }
-}
-
-
-void JamRecorder::writeProjectFile() {
-    if (jamMetadataWritter && jam) {
-        jamMetadataWritter->write(*jam);
+        this->chainedTrackFiles.clear();
+        diskWriter.closeFiles();
+        diskWriter.logMetrics();
     }
 }
 
@@ -189,7 +233,10 @@ void JamRecorder::writeProjectFile() {
 void JamRecorder::newInterval() {
     if (running) {
         globalIntervalIndex++;
-        writeProjectFile();
+        diskWriter.sync();
+        if (jamMetadataWritter) {
+            jamMetadataWritter->newInterval();
+        }
     }
     //        if (newPath == null) {
     //            if (recording) {
@@ -3,19 +3,25 @@
 
 #include <QDir>
 #include <QMap>
+#include "RecordingDiskWriter.h"
 
 namespace Recorder {
 // ++++++++++++++++++++++++++++++++++++++++++++++
 class JamAudioFile
 {
 public:
-    JamAudioFile(QString path, uint intervalIndex);
+    JamAudioFile(QString path, uint intervalIndex, double sourceOffset = 0);
     JamAudioFile();// default construtor to use this class in QMap and QList without pointers
     inline uint getIntervalIndex() const
     {
         return intervalIndex;
     }
 
+    inline double getSourceOffset() const// seconds, the interval start in chained track files
+    {
+        return sourceOffset;
+    }
+
     inline QString getPath() const
     {
         return path;
@@ -24,6 +30,7 @@ public:
 private:
     QString path;
     uint intervalIndex;
+    double sourceOffset;
 };
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 class JamTrack
@@ -31,7 +38,7 @@ class JamTrack
 public:
     JamTrack(QString userName, quint8 channelIndex);
     JamTrack();// default construtor to use this class in QMap and QList without pointers
-    void addAudioFile(QString path, int intervalIndex);
+    void addAudioFile(QString path, int intervalIndex, double sourceOffset = 0);
     inline QString getUserName() const
     {
         return userName;
@@ -58,10 +65,11 @@ class Jam
 public:
     Jam(int bpm, int bpi, int sampleRate, QString jamName, QString baseDir);
 
-    double getIntervalsLenght();
+    double getIntervalsLenght() const;
 
     // called when a new file is writed in disk
-    void addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex);
+    void addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex,
+                      double sourceOffset = 0);
     QString getAudioAbsolutePath() const
     {
         return audioPath;
@@ -100,10 +108,22 @@ private:
     QMap<QString, QMap<quint8, JamTrack> > jamTracks;
 };
 // +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * The metadata is written incrementally, the writers receive only the new audio files in each
+ * interval instead of the whole jam.
+ */
 class JamMetadataWriter
 {
 public:
-    virtual void write(Jam metadata) = 0;
+    virtual ~JamMetadataWriter()
+    {
+    }
+
+    virtual void startJam(const Jam &jam) = 0;
+    virtual void addAudioFile(const QString &userName, quint8 channelIndex,
+                              const JamAudioFile &audioFile) = 0;
+    virtual void newInterval() = 0;
+    virtual void stopJam() = 0;
 };
 // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 class LocalNinjamInterval
@@ -147,7 +167,8 @@ private:
 class JamRecorder
 {
 public:
-    JamRecorder(JamMetadataWriter *jamMetadataWritter);
+    JamRecorder(JamMetadataWriter *jamMetadataWritter);// the recorder owns the writer
+    ~JamRecorder();
     void appendLocalUserAudio(QByteArray encodedaudio, quint8 channelIndex,
                               bool isFirstPartOfInterval, bool isLastPastOfInterval);
     void addRemoteUserAudio(QString userName, QByteArray encodedAudio, quint8 channelIndex);
@@ -159,6 +180,16 @@ public:
     void setBpi(int newBpi);
     void setSampleRate(int newSampleRate);
 
+    // used in the next startRecording(). The intervals of each track are appended in one chained
+    // Ogg file with a sidecar index (see ChainedTrackIndex) instead of one file per interval.
+    void setOneFilePerTrack(bool oneFilePerTrack);
+    void setSyncPolicy(RecordingDiskWriter::SyncPolicy policy);
+
+    inline const RecordingDiskWriter &getDiskWriter() const// back-pressure metrics
+    {
+        return diskWriter;
+    }
+
     void stopRecording();
     void newInterval();
 
@@ -170,13 +201,23 @@ private:
     QString localUserName;
     bool running;
     QDir newPath;// used to set the newPath in the next interval
+    bool oneFilePerTrack;
+    RecordingDiskWriter diskWriter;// all recorded files are written by the disk writer thread
+
+    struct ChainedTrackFile
+    {
+        qint64 size;
+        double duration;
+    };
+    QMap<QString, ChainedTrackFile> chainedTrackFiles;// the track file path as key
 
     QMap<quint8, LocalNinjamInterval> localUserIntervals;// use channel index as key and store encoded bytes. When a full interval is stored the encoded bytes are store in a ogg file.
 
     QString getNewJamName();
-    void writeEncodedFile(const QByteArray &encodedData, QString path);
-    static QString buildAudioFileName(QString userName, quint8 channelIndex, int currentInterval);
-    void writeProjectFile();
+    void saveInterval(QString userName, quint8 channelIndex, int intervalIndex, const QByteArray &encodedData);
+    static QString buildAudioFileName(QString userName, quint8 channelIndex, int currentInterval, const QByteArray &encodedData);
+    static QString buildTrackFileName(QString userName, quint8 channelIndex, const QByteArray &encodedData);
+    void addAudioFile(QString userName, quint8 channelIndex, QString filePath, int intervalIndex, double sourceOffset = 0);
 
 // ++++++++++++++++++++++++++++++++++++++++++++++++
 };
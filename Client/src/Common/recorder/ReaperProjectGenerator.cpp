@@ -1,65 +1,267 @@
 #include "ReaperProjectGenerator.h"
 #include <QUuid>
+#include <QUrl>
+#include <QThread>
+#include <QSaveFile>
+#include <QMutexLocker>
 #include "../log/Logging.h"
 
 using namespace Recorder;
 
+namespace Recorder {
+class ReaperProjectWriterThread : public QThread
+{
+public:
+    explicit ReaperProjectWriterThread(ReaperProjectGenerator *generator) :
+        generator(generator)
+    {
+        start(QThread::LowPriority);
+    }
+
+protected:
+    void run()
+    {
+        generator->processCommands();
+    }
+
+private:
+    ReaperProjectGenerator *generator;
+};
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+ReaperProjectGenerator::ReaperProjectGenerator() :
+    stopThread(false),
+    jamStarted(false),
+    bpm(0),
+    bpi(0),
+    sampleRate(0),
+    projectChanged(false)
+{
+    thread = new ReaperProjectWriterThread(this);
+}
+
+ReaperProjectGenerator::~ReaperProjectGenerator()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopThread = true;
+        hasCommands.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void ReaperProjectGenerator::startJam(const Jam &jam)
+{
+    Command command;
+    command.type = Command::START_JAM;
+    command.audioPath = jam.getAudioAbsolutePath();
+    command.bpm = jam.getBpm();
+    command.bpi = jam.getBpi();
+    command.sampleRate = jam.getSampleRate();
+    enqueue(command);
+}
+
+void ReaperProjectGenerator::addAudioFile(const QString &userName, quint8 channelIndex,
+                                          const JamAudioFile &audioFile)
+{
+    Command command;
+    command.type = Command::ADD_AUDIO_FILE;
+    command.userName = userName;
+    command.channelIndex = channelIndex;
+    command.audioFile = audioFile;
+    enqueue(command);
+}
 
-void ReaperProjectGenerator::write(Jam jam){
-    QString stringBuffer("");
-    stringBuffer.append("<REAPER_PROJECT 0.1 \"4.731\" 1416709867").append("\n");
-    stringBuffer.append("  RECORD_PATH \"audio\" \"\"").append("\n");
-    stringBuffer.append("  SAMPLERATE " + QString::number(jam.getSampleRate()) + "  0 0").append("\n");
-    stringBuffer.append("  TEMPO " + QString::number(jam.getBpm()) + " 4 4").append("\n");
-
-    //generate tracks
-
-    QList<JamTrack> tracks = jam.getJamTracks();
-    for (JamTrack track : tracks) {
-        QString trackName = buildTrackName(track.getUserName(), track.getChannelIndex());
-        QString trackGUID = QUuid::createUuid().toString();
-        stringBuffer.append("  <TRACK "+ trackGUID).append("\n");
-        stringBuffer.append("    NAME \"" + trackName + "\"").append("\n");
-        stringBuffer.append("    TRACKID " + trackGUID).append("\n");
-        QList<JamAudioFile> channelAudioFiles = track.getAudioFiles();
-        int part = 1;
-        for (JamAudioFile audioFile : channelAudioFiles) {
-            double position = (audioFile.getIntervalIndex()-1) * jam.getIntervalsLenght();
-            QString filePath = audioFile.getPath();
-            stringBuffer.append("    <ITEM").append("\n");
-            stringBuffer.append("      POSITION " + QString::number(position)).append("\n");
-            stringBuffer.append("      LENGTH " + QString::number(jam.getIntervalsLenght())).append("\n");
-            stringBuffer.append("      FADEIN 1 0.01 0 1 0 0").append("\n");
-            stringBuffer.append("      FADEOUT 1 0.01 0 1 0 0").append("\n");
-            stringBuffer.append("      IID " + QString::number(part)).append("\n");
-            stringBuffer.append("      IGUID "+ QUuid::createUuid().toString()).append("\n");
-            stringBuffer.append("      NAME \"" + QFileInfo(audioFile.getPath()).baseName() + "\"").append("\n");
-            stringBuffer.append("      GUID "+ trackGUID).append("\n");
-            stringBuffer.append("      <SOURCE VORBIS").append("\n");
-            stringBuffer.append("        FILE \"" + filePath + "\"").append("\n");
-            stringBuffer.append("      >").append("\n");//close SOURCE VORBIS
-            stringBuffer.append("    >").append("\n");//close item
-            part++;
+void ReaperProjectGenerator::newInterval()
+{
+    Command command;
+    command.type = Command::NEW_INTERVAL;
+    enqueue(command);
+}
+
+void ReaperProjectGenerator::stopJam()
+{
+    Command command;
+    command.type = Command::STOP_JAM;
+    enqueue(command);
+}
+
+void ReaperProjectGenerator::enqueue(const Command &command)
+{
+    QMutexLocker locker(&mutex);
+    commands.append(command);
+    hasCommands.wakeAll();
+}
+
+// ++++++++++++++ writer thread +++++++++++++++
+
+void ReaperProjectGenerator::processCommands()
+{
+    QMutexLocker locker(&mutex);
+    forever {
+        if (commands.isEmpty()) {
+            if (stopThread)
+                break;
+            hasCommands.wait(&mutex);
+            continue;
         }
-        stringBuffer.append("  >").append("\n");//close track
+        QList<Command> pendingCommands = commands;
+        commands.clear();
+        locker.unlock();// the GUI thread is not blocked while the files are written
+        for (const Command &command : pendingCommands)
+            execute(command);
+        locker.relock();
     }
+    locker.unlock();
 
-    stringBuffer.append(">");//close the root tag
-    //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-    //save
-    QDir jamDir = QDir(jam.getAudioAbsolutePath());
-    jamDir.cdUp();
-    QFile projectFile(jamDir.absoluteFilePath("Reaper project.rpp"));
-    if(!projectFile.open(QFile::WriteOnly)){
-        qCCritical(jtJamRecorder) << "Can't write the reaper project file in " << jamDir;
+    if (jamStarted) {// the recorder was destroyed without stop the jam
+        Command command;
+        command.type = Command::STOP_JAM;
+        execute(command);
     }
-    QTextStream stream(&projectFile);
-    QByteArray byteArray(stringBuffer.toUtf8());
-    stream << byteArray;
-    //projectFile.write(stringBuffer.toStdString().c_str(), stringBuffer.size());
 }
 
+void ReaperProjectGenerator::execute(const Command &command)
+{
+    switch (command.type) {
+    case Command::START_JAM:
+    {
+        if (jamStarted) {
+            Command stop;
+            stop.type = Command::STOP_JAM;
+            execute(stop);
+        }
+        bpm = command.bpm;
+        bpi = command.bpi;
+        sampleRate = command.sampleRate;
+        tracks.clear();
+
+        QDir jamDir(command.audioPath);
+        jamDir.cdUp();
+        projectFilePath = jamDir.absoluteFilePath("Reaper project.rpp");
+        journal.setFileName(jamDir.absoluteFilePath("Reaper project.journal"));
+        if (!journal.open(QFile::WriteOnly | QFile::Truncate))
+            qCCritical(jtJamRecorder) << "Can't write the reaper project journal in " << jamDir;
+        journal.write(QString("JAM %1 %2 %3\n").arg(bpm).arg(bpi).arg(sampleRate).toUtf8());
+        journal.flush();
+
+        jamStarted = true;
+        projectChanged = true;
+        writeProjectFile();// the empty project
+        break;
+    }
+    case Command::ADD_AUDIO_FILE:
+        if (jamStarted)
+            appendItem(command.userName, command.channelIndex, command.audioFile);
+        break;
+    case Command::NEW_INTERVAL:
+        if (!jamStarted)
+            break;
+        journal.flush();// the items added in the last interval
+        if (projectChanged && lastCheckpoint.hasExpired(CHECKPOINT_PERIOD))
+            writeProjectFile();
+        break;
+    case Command::STOP_JAM:
+        if (!jamStarted)
+            break;
+        writeProjectFile();
+        if (!projectChanged)// the project is complete, the journal is not necessary
+            journal.remove();
+        else
+            journal.close();
+        jamStarted = false;
+        tracks.clear();
+        break;
+    }
+}
+
+void ReaperProjectGenerator::appendItem(const QString &userName, quint8 channelIndex,
+                                        const JamAudioFile &audioFile)
+{
+    QMap<quint8, Track> &userTracks = tracks[userName];
+    if (!userTracks.contains(channelIndex)) {
+        Track track;
+        track.name = buildTrackName(userName, channelIndex);
+        track.guid = QUuid::createUuid().toString();
+        track.itemsCount = 0;
+        userTracks.insert(channelIndex, track);
+    }
+    Track &track = userTracks[channelIndex];
+
+    double intervalsLenght = getIntervalsLenght();
+    double position = (audioFile.getIntervalIndex()-1) * intervalsLenght;
+    QString filePath = audioFile.getPath();
+    QString sourceType = filePath.endsWith(".opus") ? "OPUS" : "VORBIS";
+    QString item;
+    item.append("    <ITEM").append("\n");
+    item.append("      POSITION " + QString::number(position)).append("\n");
+    item.append("      LENGTH " + QString::number(intervalsLenght)).append("\n");
+    item.append("      FADEIN 1 0.01 0 1 0 0").append("\n");
+    item.append("      FADEOUT 1 0.01 0 1 0 0").append("\n");
+    item.append("      IID " + QString::number(++track.itemsCount)).append("\n");
+    item.append("      IGUID " + QUuid::createUuid().toString()).append("\n");
+    item.append("      NAME \"" + QFileInfo(filePath).baseName() + "\"").append("\n");
+    item.append("      SOFFS " + QString::number(audioFile.getSourceOffset())).append("\n");
+    item.append("      GUID " + track.guid).append("\n");
+    item.append("      <SOURCE " + sourceType).append("\n");
+    item.append("        FILE \"" + filePath + "\"").append("\n");
+    item.append("      >").append("\n");// close SOURCE
+    item.append("    >").append("\n");// close item
+    track.items.append(item.toUtf8());
+
+    journal.write("ITEM " + QByteArray::number(audioFile.getIntervalIndex()) + " "
+                  + QByteArray::number(channelIndex) + " "
+                  + QUrl::toPercentEncoding(userName) + " "
+                  + QUrl::toPercentEncoding(filePath) + " "
+                  + QByteArray::number(audioFile.getSourceOffset()) + "\n");
+    projectChanged = true;
+}
+
+void ReaperProjectGenerator::writeProjectFile()
+{
+    QSaveFile projectFile(projectFilePath);// written in a temporary file and renamed in commit()
+    if (!projectFile.open(QFile::WriteOnly)) {
+        qCCritical(jtJamRecorder) << "Can't write the reaper project file " << projectFilePath;
+        return;
+    }
+
+    QString header;
+    header.append("<REAPER_PROJECT 0.1 \"4.731\" 1416709867").append("\n");
+    header.append("  RECORD_PATH \"audio\" \"\"").append("\n");
+    header.append("  SAMPLERATE " + QString::number(sampleRate) + "  0 0").append("\n");
+    header.append("  TEMPO " + QString::number(bpm) + " 4 4").append("\n");
+    projectFile.write(header.toUtf8());
+
+    for (const QMap<quint8, Track> &userTracks : tracks) {
+        for (const Track &track : userTracks) {
+            QString trackHeader;
+            trackHeader.append("  <TRACK " + track.guid).append("\n");
+            trackHeader.append("    NAME \"" + track.name + "\"").append("\n");
+            trackHeader.append("    TRACKID " + track.guid).append("\n");
+            projectFile.write(trackHeader.toUtf8());
+            projectFile.write(track.items);
+            projectFile.write("  >\n");// close track
+        }
+    }
+    projectFile.write(">");// close the root tag
+
+    if (!projectFile.commit()) {
+        qCCritical(jtJamRecorder) << "Can't write the reaper project file " << projectFilePath
+                                  << projectFile.errorString();
+        return;
+    }
+    projectChanged = false;
+    lastCheckpoint.start();
+}
+
+double ReaperProjectGenerator::getIntervalsLenght() const
+{
+    return 60.0/bpm * (double)bpi;
+}
 
-QString ReaperProjectGenerator::buildTrackName(QString userName, quint8 channelIndex) {
+QString ReaperProjectGenerator::buildTrackName(QString userName, quint8 channelIndex)
+{
     return userName + " (Channel " + QString::number(channelIndex+1) + ")";
 }
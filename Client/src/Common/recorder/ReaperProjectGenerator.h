@@ -2,14 +2,96 @@
 #define __REAPER_PROJECT_GENERATOR__
 
 #include "JamRecorder.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QElapsedTimer>
 
 namespace Recorder {
+class ReaperProjectWriterThread;
+
+/**
+ * Writes the Reaper project (RPP) of the recorded jams. The new items are appended in a journal
+ * file in each interval, the complete RPP is rewritten only in the checkpoints (at most one time
+ * each CHECKPOINT_PERIOD) and when the jam is stopped. The RPP is replaced atomically (temp file +
+ * rename), a crash never leaves a truncated project.
+ *
+ * The items are rendered one time when they are added, the files are written by a background
+ * thread and the GUI thread only enqueue the commands.
+ *
+ * The journal is removed when the jam is stopped. If the application crash the journal keeps all
+ * the recorded items, one per line:
+ *     JAM <bpm> <bpi> <sampleRate>
+ *     ITEM <intervalIndex> <channelIndex> <percent encoded user name> <percent encoded file path>
+ *          <source offset>
+ */
 class ReaperProjectGenerator : public JamMetadataWriter
 {
+    friend class ReaperProjectWriterThread;
+
 public:
-    void write(Jam jam);
+    ReaperProjectGenerator();
+    ~ReaperProjectGenerator();// the pending commands are executed before the thread finish
+
+    void startJam(const Jam &jam);
+    void addAudioFile(const QString &userName, quint8 channelIndex, const JamAudioFile &audioFile);
+    void newInterval();
+    void stopJam();
+
+    static const qint64 CHECKPOINT_PERIOD = 60000;// milliseconds
 
 private:
+    struct Command
+    {
+        enum Type {
+            START_JAM,
+            ADD_AUDIO_FILE,
+            NEW_INTERVAL,
+            STOP_JAM
+        };
+
+        Type type;
+        QString audioPath;// START_JAM
+        QString userName;
+        quint8 channelIndex;
+        JamAudioFile audioFile;
+        int bpm;
+        int bpi;
+        int sampleRate;
+    };
+
+    struct Track
+    {
+        QString name;
+        QString guid;
+        QByteArray items;// rendered RPP items, appended when the files are added
+        int itemsCount;
+    };
+
+    ReaperProjectWriterThread *thread;
+    QMutex mutex;
+    QWaitCondition hasCommands;
+    QList<Command> commands;// protected by 'mutex'
+    bool stopThread;// protected by 'mutex'
+
+    // writer thread
+    bool jamStarted;
+    int bpm;
+    int bpi;
+    int sampleRate;
+    QString projectFilePath;
+    QFile journal;
+    QMap<QString, QMap<quint8, Track> > tracks;// the same order used in Jam::getJamTracks()
+    bool projectChanged;
+    QElapsedTimer lastCheckpoint;
+
+    void enqueue(const Command &command);
+    void processCommands();
+    void execute(const Command &command);
+    void appendItem(const QString &userName, quint8 channelIndex, const JamAudioFile &audioFile);
+    void writeProjectFile();
+    double getIntervalsLenght() const;
+
     static QString buildTrackName(QString userName, quint8 channelIndex);
 };
 }
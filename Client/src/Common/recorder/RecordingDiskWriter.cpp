@@ -0,0 +1,231 @@
+#include "RecordingDiskWriter.h"
+#include "log/Logging.h"
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QFile>
+
+#if defined(Q_OS_WIN)
+    #include <windows.h>
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+using namespace Recorder;
+
+RecordingDiskWriter::RecordingDiskWriter(qint64 queueCapacity) :
+    queueCapacity(queueCapacity),
+    stopRequested(false),
+    syncPolicy(SyncPolicy::EACH_INTERVAL),
+    queuedBytes(0),
+    maxQueuedBytes(0),
+    writtenBytes(0),
+    batches(0),
+    writes(0),
+    stalls(0),
+    stalledTime(0)
+{
+    start(QThread::LowPriority);
+}
+
+RecordingDiskWriter::~RecordingDiskWriter()
+{
+    QMutexLocker locker(&mutex);
+    stopRequested = true;
+    requestsAvailable.wakeAll();
+    locker.unlock();
+
+    wait();// the queued writes are executed before the thread finish
+}
+
+void RecordingDiskWriter::setSyncPolicy(SyncPolicy policy)
+{
+    QMutexLocker locker(&mutex);
+    syncPolicy = policy;
+}
+
+void RecordingDiskWriter::write(const QString &filePath, const QByteArray &data)
+{
+    Request request;
+    request.type = Request::WRITE;
+    request.filePath = filePath;
+    request.data = data;
+    enqueue(request);
+}
+
+void RecordingDiskWriter::append(const QString &filePath, const QByteArray &data)
+{
+    Request request;
+    request.type = Request::APPEND;
+    request.filePath = filePath;
+    request.data = data;
+    enqueue(request);
+}
+
+void RecordingDiskWriter::sync()
+{
+    Request request;
+    request.type = Request::SYNC;
+    enqueue(request);
+}
+
+void RecordingDiskWriter::closeFiles()
+{
+    Request request;
+    request.type = Request::CLOSE_FILES;
+    enqueue(request);
+}
+
+void RecordingDiskWriter::enqueue(const Request &request)
+{
+    QMutexLocker locker(&mutex);
+    qint64 bytes = request.data.size();
+    if (!queue.isEmpty() && queuedBytes.load() + bytes > queueCapacity) {
+        // back-pressure, the disk is slower than the recorded streams
+        stalls.fetch_add(1);
+        QElapsedTimer timer;
+        timer.start();
+        while (!queue.isEmpty() && queuedBytes.load() + bytes > queueCapacity)
+            spaceAvailable.wait(&mutex);
+        stalledTime.fetch_add(timer.elapsed());
+    }
+
+    queue.enqueue(request);// implicitly shared, the bytes are not copied
+    qint64 totalBytes = queuedBytes.fetch_add(bytes) + bytes;
+    if (totalBytes > maxQueuedBytes.load())
+        maxQueuedBytes.store(totalBytes);
+    requestsAvailable.wakeOne();
+}
+
+void RecordingDiskWriter::run()
+{
+    QList<Request> batch;
+    QList<QFile *> appendedFiles;
+    QMutexLocker locker(&mutex);
+    forever {
+        if (queue.isEmpty()) {
+            if (stopRequested)
+                break;
+            requestsAvailable.wait(&mutex);
+            continue;
+        }
+
+        // all queued requests are executed without the lock
+        batch.reserve(queue.size());
+        while (!queue.isEmpty())
+            batch.append(queue.dequeue());
+        SyncPolicy policy = syncPolicy;
+        locker.unlock();
+
+        qint64 batchBytes = 0;
+        for (const Request &request : batch) {
+            execute(request, policy, appendedFiles);
+            batchBytes += request.data.size();
+        }
+        for (QFile *file : appendedFiles) {// one flush per file in each batch
+            if (policy == SyncPolicy::EACH_BATCH)
+                syncToDisk(file);
+            else
+                file->flush();
+        }
+        appendedFiles.clear();
+        batch.clear();
+        batches.fetch_add(1);
+
+        locker.relock();
+        queuedBytes.fetch_sub(batchBytes);
+        spaceAvailable.wakeAll();
+    }
+    locker.unlock();
+
+    closeOpenFiles();
+}
+
+void RecordingDiskWriter::execute(const Request &request, SyncPolicy policy,
+                                  QList<QFile *> &appendedFiles)
+{
+    switch (request.type) {
+    case Request::WRITE:
+    {
+        QFile file(request.filePath);
+        if (!file.open(QFile::WriteOnly)) {
+            qCCritical(jtJamRecorder) << "can't open file " << request.filePath;
+            return;
+        }
+        file.write(request.data);
+        if (policy == SyncPolicy::EACH_BATCH)
+            syncToDisk(&file);
+        writes.fetch_add(1);
+        writtenBytes.fetch_add(request.data.size());
+        qCDebug(jtJamRecorder) << "file writed:" << request.filePath;
+        break;
+    }
+    case Request::APPEND:
+    {
+        QFile *file = getOpenFile(request.filePath);
+        if (!file)
+            return;
+        if (file->write(request.data) != request.data.size())
+            qCCritical(jtJamRecorder) << "can't write in the file " << request.filePath << file->errorString();
+        if (!appendedFiles.contains(file))
+            appendedFiles.append(file);
+        writes.fetch_add(1);
+        writtenBytes.fetch_add(request.data.size());
+        break;
+    }
+    case Request::SYNC:
+        if (policy == SyncPolicy::EACH_INTERVAL) {
+            for (QFile *file : openFiles)
+                syncToDisk(file);
+        }
+        break;
+    case Request::CLOSE_FILES:
+        closeOpenFiles();
+        appendedFiles.clear();
+        break;
+    }
+}
+
+QFile *RecordingDiskWriter::getOpenFile(const QString &filePath)
+{
+    QFile *file = openFiles.value(filePath, nullptr);
+    if (file)
+        return file;
+
+    file = new QFile(filePath);
+    if (!file->open(QFile::WriteOnly | QFile::Append)) {
+        qCCritical(jtJamRecorder) << "can't open file " << filePath;
+        delete file;
+        return nullptr;
+    }
+    openFiles.insert(filePath, file);
+    return file;
+}
+
+void RecordingDiskWriter::closeOpenFiles()
+{
+    for (QFile *file : openFiles)
+        delete file;// flushed and closed
+    openFiles.clear();
+}
+
+bool RecordingDiskWriter::syncToDisk(QFile *file)
+{
+    if (!file->flush())
+        return false;
+#if defined(Q_OS_WIN)
+    return FlushFileBuffers((HANDLE)_get_osfhandle(file->handle()));
+#else
+    return fsync(file->handle()) == 0;
+#endif
+}
+
+void RecordingDiskWriter::logMetrics() const
+{
+    int batchesCount = batches.load();
+    qCDebug(jtJamRecorder) << "Recorded" << getWrittenBytes() << "bytes," << getWrites()
+                           << "writes in" << batchesCount << "batches ("
+                           << (batchesCount > 0 ? (double)getWrites() / batchesCount : 0.0)
+                           << "writes per batch), max queued bytes:" << getMaxQueuedBytes()
+                           << "queue full" << getStalls() << "times," << getStalledTime() << "ms";
+}
@@ -0,0 +1,132 @@
+#ifndef RECORDING_DISK_WRITER_H
+#define RECORDING_DISK_WRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QMap>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+class QFile;
+
+namespace Recorder {
+/**
+ * Write the recorded files in a dedicated thread.
+ *
+ * All queued writes are executed in batches: the files appended in a batch are kept open, flushed
+ * one time in the end of the batch and synced to the disk following the SyncPolicy. The queue is
+ * bounded, when the disk can't keep up the threads queueing the writes wait until there is space
+ * (back-pressure), the waits are counted in the metrics.
+ */
+class RecordingDiskWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum class SyncPolicy {
+        NEVER,// the OS decides when the data is written in the disk
+        EACH_INTERVAL,// in sync()
+        EACH_BATCH
+    };
+
+    explicit RecordingDiskWriter(qint64 queueCapacity = DEFAULT_QUEUE_CAPACITY);
+    ~RecordingDiskWriter();// the queued writes are finished
+
+    void setSyncPolicy(SyncPolicy policy);
+
+    // thread safe, the data is not copied. Wait if the queue is full.
+    void write(const QString &filePath, const QByteArray &data);// create or replace the file
+    void append(const QString &filePath, const QByteArray &data);// the file is kept open
+
+    void sync();// the open files are synced when the policy is EACH_INTERVAL
+    void closeFiles();// close the appended files after the queued writes
+
+    // metrics, can be read from any thread
+    inline qint64 getQueuedBytes() const
+    {
+        return queuedBytes.load();
+    }
+
+    inline qint64 getMaxQueuedBytes() const
+    {
+        return maxQueuedBytes.load();
+    }
+
+    inline qint64 getWrittenBytes() const
+    {
+        return writtenBytes.load();
+    }
+
+    inline int getBatches() const
+    {
+        return batches.load();
+    }
+
+    inline int getWrites() const
+    {
+        return writes.load();
+    }
+
+    inline int getStalls() const// the queue was full
+    {
+        return stalls.load();
+    }
+
+    inline qint64 getStalledTime() const// ms waiting for space in the queue
+    {
+        return stalledTime.load();
+    }
+
+    void logMetrics() const;
+
+    static const qint64 DEFAULT_QUEUE_CAPACITY = 32 * 1024 * 1024;
+
+protected:
+    void run();
+
+private:
+    struct Request
+    {
+        enum Type {
+            WRITE,
+            APPEND,
+            SYNC,
+            CLOSE_FILES
+        };
+
+        Type type;
+        QString filePath;
+        QByteArray data;
+    };
+
+    const qint64 queueCapacity;
+    QMutex mutex;
+    QWaitCondition requestsAvailable;
+    QWaitCondition spaceAvailable;
+    QQueue<Request> queue;
+    bool stopRequested;
+    SyncPolicy syncPolicy;// protected by 'mutex'
+
+    QMap<QString, QFile *> openFiles;// writer thread
+
+    std::atomic<qint64> queuedBytes;
+    std::atomic<qint64> maxQueuedBytes;
+    std::atomic<qint64> writtenBytes;
+    std::atomic<int> batches;
+    std::atomic<int> writes;
+    std::atomic<int> stalls;
+    std::atomic<qint64> stalledTime;
+
+    void enqueue(const Request &request);
+    void execute(const Request &request, SyncPolicy policy, QList<QFile *> &appendedFiles);
+    QFile *getOpenFile(const QString &filePath);
+    void closeOpenFiles();
+
+    static bool syncToDisk(QFile *file);
+};
+}
+
+#endif // RECORDING_DISK_WRITER_H
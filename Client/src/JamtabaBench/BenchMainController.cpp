@@ -0,0 +1,89 @@
+#include "BenchMainController.h"
+#include "audio/NinjamTrackNode.h"
+#include "midi/MidiDriver.h"
+
+BenchMainController::BenchMainController(Persistence::Settings settings, int sampleRate) :
+    MainController(settings),
+    sampleRate(sampleRate),
+    newIntervalStarted(false),
+    midiBuffer(0)
+{
+    MainController::setSampleRate(sampleRate);
+}
+
+QString BenchMainController::getJamtabaFlavor() const
+{
+    return "Bench";
+}
+
+Controller::NinjamController *BenchMainController::createNinjamController(MainController *c)
+{
+    Controller::NinjamController *controller = new Controller::NinjamController(c);
+    // connected before the controller start, the tracks of the users in the server are created in start()
+    QObject::connect(controller, SIGNAL(channelAdded(Ninjam::User, Ninjam::UserChannel, long)),
+                     this, SLOT(addRemoteTrack(Ninjam::User, Ninjam::UserChannel, long)));
+    QObject::connect(controller, SIGNAL(startingNewInterval()), this, SLOT(setNewIntervalFlag()),
+                     Qt::DirectConnection);
+    return controller;
+}
+
+void BenchMainController::enterInRoom(const Ninjam::Server &server)
+{
+    remoteTrackIDs.clear();
+    connectedNinjamServer(server);
+}
+
+void BenchMainController::downloadInterval(const Ninjam::User &user, int channelIndex,
+                                           const QByteArray &interval)
+{
+    int offset = 0;
+    do {
+        QByteArray chunk = interval.mid(offset, DOWNLOAD_CHUNK_SIZE);
+        offset += chunk.size();
+        bool isFirstPart = offset == chunk.size();
+        bool isLastPart = offset >= interval.size();
+        emit ninjamService.audioIntervalChunkDownloaded(user, channelIndex, chunk, isFirstPart,
+                                                       isLastPart);
+    } while (offset < interval.size());
+}
+
+quint64 BenchMainController::getUnderruns()
+{
+    quint64 underruns = 0;
+    foreach (long trackID, remoteTrackIDs) {
+        NinjamTrackNode *trackNode = dynamic_cast<NinjamTrackNode *>(getTrackNode(trackID));
+        if (trackNode)
+            underruns += trackNode->getUnderruns();
+    }
+    return underruns;
+}
+
+bool BenchMainController::takeNewIntervalFlag()
+{
+    Controller::NinjamController *controller = getNinjamController();
+    if (controller)// the bench has no event loop, the audio events are emitted here
+        controller->emitAudioEvents();
+    bool flag = newIntervalStarted;
+    newIntervalStarted = false;
+    return flag;
+}
+
+const Midi::MidiBuffer &BenchMainController::pullMidiBuffer(int frames, int sampleRate)
+{
+    Q_UNUSED(frames);
+    Q_UNUSED(sampleRate);
+    return midiBuffer;// always empty
+}
+
+void BenchMainController::addRemoteTrack(Ninjam::User user, Ninjam::UserChannel channel,
+                                         long channelID)
+{
+    Q_UNUSED(user);
+    Q_UNUSED(channel);
+    remoteTrackIDs.append(channelID);
+}
+
+void BenchMainController::setNewIntervalFlag()
+{
+    newIntervalStarted = true;// emitted in the benchmark thread, see takeNewIntervalFlag()
+}
@@ -0,0 +1,100 @@
+#ifndef BENCH_MAIN_CONTROLLER_H
+#define BENCH_MAIN_CONTROLLER_H
+
+#include "MainController.h"
+#include "NinjamController.h"
+
+/**
+ * MainController used by the offline benchmark. There is no audio driver, no GUI and no network,
+ * the benchmark calls process() in a loop (like a null audio driver running faster than real time)
+ * and the downloaded intervals are injected in the ninjam service signals.
+ */
+class BenchMainController : public Controller::MainController
+{
+    Q_OBJECT
+
+public:
+    BenchMainController(Persistence::Settings settings, int sampleRate);
+
+    QString getJamtabaFlavor() const override;
+
+    inline int getSampleRate() const override
+    {
+        return sampleRate;
+    }
+
+    inline Audio::Plugin *createPluginInstance(const Audio::PluginDescriptor &descriptor) override
+    {
+        Q_UNUSED(descriptor);
+        return nullptr;
+    }
+
+    inline void addDefaultPluginsScanPath() override
+    {
+    }
+
+    inline void scanPlugins(bool scanOnlyNewPlugins) override
+    {
+        Q_UNUSED(scanOnlyNewPlugins)
+    }
+
+    // create the remote users tracks like a connection in a real server
+    void enterInRoom(const Ninjam::Server &server);
+
+    // deliver one encoded interval split in download chunks, like the ninjam service
+    void downloadInterval(const Ninjam::User &user, int channelIndex, const QByteArray &interval);
+
+    inline const QList<long> &getRemoteTrackIDs() const
+    {
+        return remoteTrackIDs;
+    }
+
+    quint64 getUnderruns();// sum of all remote tracks underruns
+
+    // true one time after each interval start, the benchmark download more intervals
+    bool takeNewIntervalFlag();
+
+    static const int DOWNLOAD_CHUNK_SIZE = 4096;
+
+protected:
+    inline Vst::PluginFinder *createPluginFinder() override
+    {
+        return nullptr;
+    }
+
+    Controller::NinjamController *createNinjamController(MainController *c) override;
+
+    inline void setCSS(QString css) override
+    {
+        Q_UNUSED(css);
+    }
+
+    const Midi::MidiBuffer &pullMidiBuffer(int frames, int sampleRate) override;
+
+    inline void connectInLoginServer() override
+    {
+        // offline, the public rooms are not used
+    }
+
+protected slots:
+    inline void on_ninjamStartProcessing(int intervalPosition) override
+    {
+        Q_UNUSED(intervalPosition);
+    }
+
+    inline void on_audioDriverStarted() override
+    {
+    }
+
+private slots:
+    void addRemoteTrack(Ninjam::User user, Ninjam::UserChannel channel, long channelID);
+    void setNewIntervalFlag();
+
+private:
+    int sampleRate;
+    QList<long> remoteTrackIDs;
+    bool newIntervalStarted;
+    Midi::MidiBuffer midiBuffer;
+};
+
+#endif // BENCH_MAIN_CONTROLLER_H
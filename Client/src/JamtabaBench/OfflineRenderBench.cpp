@@ -0,0 +1,206 @@
+#include "OfflineRenderBench.h"
+#include "BenchMainController.h"
+#include "ninjam/Server.h"
+#include "ninjam/User.h"
+#include "audio/IntervalCodec.h"
+#include "audio/core/AudioNode.h"
+#include "audio/core/SamplesBuffer.h"
+#include "audio/core/RtViolationDetector.h"
+#include "persistence/Settings.h"
+#include <QDebug>
+#include <QDirIterator>
+#include <QFile>
+#include <QScopedPointer>
+#include <QThread>
+#include <cmath>
+
+using namespace Audio;
+
+OfflineRenderBench::OfflineRenderBench(const QList<QByteArray> &encodedIntervals) :
+    encodedIntervals(encodedIntervals)
+{
+}
+
+const QByteArray &OfflineRenderBench::getInterval(int user, int intervalIndex, int users) const
+{
+    // the users don't play the same interval at same time when there are enough intervals
+    return encodedIntervals.at((intervalIndex * users + user) % encodedIntervals.size());
+}
+
+BenchResult OfflineRenderBench::run(const BenchScenario &scenario)
+{
+    BenchResult result;
+    result.scenario = scenario;
+    result.blocks = 0;
+    result.blocksPerSecond = 0;
+    result.realTimeFactor = 0;
+    result.averageBlockTime = 0;
+    result.worstBlockTime = 0;
+    result.budget = DspProfiler::getBudget(scenario.blockSize, scenario.sampleRate);
+    result.allocationsPerBlock = 0;
+    result.locksPerBlock = 0;
+    result.underruns = 0;
+    if (encodedIntervals.isEmpty())
+        return result;
+
+    Persistence::Settings settings;// the defaults, the user settings file is not loaded
+    settings.setRenderThreads(scenario.renderThreads);
+    BenchMainController controller(settings, scenario.sampleRate);
+    controller.start();
+
+    Ninjam::Server server("localhost", 2049, 1, scenario.users);
+    server.setBpm(scenario.bpm);
+    server.setBpi(scenario.bpi);
+    QStringList userNames;
+    for (int u = 0; u < scenario.users; ++u) {
+        QString fullName = "bench" + QString::number(u + 1) + "@127.0.0.1";
+        server.addUser(Ninjam::User(fullName));
+        server.getUser(fullName)->addChannel(Ninjam::UserChannel(fullName, "Channel 1", true, 0, 0,
+                                                                 0, 0));
+        userNames.append(fullName);
+    }
+    controller.enterInRoom(server);
+
+    // one interval playing and the next one downloaded, like in a normal jam
+    int downloadedIntervals = 0;
+    for (; downloadedIntervals < 2; ++downloadedIntervals) {
+        for (int u = 0; u < userNames.size(); ++u)
+            controller.downloadInterval(*server.getUser(userNames.at(u)), 0,
+                                        getInterval(u, downloadedIntervals, userNames.size()));
+    }
+    QThread::msleep(DECODERS_WARM_UP_TIME);// the decoding thread pre-render the first samples
+
+    bool profilerWasEnabled = DspProfiler::isEnabled();
+    DspProfiler::setEnabled(true);
+    DspProfiler::reset();
+    RtViolationDetector::reset();
+
+    SamplesBuffer in(2, scenario.blockSize);
+    SamplesBuffer out(2, scenario.blockSize);
+    in.zero();
+
+    const qint64 samplesInInterval = (qint64)scenario.sampleRate * 60 * scenario.bpi / scenario.bpm;
+    const qint64 framesToRender = samplesInInterval * scenario.intervals;
+    qint64 renderedFrames = 0;
+    qint64 totalTime = 0;
+    const qint64 benchStart = DspProfiler::now();
+    while (renderedFrames < framesToRender) {
+        out.zero();
+        qint64 blockStart = DspProfiler::now();
+        controller.process(in, out, scenario.sampleRate);
+        qint64 blockTime = DspProfiler::now() - blockStart;
+
+        totalTime += blockTime;
+        result.worstBlockTime = qMax(result.worstBlockTime, blockTime);
+        result.blocks++;
+        renderedFrames += scenario.blockSize;
+
+        // the next intervals are 'downloaded' outside the measured time
+        if (controller.takeNewIntervalFlag()) {
+            for (int u = 0; u < userNames.size(); ++u)
+                controller.downloadInterval(*server.getUser(userNames.at(u)), 0,
+                                            getInterval(u, downloadedIntervals, userNames.size()));
+            downloadedIntervals++;
+        }
+
+        if (scenario.speed > 0) {
+            qint64 elapsed = DspProfiler::now() - benchStart;
+            qint64 expected = (qint64)(renderedFrames * 1000000000.0 / scenario.sampleRate
+                                       / scenario.speed);
+            if (expected > elapsed)
+                QThread::usleep((expected - elapsed) / 1000);
+        }
+    }
+
+    if (totalTime > 0) {
+        double seconds = totalTime / 1000000000.0;
+        result.blocksPerSecond = result.blocks / seconds;
+        result.realTimeFactor = ((double)renderedFrames / scenario.sampleRate) / seconds;
+        result.averageBlockTime = totalTime / (qint64)result.blocks;
+    }
+    result.allocationsPerBlock = (double)RtViolationDetector::getAllocations() / result.blocks;
+    result.locksPerBlock = (double)RtViolationDetector::getLocks() / result.blocks;
+    result.underruns = controller.getUnderruns();
+
+    // collected before the controller is destroyed, the track histograms are deleted with the nodes
+    result.profile = DspProfiler::getStatistics();
+    QStringList trackNames;
+    foreach (long trackID, controller.getRemoteTrackIDs()) {
+        AudioNode *trackNode = controller.getTrackNode(trackID);
+        if (trackNode)
+            trackNames.append(trackNode->getProfileName());
+    }
+    foreach (const ProfileStatistics &statistics, result.profile) {
+        if (trackNames.contains(statistics.name))
+            result.tracks.append(statistics);
+    }
+
+    DspProfiler::setEnabled(profilerWasEnabled);
+    controller.stop();
+    return result;
+}
+
+QList<QByteArray> OfflineRenderBench::loadIntervals(const QString &path)
+{
+    QStringList fileNames;
+    QDirIterator iterator(path, QStringList() << "*.ogg" << "*.opus", QDir::Files,
+                          QDirIterator::Subdirectories);
+    while (iterator.hasNext())
+        fileNames.append(iterator.next());
+    fileNames.sort();// the same order in all runs
+
+    QList<QByteArray> intervals;
+    foreach (const QString &fileName, fileNames) {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly)) {
+            qWarning() << "can't open the interval file" << fileName;
+            continue;
+        }
+        QByteArray interval = file.readAll();
+        if (!IntervalCodecs::isSupported(IntervalCodecs::detect(interval))) {
+            qWarning() << "skipping the interval file" << fileName << "(codec not supported)";
+            continue;
+        }
+        intervals.append(interval);
+    }
+    return intervals;
+}
+
+QList<QByteArray> OfflineRenderBench::createSyntheticIntervals(int count, int sampleRate,
+                                                               int seconds)
+{
+    static const int BLOCK_FRAMES = 2048;// the encoding threads receive blocks like this
+    QList<QByteArray> intervals;
+    QScopedPointer<IntervalEncoder> encoder(IntervalCodecs::createEncoder(IntervalCodec::VORBIS, 2,
+                                                                          sampleRate));
+    SamplesBuffer block(2, BLOCK_FRAMES);
+    quint32 noise = 12345;// fixed seed, the same intervals in all runs
+    for (int i = 0; i < count; ++i) {
+        // some harmonics and noise, closer to music than a pure sine wave
+        double frequency = 110.0 * (1 + i % 4);
+        QByteArray interval;
+        int framesToEncode = sampleRate * seconds;
+        int frame = 0;
+        while (frame < framesToEncode) {
+            int frames = qMin(BLOCK_FRAMES, framesToEncode - frame);
+            block.setFrameLenght(frames);
+            float *left = block.getSamplesArray(0);
+            float *right = block.getSamplesArray(1);
+            for (int s = 0; s < frames; ++s) {
+                double t = (double)(frame + s) / sampleRate;
+                double value = 0;
+                for (int h = 1; h <= 4; ++h)
+                    value += std::sin(2 * M_PI * frequency * h * t) / (h * 4.0);
+                noise = noise * 1664525 + 1013904223;
+                double white = ((noise >> 8) / 8388608.0 - 1.0) * 0.05;
+                left[s] = (float)(value + white);
+                right[s] = (float)(value - white);
+            }
+            interval.append(encoder->encode(block));
+            frame += frames;
+        }
+        interval.append(encoder->finishIntervalEncoding());
+        intervals.append(interval);
+    }
+    return intervals;
+}
@@ -0,0 +1,63 @@
+#ifndef OFFLINE_RENDER_BENCH_H
+#define OFFLINE_RENDER_BENCH_H
+
+#include <QList>
+#include <QByteArray>
+#include <QString>
+#include "audio/core/DspProfiler.h"
+
+struct BenchScenario
+{
+    int users;// remote users, one channel each
+    int blockSize;// frames rendered in each audio callback
+    int sampleRate;
+    int bpm;
+    int bpi;
+    int intervals;// rendered intervals
+    int renderThreads;
+    double speed;// real time multiplier, zero to render as fast as possible
+};
+
+struct BenchResult
+{
+    BenchScenario scenario;
+    quint64 blocks;
+    double blocksPerSecond;
+    double realTimeFactor;// rendered audio time / render time
+    qint64 averageBlockTime;// nanoseconds
+    qint64 worstBlockTime;
+    qint64 budget;// the audio callback deadline
+    double allocationsPerBlock;// always zero if JT_RT_VIOLATION_DETECTOR is not defined
+    double locksPerBlock;
+    quint64 underruns;// blocks rendered while the decoding thread was late
+    QList<Audio::ProfileStatistics> tracks;// render time of each remote track
+    QList<Audio::ProfileStatistics> profile;// all profiled nodes, decoders, mixer, etc.
+};
+
+/**
+ * Render a jam offline: the MainController and NinjamController used in the real application
+ * receive the encoded intervals as if they were downloaded from N remote users, and the audio
+ * callback is called in a loop without an audio device.
+ */
+class OfflineRenderBench
+{
+public:
+    explicit OfflineRenderBench(const QList<QByteArray> &encodedIntervals);
+
+    BenchResult run(const BenchScenario &scenario);
+
+    // the .ogg and .opus intervals in a directory, like the 'audio' folder written by the jam recorder
+    static QList<QByteArray> loadIntervals(const QString &path);
+
+    // vorbis intervals of a synthetic signal, used when no recorded intervals are available
+    static QList<QByteArray> createSyntheticIntervals(int count, int sampleRate, int seconds);
+
+private:
+    QList<QByteArray> encodedIntervals;
+
+    const QByteArray &getInterval(int user, int intervalIndex, int users) const;
+
+    static const int DECODERS_WARM_UP_TIME = 250;// ms before the first rendered block
+};
+
+#endif // OFFLINE_RENDER_BENCH_H
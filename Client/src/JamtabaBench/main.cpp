@@ -0,0 +1,209 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include "OfflineRenderBench.h"
+
+/**
+ * Headless benchmark of the audio engine. A jam is rendered offline (no audio device, no server)
+ * for each combination of users, block sizes and sample rates, and one line is printed per scenario.
+ *
+ * Example: JamtabaBench --input ~/Jamtaba/Jam-xxx/audio --users 4,16 --block-sizes 64,256
+ */
+
+static QList<int> parseIntList(const QString &value, bool &ok)
+{
+    QList<int> list;
+    ok = true;
+    foreach (const QString &item, value.split(",", QString::SkipEmptyParts)) {
+        int number = item.trimmed().toInt(&ok);
+        if (!ok || number <= 0) {
+            ok = false;
+            return list;
+        }
+        list.append(number);
+    }
+    ok = !list.isEmpty();
+    return list;
+}
+
+static QString formatTime(qint64 nanoseconds)
+{
+    return QString::number(nanoseconds / 1000.0, 'f', 1);// microseconds
+}
+
+static QString formatResult(const BenchResult &r)
+{
+    qint64 trackAverage = 0;
+    qint64 worstTrack = 0;
+    foreach (const Audio::ProfileStatistics &track, r.tracks) {
+        trackAverage += track.averageTime;
+        worstTrack = qMax(worstTrack, track.percentile99);
+    }
+    if (!r.tracks.isEmpty())
+        trackAverage /= r.tracks.size();
+
+    return QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12")
+           .arg(r.scenario.users, 5)
+           .arg(r.scenario.blockSize, 6)
+           .arg(r.scenario.sampleRate, 6)
+           .arg(QString::number(r.blocksPerSecond, 'f', 0), 10)
+           .arg(QString::number(r.realTimeFactor, 'f', 1), 9)
+           .arg(formatTime(r.averageBlockTime), 9)
+           .arg(formatTime(r.worstBlockTime), 10)
+           .arg(formatTime(r.budget), 10)
+           .arg(QString::number(r.allocationsPerBlock, 'f', 2), 8)
+           .arg(QString::number(r.locksPerBlock, 'f', 2), 7)
+           .arg(formatTime(trackAverage) + "/" + formatTime(worstTrack), 15)
+           .arg(r.underruns, 9);
+}
+
+static QString formatCsv(const BenchResult &r)
+{
+    qint64 trackAverage = 0;
+    foreach (const Audio::ProfileStatistics &track, r.tracks)
+        trackAverage += track.averageTime;
+    if (!r.tracks.isEmpty())
+        trackAverage /= r.tracks.size();
+
+    QStringList values;
+    values << QString::number(r.scenario.users) << QString::number(r.scenario.blockSize)
+           << QString::number(r.scenario.sampleRate) << QString::number(r.blocks)
+           << QString::number(r.blocksPerSecond, 'f', 1) << QString::number(r.realTimeFactor, 'f', 2)
+           << QString::number(r.averageBlockTime) << QString::number(r.worstBlockTime)
+           << QString::number(r.budget) << QString::number(r.allocationsPerBlock, 'f', 3)
+           << QString::number(r.locksPerBlock, 'f', 3) << QString::number(trackAverage)
+           << QString::number(r.underruns);
+    return values.join(",");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("JamtabaBench");
+    QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Render a jam offline with the Jamtaba audio engine and report the render times.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption inputOption("input",
+                                   "Folder with recorded .ogg/.opus intervals (the jam recorder 'audio' folder). Synthetic intervals are used if not informed.",
+                                   "folder");
+    QCommandLineOption usersOption("users", "Remote users, comma separated list.", "list",
+                                   "1,4,8,16");
+    QCommandLineOption blockSizesOption("block-sizes", "Audio callback frames, comma separated list.",
+                                        "list", "128,256,512");
+    QCommandLineOption sampleRatesOption("sample-rates", "Comma separated list.", "list",
+                                         "44100,48000");
+    QCommandLineOption bpmOption("bpm", "Server BPM.", "bpm", "120");
+    QCommandLineOption bpiOption("bpi", "Server BPI.", "bpi", "16");
+    QCommandLineOption intervalsOption("intervals", "Rendered intervals in each scenario.", "count",
+                                       "4");
+    QCommandLineOption renderThreadsOption("render-threads",
+                                           "Tracks rendering threads, 0 to render in the audio thread.",
+                                           "threads", "0");
+    QCommandLineOption speedOption("speed",
+                                   "Limit the render speed (real time multiplier), 0 to render as fast as possible.",
+                                   "factor", "0");
+    QCommandLineOption tracksOption("tracks", "Print the profiled time of each track, decoder and mixer.");
+    QCommandLineOption csvOption("csv", "Write the results in a CSV file.", "file");
+    parser.addOption(inputOption);
+    parser.addOption(usersOption);
+    parser.addOption(blockSizesOption);
+    parser.addOption(sampleRatesOption);
+    parser.addOption(bpmOption);
+    parser.addOption(bpiOption);
+    parser.addOption(intervalsOption);
+    parser.addOption(renderThreadsOption);
+    parser.addOption(speedOption);
+    parser.addOption(tracksOption);
+    parser.addOption(csvOption);
+    parser.process(application);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool usersOk, blockSizesOk, sampleRatesOk, bpmOk, bpiOk, intervalsOk, threadsOk, speedOk;
+    QList<int> users = parseIntList(parser.value(usersOption), usersOk);
+    QList<int> blockSizes = parseIntList(parser.value(blockSizesOption), blockSizesOk);
+    QList<int> sampleRates = parseIntList(parser.value(sampleRatesOption), sampleRatesOk);
+    BenchScenario scenario;
+    scenario.bpm = parser.value(bpmOption).toInt(&bpmOk);
+    scenario.bpi = parser.value(bpiOption).toInt(&bpiOk);
+    scenario.intervals = parser.value(intervalsOption).toInt(&intervalsOk);
+    scenario.renderThreads = parser.value(renderThreadsOption).toInt(&threadsOk);
+    scenario.speed = parser.value(speedOption).toDouble(&speedOk);
+    if (!usersOk || !blockSizesOk || !sampleRatesOk || !bpmOk || !bpiOk || !intervalsOk
+        || !threadsOk || !speedOk || scenario.bpm <= 0 || scenario.bpi <= 0
+        || scenario.intervals <= 0 || scenario.renderThreads < 0 || scenario.speed < 0) {
+        err << "Invalid arguments, see --help" << endl;
+        return 1;
+    }
+
+    QList<QByteArray> intervals;
+    if (parser.isSet(inputOption)) {
+        intervals = OfflineRenderBench::loadIntervals(parser.value(inputOption));
+        if (intervals.isEmpty()) {
+            err << "No intervals found in " << parser.value(inputOption) << endl;
+            return 1;
+        }
+        out << "Using " << intervals.size() << " recorded intervals" << endl;
+    } else {
+        // 44100 like most NINJAM clients, the other sample rates include the resampling cost
+        int intervalSeconds = qMax(1, 60 * scenario.bpi / scenario.bpm);
+        intervals = OfflineRenderBench::createSyntheticIntervals(8, 44100, intervalSeconds);
+        out << "Using " << intervals.size() << " synthetic vorbis intervals" << endl;
+    }
+
+    QFile csvFile;
+    QTextStream csv(&csvFile);
+    if (parser.isSet(csvOption)) {
+        csvFile.setFileName(parser.value(csvOption));
+        if (!csvFile.open(QFile::WriteOnly | QFile::Truncate)) {
+            err << "Can't write " << csvFile.fileName() << endl;
+            return 1;
+        }
+        csv << "users,block size,sample rate,blocks,blocks/s,real time factor,average (ns),"
+               "worst (ns),budget (ns),allocations/block,locks/block,track average (ns),underruns"
+            << endl;
+    }
+
+    // times in microseconds, 'track' is the average time of the tracks / the worst track p99
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12")
+           .arg("users", 5).arg("block", 6).arg("rate", 6).arg("blocks/s", 10)
+           .arg("realtime", 9).arg("avg (us)", 9).arg("worst (us)", 10).arg("budget(us)", 10)
+           .arg("allocs/b", 8).arg("locks/b", 7).arg("track avg/p99", 15).arg("underruns", 9)
+        << endl;
+
+    OfflineRenderBench bench(intervals);
+    bool underruns = false;
+    foreach (int sampleRate, sampleRates) {
+        foreach (int blockSize, blockSizes) {
+            foreach (int userCount, users) {
+                scenario.users = userCount;
+                scenario.blockSize = blockSize;
+                scenario.sampleRate = sampleRate;
+                BenchResult result = bench.run(scenario);
+                out << formatResult(result) << endl;
+                if (csvFile.isOpen())
+                    csv << formatCsv(result) << endl;
+                if (parser.isSet(tracksOption)) {
+                    foreach (const Audio::ProfileStatistics &s, result.profile) {
+                        out << "      " << s.name << ": avg " << formatTime(s.averageTime)
+                            << " us, p99 " << formatTime(s.percentile99) << " us, max "
+                            << formatTime(s.maxTime) << " us" << endl;
+                    }
+                }
+                underruns = underruns || result.underruns > 0;
+            }
+        }
+    }
+
+    if (underruns) {
+        out << "The decoding thread was late in some blocks (underruns), the silent blocks are "
+               "cheaper to render. Use --speed to limit the render speed." << endl;
+    }
+    return 0;
+}
@@ -231,7 +231,7 @@ void MainWindowStandalone::setGlobalPreferences(QList<bool> midiInputsStatus, in
 {
     Audio::AudioDriver *audioDriver = controller->getAudioDriver();
 
-#ifdef Q_OS_WIN
+#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
     audioDriver->setProperties(audioDevice, firstIn, lastIn, firstOut, lastOut, sampleRate,
                                bufferSize);
 #endif
@@ -1,7 +1,11 @@
 #include "StandAloneMainController.h"
 
 #include "midi/RtMidiDriver.h"
-#include "audio/core/PortAudioDriver.h"
+#ifdef Q_OS_LINUX
+    #include "audio/core/JackAudioDriver.h"
+#else
+    #include "audio/core/PortAudioDriver.h"
+#endif
 
 #include "audio/vst/VstPlugin.h"
 #include "audio/vst/VstHost.h"
@@ -215,9 +219,7 @@ void StandaloneMainController::setInputTrackToNoInput(int localChannelIndex)
         if (window)
             window->refreshTrackInputSelection(localChannelIndex);
         if (isPlayingInNinjamRoom()) {// send the finish interval message
-            if (intervalsToUpload.contains(localChannelIndex)) {
-                ninjamService.sendAudioIntervalPart(
-                    intervalsToUpload[localChannelIndex]->getGUID(), QByteArray(), true);
+            if (finishUpload(localChannelIndex)) {
                 if (ninjamController)
                     ninjamController->scheduleEncoderChangeForChannel(
                         inputTrack->getGroupChannelIndex());
@@ -270,11 +272,29 @@ void StandaloneMainController::on_audioDriverStarted()
 
     vstHost->setSampleRate(audioDriver->getSampleRate());
     vstHost->setBlockSize(audioDriver->getBufferSize());
+    setNinjamAudioFormat(ninjamController.data());
+    if (getRoomStreamer())
+        getRoomStreamer()->setMaxBlockSize(audioDriver->getBufferSize());
 
     foreach (Audio::LocalInputAudioNode *inputTrack, inputTracks)
         inputTrack->resumeProcessors();
 }
 
+void StandaloneMainController::on_audioDriverBufferSizeChanged(int newBufferSize)
+{
+    // the stop suspends the plugins, the start reconfigures the vst host, the ninjam controller
+    // and the room streamer and resumes the plugins with the new block size
+    qCInfo(jtCore) << "Audio driver buffer size changed to" << newBufferSize << ", restarting...";
+    audioDriver->stop();
+    try {
+        audioDriver->start();
+    }
+    catch (const std::runtime_error &error) {
+        qCCritical(jtCore) << "Error restarting the audio driver: " << QString::fromUtf8(error.what());
+        useNullAudioDriver();
+    }
+}
+
 void StandaloneMainController::on_audioDriverStopped()
 {
     MainController::on_audioDriverStopped();
@@ -335,13 +355,28 @@ Midi::MidiDriver *StandaloneMainController::createMidiDriver()
 
 Controller::NinjamController *StandaloneMainController::createNinjamController(MainController *c)
 {
-    return new NinjamController(c);
+    NinjamController *controller = new NinjamController(c);
+    setNinjamAudioFormat(controller);
+    return controller;
+}
+
+void StandaloneMainController::setNinjamAudioFormat(Controller::NinjamController *controller)
+{
+    if (controller && audioDriver) {
+        controller->setAudioFormat(audioDriver->getSelectedInputs().getChannels(),
+                                   audioDriver->getSelectedOutputs().getChannels(),
+                                   audioDriver->getBufferSize());
+    }
 }
 
 Audio::AudioDriver *StandaloneMainController::createAudioDriver(
     const Persistence::Settings &settings)
 {
+#ifdef Q_OS_LINUX
+    return new Audio::JackAudioDriver(
+#else
     return new Audio::PortAudioDriver(
+#endif
         this,
         settings.getLastAudioDevice(),
         settings.getFirstGlobalAudioInput(),
@@ -358,7 +393,8 @@ StandaloneMainController::StandaloneMainController(Persistence::Settings setting
                                                    QApplication *application) :
     MainController(settings),
     vstHost(Vst::Host::getInstance()),
-    application(application)
+    application(application),
+    midiBuffer(Midi::MidiBuffer::MAX_BLOCK_MESSAGES, Midi::MidiBuffer::MAX_BLOCK_SYSEX_BYTES)
 {
     application->setQuitOnLastWindowClosed(true);
 
@@ -403,6 +439,8 @@ void StandaloneMainController::start()
 
         QObject::connect(audioDriver.data(), SIGNAL(sampleRateChanged(int)), this,
                          SLOT(setSampleRate(int)));
+        QObject::connect(audioDriver.data(), SIGNAL(bufferSizeChanged(int)), this,
+                         SLOT(on_audioDriverBufferSizeChanged(int)), Qt::QueuedConnection);
         QObject::connect(audioDriver.data(), SIGNAL(stopped()), this,
                          SLOT(on_audioDriverStopped()));
         QObject::connect(audioDriver.data(), SIGNAL(started()), this,
@@ -584,20 +622,12 @@ void StandaloneMainController::quit()
     application->quit();
 }
 
-Midi::MidiBuffer StandaloneMainController::pullMidiBuffer()
-{
-    Midi::MidiBuffer midiBuffer(midiDriver ? midiDriver->getBuffer() : Midi::MidiBuffer(0));
-// int messages = midiBuffer.getMessagesCount();
-// for(int m=0; m < messages; m++){
-// Midi::MidiMessage msg = midiBuffer.getMessage(m);
-// if(msg.isControl()){
-// int inputTrackIndex = 0;//just for test for while, we need get this index from the mapping pair
-// char cc = msg.getData1();
-// char ccValue = msg.getData2();
-// qCDebug(jtMidi) << "Control Change received: " << QString::number(cc) << " -> " << QString::number(ccValue);
-// getInputTrack(inputTrackIndex)->setGain(ccValue/127.0);
-// }
-// }
+const Midi::MidiBuffer &StandaloneMainController::pullMidiBuffer(int frames, int sampleRate)
+{
+    if (midiDriver)
+        midiDriver->fillBuffer(midiBuffer, frames, sampleRate);
+    else
+        midiBuffer.clear();
     return midiBuffer;
 }
 
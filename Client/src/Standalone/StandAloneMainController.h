@@ -124,7 +124,7 @@ protected:
 
     void setCSS(QString css);
 
-    Midi::MidiBuffer pullMidiBuffer() override;
+    const Midi::MidiBuffer &pullMidiBuffer(int frames, int sampleRate) override;
 
 protected slots:
     void updateBpm(int newBpm) override;
@@ -137,6 +137,7 @@ protected slots:
     void on_VSTPluginFounded(QString name, QString group, QString path) override;
 
 private slots:
+    void on_audioDriverBufferSizeChanged(int newBufferSize);
     void on_vstPluginRequestedWindowResize(QString pluginName, int newWidht, int newHeight);
 
 private:
@@ -146,9 +147,12 @@ private:
 
     QScopedPointer<Audio::AudioDriver> audioDriver;
     QScopedPointer<Midi::MidiDriver> midiDriver;
+    Midi::MidiBuffer midiBuffer;// reused in each audio block
 
     bool isVstPluginFile(QString file) const;
 
+    void setNinjamAudioFormat(Controller::NinjamController *controller);
+
     bool inputIndexIsValid(int inputIndex);
 
     MainWindowStandalone *window;
@@ -404,6 +404,18 @@ void StandalonePreferencesDialog::populateBufferSizeCombo()
 
     ui->comboBufferSize->setCurrentText(QString::number(audioDriver->getBufferSize()));
     ui->comboBufferSize->setEnabled(!bufferSizes.isEmpty());
+
+    // latency of the running stream, reported by the audio API
+    int sampleRate = audioDriver->getSampleRate();
+    int inputLatency = audioDriver->getInputLatency();
+    int outputLatency = audioDriver->getOutputLatency();
+    if (sampleRate > 0 && (inputLatency > 0 || outputLatency > 0)) {
+        ui->labelLatency->setText(QString("Latency: %1 ms in, %2 ms out")
+                                  .arg(QString::number(inputLatency * 1000.0 / sampleRate, 'f', 1))
+                                  .arg(QString::number(outputLatency * 1000.0 / sampleRate, 'f', 1)));
+    } else {
+        ui->labelLatency->clear();
+    }
 }
 
 // ++++++++++++
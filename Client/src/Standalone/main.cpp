@@ -8,6 +8,97 @@
 #include "log/Logging.h"
 #include "SingleApplication/singleapplication.h"
 #include "Configurator.h"
+#include "recorder/JamMixdown.h"
+#include "persistence/UsersDataCache.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <cstring>
+
+/**
+ * Headless mode to render recorded jams, used to batch process the sessions in servers:
+ *     Jamtaba2 --mixdown <jam folder or folder with jams>... [--output folder] [--format flac]
+ */
+static int renderJams(int argc, char* args[])
+{
+    QCoreApplication application(argc, args);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render the mixdown and the stems of recorded jams.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("jams", "Jam folders, or folders with jam folders.", "<folder>...");
+    QCommandLineOption mixdownOption("mixdown", "Render the jams instead of start Jamtaba.");
+    QCommandLineOption outputOption("output", "Output folder, the 'mixdown' folder of each jam if not informed.", "folder");
+    QCommandLineOption formatOption("format", "wav or flac.", "format", "wav");
+    QCommandLineOption bitsOption("bits", "Bits per sample: 16, 24 or 32 (float, WAV only).", "bits", "16");
+    QCommandLineOption sampleRateOption("sample-rate", "The jam sample rate if not informed.", "rate", "0");
+    QCommandLineOption threadsOption("threads", "Decoding threads, 0 to use all cores.", "threads", "0");
+    QCommandLineOption noStemsOption("no-stems", "Render only the mixdown.");
+    QCommandLineOption noMixdownOption("no-mixdown", "Render only the stems.");
+    QCommandLineOption noCacheOption("no-cache", "Ignore the users level, pan and mute remembered by Jamtaba.");
+    parser.addOption(mixdownOption);
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(bitsOption);
+    parser.addOption(sampleRateOption);
+    parser.addOption(threadsOption);
+    parser.addOption(noStemsOption);
+    parser.addOption(noMixdownOption);
+    parser.addOption(noCacheOption);
+    parser.process(application);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    Recorder::JamMixdown::Options options;
+    options.fileExtension = "." + parser.value(formatOption).toLower();
+    options.bitsPerSample = parser.value(bitsOption).toInt();
+    options.sampleRate = parser.value(sampleRateOption).toInt();
+    options.threads = parser.value(threadsOption).toInt();
+    options.stems = !parser.isSet(noStemsOption);
+    options.mixdown = !parser.isSet(noMixdownOption);
+    if ((options.fileExtension != ".wav" && options.fileExtension != ".flac")
+        || options.sampleRate < 0 || options.threads < 0 || parser.positionalArguments().isEmpty()) {
+        err << "Invalid arguments, see --help" << endl;
+        return 1;
+    }
+
+    QStringList jamDirs;
+    foreach (const QString &path, parser.positionalArguments()) {
+        QDir dir(path);
+        if (dir.exists("Reaper project.rpp") || dir.exists("Reaper project.journal")) {
+            jamDirs.append(dir.absolutePath());
+            continue;
+        }
+        foreach (const QFileInfo &jam, dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+            QDir jamDir(jam.absoluteFilePath());
+            if (jamDir.exists("Reaper project.rpp") || jamDir.exists("Reaper project.journal"))
+                jamDirs.append(jamDir.absolutePath());
+        }
+    }
+    if (jamDirs.isEmpty()) {
+        err << "No recorded jams found" << endl;
+        return 1;
+    }
+
+    QScopedPointer<Persistence::UsersDataCache> usersDataCache;
+    if (!parser.isSet(noCacheOption))
+        usersDataCache.reset(new Persistence::UsersDataCache());
+
+    int failures = 0;
+    foreach (const QString &jamDir, jamDirs) {
+        QString outputDir = parser.isSet(outputOption)
+                            ? QDir(parser.value(outputOption)).absoluteFilePath(QDir(jamDir).dirName())
+                            : QDir(jamDir).absoluteFilePath("mixdown");
+        out << "Rendering " << jamDir << " in " << outputDir << endl;
+        Recorder::JamMixdown mixdown(jamDir);
+        if (!mixdown.load() || !mixdown.render(outputDir, options, usersDataCache.data())) {
+            err << mixdown.getErrorMessage() << endl;
+            failures++;
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
 
 int main(int argc, char* args[] ){
 
@@ -18,6 +109,11 @@ int main(int argc, char* args[] ){
     Configurator* configurator = Configurator::getInstance();
     if(!configurator->setUp(standalone)) qCWarning(jtConfigurator) << "JTBConfig->setUp() FAILED !" ;
 
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(args[i], "--mixdown") == 0)
+            return renderJams(argc, args);// no GUI, the settings are not loaded
+    }
+
     Persistence::Settings settings;
     settings.load();
 
@@ -224,7 +224,7 @@ void JamtabaPlugin::processReplacing(float **inputs, float **outputs, VstInt32 s
 
     int channels = outputBuffer.getChannels();
     for (int c = 0; c < channels; ++c)
-        memcpy(outputs[c], outputBuffer.getSamplesArray(c), sizeof(float) * sampleFrames);
+        memcpy(outputs[c], outputBuffer.getReadOnlySamplesArray(c), sizeof(float) * sampleFrames);
 
     // ++++++++++++++++++++++++++++++
     hostWasPlayingInLastAudioCallBack = hostIsPlaying();
@@ -0,0 +1,38 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_audiofileplayer
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+INCLUDEPATH += ../../../libs/includes/ogg
+INCLUDEPATH += ../../../libs/includes/vorbis
+INCLUDEPATH += ../../../libs/includes/minimp3
+VPATH += ../../../src/Common
+
+linux: LIBS += -L$$PWD/../../../libs/static/linux64
+LIBS += -lminimp3 -lvorbisfile -lvorbis -logg
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += midi/MidiDriver.h
+HEADERS += audio/core/AudioDriver.h
+HEADERS += audio/core/AudioNode.h
+HEADERS += audio/AudioFilePlayerNode.h
+SOURCES += log/logging.cpp
+SOURCES += midi/MidiDriver.cpp
+SOURCES += audio/core/AudioDriver.cpp
+SOURCES += audio/core/AudioNode.cpp
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/core/SamplesRingBuffer.cpp
+SOURCES += audio/core/DspProfiler.cpp
+SOURCES += audio/core/RtViolationDetector.cpp
+SOURCES += audio/SamplesBufferResampler.cpp
+SOURCES += audio/WaveFileReader.cpp
+SOURCES += audio/codec.cpp
+SOURCES += audio/AudioFileSource.cpp
+SOURCES += audio/AudioFilePlayerNode.cpp
+SOURCES += tst_AudioFilePlayerNode.cpp
@@ -0,0 +1,205 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QThread>
+#include "audio/AudioFilePlayerNode.h"
+#include "audio/core/SamplesBuffer.h"
+#include "midi/MidiDriver.h"
+
+using namespace Audio;
+
+namespace {
+const int SAMPLE_RATE = 44100;// the file sample rate, the samples are not resampled
+const int FILE_FRAMES = 20000;
+const int TIMEOUT = 5000;// milliseconds
+
+// 16 bits stereo, each frame has different samples in the left and right channels
+float fileSample(int channel, qint64 frame)
+{
+    return (channel == 0 ? frame : -frame) / 32768.0f;
+}
+
+bool createWaveFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly))
+        return false;
+
+    const quint32 dataSize = FILE_FRAMES * 2 * sizeof(qint16);
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("RIFF", 4);
+    stream << quint32(36 + dataSize);
+    stream.writeRawData("WAVE", 4);
+    stream.writeRawData("fmt ", 4);
+    stream << quint32(16) << quint16(1) << quint16(2) << quint32(SAMPLE_RATE)
+           << quint32(SAMPLE_RATE * 4) << quint16(4) << quint16(16);
+    stream.writeRawData("data", 4);
+    stream << dataSize;
+    for (int f = 0; f < FILE_FRAMES; ++f)
+        stream << qint16(f) << qint16(-f);
+    return stream.status() == QDataStream::Ok;
+}
+}
+
+class TestAudioFilePlayerNode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void loop_data();
+    void loop();
+    void restartAfterTheEnd();
+
+private:
+    QTemporaryDir dir;
+    QString filePath;
+
+    static void renderBlock(AudioFilePlayerNode &player, SamplesBuffer &out);
+    static SamplesBuffer render(AudioFilePlayerNode &player, int blockSize, int totalFrames);
+
+    // the audio thread consumes the flushes requested by the decoding thread, the blocks are
+    // rendered until the player is in 'position' and the ring buffer is filled again
+    static bool waitDecodingThread(AudioFilePlayerNode &player, qint64 position);
+};
+
+void TestAudioFilePlayerNode::init()
+{
+    QVERIFY(dir.isValid());
+    filePath = dir.path() + "/backing track.wav";
+    QVERIFY(createWaveFile(filePath));
+}
+
+void TestAudioFilePlayerNode::renderBlock(AudioFilePlayerNode &player, SamplesBuffer &out)
+{
+    SamplesBuffer in(2, out.getFrameLenght());
+    Midi::MidiBuffer midiBuffer(0);
+    out.zero();
+    player.processReplacing(in, out, SAMPLE_RATE, midiBuffer);
+}
+
+SamplesBuffer TestAudioFilePlayerNode::render(AudioFilePlayerNode &player, int blockSize,
+                                              int totalFrames)
+{
+    SamplesBuffer rendered(2, 0);
+    SamplesBuffer out(2, blockSize);
+    while (rendered.getFrameLenght() < totalFrames) {
+        out.setFrameLenght(qMin(blockSize, totalFrames - rendered.getFrameLenght()));
+        renderBlock(player, out);
+        rendered.append(out);
+    }
+    return rendered;
+}
+
+bool TestAudioFilePlayerNode::waitDecodingThread(AudioFilePlayerNode &player, qint64 position)
+{
+    SamplesBuffer out(2, 64);
+    QElapsedTimer timer;
+    timer.start();
+    while (player.getLength() <= 0 || player.getPosition() != position) {
+        if (timer.elapsed() > TIMEOUT)
+            return false;
+        renderBlock(player, out);// not playing, only the flush is consumed
+        QThread::msleep(1);
+    }
+    QTest::qWait(100);// the decoding thread fills the ring buffer ahead of the playback
+    return true;
+}
+
+void TestAudioFilePlayerNode::loop_data()
+{
+    QTest::addColumn<int>("loopStart");
+    QTest::addColumn<int>("loopEnd");
+    QTest::addColumn<int>("blockSize");
+
+    QTest::newRow("loop in the file middle") << 5000 << 8000 << 256;
+    QTest::newRow("loop until the end of the file") << 15000 << -1 << 1000;
+    QTest::newRow("block bigger than the loop") << 5000 << 5300 << 1024;
+    QTest::newRow("loop end after the end of the file") << 18000 << FILE_FRAMES + 500 << 333;
+}
+
+void TestAudioFilePlayerNode::loop()
+{
+    QFETCH(int, loopStart);
+    QFETCH(int, loopEnd);
+    QFETCH(int, blockSize);
+
+    AudioFilePlayerNode player;
+    player.load(filePath);
+    QVERIFY(waitDecodingThread(player, 0));
+    QCOMPARE(player.getLength(), qint64(FILE_FRAMES));
+    QCOMPARE(player.getFileSampleRate(), SAMPLE_RATE);
+
+    player.setLoop(true, loopStart, loopEnd);
+    QVERIFY(waitDecodingThread(player, loopStart));
+    player.play();
+
+    const int totalFrames = 9000;// less than the decoded frames, the loop is restarted many times
+    const int loopLength = qMin(loopEnd < 0 ? FILE_FRAMES : loopEnd, FILE_FRAMES) - loopStart;
+    SamplesBuffer rendered = render(player, blockSize, totalFrames);
+    QVERIFY(player.isPlaying());
+    QCOMPARE(player.getPosition(), qint64(loopStart + totalFrames % loopLength));
+
+    // the first block fades in
+    for (int frame = blockSize; frame < rendered.getFrameLenght(); ++frame) {
+        qint64 fileFrame = loopStart + frame % loopLength;
+        for (int c = 0; c < 2; ++c) {
+            if (rendered.get(c, frame) != fileSample(c, fileFrame))
+                QFAIL(qPrintable(QString("frame %1, channel %2: %3 != %4 (file frame %5)")
+                                 .arg(frame).arg(c).arg(rendered.get(c, frame))
+                                 .arg(fileSample(c, fileFrame)).arg(fileFrame)));
+        }
+    }
+}
+
+void TestAudioFilePlayerNode::restartAfterTheEnd()
+{
+    const int blockSize = 1000;
+
+    AudioFilePlayerNode player;
+    player.load(filePath);
+    QVERIFY(waitDecodingThread(player, 0));
+    player.play();
+
+    // the playback stops in the first block without samples
+    SamplesBuffer rendered(2, 0);
+    SamplesBuffer out(2, blockSize);
+    for (int block = 0; block < 100 && player.isPlaying(); ++block) {
+        renderBlock(player, out);
+        rendered.append(out);
+    }
+    QVERIFY(!player.isPlaying());
+    QCOMPARE(player.getPosition(), qint64(FILE_FRAMES));
+    QVERIFY(rendered.getFrameLenght() > FILE_FRAMES);
+    for (int frame = blockSize; frame < rendered.getFrameLenght(); ++frame) {
+        for (int c = 0; c < 2; ++c) {
+            float expected = frame < FILE_FRAMES ? fileSample(c, frame) : 0.0f;
+            if (rendered.get(c, frame) != expected)
+                QFAIL(qPrintable(QString("frame %1, channel %2: %3 != %4")
+                                 .arg(frame).arg(c).arg(rendered.get(c, frame)).arg(expected)));
+        }
+    }
+
+    // played until the end, play() seeks to the file start
+    player.play();
+    player.stop();
+    QVERIFY(waitDecodingThread(player, 0));
+    player.play();
+    rendered = render(player, blockSize, blockSize * 3);
+    QVERIFY(player.isPlaying());
+    QCOMPARE(player.getPosition(), qint64(blockSize * 3));
+    for (int frame = blockSize; frame < rendered.getFrameLenght(); ++frame) {
+        for (int c = 0; c < 2; ++c) {
+            if (rendered.get(c, frame) != fileSample(c, frame))
+                QFAIL(qPrintable(QString("restarted, frame %1, channel %2: %3 != %4")
+                                 .arg(frame).arg(c).arg(rendered.get(c, frame))
+                                 .arg(fileSample(c, frame))));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestAudioFilePlayerNode)
+
+#include "tst_AudioFilePlayerNode.moc"
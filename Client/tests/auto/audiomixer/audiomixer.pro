@@ -0,0 +1,30 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_audiomixer
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += midi/MidiDriver.h
+HEADERS += audio/core/AudioDriver.h
+HEADERS += audio/core/AudioNode.h
+HEADERS += audio/core/AudioMixer.h
+SOURCES += log/logging.cpp
+SOURCES += midi/MidiDriver.cpp
+SOURCES += audio/core/AudioDriver.cpp
+SOURCES += audio/core/AudioNode.cpp
+SOURCES += audio/core/AudioMixer.cpp
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/core/DspProfiler.cpp
+SOURCES += audio/core/RenderSchedule.cpp
+SOURCES += audio/core/RenderWorkerPool.cpp
+SOURCES += audio/core/RtSemaphore.cpp
+SOURCES += audio/core/RtViolationDetector.cpp
+SOURCES += tst_AudioMixer.cpp
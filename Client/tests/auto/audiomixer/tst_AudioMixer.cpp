@@ -0,0 +1,161 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <cmath>
+#include "audio/core/AudioMixer.h"
+#include "audio/core/AudioNode.h"
+#include "midi/MidiDriver.h"
+
+using namespace Audio;
+
+namespace {
+// deterministic signal summed with the connected nodes outputs, the same in both mixers
+class SignalNode : public AudioNode
+{
+public:
+    explicit SignalNode(int seed) :
+        seed(seed),
+        position(0)
+    {
+    }
+
+    void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                          const Midi::MidiBuffer &midiBuffer) override
+    {
+        int frames = out.getFrameLenght();
+        internalInputBuffer.setFrameLenght(frames);
+        for (int f = 0; f < frames; ++f) {
+            float sample = std::sin((position + f) * 0.001f * seed) / seed;
+            internalInputBuffer.set(0, f, sample);
+            internalInputBuffer.set(1, f, -sample);
+        }
+        position += frames;
+        AudioNode::processReplacing(in, out, sampleRate, midiBuffer);
+    }
+
+private:
+    const int seed;
+    int position;
+};
+
+const int NODES = 12;
+const int SAMPLE_RATE = 44100;
+
+// nodes 0-3 are mixed, 4-11 are connected in two levels below them (8 and 9 are read by two nodes)
+void buildGraph(AudioMixer &mixer, QList<AudioNode *> &nodes)
+{
+    for (int n = 0; n < NODES; ++n) {
+        SignalNode *node = new SignalNode(n + 1);
+        node->setGain(1.0f - n * 0.05f);
+        node->setPan((n % 3 - 1) * 0.5f);
+        nodes.append(node);
+    }
+    for (int n = 0; n < 4; ++n)
+        mixer.addNode(nodes.at(n));
+    mixer.connect(nodes.at(4), nodes.at(0));
+    mixer.connect(nodes.at(5), nodes.at(0));
+    mixer.connect(nodes.at(6), nodes.at(1));
+    mixer.connect(nodes.at(7), nodes.at(1));
+    mixer.connect(nodes.at(8), nodes.at(4));
+    mixer.connect(nodes.at(9), nodes.at(4));
+    mixer.connect(nodes.at(10), nodes.at(6));
+    mixer.connect(nodes.at(11), nodes.at(7));
+    mixer.connect(nodes.at(8), nodes.at(2));// rendered once, read by 4 and 2
+    mixer.connect(nodes.at(9), nodes.at(3));
+    nodes.at(1)->setMute(true);// culled, its inputs are still rendered
+}
+}
+
+class TestAudioMixer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parallelOutputEqualsSerialOutput_data();
+    void parallelOutputEqualsSerialOutput();
+    void renderThreadsCanChangeBetweenBlocks();
+};
+
+void TestAudioMixer::parallelOutputEqualsSerialOutput_data()
+{
+    QTest::addColumn<int>("renderThreads");
+    QTest::addColumn<int>("frames");
+
+    QTest::newRow("1 thread") << 1 << 256;
+    QTest::newRow("3 threads") << 3 << 256;
+    QTest::newRow("8 threads, small blocks") << 8 << 16;
+}
+
+void TestAudioMixer::parallelOutputEqualsSerialOutput()
+{
+    QFETCH(int, renderThreads);
+    QFETCH(int, frames);
+
+    AudioMixer serialMixer(SAMPLE_RATE);
+    AudioMixer parallelMixer(SAMPLE_RATE);
+    QList<AudioNode *> serialNodes;
+    QList<AudioNode *> parallelNodes;
+    buildGraph(serialMixer, serialNodes);
+    buildGraph(parallelMixer, parallelNodes);
+    parallelMixer.setRenderThreads(renderThreads);
+    QCOMPARE(parallelMixer.getRenderThreads(), renderThreads);
+
+    SamplesBuffer in(2, frames);
+    Midi::MidiBuffer midiBuffer(0);
+    SamplesBuffer serialOut(2, frames);
+    SamplesBuffer parallelOut(2, frames);
+    for (int block = 0; block < 2000; ++block) {
+        serialOut.zero();
+        parallelOut.zero();
+        serialMixer.process(in, serialOut, SAMPLE_RATE, midiBuffer);
+        parallelMixer.process(in, parallelOut, SAMPLE_RATE, midiBuffer);
+        for (int c = 0; c < 2; ++c) {
+            const float *serialSamples = serialOut.getReadOnlySamplesArray(c);
+            const float *parallelSamples = parallelOut.getReadOnlySamplesArray(c);
+            for (int f = 0; f < frames; ++f) {
+                if (serialSamples[f] != parallelSamples[f])// bit exact, the sum order is the same
+                    QFAIL(qPrintable(QString("block %1, channel %2, frame %3: %4 != %5")
+                                     .arg(block).arg(c).arg(f)
+                                     .arg(serialSamples[f]).arg(parallelSamples[f])));
+            }
+        }
+    }
+
+    parallelMixer.setRenderThreads(0);// stop the workers before the nodes are deleted
+    qDeleteAll(serialNodes);
+    qDeleteAll(parallelNodes);
+}
+
+void TestAudioMixer::renderThreadsCanChangeBetweenBlocks()
+{
+    const int frames = 64;
+    AudioMixer serialMixer(SAMPLE_RATE);
+    AudioMixer parallelMixer(SAMPLE_RATE);
+    QList<AudioNode *> serialNodes;
+    QList<AudioNode *> parallelNodes;
+    buildGraph(serialMixer, serialNodes);
+    buildGraph(parallelMixer, parallelNodes);
+
+    SamplesBuffer in(2, frames);
+    Midi::MidiBuffer midiBuffer(0);
+    SamplesBuffer serialOut(2, frames);
+    SamplesBuffer parallelOut(2, frames);
+    for (int block = 0; block < 64; ++block) {
+        parallelMixer.setRenderThreads(block % 4);// zero renders in the audio thread
+        serialOut.zero();
+        parallelOut.zero();
+        serialMixer.process(in, serialOut, SAMPLE_RATE, midiBuffer);
+        parallelMixer.process(in, parallelOut, SAMPLE_RATE, midiBuffer);
+        for (int c = 0; c < 2; ++c) {
+            for (int f = 0; f < frames; ++f)
+                QCOMPARE(parallelOut.get(c, f), serialOut.get(c, f));
+        }
+    }
+
+    parallelMixer.setRenderThreads(0);
+    qDeleteAll(serialNodes);
+    qDeleteAll(parallelNodes);
+}
+
+QTEST_GUILESS_MAIN(TestAudioMixer)
+
+#include "tst_AudioMixer.moc"
@@ -0,0 +1,214 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QPoint>
+#include "audio/core/AudioNode.h"
+#include "midi/MidiDriver.h"
+
+using namespace Audio;
+
+namespace {
+// out = in * 0.5 + offset, the order of the processors changes the output
+class StubProcessor : public AudioNodeProcessor
+{
+public:
+    StubProcessor(float offset, bool inPlace) :
+        offset(offset),
+        inPlace(inPlace),
+        calls(0),
+        sharedBuffers(0)
+    {
+    }
+
+    void process(const SamplesBuffer &in, SamplesBuffer &out,
+                 const Midi::MidiBuffer &midiBuffer) override
+    {
+        Q_UNUSED(midiBuffer);
+        calls++;
+        if (&in == &out)
+            sharedBuffers++;
+        for (int c = 0; c < out.getChannels(); ++c) {
+            const float *input = in.getReadOnlySamplesArray(c);
+            float *output = out.getSamplesArray(c);
+            for (int f = 0; f < out.getFrameLenght(); ++f)
+                output[f] = input[f] * 0.5f + offset;
+        }
+    }
+
+    bool canProcessInPlace() const override
+    {
+        return inPlace;
+    }
+
+    void suspend() override
+    {
+    }
+
+    void resume() override
+    {
+    }
+
+    void updateGui() override
+    {
+    }
+
+    void openEditor(QPoint centerOfScreen) override
+    {
+        Q_UNUSED(centerOfScreen);
+    }
+
+    void closeEditor() override
+    {
+    }
+
+    const float offset;
+    const bool inPlace;
+    int calls;
+    int sharedBuffers;// calls with the same buffer as input and output
+};
+
+// a ramp in the node input, the left and right channels are different
+class RampNode : public AudioNode
+{
+public:
+    void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                          const Midi::MidiBuffer &midiBuffer) override
+    {
+        internalInputBuffer.setFrameLenght(out.getFrameLenght());
+        for (int f = 0; f < out.getFrameLenght(); ++f) {
+            internalInputBuffer.set(0, f, inputSample(0, f));
+            internalInputBuffer.set(1, f, inputSample(1, f));
+        }
+        AudioNode::processReplacing(in, out, sampleRate, midiBuffer);
+    }
+
+    static float inputSample(int channel, int frame)
+    {
+        return channel == 0 ? frame * 0.01f : -frame * 0.02f;
+    }
+};
+
+const int FRAMES = 64;
+const int SAMPLE_RATE = 44100;
+}
+
+class TestAudioNode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void insertChain_data();
+    void insertChain();
+    void bypassChangedBetweenBlocks();
+
+private:
+    // 'chain' has one letter for each processor: 'O' out of place, 'I' in place, lower case bypassed
+    static QList<StubProcessor *> addProcessors(AudioNode &node, const QString &chain);
+    static void verifyOutput(const SamplesBuffer &out, const QList<StubProcessor *> &processors,
+                             float pan);
+};
+
+QList<StubProcessor *> TestAudioNode::addProcessors(AudioNode &node, const QString &chain)
+{
+    QList<StubProcessor *> processors;
+    for (int p = 0; p < chain.size(); ++p) {
+        QChar type = chain.at(p);
+        StubProcessor *processor = new StubProcessor((p + 1) * 0.1f, type.toUpper() == 'I');
+        processor->setBypass(type.isLower());
+        node.addProcessor(processor);// deleted by the node
+        processors.append(processor);
+    }
+    return processors;
+}
+
+void TestAudioNode::verifyOutput(const SamplesBuffer &out, const QList<StubProcessor *> &processors,
+                                 float pan)
+{
+    float gains[2];
+    AudioNode::getPanGains(pan, gains[0], gains[1]);
+    for (int c = 0; c < 2; ++c) {
+        for (int f = 0; f < FRAMES; ++f) {
+            float expected = RampNode::inputSample(c, f);
+            foreach (StubProcessor *processor, processors) {
+                if (!processor->isBypassed())
+                    expected = expected * 0.5f + processor->offset;
+            }
+            expected *= gains[c];
+            if (qAbs(out.get(c, f) - expected) > 1e-6f)
+                QFAIL(qPrintable(QString("channel %1, frame %2: %3 != %4")
+                                 .arg(c).arg(f).arg(out.get(c, f)).arg(expected)));
+        }
+    }
+}
+
+void TestAudioNode::insertChain_data()
+{
+    QTest::addColumn<QString>("chain");
+
+    QTest::newRow("no processors") << "";
+    QTest::newRow("one out of place") << "O";
+    QTest::newRow("two out of place") << "OO";
+    QTest::newRow("three out of place") << "OOO";
+    QTest::newRow("four out of place") << "OOOO";
+    QTest::newRow("one in place") << "I";
+    QTest::newRow("two in place") << "II";
+    QTest::newRow("in place first, odd") << "IO";
+    QTest::newRow("in place first, even") << "IOO";
+    QTest::newRow("in place between") << "OIO";
+    QTest::newRow("in place last") << "OOI";
+    QTest::newRow("mixed") << "IOIOI";
+    QTest::newRow("bypassed out of place, odd") << "OoOO";
+    QTest::newRow("bypassed out of place, even") << "OOo";
+    QTest::newRow("bypassed in place") << "iOI";
+    QTest::newRow("all bypassed") << "oio";
+}
+
+void TestAudioNode::insertChain()
+{
+    QFETCH(QString, chain);
+
+    RampNode node;
+    node.setPan(0.3f);
+    QList<StubProcessor *> processors = addProcessors(node, chain);
+
+    SamplesBuffer in(2, FRAMES);
+    SamplesBuffer out(2, FRAMES);
+    Midi::MidiBuffer midiBuffer(0);
+    for (int block = 0; block < 3; ++block) {// the buffers are reused in the next blocks
+        out.zero();
+        node.processReplacing(in, out, SAMPLE_RATE, midiBuffer);
+        verifyOutput(out, processors, node.getPan());
+        if (QTest::currentTestFailed())
+            return;
+    }
+
+    foreach (StubProcessor *processor, processors) {
+        QCOMPARE(processor->calls, processor->isBypassed() ? 0 : 3);
+        // the out of place processors never write in the buffer they are reading
+        QCOMPARE(processor->sharedBuffers, processor->inPlace ? processor->calls : 0);
+    }
+}
+
+void TestAudioNode::bypassChangedBetweenBlocks()
+{
+    RampNode node;
+    node.setPan(-0.2f);
+    QList<StubProcessor *> processors = addProcessors(node, "OIOO");
+
+    SamplesBuffer in(2, FRAMES);
+    SamplesBuffer out(2, FRAMES);
+    Midi::MidiBuffer midiBuffer(0);
+    for (int block = 0; block < processors.size() * 2; ++block) {
+        // each processor is bypassed and enabled again, the out of place count changes
+        StubProcessor *processor = processors.at(block / 2);
+        processor->setBypass(block % 2 == 0);
+        out.zero();
+        node.processReplacing(in, out, SAMPLE_RATE, midiBuffer);
+        verifyOutput(out, processors, node.getPan());
+        if (QTest::currentTestFailed())
+            return;
+    }
+}
+
+QTEST_GUILESS_MAIN(TestAudioNode)
+
+#include "tst_AudioNode.moc"
@@ -0,0 +1,16 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_chainedtrackindex
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += recorder/ChainedTrackIndex.h
+SOURCES += log/logging.cpp
+SOURCES += recorder/ChainedTrackIndex.cpp
+SOURCES += tst_ChainedTrackIndex.cpp
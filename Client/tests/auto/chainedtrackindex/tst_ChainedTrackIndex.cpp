@@ -0,0 +1,150 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "recorder/ChainedTrackIndex.h"
+
+using namespace Recorder;
+
+namespace {
+// three intervals appended in the track file
+QList<ChainedTrackIndex::Entry> createEntries()
+{
+    QList<ChainedTrackIndex::Entry> entries;
+    const int sizes[] = {1000, 1200, 900};
+    const double durations[] = {8.0, 8.5, 7.25};
+    qint64 offset = 0;
+    double startTime = 0;
+    for (int i = 0; i < 3; ++i) {
+        ChainedTrackIndex::Entry entry;
+        entry.intervalIndex = i + 5;// the track was added in the middle of the jam
+        entry.offset = offset;
+        entry.size = sizes[i];
+        entry.startTime = startTime;
+        entry.duration = durations[i];
+        entries.append(entry);
+        offset += entry.size;
+        startTime += entry.duration;
+    }
+    return entries;
+}
+
+bool writeFile(const QString &filePath, const QByteArray &content)
+{
+    QFile file(filePath);
+    return file.open(QFile::WriteOnly) && file.write(content) == content.size();
+}
+}
+
+class TestChainedTrackIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void truncatedTrackFile_data();
+    void truncatedTrackFile();
+    void incompleteIndexLine();
+    void missingIndex();
+
+private:
+    QTemporaryDir dir;
+    QString trackFilePath;
+
+    // the index of 'entries' and a track file with 'trackFileSize' bytes
+    bool writeTrack(const QList<ChainedTrackIndex::Entry> &entries, qint64 trackFileSize,
+                    const QByteArray &indexTail = QByteArray());
+    static void compare(const QList<ChainedTrackIndex::Entry> &entries,
+                        const QList<ChainedTrackIndex::Entry> &expected);
+};
+
+void TestChainedTrackIndex::init()
+{
+    QVERIFY(dir.isValid());
+    trackFilePath = QDir(dir.path()).absoluteFilePath("user-1.ogg");
+    QFile::remove(trackFilePath);// the same track in all tests
+    QFile::remove(ChainedTrackIndex::getIndexPath(trackFilePath));
+}
+
+bool TestChainedTrackIndex::writeTrack(const QList<ChainedTrackIndex::Entry> &entries,
+                                       qint64 trackFileSize, const QByteArray &indexTail)
+{
+    QByteArray index;
+    for (const ChainedTrackIndex::Entry &entry : entries)
+        index.append(ChainedTrackIndex::toLine(entry));
+    index.append(indexTail);
+    return writeFile(ChainedTrackIndex::getIndexPath(trackFilePath), index)
+           && writeFile(trackFilePath, QByteArray((int)trackFileSize, 'x'));
+}
+
+void TestChainedTrackIndex::compare(const QList<ChainedTrackIndex::Entry> &entries,
+                                    const QList<ChainedTrackIndex::Entry> &expected)
+{
+    QCOMPARE(entries.size(), expected.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        QCOMPARE(entries.at(i).intervalIndex, expected.at(i).intervalIndex);
+        QCOMPARE(entries.at(i).offset, expected.at(i).offset);
+        QCOMPARE(entries.at(i).size, expected.at(i).size);
+        QCOMPARE(entries.at(i).startTime, expected.at(i).startTime);
+        QCOMPARE(entries.at(i).duration, expected.at(i).duration);
+    }
+}
+
+void TestChainedTrackIndex::roundTrip()
+{
+    QList<ChainedTrackIndex::Entry> entries = createEntries();
+    QVERIFY(writeTrack(entries, entries.last().offset + entries.last().size));
+    QCOMPARE(ChainedTrackIndex::getIndexPath(trackFilePath), trackFilePath + ".index");
+
+    compare(ChainedTrackIndex::read(trackFilePath), entries);
+}
+
+void TestChainedTrackIndex::truncatedTrackFile_data()
+{
+    QTest::addColumn<qint64>("trackFileSize");
+    QTest::addColumn<int>("completeIntervals");
+
+    // the application crashed before the interval was completely written
+    QTest::newRow("last interval truncated") << qint64(3000) << 2;
+    QTest::newRow("last interval not written") << qint64(2200) << 2;
+    QTest::newRow("first interval truncated") << qint64(999) << 0;
+    QTest::newRow("empty track file") << qint64(0) << 0;
+}
+
+void TestChainedTrackIndex::truncatedTrackFile()
+{
+    QFETCH(qint64, trackFileSize);
+    QFETCH(int, completeIntervals);
+
+    QList<ChainedTrackIndex::Entry> entries = createEntries();
+    QVERIFY(writeTrack(entries, trackFileSize));
+
+    compare(ChainedTrackIndex::read(trackFilePath), entries.mid(0, completeIntervals));
+}
+
+void TestChainedTrackIndex::incompleteIndexLine()
+{
+    QList<ChainedTrackIndex::Entry> entries = createEntries();
+    QList<ChainedTrackIndex::Entry> indexedEntries = entries.mid(0, 2);
+
+    // the last line was not completely written, the track file has the interval
+    QVERIFY(writeTrack(indexedEntries, entries.last().offset + entries.last().size, "7 2200 9"));
+    compare(ChainedTrackIndex::read(trackFilePath), indexedEntries);
+
+    // an empty size is never written in a complete line
+    ChainedTrackIndex::Entry emptyEntry = entries.last();
+    emptyEntry.size = 0;
+    QVERIFY(writeTrack(indexedEntries, entries.last().offset + entries.last().size,
+                       ChainedTrackIndex::toLine(emptyEntry)));
+    compare(ChainedTrackIndex::read(trackFilePath), indexedEntries);
+}
+
+void TestChainedTrackIndex::missingIndex()
+{
+    QVERIFY(writeFile(trackFilePath, QByteArray(100, 'x')));
+    QVERIFY(ChainedTrackIndex::read(trackFilePath).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestChainedTrackIndex)
+
+#include "tst_ChainedTrackIndex.moc"
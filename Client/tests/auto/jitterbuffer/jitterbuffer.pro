@@ -0,0 +1,15 @@
+QT += testlib
+QT += network
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_jitterbuffer
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += audio/StreamJitterBuffer.h
+SOURCES += audio/StreamJitterBuffer.cpp
+SOURCES += tst_StreamJitterBuffer.cpp
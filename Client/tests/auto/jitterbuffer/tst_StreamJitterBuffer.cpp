@@ -0,0 +1,303 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include "audio/StreamJitterBuffer.h"
+
+using namespace Audio;
+
+namespace {
+const int BYTE_RATE = 16000;// 128 kbps
+
+/**
+ * Plays the received bytes following the jitter buffer decisions, like the room streamer does
+ * with the decoded samples. The time is advanced by the caller.
+ */
+class Playout
+{
+public:
+    Playout() :
+        receivedBytes(0),
+        playedMs(0),
+        lastTime(0)
+    {
+        buffer.setByteRate(BYTE_RATE);
+    }
+
+    void arrival(qint64 timeMs, int bytes)
+    {
+        advance(timeMs);
+        buffer.addArrival(timeMs, bytes);
+        receivedBytes += bytes;
+        update();
+    }
+
+    void advance(qint64 timeMs)
+    {
+        if (!buffer.isBuffering()) {
+            playedMs += (timeMs - lastTime) * buffer.getPlaybackRate(getBufferedMs());
+            playedMs = std::min(playedMs, (double)getReceivedMs());// nothing more to play
+        }
+        lastTime = timeMs;
+        update();
+    }
+
+    int getBufferedMs() const
+    {
+        return (int)(getReceivedMs() - playedMs);
+    }
+
+    StreamJitterBuffer::Health getHealth() const
+    {
+        return buffer.getHealth(getBufferedMs());
+    }
+
+private:
+    StreamJitterBuffer buffer;
+    qint64 receivedBytes;
+    double playedMs;
+    qint64 lastTime;
+
+    qint64 getReceivedMs() const
+    {
+        return receivedBytes * 1000 / BYTE_RATE;
+    }
+
+    void update()
+    {
+        buffer.update(getBufferedMs());
+        int excessMs = buffer.getExcessMs(getBufferedMs());
+        if (excessMs > 0) {
+            playedMs += excessMs;
+            buffer.addDroppedMs(excessMs);
+        }
+    }
+};
+
+/**
+ * Local stand-in for the room stream server, sending 'chunkBytes' each 'periodMs'. The chunks
+ * are grouped in bursts of 'burstChunks'.
+ */
+class StreamServer : public QTcpServer
+{
+public:
+    StreamServer(int periodMs, int chunkBytes, int burstChunks, int durationMs) :
+        periodMs(periodMs),
+        chunkBytes(chunkBytes),
+        burstChunks(burstChunks),
+        durationMs(durationMs),
+        chunks(0)
+    {
+        connect(this, &QTcpServer::newConnection, this, &StreamServer::startStreaming);
+        listen(QHostAddress::LocalHost);
+    }
+
+private:
+    int periodMs;
+    int chunkBytes;
+    int burstChunks;
+    int durationMs;
+    int chunks;
+    QTimer timer;
+    QElapsedTimer clock;
+
+    void startStreaming()// only one connection
+    {
+        QTcpSocket *socket = nextPendingConnection();
+        socket->write("HTTP/1.0 200 OK\r\nContent-Type: audio/mpeg\r\nConnection: close\r\n\r\n");
+
+        connect(&timer, &QTimer::timeout, socket, [=]() {
+            if (clock.elapsed() >= durationMs) {
+                timer.stop();
+                socket->disconnectFromHost();
+                return;
+            }
+            // chunks are sent when the burst is complete
+            if (++chunks % burstChunks == 0)
+                socket->write(QByteArray(chunkBytes * burstChunks, 0));
+        });
+        clock.start();
+        timer.start(periodMs);
+    }
+};
+}
+
+/**
+ * The jitter buffer target follows the arrivals: steady streams play with a short buffer, bursty
+ * streams buffer the burst period and streams slower than real time buffer again.
+ */
+class TestStreamJitterBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initialTarget();
+    void underrunIncreasesTheTarget();
+    void playbackRateFollowsTheBufferedDuration();
+    void excessIsDropped();
+    void simulatedArrivals_data();
+    void simulatedArrivals();
+    void localHttpStream_data();
+    void localHttpStream();
+
+private:
+    static void addScheduleColumns();
+    static void checkHealth(const StreamJitterBuffer::Health &health);
+};
+
+void TestStreamJitterBuffer::initialTarget()
+{
+    StreamJitterBuffer buffer;
+    QCOMPARE(buffer.getTargetMs(), (int)StreamJitterBuffer::INITIAL_TARGET_MS);
+    QVERIFY(buffer.isBuffering());
+    QVERIFY(!buffer.update(StreamJitterBuffer::INITIAL_TARGET_MS - 1));
+    QVERIFY(buffer.update(StreamJitterBuffer::INITIAL_TARGET_MS));
+    QCOMPARE(buffer.getPlaybackRate(StreamJitterBuffer::INITIAL_TARGET_MS), 1.0f);
+}
+
+void TestStreamJitterBuffer::underrunIncreasesTheTarget()
+{
+    StreamJitterBuffer buffer;
+    int target = buffer.getTargetMs();
+    QVERIFY(buffer.update(target));
+    QVERIFY(!buffer.update(0));
+    QCOMPARE(buffer.getUnderruns(), (quint64)1);
+    QVERIFY(buffer.getTargetMs() > target);
+
+    // the penalty is kept in the next stream
+    int penaltyTarget = buffer.getTargetMs();
+    buffer.reset();
+    QCOMPARE(buffer.getTargetMs(), penaltyTarget);
+}
+
+void TestStreamJitterBuffer::playbackRateFollowsTheBufferedDuration()
+{
+    StreamJitterBuffer buffer;
+    int target = buffer.getTargetMs();
+    QVERIFY(buffer.update(target));
+
+    QCOMPARE(buffer.getPlaybackRate(target), 1.0f);
+    float fast = buffer.getPlaybackRate(target * 2);
+    float slow = buffer.getPlaybackRate(target / 4);
+    QVERIFY(fast > 1.0f);
+    QVERIFY(slow < 1.0f);
+    QVERIFY(fast <= 1.0f + StreamJitterBuffer::MAX_RATE_DEVIATION);
+    QVERIFY(slow >= 1.0f - StreamJitterBuffer::MAX_RATE_DEVIATION);
+}
+
+void TestStreamJitterBuffer::excessIsDropped()
+{
+    StreamJitterBuffer buffer;
+    int target = buffer.getTargetMs();
+    QVERIFY(buffer.update(target));
+    QCOMPARE(buffer.getExcessMs(target * 2), 0);// corrected changing the playback rate
+    QCOMPARE(buffer.getExcessMs(target * 10), target * 9);
+}
+
+void TestStreamJitterBuffer::addScheduleColumns()
+{
+    QTest::addColumn<int>("periodMs");
+    QTest::addColumn<int>("chunkBytes");
+    QTest::addColumn<int>("burstChunks");
+    QTest::addColumn<int>("minTargetMs");
+    QTest::addColumn<int>("maxTargetMs");
+    QTest::addColumn<bool>("underruns");
+    QTest::addColumn<int>("durationMs");
+}
+
+void TestStreamJitterBuffer::checkHealth(const StreamJitterBuffer::Health &health)
+{
+    QFETCH(int, minTargetMs);
+    QFETCH(int, maxTargetMs);
+    QFETCH(bool, underruns);
+
+    QVERIFY2(health.targetMs >= minTargetMs && health.targetMs <= maxTargetMs,
+             qPrintable(QString("target %1ms, jitter %2ms, spread %3ms").arg(health.targetMs)
+                        .arg(health.jitterMs).arg(health.delaySpreadMs)));
+    QCOMPARE(health.underruns > 0, underruns);
+}
+
+void TestStreamJitterBuffer::simulatedArrivals_data()
+{
+    addScheduleColumns();
+
+    // 1600 bytes each 100 ms is the stream rate
+    QTest::newRow("steady") << 100 << 1600 << 1 << 250 << 600 << false << 60000;
+    QTest::newRow("bursts each 2 seconds") << 100 << 1600 << 20 << 2000 << 3000 << false << 60000;
+    QTest::newRow("throttled 10%") << 100 << 1440 << 1 << 250 << 8000 << true << 60000;
+}
+
+void TestStreamJitterBuffer::simulatedArrivals()
+{
+    QFETCH(int, periodMs);
+    QFETCH(int, chunkBytes);
+    QFETCH(int, burstChunks);
+    QFETCH(int, durationMs);
+
+    Playout playout;
+    int chunks = 0;
+    for (qint64 time = 10; time <= durationMs; time += 10) {// audio callbacks each 10 ms
+        if (time % periodMs == 0 && ++chunks % burstChunks == 0)
+            playout.arrival(time, chunkBytes * burstChunks);
+        else
+            playout.advance(time);
+    }
+    checkHealth(playout.getHealth());
+}
+
+void TestStreamJitterBuffer::localHttpStream_data()
+{
+    addScheduleColumns();
+
+    // shorter than the simulation, the bursts are measured but there is no time to underrun
+    QTest::newRow("steady") << 50 << 800 << 1 << 250 << 1000 << false << 4000;
+    QTest::newRow("bursts each second") << 50 << 800 << 20 << 1000 << 3000 << false << 12000;
+}
+
+void TestStreamJitterBuffer::localHttpStream()
+{
+    QFETCH(int, periodMs);
+    QFETCH(int, chunkBytes);
+    QFETCH(int, burstChunks);
+    QFETCH(int, durationMs);
+
+    StreamServer server(periodMs, chunkBytes, burstChunks, durationMs);
+    QVERIFY(server.isListening());
+
+    Playout playout;
+    QElapsedTimer clock;
+    clock.start();
+
+    QNetworkAccessManager httpClient;
+    QUrl url(QString("http://127.0.0.1:%1/stream").arg(server.serverPort()));
+    QNetworkReply *reply = httpClient.get(QNetworkRequest(url));
+    connect(reply, &QNetworkReply::readyRead, [&]() {
+        playout.arrival(clock.elapsed(), reply->readAll().size());
+    });
+
+    QTimer audioCallbacks;
+    connect(&audioCallbacks, &QTimer::timeout, [&]() {
+        playout.advance(clock.elapsed());
+    });
+    audioCallbacks.start(10);
+
+    QEventLoop loop;
+    connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(durationMs + 5000, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    QVERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    checkHealth(playout.getHealth());
+    delete reply;
+}
+
+QTEST_GUILESS_MAIN(TestStreamJitterBuffer)
+
+#include "tst_StreamJitterBuffer.moc"
@@ -0,0 +1,132 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include "audio/MetronomeTrackNode.h"
+#include "audio/MetronomeSoundBank.h"
+#include "audio/core/SamplesBuffer.h"
+#include "midi/MidiDriver.h"
+
+using namespace Audio;
+
+namespace {
+const int SAMPLE_RATE = 44100;
+
+// mono sound, each sound has different samples
+SamplesBuffer createSound(int frames, float firstSample)
+{
+    SamplesBuffer sound(1, frames);
+    for (int f = 0; f < frames; ++f)
+        sound.set(0, f, firstSample + f * 0.0001f);
+    return sound;
+}
+}
+
+class TestMetronome : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void clicksCrossingBlockBoundaries_data();
+    void clicksCrossingBlockBoundaries();
+    void resampledSoundsAreCached();
+
+private:
+    // the metronome output rendered in blocks of 'blockSize' frames
+    static SamplesBuffer render(MetronomeTrackNode &metronome, int blockSize, int totalFrames);
+};
+
+SamplesBuffer TestMetronome::render(MetronomeTrackNode &metronome, int blockSize, int totalFrames)
+{
+    SamplesBuffer rendered(2, 0);
+    SamplesBuffer in(2, blockSize);
+    SamplesBuffer out(2, blockSize);
+    Midi::MidiBuffer midiBuffer(0);
+    while (rendered.getFrameLenght() < totalFrames) {
+        out.setFrameLenght(qMin(blockSize, totalFrames - rendered.getFrameLenght()));
+        out.zero();
+        metronome.processReplacing(in, out, SAMPLE_RATE, midiBuffer);
+        rendered.append(out);
+    }
+    return rendered;
+}
+
+void TestMetronome::clicksCrossingBlockBoundaries_data()
+{
+    QTest::addColumn<int>("blockSize");
+    QTest::addColumn<int>("soundFrames");
+
+    QTest::newRow("click in 3 blocks") << 128 << 300;
+    QTest::newRow("beat starting in the block middle") << 333 << 300;
+    QTest::newRow("block bigger than the beat") << 2500 << 300;
+    QTest::newRow("click cut by the next beat") << 128 << 1500;
+    QTest::newRow("one frame blocks") << 1 << 300;
+}
+
+void TestMetronome::clicksCrossingBlockBoundaries()
+{
+    QFETCH(int, blockSize);
+    QFETCH(int, soundFrames);
+
+    const int samplesPerBeat = 1000;
+    const int beats = 8;
+    const int accentBeats = 4;
+
+    // the sounds have the bank sample rate, they are not resampled
+    MetronomeTrackNode metronome(SAMPLE_RATE);
+    MetronomeSoundBank &soundBank = metronome.getSoundBank();
+    soundBank.setSound(MetronomeSoundBank::CLICK, createSound(soundFrames, 0.1f), SAMPLE_RATE);
+    soundBank.setSound(MetronomeSoundBank::MEASURE_ACCENT, createSound(soundFrames, 0.2f), SAMPLE_RATE);
+    soundBank.setSound(MetronomeSoundBank::INTERVAL_ACCENT, createSound(soundFrames, 0.3f), SAMPLE_RATE);
+    metronome.setSamplesPerBeat(samplesPerBeat);
+    metronome.setBeatsPerAccent(accentBeats);
+
+    // the metronome doesn't wrap the interval, the ninjam controller resets the position
+    SamplesBuffer rendered = render(metronome, blockSize, samplesPerBeat * beats);
+    QCOMPARE(rendered.getFrameLenght(), samplesPerBeat * beats);
+
+    for (int frame = 0; frame < rendered.getFrameLenght(); ++frame) {
+        int beat = frame / samplesPerBeat;
+        int beatPosition = frame % samplesPerBeat;
+        float firstSample = 0.1f;
+        if (beat == 0)
+            firstSample = 0.3f;
+        else if (beat % accentBeats == 0)
+            firstSample = 0.2f;
+        float expected = beatPosition < soundFrames ? firstSample + beatPosition * 0.0001f : 0.0f;
+        for (int c = 0; c < 2; ++c) {// the mono sound is played in both channels
+            if (rendered.get(c, frame) != expected)
+                QFAIL(qPrintable(QString("beat %1, frame %2, channel %3: %4 != %5")
+                                 .arg(beat).arg(beatPosition).arg(c)
+                                 .arg(rendered.get(c, frame)).arg(expected)));
+        }
+    }
+}
+
+void TestMetronome::resampledSoundsAreCached()
+{
+    MetronomeSoundBank soundBank(SAMPLE_RATE);
+    soundBank.setSound(MetronomeSoundBank::CLICK, createSound(441, 0.1f), SAMPLE_RATE);
+
+    const SamplesBuffer *original = soundBank.getSounds().getCurrent().buffers[MetronomeSoundBank::CLICK];
+    QVERIFY(original);
+    QCOMPARE(original->getFrameLenght(), 441);
+
+    soundBank.setSampleRate(48000);
+    const SamplesBuffer *resampled = soundBank.getSounds().getCurrent().buffers[MetronomeSoundBank::CLICK];
+    QVERIFY(resampled);
+    QVERIFY(qAbs(resampled->getFrameLenght() - 480) <= 1);// the same duration
+    QCOMPARE(soundBank.getSampleRate(), 48000);
+
+    // the default accents are derived from the click, played in a higher pitch (shorter)
+    const SamplesBuffer *accent = soundBank.getSounds().getCurrent().buffers[MetronomeSoundBank::INTERVAL_ACCENT];
+    QVERIFY(accent);
+    QVERIFY(accent->getFrameLenght() < resampled->getFrameLenght());
+
+    soundBank.setSampleRate(SAMPLE_RATE);
+    QCOMPARE(soundBank.getSounds().getCurrent().buffers[MetronomeSoundBank::CLICK], original);
+    soundBank.setSampleRate(48000);
+    QCOMPARE(soundBank.getSounds().getCurrent().buffers[MetronomeSoundBank::CLICK], resampled);
+}
+
+QTEST_GUILESS_MAIN(TestMetronome)
+
+#include "tst_Metronome.moc"
@@ -0,0 +1,14 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_midibuffer
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += midi/MidiDriver.h
+SOURCES += midi/MidiDriver.cpp
+SOURCES += tst_MidiBuffer.cpp
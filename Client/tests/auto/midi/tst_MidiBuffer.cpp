@@ -0,0 +1,119 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include "midi/MidiDriver.h"
+
+using namespace Midi;
+
+namespace {
+qint32 noteOn(quint8 note)
+{
+    return 0x90 | (note << 8) | (100 << 16);
+}
+}
+
+class TestMidiBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fullBufferDiscardsMessages();
+    void sortIsStable();
+    void sysExBytesAreCopied();
+    void sysExArenaLimit();
+    void copyOwnsTheSysExBytes();
+    void clearReusesTheMemory();
+};
+
+void TestMidiBuffer::fullBufferDiscardsMessages()
+{
+    MidiBuffer buffer(2);
+    for (int m = 0; m < 3; ++m)
+        buffer.addMessage(MidiMessage(noteOn(60 + m), m, 0));
+    QCOMPARE(buffer.getMessagesCount(), 2);
+    QCOMPARE(buffer.getMessage(1).getData1(), 61);
+    QCOMPARE(buffer.getMessage(2).getFrameOffset(), -1);// invalid index
+}
+
+void TestMidiBuffer::sortIsStable()
+{
+    MidiBuffer buffer(8);
+    buffer.addMessage(MidiMessage(noteOn(60), 100, 0));
+    buffer.addMessage(MidiMessage(noteOn(61), 10, 1));
+    buffer.addMessage(MidiMessage(noteOn(62), 100, 0));
+    buffer.addMessage(MidiMessage(noteOn(63), 0, 1));
+    buffer.addMessage(MidiMessage(noteOn(64), 10, 0));
+    buffer.sortByFrameOffset();
+
+    const int expectedNotes[] = {63, 61, 64, 60, 62};
+    const int expectedOffsets[] = {0, 10, 10, 100, 100};
+    QCOMPARE(buffer.getMessagesCount(), 5);
+    for (int m = 0; m < 5; ++m) {
+        QCOMPARE(buffer.getMessage(m).getData1(), expectedNotes[m]);
+        QCOMPARE(buffer.getMessage(m).getFrameOffset(), expectedOffsets[m]);
+    }
+}
+
+void TestMidiBuffer::sysExBytesAreCopied()
+{
+    quint8 sysEx[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+    MidiBuffer buffer(4, 64);
+    QVERIFY(buffer.addSysEx(sysEx, sizeof(sysEx), 32, 2));
+    sysEx[1] = 0;// the buffer has a copy
+
+    MidiMessage message = buffer.getMessage(0);
+    QVERIFY(message.isSysEx());
+    QCOMPARE(message.getStatus(), 0xF0);
+    QCOMPARE(message.getFrameOffset(), 32);
+    QCOMPARE(message.getDeviceIndex(), 2);
+    QCOMPARE(message.getSysExSize(), (int)sizeof(sysEx));
+    QCOMPARE(message.getSysExData()[1], (quint8)0x7E);
+    QCOMPARE(message.getSysExData()[5], (quint8)0xF7);
+    QVERIFY(!MidiMessage(noteOn(60), 0, 0).isSysEx());
+}
+
+void TestMidiBuffer::sysExArenaLimit()
+{
+    const quint8 sysEx[] = {0xF0, 0x01, 0x02, 0x03, 0x04, 0xF7};
+    MidiBuffer buffer(4, 10);
+    QVERIFY(buffer.addSysEx(sysEx, sizeof(sysEx), 0, 0));
+    QVERIFY(!buffer.addSysEx(sysEx, sizeof(sysEx), 0, 0));// only 4 free bytes
+    QCOMPARE(buffer.getMessagesCount(), 1);
+
+    MidiBuffer withoutSysEx(4);
+    QVERIFY(!withoutSysEx.addSysEx(sysEx, sizeof(sysEx), 0, 0));
+    QCOMPARE(withoutSysEx.getMessagesCount(), 0);
+}
+
+void TestMidiBuffer::copyOwnsTheSysExBytes()
+{
+    const quint8 sysEx[] = {0xF0, 0x43, 0x10, 0xF7};
+    MidiBuffer *buffer = new MidiBuffer(4, 16);
+    buffer->addMessage(MidiMessage(noteOn(60), 0, 0));
+    buffer->addSysEx(sysEx, sizeof(sysEx), 5, 0);
+    MidiBuffer copy(*buffer);
+    delete buffer;
+
+    QCOMPARE(copy.getMessagesCount(), 2);
+    QCOMPARE(copy.getMessage(0).getData1(), 60);
+    MidiMessage message = copy.getMessage(1);
+    QVERIFY(message.isSysEx());
+    QCOMPARE(message.getFrameOffset(), 5);
+    QCOMPARE(QByteArray((const char *)message.getSysExData(), message.getSysExSize()),
+             QByteArray((const char *)sysEx, sizeof(sysEx)));
+}
+
+void TestMidiBuffer::clearReusesTheMemory()
+{
+    const quint8 sysEx[] = {0xF0, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0xF7};
+    MidiBuffer buffer(1, 8);
+    for (int block = 0; block < 3; ++block) {
+        buffer.clear();
+        QCOMPARE(buffer.getMessagesCount(), 0);
+        QVERIFY(buffer.addSysEx(sysEx, sizeof(sysEx), block, 0));
+        QCOMPARE(buffer.getMessage(0).getFrameOffset(), block);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestMidiBuffer)
+
+#include "tst_MidiBuffer.moc"
@@ -2,6 +2,9 @@
 #include <QObject>
 #include <QString>
 #include <QtTest/QtTest>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
 #include "persistence/UsersDataCache.h"
 
 using namespace Persistence;
@@ -32,12 +35,17 @@ private slots:
 };
 
 
-// NOTE: UsersDataCache class was not able to test without side effect
-// because destructor write to storage directly.
+// NOTE: the UsersDataCache destructor writes to storage directly, the tests use the
+// QStandardPaths test mode to not change the user cache file.
 class TestUsersDataCache: public QObject
 {
     Q_OBJECT
 private slots:
+    void initTestCase();
+    void cleanup();
+
+    void findRecordedRemoteUser();
+    void findRecordedLocalUser();
 };
 
 
@@ -156,6 +164,55 @@ void TestCacheEntry::setPanGuard()
     QCOMPARE(entry.getPan(), expect);
 }
 
+void TestUsersDataCache::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    cleanup();
+}
+
+void TestUsersDataCache::cleanup()
+{
+    QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    QFile::remove(cacheDir.absoluteFilePath("tracks_cache.bin"));
+}
+
+void TestUsersDataCache::findRecordedRemoteUser()
+{
+    UsersDataCache cache;
+    CacheEntry bob("10.0.0.x", "bob", 1);
+    bob.setGain(0.5f);
+    bob.setPan(-1.0f);
+    bob.setMuted(true);
+    cache.updateUserCacheEntry(bob);
+
+    // the recorded remote tracks have the user country in the name
+    CacheEntry entry = cache.findUserCacheEntry("bob from Brazil", 1);
+    QCOMPARE(entry.getGain(), 0.5f);
+    QCOMPARE(entry.getPan(), -1.0f);
+    QVERIFY(entry.isMuted());
+
+    entry = cache.findUserCacheEntry("bob from Brazil", 0);// other channel
+    QCOMPARE(entry.getGain(), CacheEntry::DEFAULT_GAIN);
+    QCOMPARE(entry.isMuted(), CacheEntry::DEFAULT_MUTED);
+
+    entry = cache.findUserCacheEntry("alice from Brazil", 1);
+    QCOMPARE(entry.getGain(), CacheEntry::DEFAULT_GAIN);
+    QCOMPARE(entry.getPan(), CacheEntry::DEFAULT_PAN);
+}
+
+void TestUsersDataCache::findRecordedLocalUser()
+{
+    UsersDataCache cache;
+    CacheEntry alice("10.0.0.x", "alice", 0);
+    alice.setGain(0.25f);
+    cache.updateUserCacheEntry(alice);
+
+    // the local user tracks are recorded without the country
+    QCOMPARE(cache.findUserCacheEntry("alice", 0).getGain(), 0.25f);
+    QCOMPARE(cache.findUserCacheEntry("alice from United States", 0).getGain(), 0.25f);
+}
+
 int main(int argc, char *argv[])
 {
     int status = 0;
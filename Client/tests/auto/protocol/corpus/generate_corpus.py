@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Generate the seed corpus used by tst_ServerMessageParser (and by any external fuzzer).
+
+Each .bin file is a raw server-to-client NINJAM stream: a sequence of messages with a
+5 bytes header (uint8 type, uint32 little endian payload size) and the payload.
+"""
+import os
+import struct
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def message(msg_type, payload):
+    return struct.pack('<BI', msg_type, len(payload)) + payload
+
+
+def cstring(text):
+    return text.encode('utf-8') + b'\0'
+
+
+def auth_challenge(licence=None, keep_alive=30):
+    capabilities = (keep_alive << 8) | (1 if licence is not None else 0)
+    payload = bytes(range(1, 9)) + struct.pack('<II', capabilities, 0x00020000)
+    if licence is not None:
+        payload += cstring(licence)
+    return message(0x00, payload)
+
+
+def auth_reply(ok, text, max_channels=32):
+    return message(0x01, struct.pack('<B', 1 if ok else 0) + cstring(text) + struct.pack('<B', max_channels))
+
+
+def config_change(bpm, bpi):
+    return message(0x02, struct.pack('<HH', bpm, bpi))
+
+
+def user_info(channels):
+    payload = b''
+    for active, index, user, name in channels:
+        payload += struct.pack('<BBhbB', active, index, 0, 0, 0) + cstring(user) + cstring(name)
+    return message(0x03, payload)
+
+
+def download_begin(guid, user, channel, fourcc=b'OGGv', size=0):
+    return message(0x04, guid + struct.pack('<I', size) + fourcc + struct.pack('<B', channel) + cstring(user))
+
+
+def download_write(guid, data, last=False):
+    return message(0x05, guid + struct.pack('<B', 1 if last else 0) + data)
+
+
+def chat(*args):
+    return message(0xc0, b''.join(cstring(a) for a in args))
+
+
+def keep_alive():
+    return message(0xfd, b'')
+
+
+def write(name, data):
+    with open(os.path.join(HERE, name), 'wb') as f:
+        f.write(data)
+
+
+def main():
+    guid_a = bytes([0xa0 + i for i in range(16)])
+    guid_b = bytes([0x00] * 15 + [0x01])  # starts with zero, must not be seen as "stop download"
+    ogg_chunk = b'OggS' + bytes((i * 37) & 0xff for i in range(600))
+
+    write('handshake.bin',
+          auth_challenge('Be nice, the jam is recorded.\nAccept?') +
+          auth_reply(True, 'jamtaba@127.0.0.x') +
+          config_change(120, 16) +
+          user_info([(1, 0, 'alice@10.0.0.x', 'guitar'), (1, 1, 'alice@10.0.0.x', 'voice'),
+                     (1, 0, 'bob@10.0.0.x', 'bass')]) +
+          chat('TOPIC', '', 'Welcome!') +
+          chat('USERCOUNT', '3', '8'))
+
+    write('intervals.bin',
+          download_begin(guid_a, 'alice@10.0.0.x', 0, size=4000) +
+          download_write(guid_a, ogg_chunk) +
+          download_begin(guid_b, 'bob@10.0.0.x', 0) +
+          download_write(guid_b, ogg_chunk[:100]) +
+          keep_alive() +
+          download_write(guid_a, ogg_chunk[100:], last=True) +
+          download_write(guid_b, b'', last=True) +
+          download_begin(bytes(16), 'bob@10.0.0.x', 0, fourcc=bytes(4)))
+
+    write('chat.bin',
+          chat('MSG', 'alice@10.0.0.x', 'olá \U0001F3B8') +
+          chat('PRIVMSG', 'bob@10.0.0.x', 'hi') +
+          chat('JOIN', 'carol@10.0.0.x') +
+          chat('PART', 'carol@10.0.0.x') +
+          chat('MSG', 'alice@10.0.0.x', 'a', 'b', 'c', 'ignored'))
+
+    write('edge_cases.bin',
+          auth_challenge() +  # no licence
+          message(0x01, b'\0' + cstring('invalid login')) +  # max channels not sent
+          message(0x01, b'\0') +
+          user_info([]) +
+          message(0x03, struct.pack('<BBhbB', 0, 2, 0, 0, 0) + b'eve') +  # last string not terminated
+          message(0x77, b'unknown message type') +
+          message(0x02, b'\x01') +  # too short
+          message(0x05, guid_a[:8]) +  # too short
+          chat())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,330 @@
+#include <QObject>
+#include <QString>
+#include <QDir>
+#include <QFile>
+#include <QtTest/QtTest>
+#include <QtEndian>
+#include "ninjam/protocol/MessageFraming.h"
+#include "ninjam/protocol/ServerMessageParser.h"
+#include "ninjam/UserChannel.h"
+
+using namespace Ninjam;
+
+/**
+ * Framing and parsing of the server messages. The corpus files are raw server streams
+ * (see corpus/generate_corpus.py), they are replayed as is and mutated to check the parser
+ * never reads outside the received bytes.
+ */
+class TestServerMessageParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void payloadReader();
+    void framesInAnyChunkSize_data();
+    void framesInAnyChunkSize();
+    void invalidPayloadSize();
+    void authChallenge();
+    void userInfoChangeNotify();
+    void chatMessage();
+    void downloadIntervalBegin();
+    void downloadIntervalWriteIsNotCopied();
+    void malformedMessages();
+    void corpusReplay();
+    void corpusMutations();
+
+private:
+    static QByteArray message(quint8 type, const QByteArray &payload);
+    static QByteArray uint32(quint32 value);
+    static QList<QByteArray> loadCorpus();
+
+    // feed the stream in chunks and parse every frame, return the parsed messages count
+    static int replay(const QByteArray &stream, int chunkSize, int *invalidFrames = nullptr);
+};
+
+QByteArray TestServerMessageParser::uint32(quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian(value, bytes);
+    return QByteArray(reinterpret_cast<const char *>(bytes), 4);
+}
+
+QByteArray TestServerMessageParser::message(quint8 type, const QByteArray &payload)
+{
+    return QByteArray(1, (char)type) + uint32(payload.size()) + payload;
+}
+
+QList<QByteArray> TestServerMessageParser::loadCorpus()
+{
+    QList<QByteArray> corpus;
+    QDir corpusDir(QFINDTESTDATA("corpus"));
+    foreach (const QString &fileName, corpusDir.entryList(QStringList("*.bin"), QDir::Files, QDir::Name)) {
+        QFile file(corpusDir.filePath(fileName));
+        if (file.open(QFile::ReadOnly))
+            corpus.append(file.readAll());
+    }
+    return corpus;
+}
+
+int TestServerMessageParser::replay(const QByteArray &stream, int chunkSize, int *invalidFrames)
+{
+    ReceiveBuffer buffer;
+    ServerMessageParser parser;
+    int parsedMessages = 0;
+    for (int offset = 0; offset < stream.size(); offset += chunkSize) {
+        int bytes = qMin(chunkSize, stream.size() - offset);
+        std::memcpy(buffer.prepareWrite(bytes), stream.constData() + offset, bytes);
+        buffer.commitWrite(bytes);
+
+        MessageFrame frame;
+        ReceiveBuffer::FrameStatus status;
+        while ((status = buffer.nextFrame(frame)) == ReceiveBuffer::FRAME_AVAILABLE) {
+            const ServerMessage *message = parser.parse(frame);
+            if (message) {
+                QString text;
+                message->printDebug(QDebug(&text));// touch all message fields
+                parsedMessages++;
+            }
+        }
+        if (status == ReceiveBuffer::INVALID_FRAME) {
+            if (invalidFrames)
+                (*invalidFrames)++;
+            break;// the connection is closed
+        }
+    }
+    return parsedMessages;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++
+
+void TestServerMessageParser::payloadReader()
+{
+    const char data[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 'a', 'b', 0, 'c'};
+    PayloadReader reader(data, sizeof(data));
+    QCOMPARE(reader.readUInt8(), (quint8)0x01);
+    QCOMPARE(reader.readUInt16(), (quint16)0x0302);
+    QCOMPARE(reader.readUInt32(), (quint32)0x07060504);
+    QCOMPARE(reader.readString(), QString("ab"));
+    QCOMPARE(reader.readString(), QString("c"));// not terminated
+    QVERIFY(reader.atEnd());
+    QVERIFY(!reader.hasError());
+
+    QCOMPARE(reader.readString(), QString());// missing strings are allowed
+    QVERIFY(!reader.hasError());
+
+    QCOMPARE(reader.readUInt32(), (quint32)0);
+    QVERIFY(reader.hasError());
+    QVERIFY(reader.readBytes(1) == nullptr);
+}
+
+void TestServerMessageParser::framesInAnyChunkSize_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::newRow("1 byte") << 1;
+    QTest::newRow("3 bytes") << 3;
+    QTest::newRow("7 bytes") << 7;
+    QTest::newRow("TCP segment") << 1460;
+    QTest::newRow("whole stream") << (1 << 20);
+}
+
+void TestServerMessageParser::framesInAnyChunkSize()
+{
+    QFETCH(int, chunkSize);
+    QList<QByteArray> corpus = loadCorpus();
+    QVERIFY(!corpus.isEmpty());
+    foreach (const QByteArray &stream, corpus)
+        QCOMPARE(replay(stream, chunkSize), replay(stream, stream.size()));
+}
+
+void TestServerMessageParser::invalidPayloadSize()
+{
+    ReceiveBuffer buffer;
+    QByteArray stream = message(0x05, QByteArray());
+    stream.replace(1, 4, uint32(ReceiveBuffer::MAX_PAYLOAD_SIZE + 1));
+    std::memcpy(buffer.prepareWrite(stream.size()), stream.constData(), stream.size());
+    buffer.commitWrite(stream.size());
+
+    MessageFrame frame;
+    QCOMPARE(buffer.nextFrame(frame), ReceiveBuffer::INVALID_FRAME);
+}
+
+void TestServerMessageParser::authChallenge()
+{
+    QByteArray challenge("\x00\x01\x00\x02\x00\x03\x00\x04", 8);
+    quint32 capabilities = (10 << 8) | 1;// keep alive period and licence
+    QByteArray payload = challenge + uint32(capabilities) + uint32(0x00020000)
+                         + QByteArray("licence text\0", 13);
+    QByteArray stream = message(0x00, payload);
+
+    ServerMessageParser parser;
+    MessageFrame frame = {ServerMessageType::AUTH_CHALLENGE, stream.constData() + 5,
+                          (quint32)payload.size()};
+    const ServerAuthChallengeMessage *msg
+        = static_cast<const ServerAuthChallengeMessage *>(parser.parse(frame));
+    QVERIFY(msg);
+    QCOMPARE(msg->getChallenge(), challenge);
+    QCOMPARE(msg->getServerKeepAlivePeriod(), 10);
+    QCOMPARE(msg->getProtocolVersion(), 0x00020000);
+    QCOMPARE(msg->getLicenceAgreement(), QString("licence text"));
+}
+
+void TestServerMessageParser::userInfoChangeNotify()
+{
+    // active, channel index, volume, pan and flags
+    QByteArray firstChannel("\x01\x00\x00\x00\x00\x00", 6);
+    QByteArray secondChannel("\x01\x01\x00\x00\x00\x00", 6);
+    QByteArray payload = firstChannel + QByteArray("alice\0guitar\0", 13)
+                         + firstChannel + QByteArray("bob\0bass\0", 9)
+                         + secondChannel + QByteArray("alice\0voice\0", 12);
+
+    ServerMessageParser parser;
+    MessageFrame frame = {ServerMessageType::USER_INFO_CHANGE_NOTIFY, payload.constData(),
+                          (quint32)payload.size()};
+    const UserInfoChangeNotifyMessage *msg
+        = static_cast<const UserInfoChangeNotifyMessage *>(parser.parse(frame));
+    QVERIFY(msg);
+    QCOMPARE(msg->getUsersNames().size(), 2);
+    QList<UserChannel> aliceChannels = msg->getUserChannels("alice");
+    QCOMPARE(aliceChannels.size(), 2);
+    QCOMPARE(aliceChannels.at(0).getName(), QString("guitar"));
+    QCOMPARE(aliceChannels.at(1).getName(), QString("voice"));
+    QCOMPARE(aliceChannels.at(1).getIndex(), 1);
+    QCOMPARE(msg->getUserChannels("bob").at(0).getName(), QString("bass"));
+}
+
+void TestServerMessageParser::chatMessage()
+{
+    // bigger than the old 4096 bytes parser buffer
+    QString longText(5000, QChar('x'));
+    QByteArray payload = QByteArray("MSG\0alice\0", 10) + longText.toUtf8() + '\0'
+                         + QByteArray("extra\0arguments\0ignored\0", 24);
+
+    ServerMessageParser parser;
+    MessageFrame frame = {ServerMessageType::CHAT_MESSAGE, payload.constData(),
+                          (quint32)payload.size()};
+    const ServerChatMessage *msg = static_cast<const ServerChatMessage *>(parser.parse(frame));
+    QVERIFY(msg);
+    QVERIFY(msg->getCommand() == ChatCommandType::MSG);
+    QCOMPARE(msg->getArguments().size(), 4);
+    QCOMPARE(msg->getArguments().at(0), QString("alice"));
+    QCOMPARE(msg->getArguments().at(1), longText);
+}
+
+void TestServerMessageParser::downloadIntervalBegin()
+{
+    QByteArray GUID(16, '\0');
+    GUID[15] = 1;
+    QByteArray payload = GUID + uint32(1234) + QByteArray("OGGv") + QByteArray(1, 2)
+                         + QByteArray("bob\0", 4);
+
+    ServerMessageParser parser;
+    MessageFrame frame = {ServerMessageType::DOWNLOAD_INTERVAL_BEGIN, payload.constData(),
+                          (quint32)payload.size()};
+    const DownloadIntervalBegin *msg
+        = static_cast<const DownloadIntervalBegin *>(parser.parse(frame));
+    QVERIFY(msg);
+    QCOMPARE(msg->getGUID(), GUID);
+    QVERIFY(!msg->downloadShouldBeStopped());
+    QVERIFY(msg->isValidOggDownload());
+    QCOMPARE(msg->getFourCC(), QByteArray("OGGv"));
+    QCOMPARE(msg->getEstimatedSize(), (quint32)1234);
+    QCOMPARE(msg->getChannelIndex(), (quint8)2);
+    QCOMPARE(msg->getUserName(), QString("bob"));
+
+    payload.replace(20, 4, QByteArray("OGGo"));// opus intervals
+    msg = static_cast<const DownloadIntervalBegin *>(parser.parse(frame));
+    QVERIFY(msg);
+    QVERIFY(msg->isValidOggDownload());
+    QCOMPARE(msg->getFourCC(), QByteArray("OGGo"));
+
+    payload.replace(0, 16, QByteArray(16, '\0'));
+    msg = static_cast<const DownloadIntervalBegin *>(parser.parse(frame));
+    QVERIFY(msg);
+    QVERIFY(msg->downloadShouldBeStopped());
+}
+
+void TestServerMessageParser::downloadIntervalWriteIsNotCopied()
+{
+    QByteArray GUID(16, 'g');
+    QByteArray audio(3000, 'a');
+    QByteArray payload = GUID + QByteArray(1, 1) + audio;
+
+    ServerMessageParser parser;
+    MessageFrame frame = {ServerMessageType::DOWNLOAD_INTERVAL_WRITE, payload.constData(),
+                          (quint32)payload.size()};
+    const DownloadIntervalWrite *msg
+        = static_cast<const DownloadIntervalWrite *>(parser.parse(frame));
+    QVERIFY(msg);
+    QVERIFY(msg->downloadIsComplete());
+    QCOMPARE(msg->getGUID(), GUID);
+    QCOMPARE(msg->getEncodedAudioData(), audio);
+    QVERIFY(msg->getEncodedAudioData().constData() == payload.constData() + 17);
+
+    QByteArray copy;
+    copy.append(msg->getEncodedAudioData());// how the receivers keep the data
+    QVERIFY(copy.constData() != payload.constData() + 17);
+}
+
+void TestServerMessageParser::malformedMessages()
+{
+    ServerMessageParser parser;
+    QByteArray shortPayload("\x01", 1);
+    MessageFrame frame = {ServerMessageType::SERVER_CONFIG_CHANGE_NOTIFY, shortPayload.constData(),
+                          (quint32)shortPayload.size()};
+    QVERIFY(parser.parse(frame) == nullptr);
+
+    frame.type = ServerMessageType::DOWNLOAD_INTERVAL_WRITE;
+    QVERIFY(parser.parse(frame) == nullptr);
+
+    frame.type = static_cast<ServerMessageType>(0x77);
+    QVERIFY(parser.parse(frame) == nullptr);
+}
+
+void TestServerMessageParser::corpusReplay()
+{
+    int invalidFrames = 0;
+    int messages = 0;
+    foreach (const QByteArray &stream, loadCorpus())
+        messages += replay(stream, 1460, &invalidFrames);
+    QCOMPARE(invalidFrames, 0);
+    QVERIFY(messages > 0);
+}
+
+void TestServerMessageParser::corpusMutations()
+{
+    // deterministic mutations, the parser must survive any input (run with -fsanitize=address)
+    static const int MUTATIONS_PER_FILE = 2000;
+    qsrand(2016);
+    foreach (const QByteArray &original, loadCorpus()) {
+        for (int i = 0; i < MUTATIONS_PER_FILE; ++i) {
+            QByteArray stream = original;
+            int mutations = 1 + qrand() % 4;
+            for (int m = 0; m < mutations && !stream.isEmpty(); ++m) {
+                int position = qrand() % stream.size();
+                switch (qrand() % 5) {
+                case 0:
+                    stream[position] = stream.at(position) ^ (char)(1 << (qrand() % 8));
+                    break;
+                case 1:
+                    stream[position] = (char)(qrand() % 256);
+                    break;
+                case 2:
+                    stream.insert(position, (char)(qrand() % 256));
+                    break;
+                case 3:
+                    stream.remove(position, 1 + qrand() % 16);
+                    break;
+                case 4:
+                    stream.truncate(position);
+                    break;
+                }
+            }
+            int chunkSize = 1 + qrand() % 512;
+            replay(stream, chunkSize);
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(TestServerMessageParser)
+
+#include "tst_ServerMessageParser.moc"
@@ -0,0 +1,39 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_reaperproject
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+INCLUDEPATH += ../../../libs/includes/ogg
+INCLUDEPATH += ../../../libs/includes/vorbis
+VPATH += ../../../src/Common
+
+linux: LIBS += -L$$PWD/../../../libs/static/linux64
+LIBS += -lvorbisfile -lvorbisenc -lvorbis -logg
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/vorbis/VorbisEncoder.h
+HEADERS += audio/vorbis/VorbisDecoder.h
+HEADERS += audio/IntervalCodec.h
+HEADERS += recorder/RecordingDiskWriter.h
+HEADERS += recorder/ChainedTrackIndex.h
+HEADERS += recorder/JamRecorder.h
+HEADERS += recorder/ReaperProjectGenerator.h
+SOURCES += log/logging.cpp
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/SamplesBufferResampler.cpp
+SOURCES += audio/vorbis/VorbisEncoder.cpp
+SOURCES += audio/vorbis/VorbisDecoder.cpp
+SOURCES += audio/IntervalCodec.cpp
+SOURCES += recorder/RecordingDiskWriter.cpp
+SOURCES += recorder/ChainedTrackIndex.cpp
+SOURCES += recorder/JamRecorder.cpp
+SOURCES += recorder/ReaperProjectGenerator.cpp
+SOURCES += tst_ReaperProjectGenerator.cpp
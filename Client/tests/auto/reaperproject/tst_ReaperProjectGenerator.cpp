@@ -0,0 +1,157 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QUrl>
+#include "recorder/ReaperProjectGenerator.h"
+
+using namespace Recorder;
+
+namespace {
+const int BPM = 120;
+const int BPI = 16;// 8 seconds intervals
+const int SAMPLE_RATE = 44100;
+
+QByteArray readFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+QByteArray journalItem(int intervalIndex, quint8 channelIndex, const QString &userName,
+                       const QString &filePath, double sourceOffset = 0)
+{
+    return "ITEM " + QByteArray::number(intervalIndex) + " " + QByteArray::number(channelIndex)
+           + " " + QUrl::toPercentEncoding(userName) + " " + QUrl::toPercentEncoding(filePath)
+           + " " + QByteArray::number(sourceOffset) + "\n";
+}
+}
+
+class TestReaperProjectGenerator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void journalIsAppendedInEachInterval();
+    void projectIsWrittenWhenTheJamIsStopped();
+    void destroyedWithoutStopTheJam();
+
+private:
+    QTemporaryDir dir;
+    QString projectFilePath;
+    QString journalFilePath;
+    QString audioPath;
+
+    QString addFiles(ReaperProjectGenerator &generator);// return the expected journal items
+};
+
+void TestReaperProjectGenerator::init()
+{
+    QVERIFY(dir.isValid());
+    QDir jamDir(QDir(dir.path()).absoluteFilePath("jam"));
+    jamDir.removeRecursively();// the same jam name in all tests
+    projectFilePath = jamDir.absoluteFilePath("Reaper project.rpp");
+    journalFilePath = jamDir.absoluteFilePath("Reaper project.journal");
+    audioPath = jamDir.absoluteFilePath("audio");
+}
+
+QString TestReaperProjectGenerator::addFiles(ReaperProjectGenerator &generator)
+{
+    QDir audioDir(audioPath);
+    QByteArray items;
+    struct {
+        const char *userName;
+        quint8 channelIndex;
+        const char *fileName;
+        int intervalIndex;
+        double sourceOffset;
+    } files[] = {
+        {"user 1", 0, "user 1-1-1.ogg", 1, 0},
+        {"other user", 1, "other user-2-1.ogg", 1, 0},
+        {"user 1", 0, "user 1-1-2.ogg", 2, 0},
+        {"other user", 1, "other user-2.ogg", 3, 8.5}// chained track file
+    };
+    for (const auto &file : files) {
+        QString filePath = audioDir.absoluteFilePath(file.fileName);
+        generator.addAudioFile(file.userName, file.channelIndex,
+                               JamAudioFile(filePath, file.intervalIndex, file.sourceOffset));
+        items.append(journalItem(file.intervalIndex, file.channelIndex, file.userName, filePath,
+                                 file.sourceOffset));
+    }
+    return QString::fromUtf8(items);
+}
+
+void TestReaperProjectGenerator::journalIsAppendedInEachInterval()
+{
+    ReaperProjectGenerator generator;
+    Jam jam(BPM, BPI, SAMPLE_RATE, "jam", dir.path());
+    QCOMPARE(jam.getAudioAbsolutePath(), audioPath);
+    generator.startJam(jam);
+    QString expectedJournal = QString("JAM %1 %2 %3\n").arg(BPM).arg(BPI).arg(SAMPLE_RATE);
+    expectedJournal.append(addFiles(generator));
+    generator.newInterval();// the items are flushed in the journal
+
+    QTRY_COMPARE(QString::fromUtf8(readFile(journalFilePath)), expectedJournal);
+
+    // the project is rewritten only in the checkpoints, it is the empty project written in the start
+    QByteArray project = readFile(projectFilePath);
+    QVERIFY(project.startsWith("<REAPER_PROJECT"));
+    QVERIFY(!project.contains("<TRACK"));
+    QVERIFY(!project.contains("<ITEM"));
+}
+
+void TestReaperProjectGenerator::projectIsWrittenWhenTheJamIsStopped()
+{
+    {
+        ReaperProjectGenerator generator;
+        generator.startJam(Jam(BPM, BPI, SAMPLE_RATE, "jam", dir.path()));
+        addFiles(generator);
+        generator.newInterval();
+        generator.stopJam();
+    }// the commands are executed before the generator is destroyed
+
+    QVERIFY(!QFile::exists(journalFilePath));// the project is complete
+
+    QString project = QString::fromUtf8(readFile(projectFilePath));
+    QVERIFY(project.startsWith("<REAPER_PROJECT"));
+    QVERIFY(project.endsWith(">"));
+    QVERIFY(project.contains(QString("SAMPLERATE %1 ").arg(SAMPLE_RATE)));
+    QVERIFY(project.contains(QString("TEMPO %1 4 4").arg(BPM)));
+
+    // the tracks are sorted by user name and channel, the items keep the adding order
+    int otherUserTrack = project.indexOf("NAME \"other user (Channel 2)\"");
+    int userTrack = project.indexOf("NAME \"user 1 (Channel 1)\"");
+    QVERIFY(otherUserTrack >= 0);
+    QVERIFY(userTrack > otherUserTrack);
+    QCOMPARE(project.count("<TRACK"), 2);
+    QCOMPARE(project.count("<ITEM"), 4);
+
+    QString otherUserItems = project.mid(otherUserTrack, userTrack - otherUserTrack);
+    QVERIFY(otherUserItems.indexOf("other user-2-1.ogg") < otherUserItems.indexOf("other user-2.ogg"));
+    QVERIFY(otherUserItems.contains("POSITION 16\n"));// the third interval
+    QVERIFY(otherUserItems.contains("SOFFS 8.5\n"));
+
+    QString userItems = project.mid(userTrack);
+    QVERIFY(userItems.contains("POSITION 0\n"));
+    QVERIFY(userItems.contains("POSITION 8\n"));
+    QCOMPARE(userItems.count("LENGTH 8\n"), 2);
+    QCOMPARE(userItems.count("<SOURCE VORBIS"), 2);
+}
+
+void TestReaperProjectGenerator::destroyedWithoutStopTheJam()
+{
+    {
+        ReaperProjectGenerator generator;
+        generator.startJam(Jam(BPM, BPI, SAMPLE_RATE, "jam", dir.path()));
+        addFiles(generator);
+    }
+
+    QVERIFY(!QFile::exists(journalFilePath));
+    QCOMPARE(QString::fromUtf8(readFile(projectFilePath)).count("<ITEM"), 4);
+}
+
+QTEST_GUILESS_MAIN(TestReaperProjectGenerator)
+
+#include "tst_ReaperProjectGenerator.moc"
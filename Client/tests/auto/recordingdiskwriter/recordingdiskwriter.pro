@@ -0,0 +1,16 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_recordingdiskwriter
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += recorder/RecordingDiskWriter.h
+SOURCES += log/logging.cpp
+SOURCES += recorder/RecordingDiskWriter.cpp
+SOURCES += tst_RecordingDiskWriter.cpp
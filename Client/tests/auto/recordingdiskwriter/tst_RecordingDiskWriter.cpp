@@ -0,0 +1,129 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <atomic>
+#include <thread>
+#include "recorder/RecordingDiskWriter.h"
+
+#ifdef Q_OS_UNIX
+    #include <sys/stat.h>
+#endif
+
+using namespace Recorder;
+
+namespace {
+QByteArray readFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+}
+
+class TestRecordingDiskWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void writesAndAppends();
+    void fullQueueStallsTheRecorder();
+
+private:
+    QTemporaryDir dir;
+    QString getFilePath(const QString &fileName) const;
+};
+
+void TestRecordingDiskWriter::init()
+{
+    QVERIFY(dir.isValid());
+}
+
+QString TestRecordingDiskWriter::getFilePath(const QString &fileName) const
+{
+    return QDir(dir.path()).absoluteFilePath(fileName);
+}
+
+void TestRecordingDiskWriter::writesAndAppends()
+{
+    QString intervalFile = getFilePath("user-1-1.ogg");
+    QString trackFile = getFilePath("user-1.ogg");
+    QFile::remove(trackFile);
+    {
+        QFile file(trackFile);// the recording was resumed, the track file is not replaced
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("0");
+    }
+
+    {
+        RecordingDiskWriter writer;
+        writer.setSyncPolicy(RecordingDiskWriter::SyncPolicy::EACH_BATCH);
+        writer.write(intervalFile, "interval");
+        writer.append(trackFile, "1");
+        writer.append(trackFile, "23");
+        writer.sync();
+        writer.closeFiles();
+
+        QTRY_COMPARE(writer.getWrites(), 3);
+        QTRY_COMPARE(writer.getQueuedBytes(), qint64(0));
+        QCOMPARE(writer.getWrittenBytes(), qint64(11));
+        QCOMPARE(writer.getStalls(), 0);
+        QCOMPARE(writer.getStalledTime(), qint64(0));
+        QVERIFY(writer.getMaxQueuedBytes() <= 11);
+        QVERIFY(writer.getBatches() >= 1);
+    }// the queued requests are finished before the writer is destroyed
+
+    QCOMPARE(readFile(intervalFile), QByteArray("interval"));
+    QCOMPARE(readFile(trackFile), QByteArray("0123"));
+}
+
+void TestRecordingDiskWriter::fullQueueStallsTheRecorder()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The writer thread is blocked in a named pipe");
+#else
+    // the writer thread is blocked opening the pipe until the test opens the other side
+    QString pipePath = getFilePath("blocking pipe");
+    QFile::remove(pipePath);
+    QVERIFY(::mkfifo(QFile::encodeName(pipePath).constData(), 0600) == 0);
+
+    const QByteArray data(60, 'a');
+    RecordingDiskWriter writer(100);
+    writer.write(pipePath, data);
+
+    // the requests are queued without waiting only when the queue is empty, so the recorder
+    // waits in the first or in the second request until the blocked batch is finished
+    std::atomic<bool> queued(false);
+    std::thread recorder([&]() {
+        writer.write(getFilePath("other user-1-1.ogg"), data);
+        writer.append(getFilePath("user-1.ogg"), data);
+        queued = true;
+    });
+    QTest::qWait(200);
+    bool queuedWhileBlocked = queued;
+    int stallsWhileBlocked = writer.getStalls();
+
+    QFile pipe(pipePath);
+    bool pipeOpened = pipe.open(QFile::ReadOnly);
+    QByteArray pipeData = pipe.readAll();// until the writer thread closes the file
+    recorder.join();
+
+    QVERIFY(pipeOpened);
+    QCOMPARE(pipeData, data);
+    QVERIFY(!queuedWhileBlocked);
+    QVERIFY(stallsWhileBlocked >= 1);
+    QVERIFY(queued);
+    QVERIFY(writer.getStalls() <= 2);
+    QVERIFY(writer.getStalledTime() >= 100);// waiting while the test was not reading the pipe
+    QVERIFY(writer.getMaxQueuedBytes() <= data.size() * 2);
+
+    QTRY_COMPARE(writer.getWrites(), 3);
+    QTRY_COMPARE(writer.getQueuedBytes(), qint64(0));
+    QCOMPARE(writer.getWrittenBytes(), qint64(data.size() * 3));
+#endif
+}
+
+QTEST_GUILESS_MAIN(TestRecordingDiskWriter)
+
+#include "tst_RecordingDiskWriter.moc"
@@ -0,0 +1,328 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QScopedPointer>
+#include <cmath>
+#include "audio/core/AudioMixer.h"
+#include "audio/core/AudioNode.h"
+#include "audio/core/RenderSchedule.h"
+#include "midi/MidiDriver.h"
+
+using namespace Audio;
+
+namespace {
+long blockStart = 0;// position of the rendered block, the node signals are functions of the position
+
+float sampleAt(int seed, long position)
+{
+    return std::sin(position * 0.001f * seed) / seed;
+}
+
+// a stateless signal summed with the connected nodes outputs, so the nodes added while the test
+// runs render the same samples as the reference
+class SignalNode : public AudioNode
+{
+public:
+    explicit SignalNode(int seed) :
+        seed(seed)
+    {
+    }
+
+    void processReplacing(const SamplesBuffer &in, SamplesBuffer &out, int sampleRate,
+                          const Midi::MidiBuffer &midiBuffer) override
+    {
+        int frames = out.getFrameLenght();
+        internalInputBuffer.setFrameLenght(frames);
+        for (int f = 0; f < frames; ++f) {
+            float sample = sampleAt(seed, blockStart + f);
+            internalInputBuffer.set(0, f, sample);
+            internalInputBuffer.set(1, f, -sample);
+        }
+        AudioNode::processReplacing(in, out, sampleRate, midiBuffer);
+    }
+
+    const int seed;
+};
+
+// the graph rendered recursively, like the mixer did before the render schedules
+class ReferenceGraph
+{
+public:
+    QList<AudioNode *> mixerNodes;
+    QMultiHash<AudioNode *, AudioNode *> sources;
+
+    void render(int frames, QVector<float> &left, QVector<float> &right) const
+    {
+        left.fill(0, frames);
+        right.fill(0, frames);
+        foreach (AudioNode *node, mixerNodes) {
+            QVector<float> nodeLeft;
+            QVector<float> nodeRight;
+            renderNode(node, frames, nodeLeft, nodeRight);
+            for (int f = 0; f < frames; ++f) {
+                left[f] += nodeLeft[f];
+                right[f] += nodeRight[f];
+            }
+        }
+    }
+
+private:
+    void renderNode(AudioNode *node, int frames, QVector<float> &left,
+                    QVector<float> &right) const
+    {
+        int seed = static_cast<SignalNode *>(node)->seed;
+        left.resize(frames);
+        right.resize(frames);
+        for (int f = 0; f < frames; ++f) {
+            left[f] = sampleAt(seed, blockStart + f);
+            right[f] = -left[f];
+        }
+        foreach (AudioNode *source, sources.values(node)) {
+            QVector<float> sourceLeft;
+            QVector<float> sourceRight;
+            renderNode(source, frames, sourceLeft, sourceRight);
+            for (int f = 0; f < frames; ++f) {
+                left[f] += sourceLeft[f];
+                right[f] += sourceRight[f];
+            }
+        }
+        float leftGain, rightGain;
+        AudioNode::getPanGains(node->getPan(), leftGain, rightGain);
+        float commonGain = node->getGain() * node->getBoost();
+        for (int f = 0; f < frames; ++f) {
+            left[f] *= commonGain * leftGain;
+            right[f] *= commonGain * rightGain;
+        }
+    }
+};
+
+int levelOf(const RenderSchedule &schedule, int stepIndex)
+{
+    for (int level = 0; level < schedule.getLevels(); ++level) {
+        if (stepIndex < schedule.getLevelStart(level + 1))
+            return level;
+    }
+    return -1;
+}
+
+int stepOf(const RenderSchedule &schedule, const AudioNode *node)
+{
+    for (int s = 0; s < schedule.getSteps().size(); ++s) {
+        if (schedule.getSteps().at(s).node == node)
+            return s;
+    }
+    return -1;
+}
+
+const int SAMPLE_RATE = 44100;
+const int MAX_FRAMES = 256;
+}
+
+class TestRenderSchedule : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void diamondGraphLevels();
+    void chainReusesTheScratchBuffers();
+    void scratchBuffersAreNotReusedWhileRead();
+    void changedGraphMatchesRecursiveRendering();
+};
+
+void TestRenderSchedule::diamondGraphLevels()
+{
+    // top is mixed, left and right read bottom, top reads left and right
+    AudioNode top, left, right, bottom;
+    QList<AudioNode *> mixerNodes;
+    mixerNodes << &top;
+    QMultiHash<AudioNode *, AudioNode *> sources;
+    sources.insert(&top, &left);
+    sources.insert(&top, &right);
+    sources.insert(&left, &bottom);
+    sources.insert(&right, &bottom);
+
+    QScopedPointer<RenderSchedule> schedule(RenderSchedule::compile(mixerNodes, sources, MAX_FRAMES));
+    const QVector<RenderSchedule::Step> &steps = schedule->getSteps();
+    QCOMPARE(steps.size(), 4);// the shared node is rendered once
+    QCOMPARE(schedule->getLevels(), 3);
+    QCOMPARE(schedule->getMixedSteps(), 1);
+
+    QCOMPARE(levelOf(*schedule, stepOf(*schedule, &bottom)), 0);
+    QCOMPARE(levelOf(*schedule, stepOf(*schedule, &left)), 1);
+    QCOMPARE(levelOf(*schedule, stepOf(*schedule, &right)), 1);
+    QCOMPARE(levelOf(*schedule, stepOf(*schedule, &top)), 2);
+
+    const RenderSchedule::Step &bottomStep = steps.at(stepOf(*schedule, &bottom));
+    const RenderSchedule::Step &leftStep = steps.at(stepOf(*schedule, &left));
+    const RenderSchedule::Step &rightStep = steps.at(stepOf(*schedule, &right));
+    const RenderSchedule::Step &topStep = steps.at(stepOf(*schedule, &top));
+    QVERIFY(bottomStep.inputs.isEmpty());
+    QCOMPARE(leftStep.inputs.size(), 1);
+    QCOMPARE(leftStep.inputs.first(), bottomStep.output);
+    QCOMPARE(rightStep.inputs.first(), bottomStep.output);
+    QCOMPARE(topStep.inputs.size(), 2);
+    QVERIFY(topStep.inputs.contains(leftStep.output));
+    QVERIFY(topStep.inputs.contains(rightStep.output));
+    QVERIFY(leftStep.output != rightStep.output);// rendered in parallel
+
+    QVERIFY(bottomStep.hasConsumers && leftStep.hasConsumers && rightStep.hasConsumers);
+    QVERIFY(!topStep.hasConsumers);
+    QVERIFY(topStep.mixed);
+    QVERIFY(!bottomStep.mixed && !leftStep.mixed && !rightStep.mixed);
+}
+
+void TestRenderSchedule::chainReusesTheScratchBuffers()
+{
+    // each node reads only the previous one, two buffers are enough for any chain lenght
+    const int nodesCount = 8;
+    AudioNode nodes[nodesCount];
+    QList<AudioNode *> mixerNodes;
+    mixerNodes << &nodes[0];
+    QMultiHash<AudioNode *, AudioNode *> sources;
+    for (int n = 1; n < nodesCount; ++n)
+        sources.insert(&nodes[n - 1], &nodes[n]);
+
+    QScopedPointer<RenderSchedule> schedule(RenderSchedule::compile(mixerNodes, sources, MAX_FRAMES));
+    QCOMPARE(schedule->getLevels(), nodesCount);
+    QCOMPARE(schedule->getScratchBuffers(), 2);
+}
+
+void TestRenderSchedule::scratchBuffersAreNotReusedWhileRead()
+{
+    // nodes 0-3 are mixed, the others are connected in several levels and some are read by
+    // nodes in far levels, so the buffers live for different level ranges
+    const int nodesCount = 14;
+    AudioNode nodes[nodesCount];
+    QList<AudioNode *> mixerNodes;
+    for (int n = 0; n < 4; ++n)
+        mixerNodes << &nodes[n];
+    QMultiHash<AudioNode *, AudioNode *> sources;
+    int connections[][2] = {// source, destination
+        {4, 0}, {5, 0}, {6, 1}, {7, 4}, {8, 7}, {9, 8}, {10, 9}, {11, 10},
+        {11, 2},// read in the first and last levels
+        {12, 6}, {13, 12}, {13, 3}, {5, 12}, {10, 1}
+    };
+    for (const auto &connection : connections)
+        sources.insert(&nodes[connection[1]], &nodes[connection[0]]);
+
+    QScopedPointer<RenderSchedule> schedule(RenderSchedule::compile(mixerNodes, sources, MAX_FRAMES));
+    const QVector<RenderSchedule::Step> &steps = schedule->getSteps();
+    QCOMPARE(steps.size(), nodesCount);
+    QVERIFY(schedule->getScratchBuffers() < nodesCount);// the buffers are reused
+
+    // a step output is alive from the step level to the level of the last step reading it
+    QVector<int> firstLevel(steps.size());
+    QVector<int> lastLevel(steps.size());
+    for (int s = 0; s < steps.size(); ++s) {
+        firstLevel[s] = levelOf(*schedule, s);
+        lastLevel[s] = firstLevel.at(s);
+    }
+    for (int s = 0; s < steps.size(); ++s) {
+        foreach (AudioNode *source, sources.values(steps.at(s).node)) {
+            int sourceStep = stepOf(*schedule, source);
+            QVERIFY(firstLevel.at(sourceStep) < firstLevel.at(s));// rendered in a previous level
+            QVERIFY(steps.at(s).inputs.contains(steps.at(sourceStep).output));
+            lastLevel[sourceStep] = qMax(lastLevel.at(sourceStep), firstLevel.at(s));
+        }
+    }
+    for (int a = 0; a < steps.size(); ++a) {
+        for (int b = a + 1; b < steps.size(); ++b) {
+            if (steps.at(a).output != steps.at(b).output)
+                continue;
+            bool overlapped = firstLevel.at(a) <= lastLevel.at(b)
+                              && firstLevel.at(b) <= lastLevel.at(a);
+            if (overlapped)
+                QFAIL(qPrintable(QString("steps %1 and %2 share a buffer alive in levels [%3, %4] and [%5, %6]")
+                                 .arg(a).arg(b).arg(firstLevel.at(a)).arg(lastLevel.at(a))
+                                 .arg(firstLevel.at(b)).arg(lastLevel.at(b))));
+        }
+    }
+}
+
+void TestRenderSchedule::changedGraphMatchesRecursiveRendering()
+{
+    const int frames = 128;
+    AudioMixer mixer(SAMPLE_RATE);
+    ReferenceGraph reference;
+    QList<AudioNode *> nodes;
+    for (int n = 0; n < 10; ++n) {
+        SignalNode *node = new SignalNode(n + 1);
+        node->setGain(1.0f - n * 0.07f);
+        node->setPan((n % 3 - 1) * 0.4f);
+        nodes.append(node);
+    }
+
+    // the graph and the reference are changed in the same order
+    auto addNode = [&](int n) {
+        mixer.addNode(nodes.at(n));
+        reference.mixerNodes.append(nodes.at(n));
+    };
+    auto connectNodes = [&](int source, int destination) {
+        QVERIFY(mixer.connect(nodes.at(source), nodes.at(destination)));
+        reference.sources.insert(nodes.at(destination), nodes.at(source));
+    };
+    auto disconnectNodes = [&](int source, int destination) {
+        QVERIFY(mixer.disconnect(nodes.at(source), nodes.at(destination)));
+        reference.sources.remove(nodes.at(destination), nodes.at(source));
+    };
+
+    SamplesBuffer in(2, frames);
+    SamplesBuffer out(2, frames);
+    Midi::MidiBuffer midiBuffer(0);
+    QVector<float> left;
+    QVector<float> right;
+    auto compareBlocks = [&](int blocks) {
+        for (int block = 0; block < blocks; ++block) {
+            out.zero();
+            mixer.process(in, out, SAMPLE_RATE, midiBuffer);
+            reference.render(frames, left, right);
+            for (int f = 0; f < frames; ++f) {
+                if (std::fabs(out.get(0, f) - left[f]) > 1e-5f
+                    || std::fabs(out.get(1, f) - right[f]) > 1e-5f)
+                    QFAIL(qPrintable(QString("position %1: (%2, %3) != (%4, %5)")
+                                     .arg(blockStart + f).arg(out.get(0, f)).arg(out.get(1, f))
+                                     .arg(left[f]).arg(right[f])));
+            }
+            blockStart += frames;
+        }
+    };
+
+    blockStart = 0;
+    addNode(0);
+    addNode(1);
+    connectNodes(2, 0);
+    connectNodes(3, 2);
+    connectNodes(3, 1);
+    compareBlocks(4);
+
+    addNode(4);// a new branch
+    connectNodes(5, 4);
+    connectNodes(6, 5);
+    compareBlocks(4);
+
+    disconnectNodes(3, 2);// the shared node is read only by a mixer node
+    connectNodes(7, 2);
+    connectNodes(3, 7);
+    compareBlocks(4);
+
+    connectNodes(8, 6);// deeper than the other branches
+    connectNodes(9, 8);
+    connectNodes(9, 0);
+    compareBlocks(4);
+
+    mixer.removeNode(nodes.at(1));// the connections are removed too
+    reference.mixerNodes.removeAll(nodes.at(1));
+    reference.sources.remove(nodes.at(1));
+    compareBlocks(4);
+
+    disconnectNodes(5, 4);
+    addNode(5);// a source becomes a mixer node
+    compareBlocks(4);
+
+    foreach (AudioNode *node, reference.mixerNodes)
+        mixer.removeNode(node);
+    qDeleteAll(nodes);
+}
+
+QTEST_GUILESS_MAIN(TestRenderSchedule)
+
+#include "tst_RenderSchedule.moc"
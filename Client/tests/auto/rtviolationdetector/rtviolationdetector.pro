@@ -0,0 +1,18 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_rtviolationdetector
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+DEFINES += JT_RT_VIOLATION_DETECTOR
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += audio/core/RtViolationDetector.h
+SOURCES += log/logging.cpp
+SOURCES += audio/core/RtViolationDetector.cpp
+SOURCES += tst_RtViolationDetector.cpp
@@ -0,0 +1,131 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QMutex>
+#include <atomic>
+#include <thread>
+#include "audio/core/RtViolationDetector.h"
+
+using namespace Audio;
+
+namespace {
+int *volatile allocatedValue = nullptr;// the allocations are not removed by the optimizer
+
+void allocateAndDelete()
+{
+    allocatedValue = new int(1);
+    delete allocatedValue;
+    allocatedValue = nullptr;
+}
+}
+
+class TestRtViolationDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void allocationsOutsideTheAudioThreadAreNotCounted();
+    void allocationsInTheAudioThreadAreCounted();
+    void otherThreadsAreNotCounted();
+    void nestedScopes();
+    void locksAreCounted();
+    void resetClearsTheCounters();
+};
+
+void TestRtViolationDetector::init()
+{
+    RtViolationDetector::reset();
+}
+
+void TestRtViolationDetector::allocationsOutsideTheAudioThreadAreNotCounted()
+{
+    allocateAndDelete();
+    QVERIFY(!RtViolationDetector::isInAudioThread());
+    QCOMPARE(RtViolationDetector::getAllocations(), quint64(0));
+    QCOMPARE(RtViolationDetector::getDeallocations(), quint64(0));
+}
+
+void TestRtViolationDetector::allocationsInTheAudioThreadAreCounted()
+{
+    {
+        RtViolationDetector::AudioThreadScope audioThread;
+        allocateAndDelete();
+        allocateAndDelete();
+    }
+    QCOMPARE(RtViolationDetector::getAllocations(), quint64(2));
+    QCOMPARE(RtViolationDetector::getDeallocations(), quint64(2));
+}
+
+void TestRtViolationDetector::otherThreadsAreNotCounted()
+{
+    std::atomic<int> step(0);
+    std::thread otherThread([&step]() {// created outside the scope, std::thread allocates
+        while (step.load() == 0)
+            std::this_thread::yield();
+        allocateAndDelete();
+        step = 2;
+    });
+    {
+        RtViolationDetector::AudioThreadScope audioThread;// marked in this thread only
+        step = 1;
+        while (step.load() != 2)
+            std::this_thread::yield();
+    }
+    otherThread.join();
+    QCOMPARE(RtViolationDetector::getAllocations(), quint64(0));
+    QCOMPARE(RtViolationDetector::getDeallocations(), quint64(0));
+}
+
+void TestRtViolationDetector::nestedScopes()
+{
+    bool inAudioThreadAfterInnerScope;
+    {
+        RtViolationDetector::AudioThreadScope audioThread;
+        {
+            RtViolationDetector::AudioThreadScope innerScope;
+        }
+        inAudioThreadAfterInnerScope = RtViolationDetector::isInAudioThread();
+        allocateAndDelete();
+    }
+    QVERIFY(inAudioThreadAfterInnerScope);
+    QVERIFY(!RtViolationDetector::isInAudioThread());
+    QCOMPARE(RtViolationDetector::getAllocations(), quint64(1));
+}
+
+void TestRtViolationDetector::locksAreCounted()
+{
+    QMutex mutex;
+    {
+        RtCheckedMutexLocker locker(&mutex);// not counted, outside the audio thread
+    }
+    {
+        RtViolationDetector::AudioThreadScope audioThread;
+        RtCheckedMutexLocker locker(&mutex);
+        locker.unlock();
+        locker.unlock();// not locked, ignored
+        locker.relock();
+        locker.relock();// already locked, ignored
+    }
+    QCOMPARE(RtViolationDetector::getLocks(), quint64(2));
+    QVERIFY(mutex.tryLock());// released by the locker destructor
+    mutex.unlock();
+}
+
+void TestRtViolationDetector::resetClearsTheCounters()
+{
+    QMutex mutex;
+    {
+        RtViolationDetector::AudioThreadScope audioThread;
+        allocateAndDelete();
+        RtCheckedMutexLocker locker(&mutex);
+    }
+    QVERIFY(RtViolationDetector::getAllocations() > 0);
+    RtViolationDetector::reset();
+    QCOMPARE(RtViolationDetector::getAllocations(), quint64(0));
+    QCOMPARE(RtViolationDetector::getDeallocations(), quint64(0));
+    QCOMPARE(RtViolationDetector::getLocks(), quint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestRtViolationDetector)
+
+#include "tst_RtViolationDetector.moc"
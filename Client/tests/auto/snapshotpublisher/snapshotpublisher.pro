@@ -0,0 +1,13 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_snapshotpublisher
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += audio/core/SnapshotPublisher.h
+SOURCES += tst_SnapshotPublisher.cpp
@@ -0,0 +1,153 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include "audio/core/SnapshotPublisher.h"
+
+using namespace Audio;
+
+namespace {
+// all values are equal to the values count, a reader seeing other values read a changing snapshot
+struct Values
+{
+    Values()
+    {
+        instances++;
+    }
+
+    Values(const Values &other) :
+        values(other.values)
+    {
+        instances++;
+    }
+
+    ~Values()
+    {
+        values.fill(-1);// a reader using a deleted snapshot sees invalid values
+        instances--;
+    }
+
+    bool isConsistent() const
+    {
+        for (int value : values) {
+            if (value != values.size())
+                return false;
+        }
+        return true;
+    }
+
+    QVector<int> values;
+    static std::atomic<int> instances;
+};
+
+std::atomic<int> Values::instances(0);
+
+void grow(Values &snapshot)
+{
+    snapshot.values.append(0);
+    snapshot.values.fill(snapshot.values.size());
+}
+}
+
+class TestSnapshotPublisher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void modifyWaitsTheReaders();
+    void newReadersSeeTheNewSnapshot();
+    void readersDrainingDuringModify();
+    void oldSnapshotsAreDeleted();
+};
+
+void TestSnapshotPublisher::modifyWaitsTheReaders()
+{
+    SnapshotPublisher<Values> publisher;
+    std::atomic<bool> modified(false);
+    std::thread writer;
+    bool modifiedWhileReading;
+    int readValues;
+    {
+        SnapshotPublisher<Values>::Reader reader(publisher);
+        writer = std::thread([&publisher, &modified]() {
+            publisher.modify(grow);
+            modified = true;
+        });
+        QTest::qWait(100);
+        modifiedWhileReading = modified;
+        readValues = reader->values.size();
+    }
+    writer.join();
+
+    QVERIFY(!modifiedWhileReading);// the reader could still see the old snapshot
+    QCOMPARE(readValues, 0);
+    QVERIFY(modified);
+    QCOMPARE(publisher.getCurrent().values.size(), 1);
+}
+
+void TestSnapshotPublisher::newReadersSeeTheNewSnapshot()
+{
+    SnapshotPublisher<Values> publisher;
+    publisher.modify(grow);
+    SnapshotPublisher<Values>::Reader reader(publisher);
+    QCOMPARE(reader->values.size(), 1);
+    QVERIFY(reader->isConsistent());
+}
+
+void TestSnapshotPublisher::readersDrainingDuringModify()
+{
+    const int modifications = 2000;
+    SnapshotPublisher<Values> publisher;
+    std::atomic<bool> writing(true);
+    std::atomic<int> inconsistentReads(0);
+    std::atomic<int> backwardReads(0);
+    std::atomic<int> reads(0);
+
+    // like the audio thread, the readers never block and read each snapshot many times
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.push_back(std::thread([&]() {
+            int lastSize = 0;
+            while (writing) {
+                SnapshotPublisher<Values>::Reader reader(publisher);
+                const Values &snapshot = *reader;
+                if (!snapshot.isConsistent())
+                    inconsistentReads++;
+                if (snapshot.values.size() < lastSize)
+                    backwardReads++;
+                lastSize = snapshot.values.size();
+                reads++;
+            }
+        }));
+    }
+
+    for (int m = 0; m < modifications; ++m)
+        publisher.modify(grow);
+    writing = false;
+    for (std::thread &reader : readers)
+        reader.join();
+
+    QVERIFY(reads > 0);
+    QCOMPARE(inconsistentReads.load(), 0);
+    QCOMPARE(backwardReads.load(), 0);// a snapshot is never replaced by an older one
+    QCOMPARE(publisher.getCurrent().values.size(), modifications);
+    QVERIFY(publisher.getCurrent().isConsistent());
+}
+
+void TestSnapshotPublisher::oldSnapshotsAreDeleted()
+{
+    {
+        SnapshotPublisher<Values> publisher;
+        QCOMPARE(Values::instances.load(), 1);
+        for (int m = 0; m < 10; ++m) {
+            publisher.modify(grow);
+            QCOMPARE(Values::instances.load(), 1);// deleted when modify() returns
+        }
+    }
+    QCOMPARE(Values::instances.load(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestSnapshotPublisher)
+
+#include "tst_SnapshotPublisher.moc"
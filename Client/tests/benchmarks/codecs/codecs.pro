@@ -0,0 +1,44 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_codecs
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+INCLUDEPATH += ../../../libs/includes/ogg
+INCLUDEPATH += ../../../libs/includes/vorbis
+VPATH += ../../../src/Common
+
+linux: LIBS += -L$$PWD/../../../libs/static/linux64
+LIBS += -lvorbisfile -lvorbisenc -lvorbis -logg
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/core/SamplesBufferKernels.h
+HEADERS += audio/SamplesBufferResampler.h
+HEADERS += audio/vorbis/VorbisEncoder.h
+HEADERS += audio/vorbis/VorbisDecoder.h
+HEADERS += audio/IntervalCodec.h
+SOURCES += log/logging.cpp
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/SamplesBufferResampler.cpp
+SOURCES += audio/vorbis/VorbisEncoder.cpp
+SOURCES += audio/vorbis/VorbisDecoder.cpp
+SOURCES += audio/IntervalCodec.cpp
+SOURCES += tst_IntervalCodecs.cpp
+
+# the opus rows are benchmarked only with 'qmake CONFIG+=opus'
+CONFIG(opus) {
+    DEFINES += JAMTABA_OPUS_CODEC
+    INCLUDEPATH += ../../../libs/includes/opus
+    HEADERS += audio/opus/OpusIntervalEncoder.h
+    HEADERS += audio/opus/OpusIntervalDecoder.h
+    SOURCES += audio/opus/OpusIntervalEncoder.cpp
+    SOURCES += audio/opus/OpusIntervalDecoder.cpp
+    LIBS += -lopus
+}
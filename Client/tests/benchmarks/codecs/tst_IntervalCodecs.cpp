@@ -0,0 +1,194 @@
+#include <QObject>
+#include <QString>
+#include <QtTest/QtTest>
+#include <QScopedPointer>
+#include <cmath>
+#include "audio/IntervalCodec.h"
+#include "audio/core/SamplesBuffer.h"
+#ifdef JAMTABA_OPUS_CODEC
+    #include "audio/opus/OpusIntervalEncoder.h"
+#endif
+
+using namespace Audio;
+
+/**
+ * CPU cost of the NINJAM interval codecs. The opus encoder uses the same bitrate produced by
+ * the vorbis encoder, so both codecs are compared in the same upload bandwidth.
+ */
+class TestIntervalCodecs : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void encode_data();
+    void encode();
+    void decode_data();
+    void decode();
+    void decodeRestarted_data();
+    void decodeRestarted();// the same decoder in all intervals, like the ninjam tracks
+
+private:
+    static const int SAMPLE_RATE = 44100;
+    static const int INTERVAL_FRAMES = SAMPLE_RATE * 4;
+    static const int AUDIO_BUFFER_FRAMES = 2048;// the encoding threads receive blocks like this
+    static const int MAX_FRAMES_PER_DECODE = 4096;
+
+    static void addRows();
+    static SamplesBuffer createInterval(int channels);
+    static IntervalEncoder *createEncoder(IntervalCodec codec, int channels);
+    static QByteArray encodeInterval(IntervalEncoder *encoder, const SamplesBuffer &interval);
+    static int decodeInterval(IntervalDecoder *decoder, const QByteArray &encodedInterval);
+    static int getVorbisBitrate(int channels);
+};
+
+void TestIntervalCodecs::addRows()
+{
+    QTest::addColumn<int>("codec");
+    QTest::addColumn<int>("channels");
+    QTest::newRow("vorbis mono") << (int)IntervalCodec::VORBIS << 1;
+    QTest::newRow("vorbis stereo") << (int)IntervalCodec::VORBIS << 2;
+#ifdef JAMTABA_OPUS_CODEC
+    QTest::newRow("opus mono") << (int)IntervalCodec::OPUS << 1;
+    QTest::newRow("opus stereo") << (int)IntervalCodec::OPUS << 2;
+#endif
+}
+
+SamplesBuffer TestIntervalCodecs::createInterval(int channels)
+{
+    // some harmonics and noise, closer to music than a pure sine wave
+    SamplesBuffer interval(channels, INTERVAL_FRAMES);
+    for (int c = 0; c < channels; ++c) {
+        float *samples = interval.getSamplesArray(c);
+        for (int s = 0; s < INTERVAL_FRAMES; ++s) {
+            double t = (double)s / SAMPLE_RATE;
+            double value = 0.3 * std::sin(2 * M_PI * 220 * t) + 0.15 * std::sin(2 * M_PI * 330 * t)
+                           + 0.05 * std::sin(2 * M_PI * (1760 + c * 5) * t);
+            samples[s] = (float)(value + ((qrand() / (double)RAND_MAX) - 0.5) * 0.02);
+        }
+    }
+    return interval;
+}
+
+int TestIntervalCodecs::getVorbisBitrate(int channels)
+{
+    QScopedPointer<IntervalEncoder> encoder(IntervalCodecs::createEncoder(IntervalCodec::VORBIS,
+                                                                           channels, SAMPLE_RATE));
+    QByteArray encoded = encodeInterval(encoder.data(), createInterval(channels));
+    return (qint64)encoded.size() * 8 * SAMPLE_RATE / INTERVAL_FRAMES;
+}
+
+IntervalEncoder *TestIntervalCodecs::createEncoder(IntervalCodec codec, int channels)
+{
+#ifdef JAMTABA_OPUS_CODEC
+    if (codec == IntervalCodec::OPUS)
+        return new OpusIntervalEncoder(channels, SAMPLE_RATE, getVorbisBitrate(channels));
+#endif
+    return IntervalCodecs::createEncoder(codec, channels, SAMPLE_RATE);
+}
+
+QByteArray TestIntervalCodecs::encodeInterval(IntervalEncoder *encoder, const SamplesBuffer &interval)
+{
+    QByteArray encoded;
+    SamplesBuffer block(interval.getChannels(), AUDIO_BUFFER_FRAMES);
+    for (int position = 0; position < INTERVAL_FRAMES; position += AUDIO_BUFFER_FRAMES) {
+        int frames = qMin(AUDIO_BUFFER_FRAMES, INTERVAL_FRAMES - position);
+        block.setFrameLenght(frames);
+        block.set(interval, position, frames, 0);
+        encoded.append(encoder->encode(block));
+    }
+    encoded.append(encoder->finishIntervalEncoding());
+    return encoded;
+}
+
+int TestIntervalCodecs::decodeInterval(IntervalDecoder *decoder, const QByteArray &encodedInterval)
+{
+    decoder->addInput(encodedInterval, true);
+    int decodedFrames = 0;
+    while (true) {
+        const SamplesBuffer &samples = decoder->decode(MAX_FRAMES_PER_DECODE);
+        if (samples.isEmpty())
+            break;
+        decodedFrames += samples.getFrameLenght();
+    }
+    return decodedFrames;
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++
+
+void TestIntervalCodecs::encode_data()
+{
+    addRows();
+}
+
+void TestIntervalCodecs::encode()
+{
+    QFETCH(int, codec);
+    QFETCH(int, channels);
+
+    SamplesBuffer interval = createInterval(channels);
+    QScopedPointer<IntervalEncoder> encoder(createEncoder((IntervalCodec)codec, channels));
+    QByteArray encoded;
+    QBENCHMARK {
+        encoded = encodeInterval(encoder.data(), interval);
+    }
+
+    QCOMPARE(IntervalCodecs::detect(encoded), (IntervalCodec)codec);
+    QVERIFY(IntervalCodecs::getAdvertisedDecoders(encoded).contains(IntervalCodec::VORBIS));
+    qDebug() << "encoded bitrate:" << (qint64)encoded.size() * 8 * SAMPLE_RATE / INTERVAL_FRAMES / 1000
+             << "kbps";
+}
+
+void TestIntervalCodecs::decode_data()
+{
+    addRows();
+}
+
+void TestIntervalCodecs::decode()
+{
+    QFETCH(int, codec);
+    QFETCH(int, channels);
+
+    QScopedPointer<IntervalEncoder> encoder(createEncoder((IntervalCodec)codec, channels));
+    QByteArray encoded = encodeInterval(encoder.data(), createInterval(channels));
+
+    int decodedFrames = 0;
+    int decoderSampleRate = 0;
+    QBENCHMARK {
+        QScopedPointer<IntervalDecoder> decoder(IntervalCodecs::createDecoder((IntervalCodec)codec));
+        decodedFrames = decodeInterval(decoder.data(), encoded);
+        decoderSampleRate = decoder->getSampleRate();
+    }
+
+    // the decoded interval has the original length (in the decoder sample rate)
+    int expectedFrames = (qint64)INTERVAL_FRAMES * decoderSampleRate / SAMPLE_RATE;
+    QVERIFY(qAbs(decodedFrames - expectedFrames) <= 2);
+}
+
+void TestIntervalCodecs::decodeRestarted_data()
+{
+    addRows();
+}
+
+void TestIntervalCodecs::decodeRestarted()
+{
+    QFETCH(int, codec);
+    QFETCH(int, channels);
+
+    QScopedPointer<IntervalEncoder> encoder(createEncoder((IntervalCodec)codec, channels));
+    QByteArray firstInterval = encodeInterval(encoder.data(), createInterval(channels));
+    QByteArray encoded = encodeInterval(encoder.data(), createInterval(channels));
+
+    QScopedPointer<IntervalDecoder> decoder(IntervalCodecs::createDecoder((IntervalCodec)codec));
+    int firstFrames = decodeInterval(decoder.data(), firstInterval);
+    int decodedFrames = 0;
+    QBENCHMARK {
+        decoder->restart();// the stream headers parsed in the last interval are reused
+        decodedFrames = decodeInterval(decoder.data(), encoded);
+    }
+
+    QCOMPARE(decodedFrames, firstFrames);
+}
+
+QTEST_APPLESS_MAIN(TestIntervalCodecs)
+
+#include "tst_IntervalCodecs.moc"
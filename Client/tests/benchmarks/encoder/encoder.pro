@@ -0,0 +1,36 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_encoder_latency
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+INCLUDEPATH += ../../../libs/includes/ogg
+INCLUDEPATH += ../../../libs/includes/vorbis
+VPATH += ../../../src/Common
+
+linux: LIBS += -L$$PWD/../../../libs/static/linux64
+LIBS += -lvorbisfile -lvorbisenc -lvorbis -logg
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/core/SamplesBufferKernels.h
+HEADERS += audio/core/SpscQueue.h
+HEADERS += audio/core/RtSemaphore.h
+HEADERS += audio/vorbis/VorbisEncoder.h
+HEADERS += audio/vorbis/VorbisDecoder.h
+HEADERS += audio/IntervalCodec.h
+HEADERS += audio/NinjamIntervalEncoder.h
+SOURCES += log/logging.cpp
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/core/RtSemaphore.cpp
+SOURCES += audio/vorbis/VorbisEncoder.cpp
+SOURCES += audio/vorbis/VorbisDecoder.cpp
+SOURCES += audio/IntervalCodec.cpp
+SOURCES += audio/NinjamIntervalEncoder.cpp
+SOURCES += tst_EncoderLatency.cpp
@@ -0,0 +1,133 @@
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtTest/QtTest>
+#include <atomic>
+#include <vector>
+#include "audio/NinjamIntervalEncoder.h"
+#include "audio/core/SamplesBuffer.h"
+
+/**
+ * Encode latency of the NINJAM intervals: the time between the last part of an interval being
+ * added by the audio thread and the last encoded bytes of all channels being available to
+ * upload. The audio thread is simulated, the input is pushed faster than real time to keep the
+ * benchmark short.
+ */
+class TestEncoderLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void intervalLatency_data();
+    void intervalLatency();
+
+private:
+    static const int SAMPLE_RATE = 44100;
+    static const int INTERVAL_FRAMES = SAMPLE_RATE * 2;
+    static const int INTERVALS = 4;
+    static const int AUDIO_BUFFER_FRAMES = 256;
+    static const int SPEED_FACTOR = 4;// the simulated audio thread runs 4x faster than real time
+
+    static void fillWithNoise(Audio::SamplesBuffer &buffer);
+};
+
+void TestEncoderLatency::fillWithNoise(Audio::SamplesBuffer &buffer)
+{
+    for (int c = 0; c < buffer.getChannels(); ++c) {
+        float *samples = buffer.getSamplesArray(c);
+        for (int s = 0; s < buffer.getFrameLenght(); ++s)
+            samples[s] = (qrand() / (float)RAND_MAX) * 0.5f - 0.25f;
+    }
+}
+
+void TestEncoderLatency::intervalLatency_data()
+{
+    QTest::addColumn<int>("channels");// transmitted channels, each one has its own encoder
+    QTest::newRow("1 channel") << 1;
+    QTest::newRow("4 channels") << 4;
+    QTest::newRow("8 channels") << 8;
+}
+
+void TestEncoderLatency::intervalLatency()
+{
+    QFETCH(int, channels);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the encoded time of each interval in each channel, written only by the encoder thread
+    std::vector<std::vector<qint64> > lastPartEncodedTimes(channels);
+    std::atomic<int> encodedIntervals(0);
+    std::vector<NinjamIntervalEncoder *> encoders;
+    for (int c = 0; c < channels; ++c) {
+        NinjamIntervalEncoder *encoder = new NinjamIntervalEncoder(c);
+        std::vector<qint64> *encodedTimes = &lastPartEncodedTimes[c];
+        QObject::connect(encoder, &NinjamIntervalEncoder::encodedAudioAvailable,
+                         [&timer, &encodedIntervals, encodedTimes](const QByteArray &, quint8, bool,
+                                                                   bool isLastPart) {
+            if (isLastPart) {
+                encodedTimes->push_back(timer.nsecsElapsed());
+                encodedIntervals.fetch_add(1);
+            }
+        });
+        encoders.push_back(encoder);
+    }
+
+    Audio::SamplesBuffer input(2, INTERVAL_FRAMES);
+    fillWithNoise(input);
+    Audio::SamplesBuffer audioBuffer(2, AUDIO_BUFFER_FRAMES);
+
+    std::vector<qint64> lastPartAddedTimes;
+    qint64 startTime = timer.nsecsElapsed();
+    qint64 processedFrames = 0;
+    for (int interval = 0; interval < INTERVALS; ++interval) {
+        for (int position = 0; position < INTERVAL_FRAMES; position += AUDIO_BUFFER_FRAMES) {
+            int frames = qMin(AUDIO_BUFFER_FRAMES, INTERVAL_FRAMES - position);
+            audioBuffer.setFrameLenght(frames);
+            audioBuffer.set(input, position, frames, 0);
+            bool isFirstPart = position == 0;
+            bool isLastPart = position + frames >= INTERVAL_FRAMES;
+            for (NinjamIntervalEncoder *encoder : encoders)
+                encoder->addSamples(audioBuffer, SAMPLE_RATE, isFirstPart, isLastPart);
+            if (isLastPart)
+                lastPartAddedTimes.push_back(timer.nsecsElapsed());
+
+            // wait like an audio callback
+            processedFrames += frames;
+            qint64 audioTime = processedFrames * 1000000000LL / (SAMPLE_RATE * SPEED_FACTOR);
+            qint64 ahead = audioTime - (timer.nsecsElapsed() - startTime);
+            if (ahead > 0)
+                QThread::usleep(ahead / 1000);
+        }
+    }
+
+    while (encodedIntervals.load() < channels * INTERVALS && timer.elapsed() < 60000)
+        QThread::msleep(1);
+
+    int droppedFrames = 0;
+    for (NinjamIntervalEncoder *encoder : encoders) {
+        droppedFrames += encoder->getDroppedFrames();
+        delete encoder;// stop the thread, lastPartEncodedTimes is not changed after this point
+    }
+    QCOMPARE(encodedIntervals.load(), channels * INTERVALS);
+
+    double totalLatency = 0;
+    double maxLatency = 0;
+    for (int interval = 0; interval < INTERVALS; ++interval) {
+        qint64 lastChannelEncoded = 0;
+        for (int c = 0; c < channels; ++c)
+            lastChannelEncoded = qMax(lastChannelEncoded, lastPartEncodedTimes[c].at(interval));
+        double latency = (lastChannelEncoded - lastPartAddedTimes.at(interval)) / 1e6;
+        totalLatency += latency;
+        maxLatency = qMax(maxLatency, latency);
+    }
+    double averageLatency = totalLatency / INTERVALS;
+    qDebug() << channels << "channels, encode latency per interval:" << averageLatency
+             << "ms (max" << maxLatency << "ms), dropped frames:" << droppedFrames;
+    QTest::setBenchmarkResult(averageLatency, QTest::WalltimeMilliseconds);
+}
+
+QTEST_APPLESS_MAIN(TestEncoderLatency)
+
+#include "tst_EncoderLatency.moc"
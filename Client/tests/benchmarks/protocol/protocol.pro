@@ -0,0 +1,22 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_protocol_throughput
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += log/Logging.h
+HEADERS += ninjam/UserChannel.h
+HEADERS += ninjam/protocol/ServerMessages.h
+HEADERS += ninjam/protocol/ServerMessageParser.h
+HEADERS += ninjam/protocol/MessageFraming.h
+SOURCES += log/logging.cpp
+SOURCES += ninjam/UserChannel.cpp
+SOURCES += ninjam/protocol/ServerMessages.cpp
+SOURCES += ninjam/protocol/ServerMessageParser.cpp
+SOURCES += ninjam/protocol/MessageFraming.cpp
+SOURCES += tst_ProtocolThroughput.cpp
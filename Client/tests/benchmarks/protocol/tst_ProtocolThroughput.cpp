@@ -0,0 +1,142 @@
+#include <QObject>
+#include <QString>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtTest/QtTest>
+#include <QtEndian>
+#include "ninjam/protocol/MessageFraming.h"
+#include "ninjam/protocol/ServerMessageParser.h"
+
+using namespace Ninjam;
+
+/**
+ * Replay a server stream through the receive buffer and the parser, like Service::socketReadSlot.
+ *
+ * The stream is read from the file in the JAMTABA_NINJAM_CAPTURE environment variable (the raw
+ * bytes received from a server, captured with tcpdump/wireshark "follow TCP stream" saved as raw).
+ * When the variable is not defined a jam with 8 users and 2 channels per user is synthesized.
+ */
+class TestProtocolThroughput : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void replay_data();
+    void replay();
+
+private:
+    QByteArray stream;
+
+    static QByteArray synthesizeJam(int users, int channelsPerUser, int intervals);
+    static QByteArray message(quint8 type, const QByteArray &payload);
+};
+
+QByteArray TestProtocolThroughput::message(quint8 type, const QByteArray &payload)
+{
+    uchar size[4];
+    qToLittleEndian((quint32)payload.size(), size);
+    return QByteArray(1, (char)type) + QByteArray(reinterpret_cast<const char *>(size), 4) + payload;
+}
+
+QByteArray TestProtocolThroughput::synthesizeJam(int users, int channelsPerUser, int intervals)
+{
+    static const int INTERVAL_BYTES = 64000;// 8 seconds intervals at 64 kbps
+    static const int CHUNK_BYTES = 4096;// ninjam servers forward the chunks sent by the clients
+
+    QByteArray jam;
+    QByteArray audio(CHUNK_BYTES, 'a');
+    for (int interval = 0; interval < intervals; ++interval) {
+        for (int user = 0; user < users; ++user) {
+            QByteArray userName = "user" + QByteArray::number(user) + "@127.0.0.x";
+            for (int channel = 0; channel < channelsPerUser; ++channel) {
+                QByteArray GUID(16, (char)(1 + channel));
+                GUID[0] = (char)user;
+                GUID[1] = (char)interval;
+
+                uchar estimatedSize[4];
+                qToLittleEndian((quint32)INTERVAL_BYTES, estimatedSize);
+                QByteArray begin = GUID + QByteArray(reinterpret_cast<const char *>(estimatedSize), 4)
+                                   + QByteArray("OGGv") + QByteArray(1, (char)channel)
+                                   + userName + '\0';
+                jam += message(0x04, begin);
+
+                for (int bytes = 0; bytes < INTERVAL_BYTES; bytes += CHUNK_BYTES) {
+                    bool lastChunk = bytes + CHUNK_BYTES >= INTERVAL_BYTES;
+                    jam += message(0x05, GUID + QByteArray(1, lastChunk ? 1 : 0) + audio);
+                }
+            }
+        }
+        jam += message(0xc0, QByteArray("MSG\0user0@127.0.0.x\0nice groove!\0", 33));
+        jam += message(0xfd, QByteArray());
+    }
+    return jam;
+}
+
+void TestProtocolThroughput::initTestCase()
+{
+    QString capturePath = QString::fromLocal8Bit(qgetenv("JAMTABA_NINJAM_CAPTURE"));
+    if (!capturePath.isEmpty()) {
+        QFile file(capturePath);
+        QVERIFY2(file.open(QFile::ReadOnly), qPrintable("Can't open " + capturePath));
+        stream = file.readAll();
+        qDebug() << "Replaying" << capturePath;
+    } else {
+        stream = synthesizeJam(8, 2, 16);
+        qDebug() << "Replaying a synthesized jam (define JAMTABA_NINJAM_CAPTURE to use a capture)";
+    }
+    qDebug() << "Stream size:" << stream.size() / 1024 << "KB";
+}
+
+void TestProtocolThroughput::replay_data()
+{
+    QTest::addColumn<int>("readSize");// bytes available in each socketReadSlot call
+    QTest::newRow("TCP segment") << 1460;
+    QTest::newRow("16 KB") << 16 * 1024;
+    QTest::newRow("64 KB") << 64 * 1024;
+}
+
+void TestProtocolThroughput::replay()
+{
+    QFETCH(int, readSize);
+
+    int messages = 0;
+    qint64 audioBytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    int replays = 0;
+    QBENCHMARK {
+        ReceiveBuffer buffer;
+        ServerMessageParser parser;
+        messages = 0;
+        audioBytes = 0;
+        for (int offset = 0; offset < stream.size(); offset += readSize) {
+            int bytes = qMin(readSize, stream.size() - offset);
+            std::memcpy(buffer.prepareWrite(bytes), stream.constData() + offset, bytes);
+            buffer.commitWrite(bytes);
+
+            MessageFrame frame;
+            while (buffer.nextFrame(frame) == ReceiveBuffer::FRAME_AVAILABLE) {
+                const ServerMessage *message = parser.parse(frame);
+                if (!message)
+                    continue;
+                messages++;
+                if (message->getMessageType() == ServerMessageType::DOWNLOAD_INTERVAL_WRITE) {
+                    const DownloadIntervalWrite *write
+                        = static_cast<const DownloadIntervalWrite *>(message);
+                    audioBytes += write->getEncodedAudioData().size();
+                }
+            }
+        }
+        replays++;
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    double megabytesPerSecond = (double)stream.size() * replays / (1024 * 1024) / seconds;
+    qDebug() << messages << "messages," << audioBytes / 1024 << "KB of audio,"
+             << megabytesPerSecond << "MB/s";
+}
+
+QTEST_APPLESS_MAIN(TestProtocolThroughput)
+
+#include "tst_ProtocolThroughput.moc"
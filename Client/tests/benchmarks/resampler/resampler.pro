@@ -0,0 +1,21 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_resampler
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+INCLUDEPATH += ../../../src/Common/audio
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/core/SamplesBufferKernels.h
+HEADERS += audio/SamplesBufferResampler.h
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += audio/SamplesBufferResampler.cpp
+SOURCES += tst_SamplesBufferResampler.cpp
@@ -0,0 +1,251 @@
+#include <QObject>
+#include <QString>
+#include <QtTest/QtTest>
+#include <cmath>
+#include "audio/core/SamplesBuffer.h"
+#include "audio/SamplesBufferResampler.h"
+
+using namespace Audio;
+
+Q_DECLARE_METATYPE(SamplesBufferResampler::Quality)
+
+/**
+ * THD+N and aliasing measures for the resampler presets, and an offline benchmark.
+ *
+ * A sine is resampled in small blocks (like in the audio callback) and the best fitting
+ * sine in the output is removed. Everything left is distortion, noise or clicks in the
+ * block edges.
+ */
+class TestSamplesBufferResampler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void thdPlusNoise_data();
+    void thdPlusNoise();
+
+    void aliasing_data();
+    void aliasing();
+
+    void blockSizeIndependence();
+    void inputBiggerThanTheHistory();
+    void passThroughWithShortInput();
+
+    void offlineBenchmark_data();
+    void offlineBenchmark();
+
+private:
+    static QVector<float> resampleSine(SamplesBufferResampler::Quality quality, int sourceSampleRate,
+                                       int targetSampleRate, double frequency, int blockSize,
+                                       int outputFrames);
+    static double measureThdPlusNoise(const QVector<float> &samples, double frequency,
+                                      int sampleRate);
+    static double rmsInDb(const QVector<float> &samples);
+
+    static const int SKIPPED_FRAMES = 1000;// the filter start
+};
+
+QVector<float> TestSamplesBufferResampler::resampleSine(SamplesBufferResampler::Quality quality,
+                                                        int sourceSampleRate,
+                                                        int targetSampleRate, double frequency,
+                                                        int blockSize, int outputFrames)
+{
+    SamplesBufferResampler resampler(quality);
+    resampler.setSampleRates(sourceSampleRate, targetSampleRate);
+
+    QVector<float> output;
+    SamplesBuffer input(1, 4096);
+    long inputPosition = 0;
+    while (output.size() < outputFrames) {
+        int inputFrames = resampler.getInputFramesFor(blockSize);
+        input.setFrameLenght(inputFrames);
+        float *samples = input.getSamplesArray(0);
+        for (int i = 0; i < inputFrames; ++i)
+            samples[i] = 0.5 * std::sin(2 * M_PI * frequency * (inputPosition + i)/sourceSampleRate);
+        inputPosition += inputFrames;
+
+        const SamplesBuffer &resampled = resampler.resample(input, blockSize);
+        if (resampled.getFrameLenght() != blockSize)
+            qWarning() << "missing frames:" << blockSize - resampled.getFrameLenght();
+        for (int i = 0; i < resampled.getFrameLenght(); ++i)
+            output.append(resampled.getReadOnlySamplesArray(0)[i]);
+    }
+    return output.mid(SKIPPED_FRAMES);
+}
+
+double TestSamplesBufferResampler::measureThdPlusNoise(const QVector<float> &samples,
+                                                       double frequency, int sampleRate)
+{
+    // least squares fit of a*sin + b*cos in the expected frequency
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, yy = 0;
+    for (int i = 0; i < samples.size(); ++i) {
+        double t = 2 * M_PI * frequency * (i + SKIPPED_FRAMES)/sampleRate;
+        double s = std::sin(t), c = std::cos(t), y = samples[i];
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y * s;
+        yc += y * c;
+        yy += y * y;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc)/det;
+    double b = (yc * ss - ys * sc)/det;
+
+    double residual = 0;
+    for (int i = 0; i < samples.size(); ++i) {
+        double t = 2 * M_PI * frequency * (i + SKIPPED_FRAMES)/sampleRate;
+        double error = samples[i] - a * std::sin(t) - b * std::cos(t);
+        residual += error * error;
+    }
+    return 10 * std::log10(residual/yy);
+}
+
+double TestSamplesBufferResampler::rmsInDb(const QVector<float> &samples)
+{
+    double sum = 0;
+    foreach (float sample, samples)
+        sum += sample * sample;
+    double inputPower = 0.5 * 0.5/2;// the sine amplitude is 0.5
+    return 10 * std::log10(sum/samples.size()/inputPower);
+}
+
+// +++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferResampler::thdPlusNoise_data()
+{
+    QTest::addColumn<SamplesBufferResampler::Quality>("quality");
+    QTest::addColumn<int>("sourceSampleRate");
+    QTest::addColumn<int>("targetSampleRate");
+    QTest::addColumn<double>("frequency");
+    QTest::addColumn<double>("maxThdPlusNoise");// in dB
+
+    QTest::newRow("low latency 44.1k -> 48k 1kHz") << SamplesBufferResampler::LOW_LATENCY << 44100 << 48000 << 1000.0 << -70.0;
+    QTest::newRow("normal 44.1k -> 48k 1kHz") << SamplesBufferResampler::NORMAL << 44100 << 48000 << 1000.0 << -85.0;
+    QTest::newRow("normal 48k -> 44.1k 1kHz") << SamplesBufferResampler::NORMAL << 48000 << 44100 << 1000.0 << -85.0;
+    QTest::newRow("normal 48k -> 44.1k 10kHz") << SamplesBufferResampler::NORMAL << 48000 << 44100 << 10000.0 << -85.0;
+    QTest::newRow("high 44.1k -> 48k 1kHz") << SamplesBufferResampler::HIGH << 44100 << 48000 << 1000.0 << -105.0;
+    QTest::newRow("high 48k -> 44.1k 10kHz") << SamplesBufferResampler::HIGH << 48000 << 44100 << 10000.0 << -105.0;
+}
+
+void TestSamplesBufferResampler::thdPlusNoise()
+{
+    QFETCH(SamplesBufferResampler::Quality, quality);
+    QFETCH(int, sourceSampleRate);
+    QFETCH(int, targetSampleRate);
+    QFETCH(double, frequency);
+    QFETCH(double, maxThdPlusNoise);
+
+    QVector<float> output = resampleSine(quality, sourceSampleRate, targetSampleRate, frequency,
+                                         128, targetSampleRate);
+    double thdPlusNoise = measureThdPlusNoise(output, frequency, targetSampleRate);
+    qDebug() << "THD+N:" << thdPlusNoise << "dB";
+    QVERIFY(thdPlusNoise < maxThdPlusNoise);
+}
+
+// +++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferResampler::aliasing_data()
+{
+    QTest::addColumn<SamplesBufferResampler::Quality>("quality");
+    QTest::addColumn<double>("maxAliasing");// in dB
+
+    QTest::newRow("low latency") << SamplesBufferResampler::LOW_LATENCY << -35.0;
+    QTest::newRow("normal") << SamplesBufferResampler::NORMAL << -55.0;
+    QTest::newRow("high") << SamplesBufferResampler::HIGH << -90.0;
+}
+
+void TestSamplesBufferResampler::aliasing()
+{
+    QFETCH(SamplesBufferResampler::Quality, quality);
+    QFETCH(double, maxAliasing);
+
+    // 23 kHz is above the 44.1k nyquist, everything in the output is aliasing
+    QVector<float> output = resampleSine(quality, 48000, 44100, 23000, 256, 44100);
+    double aliasing = rmsInDb(output);
+    qDebug() << "aliasing:" << aliasing << "dB";
+    QVERIFY(aliasing < maxAliasing);
+}
+
+// +++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferResampler::blockSizeIndependence()
+{
+    // the state carried between blocks must give the same result with any block size
+    QVector<float> smallBlocks = resampleSine(SamplesBufferResampler::NORMAL, 44100, 48000, 440,
+                                              32, 8192);
+    QVector<float> bigBlocks = resampleSine(SamplesBufferResampler::NORMAL, 44100, 48000, 440,
+                                            1024, 8192);
+    int frames = qMin(smallBlocks.size(), bigBlocks.size());
+    for (int i = 0; i < frames; ++i)
+        QVERIFY(std::fabs(smallBlocks[i] - bigBlocks[i]) < 1e-4f);
+}
+
+void TestSamplesBufferResampler::inputBiggerThanTheHistory()
+{
+    // downsampling 8192 frames needs more input than the history holds, it's resampled in chunks
+    QVector<float> smallBlocks = resampleSine(SamplesBufferResampler::NORMAL, 48000, 22050, 440,
+                                              64, 8192 * 3);
+    QVector<float> bigBlocks = resampleSine(SamplesBufferResampler::NORMAL, 48000, 22050, 440,
+                                            8192, 8192 * 3);
+    QVERIFY(bigBlocks.size() >= 8192 * 2);
+    int frames = qMin(smallBlocks.size(), bigBlocks.size());
+    for (int i = 0; i < frames; ++i)
+        QVERIFY(std::fabs(smallBlocks[i] - bigBlocks[i]) < 1e-4f);
+}
+
+void TestSamplesBufferResampler::passThroughWithShortInput()
+{
+    SamplesBufferResampler resampler;// sample rates not setted, the input is just copied
+    SamplesBuffer input(2, 64);
+    for (int c = 0; c < 2; ++c) {
+        float *samples = input.getSamplesArray(c);
+        for (int i = 0; i < 64; ++i)
+            samples[i] = 1;
+    }
+    QCOMPARE(resampler.resample(input, 64).getFrameLenght(), 64);
+
+    input.setFrameLenght(32);
+    const SamplesBuffer &resampled = resampler.resample(input, 64);
+    QCOMPARE(resampled.getFrameLenght(), 32);// the samples of the last block are not returned
+    QCOMPARE(resampled.get(0, 31), 1.0f);
+}
+
+// +++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferResampler::offlineBenchmark_data()
+{
+    QTest::addColumn<SamplesBufferResampler::Quality>("quality");
+    QTest::addColumn<int>("blockSize");
+
+    QTest::newRow("low latency 64 frames") << SamplesBufferResampler::LOW_LATENCY << 64;
+    QTest::newRow("normal 64 frames") << SamplesBufferResampler::NORMAL << 64;
+    QTest::newRow("normal 256 frames") << SamplesBufferResampler::NORMAL << 256;
+    QTest::newRow("high 256 frames") << SamplesBufferResampler::HIGH << 256;
+}
+
+void TestSamplesBufferResampler::offlineBenchmark()
+{
+    QFETCH(SamplesBufferResampler::Quality, quality);
+    QFETCH(int, blockSize);
+
+    // one second of a stereo channel, 44.1k -> 48k
+    SamplesBufferResampler resampler(quality);
+    resampler.setSampleRates(44100, 48000);
+    SamplesBuffer input(2, 4096);
+    for (int c = 0; c < 2; ++c) {
+        float *samples = input.getSamplesArray(c);
+        for (int i = 0; i < 4096; ++i)
+            samples[i] = std::sin(i * 0.05f);
+    }
+    QBENCHMARK {
+        for (int rendered = 0; rendered < 48000; rendered += blockSize) {
+            input.setFrameLenght(resampler.getInputFramesFor(blockSize));
+            resampler.resample(input, blockSize);
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(TestSamplesBufferResampler)
+
+#include "tst_SamplesBufferResampler.moc"
@@ -0,0 +1,18 @@
+QT += testlib
+QT -= gui
+CONFIG += testcase
+CONFIG += c++11
+TEMPLATE = app
+TARGET = tst_samplesbuffer
+INCLUDEPATH += .
+INCLUDEPATH += ../../../src/Common
+VPATH += ../../../src/Common
+
+# Input
+HEADERS += audio/core/AudioPeak.h
+HEADERS += audio/core/SamplesBuffer.h
+HEADERS += audio/core/SamplesBufferKernels.h
+SOURCES += audio/core/AudioPeak.cpp
+SOURCES += audio/core/SamplesBuffer.cpp
+SOURCES += audio/core/SamplesBufferKernels.cpp
+SOURCES += tst_SamplesBufferKernels.cpp
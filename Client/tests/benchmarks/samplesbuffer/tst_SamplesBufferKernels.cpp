@@ -0,0 +1,365 @@
+#include <QObject>
+#include <QString>
+#include <QtTest/QtTest>
+#include <climits>
+#include <cmath>
+#include "audio/core/SamplesBuffer.h"
+#include "audio/core/SamplesBufferKernels.h"
+
+using namespace Audio;
+
+Q_DECLARE_METATYPE(const Audio::Kernels::Functions *)
+
+/**
+ * Compare the SIMD kernels with the scalar (original SamplesBuffer) loops
+ * using the usual audio driver block sizes.
+ *
+ * Run with -tickcounter or -callgrind for more precise results.
+ */
+class TestSamplesBufferKernels : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void kernelsResults_data();
+    void kernelsResults();
+
+    void applyGainAndPan_data();
+    void applyGainAndPan();
+    void mix_data();
+    void mix();
+    void applyRamp_data();
+    void applyRamp();
+    void applyGainAndComputePeak_data();
+    void applyGainAndComputePeak();
+    void deinterleaveShorts_data();
+    void deinterleaveShorts();
+    void convertToInts_data();
+    void convertToInts();
+
+    void samplesBufferMix_data();
+    void samplesBufferMix();
+
+    void driverBuffers_data();
+    void driverBuffers();
+
+private:
+    void createBenchmarkData();
+    static void fillSamples(SamplesBuffer &buffer);
+};
+
+void TestSamplesBufferKernels::initTestCase()
+{
+    qDebug() << "Selected kernels:" << Kernels::get().name;
+}
+
+void TestSamplesBufferKernels::fillSamples(SamplesBuffer &buffer)
+{
+    for (int c = 0; c < buffer.getChannels(); ++c) {
+        float *samples = buffer.getSamplesArray(c);
+        for (int i = 0; i < buffer.getFrameLenght(); ++i)
+            samples[i] = std::sin(i * 0.01f * (c + 1)) * ((i % 3) ? 0.5f : -0.9f);
+    }
+}
+
+void TestSamplesBufferKernels::createBenchmarkData()
+{
+    QTest::addColumn<const Kernels::Functions *>("kernels");
+    QTest::addColumn<int>("frames");
+
+    QList<const Kernels::Functions *> implementations;
+    implementations << &Kernels::scalar() << Kernels::sse() << Kernels::avx() << Kernels::neon();
+
+    const int blockSizes[] = {32, 64, 128, 256, 1024};
+    foreach (const Kernels::Functions *kernels, implementations) {
+        if (!kernels)
+            continue;// not supported in this CPU
+        for (int frames : blockSizes) {
+            QString tag = QString("%1 %2 frames").arg(kernels->name).arg(frames);
+            QTest::newRow(tag.toLatin1().constData()) << kernels << frames;
+        }
+    }
+}
+
+// ++++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferKernels::kernelsResults_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::kernelsResults()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    const int testedFrames = frames + 3;// test the scalar tail in SIMD kernels
+    SamplesBuffer reference(2, testedFrames);
+    fillSamples(reference);
+    SamplesBuffer tested(reference);
+
+    float *expected = reference.getSamplesArray(0);
+    float *actual = tested.getSamplesArray(0);
+    const float *source = reference.getReadOnlySamplesArray(1);
+
+    float expectedPeak = Kernels::scalar().applyGainAndComputePeak(expected, testedFrames, 0.7f);
+    float actualPeak = kernels->applyGainAndComputePeak(actual, testedFrames, 0.7f);
+    QCOMPARE(actualPeak, expectedPeak);
+    QCOMPARE(kernels->computePeak(actual, testedFrames), expectedPeak);
+
+    Kernels::scalar().mix(expected, source, testedFrames);
+    kernels->mix(actual, source, testedFrames);
+
+    Kernels::scalar().applyRamp(expected, testedFrames, 0.1f, 0.9f/testedFrames);
+    kernels->applyRamp(actual, testedFrames, 0.1f, 0.9f/testedFrames);
+
+    for (int i = 0; i < testedFrames; ++i)
+        QVERIFY(std::fabs(actual[i] - expected[i]) < 1e-5f);
+
+    // the mp3 decoder output, the conversions are exact
+    QVector<short> shorts(testedFrames * 2);
+    for (int i = 0; i < shorts.size(); ++i)
+        shorts[i] = (short)((i * 7919) % USHRT_MAX + SHRT_MIN);
+    Kernels::scalar().deinterleaveShorts(expected, reference.getSamplesArray(1), shorts.constData(),
+                                         testedFrames);
+    kernels->deinterleaveShorts(actual, tested.getSamplesArray(1), shorts.constData(), testedFrames);
+    for (int i = 0; i < testedFrames; ++i) {
+        QCOMPARE(actual[i], expected[i]);
+        QCOMPARE(tested.getReadOnlySamplesArray(1)[i], reference.getReadOnlySamplesArray(1)[i]);
+    }
+
+    Kernels::scalar().convertShorts(expected, shorts.constData(), testedFrames);
+    kernels->convertShorts(actual, shorts.constData(), testedFrames);
+    for (int i = 0; i < testedFrames; ++i)
+        QCOMPARE(actual[i], expected[i]);
+
+    // the recorded PCM, the clipped samples are in the source
+    QVector<int> expectedInts(testedFrames);
+    QVector<int> actualInts(testedFrames);
+    Kernels::scalar().applyGain(expected, testedFrames, 1.5f);
+    Kernels::scalar().convertToInts(expectedInts.data(), expected, testedFrames, 8388607.0f);
+    kernels->convertToInts(actualInts.data(), expected, testedFrames, 8388607.0f);
+    for (int i = 0; i < testedFrames; ++i) {
+        QCOMPARE(actualInts[i], expectedInts[i]);
+        QVERIFY(std::abs(actualInts[i]) <= 8388607);
+    }
+}
+
+// ++++++++++++++++++++++++++++++++++++++++
+
+void TestSamplesBufferKernels::applyGainAndPan_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::applyGainAndPan()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer buffer(2, frames);
+    fillSamples(buffer);
+    QBENCHMARK {
+        kernels->applyGain(buffer.getSamplesArray(0), frames, 0.999f);
+        kernels->applyGain(buffer.getSamplesArray(1), frames, 1.001f);
+    }
+}
+
+void TestSamplesBufferKernels::mix_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::mix()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer out(2, frames);
+    SamplesBuffer in(2, frames);
+    fillSamples(in);
+    QBENCHMARK {
+        kernels->mix(out.getSamplesArray(0), in.getReadOnlySamplesArray(0), frames);
+        kernels->mix(out.getSamplesArray(1), in.getReadOnlySamplesArray(1), frames);
+    }
+}
+
+void TestSamplesBufferKernels::applyRamp_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::applyRamp()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer buffer(2, frames);
+    fillSamples(buffer);
+    float gainStep = 0.001f/frames;
+    QBENCHMARK {
+        kernels->applyRamp(buffer.getSamplesArray(0), frames, 0.9995f, gainStep);
+        kernels->applyRamp(buffer.getSamplesArray(1), frames, 0.9995f, gainStep);
+    }
+}
+
+void TestSamplesBufferKernels::applyGainAndComputePeak_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::applyGainAndComputePeak()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer buffer(2, frames);
+    fillSamples(buffer);
+    float peak = 0;
+    QBENCHMARK {
+        peak += kernels->applyGainAndComputePeak(buffer.getSamplesArray(0), frames, 0.999f);
+        peak += kernels->applyGainAndComputePeak(buffer.getSamplesArray(1), frames, 1.001f);
+    }
+    QVERIFY(peak > 0);
+}
+
+void TestSamplesBufferKernels::deinterleaveShorts_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::deinterleaveShorts()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer buffer(2, frames);
+    QVector<short> shorts(frames * 2);
+    for (int i = 0; i < shorts.size(); ++i)
+        shorts[i] = (short)(std::sin(i * 0.01f) * SHRT_MAX);
+    QBENCHMARK {
+        kernels->deinterleaveShorts(buffer.getSamplesArray(0), buffer.getSamplesArray(1),
+                                    shorts.constData(), frames);
+    }
+}
+
+void TestSamplesBufferKernels::convertToInts_data()
+{
+    createBenchmarkData();
+}
+
+void TestSamplesBufferKernels::convertToInts()
+{
+    QFETCH(const Kernels::Functions *, kernels);
+    QFETCH(int, frames);
+
+    SamplesBuffer buffer(2, frames);
+    fillSamples(buffer);
+    QVector<int> ints(frames);
+    QBENCHMARK {
+        kernels->convertToInts(ints.data(), buffer.getSamplesArray(0), frames, 32767.0f);
+        kernels->convertToInts(ints.data(), buffer.getSamplesArray(1), frames, 32767.0f);
+    }
+}
+
+// ++++++++++++++++++++++++++++++++++++++++
+// the complete SamplesBuffer call used for every track in the mixer (20 remote channels)
+
+void TestSamplesBufferKernels::samplesBufferMix_data()
+{
+    QTest::addColumn<int>("frames");
+    QTest::addColumn<bool>("silent");// idle remote users, the silent tracks are not mixed
+
+    const int blockSizes[] = {32, 64, 128, 256, 1024};
+    for (bool silent : {false, true}) {
+        for (int frames : blockSizes) {
+            QString tag = QString("%1 frames%2").arg(frames).arg(silent ? " (silent)" : "");
+            QTest::newRow(tag.toLatin1().constData()) << frames << silent;
+        }
+    }
+}
+
+void TestSamplesBufferKernels::samplesBufferMix()
+{
+    QFETCH(int, frames);
+    QFETCH(bool, silent);
+
+    const int tracks = 20;
+    SamplesBuffer track(2, frames);
+    SamplesBuffer out(2, frames);
+    if (!silent)
+        fillSamples(track);
+    QBENCHMARK {
+        out.zero();
+        for (int t = 0; t < tracks; ++t) {
+            track.applyGainAndComputePeak(1.0f, 0.99f, 1.0f, 1.0f);
+            out.add(track);
+        }
+    }
+}
+
+// ++++++++++++++++++++++++++++++++++++++++
+// the audio driver buffers exposed to the engine, interleaved (PortAudio) or non interleaved (JACK)
+
+void TestSamplesBufferKernels::driverBuffers_data()
+{
+    QTest::addColumn<bool>("interleaved");
+    QTest::addColumn<int>("frames");
+
+    const int blockSizes[] = {16, 32, 64, 128, 256};
+    for (int frames : blockSizes) {
+        QTest::newRow(QString("interleaved %1 frames").arg(frames).toLatin1().constData()) << true
+                                                                                       << frames;
+        QTest::newRow(QString("external %1 frames").arg(frames).toLatin1().constData()) << false
+                                                                                    << frames;
+    }
+}
+
+void TestSamplesBufferKernels::driverBuffers()
+{
+    QFETCH(bool, interleaved);
+    QFETCH(int, frames);
+
+    const int channels = 2;
+    SamplesBuffer source(channels, frames);
+    fillSamples(source);
+    QVector<float> interleavedIn(frames * channels);
+    QVector<float> interleavedOut(frames * channels);
+    source.getInterleavedSamples(interleavedIn.data(), channels);
+    float *driverIn[] = {source.getSamplesArray(0), source.getSamplesArray(1)};
+    SamplesBuffer driverOutput(channels, frames);
+    float *driverOut[] = {driverOutput.getSamplesArray(0), driverOutput.getSamplesArray(1)};
+
+    SamplesBuffer in(channels);
+    SamplesBuffer out(channels);
+    QBENCHMARK {
+        if (interleaved) {
+            in.setFrameLenght(frames);
+            out.setFrameLenght(frames);
+            in.setInterleavedSamples(interleavedIn.constData(), channels);
+            out.zero();
+            out.add(in);
+            out.getInterleavedSamples(interleavedOut.data(), channels);
+        } else {
+            in.setExternalSamples(driverIn, frames);
+            out.setExternalSamples(driverOut, frames);
+            out.zero();
+            out.add(in);
+        }
+    }
+
+    // the engine output is in the driver memory, without copies
+    if (!interleaved) {
+        QCOMPARE(out.getSamplesArray(1), driverOut[1]);
+        for (int i = 0; i < frames; ++i)
+            QCOMPARE(driverOut[0][i], driverIn[0][i]);
+        out.releaseExternalSamples();
+        QCOMPARE(out.getFrameLenght(), 0);
+    }
+}
+
+QTEST_APPLESS_MAIN(TestSamplesBufferKernels)
+
+#include "tst_SamplesBufferKernels.moc"